@@ -19,7 +19,9 @@ readonly OUTPUT_DIR="$(mktemp -d)"
 
 declare -a output_files
 output_files=("compile_time.csv" "run_time.csv" "memory_usage.csv"
-              "frame_time.csv" "events.log")
+              "frame_time.csv" "queue_submit.csv" "sync_wait.csv"
+              "command_recording.csv" "descriptor.csv"
+              "resource_creation.csv" "events.log")
 
 #######################################
 # Checks if the layers write data in their specified log files.
@@ -44,12 +46,24 @@ export VK_INSTANCE_LAYERS=VK_LAYER_STADIA_pipeline_compile_time
 export VK_INSTANCE_LAYERS=$VK_INSTANCE_LAYERS:VK_LAYER_STADIA_pipeline_runtime
 export VK_INSTANCE_LAYERS=$VK_INSTANCE_LAYERS:VK_LAYER_STADIA_frame_time
 export VK_INSTANCE_LAYERS=$VK_INSTANCE_LAYERS:VK_LAYER_STADIA_memory_usage
+export VK_INSTANCE_LAYERS=$VK_INSTANCE_LAYERS:VK_LAYER_STADIA_queue_submit
+export VK_INSTANCE_LAYERS=$VK_INSTANCE_LAYERS:VK_LAYER_STADIA_sync_wait
+export VK_INSTANCE_LAYERS=$VK_INSTANCE_LAYERS:VK_LAYER_STADIA_command_recording
+export VK_INSTANCE_LAYERS=$VK_INSTANCE_LAYERS:VK_LAYER_STADIA_descriptor
+export VK_INSTANCE_LAYERS=$VK_INSTANCE_LAYERS:VK_LAYER_STADIA_resource_creation
 export VK_INSTANCE_LAYERS=$VK_INSTANCE_LAYERS:VK_LAYER_STADIA_pipeline_cache_sideload
 export VK_LAYER_PATH="${MANIFEST_DIR}"
 export VK_COMPILE_TIME_LOG="${OUTPUT_DIR}"/compile_time.csv
 export VK_RUNTIME_LOG="${OUTPUT_DIR}"/run_time.csv
 export VK_FRAME_TIME_LOG="${OUTPUT_DIR}"/frame_time.csv
 export VK_MEMORY_USAGE_LOG="${OUTPUT_DIR}"/memory_usage.csv
+# check_memory_usage_log.txt expects a memory usage row every frame.
+export VK_MEMORY_USAGE_SNAPSHOT_FRAMES=1
+export VK_QUEUE_SUBMIT_LOG="${OUTPUT_DIR}"/queue_submit.csv
+export VK_SYNC_WAIT_LOG="${OUTPUT_DIR}"/sync_wait.csv
+export VK_COMMAND_RECORDING_LOG="${OUTPUT_DIR}"/command_recording.csv
+export VK_DESCRIPTOR_LOG="${OUTPUT_DIR}"/descriptor.csv
+export VK_RESOURCE_CREATION_LOG="${OUTPUT_DIR}"/resource_creation.csv
 export VK_PERFORMANCE_LAYERS_EVENT_LOG_FILE="${OUTPUT_DIR}"/events.log
 export VK_PERFORMANCE_LAYERS_TRACE_EVENT_LOG_FILE="${OUTPUT_DIR}"/trace_events.log
 
@@ -75,6 +89,21 @@ FileCheck "${PROJECT_ROOT_DIR}/test/check_memory_usage_log.txt" \
 FileCheck "${PROJECT_ROOT_DIR}/test/check_frame_time_log.txt" \
   --match-full-lines --input-file "${OUTPUT_DIR}"/frame_time.csv
 
+FileCheck "${PROJECT_ROOT_DIR}/test/check_queue_submit_log.txt" \
+  --match-full-lines --input-file "${OUTPUT_DIR}"/queue_submit.csv
+
+FileCheck "${PROJECT_ROOT_DIR}/test/check_sync_wait_log.txt" \
+  --match-full-lines --input-file "${OUTPUT_DIR}"/sync_wait.csv
+
+FileCheck "${PROJECT_ROOT_DIR}/test/check_command_recording_log.txt" \
+  --match-full-lines --input-file "${OUTPUT_DIR}"/command_recording.csv
+
+FileCheck "${PROJECT_ROOT_DIR}/test/check_descriptor_log.txt" \
+  --match-full-lines --input-file "${OUTPUT_DIR}"/descriptor.csv
+
+FileCheck "${PROJECT_ROOT_DIR}/test/check_resource_creation_log.txt" \
+  --match-full-lines --input-file "${OUTPUT_DIR}"/resource_creation.csv
+
 FileCheck "${PROJECT_ROOT_DIR}/test/check_event_log.txt" \
   --match-full-lines --input-file "${OUTPUT_DIR}"/events.log
 
@@ -0,0 +1,156 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "layer/support/common_logging.h"
+#include "layer/support/csv_logging.h"
+#include "layer/support/event_logging.h"
+#include "layer/support/layer_utils.h"
+#include "layer/support/log_output.h"
+#include "layer/support/trace_event_logging.h"
+
+namespace performancelayers {
+namespace {
+// A pipeline creation event, like the compile time layer logs for every
+// pipeline, as a complete event in the Trace Event format.
+class CompileTimeCompleteEvent : public Event {
+ public:
+  CompileTimeCompleteEvent()
+      : Event("create_graphics_pipelines", LogLevel::kHigh),
+        hash_values_("hashes", {0x1234567890abcdef, 0x0fedcba987654321}),
+        duration_("duration", Duration::FromNanoseconds(1234567)),
+        trace_event_("trace_event", "pipeline", "X", {&duration_}) {
+    InitAttributes({&hash_values_, &duration_, &trace_event_});
+  }
+
+ private:
+  VectorInt64Attr hash_values_;
+  DurationAttr duration_;
+  TraceEventAttr trace_event_;
+};
+
+// An event with one attribute of every scalar type, like the reports of the
+// memory usage layer.
+class ScalarAttributesEvent : public Event {
+ public:
+  ScalarAttributesEvent()
+      : Event("memory_usage_present", LogLevel::kHigh),
+        current_("current", 123456789),
+        peak_("peak", 987654321),
+        hash_("hash", 0x1234567890abcdef),
+        is_leak_("is_leak", false),
+        resource_("resource", "image") {
+    InitAttributes({&current_, &peak_, &hash_, &is_leak_, &resource_});
+  }
+
+ private:
+  Int64Attr current_;
+  Int64Attr peak_;
+  HashAttr hash_;
+  BoolAttr is_leak_;
+  StringAttr resource_;
+};
+
+std::unique_ptr<Event> MakeLayerInitEvent() {
+  return std::make_unique<LayerInitEvent>("frame_time_layer_init", "layer");
+}
+
+std::unique_ptr<Event> MakeCreateGraphicsPipelinesEvent() {
+  VectorInt64Attr hashes("hashes", {0x1234567890abcdef, 0x0fedcba987654321});
+  return std::make_unique<CreateGraphicsPipelinesEvent>(
+      "create_graphics_pipelines", hashes, Duration::FromNanoseconds(1234567),
+      LogLevel::kHigh);
+}
+
+std::unique_ptr<Event> MakeCompileTimeCompleteEvent() {
+  return std::make_unique<CompileTimeCompleteEvent>();
+}
+
+std::unique_ptr<Event> MakeScalarAttributesEvent() {
+  return std::make_unique<ScalarAttributesEvent>();
+}
+
+using EventFactory = std::unique_ptr<Event> (*)();
+
+void BM_EventToCSVString(benchmark::State& state, EventFactory make_event) {
+  std::unique_ptr<Event> event = make_event();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(EventToCSVString(*event));
+  }
+}
+BENCHMARK_CAPTURE(BM_EventToCSVString, LayerInit, &MakeLayerInitEvent);
+BENCHMARK_CAPTURE(BM_EventToCSVString, CreateGraphicsPipelines,
+                  &MakeCreateGraphicsPipelinesEvent);
+BENCHMARK_CAPTURE(BM_EventToCSVString, CompileTimeComplete,
+                  &MakeCompileTimeCompleteEvent);
+BENCHMARK_CAPTURE(BM_EventToCSVString, ScalarAttributes,
+                  &MakeScalarAttributesEvent);
+
+void BM_EventToCommonLogStr(benchmark::State& state, EventFactory make_event) {
+  std::unique_ptr<Event> event = make_event();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(EventToCommonLogStr(*event));
+  }
+}
+BENCHMARK_CAPTURE(BM_EventToCommonLogStr, LayerInit, &MakeLayerInitEvent);
+BENCHMARK_CAPTURE(BM_EventToCommonLogStr, CreateGraphicsPipelines,
+                  &MakeCreateGraphicsPipelinesEvent);
+BENCHMARK_CAPTURE(BM_EventToCommonLogStr, CompileTimeComplete,
+                  &MakeCompileTimeCompleteEvent);
+BENCHMARK_CAPTURE(BM_EventToCommonLogStr, ScalarAttributes,
+                  &MakeScalarAttributesEvent);
+
+// Only events with a `TraceEventAttr` are written to the trace log.
+void BM_EventToTraceEventString(benchmark::State& state,
+                                EventFactory make_event) {
+  std::unique_ptr<Event> event = make_event();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(EventToTraceEventString(*event));
+  }
+}
+BENCHMARK_CAPTURE(BM_EventToTraceEventString, LayerInit, &MakeLayerInitEvent);
+BENCHMARK_CAPTURE(BM_EventToTraceEventString, CompileTimeComplete,
+                  &MakeCompileTimeCompleteEvent);
+
+// Logs an event through a `BroadcastLogger` forwarding it to |state.range(0)|
+// CSV loggers, each writing to its own output.
+void BM_BroadcastLoggerFanOut(benchmark::State& state) {
+  const int num_loggers = state.range(0);
+  std::vector<std::unique_ptr<FileOutput>> outputs;
+  std::vector<std::unique_ptr<CSVLogger>> loggers;
+  std::vector<EventLogger*> logger_ptrs;
+  for (int i = 0; i != num_loggers; ++i) {
+    outputs.push_back(std::make_unique<FileOutput>("/dev/null"));
+    loggers.push_back(
+        std::make_unique<CSVLogger>("Hashes,Duration", outputs.back().get()));
+    logger_ptrs.push_back(loggers.back().get());
+  }
+  BroadcastLogger broadcast_logger(logger_ptrs);
+  broadcast_logger.StartLog();
+
+  std::unique_ptr<Event> event = MakeCreateGraphicsPipelinesEvent();
+  for (auto _ : state) {
+    broadcast_logger.AddEvent(event.get());
+  }
+  broadcast_logger.EndLog();
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BroadcastLoggerFanOut)->RangeMultiplier(2)->Range(1, 8);
+
+}  // namespace
+}  // namespace performancelayers
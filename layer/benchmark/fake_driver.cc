@@ -0,0 +1,652 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/benchmark/fake_driver.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "layer/support/layer_utils.h"
+#include "vulkan/vk_layer.h"
+#include "vulkan/vulkan.h"
+
+namespace performancelayers {
+namespace {
+FakeDriverLatencies latencies;
+
+// The size and alignment of every buffer and image.
+constexpr VkDeviceSize kResourceSize = 64 * 1024;
+constexpr VkDeviceSize kResourceAlignment = 256;
+
+// A dispatchable object. Its first word is the dispatch key the layers look
+// up their dispatch tables by, which is the address of its instance or device.
+struct FakeDispatchableObject {
+  void* dispatch_key;
+};
+
+struct FakePhysicalDevice {
+  FakeDispatchableObject object;
+};
+
+struct FakeInstance {
+  FakeDispatchableObject object;
+  FakePhysicalDevice physical_device;
+};
+
+struct FakeQueue {
+  FakeDispatchableObject object;
+};
+
+struct FakeDevice {
+  FakeDispatchableObject object;
+  FakeQueue queue;
+};
+
+// Returns a new non-dispatchable handle. Handles are never reused, so that the
+// layers never see the same handle for two live objects.
+template <typename HandleT>
+HandleT NewHandle() {
+  static std::atomic<uintptr_t> next_handle = 1;
+  return reinterpret_cast<HandleT>(
+      next_handle.fetch_add(1, std::memory_order_relaxed));
+}
+
+// Spins for |nanoseconds|, standing for the work of the driver.
+void SpinFor(int64_t nanoseconds) {
+  if (nanoseconds <= 0) return;
+  const DurationClock::time_point end =
+      Now() + std::chrono::nanoseconds(nanoseconds);
+  while (Now() < end) {
+  }
+}
+
+// Use this macro to define all vulkan functions implemented by the driver.
+#define SPL_FAKE_DRIVER_FUNC(RETURN_TYPE_, FUNC_NAME_, FUNC_ARGS_)  \
+  SPL_INTERCEPTED_VULKAN_FUNC(RETURN_TYPE_, FakeDriver_, FUNC_NAME_, \
+                              FUNC_ARGS_)
+
+// The functions implemented by the driver, defined below with
+// SPL_FAKE_DRIVER_FUNC.
+#define SPL_FAKE_DRIVER_FUNCS(X_, LAYER_PREFIX_)       \
+  X_(LAYER_PREFIX_, CreateInstance)                    \
+  X_(LAYER_PREFIX_, DestroyInstance)                   \
+  X_(LAYER_PREFIX_, EnumeratePhysicalDevices)          \
+  X_(LAYER_PREFIX_, GetPhysicalDeviceMemoryProperties) \
+  X_(LAYER_PREFIX_, CreateDevice)                      \
+  X_(LAYER_PREFIX_, DestroyDevice)                     \
+  X_(LAYER_PREFIX_, GetDeviceQueue)                    \
+  X_(LAYER_PREFIX_, DeviceWaitIdle)                    \
+  X_(LAYER_PREFIX_, QueueWaitIdle)                     \
+  X_(LAYER_PREFIX_, QueueSubmit)                       \
+  X_(LAYER_PREFIX_, QueuePresentKHR)                   \
+  X_(LAYER_PREFIX_, AllocateCommandBuffers)            \
+  X_(LAYER_PREFIX_, FreeCommandBuffers)                \
+  X_(LAYER_PREFIX_, BeginCommandBuffer)                \
+  X_(LAYER_PREFIX_, EndCommandBuffer)                  \
+  X_(LAYER_PREFIX_, CmdBindPipeline)                   \
+  X_(LAYER_PREFIX_, CmdDraw)                           \
+  X_(LAYER_PREFIX_, CmdDrawIndexed)                    \
+  X_(LAYER_PREFIX_, CmdDrawIndirect)                   \
+  X_(LAYER_PREFIX_, CmdDrawIndexedIndirect)            \
+  X_(LAYER_PREFIX_, CmdDispatch)                       \
+  X_(LAYER_PREFIX_, CmdPipelineBarrier)                \
+  X_(LAYER_PREFIX_, CmdResetQueryPool)                 \
+  X_(LAYER_PREFIX_, CmdWriteTimestamp)                 \
+  X_(LAYER_PREFIX_, CmdBeginQuery)                     \
+  X_(LAYER_PREFIX_, CmdEndQuery)                       \
+  X_(LAYER_PREFIX_, CreateQueryPool)                   \
+  X_(LAYER_PREFIX_, DestroyQueryPool)                  \
+  X_(LAYER_PREFIX_, GetQueryPoolResults)               \
+  X_(LAYER_PREFIX_, CreateShaderModule)                \
+  X_(LAYER_PREFIX_, DestroyShaderModule)               \
+  X_(LAYER_PREFIX_, CreatePipelineCache)               \
+  X_(LAYER_PREFIX_, DestroyPipelineCache)              \
+  X_(LAYER_PREFIX_, GetPipelineCacheData)              \
+  X_(LAYER_PREFIX_, MergePipelineCaches)               \
+  X_(LAYER_PREFIX_, CreateGraphicsPipelines)           \
+  X_(LAYER_PREFIX_, CreateComputePipelines)            \
+  X_(LAYER_PREFIX_, DestroyPipeline)                   \
+  X_(LAYER_PREFIX_, AllocateMemory)                    \
+  X_(LAYER_PREFIX_, FreeMemory)                        \
+  X_(LAYER_PREFIX_, CreateBuffer)                      \
+  X_(LAYER_PREFIX_, DestroyBuffer)                     \
+  X_(LAYER_PREFIX_, CreateImage)                       \
+  X_(LAYER_PREFIX_, DestroyImage)                      \
+  X_(LAYER_PREFIX_, GetBufferMemoryRequirements)       \
+  X_(LAYER_PREFIX_, GetImageMemoryRequirements)        \
+  X_(LAYER_PREFIX_, BindBufferMemory)                  \
+  X_(LAYER_PREFIX_, BindBufferMemory2)                 \
+  X_(LAYER_PREFIX_, BindBufferMemory2KHR)              \
+  X_(LAYER_PREFIX_, BindImageMemory)                   \
+  X_(LAYER_PREFIX_, BindImageMemory2)                  \
+  X_(LAYER_PREFIX_, BindImageMemory2KHR)               \
+  X_(LAYER_PREFIX_, CreateDescriptorPool)              \
+  X_(LAYER_PREFIX_, DestroyDescriptorPool)             \
+  X_(LAYER_PREFIX_, AllocateDescriptorSets)            \
+  X_(LAYER_PREFIX_, GetDeviceProcAddr)                 \
+  X_(LAYER_PREFIX_, GetInstanceProcAddr)
+
+SPL_DECLARE_INTERCEPTED_FUNCTIONS(FakeDriver_, SPL_FAKE_DRIVER_FUNCS);
+
+//////////////////////////////////////////////////////////////////////////////
+//  Instances and devices.
+//////////////////////////////////////////////////////////////////////////////
+
+SPL_FAKE_DRIVER_FUNC(VkResult, CreateInstance,
+                     (const VkInstanceCreateInfo*,
+                      const VkAllocationCallbacks*, VkInstance* instance)) {
+  auto* fake_instance = new FakeInstance();
+  fake_instance->object.dispatch_key = fake_instance;
+  // Physical devices share the dispatch key of their instance.
+  fake_instance->physical_device.object.dispatch_key = fake_instance;
+  *instance = reinterpret_cast<VkInstance>(fake_instance);
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(void, DestroyInstance,
+                     (VkInstance instance, const VkAllocationCallbacks*)) {
+  delete reinterpret_cast<FakeInstance*>(instance);
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, EnumeratePhysicalDevices,
+                     (VkInstance instance, uint32_t* physical_device_count,
+                      VkPhysicalDevice* physical_devices)) {
+  if (physical_devices == nullptr) {
+    *physical_device_count = 1;
+    return VK_SUCCESS;
+  }
+  if (*physical_device_count == 0) return VK_INCOMPLETE;
+  *physical_device_count = 1;
+  physical_devices[0] = reinterpret_cast<VkPhysicalDevice>(
+      &reinterpret_cast<FakeInstance*>(instance)->physical_device);
+  return VK_SUCCESS;
+}
+
+// Reports a device-local heap and a host-visible heap, with one memory type
+// each.
+SPL_FAKE_DRIVER_FUNC(void, GetPhysicalDeviceMemoryProperties,
+                     (VkPhysicalDevice,
+                      VkPhysicalDeviceMemoryProperties* memory_properties)) {
+  *memory_properties = {};
+  memory_properties->memoryTypeCount = 2;
+  memory_properties->memoryTypes[0] = {VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0};
+  memory_properties->memoryTypes[1] = {
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      1};
+  memory_properties->memoryHeapCount = 2;
+  memory_properties->memoryHeaps[0] = {VkDeviceSize{8} << 30,
+                                       VK_MEMORY_HEAP_DEVICE_LOCAL_BIT};
+  memory_properties->memoryHeaps[1] = {VkDeviceSize{16} << 30, 0};
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, CreateDevice,
+                     (VkPhysicalDevice, const VkDeviceCreateInfo*,
+                      const VkAllocationCallbacks*, VkDevice* device)) {
+  auto* fake_device = new FakeDevice();
+  fake_device->object.dispatch_key = fake_device;
+  fake_device->queue.object.dispatch_key = fake_device;
+  *device = reinterpret_cast<VkDevice>(fake_device);
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(void, DestroyDevice,
+                     (VkDevice device, const VkAllocationCallbacks*)) {
+  delete reinterpret_cast<FakeDevice*>(device);
+}
+
+SPL_FAKE_DRIVER_FUNC(void, GetDeviceQueue,
+                     (VkDevice device, uint32_t, uint32_t, VkQueue* queue)) {
+  *queue = reinterpret_cast<VkQueue>(
+      &reinterpret_cast<FakeDevice*>(device)->queue);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//  Queues.
+//////////////////////////////////////////////////////////////////////////////
+
+SPL_FAKE_DRIVER_FUNC(VkResult, DeviceWaitIdle, (VkDevice)) {
+  SpinFor(latencies.queue_operation_ns);
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, QueueWaitIdle, (VkQueue)) {
+  SpinFor(latencies.queue_operation_ns);
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, QueueSubmit,
+                     (VkQueue, uint32_t, const VkSubmitInfo*, VkFence)) {
+  SpinFor(latencies.queue_operation_ns);
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, QueuePresentKHR,
+                     (VkQueue, const VkPresentInfoKHR*)) {
+  SpinFor(latencies.queue_operation_ns);
+  return VK_SUCCESS;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//  Command buffers.
+//////////////////////////////////////////////////////////////////////////////
+
+SPL_FAKE_DRIVER_FUNC(VkResult, AllocateCommandBuffers,
+                     (VkDevice device,
+                      const VkCommandBufferAllocateInfo* allocate_info,
+                      VkCommandBuffer* command_buffers)) {
+  for (uint32_t i = 0; i != allocate_info->commandBufferCount; ++i) {
+    // Command buffers share the dispatch key of their device.
+    auto* command_buffer =
+        new FakeDispatchableObject{*reinterpret_cast<void**>(device)};
+    command_buffers[i] = reinterpret_cast<VkCommandBuffer>(command_buffer);
+  }
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(void, FreeCommandBuffers,
+                     (VkDevice, VkCommandPool, uint32_t command_buffer_count,
+                      const VkCommandBuffer* command_buffers)) {
+  for (uint32_t i = 0; i != command_buffer_count; ++i) {
+    delete reinterpret_cast<FakeDispatchableObject*>(command_buffers[i]);
+  }
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, BeginCommandBuffer,
+                     (VkCommandBuffer, const VkCommandBufferBeginInfo*)) {
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, EndCommandBuffer, (VkCommandBuffer)) {
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(void, CmdBindPipeline,
+                     (VkCommandBuffer, VkPipelineBindPoint, VkPipeline)) {
+  SpinFor(latencies.command_recording_ns);
+}
+
+SPL_FAKE_DRIVER_FUNC(void, CmdDraw,
+                     (VkCommandBuffer, uint32_t, uint32_t, uint32_t,
+                      uint32_t)) {
+  SpinFor(latencies.command_recording_ns);
+}
+
+SPL_FAKE_DRIVER_FUNC(void, CmdDrawIndexed,
+                     (VkCommandBuffer, uint32_t, uint32_t, uint32_t, int32_t,
+                      uint32_t)) {
+  SpinFor(latencies.command_recording_ns);
+}
+
+SPL_FAKE_DRIVER_FUNC(void, CmdDrawIndirect,
+                     (VkCommandBuffer, VkBuffer, VkDeviceSize, uint32_t,
+                      uint32_t)) {
+  SpinFor(latencies.command_recording_ns);
+}
+
+SPL_FAKE_DRIVER_FUNC(void, CmdDrawIndexedIndirect,
+                     (VkCommandBuffer, VkBuffer, VkDeviceSize, uint32_t,
+                      uint32_t)) {
+  SpinFor(latencies.command_recording_ns);
+}
+
+SPL_FAKE_DRIVER_FUNC(void, CmdDispatch,
+                     (VkCommandBuffer, uint32_t, uint32_t, uint32_t)) {
+  SpinFor(latencies.command_recording_ns);
+}
+
+SPL_FAKE_DRIVER_FUNC(void, CmdPipelineBarrier,
+                     (VkCommandBuffer, VkPipelineStageFlags,
+                      VkPipelineStageFlags, VkDependencyFlags, uint32_t,
+                      const VkMemoryBarrier*, uint32_t,
+                      const VkBufferMemoryBarrier*, uint32_t,
+                      const VkImageMemoryBarrier*)) {
+  SpinFor(latencies.command_recording_ns);
+}
+
+SPL_FAKE_DRIVER_FUNC(void, CmdResetQueryPool,
+                     (VkCommandBuffer, VkQueryPool, uint32_t, uint32_t)) {
+  SpinFor(latencies.command_recording_ns);
+}
+
+SPL_FAKE_DRIVER_FUNC(void, CmdWriteTimestamp,
+                     (VkCommandBuffer, VkPipelineStageFlagBits, VkQueryPool,
+                      uint32_t)) {
+  SpinFor(latencies.command_recording_ns);
+}
+
+SPL_FAKE_DRIVER_FUNC(void, CmdBeginQuery,
+                     (VkCommandBuffer, VkQueryPool, uint32_t,
+                      VkQueryControlFlags)) {
+  SpinFor(latencies.command_recording_ns);
+}
+
+SPL_FAKE_DRIVER_FUNC(void, CmdEndQuery,
+                     (VkCommandBuffer, VkQueryPool, uint32_t)) {
+  SpinFor(latencies.command_recording_ns);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//  Queries.
+//////////////////////////////////////////////////////////////////////////////
+
+SPL_FAKE_DRIVER_FUNC(VkResult, CreateQueryPool,
+                     (VkDevice, const VkQueryPoolCreateInfo*,
+                      const VkAllocationCallbacks*, VkQueryPool* query_pool)) {
+  SpinFor(latencies.resource_creation_ns);
+  *query_pool = NewHandle<VkQueryPool>();
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(void, DestroyQueryPool,
+                     (VkDevice, VkQueryPool, const VkAllocationCallbacks*)) {}
+
+// Reports increasing values for consecutive queries, so that timestamps read
+// as a positive, plausible duration.
+SPL_FAKE_DRIVER_FUNC(VkResult, GetQueryPoolResults,
+                     (VkDevice, VkQueryPool, uint32_t, uint32_t query_count,
+                      size_t data_size, void* data, VkDeviceSize stride,
+                      VkQueryResultFlags flags)) {
+  const size_t value_size = (flags & VK_QUERY_RESULT_64_BIT)
+                                ? sizeof(uint64_t)
+                                : sizeof(uint32_t);
+  auto* bytes = static_cast<char*>(data);
+  for (uint32_t i = 0; i != query_count; ++i) {
+    if (i * stride + value_size > data_size) break;
+    const uint64_t value = (i + 1) * uint64_t{1000};
+    if (value_size == sizeof(uint64_t)) {
+      memcpy(bytes + i * stride, &value, sizeof(value));
+    } else {
+      const uint32_t value32 = static_cast<uint32_t>(value);
+      memcpy(bytes + i * stride, &value32, sizeof(value32));
+    }
+  }
+  return VK_SUCCESS;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//  Shader modules and pipelines.
+//////////////////////////////////////////////////////////////////////////////
+
+SPL_FAKE_DRIVER_FUNC(VkResult, CreateShaderModule,
+                     (VkDevice, const VkShaderModuleCreateInfo*,
+                      const VkAllocationCallbacks*,
+                      VkShaderModule* shader_module)) {
+  SpinFor(latencies.shader_module_creation_ns);
+  *shader_module = NewHandle<VkShaderModule>();
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(void, DestroyShaderModule,
+                     (VkDevice, VkShaderModule, const VkAllocationCallbacks*)) {
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, CreatePipelineCache,
+                     (VkDevice, const VkPipelineCacheCreateInfo*,
+                      const VkAllocationCallbacks*,
+                      VkPipelineCache* pipeline_cache)) {
+  *pipeline_cache = NewHandle<VkPipelineCache>();
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(void, DestroyPipelineCache,
+                     (VkDevice, VkPipelineCache,
+                      const VkAllocationCallbacks*)) {}
+
+// Pipeline caches are always empty.
+SPL_FAKE_DRIVER_FUNC(VkResult, GetPipelineCacheData,
+                     (VkDevice, VkPipelineCache, size_t* data_size, void*)) {
+  *data_size = 0;
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, MergePipelineCaches,
+                     (VkDevice, VkPipelineCache, uint32_t,
+                      const VkPipelineCache*)) {
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, CreateGraphicsPipelines,
+                     (VkDevice, VkPipelineCache, uint32_t create_info_count,
+                      const VkGraphicsPipelineCreateInfo*,
+                      const VkAllocationCallbacks*, VkPipeline* pipelines)) {
+  for (uint32_t i = 0; i != create_info_count; ++i) {
+    SpinFor(latencies.pipeline_creation_ns);
+    pipelines[i] = NewHandle<VkPipeline>();
+  }
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, CreateComputePipelines,
+                     (VkDevice, VkPipelineCache, uint32_t create_info_count,
+                      const VkComputePipelineCreateInfo*,
+                      const VkAllocationCallbacks*, VkPipeline* pipelines)) {
+  for (uint32_t i = 0; i != create_info_count; ++i) {
+    SpinFor(latencies.pipeline_creation_ns);
+    pipelines[i] = NewHandle<VkPipeline>();
+  }
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(void, DestroyPipeline,
+                     (VkDevice, VkPipeline, const VkAllocationCallbacks*)) {}
+
+//////////////////////////////////////////////////////////////////////////////
+//  Memory and resources.
+//////////////////////////////////////////////////////////////////////////////
+
+SPL_FAKE_DRIVER_FUNC(VkResult, AllocateMemory,
+                     (VkDevice, const VkMemoryAllocateInfo*,
+                      const VkAllocationCallbacks*, VkDeviceMemory* memory)) {
+  SpinFor(latencies.memory_allocation_ns);
+  *memory = NewHandle<VkDeviceMemory>();
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(void, FreeMemory,
+                     (VkDevice, VkDeviceMemory, const VkAllocationCallbacks*)) {
+  SpinFor(latencies.memory_allocation_ns);
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, CreateBuffer,
+                     (VkDevice, const VkBufferCreateInfo*,
+                      const VkAllocationCallbacks*, VkBuffer* buffer)) {
+  SpinFor(latencies.resource_creation_ns);
+  *buffer = NewHandle<VkBuffer>();
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(void, DestroyBuffer,
+                     (VkDevice, VkBuffer, const VkAllocationCallbacks*)) {}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, CreateImage,
+                     (VkDevice, const VkImageCreateInfo*,
+                      const VkAllocationCallbacks*, VkImage* image)) {
+  SpinFor(latencies.resource_creation_ns);
+  *image = NewHandle<VkImage>();
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(void, DestroyImage,
+                     (VkDevice, VkImage, const VkAllocationCallbacks*)) {}
+
+SPL_FAKE_DRIVER_FUNC(void, GetBufferMemoryRequirements,
+                     (VkDevice, VkBuffer,
+                      VkMemoryRequirements* memory_requirements)) {
+  *memory_requirements = {kResourceSize, kResourceAlignment, 0x3};
+}
+
+SPL_FAKE_DRIVER_FUNC(void, GetImageMemoryRequirements,
+                     (VkDevice, VkImage,
+                      VkMemoryRequirements* memory_requirements)) {
+  *memory_requirements = {kResourceSize, kResourceAlignment, 0x3};
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, BindBufferMemory,
+                     (VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize)) {
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, BindBufferMemory2,
+                     (VkDevice, uint32_t, const VkBindBufferMemoryInfo*)) {
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, BindBufferMemory2KHR,
+                     (VkDevice, uint32_t, const VkBindBufferMemoryInfo*)) {
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, BindImageMemory,
+                     (VkDevice, VkImage, VkDeviceMemory, VkDeviceSize)) {
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, BindImageMemory2,
+                     (VkDevice, uint32_t, const VkBindImageMemoryInfo*)) {
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, BindImageMemory2KHR,
+                     (VkDevice, uint32_t, const VkBindImageMemoryInfo*)) {
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, CreateDescriptorPool,
+                     (VkDevice, const VkDescriptorPoolCreateInfo*,
+                      const VkAllocationCallbacks*,
+                      VkDescriptorPool* descriptor_pool)) {
+  SpinFor(latencies.resource_creation_ns);
+  *descriptor_pool = NewHandle<VkDescriptorPool>();
+  return VK_SUCCESS;
+}
+
+SPL_FAKE_DRIVER_FUNC(void, DestroyDescriptorPool,
+                     (VkDevice, VkDescriptorPool,
+                      const VkAllocationCallbacks*)) {}
+
+SPL_FAKE_DRIVER_FUNC(VkResult, AllocateDescriptorSets,
+                     (VkDevice,
+                      const VkDescriptorSetAllocateInfo* allocate_info,
+                      VkDescriptorSet* descriptor_sets)) {
+  for (uint32_t i = 0; i != allocate_info->descriptorSetCount; ++i) {
+    descriptor_sets[i] = NewHandle<VkDescriptorSet>();
+  }
+  return VK_SUCCESS;
+}
+
+}  // namespace
+
+SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE(FakeDriver_, SPL_FAKE_DRIVER_FUNCS);
+
+// Like an ICD, the driver returns its functions for instances and devices
+// alike, and null for the functions it doesn't implement.
+
+SPL_LAYER_ENTRY_POINT
+SPL_FAKE_DRIVER_FUNC(PFN_vkVoidFunction, GetDeviceProcAddr,
+                     (VkDevice, const char* name)) {
+  return SPL_GET_INTERCEPTED_VULKAN_FUNC(FakeDriver_, name);
+}
+
+SPL_LAYER_ENTRY_POINT
+SPL_FAKE_DRIVER_FUNC(PFN_vkVoidFunction, GetInstanceProcAddr,
+                     (VkInstance, const char* name)) {
+  return SPL_GET_INTERCEPTED_VULKAN_FUNC(FakeDriver_, name);
+}
+
+void SetFakeDriverLatencies(const FakeDriverLatencies& new_latencies) {
+  latencies = new_latencies;
+}
+
+bool CreateLayerChain(PFN_vkGetInstanceProcAddr get_instance_proc_addr,
+                      PFN_vkGetDeviceProcAddr get_device_proc_addr,
+                      LayerChain* chain) {
+  *chain = {};
+  chain->get_instance_proc_addr = get_instance_proc_addr;
+  chain->get_device_proc_addr = get_device_proc_addr;
+
+  // The link to the driver, which the layer takes off the chain before
+  // calling the driver. The driver itself ignores the link info.
+  VkLayerInstanceLink instance_link = {};
+  instance_link.pfnNextGetInstanceProcAddr = &FakeDriver_GetInstanceProcAddr;
+  VkLayerInstanceCreateInfo layer_instance_create_info = {};
+  layer_instance_create_info.sType =
+      VK_STRUCTURE_TYPE_LOADER_INSTANCE_CREATE_INFO;
+  layer_instance_create_info.function = VK_LAYER_LINK_INFO;
+  layer_instance_create_info.u.pLayerInfo = &instance_link;
+
+  VkInstanceCreateInfo instance_create_info = {};
+  instance_create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+  instance_create_info.pNext = &layer_instance_create_info;
+
+  auto create_instance = reinterpret_cast<PFN_vkCreateInstance>(
+      get_instance_proc_addr(VK_NULL_HANDLE, "vkCreateInstance"));
+  if (create_instance == nullptr ||
+      create_instance(&instance_create_info, nullptr, &chain->instance) !=
+          VK_SUCCESS) {
+    return false;
+  }
+
+  auto enumerate_physical_devices =
+      reinterpret_cast<PFN_vkEnumeratePhysicalDevices>(get_instance_proc_addr(
+          chain->instance, "vkEnumeratePhysicalDevices"));
+  uint32_t physical_device_count = 1;
+  if (enumerate_physical_devices(chain->instance, &physical_device_count,
+                                 &chain->physical_device) != VK_SUCCESS) {
+    return false;
+  }
+
+  VkLayerDeviceLink device_link = {};
+  device_link.pfnNextGetInstanceProcAddr = &FakeDriver_GetInstanceProcAddr;
+  device_link.pfnNextGetDeviceProcAddr = &FakeDriver_GetDeviceProcAddr;
+  VkLayerDeviceCreateInfo layer_device_create_info = {};
+  layer_device_create_info.sType = VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO;
+  layer_device_create_info.function = VK_LAYER_LINK_INFO;
+  layer_device_create_info.u.pLayerInfo = &device_link;
+
+  VkDeviceCreateInfo device_create_info = {};
+  device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  device_create_info.pNext = &layer_device_create_info;
+
+  auto create_device = reinterpret_cast<PFN_vkCreateDevice>(
+      get_instance_proc_addr(chain->instance, "vkCreateDevice"));
+  if (create_device(chain->physical_device, &device_create_info, nullptr,
+                    &chain->device) != VK_SUCCESS) {
+    return false;
+  }
+
+  auto get_device_queue = reinterpret_cast<PFN_vkGetDeviceQueue>(
+      get_device_proc_addr(chain->device, "vkGetDeviceQueue"));
+  get_device_queue(chain->device, 0, 0, &chain->queue);
+  return true;
+}
+
+void DestroyLayerChain(LayerChain* chain) {
+  if (chain->device != VK_NULL_HANDLE) {
+    auto destroy_device = reinterpret_cast<PFN_vkDestroyDevice>(
+        chain->get_device_proc_addr(chain->device, "vkDestroyDevice"));
+    destroy_device(chain->device, nullptr);
+  }
+  if (chain->instance != VK_NULL_HANDLE) {
+    auto destroy_instance = reinterpret_cast<PFN_vkDestroyInstance>(
+        chain->get_instance_proc_addr(chain->instance, "vkDestroyInstance"));
+    destroy_instance(chain->instance, nullptr);
+  }
+  *chain = {};
+}
+
+}  // namespace performancelayers
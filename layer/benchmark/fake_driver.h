@@ -0,0 +1,87 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_FAKE_DRIVER_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_FAKE_DRIVER_H_
+
+#include <cstdint>
+
+#include "layer/support/layer_utils.h"
+#include "vulkan/vulkan.h"
+
+// A fake Vulkan driver, to run the layers without a GPU.
+//
+// The driver implements the functions the layers call on the next layer, and
+// those an application needs to drive them: instance and device creation,
+// command buffers, pipelines, shader modules, query pools, memory, resources,
+// descriptors, submission and presentation. Every function returns success
+// after spinning for the latency configured for its kind of work. Handles are
+// laid out like the loader's: dispatchable objects start with a key that is
+// unique per instance or per device, which is what the layers look up their
+// dispatch tables by.
+//
+// The driver's *GetProcAddr functions take the place of the next layer in the
+// loader's link info. With |CreateLayerChain| below, the whole chain can be
+// created without a loader.
+
+namespace performancelayers {
+// The time, in nanoseconds, that fake driver functions spin for, by the kind
+// of work they stand for. Functions creating several objects spin once per
+// object.
+struct FakeDriverLatencies {
+  int64_t pipeline_creation_ns = 0;
+  int64_t shader_module_creation_ns = 0;
+  int64_t memory_allocation_ns = 0;
+  int64_t resource_creation_ns = 0;
+  int64_t command_recording_ns = 0;
+  int64_t queue_operation_ns = 0;
+};
+
+// Sets the latencies of the fake driver. Must not be called while other
+// threads call into the driver.
+void SetFakeDriverLatencies(const FakeDriverLatencies& latencies);
+
+// An instance and a device created through a chain of layers ending in the
+// fake driver, together with the functions to look up the chain's functions,
+// i.e., the entry points of the first layer.
+struct LayerChain {
+  PFN_vkGetInstanceProcAddr get_instance_proc_addr = nullptr;
+  PFN_vkGetDeviceProcAddr get_device_proc_addr = nullptr;
+  VkInstance instance = VK_NULL_HANDLE;
+  VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+  VkDevice device = VK_NULL_HANDLE;
+  VkQueue queue = VK_NULL_HANDLE;
+};
+
+// Creates an instance and a device through the layer with the entry points
+// |get_instance_proc_addr| and |get_device_proc_addr|, followed by the fake
+// driver, as the loader would. Passing the fake driver's own entry points
+// creates them on the driver alone, to measure the layers against. Returns
+// false on failure.
+bool CreateLayerChain(PFN_vkGetInstanceProcAddr get_instance_proc_addr,
+                      PFN_vkGetDeviceProcAddr get_device_proc_addr,
+                      LayerChain* chain);
+
+// Destroys the device and the instance of |chain| through its layer.
+void DestroyLayerChain(LayerChain* chain);
+
+// The fake driver's entry points.
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    FakeDriver_GetInstanceProcAddr(VkInstance instance, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    FakeDriver_GetDeviceProcAddr(VkDevice device, const char* name);
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_FAKE_DRIVER_H_
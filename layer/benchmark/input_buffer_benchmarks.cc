@@ -0,0 +1,73 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "layer/support/input_buffer.h"
+
+namespace performancelayers {
+namespace {
+namespace fs = std::filesystem;
+
+// Writes a file of |size| bytes to the temporary directory and returns its
+// path.
+fs::path WriteTmpFile(const char* filename, size_t size) {
+  const fs::path path = fs::temp_directory_path() / filename;
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i != size; ++i) data[i] = static_cast<uint8_t>(i * 31);
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file) {
+    fwrite(data.data(), 1, data.size(), file);
+    fclose(file);
+  }
+  return path;
+}
+
+// Opens a pipeline cache file of |state.range(0)| bytes, as the pipeline cache
+// sideload layer does, and reads one byte of every page, so that the mapped
+// implementation pays for the pages it maps.
+void BM_InputBufferCreate(benchmark::State& state,
+                          InputBuffer::ImplementationKind implementation) {
+  const size_t size = state.range(0);
+  const fs::path path = WriteTmpFile("input_buffer_benchmarks.bin", size);
+  for (auto _ : state) {
+    auto buffer_or_error = InputBuffer::Create(path.string(), implementation);
+    if (!buffer_or_error.ok()) {
+      state.SkipWithError("Failed to create the input buffer");
+      break;
+    }
+    absl::Span<const uint8_t> buffer = buffer_or_error->GetBuffer();
+    uint8_t sum = 0;
+    for (size_t i = 0; i < buffer.size(); i += 4096) sum += buffer[i];
+    benchmark::DoNotOptimize(sum);
+  }
+  fs::remove(path);
+  state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK_CAPTURE(BM_InputBufferCreate, FileRead,
+                  InputBuffer::ImplementationKind::kFileRead)
+    ->RangeMultiplier(16)
+    ->Range(4 << 10, 16 << 20);
+BENCHMARK_CAPTURE(BM_InputBufferCreate, MemMapped,
+                  InputBuffer::ImplementationKind::kMemMapped)
+    ->RangeMultiplier(16)
+    ->Range(4 << 10, 16 << 20);
+
+}  // namespace
+}  // namespace performancelayers
@@ -0,0 +1,87 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "benchmark/benchmark.h"
+#include "layer/support/intercepted_function_table.h"
+
+namespace performancelayers {
+namespace {
+// Every Vulkan command declared by the Vulkan headers, generated by the build.
+// Resolving all of them is what the loader and many engines do at startup.
+constexpr const char* kVulkanFunctionNames[] = {
+#include "vulkan_function_names.inc"
+};
+constexpr size_t kNumVulkanFunctionNames =
+    sizeof(kVulkanFunctionNames) / sizeof(kVulkanFunctionNames[0]);
+
+// The functions intercepted by the memory usage layer, the layer intercepting
+// the most functions.
+constexpr std::string_view kInterceptedNames[] = {
+    "vkCreateDevice",           "vkDestroyInstance",
+    "vkCreateInstance",         "vkDestroyDevice",
+    "vkQueuePresentKHR",        "vkAllocateMemory",
+    "vkFreeMemory",             "vkCreateBuffer",
+    "vkDestroyBuffer",          "vkCreateImage",
+    "vkDestroyImage",           "vkBindBufferMemory",
+    "vkBindBufferMemory2",      "vkBindBufferMemory2KHR",
+    "vkBindImageMemory",        "vkBindImageMemory2",
+    "vkBindImageMemory2KHR",    "vkCreateShaderModule",
+    "vkDestroyShaderModule",    "vkCreatePipelineCache",
+    "vkDestroyPipelineCache",   "vkCreateGraphicsPipelines",
+    "vkCreateComputePipelines", "vkDestroyPipeline",
+    "vkCreateDescriptorPool",    "vkDestroyDescriptorPool",
+    "vkAllocateDescriptorSets",  "vkGetDeviceProcAddr",
+    "vkGetInstanceProcAddr"};
+constexpr InterceptedFunctionTable kInterceptedTable(kInterceptedNames);
+
+// Resolves every Vulkan command with the compile-time perfect hash table.
+void BM_ResolveAllWithPerfectHash(benchmark::State& state) {
+  for (auto _ : state) {
+    for (const char* name : kVulkanFunctionNames) {
+      benchmark::DoNotOptimize(kInterceptedTable.Find(name));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumVulkanFunctionNames);
+}
+BENCHMARK(BM_ResolveAllWithPerfectHash);
+
+// Resolves every Vulkan command with a hash map keyed by the layer and the
+// function name, the way intercepted functions used to be registered.
+void BM_ResolveAllWithHashMap(benchmark::State& state) {
+  constexpr std::string_view kLayerPrefix = "MemoryUsageLayer_";
+  absl::flat_hash_map<std::pair<std::string_view, std::string_view>, size_t>
+      map;
+  for (size_t i = 0; i != std::size(kInterceptedNames); ++i) {
+    map[{kLayerPrefix, kInterceptedNames[i]}] = i;
+  }
+
+  for (auto _ : state) {
+    for (const char* name : kVulkanFunctionNames) {
+      auto it = map.find({kLayerPrefix, name});
+      benchmark::DoNotOptimize(it == map.end() ? std::size(kInterceptedNames)
+                                               : it->second);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumVulkanFunctionNames);
+}
+BENCHMARK(BM_ResolveAllWithHashMap);
+
+}  // namespace
+}  // namespace performancelayers
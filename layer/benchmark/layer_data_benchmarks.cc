@@ -0,0 +1,129 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "benchmark/benchmark.h"
+#include "layer/support/layer_data.h"
+
+namespace performancelayers {
+namespace {
+// A dispatchable object as the loader creates it: its first word is the
+// dispatch key, a pointer unique to its device.
+struct FakeDispatchableObject {
+  void* dispatch_key;
+};
+
+int dispatch_key_storage[2];
+FakeDispatchableObject device_objects[2] = {{&dispatch_key_storage[0]},
+                                            {&dispatch_key_storage[1]}};
+// A command buffer of the first device, which shares the device's dispatch
+// key.
+FakeDispatchableObject command_buffer_object = {&dispatch_key_storage[0]};
+
+VkDevice FakeDevice(int index) {
+  return reinterpret_cast<VkDevice>(&device_objects[index]);
+}
+
+VkCommandBuffer FakeCommandBuffer() {
+  return reinterpret_cast<VkCommandBuffer>(&command_buffer_object);
+}
+
+VKAPI_ATTR void VKAPI_CALL FakeCmdDraw(VkCommandBuffer, uint32_t, uint32_t,
+                                       uint32_t, uint32_t) {}
+
+VkLayerDispatchTable MakeDispatchTable() {
+  VkLayerDispatchTable dispatch_table = {};
+  dispatch_table.CmdDraw = &FakeCmdDraw;
+  return dispatch_table;
+}
+
+LayerData* GetLayerData() {
+  static LayerData* layer_data = [] {
+    auto* layer_data = new LayerData("/dev/null", "");
+    layer_data->AddDevice(FakeDevice(0), MakeDispatchTable());
+    layer_data->AddDevice(FakeDevice(1), MakeDispatchTable());
+    return layer_data;
+  }();
+  return layer_data;
+}
+
+// Looks up a command buffer function, like a layer intercepting vkCmdDraw
+// does on every call. Hits the per-thread cache.
+void BM_GetNextDeviceProcAddr(benchmark::State& state) {
+  const LayerData* layer_data = GetLayerData();
+  VkCommandBuffer command_buffer = FakeCommandBuffer();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(layer_data->GetNextDeviceProcAddr(
+        command_buffer, &VkLayerDispatchTable::CmdDraw));
+  }
+}
+BENCHMARK(BM_GetNextDeviceProcAddr)->ThreadRange(1, 32);
+
+// Alternates between two devices, so that every lookup misses the cache and
+// takes the lock.
+void BM_GetNextDeviceProcAddrAlternatingDevices(benchmark::State& state) {
+  const LayerData* layer_data = GetLayerData();
+  int device_index = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(layer_data->GetNextDeviceProcAddr(
+        FakeDevice(device_index), &VkLayerDispatchTable::CmdDraw));
+    device_index ^= 1;
+  }
+}
+BENCHMARK(BM_GetNextDeviceProcAddrAlternatingDevices)->ThreadRange(1, 32);
+
+// The lookup without the cache: a hash map lookup under a mutex on every call.
+void BM_MutexHashMapLookup(benchmark::State& state) {
+  static absl::Mutex lock;
+  static const auto* dispatch_map = [] {
+    auto* dispatch_map =
+        new absl::flat_hash_map<DeviceKey, VkLayerDispatchTable>();
+    (*dispatch_map)[DeviceKey(FakeDevice(0))] = MakeDispatchTable();
+    (*dispatch_map)[DeviceKey(FakeDevice(1))] = MakeDispatchTable();
+    return dispatch_map;
+  }();
+
+  VkCommandBuffer command_buffer = FakeCommandBuffer();
+  for (auto _ : state) {
+    absl::MutexLock guard(&lock);
+    auto it = dispatch_map->find(DeviceKey(command_buffer));
+    benchmark::DoNotOptimize(it->second.CmdDraw);
+  }
+}
+BENCHMARK(BM_MutexHashMapLookup)->ThreadRange(1, 32);
+
+// Hashes |state.range(0)| bytes of SPIR-V, as every layer does for each shader
+// module created.
+void BM_HashShader(benchmark::State& state) {
+  LayerData* layer_data = GetLayerData();
+  const size_t size = state.range(0);
+  std::vector<uint32_t> code(size / sizeof(uint32_t));
+  for (size_t i = 0; i != code.size(); ++i) {
+    code[i] = static_cast<uint32_t>(i * 2654435761u);
+  }
+  VkShaderModule shader_module = reinterpret_cast<VkShaderModule>(uintptr_t{1});
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        layer_data->HashShader(shader_module, code.data(), size));
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_HashShader)->RangeMultiplier(4)->Range(1 << 10, 1 << 20);
+
+}  // namespace
+}  // namespace performancelayers
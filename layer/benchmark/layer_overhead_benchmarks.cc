@@ -0,0 +1,638 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// End-to-end benchmarks of the layers on top of the fake driver.
+//
+// Each workload runs through every layer, through the combined layer with all
+// modules enabled, and on the fake driver alone. The difference to the driver
+// alone is the overhead of the layer. Besides the time per iteration, every
+// benchmark reports:
+// - the Vulkan calls made per second (items_per_second),
+// - the average time per call (time_per_call),
+// - the average time per call added by the layer (overhead_per_call), against
+//   the last run of the same workload on the fake driver alone, if it ran,
+// - the lines the layers logged per second (log_lines), one per event and log
+//   file it is written to.
+//
+// The layers log to a pipe that counts the lines, and the pipeline cache
+// sideload layer reads an empty cache from /dev/null, unless their environment
+// variables are set. Layer diagnostics still go to stderr. The latencies of
+// the fake driver are zero unless set with the
+// --fake_driver_<kind>_ns=<nanoseconds> flags, see kLatencyFlags below.
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "benchmark/benchmark.h"
+#include "layer/benchmark/fake_driver.h"
+#include "layer/support/layer_utils.h"
+#include "vulkan/vulkan.h"
+
+namespace performancelayers {
+// The entry points of the layers.
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    FrameTimeLayer_GetInstanceProcAddr(VkInstance instance, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    FrameTimeLayer_GetDeviceProcAddr(VkDevice device, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    MemoryUsageLayer_GetInstanceProcAddr(VkInstance instance, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    MemoryUsageLayer_GetDeviceProcAddr(VkDevice device, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    CompileTimeLayer_GetInstanceProcAddr(VkInstance instance, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    CompileTimeLayer_GetDeviceProcAddr(VkDevice device, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    RuntimeLayer_GetInstanceProcAddr(VkInstance instance, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    RuntimeLayer_GetDeviceProcAddr(VkDevice device, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    CacheSideloadLayer_GetInstanceProcAddr(VkInstance instance,
+                                           const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    CacheSideloadLayer_GetDeviceProcAddr(VkDevice device, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    QueueSubmitLayer_GetInstanceProcAddr(VkInstance instance, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    QueueSubmitLayer_GetDeviceProcAddr(VkDevice device, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    SyncWaitLayer_GetInstanceProcAddr(VkInstance instance, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    SyncWaitLayer_GetDeviceProcAddr(VkDevice device, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    CommandRecordingLayer_GetInstanceProcAddr(VkInstance instance,
+                                              const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    CommandRecordingLayer_GetDeviceProcAddr(VkDevice device, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    DescriptorLayer_GetInstanceProcAddr(VkInstance instance, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    DescriptorLayer_GetDeviceProcAddr(VkDevice device, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    ResourceCreationLayer_GetInstanceProcAddr(VkInstance instance,
+                                              const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    ResourceCreationLayer_GetDeviceProcAddr(VkDevice device, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    CombinedLayer_GetInstanceProcAddr(VkInstance instance, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    CombinedLayer_GetDeviceProcAddr(VkDevice device, const char* name);
+
+namespace {
+struct BenchmarkedLayer {
+  const char* name;
+  PFN_vkGetInstanceProcAddr get_instance_proc_addr;
+  PFN_vkGetDeviceProcAddr get_device_proc_addr;
+};
+
+constexpr BenchmarkedLayer kLayers[] = {
+    {"fake_driver", &FakeDriver_GetInstanceProcAddr,
+     &FakeDriver_GetDeviceProcAddr},
+    {"frame_time", &FrameTimeLayer_GetInstanceProcAddr,
+     &FrameTimeLayer_GetDeviceProcAddr},
+    {"memory_usage", &MemoryUsageLayer_GetInstanceProcAddr,
+     &MemoryUsageLayer_GetDeviceProcAddr},
+    {"compile_time", &CompileTimeLayer_GetInstanceProcAddr,
+     &CompileTimeLayer_GetDeviceProcAddr},
+    {"runtime", &RuntimeLayer_GetInstanceProcAddr,
+     &RuntimeLayer_GetDeviceProcAddr},
+    {"queue_submit", &QueueSubmitLayer_GetInstanceProcAddr,
+     &QueueSubmitLayer_GetDeviceProcAddr},
+    {"sync_wait", &SyncWaitLayer_GetInstanceProcAddr,
+     &SyncWaitLayer_GetDeviceProcAddr},
+    {"command_recording", &CommandRecordingLayer_GetInstanceProcAddr,
+     &CommandRecordingLayer_GetDeviceProcAddr},
+    {"descriptor", &DescriptorLayer_GetInstanceProcAddr,
+     &DescriptorLayer_GetDeviceProcAddr},
+    {"resource_creation", &ResourceCreationLayer_GetInstanceProcAddr,
+     &ResourceCreationLayer_GetDeviceProcAddr},
+    {"cache_sideload", &CacheSideloadLayer_GetInstanceProcAddr,
+     &CacheSideloadLayer_GetDeviceProcAddr},
+    {"combined", &CombinedLayer_GetInstanceProcAddr,
+     &CombinedLayer_GetDeviceProcAddr},
+};
+
+// The environment variables naming the files the layers log to.
+constexpr const char* kLogEnvVars[] = {
+    "VK_FRAME_TIME_LOG",
+    "VK_MEMORY_USAGE_LOG",
+    "VK_COMPILE_TIME_LOG",
+    "VK_RUNTIME_LOG",
+    "VK_QUEUE_SUBMIT_LOG",
+    "VK_SYNC_WAIT_LOG",
+    "VK_COMMAND_RECORDING_LOG",
+    "VK_DESCRIPTOR_LOG",
+    "VK_RESOURCE_CREATION_LOG",
+    "VK_PERFORMANCE_LAYERS_EVENT_LOG_FILE",
+    "VK_PERFORMANCE_LAYERS_TRACE_EVENT_LOG_FILE",
+};
+
+// Counts the lines written to a named pipe, on a thread that reads it for the
+// rest of the process. The layers open the pipe like a regular log file.
+class LogLineCounter {
+ public:
+  // Creates the pipe at |path| and starts counting. Returns false on failure.
+  bool Start(const std::string& path) {
+    path_ = path;
+    unlink(path_.c_str());
+    if (mkfifo(path_.c_str(), 0600) != 0) return false;
+    // Opened for writing too, so that opening it doesn't wait for a writer
+    // and reading it doesn't end when the layers close it.
+    fd_ = open(path_.c_str(), O_RDWR);
+    if (fd_ < 0) return false;
+    std::thread([this] { Run(); }).detach();
+    return true;
+  }
+
+  // Removes the pipe. The layers keep their open ends.
+  void Stop() {
+    if (!path_.empty()) unlink(path_.c_str());
+  }
+
+  bool IsStarted() const { return fd_ >= 0; }
+
+  // Returns the lines counted so far, once the lines written are read.
+  int64_t GetLineCount() const {
+    int unread = 0;
+    while (ioctl(fd_, FIONREAD, &unread) == 0 && unread > 0) {
+      std::this_thread::yield();
+    }
+    // Let the reader count the last lines it read.
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return lines_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void Run() {
+    char buffer[1 << 16];
+    for (;;) {
+      const ssize_t size = read(fd_, buffer, sizeof(buffer));
+      if (size <= 0) return;
+      lines_.fetch_add(std::count(buffer, buffer + size, '\n'),
+                       std::memory_order_relaxed);
+    }
+  }
+
+  std::string path_;
+  int fd_ = -1;
+  std::atomic<int64_t> lines_ = 0;
+};
+
+LogLineCounter* GetLogLineCounter() {
+  static auto* counter = new LogLineCounter();
+  return counter;
+}
+
+struct LatencyFlag {
+  const char* name;
+  int64_t FakeDriverLatencies::*latency;
+};
+
+constexpr LatencyFlag kLatencyFlags[] = {
+    {"--fake_driver_pipeline_creation_ns=",
+     &FakeDriverLatencies::pipeline_creation_ns},
+    {"--fake_driver_shader_module_creation_ns=",
+     &FakeDriverLatencies::shader_module_creation_ns},
+    {"--fake_driver_memory_allocation_ns=",
+     &FakeDriverLatencies::memory_allocation_ns},
+    {"--fake_driver_resource_creation_ns=",
+     &FakeDriverLatencies::resource_creation_ns},
+    {"--fake_driver_command_recording_ns=",
+     &FakeDriverLatencies::command_recording_ns},
+    {"--fake_driver_queue_operation_ns=",
+     &FakeDriverLatencies::queue_operation_ns},
+};
+
+// Sets the latencies of the fake driver from the latency flags in |argv|, and
+// removes them. Returns false if a flag has an invalid value.
+bool ParseLatencyFlags(int* argc, char** argv) {
+  FakeDriverLatencies latencies;
+  int num_remaining = 1;
+  for (int i = 1; i != *argc; ++i) {
+    const LatencyFlag* matching_flag = nullptr;
+    for (const LatencyFlag& flag : kLatencyFlags) {
+      if (strncmp(argv[i], flag.name, strlen(flag.name)) == 0) {
+        matching_flag = &flag;
+      }
+    }
+    if (matching_flag == nullptr) {
+      argv[num_remaining++] = argv[i];
+      continue;
+    }
+    int64_t value = 0;
+    if (!absl::SimpleAtoi(argv[i] + strlen(matching_flag->name), &value) ||
+        value < 0) {
+      fprintf(stderr, "Invalid value: %s\n", argv[i]);
+      return false;
+    }
+    latencies.*(matching_flag->latency) = value;
+  }
+  *argc = num_remaining;
+  SetFakeDriverLatencies(latencies);
+  return true;
+}
+
+
+// The device functions used by the workloads, looked up through the layer
+// once, as applications and the loader do.
+struct DeviceFunctions {
+  explicit DeviceFunctions(const LayerChain& chain) {
+    auto get = [&chain](const char* name) {
+      PFN_vkVoidFunction function =
+          chain.get_device_proc_addr(chain.device, name);
+      assert(function && "Function not implemented by the fake driver");
+      return function;
+    };
+#define SPL_GET_DEVICE_FUNC(FUNC_NAME_) \
+  FUNC_NAME_ = reinterpret_cast<PFN_vk##FUNC_NAME_>(get("vk" #FUNC_NAME_))
+    SPL_GET_DEVICE_FUNC(AllocateCommandBuffers);
+    SPL_GET_DEVICE_FUNC(FreeCommandBuffers);
+    SPL_GET_DEVICE_FUNC(BeginCommandBuffer);
+    SPL_GET_DEVICE_FUNC(EndCommandBuffer);
+    SPL_GET_DEVICE_FUNC(CmdBindPipeline);
+    SPL_GET_DEVICE_FUNC(CmdDraw);
+    SPL_GET_DEVICE_FUNC(CmdDrawIndexed);
+    SPL_GET_DEVICE_FUNC(CmdDispatch);
+    SPL_GET_DEVICE_FUNC(QueueSubmit);
+    SPL_GET_DEVICE_FUNC(QueueWaitIdle);
+    SPL_GET_DEVICE_FUNC(QueuePresentKHR);
+    SPL_GET_DEVICE_FUNC(CreateShaderModule);
+    SPL_GET_DEVICE_FUNC(DestroyShaderModule);
+    SPL_GET_DEVICE_FUNC(CreateGraphicsPipelines);
+    SPL_GET_DEVICE_FUNC(CreateComputePipelines);
+    SPL_GET_DEVICE_FUNC(DestroyPipeline);
+    SPL_GET_DEVICE_FUNC(AllocateMemory);
+    SPL_GET_DEVICE_FUNC(FreeMemory);
+    SPL_GET_DEVICE_FUNC(CreateBuffer);
+    SPL_GET_DEVICE_FUNC(DestroyBuffer);
+    SPL_GET_DEVICE_FUNC(CreateImage);
+    SPL_GET_DEVICE_FUNC(DestroyImage);
+    SPL_GET_DEVICE_FUNC(GetBufferMemoryRequirements);
+    SPL_GET_DEVICE_FUNC(GetImageMemoryRequirements);
+    SPL_GET_DEVICE_FUNC(BindBufferMemory);
+    SPL_GET_DEVICE_FUNC(BindImageMemory);
+#undef SPL_GET_DEVICE_FUNC
+  }
+
+  PFN_vkAllocateCommandBuffers AllocateCommandBuffers;
+  PFN_vkFreeCommandBuffers FreeCommandBuffers;
+  PFN_vkBeginCommandBuffer BeginCommandBuffer;
+  PFN_vkEndCommandBuffer EndCommandBuffer;
+  PFN_vkCmdBindPipeline CmdBindPipeline;
+  PFN_vkCmdDraw CmdDraw;
+  PFN_vkCmdDrawIndexed CmdDrawIndexed;
+  PFN_vkCmdDispatch CmdDispatch;
+  PFN_vkQueueSubmit QueueSubmit;
+  PFN_vkQueueWaitIdle QueueWaitIdle;
+  PFN_vkQueuePresentKHR QueuePresentKHR;
+  PFN_vkCreateShaderModule CreateShaderModule;
+  PFN_vkDestroyShaderModule DestroyShaderModule;
+  PFN_vkCreateGraphicsPipelines CreateGraphicsPipelines;
+  PFN_vkCreateComputePipelines CreateComputePipelines;
+  PFN_vkDestroyPipeline DestroyPipeline;
+  PFN_vkAllocateMemory AllocateMemory;
+  PFN_vkFreeMemory FreeMemory;
+  PFN_vkCreateBuffer CreateBuffer;
+  PFN_vkDestroyBuffer DestroyBuffer;
+  PFN_vkCreateImage CreateImage;
+  PFN_vkDestroyImage DestroyImage;
+  PFN_vkGetBufferMemoryRequirements GetBufferMemoryRequirements;
+  PFN_vkGetImageMemoryRequirements GetImageMemoryRequirements;
+  PFN_vkBindBufferMemory BindBufferMemory;
+  PFN_vkBindImageMemory BindImageMemory;
+};
+
+// The code of the shader modules created by the workloads. The fake driver
+// doesn't read it, but the layers hash it.
+constexpr size_t kShaderCodeSize = 4096;
+const uint32_t* GetShaderCode() {
+  static const auto* code = [] {
+    auto* code = new std::vector<uint32_t>(kShaderCodeSize / sizeof(uint32_t));
+    for (size_t i = 0; i != code->size(); ++i) {
+      (*code)[i] = static_cast<uint32_t>(i * 2654435761u);
+    }
+    return code;
+  }();
+  return code->data();
+}
+
+VkShaderModule CreateShaderModule(const LayerChain& chain,
+                                  const DeviceFunctions& functions) {
+  VkShaderModuleCreateInfo create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  create_info.codeSize = kShaderCodeSize;
+  create_info.pCode = GetShaderCode();
+  VkShaderModule shader_module = VK_NULL_HANDLE;
+  functions.CreateShaderModule(chain.device, &create_info, nullptr,
+                               &shader_module);
+  return shader_module;
+}
+
+// Records, submits, and presents frames of many draws with a few pipeline
+// changes, then waits for the queue, like a draw-heavy game.
+int64_t RunDrawHeavyFrames(benchmark::State& state, const LayerChain& chain,
+                        const DeviceFunctions& functions) {
+  constexpr int kDrawsPerFrame = 500;
+  constexpr int kDrawsPerPipeline = 50;
+
+  VkShaderModule shader_modules[2] = {CreateShaderModule(chain, functions),
+                                      CreateShaderModule(chain, functions)};
+  VkPipelineShaderStageCreateInfo stages[2] = {};
+  stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  stages[0].module = shader_modules[0];
+  stages[0].pName = "main";
+  stages[1] = stages[0];
+  stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  stages[1].module = shader_modules[1];
+  VkGraphicsPipelineCreateInfo pipeline_create_info = {};
+  pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipeline_create_info.stageCount = 2;
+  pipeline_create_info.pStages = stages;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  functions.CreateGraphicsPipelines(chain.device, VK_NULL_HANDLE, 1,
+                                    &pipeline_create_info, nullptr, &pipeline);
+
+  VkCommandBufferAllocateInfo allocate_info = {};
+  allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocate_info.commandBufferCount = 1;
+  VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+  functions.AllocateCommandBuffers(chain.device, &allocate_info,
+                                   &command_buffer);
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  VkSubmitInfo submit_info = {};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &command_buffer;
+  VkPresentInfoKHR present_info = {};
+  present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+  for (auto _ : state) {
+    functions.BeginCommandBuffer(command_buffer, &begin_info);
+    for (int i = 0; i != kDrawsPerFrame; ++i) {
+      if (i % kDrawsPerPipeline == 0) {
+        functions.CmdBindPipeline(command_buffer,
+                                  VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+      }
+      if (i % 2 == 0) {
+        functions.CmdDraw(command_buffer, 3, 1, 0, 0);
+      } else {
+        functions.CmdDrawIndexed(command_buffer, 3, 1, 0, 0, 0);
+      }
+    }
+    functions.EndCommandBuffer(command_buffer);
+    functions.QueueSubmit(chain.queue, 1, &submit_info, VK_NULL_HANDLE);
+    functions.QueueWaitIdle(chain.queue);
+    functions.QueuePresentKHR(chain.queue, &present_info);
+  }
+
+  functions.FreeCommandBuffers(chain.device, VK_NULL_HANDLE, 1,
+                               &command_buffer);
+  functions.DestroyPipeline(chain.device, pipeline, nullptr);
+  for (VkShaderModule shader_module : shader_modules) {
+    functions.DestroyShaderModule(chain.device, shader_module, nullptr);
+  }
+  return kDrawsPerFrame + kDrawsPerFrame / kDrawsPerPipeline + 5;
+}
+
+// Creates and destroys batches of graphics and compute pipelines with fresh
+// shader modules, like a game compiling its pipelines at a loading screen.
+int64_t RunPipelineFlood(benchmark::State& state, const LayerChain& chain,
+                      const DeviceFunctions& functions) {
+  constexpr uint32_t kPipelinesPerBatch = 16;
+
+  for (auto _ : state) {
+    VkShaderModule shader_modules[2] = {CreateShaderModule(chain, functions),
+                                        CreateShaderModule(chain, functions)};
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = shader_modules[0];
+    stages[0].pName = "main";
+    stages[1] = stages[0];
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = shader_modules[1];
+
+    VkGraphicsPipelineCreateInfo graphics_create_infos[kPipelinesPerBatch] =
+        {};
+    VkComputePipelineCreateInfo compute_create_infos[kPipelinesPerBatch] = {};
+    for (uint32_t i = 0; i != kPipelinesPerBatch; ++i) {
+      graphics_create_infos[i].sType =
+          VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+      graphics_create_infos[i].stageCount = 2;
+      graphics_create_infos[i].pStages = stages;
+      compute_create_infos[i].sType =
+          VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+      compute_create_infos[i].stage = stages[0];
+      compute_create_infos[i].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkPipeline pipelines[2 * kPipelinesPerBatch] = {};
+    functions.CreateGraphicsPipelines(chain.device, VK_NULL_HANDLE,
+                                      kPipelinesPerBatch, graphics_create_infos,
+                                      nullptr, pipelines);
+    functions.CreateComputePipelines(
+        chain.device, VK_NULL_HANDLE, kPipelinesPerBatch, compute_create_infos,
+        nullptr, pipelines + kPipelinesPerBatch);
+
+    for (VkPipeline pipeline : pipelines) {
+      functions.DestroyPipeline(chain.device, pipeline, nullptr);
+    }
+    for (VkShaderModule shader_module : shader_modules) {
+      functions.DestroyShaderModule(chain.device, shader_module, nullptr);
+    }
+  }
+  return 2 + 2 + 2 * kPipelinesPerBatch + 2;
+}
+
+// Creates, binds, and destroys buffers and images with dedicated allocations,
+// presenting once per round, like a streaming system churning through
+// transient resources.
+int64_t RunAllocationChurn(benchmark::State& state, const LayerChain& chain,
+                        const DeviceFunctions& functions) {
+  constexpr int kResourcesPerFrame = 16;
+
+  VkBufferCreateInfo buffer_create_info = {};
+  buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_create_info.size = 64 * 1024;
+  buffer_create_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  VkImageCreateInfo image_create_info = {};
+  image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_create_info.imageType = VK_IMAGE_TYPE_2D;
+  image_create_info.extent = {128, 128, 1};
+  VkPresentInfoKHR present_info = {};
+  present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+  auto allocate = [&chain, &functions](const VkMemoryRequirements& reqs) {
+    VkMemoryAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocate_info.allocationSize = reqs.size;
+    allocate_info.memoryTypeIndex = 0;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    functions.AllocateMemory(chain.device, &allocate_info, nullptr, &memory);
+    return memory;
+  };
+
+  for (auto _ : state) {
+    for (int i = 0; i != kResourcesPerFrame; ++i) {
+      VkBuffer buffer = VK_NULL_HANDLE;
+      functions.CreateBuffer(chain.device, &buffer_create_info, nullptr,
+                             &buffer);
+      VkMemoryRequirements requirements = {};
+      functions.GetBufferMemoryRequirements(chain.device, buffer,
+                                            &requirements);
+      VkDeviceMemory buffer_memory = allocate(requirements);
+      functions.BindBufferMemory(chain.device, buffer, buffer_memory, 0);
+
+      VkImage image = VK_NULL_HANDLE;
+      functions.CreateImage(chain.device, &image_create_info, nullptr, &image);
+      functions.GetImageMemoryRequirements(chain.device, image, &requirements);
+      VkDeviceMemory image_memory = allocate(requirements);
+      functions.BindImageMemory(chain.device, image, image_memory, 0);
+
+      functions.DestroyBuffer(chain.device, buffer, nullptr);
+      functions.FreeMemory(chain.device, buffer_memory, nullptr);
+      functions.DestroyImage(chain.device, image, nullptr);
+      functions.FreeMemory(chain.device, image_memory, nullptr);
+    }
+    functions.QueuePresentKHR(chain.queue, &present_info);
+  }
+  return 12 * kResourcesPerFrame + 1;
+}
+
+// Runs the timed loop of a workload on |chain|, and returns the number of
+// Vulkan calls of an iteration.
+using Workload = int64_t (*)(benchmark::State&, const LayerChain&,
+                             const DeviceFunctions&);
+
+struct NamedWorkload {
+  const char* name;
+  Workload workload;
+  // The time per call of the last run on the fake driver alone, 0 until then.
+  // The benchmarks run one at a time.
+  double baseline_ns_per_call = 0;
+};
+
+// Runs |workload| on a chain through |layer|. The chain is created outside of
+// the timed loop. The time per call for the overhead is measured around the
+// workload, which also creates the few objects the loop uses.
+void BM_Workload(benchmark::State& state, const BenchmarkedLayer& layer,
+                 NamedWorkload* workload) {
+  LayerChain chain;
+  if (!CreateLayerChain(layer.get_instance_proc_addr,
+                        layer.get_device_proc_addr, &chain)) {
+    state.SkipWithError("Failed to create the layer chain");
+    return;
+  }
+  const LogLineCounter& log_lines = *GetLogLineCounter();
+  const int64_t start_lines =
+      log_lines.IsStarted() ? log_lines.GetLineCount() : 0;
+  int64_t num_calls = 0;
+  const auto start = std::chrono::steady_clock::now();
+  {
+    const DeviceFunctions functions(chain);
+    num_calls = workload->workload(state, chain, functions);
+  }
+  const std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  if (log_lines.IsStarted()) {
+    state.counters["log_lines"] =
+        benchmark::Counter(static_cast<double>(log_lines.GetLineCount() -
+                                               start_lines),
+                           benchmark::Counter::kIsRate);
+  }
+  DestroyLayerChain(&chain);
+
+  const int64_t total_calls = state.iterations() * num_calls;
+  state.SetItemsProcessed(total_calls);
+  state.counters["time_per_call"] = benchmark::Counter(
+      num_calls, benchmark::Counter::kIsIterationInvariantRate |
+                     benchmark::Counter::kInvert);
+  if (total_calls == 0) return;
+  const double ns_per_call = elapsed.count() / static_cast<double>(total_calls);
+  if (layer.get_instance_proc_addr == &FakeDriver_GetInstanceProcAddr) {
+    workload->baseline_ns_per_call = ns_per_call;
+  } else if (workload->baseline_ns_per_call != 0) {
+    // In seconds, as the time_per_call counter.
+    state.counters["overhead_per_call"] =
+        (ns_per_call - workload->baseline_ns_per_call) * 1e-9;
+  }
+}
+
+void RegisterBenchmarks() {
+  static NamedWorkload workloads[] = {
+      {"BM_DrawHeavyFrame", &RunDrawHeavyFrames},
+      {"BM_PipelineFlood", &RunPipelineFlood},
+      {"BM_AllocationChurn", &RunAllocationChurn},
+  };
+  for (NamedWorkload& workload : workloads) {
+    for (const BenchmarkedLayer& layer : kLayers) {
+      const std::string name = std::string(workload.name) + "/" + layer.name;
+      // In real time, which the overhead is measured in, as the layers and
+      // their logs may block.
+      benchmark::RegisterBenchmark(name.c_str(), &BM_Workload, layer,
+                                   &workload)
+          ->UseRealTime();
+    }
+  }
+}
+
+}  // namespace
+}  // namespace performancelayers
+
+int main(int argc, char** argv) {
+  // Keep the logs of the layers out of the benchmark output, unless asked for,
+  // and count their lines.
+  performancelayers::LogLineCounter* log_lines =
+      performancelayers::GetLogLineCounter();
+  const std::string log_path =
+      (std::filesystem::temp_directory_path() /
+       ("layer_overhead_benchmarks_" + std::to_string(getpid()) + ".log"))
+          .string();
+  if (!log_lines->Start(log_path)) {
+    fprintf(stderr, "Failed to create %s, not counting the log lines\n",
+            log_path.c_str());
+  }
+  for (const char* env_var : performancelayers::kLogEnvVars) {
+    setenv(env_var, log_lines->IsStarted() ? log_path.c_str() : "/dev/null",
+           /*overwrite=*/0);
+  }
+  setenv("VK_PIPELINE_CACHE_SIDELOAD_FILE", "/dev/null", /*overwrite=*/0);
+  if (!performancelayers::ParseLatencyFlags(&argc, argv)) return 1;
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  performancelayers::RegisterBenchmarks();
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  log_lines->Stop();
+  return 0;
+}
@@ -0,0 +1,96 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "benchmark/benchmark.h"
+#include "layer/support/log_output.h"
+
+namespace performancelayers {
+namespace {
+namespace fs = std::filesystem;
+
+// A CSV line as long as the compile time layer's.
+constexpr std::string_view kLogLine =
+    "create_graphics_pipelines,\"[0x1234567890abcdef,0x0fedcba987654321]\","
+    "1234567";
+
+// Logs lines to a regular file, under each flush mode of `FileOutput`. When it
+// flushes every line, each line is a write to the file; otherwise the lines
+// are written when the buffer of the file fills up.
+void BM_FileOutputLogLineToFile(benchmark::State& state) {
+  const bool flush_every_line = state.range(0) != 0;
+  const fs::path path =
+      fs::temp_directory_path() / "log_output_benchmarks.log";
+  fs::remove(path);
+  {
+    FileOutput output(path.c_str(), flush_every_line);
+    int64_t num_lines = 0;
+    for (auto _ : state) {
+      output.LogLine(kLogLine);
+      // Keep the file small.
+      if (++num_lines % (1 << 16) == 0) {
+        state.PauseTiming();
+        output.Flush();
+        fs::resize_file(path, 0);
+        state.ResumeTiming();
+      }
+    }
+  }
+  fs::remove(path);
+  state.SetBytesProcessed(state.iterations() * (kLogLine.size() + 1));
+}
+BENCHMARK(BM_FileOutputLogLineToFile)
+    ->ArgName("flush_every_line")
+    ->Arg(1)
+    ->Arg(0);
+
+// Logs lines to /dev/null, under each flush mode of `FileOutput`, which
+// measures the write and flush calls without the cost of the file system.
+void BM_FileOutputLogLineToDevNull(benchmark::State& state) {
+  const bool flush_every_line = state.range(0) != 0;
+  FileOutput output("/dev/null", flush_every_line);
+  for (auto _ : state) {
+    output.LogLine(kLogLine);
+  }
+  state.SetBytesProcessed(state.iterations() * (kLogLine.size() + 1));
+}
+BENCHMARK(BM_FileOutputLogLineToDevNull)
+    ->ArgName("flush_every_line")
+    ->Arg(1)
+    ->Arg(0);
+
+// Logs lines to memory, the baseline without any flushing.
+void BM_StringOutputLogLine(benchmark::State& state) {
+  auto output = std::make_unique<StringOutput>();
+  int64_t num_lines = 0;
+  for (auto _ : state) {
+    output->LogLine(kLogLine);
+    // Keep the log small.
+    if (++num_lines % (1 << 16) == 0) {
+      state.PauseTiming();
+      output = std::make_unique<StringOutput>();
+      state.ResumeTiming();
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * (kLogLine.size() + 1));
+}
+BENCHMARK(BM_StringOutputLogLine);
+
+}  // namespace
+}  // namespace performancelayers
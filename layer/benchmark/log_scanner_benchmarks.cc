@@ -0,0 +1,64 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "layer/support/log_scanner.h"
+
+namespace performancelayers {
+namespace {
+namespace fs = std::filesystem;
+
+// Scans an application log of |state.range(0)| lines for a benchmark start
+// string, as the frame time layer does. The string appears on the last line
+// only, so every line is compared against both patterns.
+void BM_LogScannerConsumeNewLines(benchmark::State& state) {
+  const int64_t num_lines = state.range(0);
+  const fs::path path =
+      fs::temp_directory_path() / "log_scanner_benchmarks.log";
+  int64_t num_bytes = 0;
+  {
+    std::ofstream file(path);
+    for (int64_t i = 0; i + 1 < num_lines; ++i) {
+      const std::string line =
+          "[INFO] Loading asset " + std::to_string(i) + " of the level";
+      file << line << '\n';
+      num_bytes += line.size() + 1;
+    }
+    file << "BENCHMARK_START\n";
+  }
+
+  for (auto _ : state) {
+    std::optional<LogScanner> scanner = LogScanner::FromFilename(path);
+    if (!scanner) {
+      state.SkipWithError("Failed to open the log");
+      break;
+    }
+    scanner->RegisterWatchedPattern("BENCHMARK_START");
+    scanner->RegisterWatchedPattern("BENCHMARK_END");
+    benchmark::DoNotOptimize(scanner->ConsumeNewLines());
+  }
+  fs::remove(path);
+  state.SetItemsProcessed(state.iterations() * num_lines);
+  state.SetBytesProcessed(state.iterations() * num_bytes);
+}
+BENCHMARK(BM_LogScannerConsumeNewLines)->RangeMultiplier(8)->Range(8, 32 << 10);
+
+}  // namespace
+}  // namespace performancelayers
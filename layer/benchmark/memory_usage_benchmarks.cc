@@ -0,0 +1,134 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "layer/memory_usage/memory_usage_layer_data.h"
+
+namespace performancelayers {
+namespace {
+// Number of allocations each thread keeps alive while it allocates and frees.
+constexpr uint64_t kLiveAllocationsPerThread = 1024;
+// Every |kAllocationsPerFrame| allocations, a thread reads the current and peak
+// allocation size, like the layer does on each vkQueuePresentKHR.
+constexpr uint64_t kAllocationsPerFrame = 16;
+// The record of every allocation made by the benchmarks.
+const AllocationRecord kAllocation = [] {
+  AllocationRecord record;
+  record.size = 4096;
+  return record;
+}();
+
+// A physical device with a single memory type in a single heap.
+const VkPhysicalDeviceMemoryProperties kMemoryProperties = [] {
+  VkPhysicalDeviceMemoryProperties properties = {};
+  properties.memoryTypeCount = 1;
+  properties.memoryHeapCount = 1;
+  properties.memoryHeaps[0].size = VkDeviceSize{1} << 34;
+  return properties;
+}();
+
+MemoryAllocationTracker* tracker = nullptr;
+std::vector<VkDevice> devices;
+
+VkDevice FakeDevice(uint64_t index) {
+  return reinterpret_cast<VkDevice>(static_cast<uintptr_t>(index + 1) << 12);
+}
+
+VkDeviceMemory FakeMemory(uint64_t thread_index, uint64_t index) {
+  return reinterpret_cast<VkDeviceMemory>(
+      static_cast<uintptr_t>((thread_index << 40) | (index + 1)));
+}
+
+// Concurrent allocate/free/present stress test. Each thread allocates and frees
+// memory on the device `thread_index % state.range(0)`, keeping a fixed number
+// of allocations alive, and periodically reads the allocation counters.
+void BM_AllocateFreePresent(benchmark::State& state) {
+  const auto num_devices = static_cast<uint64_t>(state.range(0));
+  if (state.thread_index() == 0) {
+    tracker = new MemoryAllocationTracker();
+    devices.clear();
+    for (uint64_t i = 0; i != num_devices; ++i) {
+      devices.push_back(FakeDevice(i));
+      tracker->AddDevice(devices.back(), kMemoryProperties);
+    }
+  }
+
+  const auto thread_index = static_cast<uint64_t>(state.thread_index());
+  uint64_t allocation_index = 0;
+  for (auto _ : state) {
+    VkDevice device = devices[thread_index % num_devices];
+    tracker->RecordAllocateMemory(
+        device, FakeMemory(thread_index, allocation_index), kAllocation);
+    if (allocation_index >= kLiveAllocationsPerThread) {
+      tracker->RecordFreeMemory(
+          device, FakeMemory(thread_index,
+                             allocation_index - kLiveAllocationsPerThread));
+    }
+    if (allocation_index % kAllocationsPerFrame == 0) {
+      benchmark::DoNotOptimize(tracker->GetCurrentAllocationSize());
+      benchmark::DoNotOptimize(tracker->GetPeakAllocationSize());
+    }
+    ++allocation_index;
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  if (state.thread_index() == 0) {
+    for (VkDevice device : devices) tracker->RemoveDevice(device);
+    delete tracker;
+    tracker = nullptr;
+  }
+}
+BENCHMARK(BM_AllocateFreePresent)
+    ->Arg(1)
+    ->Arg(4)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+// Measures the cost of reading the counters on present while other threads
+// keep allocating and freeing memory.
+void BM_PresentUnderAllocationLoad(benchmark::State& state) {
+  if (state.thread_index() == 0) {
+    tracker = new MemoryAllocationTracker();
+    devices = {FakeDevice(0)};
+    tracker->AddDevice(devices[0], kMemoryProperties);
+  }
+
+  const auto thread_index = static_cast<uint64_t>(state.thread_index());
+  uint64_t allocation_index = 0;
+  for (auto _ : state) {
+    if (thread_index == 0) {
+      benchmark::DoNotOptimize(tracker->GetCurrentAllocationSize());
+      benchmark::DoNotOptimize(tracker->GetPeakAllocationSize());
+      continue;
+    }
+    tracker->RecordAllocateMemory(
+        devices[0], FakeMemory(thread_index, allocation_index), kAllocation);
+    tracker->RecordFreeMemory(devices[0],
+                              FakeMemory(thread_index, allocation_index));
+    ++allocation_index;
+  }
+
+  if (state.thread_index() == 0) {
+    tracker->RemoveDevice(devices[0]);
+    delete tracker;
+    tracker = nullptr;
+  }
+}
+BENCHMARK(BM_PresentUnderAllocationLoad)->ThreadRange(2, 16)->UseRealTime();
+
+}  // namespace
+}  // namespace performancelayers
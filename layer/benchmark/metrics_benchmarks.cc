@@ -0,0 +1,81 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "layer/support/metrics.h"
+
+namespace performancelayers {
+namespace {
+// Increments a counter shared by all the benchmark threads, as the layers do
+// from the application's threads.
+void BM_CounterAdd(benchmark::State& state) {
+  static MetricsRegistry registry;
+  Counter counter = registry.GetCounter("benchmark_total");
+  for (auto _ : state) {
+    counter.Add();
+  }
+}
+BENCHMARK(BM_CounterAdd)->ThreadRange(1, 8);
+
+void BM_HistogramRecord(benchmark::State& state) {
+  static MetricsRegistry registry;
+  Histogram histogram = registry.GetHistogram("benchmark_us");
+  int64_t value = 0;
+  for (auto _ : state) {
+    histogram.Record(value);
+    value = (value + 7919) & 0xfffff;
+  }
+}
+BENCHMARK(BM_HistogramRecord)->ThreadRange(1, 8);
+
+// Collects and publishes a full registry of histograms, the work the exporter
+// does every period.
+void BM_CollectAndPublish(benchmark::State& state) {
+  MetricsRegistry registry;
+  for (size_t i = 0; i != kMaxMetrics; ++i)
+    registry.GetHistogram(absl::StrCat("benchmark_", i, "_us")).Record(i);
+  auto page = std::make_unique<MetricsPage>();
+  for (auto _ : state) {
+    PublishMetrics(registry.Collect(), /*pid=*/1, /*publish_time_ns=*/0,
+                   page.get());
+  }
+}
+BENCHMARK(BM_CollectAndPublish);
+
+// Formats a full registry of histograms in the Prometheus text format, the
+// work of serving one request on the metrics socket.
+void BM_FormatPrometheusText(benchmark::State& state) {
+  MetricsRegistry registry;
+  for (size_t i = 0; i != kMaxMetrics; ++i) {
+    Histogram histogram =
+        registry.GetHistogram(absl::StrCat("benchmark_", i, "_us"));
+    for (int64_t value = 1; value < (1 << 20); value *= 2)
+      histogram.Record(value);
+  }
+  const std::vector<MetricValues> metrics = registry.Collect();
+  for (auto _ : state) {
+    std::string text = FormatPrometheusText(metrics);
+    benchmark::DoNotOptimize(text);
+  }
+}
+BENCHMARK(BM_FormatPrometheusText);
+
+}  // namespace
+}  // namespace performancelayers
@@ -23,6 +23,7 @@
 #include "layer/support/debug_logging.h"
 #include "layer/support/event_logging.h"
 #include "layer/support/input_buffer.h"
+#include "layer/support/layer_config.h"
 #include "layer/support/layer_data.h"
 #include "layer/support/layer_utils.h"
 
@@ -72,6 +73,8 @@ class CacheSideloadLayerData : public LayerData {
         implicit_pipeline_cache_path_(pipeline_cache_path) {
     LayerInitEvent event("cache_sideload_layer_init", "cache_sideload_layer");
     LogEvent(&event);
+    // The sideloading is not instrumentation, so only the log level applies.
+    StartControl("cache_sideload");
   }
 
   VkPipelineCache GetImplicitDeviceCache(VkDevice) const;
@@ -212,14 +215,13 @@ constexpr uint32_t kCacheSideloadLayerVersion = 1;
 
 constexpr char kLayerName[] = "VK_LAYER_STADIA_pipeline_cache_sideload";
 constexpr char kLayerDescription[] = "Stadia Pipeline Cache Sideloading Layer";
-constexpr char kImplicitCacheFilenameEnvVar[] =
-    "VK_PIPELINE_CACHE_SIDELOAD_FILE";
 
 performancelayers::CacheSideloadLayerData* GetLayerData() {
   // Don't use new -- make the destructor run when the layer gets unloaded.
   static performancelayers::CacheSideloadLayerData layer_data =
       performancelayers::CacheSideloadLayerData(
-          getenv(kImplicitCacheFilenameEnvVar));
+          performancelayers::NullIfEmpty(
+              performancelayers::GetLayerConfig().cache_sideload.file));
   return &layer_data;
 }
 
@@ -228,6 +230,26 @@ performancelayers::CacheSideloadLayerData* GetLayerData() {
   SPL_INTERCEPTED_VULKAN_FUNC(RETURN_TYPE_, CacheSideloadLayer_, FUNC_NAME_, \
                               FUNC_ARGS_)
 
+// The functions intercepted by the layer, defined below with
+// SPL_CACHE_SIDELOAD_LAYER_FUNC.
+#define SPL_CACHE_SIDELOAD_LAYER_FUNCS(X_, LAYER_PREFIX_) \
+  X_(LAYER_PREFIX_, DestroyInstance)                      \
+  X_(LAYER_PREFIX_, CreateInstance)                       \
+  X_(LAYER_PREFIX_, CreateComputePipelines)               \
+  X_(LAYER_PREFIX_, CreateGraphicsPipelines)              \
+  X_(LAYER_PREFIX_, CreatePipelineCache)                  \
+  X_(LAYER_PREFIX_, GetPipelineCacheData)                 \
+  X_(LAYER_PREFIX_, DestroyPipelineCache)                 \
+  X_(LAYER_PREFIX_, DestroyDevice)                        \
+  X_(LAYER_PREFIX_, CreateDevice)                         \
+  X_(LAYER_PREFIX_, EnumerateInstanceLayerProperties)     \
+  X_(LAYER_PREFIX_, EnumerateDeviceLayerProperties)       \
+  X_(LAYER_PREFIX_, GetDeviceProcAddr)                    \
+  X_(LAYER_PREFIX_, GetInstanceProcAddr)
+
+SPL_DECLARE_INTERCEPTED_FUNCTIONS(CacheSideloadLayer_,
+                                  SPL_CACHE_SIDELOAD_LAYER_FUNCS);
+
 //////////////////////////////////////////////////////////////////////////////
 //  Implementation of the instance functions we want to override.
 //////////////////////////////////////////////////////////////////////////////
@@ -494,6 +516,9 @@ SPL_CACHE_SIDELOAD_LAYER_FUNC(VkResult, EnumerateDeviceLayerProperties,
 
 }  // namespace
 
+SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE(CacheSideloadLayer_,
+                                      SPL_CACHE_SIDELOAD_LAYER_FUNCS);
+
 // The *GetProcAddr functions are the entry points to the layers.
 // They return a function pointer for the instance requested by |name|.
 // We return the functions defined in this layer for those we want to override.
@@ -504,26 +529,32 @@ SPL_LAYER_ENTRY_POINT SPL_CACHE_SIDELOAD_LAYER_FUNC(PFN_vkVoidFunction,
                                                     GetDeviceProcAddr,
                                                     (VkDevice device,
                                                      const char* name)) {
-  if (auto func =
-          performancelayers::FunctionInterceptor::GetInterceptedOrNull(name)) {
-    return func;
-  }
-
   performancelayers::CacheSideloadLayerData* layer_data = GetLayerData();
 
   PFN_vkGetDeviceProcAddr next_get_proc_addr =
       layer_data->GetNextDeviceProcAddr(
           device, &VkLayerDispatchTable::GetDeviceProcAddr);
   assert(next_get_proc_addr);
-  return next_get_proc_addr(device, name);
+  // The functions of the features and extensions that the device didn't
+  // enable are null down the chain, and must stay null.
+  PFN_vkVoidFunction next_func = next_get_proc_addr(device, name);
+  if (!next_func) return nullptr;
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(CacheSideloadLayer_, name)) {
+    return func;
+  }
+  return next_func;
 }
 
 SPL_LAYER_ENTRY_POINT SPL_CACHE_SIDELOAD_LAYER_FUNC(PFN_vkVoidFunction,
                                                     GetInstanceProcAddr,
                                                     (VkInstance instance,
                                                      const char* name)) {
-  if (auto func =
-          performancelayers::FunctionInterceptor::GetInterceptedOrNull(name)) {
+  // The loader looks up the layer's functions here first, before calling any
+  // of them.
+  if (performancelayers::IsLayerOverheadProfilingEnabled()) {
+    GetLayerData()->SetOverheadProfiler(&CacheSideloadLayer_kOverheadProfiler);
+  }
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(CacheSideloadLayer_, name)) {
     return func;
   }
 
@@ -0,0 +1,498 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A single layer hosting all performance layers as modules.
+//
+// Each module is one of the individual layers, linked into this library
+// unchanged. The loader only sees this layer, whose layer data holds the one
+// dispatch table of the layer below it, shared by all modules.
+//
+// Function lookups are resolved in-process, by walking the intercepted
+// function tables of the enabled modules in chaining order: a lookup made by
+// the application, or by a module for its next layer, returns the function of
+// the next enabled module intercepting it, or else the function of the layer
+// below from the shared dispatch table. A call thus fans out directly from one
+// intercepting module to the next, and functions that no enabled module
+// intercepts skip the layer entirely. The modules' own lookups of unknown
+// functions go through the same resolution, never down the chain of another
+// module.
+//
+// Instances and devices are created through the enabled modules, each of them
+// linked to the next one. The last module creates them through this layer,
+// which adds the shared dispatch tables.
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "layer/support/debug_logging.h"
+#include "layer/support/layer_config.h"
+#include "layer/support/layer_data.h"
+#include "layer/support/layer_overhead_profiler.h"
+#include "layer/support/layer_utils.h"
+
+// The runtime layer is defined outside of namespace performancelayers.
+PFN_vkVoidFunction RuntimeLayer_GetInterceptedProcAddr(const char* name);
+
+namespace performancelayers {
+// The entry points of the modules, defined by the individual layers with
+// SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE.
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    FrameTimeLayer_GetInstanceProcAddr(VkInstance instance, const char* name);
+PFN_vkVoidFunction FrameTimeLayer_GetInterceptedProcAddr(const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    MemoryUsageLayer_GetInstanceProcAddr(VkInstance instance, const char* name);
+PFN_vkVoidFunction MemoryUsageLayer_GetInterceptedProcAddr(const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    CompileTimeLayer_GetInstanceProcAddr(VkInstance instance, const char* name);
+PFN_vkVoidFunction CompileTimeLayer_GetInterceptedProcAddr(const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    RuntimeLayer_GetInstanceProcAddr(VkInstance instance, const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    CacheSideloadLayer_GetInstanceProcAddr(VkInstance instance,
+                                           const char* name);
+PFN_vkVoidFunction CacheSideloadLayer_GetInterceptedProcAddr(const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    QueueSubmitLayer_GetInstanceProcAddr(VkInstance instance, const char* name);
+PFN_vkVoidFunction QueueSubmitLayer_GetInterceptedProcAddr(const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    SyncWaitLayer_GetInstanceProcAddr(VkInstance instance, const char* name);
+PFN_vkVoidFunction SyncWaitLayer_GetInterceptedProcAddr(const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    CommandRecordingLayer_GetInstanceProcAddr(VkInstance instance,
+                                              const char* name);
+PFN_vkVoidFunction CommandRecordingLayer_GetInterceptedProcAddr(
+    const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    DescriptorLayer_GetInstanceProcAddr(VkInstance instance, const char* name);
+PFN_vkVoidFunction DescriptorLayer_GetInterceptedProcAddr(const char* name);
+SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+    ResourceCreationLayer_GetInstanceProcAddr(VkInstance instance,
+                                              const char* name);
+PFN_vkVoidFunction ResourceCreationLayer_GetInterceptedProcAddr(
+    const char* name);
+
+namespace {
+// ----------------------------------------------------------------------------
+// Layer book-keeping information
+// ----------------------------------------------------------------------------
+
+constexpr uint32_t kCombinedLayerVersion = 1;
+constexpr char kLayerName[] = "VK_LAYER_STADIA_performance";
+constexpr char kLayerDescription[] = "Stadia Performance Layers";
+
+struct LayerModule {
+  const char* name;
+  PFN_vkGetInstanceProcAddr get_instance_proc_addr;
+  // Returns the module's function intercepting |name|, or nullptr.
+  PFN_vkVoidFunction (*get_intercepted_proc_addr)(const char* name);
+};
+
+// All modules, in the order they are chained. The pipeline cache sideload
+// module comes last, so that the other modules see the pipeline creations the
+// driver actually performs.
+constexpr LayerModule kModules[] = {
+    {"frame_time", &FrameTimeLayer_GetInstanceProcAddr,
+     &FrameTimeLayer_GetInterceptedProcAddr},
+    {"memory_usage", &MemoryUsageLayer_GetInstanceProcAddr,
+     &MemoryUsageLayer_GetInterceptedProcAddr},
+    {"compile_time", &CompileTimeLayer_GetInstanceProcAddr,
+     &CompileTimeLayer_GetInterceptedProcAddr},
+    {"runtime", &RuntimeLayer_GetInstanceProcAddr,
+     &::RuntimeLayer_GetInterceptedProcAddr},
+    {"queue_submit", &QueueSubmitLayer_GetInstanceProcAddr,
+     &QueueSubmitLayer_GetInterceptedProcAddr},
+    {"sync_wait", &SyncWaitLayer_GetInstanceProcAddr,
+     &SyncWaitLayer_GetInterceptedProcAddr},
+    {"command_recording", &CommandRecordingLayer_GetInstanceProcAddr,
+     &CommandRecordingLayer_GetInterceptedProcAddr},
+    {"descriptor", &DescriptorLayer_GetInstanceProcAddr,
+     &DescriptorLayer_GetInterceptedProcAddr},
+    {"resource_creation", &ResourceCreationLayer_GetInstanceProcAddr,
+     &ResourceCreationLayer_GetInterceptedProcAddr},
+    {"cache_sideload", &CacheSideloadLayer_GetInstanceProcAddr,
+     &CacheSideloadLayer_GetInterceptedProcAddr},
+};
+
+constexpr size_t kNumModules = sizeof(kModules) / sizeof(kModules[0]);
+
+// Every module and the combined layer have their own LayerData, which must each
+// get a per-thread dispatch cache entry.
+static_assert(kNumModules + 1 <= LayerData::kNumDispatchCacheEntries,
+              "The modules don't fit in the dispatch table caches.");
+// They also each have their own overhead profiler, which must get a
+// per-thread counters cache entry.
+static_assert(kNumModules + 1 <=
+                  LayerOverheadProfiler::kNumThreadCountersCacheEntries,
+              "The modules don't fit in the overhead profiler caches.");
+
+// Whether each module of |kModules| is enabled.
+using ModuleSet = std::array<bool, kNumModules>;
+
+// Returns the modules named in the comma-separated |module_list|. Returns all
+// modules if |module_list| is null. Unknown names are logged and ignored, so a
+// list without any known module enables none.
+ModuleSet ParseModules(const char* module_list) {
+  ModuleSet enabled = {};
+  if (!module_list) {
+    enabled.fill(true);
+    return enabled;
+  }
+
+  bool any_enabled = false;
+  for (absl::string_view name :
+       absl::StrSplit(module_list, ',', absl::SkipWhitespace())) {
+    size_t i = 0;
+    while (i != kNumModules && name != kModules[i].name) ++i;
+    if (i == kNumModules) {
+      SPL_LOG(WARNING) << "Unknown layer module: " << name;
+      continue;
+    }
+    enabled[i] = true;
+    any_enabled = true;
+  }
+  if (!any_enabled) {
+    SPL_LOG(WARNING) << "No known layer module in \"" << module_list
+                     << "\". All modules are disabled.";
+  }
+  return enabled;
+}
+
+// Returns the enabled modules, selected by the "common.modules" setting of the
+// `LayerConfig`.
+const ModuleSet& GetEnabledModules() {
+  static const ModuleSet enabled =
+      ParseModules(NullIfEmpty(GetLayerConfig().common.modules));
+  return enabled;
+}
+
+// The layer data of the combined layer. Holds the dispatch tables of the layer
+// below, shared by all modules. The modules log through their own layer data,
+// so this one has no private log.
+class CombinedLayerData : public LayerData {
+ public:
+  CombinedLayerData()
+      : LayerData(/*log_filename=*/nullptr, /*header=*/nullptr) {}
+};
+
+CombinedLayerData* GetLayerData() {
+  // Don't use new -- make the destructor run when the layer gets unloaded.
+  static CombinedLayerData layer_data;
+  return &layer_data;
+}
+
+// Returns the function of the first enabled module at or after |kModules|
+// index |first| that intercepts |name|, or the function of the layer below.
+PFN_vkVoidFunction ResolveInstanceProcAddr(size_t first, VkInstance instance,
+                                           const char* name);
+PFN_vkVoidFunction ResolveDeviceProcAddr(size_t first, VkDevice device,
+                                         const char* name);
+
+// The vkGet*ProcAddr functions resolving from the module at |kFirst|. A module
+// at index i is linked to the ones at i + 1.
+template <size_t kFirst>
+SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+ChainGetInstanceProcAddr(VkInstance instance, const char* name) {
+  return ResolveInstanceProcAddr(kFirst, instance, name);
+}
+
+template <size_t kFirst>
+SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)
+ChainGetDeviceProcAddr(VkDevice device, const char* name) {
+  return ResolveDeviceProcAddr(kFirst, device, name);
+}
+
+template <size_t... kFirst>
+constexpr std::array<PFN_vkGetInstanceProcAddr, sizeof...(kFirst)>
+MakeChainGetInstanceProcAddrs(std::index_sequence<kFirst...>) {
+  return {&ChainGetInstanceProcAddr<kFirst>...};
+}
+
+template <size_t... kFirst>
+constexpr std::array<PFN_vkGetDeviceProcAddr, sizeof...(kFirst)>
+MakeChainGetDeviceProcAddrs(std::index_sequence<kFirst...>) {
+  return {&ChainGetDeviceProcAddr<kFirst>...};
+}
+
+// Indexed by the first module to resolve from, up to |kNumModules|, which
+// resolves to the layer below.
+constexpr auto kChainGetInstanceProcAddr =
+    MakeChainGetInstanceProcAddrs(std::make_index_sequence<kNumModules + 1>());
+constexpr auto kChainGetDeviceProcAddr =
+    MakeChainGetDeviceProcAddrs(std::make_index_sequence<kNumModules + 1>());
+
+//////////////////////////////////////////////////////////////////////////////
+//  The functions the last enabled module calls down the chain. They create
+//  and destroy the instances and devices in the layer below, and add and
+//  remove their shared dispatch tables.
+//////////////////////////////////////////////////////////////////////////////
+
+SPL_LAYER_FUNCTION_ATTRIBUTES(VkResult)
+CreateNextInstance(const VkInstanceCreateInfo* create_info,
+                   const VkAllocationCallbacks* allocator,
+                   VkInstance* instance) {
+  auto build_dispatch_table =
+      [instance](PFN_vkGetInstanceProcAddr get_proc_addr) {
+        VkLayerInstanceDispatchTable dispatch_table{};
+        SPL_DISPATCH_INSTANCE_FUNC(DestroyInstance);
+        SPL_DISPATCH_INSTANCE_FUNC(GetInstanceProcAddr);
+        return dispatch_table;
+      };
+  return GetLayerData()->CreateInstance(create_info, allocator, instance,
+                                        build_dispatch_table);
+}
+
+SPL_LAYER_FUNCTION_ATTRIBUTES(void)
+DestroyNextInstance(VkInstance instance,
+                    const VkAllocationCallbacks* allocator) {
+  CombinedLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextInstanceProcAddr(
+      instance, &VkLayerInstanceDispatchTable::DestroyInstance);
+  layer_data->RemoveInstance(instance);
+  next_proc(instance, allocator);
+}
+
+SPL_LAYER_FUNCTION_ATTRIBUTES(VkResult)
+CreateNextDevice(VkPhysicalDevice physical_device,
+                 const VkDeviceCreateInfo* create_info,
+                 const VkAllocationCallbacks* allocator, VkDevice* device) {
+  auto build_dispatch_table = [device](PFN_vkGetDeviceProcAddr gdpa) {
+    VkLayerDispatchTable dispatch_table{};
+    SPL_DISPATCH_DEVICE_FUNC(DestroyDevice);
+    SPL_DISPATCH_DEVICE_FUNC(GetDeviceProcAddr);
+    return dispatch_table;
+  };
+  return GetLayerData()->CreateDevice(physical_device, create_info, allocator,
+                                      device, build_dispatch_table);
+}
+
+SPL_LAYER_FUNCTION_ATTRIBUTES(void)
+DestroyNextDevice(VkDevice device, const VkAllocationCallbacks* allocator) {
+  CombinedLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyDevice);
+  layer_data->RemoveDevice(device);
+  next_proc(device, allocator);
+}
+
+PFN_vkVoidFunction ResolveInstanceProcAddr(size_t first, VkInstance instance,
+                                           const char* name) {
+  assert(first <= kNumModules);
+  if (strcmp(name, "vkGetInstanceProcAddr") == 0) {
+    return reinterpret_cast<PFN_vkVoidFunction>(
+        kChainGetInstanceProcAddr[first]);
+  }
+  if (strcmp(name, "vkGetDeviceProcAddr") == 0) {
+    return reinterpret_cast<PFN_vkVoidFunction>(
+        kChainGetDeviceProcAddr[first]);
+  }
+
+  const ModuleSet& enabled = GetEnabledModules();
+  for (size_t i = first; i != kNumModules; ++i) {
+    // The module's vkGetInstanceProcAddr returns the same function, and sets
+    // up the module's overhead profiler, if any.
+    if (enabled[i] && kModules[i].get_intercepted_proc_addr(name))
+      return kModules[i].get_instance_proc_addr(instance, name);
+  }
+
+  if (strcmp(name, "vkCreateInstance") == 0)
+    return reinterpret_cast<PFN_vkVoidFunction>(&CreateNextInstance);
+  if (strcmp(name, "vkDestroyInstance") == 0)
+    return reinterpret_cast<PFN_vkVoidFunction>(&DestroyNextInstance);
+  if (strcmp(name, "vkCreateDevice") == 0)
+    return reinterpret_cast<PFN_vkVoidFunction>(&CreateNextDevice);
+  if (strcmp(name, "vkDestroyDevice") == 0)
+    return reinterpret_cast<PFN_vkVoidFunction>(&DestroyNextDevice);
+  if (instance == VK_NULL_HANDLE) return nullptr;
+  return GetLayerData()->GetNextInstanceProcAddr(
+      instance, &VkLayerInstanceDispatchTable::GetInstanceProcAddr)(instance,
+                                                                     name);
+}
+
+PFN_vkVoidFunction ResolveDeviceProcAddr(size_t first, VkDevice device,
+                                         const char* name) {
+  assert(first <= kNumModules);
+  if (strcmp(name, "vkGetDeviceProcAddr") == 0) {
+    return reinterpret_cast<PFN_vkVoidFunction>(
+        kChainGetDeviceProcAddr[first]);
+  }
+
+  // The functions of the features and extensions that the device didn't
+  // enable are null in the layer below, and must stay null.
+  PFN_vkVoidFunction next_func = GetLayerData()->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::GetDeviceProcAddr)(device, name);
+  if (!next_func) return nullptr;
+
+  const ModuleSet& enabled = GetEnabledModules();
+  for (size_t i = first; i != kNumModules; ++i) {
+    if (!enabled[i]) continue;
+    if (auto func = kModules[i].get_intercepted_proc_addr(name)) return func;
+  }
+
+  if (strcmp(name, "vkDestroyDevice") == 0)
+    return reinterpret_cast<PFN_vkVoidFunction>(&DestroyNextDevice);
+  return next_func;
+}
+
+// Use this macro to define all vulkan functions intercepted by the layer.
+#define SPL_COMBINED_LAYER_FUNC(RETURN_TYPE_, FUNC_NAME_, FUNC_ARGS_)  \
+  SPL_INTERCEPTED_VULKAN_FUNC(RETURN_TYPE_, CombinedLayer_, FUNC_NAME_, \
+                              FUNC_ARGS_)
+
+// The functions intercepted by the layer, defined below with
+// SPL_COMBINED_LAYER_FUNC.
+#define SPL_COMBINED_LAYER_FUNCS(X_, LAYER_PREFIX_)   \
+  X_(LAYER_PREFIX_, CreateInstance)                   \
+  X_(LAYER_PREFIX_, CreateDevice)                     \
+  X_(LAYER_PREFIX_, EnumerateInstanceLayerProperties) \
+  X_(LAYER_PREFIX_, EnumerateDeviceLayerProperties)   \
+  X_(LAYER_PREFIX_, GetDeviceProcAddr)                \
+  X_(LAYER_PREFIX_, GetInstanceProcAddr)
+
+SPL_DECLARE_INTERCEPTED_FUNCTIONS(CombinedLayer_, SPL_COMBINED_LAYER_FUNCS);
+
+//////////////////////////////////////////////////////////////////////////////
+//  Implementation of the instance functions we want to override.
+//////////////////////////////////////////////////////////////////////////////
+
+// Override for vkCreateInstance.  Links the enabled modules to each other and
+// creates the instance through the first one.
+SPL_COMBINED_LAYER_FUNC(VkResult, CreateInstance,
+                        (const VkInstanceCreateInfo* create_info,
+                         const VkAllocationCallbacks* allocator,
+                         VkInstance* instance)) {
+  VkLayerInstanceCreateInfo* layer_create_info =
+      FindInstanceCreateInfo(create_info);
+  if (layer_create_info == nullptr) return VK_ERROR_INITIALIZATION_FAILED;
+  VkLayerInstanceLink* next_link = layer_create_info->u.pLayerInfo;
+  assert(next_link);
+
+  // Each module takes its link off the chain, which leaves the link of this
+  // layer for CreateNextInstance.
+  std::vector<VkLayerInstanceLink> links;
+  const ModuleSet& enabled = GetEnabledModules();
+  for (size_t i = 0; i != kNumModules; ++i) {
+    if (!enabled[i]) continue;
+    links.push_back(*next_link);
+    links.back().pfnNextGetInstanceProcAddr = kChainGetInstanceProcAddr[i + 1];
+  }
+  for (size_t i = 0; i != links.size(); ++i)
+    links[i].pNext = i + 1 != links.size() ? &links[i + 1] : next_link;
+  if (!links.empty()) layer_create_info->u.pLayerInfo = links.data();
+
+  auto create_function = reinterpret_cast<PFN_vkCreateInstance>(
+      ResolveInstanceProcAddr(0, VK_NULL_HANDLE, "vkCreateInstance"));
+  assert(create_function);
+  VkResult result = create_function(create_info, allocator, instance);
+  // |links| doesn't outlive this call.
+  layer_create_info->u.pLayerInfo = next_link;
+  return result;
+}
+
+// Override for vkCreateDevice.  Links the enabled modules to each other and
+// creates the device through the first one.
+SPL_COMBINED_LAYER_FUNC(VkResult, CreateDevice,
+                        (VkPhysicalDevice physical_device,
+                         const VkDeviceCreateInfo* create_info,
+                         const VkAllocationCallbacks* allocator,
+                         VkDevice* device)) {
+  VkLayerDeviceCreateInfo* layer_create_info =
+      FindDeviceCreateInfo(create_info);
+  if (layer_create_info == nullptr) return VK_ERROR_INITIALIZATION_FAILED;
+  VkLayerDeviceLink* next_link = layer_create_info->u.pLayerInfo;
+  assert(next_link);
+
+  std::vector<VkLayerDeviceLink> links;
+  const ModuleSet& enabled = GetEnabledModules();
+  for (size_t i = 0; i != kNumModules; ++i) {
+    if (!enabled[i]) continue;
+    links.push_back(*next_link);
+    links.back().pfnNextGetInstanceProcAddr = kChainGetInstanceProcAddr[i + 1];
+    links.back().pfnNextGetDeviceProcAddr = kChainGetDeviceProcAddr[i + 1];
+  }
+  for (size_t i = 0; i != links.size(); ++i)
+    links[i].pNext = i + 1 != links.size() ? &links[i + 1] : next_link;
+  if (!links.empty()) layer_create_info->u.pLayerInfo = links.data();
+
+  // Every module intercepts vkCreateDevice, so the instance is not needed to
+  // look it up.
+  auto create_function = reinterpret_cast<PFN_vkCreateDevice>(
+      ResolveInstanceProcAddr(0, VK_NULL_HANDLE, "vkCreateDevice"));
+  assert(create_function);
+  VkResult result =
+      create_function(physical_device, create_info, allocator, device);
+  // |links| doesn't outlive this call.
+  layer_create_info->u.pLayerInfo = next_link;
+  return result;
+}
+
+SPL_COMBINED_LAYER_FUNC(VkResult, EnumerateInstanceLayerProperties,
+                        (uint32_t * property_count,
+                         VkLayerProperties* properties)) {
+  if (property_count) *property_count = 1;
+
+  if (properties) {
+    strncpy(properties->layerName, kLayerName, sizeof(properties->layerName));
+    strncpy(properties->description, kLayerDescription,
+            sizeof(properties->description));
+    properties->implementationVersion = kCombinedLayerVersion;
+    properties->specVersion = VK_API_VERSION_1_0;
+  }
+
+  return VK_SUCCESS;
+}
+
+SPL_COMBINED_LAYER_FUNC(VkResult, EnumerateDeviceLayerProperties,
+                        (VkPhysicalDevice /* physical_device */,
+                         uint32_t* property_count,
+                         VkLayerProperties* properties)) {
+  return CombinedLayer_EnumerateInstanceLayerProperties(property_count,
+                                                        properties);
+}
+
+}  // namespace
+
+SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE(CombinedLayer_, SPL_COMBINED_LAYER_FUNCS);
+
+// The *GetProcAddr functions are the entry points to the layers.
+// They return a function pointer for the instance requested by |name|.  We
+// return the functions defined in this layer for those we want to override.
+// Otherwise we return the function of the first enabled module intercepting
+// it, or the function of the next layer.
+
+SPL_LAYER_ENTRY_POINT
+SPL_COMBINED_LAYER_FUNC(PFN_vkVoidFunction, GetDeviceProcAddr,
+                        (VkDevice device, const char* name)) {
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(CombinedLayer_, name)) {
+    return func;
+  }
+  return ResolveDeviceProcAddr(0, device, name);
+}
+
+SPL_LAYER_ENTRY_POINT
+SPL_COMBINED_LAYER_FUNC(PFN_vkVoidFunction, GetInstanceProcAddr,
+                        (VkInstance instance, const char* name)) {
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(CombinedLayer_, name)) {
+    return func;
+  }
+  return ResolveInstanceProcAddr(0, instance, name);
+}
+
+}  // namespace performancelayers
@@ -0,0 +1,913 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "command_recording_layer_data.h"
+#include "layer/support/layer_config.h"
+#include "layer/support/layer_data.h"
+#include "layer/support/layer_utils.h"
+
+namespace performancelayers {
+namespace {
+// ----------------------------------------------------------------------------
+// Layer book-keeping information
+// ----------------------------------------------------------------------------
+
+constexpr uint32_t kCommandRecordingLayerVersion = 1;
+constexpr char kLayerName[] = "VK_LAYER_STADIA_command_recording";
+constexpr char kLayerDescription[] =
+    "Stadia Command Buffer Recording Measuring Layer";
+
+CommandRecordingLayerData* GetLayerData() {
+  // Don't use new -- make the destructor run when the layer gets unloaded.
+  static CommandRecordingLayerData layer_data(
+      NullIfEmpty(GetLayerConfig().command_recording.log));
+  return &layer_data;
+}
+
+// Use this macro to define all vulkan functions intercepted by the layer.
+#define SPL_COMMAND_RECORDING_LAYER_FUNC(RETURN_TYPE_, FUNC_NAME_, FUNC_ARGS_) \
+  SPL_INTERCEPTED_VULKAN_FUNC(RETURN_TYPE_, CommandRecordingLayer_,            \
+                              FUNC_NAME_, FUNC_ARGS_)
+
+// The functions intercepted by the layer, defined below with
+// SPL_COMMAND_RECORDING_LAYER_FUNC.
+#define SPL_COMMAND_RECORDING_LAYER_FUNCS(X_, LAYER_PREFIX_) \
+  X_(LAYER_PREFIX_, AllocateCommandBuffers)                  \
+  X_(LAYER_PREFIX_, FreeCommandBuffers)                      \
+  X_(LAYER_PREFIX_, DestroyCommandPool)                      \
+  X_(LAYER_PREFIX_, BeginCommandBuffer)                      \
+  X_(LAYER_PREFIX_, EndCommandBuffer)                        \
+  X_(LAYER_PREFIX_, CmdBindPipeline)                         \
+  X_(LAYER_PREFIX_, CmdBindDescriptorSets)                   \
+  X_(LAYER_PREFIX_, CmdBindVertexBuffers)                    \
+  X_(LAYER_PREFIX_, CmdBindVertexBuffers2)                   \
+  X_(LAYER_PREFIX_, CmdBindVertexBuffers2EXT)                \
+  X_(LAYER_PREFIX_, CmdBindIndexBuffer)                      \
+  X_(LAYER_PREFIX_, CmdDraw)                                 \
+  X_(LAYER_PREFIX_, CmdDrawIndexed)                          \
+  X_(LAYER_PREFIX_, CmdDrawIndirect)                         \
+  X_(LAYER_PREFIX_, CmdDrawIndexedIndirect)                  \
+  X_(LAYER_PREFIX_, CmdDrawIndirectCount)                    \
+  X_(LAYER_PREFIX_, CmdDrawIndirectCountKHR)                 \
+  X_(LAYER_PREFIX_, CmdDrawIndexedIndirectCount)             \
+  X_(LAYER_PREFIX_, CmdDrawIndexedIndirectCountKHR)          \
+  X_(LAYER_PREFIX_, CmdDispatch)                             \
+  X_(LAYER_PREFIX_, CmdDispatchIndirect)                     \
+  X_(LAYER_PREFIX_, CmdDispatchBase)                         \
+  X_(LAYER_PREFIX_, CmdDispatchBaseKHR)                      \
+  X_(LAYER_PREFIX_, CmdPipelineBarrier)                      \
+  X_(LAYER_PREFIX_, CmdPipelineBarrier2)                     \
+  X_(LAYER_PREFIX_, CmdPipelineBarrier2KHR)                  \
+  X_(LAYER_PREFIX_, CmdCopyBuffer)                           \
+  X_(LAYER_PREFIX_, CmdCopyImage)                            \
+  X_(LAYER_PREFIX_, CmdCopyBufferToImage)                    \
+  X_(LAYER_PREFIX_, CmdCopyImageToBuffer)                    \
+  X_(LAYER_PREFIX_, CmdBlitImage)                            \
+  X_(LAYER_PREFIX_, CmdUpdateBuffer)                         \
+  X_(LAYER_PREFIX_, CmdFillBuffer)                           \
+  X_(LAYER_PREFIX_, CmdCopyBuffer2)                          \
+  X_(LAYER_PREFIX_, CmdCopyBuffer2KHR)                       \
+  X_(LAYER_PREFIX_, CmdCopyImage2)                           \
+  X_(LAYER_PREFIX_, CmdCopyImage2KHR)                        \
+  X_(LAYER_PREFIX_, CmdCopyBufferToImage2)                   \
+  X_(LAYER_PREFIX_, CmdCopyBufferToImage2KHR)                \
+  X_(LAYER_PREFIX_, CmdCopyImageToBuffer2)                   \
+  X_(LAYER_PREFIX_, CmdCopyImageToBuffer2KHR)                \
+  X_(LAYER_PREFIX_, CmdBlitImage2)                           \
+  X_(LAYER_PREFIX_, CmdBlitImage2KHR)                        \
+  X_(LAYER_PREFIX_, QueuePresentKHR)                         \
+  X_(LAYER_PREFIX_, DestroyInstance)                         \
+  X_(LAYER_PREFIX_, CreateInstance)                          \
+  X_(LAYER_PREFIX_, DestroyDevice)                           \
+  X_(LAYER_PREFIX_, CreateDevice)                            \
+  X_(LAYER_PREFIX_, EnumerateInstanceLayerProperties)        \
+  X_(LAYER_PREFIX_, EnumerateDeviceLayerProperties)          \
+  X_(LAYER_PREFIX_, GetDeviceProcAddr)                       \
+  X_(LAYER_PREFIX_, GetInstanceProcAddr)
+
+SPL_DECLARE_INTERCEPTED_FUNCTIONS(CommandRecordingLayer_,
+                                  SPL_COMMAND_RECORDING_LAYER_FUNCS);
+
+//////////////////////////////////////////////////////////////////////////////
+//  Implementation of the instance functions we want to override.
+//////////////////////////////////////////////////////////////////////////////
+
+// Override for vkDestroyInstance.  Deletes the entry for |instance| from the
+// layer data.
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, DestroyInstance,
+                                 (VkInstance instance,
+                                  const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextInstanceProcAddr(
+      instance, &VkLayerInstanceDispatchTable::DestroyInstance);
+  layer_data->RemoveInstance(instance);
+  next_proc(instance, allocator);
+}
+
+// Override for vkCreateInstance.  Creates the dispatch table for this instance
+// and add it to the layer data.
+SPL_COMMAND_RECORDING_LAYER_FUNC(VkResult, CreateInstance,
+                                 (const VkInstanceCreateInfo* create_info,
+                                  const VkAllocationCallbacks* allocator,
+                                  VkInstance* instance)) {
+  auto build_dispatch_table =
+      [instance](PFN_vkGetInstanceProcAddr get_proc_addr) {
+        // Build dispatch table for the instance functions we need to call.
+        VkLayerInstanceDispatchTable dispatch_table{};
+
+        // Get the next layer's instance of the instance functions we will
+        // override.
+        SPL_DISPATCH_INSTANCE_FUNC(DestroyInstance);
+        SPL_DISPATCH_INSTANCE_FUNC(GetInstanceProcAddr);
+        return dispatch_table;
+      };
+
+  return GetLayerData()->CreateInstance(create_info, allocator, instance,
+                                        build_dispatch_table);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//  Implementation of the device function we want to override.
+//////////////////////////////////////////////////////////////////////////////
+
+// Override for vkAllocateCommandBuffers.  Adds the new command buffers to the
+// layer data, even when the layer is off, so that they are known if it is
+// switched on.
+SPL_COMMAND_RECORDING_LAYER_FUNC(
+    VkResult, AllocateCommandBuffers,
+    (VkDevice device, const VkCommandBufferAllocateInfo* allocate_info,
+     VkCommandBuffer* command_buffers)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::AllocateCommandBuffers);
+  VkResult result = next_proc(device, allocate_info, command_buffers);
+  if (result == VK_SUCCESS) {
+    layer_data->AddCommandBuffers(
+        allocate_info->commandPool,
+        allocate_info->level == VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+        allocate_info->commandBufferCount, command_buffers);
+  }
+  return result;
+}
+
+// Override for vkFreeCommandBuffers.  Removes the command buffers from the
+// layer data.
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, FreeCommandBuffers,
+                                 (VkDevice device, VkCommandPool pool,
+                                  uint32_t command_buffer_count,
+                                  const VkCommandBuffer* command_buffers)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::FreeCommandBuffers);
+  layer_data->RemoveCommandBuffers(command_buffer_count, command_buffers);
+  next_proc(device, pool, command_buffer_count, command_buffers);
+}
+
+// Override for vkDestroyCommandPool.  Removes the command buffers of the pool
+// from the layer data.
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, DestroyCommandPool,
+                                 (VkDevice device, VkCommandPool pool,
+                                  const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyCommandPool);
+  layer_data->RemoveCommandPool(pool);
+  next_proc(device, pool, allocator);
+}
+
+// Override for vkBeginCommandBuffer.  Starts measuring the recording of the
+// command buffer on the calling thread.
+SPL_COMMAND_RECORDING_LAYER_FUNC(VkResult, BeginCommandBuffer,
+                                 (VkCommandBuffer command_buffer,
+                                  const VkCommandBufferBeginInfo* begin_info)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::BeginCommandBuffer);
+  // Recordings that begin while the layer is off are marked as such, so that
+  // they are not measured if the layer is switched on before they end.
+  layer_data->BeginRecording(
+      command_buffer,
+      layer_data->GetInstrumentationMode() != InstrumentationMode::kOff);
+  return next_proc(command_buffer, begin_info);
+}
+
+// Override for vkEndCommandBuffer.  Records the wall time of the recording and
+// the commands recorded.
+SPL_COMMAND_RECORDING_LAYER_FUNC(VkResult, EndCommandBuffer,
+                                 (VkCommandBuffer command_buffer)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::EndCommandBuffer);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(command_buffer);
+
+  VkResult result = next_proc(command_buffer);
+  layer_data->EndRecording(command_buffer, Now(),
+                           layer_data->ShouldInstrument());
+  return result;
+}
+
+// Overrides for the binding commands.  Count the command in its command
+// buffer.
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdBindPipeline,
+                                 (VkCommandBuffer command_buffer,
+                                  VkPipelineBindPoint bind_point,
+                                  VkPipeline pipeline)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kBind);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdBindPipeline);
+  next_proc(command_buffer, bind_point, pipeline);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdBindDescriptorSets,
+                                 (VkCommandBuffer command_buffer,
+                                  VkPipelineBindPoint bind_point,
+                                  VkPipelineLayout layout, uint32_t first_set,
+                                  uint32_t descriptor_set_count,
+                                  const VkDescriptorSet* descriptor_sets,
+                                  uint32_t dynamic_offset_count,
+                                  const uint32_t* dynamic_offsets)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kBind);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdBindDescriptorSets);
+  next_proc(command_buffer, bind_point, layout, first_set, descriptor_set_count,
+            descriptor_sets, dynamic_offset_count, dynamic_offsets);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdBindVertexBuffers,
+                                 (VkCommandBuffer command_buffer,
+                                  uint32_t first_binding,
+                                  uint32_t binding_count,
+                                  const VkBuffer* buffers,
+                                  const VkDeviceSize* offsets)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kBind);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdBindVertexBuffers);
+  next_proc(command_buffer, first_binding, binding_count, buffers, offsets);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdBindVertexBuffers2,
+                                 (VkCommandBuffer command_buffer,
+                                  uint32_t first_binding,
+                                  uint32_t binding_count,
+                                  const VkBuffer* buffers,
+                                  const VkDeviceSize* offsets,
+                                  const VkDeviceSize* sizes,
+                                  const VkDeviceSize* strides)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kBind);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdBindVertexBuffers2);
+  next_proc(command_buffer, first_binding, binding_count, buffers, offsets,
+            sizes, strides);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdBindVertexBuffers2EXT,
+                                 (VkCommandBuffer command_buffer,
+                                  uint32_t first_binding,
+                                  uint32_t binding_count,
+                                  const VkBuffer* buffers,
+                                  const VkDeviceSize* offsets,
+                                  const VkDeviceSize* sizes,
+                                  const VkDeviceSize* strides)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kBind);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdBindVertexBuffers2EXT);
+  next_proc(command_buffer, first_binding, binding_count, buffers, offsets,
+            sizes, strides);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdBindIndexBuffer,
+                                 (VkCommandBuffer command_buffer,
+                                  VkBuffer buffer, VkDeviceSize offset,
+                                  VkIndexType index_type)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kBind);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdBindIndexBuffer);
+  next_proc(command_buffer, buffer, offset, index_type);
+}
+
+// Overrides for the draw commands.  Count the command in its command buffer.
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdDraw,
+                                 (VkCommandBuffer command_buffer,
+                                  uint32_t vertex_count,
+                                  uint32_t instance_count,
+                                  uint32_t first_vertex,
+                                  uint32_t first_instance)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kDraw);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdDraw);
+  next_proc(command_buffer, vertex_count, instance_count, first_vertex,
+            first_instance);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdDrawIndexed,
+                                 (VkCommandBuffer command_buffer,
+                                  uint32_t index_count, uint32_t instance_count,
+                                  uint32_t first_index, int32_t vertex_offset,
+                                  uint32_t first_instance)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kDraw);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdDrawIndexed);
+  next_proc(command_buffer, index_count, instance_count, first_index,
+            vertex_offset, first_instance);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdDrawIndirect,
+                                 (VkCommandBuffer command_buffer,
+                                  VkBuffer buffer, VkDeviceSize offset,
+                                  uint32_t draw_count, uint32_t stride)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kDraw);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdDrawIndirect);
+  next_proc(command_buffer, buffer, offset, draw_count, stride);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdDrawIndexedIndirect,
+                                 (VkCommandBuffer command_buffer,
+                                  VkBuffer buffer, VkDeviceSize offset,
+                                  uint32_t draw_count, uint32_t stride)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kDraw);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdDrawIndexedIndirect);
+  next_proc(command_buffer, buffer, offset, draw_count, stride);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdDrawIndirectCount,
+                                 (VkCommandBuffer command_buffer,
+                                  VkBuffer buffer, VkDeviceSize offset,
+                                  VkBuffer count_buffer,
+                                  VkDeviceSize count_buffer_offset,
+                                  uint32_t max_draw_count, uint32_t stride)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kDraw);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdDrawIndirectCount);
+  next_proc(command_buffer, buffer, offset, count_buffer, count_buffer_offset,
+            max_draw_count, stride);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdDrawIndirectCountKHR,
+                                 (VkCommandBuffer command_buffer,
+                                  VkBuffer buffer, VkDeviceSize offset,
+                                  VkBuffer count_buffer,
+                                  VkDeviceSize count_buffer_offset,
+                                  uint32_t max_draw_count, uint32_t stride)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kDraw);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdDrawIndirectCountKHR);
+  next_proc(command_buffer, buffer, offset, count_buffer, count_buffer_offset,
+            max_draw_count, stride);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdDrawIndexedIndirectCount,
+                                 (VkCommandBuffer command_buffer,
+                                  VkBuffer buffer, VkDeviceSize offset,
+                                  VkBuffer count_buffer,
+                                  VkDeviceSize count_buffer_offset,
+                                  uint32_t max_draw_count, uint32_t stride)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kDraw);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdDrawIndexedIndirectCount);
+  next_proc(command_buffer, buffer, offset, count_buffer, count_buffer_offset,
+            max_draw_count, stride);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdDrawIndexedIndirectCountKHR,
+                                 (VkCommandBuffer command_buffer,
+                                  VkBuffer buffer, VkDeviceSize offset,
+                                  VkBuffer count_buffer,
+                                  VkDeviceSize count_buffer_offset,
+                                  uint32_t max_draw_count, uint32_t stride)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kDraw);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdDrawIndexedIndirectCountKHR);
+  next_proc(command_buffer, buffer, offset, count_buffer, count_buffer_offset,
+            max_draw_count, stride);
+}
+
+// Overrides for the dispatch commands.  Count the command in its command
+// buffer.
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdDispatch,
+                                 (VkCommandBuffer command_buffer,
+                                  uint32_t group_count_x,
+                                  uint32_t group_count_y,
+                                  uint32_t group_count_z)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kDispatch);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdDispatch);
+  next_proc(command_buffer, group_count_x, group_count_y, group_count_z);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdDispatchIndirect,
+                                 (VkCommandBuffer command_buffer,
+                                  VkBuffer buffer, VkDeviceSize offset)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kDispatch);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdDispatchIndirect);
+  next_proc(command_buffer, buffer, offset);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdDispatchBase,
+                                 (VkCommandBuffer command_buffer,
+                                  uint32_t base_group_x, uint32_t base_group_y,
+                                  uint32_t base_group_z, uint32_t group_count_x,
+                                  uint32_t group_count_y,
+                                  uint32_t group_count_z)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kDispatch);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdDispatchBase);
+  next_proc(command_buffer, base_group_x, base_group_y, base_group_z,
+            group_count_x, group_count_y, group_count_z);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdDispatchBaseKHR,
+                                 (VkCommandBuffer command_buffer,
+                                  uint32_t base_group_x, uint32_t base_group_y,
+                                  uint32_t base_group_z, uint32_t group_count_x,
+                                  uint32_t group_count_y,
+                                  uint32_t group_count_z)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kDispatch);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdDispatchBaseKHR);
+  next_proc(command_buffer, base_group_x, base_group_y, base_group_z,
+            group_count_x, group_count_y, group_count_z);
+}
+
+// Overrides for the barrier commands.  Count the command in its command
+// buffer.
+SPL_COMMAND_RECORDING_LAYER_FUNC(
+    void, CmdPipelineBarrier,
+    (VkCommandBuffer command_buffer, VkPipelineStageFlags src_stage_mask,
+     VkPipelineStageFlags dst_stage_mask, VkDependencyFlags dependency_flags,
+     uint32_t memory_barrier_count, const VkMemoryBarrier* memory_barriers,
+     uint32_t buffer_memory_barrier_count,
+     const VkBufferMemoryBarrier* buffer_memory_barriers,
+     uint32_t image_memory_barrier_count,
+     const VkImageMemoryBarrier* image_memory_barriers)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kBarrier);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdPipelineBarrier);
+  next_proc(command_buffer, src_stage_mask, dst_stage_mask, dependency_flags,
+            memory_barrier_count, memory_barriers, buffer_memory_barrier_count,
+            buffer_memory_barriers, image_memory_barrier_count,
+            image_memory_barriers);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdPipelineBarrier2,
+                                 (VkCommandBuffer command_buffer,
+                                  const VkDependencyInfo* dependency_info)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kBarrier);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdPipelineBarrier2);
+  next_proc(command_buffer, dependency_info);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdPipelineBarrier2KHR,
+                                 (VkCommandBuffer command_buffer,
+                                  const VkDependencyInfo* dependency_info)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kBarrier);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdPipelineBarrier2KHR);
+  next_proc(command_buffer, dependency_info);
+}
+
+// Overrides for the copy, blit, update and fill commands.  Count the command in
+// its command buffer.
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdCopyBuffer,
+                                 (VkCommandBuffer command_buffer,
+                                  VkBuffer src_buffer, VkBuffer dst_buffer,
+                                  uint32_t region_count,
+                                  const VkBufferCopy* regions)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdCopyBuffer);
+  next_proc(command_buffer, src_buffer, dst_buffer, region_count, regions);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdCopyImage,
+                                 (VkCommandBuffer command_buffer,
+                                  VkImage src_image,
+                                  VkImageLayout src_image_layout,
+                                  VkImage dst_image,
+                                  VkImageLayout dst_image_layout,
+                                  uint32_t region_count,
+                                  const VkImageCopy* regions)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdCopyImage);
+  next_proc(command_buffer, src_image, src_image_layout, dst_image,
+            dst_image_layout, region_count, regions);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdCopyBufferToImage,
+                                 (VkCommandBuffer command_buffer,
+                                  VkBuffer src_buffer, VkImage dst_image,
+                                  VkImageLayout dst_image_layout,
+                                  uint32_t region_count,
+                                  const VkBufferImageCopy* regions)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdCopyBufferToImage);
+  next_proc(command_buffer, src_buffer, dst_image, dst_image_layout,
+            region_count, regions);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdCopyImageToBuffer,
+                                 (VkCommandBuffer command_buffer,
+                                  VkImage src_image,
+                                  VkImageLayout src_image_layout,
+                                  VkBuffer dst_buffer, uint32_t region_count,
+                                  const VkBufferImageCopy* regions)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdCopyImageToBuffer);
+  next_proc(command_buffer, src_image, src_image_layout, dst_buffer,
+            region_count, regions);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdBlitImage,
+                                 (VkCommandBuffer command_buffer,
+                                  VkImage src_image,
+                                  VkImageLayout src_image_layout,
+                                  VkImage dst_image,
+                                  VkImageLayout dst_image_layout,
+                                  uint32_t region_count,
+                                  const VkImageBlit* regions,
+                                  VkFilter filter)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdBlitImage);
+  next_proc(command_buffer, src_image, src_image_layout, dst_image,
+            dst_image_layout, region_count, regions, filter);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdUpdateBuffer,
+                                 (VkCommandBuffer command_buffer,
+                                  VkBuffer dst_buffer, VkDeviceSize dst_offset,
+                                  VkDeviceSize data_size, const void* data)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdUpdateBuffer);
+  next_proc(command_buffer, dst_buffer, dst_offset, data_size, data);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdFillBuffer,
+                                 (VkCommandBuffer command_buffer,
+                                  VkBuffer dst_buffer, VkDeviceSize dst_offset,
+                                  VkDeviceSize size, uint32_t data)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdFillBuffer);
+  next_proc(command_buffer, dst_buffer, dst_offset, size, data);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdCopyBuffer2,
+                                 (VkCommandBuffer command_buffer,
+                                  const VkCopyBufferInfo2* copy_info)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdCopyBuffer2);
+  next_proc(command_buffer, copy_info);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdCopyBuffer2KHR,
+                                 (VkCommandBuffer command_buffer,
+                                  const VkCopyBufferInfo2* copy_info)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdCopyBuffer2KHR);
+  next_proc(command_buffer, copy_info);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdCopyImage2,
+                                 (VkCommandBuffer command_buffer,
+                                  const VkCopyImageInfo2* copy_info)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdCopyImage2);
+  next_proc(command_buffer, copy_info);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdCopyImage2KHR,
+                                 (VkCommandBuffer command_buffer,
+                                  const VkCopyImageInfo2* copy_info)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdCopyImage2KHR);
+  next_proc(command_buffer, copy_info);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdCopyBufferToImage2,
+                                 (VkCommandBuffer command_buffer,
+                                  const VkCopyBufferToImageInfo2* copy_info)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdCopyBufferToImage2);
+  next_proc(command_buffer, copy_info);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdCopyBufferToImage2KHR,
+                                 (VkCommandBuffer command_buffer,
+                                  const VkCopyBufferToImageInfo2* copy_info)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdCopyBufferToImage2KHR);
+  next_proc(command_buffer, copy_info);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdCopyImageToBuffer2,
+                                 (VkCommandBuffer command_buffer,
+                                  const VkCopyImageToBufferInfo2* copy_info)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdCopyImageToBuffer2);
+  next_proc(command_buffer, copy_info);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdCopyImageToBuffer2KHR,
+                                 (VkCommandBuffer command_buffer,
+                                  const VkCopyImageToBufferInfo2* copy_info)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdCopyImageToBuffer2KHR);
+  next_proc(command_buffer, copy_info);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdBlitImage2,
+                                 (VkCommandBuffer command_buffer,
+                                  const VkBlitImageInfo2* blit_image_info)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdBlitImage2);
+  next_proc(command_buffer, blit_image_info);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, CmdBlitImage2KHR,
+                                 (VkCommandBuffer command_buffer,
+                                  const VkBlitImageInfo2* blit_image_info)) {
+  auto* layer_data = GetLayerData();
+  if (layer_data->GetInstrumentationMode() != InstrumentationMode::kOff)
+    layer_data->CountCommand(command_buffer, CommandCategory::kCopy);
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      command_buffer, &VkLayerDispatchTable::CmdBlitImage2KHR);
+  next_proc(command_buffer, blit_image_info);
+}
+
+// Override for vkQueuePresentKHR.  Logs the recordings of the frame.
+SPL_COMMAND_RECORDING_LAYER_FUNC(VkResult, QueuePresentKHR,
+                                 (VkQueue queue,
+                                  const VkPresentInfoKHR* present_info)) {
+  auto* layer_data = GetLayerData();
+  layer_data->RecordPresent();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      queue, &VkLayerDispatchTable::QueuePresentKHR);
+  return next_proc(queue, present_info);
+}
+
+// Override for vkDestroyDevice.  Removes the dispatch table for the device from
+// the layer data.
+SPL_COMMAND_RECORDING_LAYER_FUNC(void, DestroyDevice,
+                                 (VkDevice device,
+                                  const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyDevice);
+  layer_data->RemoveDevice(device);
+  next_proc(device, allocator);
+}
+
+// Override for vkCreateDevice.  Builds the dispatch table for the new device
+// and add it to the layer data.
+SPL_COMMAND_RECORDING_LAYER_FUNC(VkResult, CreateDevice,
+                                 (VkPhysicalDevice physical_device,
+                                  const VkDeviceCreateInfo* create_info,
+                                  const VkAllocationCallbacks* allocator,
+                                  VkDevice* device)) {
+  auto build_dispatch_table = [device](PFN_vkGetDeviceProcAddr gdpa) {
+    VkLayerDispatchTable dispatch_table{};
+
+    // Get the next layer's instance of the device functions we will override.
+    // The functions of extensions and newer versions are null unless the
+    // device supports them.
+    SPL_DISPATCH_DEVICE_FUNC(DestroyDevice);
+    SPL_DISPATCH_DEVICE_FUNC(GetDeviceProcAddr);
+    SPL_DISPATCH_DEVICE_FUNC(AllocateCommandBuffers);
+    SPL_DISPATCH_DEVICE_FUNC(FreeCommandBuffers);
+    SPL_DISPATCH_DEVICE_FUNC(DestroyCommandPool);
+    SPL_DISPATCH_DEVICE_FUNC(BeginCommandBuffer);
+    SPL_DISPATCH_DEVICE_FUNC(EndCommandBuffer);
+    SPL_DISPATCH_DEVICE_FUNC(CmdBindPipeline);
+    SPL_DISPATCH_DEVICE_FUNC(CmdBindDescriptorSets);
+    SPL_DISPATCH_DEVICE_FUNC(CmdBindVertexBuffers);
+    SPL_DISPATCH_DEVICE_FUNC(CmdBindVertexBuffers2);
+    SPL_DISPATCH_DEVICE_FUNC(CmdBindVertexBuffers2EXT);
+    SPL_DISPATCH_DEVICE_FUNC(CmdBindIndexBuffer);
+    SPL_DISPATCH_DEVICE_FUNC(CmdDraw);
+    SPL_DISPATCH_DEVICE_FUNC(CmdDrawIndexed);
+    SPL_DISPATCH_DEVICE_FUNC(CmdDrawIndirect);
+    SPL_DISPATCH_DEVICE_FUNC(CmdDrawIndexedIndirect);
+    SPL_DISPATCH_DEVICE_FUNC(CmdDrawIndirectCount);
+    SPL_DISPATCH_DEVICE_FUNC(CmdDrawIndirectCountKHR);
+    SPL_DISPATCH_DEVICE_FUNC(CmdDrawIndexedIndirectCount);
+    SPL_DISPATCH_DEVICE_FUNC(CmdDrawIndexedIndirectCountKHR);
+    SPL_DISPATCH_DEVICE_FUNC(CmdDispatch);
+    SPL_DISPATCH_DEVICE_FUNC(CmdDispatchIndirect);
+    SPL_DISPATCH_DEVICE_FUNC(CmdDispatchBase);
+    SPL_DISPATCH_DEVICE_FUNC(CmdDispatchBaseKHR);
+    SPL_DISPATCH_DEVICE_FUNC(CmdPipelineBarrier);
+    SPL_DISPATCH_DEVICE_FUNC(CmdPipelineBarrier2);
+    SPL_DISPATCH_DEVICE_FUNC(CmdPipelineBarrier2KHR);
+    SPL_DISPATCH_DEVICE_FUNC(CmdCopyBuffer);
+    SPL_DISPATCH_DEVICE_FUNC(CmdCopyImage);
+    SPL_DISPATCH_DEVICE_FUNC(CmdCopyBufferToImage);
+    SPL_DISPATCH_DEVICE_FUNC(CmdCopyImageToBuffer);
+    SPL_DISPATCH_DEVICE_FUNC(CmdBlitImage);
+    SPL_DISPATCH_DEVICE_FUNC(CmdUpdateBuffer);
+    SPL_DISPATCH_DEVICE_FUNC(CmdFillBuffer);
+    SPL_DISPATCH_DEVICE_FUNC(CmdCopyBuffer2);
+    SPL_DISPATCH_DEVICE_FUNC(CmdCopyBuffer2KHR);
+    SPL_DISPATCH_DEVICE_FUNC(CmdCopyImage2);
+    SPL_DISPATCH_DEVICE_FUNC(CmdCopyImage2KHR);
+    SPL_DISPATCH_DEVICE_FUNC(CmdCopyBufferToImage2);
+    SPL_DISPATCH_DEVICE_FUNC(CmdCopyBufferToImage2KHR);
+    SPL_DISPATCH_DEVICE_FUNC(CmdCopyImageToBuffer2);
+    SPL_DISPATCH_DEVICE_FUNC(CmdCopyImageToBuffer2KHR);
+    SPL_DISPATCH_DEVICE_FUNC(CmdBlitImage2);
+    SPL_DISPATCH_DEVICE_FUNC(CmdBlitImage2KHR);
+    SPL_DISPATCH_DEVICE_FUNC(QueuePresentKHR);
+    return dispatch_table;
+  };
+
+  return GetLayerData()->CreateDevice(physical_device, create_info, allocator,
+                                      device, build_dispatch_table);
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(VkResult, EnumerateInstanceLayerProperties,
+                                 (uint32_t * property_count,
+                                  VkLayerProperties* properties)) {
+  if (property_count) *property_count = 1;
+
+  if (properties) {
+    strncpy(properties->layerName, kLayerName, sizeof(properties->layerName));
+    strncpy(properties->description, kLayerDescription,
+            sizeof(properties->description));
+    properties->implementationVersion = kCommandRecordingLayerVersion;
+    properties->specVersion = VK_API_VERSION_1_0;
+  }
+
+  return VK_SUCCESS;
+}
+
+SPL_COMMAND_RECORDING_LAYER_FUNC(VkResult, EnumerateDeviceLayerProperties,
+                                 (VkPhysicalDevice /* physical_device */,
+                                  uint32_t* property_count,
+                                  VkLayerProperties* properties)) {
+  return CommandRecordingLayer_EnumerateInstanceLayerProperties(property_count,
+                                                                properties);
+}
+
+}  // namespace
+
+SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE(CommandRecordingLayer_,
+                                      SPL_COMMAND_RECORDING_LAYER_FUNCS);
+
+// The *GetProcAddr functions are the entry points to the layers.
+// They return a function pointer for the instance requested by |name|.  We
+// return the functions defined in this layer for those we want to override.
+// Otherwise we call the *GetProcAddr function for the next layer to get the
+// function to be called.
+
+SPL_LAYER_ENTRY_POINT SPL_COMMAND_RECORDING_LAYER_FUNC(PFN_vkVoidFunction,
+                                                       GetDeviceProcAddr,
+                                                       (VkDevice device,
+                                                        const char* name)) {
+  auto* layer_data = GetLayerData();
+
+  PFN_vkGetDeviceProcAddr next_get_proc_addr =
+      layer_data->GetNextDeviceProcAddr(
+          device, &VkLayerDispatchTable::GetDeviceProcAddr);
+  assert(next_get_proc_addr && next_get_proc_addr != VK_NULL_HANDLE);
+  // The functions of the features and extensions that the device didn't
+  // enable are null down the chain, and must stay null.
+  PFN_vkVoidFunction next_func = next_get_proc_addr(device, name);
+  if (!next_func) return nullptr;
+  if (auto func =
+          SPL_GET_INTERCEPTED_VULKAN_FUNC(CommandRecordingLayer_, name)) {
+    return func;
+  }
+  return next_func;
+}
+
+SPL_LAYER_ENTRY_POINT SPL_COMMAND_RECORDING_LAYER_FUNC(PFN_vkVoidFunction,
+                                                       GetInstanceProcAddr,
+                                                       (VkInstance instance,
+                                                        const char* name)) {
+  // The loader looks up the layer's functions here first, before calling any
+  // of them.
+  if (IsLayerOverheadProfilingEnabled()) {
+    GetLayerData()->SetOverheadProfiler(
+        &CommandRecordingLayer_kOverheadProfiler);
+  }
+  if (auto func =
+          SPL_GET_INTERCEPTED_VULKAN_FUNC(CommandRecordingLayer_, name)) {
+    return func;
+  }
+
+  auto* layer_data = GetLayerData();
+
+  PFN_vkGetInstanceProcAddr next_get_proc_addr =
+      layer_data->GetNextInstanceProcAddr(
+          instance, &VkLayerInstanceDispatchTable::GetInstanceProcAddr);
+  assert(next_get_proc_addr && next_get_proc_addr != VK_NULL_HANDLE);
+  return next_get_proc_addr(instance, name);
+}
+
+}  // namespace performancelayers
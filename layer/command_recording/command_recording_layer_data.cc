@@ -0,0 +1,181 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "command_recording_layer_data.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace performancelayers {
+namespace {
+// A thread's last command buffer state lookup. The cached state is valid as
+// long as the layer data's state generation doesn't change.
+struct StateCacheEntry {
+  const CommandRecordingLayerData* layer_data = nullptr;
+  uint64_t generation = 0;
+  VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+  CommandBufferState* state = nullptr;
+};
+
+thread_local StateCacheEntry state_cache;
+}  // namespace
+
+Duration GetCoveredTime(
+    std::vector<std::pair<DurationClock::time_point,
+                          DurationClock::time_point>>* intervals) {
+  std::sort(intervals->begin(), intervals->end());
+  DurationClock::duration covered = DurationClock::duration::zero();
+  auto it = intervals->begin();
+  while (it != intervals->end()) {
+    auto [begin, end] = *it;
+    // Merge the intervals that overlap the current one.
+    for (++it; it != intervals->end() && it->first <= end; ++it)
+      end = std::max(end, it->second);
+    covered += end - begin;
+  }
+  return covered;
+}
+
+CommandBufferState* CommandRecordingLayerData::GetState(
+    VkCommandBuffer command_buffer) {
+  StateCacheEntry& entry = state_cache;
+  // Read the generation before looking up the state, so that a removal racing
+  // with the lookup invalidates the entry.
+  const uint64_t generation =
+      states_generation_.load(std::memory_order_acquire);
+  if (entry.layer_data != this || entry.command_buffer != command_buffer ||
+      entry.generation != generation) {
+    absl::MutexLock lock(&states_lock_);
+    entry = {this, generation, command_buffer, &states_[command_buffer]};
+  }
+  return entry.state;
+}
+
+void CommandRecordingLayerData::AddCommandBuffers(
+    VkCommandPool pool, bool secondary, uint32_t count,
+    const VkCommandBuffer* command_buffers) {
+  absl::MutexLock lock(&states_lock_);
+  for (uint32_t i = 0; i != count; ++i) {
+    CommandBufferState& state = states_[command_buffers[i]];
+    state = {};
+    state.pool = pool;
+    state.secondary = secondary;
+  }
+}
+
+void CommandRecordingLayerData::RemoveCommandBuffers(
+    uint32_t count, const VkCommandBuffer* command_buffers) {
+  absl::MutexLock lock(&states_lock_);
+  states_generation_.fetch_add(1, std::memory_order_release);
+  for (uint32_t i = 0; i != count; ++i) states_.erase(command_buffers[i]);
+}
+
+void CommandRecordingLayerData::RemoveCommandPool(VkCommandPool pool) {
+  absl::MutexLock lock(&states_lock_);
+  states_generation_.fetch_add(1, std::memory_order_release);
+  for (auto it = states_.begin(); it != states_.end();) {
+    if (it->second.pool == pool) {
+      states_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void CommandRecordingLayerData::BeginRecording(VkCommandBuffer command_buffer,
+                                               bool measure) {
+  CommandBufferState* state = GetState(command_buffer);
+  state->recording = measure;
+  if (!measure) return;
+  state->thread_id = GetThreadId();
+  state->begin = Now();
+  state->commands = {};
+}
+
+void CommandRecordingLayerData::EndRecording(VkCommandBuffer command_buffer,
+                                             DurationClock::time_point end,
+                                             bool log_call) {
+  CommandBufferState* state = GetState(command_buffer);
+  if (!state->recording) return;
+  state->recording = false;
+
+  const Duration duration = end - state->begin;
+  const int64_t duration_ns = duration.ToNanoseconds();
+  uint64_t command_count = 0;
+  for (uint64_t count : state->commands.counts) command_count += count;
+  command_buffers_metric_.Add();
+  commands_metric_.Add(static_cast<int64_t>(command_count));
+  recording_time_metric_.Record(duration_ns / 1000);
+
+  {
+    absl::MutexLock lock(&frame_lock_);
+    ++frame_stats_.command_buffer_count;
+    frame_stats_.recording_time_ns += duration_ns;
+    frame_stats_.commands += state->commands;
+    frame_intervals_.emplace_back(state->begin, end);
+    auto [it, inserted] = frame_thread_stats_.try_emplace(state->thread_id);
+    if (inserted) frame_threads_.push_back(state->thread_id);
+    ++it->second.command_buffer_count;
+    it->second.recording_time_ns += duration_ns;
+  }
+
+  if (log_call) {
+    CommandBufferRecordingEvent event("command_buffer_recording",
+                                      command_buffer, *state, duration);
+    LogEvent(&event);
+  }
+}
+
+void CommandRecordingLayerData::RecordPresent() {
+  uint64_t frame = 0;
+  CommandRecordingFrameStats stats;
+  std::vector<std::pair<DurationClock::time_point, DurationClock::time_point>>
+      intervals;
+  std::vector<int64_t> threads;
+  absl::flat_hash_map<int64_t, ThreadRecordingStats> thread_stats;
+  {
+    absl::MutexLock lock(&frame_lock_);
+    frame = frame_++;
+    std::swap(stats, frame_stats_);
+    intervals.swap(frame_intervals_);
+    threads.swap(frame_threads_);
+    thread_stats.swap(frame_thread_stats_);
+  }
+
+  // Summarize and log outside of the lock, so that the recordings of the next
+  // frame don't wait for the logs.
+  stats.thread_count = threads.size();
+  stats.recording_wall_time_ns = GetCoveredTime(&intervals).ToNanoseconds();
+  for (const auto& [thread_id, thread] : thread_stats) {
+    stats.max_thread_recording_time_ns =
+        std::max(stats.max_thread_recording_time_ns, thread.recording_time_ns);
+  }
+
+  CommandRecordingFrameEvent event("command_recording_frame",
+                                   static_cast<int64_t>(frame), stats);
+  LogEvent(&event);
+  for (int64_t thread_id : threads) {
+    assert(thread_stats.contains(thread_id));
+    ThreadRecordingFrameEvent thread_event(
+        "command_recording_thread_frame", static_cast<int64_t>(frame),
+        thread_id, thread_stats[thread_id]);
+    LogEvent(&thread_event);
+  }
+}
+
+}  // namespace performancelayers
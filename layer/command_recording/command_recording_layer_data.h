@@ -0,0 +1,350 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_COMMAND_RECORDING_LAYER_DATA_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_COMMAND_RECORDING_LAYER_DATA_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/node_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "layer/support/event_logging.h"
+#include "layer/support/layer_data.h"
+#include "layer/support/layer_utils.h"
+#include "layer/support/metrics.h"
+
+namespace performancelayers {
+// The kinds of commands counted by the layer.
+enum class CommandCategory {
+  kDraw,
+  kDispatch,
+  // Pipeline, descriptor set, vertex buffer and index buffer bindings.
+  kBind,
+  kBarrier,
+  // Copies, blits, buffer updates and buffer fills.
+  kCopy,
+};
+
+constexpr size_t kNumCommandCategories = 5;
+
+// The number of commands of each category recorded into a command buffer, or
+// into all the command buffers of a frame.
+struct CommandCounts {
+  uint64_t counts[kNumCommandCategories] = {};
+
+  uint64_t Get(CommandCategory category) const {
+    return counts[static_cast<size_t>(category)];
+  }
+
+  CommandCounts& operator+=(const CommandCounts& other) {
+    for (size_t i = 0; i != kNumCommandCategories; ++i)
+      counts[i] += other.counts[i];
+    return *this;
+  }
+};
+
+// The state of one command buffer. Commands are counted without locks or
+// atomics: command buffers are externally synchronized, so only one thread
+// records into a command buffer at a time.
+struct CommandBufferState {
+  VkCommandPool pool = VK_NULL_HANDLE;
+  bool secondary = false;
+  // Set from vkBeginCommandBuffer to vkEndCommandBuffer, unless the recording
+  // began while the layer was off.
+  bool recording = false;
+  // The thread that began the recording, and when.
+  int64_t thread_id = 0;
+  DurationClock::time_point begin;
+  CommandCounts commands;
+};
+
+// Returns the time covered by at least one of the [begin, end] |intervals|.
+// Reorders |intervals|.
+Duration GetCoveredTime(
+    std::vector<std::pair<DurationClock::time_point,
+                          DurationClock::time_point>>* intervals);
+
+// An event that holds one recording of a command buffer, from the start of its
+// vkBeginCommandBuffer to the end of its vkEndCommandBuffer. The trace event
+// spans the recording on the thread that began it.
+class CommandBufferRecordingEvent : public Event {
+ public:
+  CommandBufferRecordingEvent(const char* name, VkCommandBuffer command_buffer,
+                              const CommandBufferState& state,
+                              Duration duration)
+      : Event(name),
+        command_buffer_({"command_buffer",
+                         static_cast<int64_t>(
+                             reinterpret_cast<uintptr_t>(command_buffer))}),
+        secondary_({"secondary", state.secondary}),
+        thread_({"thread", state.thread_id}),
+        draw_count_({"draw_count", GetCount(state, CommandCategory::kDraw)}),
+        dispatch_count_(
+            {"dispatch_count", GetCount(state, CommandCategory::kDispatch)}),
+        bind_count_({"bind_count", GetCount(state, CommandCategory::kBind)}),
+        barrier_count_(
+            {"barrier_count", GetCount(state, CommandCategory::kBarrier)}),
+        copy_count_({"copy_count", GetCount(state, CommandCategory::kCopy)}),
+        duration_("duration", duration),
+        trace_attr_("trace_attr", "command_recording", "X", GetProcessId(),
+                    state.thread_id,
+                    {&command_buffer_, &secondary_, &draw_count_,
+                     &dispatch_count_, &bind_count_, &barrier_count_,
+                     &copy_count_, &duration_}) {
+    InitAttributes({&command_buffer_, &secondary_, &thread_, &draw_count_,
+                    &dispatch_count_, &bind_count_, &barrier_count_,
+                    &copy_count_, &duration_, &trace_attr_});
+  }
+
+ private:
+  static int64_t GetCount(const CommandBufferState& state,
+                          CommandCategory category) {
+    return static_cast<int64_t>(state.commands.Get(category));
+  }
+
+  Int64Attr command_buffer_;
+  BoolAttr secondary_;
+  Int64Attr thread_;
+  Int64Attr draw_count_;
+  Int64Attr dispatch_count_;
+  Int64Attr bind_count_;
+  Int64Attr barrier_count_;
+  Int64Attr copy_count_;
+  DurationAttr duration_;
+  TraceEventAttr trace_attr_;
+};
+
+// The recordings of one thread in one frame.
+struct ThreadRecordingStats {
+  uint64_t command_buffer_count = 0;
+  int64_t recording_time_ns = 0;
+};
+
+// An event that summarizes the recordings of one thread in one frame. The
+// trace event is on the thread's track.
+class ThreadRecordingFrameEvent : public Event {
+ public:
+  ThreadRecordingFrameEvent(const char* name, int64_t frame, int64_t thread_id,
+                            const ThreadRecordingStats& stats)
+      : Event(name, LogLevel::kMedium),
+        frame_({"frame", frame}),
+        thread_({"thread", thread_id}),
+        command_buffer_count_(
+            {"command_buffer_count",
+             static_cast<int64_t>(stats.command_buffer_count)}),
+        recording_time_("recording_time",
+                        Duration::FromNanoseconds(stats.recording_time_ns)),
+        trace_attr_("trace_attr", "command_recording", "i", GetProcessId(),
+                    thread_id,
+                    {&scope_, &frame_, &command_buffer_count_,
+                     &recording_time_}) {
+    InitAttributes({&frame_, &thread_, &command_buffer_count_,
+                    &recording_time_, &trace_attr_});
+  }
+
+ private:
+  Int64Attr frame_;
+  Int64Attr thread_;
+  Int64Attr command_buffer_count_;
+  DurationAttr recording_time_;
+  // `Perfetto` displays the args only for instant events with thread-level
+  // scope.
+  StringAttr scope_{"scope", "t"};
+  TraceEventAttr trace_attr_;
+};
+
+// The recordings of all threads in one frame.
+struct CommandRecordingFrameStats {
+  uint64_t command_buffer_count = 0;
+  uint64_t thread_count = 0;
+  // The recording times summed over all command buffers.
+  int64_t recording_time_ns = 0;
+  // The time during which at least one command buffer was being recorded.
+  int64_t recording_wall_time_ns = 0;
+  // The recording time of the busiest thread.
+  int64_t max_thread_recording_time_ns = 0;
+  CommandCounts commands;
+};
+
+// An event that summarizes the recordings of one frame. The parallelism is the
+// recording time over the recording wall time, in percent: 100 when the
+// command buffers are recorded one after the other, 400 when four threads
+// record at all times.
+class CommandRecordingFrameEvent : public Event {
+ public:
+  CommandRecordingFrameEvent(const char* name, int64_t frame,
+                             const CommandRecordingFrameStats& stats)
+      : Event(name, LogLevel::kHigh),
+        frame_({"frame", frame}),
+        command_buffer_count_(
+            {"command_buffer_count",
+             static_cast<int64_t>(stats.command_buffer_count)}),
+        thread_count_(
+            {"thread_count", static_cast<int64_t>(stats.thread_count)}),
+        recording_time_("recording_time",
+                        Duration::FromNanoseconds(stats.recording_time_ns)),
+        recording_wall_time_(
+            "recording_wall_time",
+            Duration::FromNanoseconds(stats.recording_wall_time_ns)),
+        max_thread_recording_time_(
+            "max_thread_recording_time",
+            Duration::FromNanoseconds(stats.max_thread_recording_time_ns)),
+        parallelism_({"parallelism", GetParallelism(stats)}),
+        draw_count_({"draw_count", GetCount(stats, CommandCategory::kDraw)}),
+        dispatch_count_(
+            {"dispatch_count", GetCount(stats, CommandCategory::kDispatch)}),
+        bind_count_({"bind_count", GetCount(stats, CommandCategory::kBind)}),
+        barrier_count_(
+            {"barrier_count", GetCount(stats, CommandCategory::kBarrier)}),
+        copy_count_({"copy_count", GetCount(stats, CommandCategory::kCopy)}),
+        trace_attr_("trace_attr", "command_recording", "i",
+                    {&scope_, &frame_, &command_buffer_count_, &thread_count_,
+                     &recording_time_, &recording_wall_time_,
+                     &max_thread_recording_time_, &parallelism_, &draw_count_,
+                     &dispatch_count_, &bind_count_, &barrier_count_,
+                     &copy_count_}) {
+    InitAttributes({&frame_, &command_buffer_count_, &thread_count_,
+                    &recording_time_, &recording_wall_time_,
+                    &max_thread_recording_time_, &parallelism_, &draw_count_,
+                    &dispatch_count_, &bind_count_, &barrier_count_,
+                    &copy_count_, &trace_attr_});
+  }
+
+ private:
+  static int64_t GetCount(const CommandRecordingFrameStats& stats,
+                          CommandCategory category) {
+    return static_cast<int64_t>(stats.commands.Get(category));
+  }
+
+  static int64_t GetParallelism(const CommandRecordingFrameStats& stats) {
+    if (stats.recording_wall_time_ns == 0) return 0;
+    return stats.recording_time_ns * 100 / stats.recording_wall_time_ns;
+  }
+
+  Int64Attr frame_;
+  Int64Attr command_buffer_count_;
+  Int64Attr thread_count_;
+  DurationAttr recording_time_;
+  DurationAttr recording_wall_time_;
+  DurationAttr max_thread_recording_time_;
+  Int64Attr parallelism_;
+  Int64Attr draw_count_;
+  Int64Attr dispatch_count_;
+  Int64Attr bind_count_;
+  Int64Attr barrier_count_;
+  Int64Attr copy_count_;
+  // `Perfetto` displays the args only for instant events with thread-level
+  // scope.
+  StringAttr scope_{"scope", "t"};
+  TraceEventAttr trace_attr_;
+};
+
+// A class that contains all of the data that is needed for the functions
+// that this layer will override.
+//
+// Every recording of a command buffer is logged to the event logs, and, at
+// every present, the recordings that ended in the frame are summarized in the
+// layer's log file, the "command_recording.log" setting of the `LayerConfig`,
+// and per thread in the event logs. Recorded commands are counted in the
+// state of their command buffer, which each thread caches, so that counting
+// a command takes no lock and reads no clock.
+class CommandRecordingLayerData : public LayerData {
+ public:
+  explicit CommandRecordingLayerData(const char* log_filename)
+      : LayerData(log_filename,
+                  "Frame,Command Buffers,Threads,Recording Time "
+                  "(ns),Recording Wall Time (ns),Max Thread Recording Time "
+                  "(ns),Parallelism (%),Draws,Dispatches,Binds,Barriers,"
+                  "Copies") {
+    LayerInitEvent event("command_recording_layer_init", "command_recording");
+    LogEvent(&event);
+    StartControl("command_recording");
+  }
+
+  // Adds the |count| |command_buffers| allocated from |pool|.
+  void AddCommandBuffers(VkCommandPool pool, bool secondary, uint32_t count,
+                         const VkCommandBuffer* command_buffers);
+
+  // Removes the |count| freed |command_buffers|.
+  void RemoveCommandBuffers(uint32_t count,
+                            const VkCommandBuffer* command_buffers);
+
+  // Removes the command buffers of the destroyed |pool|.
+  void RemoveCommandPool(VkCommandPool pool);
+
+  // Starts a recording of |command_buffer| on the calling thread. The
+  // recording is not measured if |measure| is false, e.g., when the layer is
+  // off.
+  void BeginRecording(VkCommandBuffer command_buffer, bool measure);
+
+  // Counts a command of |category| recorded into |command_buffer|.
+  void CountCommand(VkCommandBuffer command_buffer, CommandCategory category) {
+    CommandBufferState* state = GetState(command_buffer);
+    if (state->recording) {
+      ++state->commands.counts[static_cast<size_t>(category)];
+    }
+  }
+
+  // Ends the recording of |command_buffer| at |end|, and adds it to the
+  // frame. Logs the recording if |log_call| is set.
+  void EndRecording(VkCommandBuffer command_buffer,
+                    DurationClock::time_point end, bool log_call);
+
+  // Logs the recordings of the frame that ends, and starts a new frame.
+  // Recordings are counted in the frame they end in.
+  void RecordPresent();
+
+ private:
+  // Returns the state of |command_buffer|, adding it if the layer didn't see
+  // it allocated. Each thread caches the last state it looked up, so that the
+  // commands recorded into a command buffer, the common case, take neither
+  // the lock nor a hash map lookup. Removing command buffers invalidates the
+  // cached states of all threads.
+  CommandBufferState* GetState(VkCommandBuffer command_buffer);
+
+  absl::Mutex states_lock_;
+  // The states are cached by address, so they must not move.
+  absl::node_hash_map<VkCommandBuffer, CommandBufferState> states_
+      ABSL_GUARDED_BY(states_lock_);
+  // Incremented whenever command buffers are removed, to invalidate the
+  // cached states.
+  std::atomic<uint64_t> states_generation_ = 0;
+
+  absl::Mutex frame_lock_;
+  uint64_t frame_ ABSL_GUARDED_BY(frame_lock_) = 0;
+  CommandRecordingFrameStats frame_stats_ ABSL_GUARDED_BY(frame_lock_);
+  // The recordings that ended in the current frame.
+  std::vector<std::pair<DurationClock::time_point, DurationClock::time_point>>
+      frame_intervals_ ABSL_GUARDED_BY(frame_lock_);
+  // The threads that recorded in the current frame, and their recordings.
+  std::vector<int64_t> frame_threads_ ABSL_GUARDED_BY(frame_lock_);
+  absl::flat_hash_map<int64_t, ThreadRecordingStats> frame_thread_stats_
+      ABSL_GUARDED_BY(frame_lock_);
+
+  Counter command_buffers_metric_ = MetricsRegistry::Get()->GetCounter(
+      "command_recording_command_buffers_total");
+  Counter commands_metric_ =
+      MetricsRegistry::Get()->GetCounter("command_recording_commands_total");
+  Histogram recording_time_metric_ =
+      MetricsRegistry::Get()->GetHistogram("command_recording_time_us");
+};
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_COMMAND_RECORDING_LAYER_DATA_H_
@@ -12,19 +12,23 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
-#include <cstdlib>
 #include <cstring>
 #include <functional>
 #include <iomanip>
 #include <optional>
-#include <sstream>
 #include <string>
 
+#include "absl/base/attributes.h"
+#include "layer/support/call_site_profiler.h"
 #include "layer/support/event_logging.h"
+#include "layer/support/layer_config.h"
 #include "layer/support/layer_data.h"
 #include "layer/support/layer_utils.h"
+#include "layer/support/log_output.h"
+#include "layer/support/metrics.h"
 #include "layer/support/trace_event_logging.h"
 
 namespace performancelayers {
@@ -37,7 +41,6 @@ constexpr uint32_t kCompileTimeLayerVersion = 1;
 constexpr char kLayerName[] = "VK_LAYER_STADIA_pipeline_compile_time";
 constexpr char kLayerDescription[] =
     "Stadia Pipeline Compile Time Measuring Layer";
-constexpr char kLogFilenameEnvVar[] = "VK_COMPILE_TIME_LOG";
 constexpr char kTraceEventCategory[] = "compile_time_layer";
 
 class CompileTimeEvent : public Event {
@@ -95,12 +98,43 @@ class CreateShaderEvent : public Event {
 
 class CompileTimeLayerData : public LayerData {
  public:
-  CompileTimeLayerData(char* log_filename)
-      : LayerData(log_filename, "Pipeline,Compile Time (ns)") {
+  // Every |call_site_sample_us| microseconds spent creating pipelines, the
+  // stack of the creating call is captured, and the stacks are written to
+  // |call_site_log| when the layer is unloaded. 0 disables the sampling.
+  CompileTimeLayerData(const char* log_filename, uint64_t call_site_sample_us,
+                       const char* call_site_log)
+      : LayerData(log_filename, "Pipeline,Compile Time (ns)"),
+        call_sites_(call_site_sample_us, kCallSiteSkipFrames),
+        call_site_log_(call_site_log) {
     LayerInitEvent event("compile_time_layer_init", kTraceEventCategory);
     LogEvent(&event);
+    StartControl("compile_time");
   }
 
+  ~CompileTimeLayerData() {
+    if (!call_sites_.IsEnabled()) return;
+    FileOutput out(call_site_log_);
+    call_sites_.WriteFoldedStacks(&out);
+  }
+
+  // Charges the stack of the current pipeline creation call with |duration|.
+  // Not inlined, so that the number of the layer's own frames is fixed.
+  ABSL_ATTRIBUTE_NOINLINE void RecordPipelineCallSite(Duration duration) {
+    call_sites_.Record(
+        static_cast<uint64_t>(std::max<int64_t>(duration.ToNanoseconds(), 0)) /
+        1000);
+  }
+
+  // Records the creation of |pipeline_count| pipelines in one call that took
+  // |duration| in the live metrics.
+  void RecordPipelineMetrics(uint32_t pipeline_count, Duration duration) {
+    pipelines_metric_.Add(pipeline_count);
+    pipeline_creation_metric_.Record(duration.ToNanoseconds() / 1000);
+  }
+
+  // Records the creation of a shader module in the live metrics.
+  void RecordShaderModuleMetrics() { shader_modules_metric_.Add(); }
+
   // Used to track the slack between shader module creation and its first use
   // in pipeline creation.
   struct ShaderModuleSlack {
@@ -149,11 +183,27 @@ class CompileTimeLayerData : public LayerData {
   // Map from  shader module handles to their usage info.
   absl::flat_hash_map<VkShaderModule, ShaderModuleSlack> shader_module_to_usage_
       ABSL_GUARDED_BY(shader_module_usage_lock_);
+
+  Counter pipelines_metric_ =
+      MetricsRegistry::Get()->GetCounter("compile_time_pipelines_total");
+  Histogram pipeline_creation_metric_ =
+      MetricsRegistry::Get()->GetHistogram("compile_time_pipeline_creation_us");
+  Counter shader_modules_metric_ =
+      MetricsRegistry::Get()->GetCounter("compile_time_shader_modules_total");
+
+  // The layer's own frames in the sampled stacks: RecordPipelineCallSite and
+  // the pipeline creation override.
+  static constexpr size_t kCallSiteSkipFrames = 2;
+  CallSiteProfiler call_sites_;
+  const char* call_site_log_;
 };
 
 CompileTimeLayerData* GetLayerData() {
+  const LayerConfig::CompileTime& config = GetLayerConfig().compile_time;
   // Don't use new -- make the destructor run when the layer gets unloaded.
-  static CompileTimeLayerData layer_data(getenv(kLogFilenameEnvVar));
+  static CompileTimeLayerData layer_data(NullIfEmpty(config.log),
+                                         config.call_site_sample_us,
+                                         NullIfEmpty(config.call_site_log));
   return &layer_data;
 }
 
@@ -162,6 +212,25 @@ CompileTimeLayerData* GetLayerData() {
   SPL_INTERCEPTED_VULKAN_FUNC(RETURN_TYPE_, CompileTimeLayer_, FUNC_NAME_, \
                               FUNC_ARGS_)
 
+// The functions intercepted by the layer, defined below with
+// SPL_COMPILE_TIME_LAYER_FUNC.
+#define SPL_COMPILE_TIME_LAYER_FUNCS(X_, LAYER_PREFIX_) \
+  X_(LAYER_PREFIX_, DestroyInstance)                    \
+  X_(LAYER_PREFIX_, CreateInstance)                     \
+  X_(LAYER_PREFIX_, CreateComputePipelines)             \
+  X_(LAYER_PREFIX_, CreateGraphicsPipelines)            \
+  X_(LAYER_PREFIX_, CreateShaderModule)                 \
+  X_(LAYER_PREFIX_, DestroyShaderModule)                \
+  X_(LAYER_PREFIX_, DestroyDevice)                      \
+  X_(LAYER_PREFIX_, CreateDevice)                       \
+  X_(LAYER_PREFIX_, EnumerateInstanceLayerProperties)   \
+  X_(LAYER_PREFIX_, EnumerateDeviceLayerProperties)     \
+  X_(LAYER_PREFIX_, GetDeviceProcAddr)                  \
+  X_(LAYER_PREFIX_, GetInstanceProcAddr)
+
+SPL_DECLARE_INTERCEPTED_FUNCTIONS(CompileTimeLayer_,
+                                  SPL_COMPILE_TIME_LAYER_FUNCS);
+
 //////////////////////////////////////////////////////////////////////////////
 //  Implementation of the instance functions we want to override.
 //////////////////////////////////////////////////////////////////////////////
@@ -219,11 +288,18 @@ SPL_COMPILE_TIME_LAYER_FUNC(VkResult, CreateComputePipelines,
   assert(create_info_count > 0 &&
          "Specification says create_info_count must be > 0.");
 
+  if (!layer_data->ShouldInstrument()) {
+    return next_proc(device, pipeline_cache, create_info_count, create_infos,
+                     alloc_callbacks, pipelines);
+  }
+
   DurationClock::time_point start = Now();
   auto result = next_proc(device, pipeline_cache, create_info_count,
                           create_infos, alloc_callbacks, pipelines);
   DurationClock::time_point end = Now();
   Duration duration = end - start;
+  layer_data->RecordPipelineCallSite(duration);
+  layer_data->RecordPipelineMetrics(create_info_count, duration);
 
   LayerData::HashVector hashes;
   for (uint32_t i = 0; i < create_info_count; ++i) {
@@ -260,11 +336,18 @@ SPL_COMPILE_TIME_LAYER_FUNC(VkResult, CreateGraphicsPipelines,
   assert(create_info_count > 0 &&
          "Specification says create_info_count must be > 0.");
 
+  if (!layer_data->ShouldInstrument()) {
+    return next_proc(device, pipeline_cache, create_info_count, create_infos,
+                     alloc_callbacks, pipelines);
+  }
+
   DurationClock::time_point start = Now();
   auto result = next_proc(device, pipeline_cache, create_info_count,
                           create_infos, alloc_callbacks, pipelines);
   DurationClock::time_point end = Now();
   Duration duration = end - start;
+  layer_data->RecordPipelineCallSite(duration);
+  layer_data->RecordPipelineMetrics(create_info_count, duration);
 
   LayerData::HashVector hashes;
   for (uint32_t i = 0; i < create_info_count; ++i) {
@@ -290,7 +373,8 @@ SPL_COMPILE_TIME_LAYER_FUNC(VkResult, CreateGraphicsPipelines,
 }
 
 // Override for vkCreateShaderModule.  Records the hash of the shader module in
-// the layer data.
+// the layer data, even if the call is not instrumented, so that the pipelines
+// using the shader module can be instrumented.
 SPL_COMPILE_TIME_LAYER_FUNC(VkResult, CreateShaderModule,
                             (VkDevice device,
                              const VkShaderModuleCreateInfo* create_info,
@@ -307,7 +391,10 @@ SPL_COMPILE_TIME_LAYER_FUNC(VkResult, CreateShaderModule,
     layer_data->RecordShaderModuleCreation(*shader_module,
                                            event.GetCreationTime().GetValue());
 
-    layer_data->LogEvent(&event);
+    if (layer_data->ShouldInstrument()) {
+      layer_data->LogEvent(&event);
+      layer_data->RecordShaderModuleMetrics();
+    }
   }
   return res.result;
 }
@@ -383,6 +470,9 @@ SPL_COMPILE_TIME_LAYER_FUNC(VkResult, EnumerateDeviceLayerProperties,
 
 }  // namespace
 
+SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE(CompileTimeLayer_,
+                                      SPL_COMPILE_TIME_LAYER_FUNCS);
+
 // The *GetProcAddr functions are the entry points to the layers.
 // They return a function pointer for the instance requested by |name|.  We
 // return the functions defined in this layer for those we want to override.
@@ -392,24 +482,32 @@ SPL_COMPILE_TIME_LAYER_FUNC(VkResult, EnumerateDeviceLayerProperties,
 SPL_LAYER_ENTRY_POINT
 SPL_COMPILE_TIME_LAYER_FUNC(PFN_vkVoidFunction, GetDeviceProcAddr,
                             (VkDevice device, const char* name)) {
-  if (auto func = FunctionInterceptor::GetInterceptedOrNull(name)) {
-    return func;
-  }
-
   CompileTimeLayerData* layer_data = GetLayerData();
 
   PFN_vkGetDeviceProcAddr next_get_proc_addr =
       layer_data->GetNextDeviceProcAddr(
           device, &VkLayerDispatchTable::GetDeviceProcAddr);
   assert(next_get_proc_addr && next_get_proc_addr != VK_NULL_HANDLE);
-  return next_get_proc_addr(device, name);
+  // The functions of the features and extensions that the device didn't
+  // enable are null down the chain, and must stay null.
+  PFN_vkVoidFunction next_func = next_get_proc_addr(device, name);
+  if (!next_func) return nullptr;
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(CompileTimeLayer_, name)) {
+    return func;
+  }
+  return next_func;
 }
 
 SPL_LAYER_ENTRY_POINT SPL_COMPILE_TIME_LAYER_FUNC(PFN_vkVoidFunction,
                                                   GetInstanceProcAddr,
                                                   (VkInstance instance,
                                                    const char* name)) {
-  if (auto func = FunctionInterceptor::GetInterceptedOrNull(name)) {
+  // The loader looks up the layer's functions here first, before calling any
+  // of them.
+  if (IsLayerOverheadProfilingEnabled()) {
+    GetLayerData()->SetOverheadProfiler(&CompileTimeLayer_kOverheadProfiler);
+  }
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(CompileTimeLayer_, name)) {
     return func;
   }
 
@@ -0,0 +1,501 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "descriptor_layer_data.h"
+#include "layer/support/layer_config.h"
+#include "layer/support/layer_data.h"
+#include "layer/support/layer_utils.h"
+
+namespace performancelayers {
+namespace {
+// ----------------------------------------------------------------------------
+// Layer book-keeping information
+// ----------------------------------------------------------------------------
+
+constexpr uint32_t kDescriptorLayerVersion = 1;
+constexpr char kLayerName[] = "VK_LAYER_STADIA_descriptor";
+constexpr char kLayerDescription[] =
+    "Stadia Descriptor Update And Allocation Measuring Layer";
+
+DescriptorLayerData* GetLayerData() {
+  // Don't use new -- make the destructor run when the layer gets unloaded.
+  const LayerConfig::Descriptor& config = GetLayerConfig().descriptor;
+  static DescriptorLayerData layer_data(NullIfEmpty(config.log),
+                                        config.call_site_sample_us,
+                                        NullIfEmpty(config.call_site_log));
+  return &layer_data;
+}
+
+// Use this macro to define all vulkan functions intercepted by the layer.
+#define SPL_DESCRIPTOR_LAYER_FUNC(RETURN_TYPE_, FUNC_NAME_, FUNC_ARGS_)   \
+  SPL_INTERCEPTED_VULKAN_FUNC(RETURN_TYPE_, DescriptorLayer_, FUNC_NAME_, \
+                              FUNC_ARGS_)
+
+// The functions intercepted by the layer, defined below with
+// SPL_DESCRIPTOR_LAYER_FUNC.
+#define SPL_DESCRIPTOR_LAYER_FUNCS(X_, LAYER_PREFIX_)   \
+  X_(LAYER_PREFIX_, CreateDescriptorSetLayout)          \
+  X_(LAYER_PREFIX_, DestroyDescriptorSetLayout)         \
+  X_(LAYER_PREFIX_, CreateDescriptorPool)               \
+  X_(LAYER_PREFIX_, DestroyDescriptorPool)              \
+  X_(LAYER_PREFIX_, CreateDescriptorUpdateTemplate)     \
+  X_(LAYER_PREFIX_, CreateDescriptorUpdateTemplateKHR)  \
+  X_(LAYER_PREFIX_, DestroyDescriptorUpdateTemplate)    \
+  X_(LAYER_PREFIX_, DestroyDescriptorUpdateTemplateKHR) \
+  X_(LAYER_PREFIX_, UpdateDescriptorSets)               \
+  X_(LAYER_PREFIX_, UpdateDescriptorSetWithTemplate)    \
+  X_(LAYER_PREFIX_, UpdateDescriptorSetWithTemplateKHR) \
+  X_(LAYER_PREFIX_, AllocateDescriptorSets)             \
+  X_(LAYER_PREFIX_, FreeDescriptorSets)                 \
+  X_(LAYER_PREFIX_, ResetDescriptorPool)                \
+  X_(LAYER_PREFIX_, QueuePresentKHR)                    \
+  X_(LAYER_PREFIX_, DestroyInstance)                    \
+  X_(LAYER_PREFIX_, CreateInstance)                     \
+  X_(LAYER_PREFIX_, DestroyDevice)                      \
+  X_(LAYER_PREFIX_, CreateDevice)                       \
+  X_(LAYER_PREFIX_, EnumerateInstanceLayerProperties)   \
+  X_(LAYER_PREFIX_, EnumerateDeviceLayerProperties)     \
+  X_(LAYER_PREFIX_, GetDeviceProcAddr)                  \
+  X_(LAYER_PREFIX_, GetInstanceProcAddr)
+
+SPL_DECLARE_INTERCEPTED_FUNCTIONS(DescriptorLayer_, SPL_DESCRIPTOR_LAYER_FUNCS);
+
+//////////////////////////////////////////////////////////////////////////////
+//  Implementation of the instance functions we want to override.
+//////////////////////////////////////////////////////////////////////////////
+
+// Override for vkDestroyInstance.  Deletes the entry for |instance| from the
+// layer data.
+SPL_DESCRIPTOR_LAYER_FUNC(void, DestroyInstance,
+                          (VkInstance instance,
+                           const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextInstanceProcAddr(
+      instance, &VkLayerInstanceDispatchTable::DestroyInstance);
+  layer_data->RemoveInstance(instance);
+  next_proc(instance, allocator);
+}
+
+// Override for vkCreateInstance.  Creates the dispatch table for this instance
+// and add it to the layer data.
+SPL_DESCRIPTOR_LAYER_FUNC(VkResult, CreateInstance,
+                          (const VkInstanceCreateInfo* create_info,
+                           const VkAllocationCallbacks* allocator,
+                           VkInstance* instance)) {
+  auto build_dispatch_table =
+      [instance](PFN_vkGetInstanceProcAddr get_proc_addr) {
+        // Build dispatch table for the instance functions we need to call.
+        VkLayerInstanceDispatchTable dispatch_table{};
+
+        // Get the next layer's instance of the instance functions we will
+        // override.
+        SPL_DISPATCH_INSTANCE_FUNC(DestroyInstance);
+        SPL_DISPATCH_INSTANCE_FUNC(GetInstanceProcAddr);
+        return dispatch_table;
+      };
+
+  return GetLayerData()->CreateInstance(create_info, allocator, instance,
+                                        build_dispatch_table);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//  Implementation of the device function we want to override.
+//////////////////////////////////////////////////////////////////////////////
+
+// Override for vkCreateDescriptorSetLayout.  Records the descriptors of the
+// layout, even when the layer is off, so that the sets allocated with it are
+// accounted for in their pool if it is switched on.
+SPL_DESCRIPTOR_LAYER_FUNC(VkResult, CreateDescriptorSetLayout,
+                          (VkDevice device,
+                           const VkDescriptorSetLayoutCreateInfo* create_info,
+                           const VkAllocationCallbacks* allocator,
+                           VkDescriptorSetLayout* set_layout)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreateDescriptorSetLayout);
+  VkResult result = next_proc(device, create_info, allocator, set_layout);
+  if (result == VK_SUCCESS) layer_data->AddSetLayout(*set_layout, *create_info);
+  return result;
+}
+
+// Override for vkDestroyDescriptorSetLayout.  Removes the layout from the layer
+// data.
+SPL_DESCRIPTOR_LAYER_FUNC(void, DestroyDescriptorSetLayout,
+                          (VkDevice device, VkDescriptorSetLayout set_layout,
+                           const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyDescriptorSetLayout);
+  layer_data->RemoveSetLayout(set_layout);
+  next_proc(device, set_layout, allocator);
+}
+
+// Override for vkCreateDescriptorPool.  Records the capacity of the pool.
+SPL_DESCRIPTOR_LAYER_FUNC(VkResult, CreateDescriptorPool,
+                          (VkDevice device,
+                           const VkDescriptorPoolCreateInfo* create_info,
+                           const VkAllocationCallbacks* allocator,
+                           VkDescriptorPool* pool)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreateDescriptorPool);
+  VkResult result = next_proc(device, create_info, allocator, pool);
+  if (result == VK_SUCCESS) layer_data->AddPool(*pool, *create_info);
+  return result;
+}
+
+// Override for vkDestroyDescriptorPool.  Removes the pool from the layer data.
+SPL_DESCRIPTOR_LAYER_FUNC(void, DestroyDescriptorPool,
+                          (VkDevice device, VkDescriptorPool pool,
+                           const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyDescriptorPool);
+  layer_data->RemovePool(pool);
+  next_proc(device, pool, allocator);
+}
+
+// Override for vkCreateDescriptorUpdateTemplate.  Records the descriptors the
+// template writes.
+SPL_DESCRIPTOR_LAYER_FUNC(
+    VkResult, CreateDescriptorUpdateTemplate,
+    (VkDevice device, const VkDescriptorUpdateTemplateCreateInfo* create_info,
+     const VkAllocationCallbacks* allocator,
+     VkDescriptorUpdateTemplate* update_template)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreateDescriptorUpdateTemplate);
+  VkResult result = next_proc(device, create_info, allocator, update_template);
+  if (result == VK_SUCCESS)
+    layer_data->AddUpdateTemplate(*update_template, *create_info);
+  return result;
+}
+
+// Override for vkCreateDescriptorUpdateTemplateKHR.  Like
+// vkCreateDescriptorUpdateTemplate, for devices that only expose
+// VK_KHR_descriptor_update_template.
+SPL_DESCRIPTOR_LAYER_FUNC(
+    VkResult, CreateDescriptorUpdateTemplateKHR,
+    (VkDevice device, const VkDescriptorUpdateTemplateCreateInfo* create_info,
+     const VkAllocationCallbacks* allocator,
+     VkDescriptorUpdateTemplate* update_template)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreateDescriptorUpdateTemplateKHR);
+  VkResult result = next_proc(device, create_info, allocator, update_template);
+  if (result == VK_SUCCESS)
+    layer_data->AddUpdateTemplate(*update_template, *create_info);
+  return result;
+}
+
+// Override for vkDestroyDescriptorUpdateTemplate.  Removes the template from
+// the layer data.
+SPL_DESCRIPTOR_LAYER_FUNC(void, DestroyDescriptorUpdateTemplate,
+                          (VkDevice device,
+                           VkDescriptorUpdateTemplate update_template,
+                           const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyDescriptorUpdateTemplate);
+  layer_data->RemoveUpdateTemplate(update_template);
+  next_proc(device, update_template, allocator);
+}
+
+// Override for vkDestroyDescriptorUpdateTemplateKHR.  Like
+// vkDestroyDescriptorUpdateTemplate.
+SPL_DESCRIPTOR_LAYER_FUNC(void, DestroyDescriptorUpdateTemplateKHR,
+                          (VkDevice device,
+                           VkDescriptorUpdateTemplate update_template,
+                           const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyDescriptorUpdateTemplateKHR);
+  layer_data->RemoveUpdateTemplate(update_template);
+  next_proc(device, update_template, allocator);
+}
+
+// Override for vkUpdateDescriptorSets.  Measures the call and counts the
+// descriptors it writes, by descriptor type, and copies.
+SPL_DESCRIPTOR_LAYER_FUNC(void, UpdateDescriptorSets,
+                          (VkDevice device, uint32_t write_count,
+                           const VkWriteDescriptorSet* writes,
+                           uint32_t copy_count,
+                           const VkCopyDescriptorSet* copies)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::UpdateDescriptorSets);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(device, write_count, writes, copy_count, copies);
+
+  DurationClock::time_point start = Now();
+  next_proc(device, write_count, writes, copy_count, copies);
+  Duration duration = Now() - start;
+  layer_data->RecordCallSite(duration);
+  layer_data->RecordUpdate(write_count, writes, copy_count, duration,
+                           layer_data->ShouldInstrument());
+}
+
+// Override for vkUpdateDescriptorSetWithTemplate.  Measures the call and
+// counts the descriptors the template writes, by descriptor type.
+SPL_DESCRIPTOR_LAYER_FUNC(void, UpdateDescriptorSetWithTemplate,
+                          (VkDevice device, VkDescriptorSet set,
+                           VkDescriptorUpdateTemplate update_template,
+                           const void* data)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::UpdateDescriptorSetWithTemplate);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(device, set, update_template, data);
+
+  DurationClock::time_point start = Now();
+  next_proc(device, set, update_template, data);
+  Duration duration = Now() - start;
+  layer_data->RecordCallSite(duration);
+  layer_data->RecordTemplateUpdate(update_template, duration,
+                                   layer_data->ShouldInstrument());
+}
+
+// Override for vkUpdateDescriptorSetWithTemplateKHR.  Like
+// vkUpdateDescriptorSetWithTemplate.
+SPL_DESCRIPTOR_LAYER_FUNC(void, UpdateDescriptorSetWithTemplateKHR,
+                          (VkDevice device, VkDescriptorSet set,
+                           VkDescriptorUpdateTemplate update_template,
+                           const void* data)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::UpdateDescriptorSetWithTemplateKHR);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(device, set, update_template, data);
+
+  DurationClock::time_point start = Now();
+  next_proc(device, set, update_template, data);
+  Duration duration = Now() - start;
+  layer_data->RecordCallSite(duration);
+  layer_data->RecordTemplateUpdate(update_template, duration,
+                                   layer_data->ShouldInstrument());
+}
+
+// Override for vkAllocateDescriptorSets.  Measures the call and adds the sets
+// to their pool, even when the layer is off, so that the pool usage is right
+// if it is switched on. Failures are logged with the state of the pool.
+SPL_DESCRIPTOR_LAYER_FUNC(VkResult, AllocateDescriptorSets,
+                          (VkDevice device,
+                           const VkDescriptorSetAllocateInfo* allocate_info,
+                           VkDescriptorSet* sets)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::AllocateDescriptorSets);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff) {
+    VkResult result = next_proc(device, allocate_info, sets);
+    if (result == VK_SUCCESS) layer_data->AddSets(*allocate_info, sets);
+    return result;
+  }
+
+  DurationClock::time_point start = Now();
+  VkResult result = next_proc(device, allocate_info, sets);
+  Duration duration = Now() - start;
+  if (result == VK_SUCCESS) layer_data->AddSets(*allocate_info, sets);
+  layer_data->RecordCallSite(duration);
+  layer_data->RecordAllocate(*allocate_info, result, duration,
+                             layer_data->ShouldInstrument());
+  return result;
+}
+
+// Override for vkFreeDescriptorSets.  Measures the call and removes the sets
+// from their pool. The sets are removed before the call, as their handles may
+// be allocated again as soon as it returns.
+SPL_DESCRIPTOR_LAYER_FUNC(VkResult, FreeDescriptorSets,
+                          (VkDevice device, VkDescriptorPool pool,
+                           uint32_t set_count, const VkDescriptorSet* sets)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::FreeDescriptorSets);
+  layer_data->RemoveSets(pool, set_count, sets);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(device, pool, set_count, sets);
+
+  DurationClock::time_point start = Now();
+  VkResult result = next_proc(device, pool, set_count, sets);
+  Duration duration = Now() - start;
+  layer_data->RecordCallSite(duration);
+  layer_data->RecordPoolCall("free_descriptor_sets", DescriptorCall::kFree,
+                             pool, set_count, result, duration,
+                             layer_data->ShouldInstrument());
+  return result;
+}
+
+// Override for vkResetDescriptorPool.  Measures the call and removes all the
+// sets from the pool.
+SPL_DESCRIPTOR_LAYER_FUNC(VkResult, ResetDescriptorPool,
+                          (VkDevice device, VkDescriptorPool pool,
+                           VkDescriptorPoolResetFlags flags)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::ResetDescriptorPool);
+  const uint64_t set_count = layer_data->ResetPool(pool);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(device, pool, flags);
+
+  DurationClock::time_point start = Now();
+  VkResult result = next_proc(device, pool, flags);
+  Duration duration = Now() - start;
+  layer_data->RecordCallSite(duration);
+  layer_data->RecordPoolCall("reset_descriptor_pool", DescriptorCall::kReset,
+                             pool, set_count, result, duration,
+                             layer_data->ShouldInstrument());
+  return result;
+}
+
+// Override for vkQueuePresentKHR.  Logs the waits of the frame.
+SPL_DESCRIPTOR_LAYER_FUNC(VkResult, QueuePresentKHR,
+                          (VkQueue queue,
+                           const VkPresentInfoKHR* present_info)) {
+  auto* layer_data = GetLayerData();
+  layer_data->RecordPresent();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      queue, &VkLayerDispatchTable::QueuePresentKHR);
+  return next_proc(queue, present_info);
+}
+
+// Override for vkDestroyDevice.  Removes the dispatch table for the device from
+// the layer data.
+SPL_DESCRIPTOR_LAYER_FUNC(void, DestroyDevice,
+                          (VkDevice device,
+                           const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyDevice);
+  layer_data->RemoveDevice(device);
+  next_proc(device, allocator);
+}
+
+// Override for vkCreateDevice.  Builds the dispatch table for the new device
+// and add it to the layer data.
+SPL_DESCRIPTOR_LAYER_FUNC(VkResult, CreateDevice,
+                          (VkPhysicalDevice physical_device,
+                           const VkDeviceCreateInfo* create_info,
+                           const VkAllocationCallbacks* allocator,
+                           VkDevice* device)) {
+  auto build_dispatch_table = [device](PFN_vkGetDeviceProcAddr gdpa) {
+    VkLayerDispatchTable dispatch_table{};
+
+    // Get the next layer's instance of the device functions we will override.
+    // The *KHR functions are null unless the device exposes
+    // VK_KHR_descriptor_update_template.
+    SPL_DISPATCH_DEVICE_FUNC(DestroyDevice);
+    SPL_DISPATCH_DEVICE_FUNC(GetDeviceProcAddr);
+    SPL_DISPATCH_DEVICE_FUNC(CreateDescriptorSetLayout);
+    SPL_DISPATCH_DEVICE_FUNC(DestroyDescriptorSetLayout);
+    SPL_DISPATCH_DEVICE_FUNC(CreateDescriptorPool);
+    SPL_DISPATCH_DEVICE_FUNC(DestroyDescriptorPool);
+    SPL_DISPATCH_DEVICE_FUNC(CreateDescriptorUpdateTemplate);
+    SPL_DISPATCH_DEVICE_FUNC(CreateDescriptorUpdateTemplateKHR);
+    SPL_DISPATCH_DEVICE_FUNC(DestroyDescriptorUpdateTemplate);
+    SPL_DISPATCH_DEVICE_FUNC(DestroyDescriptorUpdateTemplateKHR);
+    SPL_DISPATCH_DEVICE_FUNC(UpdateDescriptorSets);
+    SPL_DISPATCH_DEVICE_FUNC(UpdateDescriptorSetWithTemplate);
+    SPL_DISPATCH_DEVICE_FUNC(UpdateDescriptorSetWithTemplateKHR);
+    SPL_DISPATCH_DEVICE_FUNC(AllocateDescriptorSets);
+    SPL_DISPATCH_DEVICE_FUNC(FreeDescriptorSets);
+    SPL_DISPATCH_DEVICE_FUNC(ResetDescriptorPool);
+    SPL_DISPATCH_DEVICE_FUNC(QueuePresentKHR);
+    return dispatch_table;
+  };
+
+  return GetLayerData()->CreateDevice(physical_device, create_info, allocator,
+                                      device, build_dispatch_table);
+}
+
+SPL_DESCRIPTOR_LAYER_FUNC(VkResult, EnumerateInstanceLayerProperties,
+                          (uint32_t * property_count,
+                           VkLayerProperties* properties)) {
+  if (property_count) *property_count = 1;
+
+  if (properties) {
+    strncpy(properties->layerName, kLayerName, sizeof(properties->layerName));
+    strncpy(properties->description, kLayerDescription,
+            sizeof(properties->description));
+    properties->implementationVersion = kDescriptorLayerVersion;
+    properties->specVersion = VK_API_VERSION_1_0;
+  }
+
+  return VK_SUCCESS;
+}
+
+SPL_DESCRIPTOR_LAYER_FUNC(VkResult, EnumerateDeviceLayerProperties,
+                          (VkPhysicalDevice /* physical_device */,
+                           uint32_t* property_count,
+                           VkLayerProperties* properties)) {
+  return DescriptorLayer_EnumerateInstanceLayerProperties(property_count,
+                                                          properties);
+}
+
+}  // namespace
+
+SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE(DescriptorLayer_,
+                                      SPL_DESCRIPTOR_LAYER_FUNCS);
+
+// The *GetProcAddr functions are the entry points to the layers.
+// They return a function pointer for the instance requested by |name|.  We
+// return the functions defined in this layer for those we want to override.
+// Otherwise we call the *GetProcAddr function for the next layer to get the
+// function to be called.
+
+SPL_LAYER_ENTRY_POINT SPL_DESCRIPTOR_LAYER_FUNC(PFN_vkVoidFunction,
+                                                GetDeviceProcAddr,
+                                                (VkDevice device,
+                                                 const char* name)) {
+  auto* layer_data = GetLayerData();
+
+  PFN_vkGetDeviceProcAddr next_get_proc_addr =
+      layer_data->GetNextDeviceProcAddr(
+          device, &VkLayerDispatchTable::GetDeviceProcAddr);
+  assert(next_get_proc_addr && next_get_proc_addr != VK_NULL_HANDLE);
+  // The functions of the features and extensions that the device didn't
+  // enable are null down the chain, and must stay null.
+  PFN_vkVoidFunction next_func = next_get_proc_addr(device, name);
+  if (!next_func) return nullptr;
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(DescriptorLayer_, name)) {
+    return func;
+  }
+  return next_func;
+}
+
+SPL_LAYER_ENTRY_POINT SPL_DESCRIPTOR_LAYER_FUNC(PFN_vkVoidFunction,
+                                                GetInstanceProcAddr,
+                                                (VkInstance instance,
+                                                 const char* name)) {
+  // The loader looks up the layer's functions here first, before calling any
+  // of them.
+  if (IsLayerOverheadProfilingEnabled()) {
+    GetLayerData()->SetOverheadProfiler(&DescriptorLayer_kOverheadProfiler);
+  }
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(DescriptorLayer_, name)) {
+    return func;
+  }
+
+  auto* layer_data = GetLayerData();
+
+  PFN_vkGetInstanceProcAddr next_get_proc_addr =
+      layer_data->GetNextInstanceProcAddr(
+          instance, &VkLayerInstanceDispatchTable::GetInstanceProcAddr);
+  assert(next_get_proc_addr && next_get_proc_addr != VK_NULL_HANDLE);
+  return next_get_proc_addr(instance, name);
+}
+
+}  // namespace performancelayers
@@ -0,0 +1,391 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "descriptor_layer_data.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+#include "layer/support/log_output.h"
+
+namespace performancelayers {
+
+namespace {
+// Returns the structure of |type|, a |T|, in the pNext chain |next|, or null.
+template <typename T>
+const T* FindNextStruct(const void* next, VkStructureType type) {
+  auto* base = static_cast<const VkBaseInStructure*>(next);
+  while (base && base->sType != type) base = base->pNext;
+  return reinterpret_cast<const T*>(base);
+}
+}  // namespace
+
+DescriptorSetLayoutCounts GetDescriptorCounts(
+    const VkDescriptorSetLayoutCreateInfo& create_info) {
+  constexpr VkStructureType kBindingFlagsType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  constexpr VkDescriptorBindingFlags kVariableCountBit =
+      VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+  // The binding flags, if given, are per binding.
+  const auto* flags_info =
+      FindNextStruct<VkDescriptorSetLayoutBindingFlagsCreateInfo>(
+          create_info.pNext, kBindingFlagsType);
+  const VkDescriptorBindingFlags* binding_flags =
+      flags_info && flags_info->bindingCount == create_info.bindingCount
+          ? flags_info->pBindingFlags
+          : nullptr;
+
+  DescriptorSetLayoutCounts counts;
+  for (uint32_t i = 0; i != create_info.bindingCount; ++i) {
+    const VkDescriptorSetLayoutBinding& binding = create_info.pBindings[i];
+    if (binding_flags && (binding_flags[i] & kVariableCountBit) != 0) {
+      counts.has_variable_binding = true;
+      counts.variable_type = binding.descriptorType;
+      continue;
+    }
+    counts.counts.Add(binding.descriptorType, binding.descriptorCount);
+  }
+  return counts;
+}
+
+DescriptorCounts GetDescriptorCounts(
+    const VkDescriptorPoolCreateInfo& create_info) {
+  DescriptorCounts counts;
+  for (uint32_t i = 0; i != create_info.poolSizeCount; ++i) {
+    const VkDescriptorPoolSize& pool_size = create_info.pPoolSizes[i];
+    counts.Add(pool_size.type, pool_size.descriptorCount);
+  }
+  return counts;
+}
+
+DescriptorCounts GetDescriptorCounts(
+    const VkDescriptorUpdateTemplateCreateInfo& create_info) {
+  DescriptorCounts counts;
+  for (uint32_t i = 0; i != create_info.descriptorUpdateEntryCount; ++i) {
+    const VkDescriptorUpdateTemplateEntry& entry =
+        create_info.pDescriptorUpdateEntries[i];
+    counts.Add(entry.descriptorType, entry.descriptorCount);
+  }
+  return counts;
+}
+
+const uint32_t* GetVariableDescriptorCounts(
+    const VkDescriptorSetAllocateInfo& allocate_info) {
+  constexpr VkStructureType kVariableCountType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+  const auto* variable_info =
+      FindNextStruct<VkDescriptorSetVariableDescriptorCountAllocateInfo>(
+          allocate_info.pNext, kVariableCountType);
+  // Without the structure, or with no counts, the counts are all 0.
+  if (!variable_info ||
+      variable_info->descriptorSetCount != allocate_info.descriptorSetCount) {
+    return nullptr;
+  }
+  return variable_info->pDescriptorCounts;
+}
+
+bool IsFragmentationFailure(VkResult result, const DescriptorPoolState& state,
+                            uint64_t requested_set_count,
+                            const DescriptorCounts& requested) {
+  if (result == VK_ERROR_FRAGMENTED_POOL) return true;
+  if (result != VK_ERROR_OUT_OF_POOL_MEMORY || state.freed_set_count == 0)
+    return false;
+  if (state.live_set_count + requested_set_count > state.max_sets) return false;
+  for (size_t i = 0; i != kNumDescriptorTypeCounts; ++i) {
+    if (state.live.counts[i] + requested.counts[i] > state.capacity.counts[i])
+      return false;
+  }
+  return true;
+}
+
+DescriptorCounts GetWriteCounts(uint32_t write_count,
+                                const VkWriteDescriptorSet* writes) {
+  DescriptorCounts counts;
+  for (uint32_t i = 0; i != write_count; ++i)
+    counts.Add(writes[i].descriptorType, writes[i].descriptorCount);
+  return counts;
+}
+
+const char* DescriptorResultToString(VkResult result) {
+  switch (result) {
+    case VK_SUCCESS:
+      return "VK_SUCCESS";
+    case VK_ERROR_OUT_OF_HOST_MEMORY:
+      return "VK_ERROR_OUT_OF_HOST_MEMORY";
+    case VK_ERROR_OUT_OF_DEVICE_MEMORY:
+      return "VK_ERROR_OUT_OF_DEVICE_MEMORY";
+    case VK_ERROR_FRAGMENTED_POOL:
+      return "VK_ERROR_FRAGMENTED_POOL";
+    case VK_ERROR_OUT_OF_POOL_MEMORY:
+      return "VK_ERROR_OUT_OF_POOL_MEMORY";
+    default:
+      return "VK_ERROR";
+  }
+}
+
+DescriptorLayerData::~DescriptorLayerData() {
+  if (!call_sites_.IsEnabled()) return;
+  FileOutput out(call_site_log_);
+  call_sites_.WriteFoldedStacks(&out);
+}
+
+void DescriptorLayerData::AddSetLayout(
+    VkDescriptorSetLayout layout,
+    const VkDescriptorSetLayoutCreateInfo& create_info) {
+  DescriptorSetLayoutCounts counts = GetDescriptorCounts(create_info);
+  absl::MutexLock lock(&objects_lock_);
+  set_layouts_[layout] = counts;
+}
+
+void DescriptorLayerData::RemoveSetLayout(VkDescriptorSetLayout layout) {
+  absl::MutexLock lock(&objects_lock_);
+  set_layouts_.erase(layout);
+}
+
+void DescriptorLayerData::AddUpdateTemplate(
+    VkDescriptorUpdateTemplate update_template,
+    const VkDescriptorUpdateTemplateCreateInfo& create_info) {
+  DescriptorCounts counts = GetDescriptorCounts(create_info);
+  absl::MutexLock lock(&templates_lock_);
+  update_templates_[update_template] = counts;
+}
+
+void DescriptorLayerData::RemoveUpdateTemplate(
+    VkDescriptorUpdateTemplate update_template) {
+  absl::MutexLock lock(&templates_lock_);
+  update_templates_.erase(update_template);
+}
+
+void DescriptorLayerData::AddPool(
+    VkDescriptorPool pool, const VkDescriptorPoolCreateInfo& create_info) {
+  DescriptorPoolState state;
+  state.max_sets = create_info.maxSets;
+  state.can_free_sets =
+      (create_info.flags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT) !=
+      0;
+  state.capacity = GetDescriptorCounts(create_info);
+  absl::MutexLock lock(&objects_lock_);
+  pools_[pool] = std::move(state);
+}
+
+void DescriptorLayerData::RemovePool(VkDescriptorPool pool) {
+  absl::MutexLock lock(&objects_lock_);
+  pools_.erase(pool);
+}
+
+void DescriptorLayerData::AddCall(DescriptorCall call, Duration duration) {
+  const int64_t duration_ns = duration.ToNanoseconds();
+  call_count_[static_cast<size_t>(call)].fetch_add(1,
+                                                   std::memory_order_relaxed);
+  call_time_ns_[static_cast<size_t>(call)].fetch_add(
+      duration_ns, std::memory_order_relaxed);
+  calls_metric_.Add();
+  call_time_metric_.Record(duration_ns / 1000);
+}
+
+void DescriptorLayerData::RecordUpdate(uint32_t write_count,
+                                       const VkWriteDescriptorSet* writes,
+                                       uint32_t copy_count, Duration duration,
+                                       bool log_call) {
+  AddCall(DescriptorCall::kUpdate, duration);
+  const DescriptorCounts counts = GetWriteCounts(write_count, writes);
+  for (size_t i = 0; i != kNumDescriptorTypeCounts; ++i) {
+    if (counts.counts[i] != 0)
+      write_count_[i].fetch_add(counts.counts[i], std::memory_order_relaxed);
+  }
+  copy_count_.fetch_add(copy_count, std::memory_order_relaxed);
+  const uint64_t total_writes = counts.GetTotal();
+  writes_metric_.Add(static_cast<int64_t>(total_writes));
+
+  if (log_call) {
+    DescriptorUpdateEvent event("update_descriptor_sets",
+                                static_cast<int64_t>(total_writes), copy_count,
+                                duration);
+    LogEvent(&event);
+  }
+}
+
+void DescriptorLayerData::RecordTemplateUpdate(
+    VkDescriptorUpdateTemplate update_template, Duration duration,
+    bool log_call) {
+  AddCall(DescriptorCall::kTemplateUpdate, duration);
+  DescriptorCounts counts;
+  {
+    absl::ReaderMutexLock lock(&templates_lock_);
+    auto it = update_templates_.find(update_template);
+    if (it != update_templates_.end()) counts = it->second;
+  }
+  for (size_t i = 0; i != kNumDescriptorTypeCounts; ++i) {
+    if (counts.counts[i] != 0)
+      write_count_[i].fetch_add(counts.counts[i], std::memory_order_relaxed);
+  }
+  const uint64_t total_writes = counts.GetTotal();
+  writes_metric_.Add(static_cast<int64_t>(total_writes));
+
+  if (log_call) {
+    DescriptorUpdateEvent event("update_descriptor_set_with_template",
+                                static_cast<int64_t>(total_writes),
+                                /*copy_count=*/0, duration);
+    LogEvent(&event);
+  }
+}
+
+DescriptorCounts DescriptorLayerData::GetSetCounts(
+    VkDescriptorSetLayout layout, uint32_t variable_count) const {
+  auto it = set_layouts_.find(layout);
+  if (it == set_layouts_.end()) return {};
+  return it->second.GetSetCounts(variable_count);
+}
+
+void DescriptorLayerData::AddSets(
+    const VkDescriptorSetAllocateInfo& allocate_info,
+    const VkDescriptorSet* sets) {
+  const uint32_t* variable_counts = GetVariableDescriptorCounts(allocate_info);
+  absl::MutexLock lock(&objects_lock_);
+  auto pool_it = pools_.find(allocate_info.descriptorPool);
+  if (pool_it == pools_.end()) return;
+  DescriptorPoolState& state = pool_it->second;
+  for (uint32_t i = 0; i != allocate_info.descriptorSetCount; ++i) {
+    const DescriptorCounts counts =
+        GetSetCounts(allocate_info.pSetLayouts[i],
+                     variable_counts ? variable_counts[i] : 0);
+    ++state.live_set_count;
+    state.live += counts;
+    if (state.can_free_sets) state.sets[sets[i]] = counts;
+  }
+}
+
+void DescriptorLayerData::RemoveSets(VkDescriptorPool pool, uint32_t set_count,
+                                     const VkDescriptorSet* sets) {
+  absl::MutexLock lock(&objects_lock_);
+  auto pool_it = pools_.find(pool);
+  if (pool_it == pools_.end()) return;
+  DescriptorPoolState& state = pool_it->second;
+  for (uint32_t i = 0; i != set_count; ++i) {
+    auto set_it = state.sets.find(sets[i]);
+    // Freeing VK_NULL_HANDLE is valid and does nothing.
+    if (set_it == state.sets.end()) continue;
+    state.live -= set_it->second;
+    state.sets.erase(set_it);
+    --state.live_set_count;
+    ++state.freed_set_count;
+  }
+}
+
+uint64_t DescriptorLayerData::ResetPool(VkDescriptorPool pool) {
+  absl::MutexLock lock(&objects_lock_);
+  auto pool_it = pools_.find(pool);
+  if (pool_it == pools_.end()) return 0;
+  DescriptorPoolState& state = pool_it->second;
+  const uint64_t set_count = state.live_set_count;
+  state.live_set_count = 0;
+  state.live = {};
+  state.freed_set_count = 0;
+  state.sets.clear();
+  return set_count;
+}
+
+void DescriptorLayerData::RecordAllocate(
+    const VkDescriptorSetAllocateInfo& allocate_info, VkResult result,
+    Duration duration, bool log_call) {
+  const VkDescriptorPool pool = allocate_info.descriptorPool;
+  const uint32_t set_count = allocate_info.descriptorSetCount;
+  AddCall(DescriptorCall::kAllocate, duration);
+  if (result == VK_SUCCESS) {
+    allocated_set_count_.fetch_add(set_count, std::memory_order_relaxed);
+  } else {
+    const uint32_t* variable_counts =
+        GetVariableDescriptorCounts(allocate_info);
+    DescriptorPoolState state;
+    DescriptorCounts requested;
+    {
+      absl::MutexLock lock(&objects_lock_);
+      for (uint32_t i = 0; i != set_count; ++i) {
+        requested += GetSetCounts(allocate_info.pSetLayouts[i],
+                                  variable_counts ? variable_counts[i] : 0);
+      }
+      auto pool_it = pools_.find(pool);
+      if (pool_it != pools_.end()) {
+        const DescriptorPoolState& pool_state = pool_it->second;
+        state.max_sets = pool_state.max_sets;
+        state.capacity = pool_state.capacity;
+        state.live_set_count = pool_state.live_set_count;
+        state.live = pool_state.live;
+        state.freed_set_count = pool_state.freed_set_count;
+      }
+    }
+
+    const bool fragmented =
+        IsFragmentationFailure(result, state, set_count, requested);
+    allocation_failure_count_.fetch_add(1, std::memory_order_relaxed);
+    allocation_failures_metric_.Add();
+    if (fragmented)
+      fragmentation_failure_count_.fetch_add(1, std::memory_order_relaxed);
+
+    // Failures are rare and are what the pool tracking is for, so they are
+    // logged even when sampling.
+    DescriptorAllocationFailureEvent event(
+        "descriptor_allocation_failure", pool, result, fragmented, state,
+        set_count, static_cast<int64_t>(requested.GetTotal()));
+    LogEvent(&event);
+  }
+
+  if (log_call) {
+    DescriptorPoolCallEvent event("allocate_descriptor_sets", pool, set_count,
+                                  result, duration);
+    LogEvent(&event);
+  }
+}
+
+void DescriptorLayerData::RecordPoolCall(const char* name, DescriptorCall call,
+                                         VkDescriptorPool pool,
+                                         uint64_t set_count, VkResult result,
+                                         Duration duration, bool log_call) {
+  AddCall(call, duration);
+  if (log_call) {
+    DescriptorPoolCallEvent event(name, pool, static_cast<int64_t>(set_count),
+                                  result, duration);
+    LogEvent(&event);
+  }
+}
+
+void DescriptorLayerData::RecordPresent() {
+  const uint64_t frame = frame_.fetch_add(1, std::memory_order_relaxed);
+  DescriptorFrameStats stats;
+  for (size_t i = 0; i != kNumDescriptorCalls; ++i) {
+    stats.call_count[i] = call_count_[i].exchange(0, std::memory_order_relaxed);
+    stats.call_time_ns[i] =
+        call_time_ns_[i].exchange(0, std::memory_order_relaxed);
+  }
+  stats.allocated_set_count =
+      allocated_set_count_.exchange(0, std::memory_order_relaxed);
+  stats.allocation_failure_count =
+      allocation_failure_count_.exchange(0, std::memory_order_relaxed);
+  stats.fragmentation_failure_count =
+      fragmentation_failure_count_.exchange(0, std::memory_order_relaxed);
+  stats.copy_count = copy_count_.exchange(0, std::memory_order_relaxed);
+  for (size_t i = 0; i != kNumDescriptorTypeCounts; ++i) {
+    stats.writes.counts[i] =
+        write_count_[i].exchange(0, std::memory_order_relaxed);
+  }
+
+  DescriptorFrameEvent event("descriptor_frame", static_cast<int64_t>(frame),
+                             stats);
+  LogEvent(&event);
+}
+
+}  // namespace performancelayers
@@ -0,0 +1,585 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_DESCRIPTOR_LAYER_DATA_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_DESCRIPTOR_LAYER_DATA_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/base/attributes.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "layer/support/call_site_profiler.h"
+#include "layer/support/event_logging.h"
+#include "layer/support/layer_data.h"
+#include "layer/support/layer_utils.h"
+#include "layer/support/metrics.h"
+
+namespace performancelayers {
+// The number of descriptor types counted separately: the core Vulkan 1.0
+// types, and one count for all the types added by extensions, e.g., inline
+// uniform blocks and acceleration structures.
+constexpr size_t kNumDescriptorTypeCounts =
+    VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT + 2;
+
+// Descriptor counts by descriptor type.
+struct DescriptorCounts {
+  static size_t GetIndex(VkDescriptorType type) {
+    return type >= 0 && type <= VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT
+               ? static_cast<size_t>(type)
+               : kNumDescriptorTypeCounts - 1;
+  }
+
+  void Add(VkDescriptorType type, uint64_t count) {
+    counts[GetIndex(type)] += count;
+  }
+
+  uint64_t GetTotal() const {
+    uint64_t total = 0;
+    for (uint64_t count : counts) total += count;
+    return total;
+  }
+
+  DescriptorCounts& operator+=(const DescriptorCounts& other) {
+    for (size_t i = 0; i != kNumDescriptorTypeCounts; ++i)
+      counts[i] += other.counts[i];
+    return *this;
+  }
+
+  // Saturates at 0, in case the application frees more than the layer saw it
+  // allocate.
+  DescriptorCounts& operator-=(const DescriptorCounts& other) {
+    for (size_t i = 0; i != kNumDescriptorTypeCounts; ++i)
+      counts[i] -= std::min(counts[i], other.counts[i]);
+    return *this;
+  }
+
+  uint64_t counts[kNumDescriptorTypeCounts] = {};
+};
+
+// The descriptors of every type in the bindings of a set layout. The binding
+// created with VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT, if any,
+// is not in |counts|: its descriptor count is set for every set when the set
+// is allocated.
+struct DescriptorSetLayoutCounts {
+  // Returns the descriptors of a set allocated with |variable_count|
+  // descriptors in the variable binding.
+  DescriptorCounts GetSetCounts(uint32_t variable_count) const {
+    DescriptorCounts set_counts = counts;
+    if (has_variable_binding) set_counts.Add(variable_type, variable_count);
+    return set_counts;
+  }
+
+  DescriptorCounts counts;
+  bool has_variable_binding = false;
+  VkDescriptorType variable_type = VK_DESCRIPTOR_TYPE_SAMPLER;
+};
+
+// Returns the descriptors of every type in the bindings of a set layout.
+DescriptorSetLayoutCounts GetDescriptorCounts(
+    const VkDescriptorSetLayoutCreateInfo& create_info);
+
+// Returns the descriptors of every type in the pool sizes of a pool and in
+// the entries of an update template. The counts of inline uniform blocks are
+// in bytes.
+DescriptorCounts GetDescriptorCounts(
+    const VkDescriptorPoolCreateInfo& create_info);
+DescriptorCounts GetDescriptorCounts(
+    const VkDescriptorUpdateTemplateCreateInfo& create_info);
+
+// Returns the descriptor counts of the variable bindings of the sets allocated
+// with |allocate_info|, one per set, or null if they are all 0.
+const uint32_t* GetVariableDescriptorCounts(
+    const VkDescriptorSetAllocateInfo& allocate_info);
+
+// Returns the descriptors of every type written by |write_count| |writes|.
+DescriptorCounts GetWriteCounts(uint32_t write_count,
+                                const VkWriteDescriptorSet* writes);
+
+// Returns the name of |result|, e.g., "VK_ERROR_FRAGMENTED_POOL", for the
+// results of the descriptor functions, and "VK_ERROR" for the other errors.
+const char* DescriptorResultToString(VkResult result);
+
+// The timed descriptor calls.
+enum class DescriptorCall {
+  // vkUpdateDescriptorSets.
+  kUpdate,
+  // vkUpdateDescriptorSetWithTemplate.
+  kTemplateUpdate,
+  // vkAllocateDescriptorSets.
+  kAllocate,
+  // vkFreeDescriptorSets.
+  kFree,
+  // vkResetDescriptorPool.
+  kReset,
+};
+
+constexpr size_t kNumDescriptorCalls = 5;
+
+// The sets and descriptors allocated from a descriptor pool.
+struct DescriptorPoolState {
+  uint32_t max_sets = 0;
+  // Whether the pool was created with
+  // VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT.
+  bool can_free_sets = false;
+  DescriptorCounts capacity;
+  uint64_t live_set_count = 0;
+  DescriptorCounts live;
+  // The sets freed one by one since the pool was created or last reset. Only
+  // such frees can fragment a pool.
+  uint64_t freed_set_count = 0;
+  // The descriptors of the live sets of the pools that can free them, so that
+  // they are released when the sets are freed.
+  absl::flat_hash_map<VkDescriptorSet, DescriptorCounts> sets;
+};
+
+// Returns whether a vkAllocateDescriptorSets call that failed with |result|,
+// requesting |requested_set_count| sets with the |requested| descriptors from
+// a pool in |state|, failed because the pool is fragmented. The driver may
+// say so with VK_ERROR_FRAGMENTED_POOL. Drivers may also return
+// VK_ERROR_OUT_OF_POOL_MEMORY for a fragmented pool, so that result counts as
+// fragmentation if the pool had room for the request, which can only be
+// because the free space is scattered across freed sets. A pool that had no
+// set freed since it was created or last reset can't be fragmented.
+bool IsFragmentationFailure(VkResult result, const DescriptorPoolState& state,
+                            uint64_t requested_set_count,
+                            const DescriptorCounts& requested);
+
+// An event that holds a single vkUpdateDescriptorSets or
+// vkUpdateDescriptorSetWithTemplate call, with the number of descriptors it
+// wrote and copied. The trace event spans the call on the calling thread.
+class DescriptorUpdateEvent : public Event {
+ public:
+  DescriptorUpdateEvent(const char* name, int64_t write_count,
+                        int64_t copy_count, Duration duration)
+      : Event(name),
+        write_count_({"write_count", write_count}),
+        copy_count_({"copy_count", copy_count}),
+        duration_("duration", duration),
+        trace_attr_("trace_attr", "descriptor", "X",
+                    {&write_count_, &copy_count_, &duration_}) {
+    InitAttributes({&write_count_, &copy_count_, &duration_, &trace_attr_});
+  }
+
+ private:
+  Int64Attr write_count_;
+  Int64Attr copy_count_;
+  DurationAttr duration_;
+  TraceEventAttr trace_attr_;
+};
+
+// An event that holds a single call allocating, freeing or resetting the sets
+// of a descriptor pool, with the number of sets and the result. The trace
+// event spans the call on the calling thread.
+class DescriptorPoolCallEvent : public Event {
+ public:
+  DescriptorPoolCallEvent(const char* name, VkDescriptorPool pool,
+                          int64_t set_count, VkResult result, Duration duration)
+      : Event(name),
+        pool_({"pool",
+               static_cast<int64_t>(reinterpret_cast<uintptr_t>(pool))}),
+        set_count_({"set_count", set_count}),
+        result_("result", DescriptorResultToString(result)),
+        duration_("duration", duration),
+        trace_attr_("trace_attr", "descriptor", "X",
+                    {&pool_, &set_count_, &result_, &duration_}) {
+    InitAttributes({&pool_, &set_count_, &result_, &duration_, &trace_attr_});
+  }
+
+ private:
+  Int64Attr pool_;
+  Int64Attr set_count_;
+  StringAttr result_;
+  DurationAttr duration_;
+  TraceEventAttr trace_attr_;
+};
+
+// An event that holds a failed vkAllocateDescriptorSets call and the state of
+// the pool it failed on, and whether the failure is attributed to
+// fragmentation, as decided by IsFragmentationFailure.
+class DescriptorAllocationFailureEvent : public Event {
+ public:
+  DescriptorAllocationFailureEvent(const char* name, VkDescriptorPool pool,
+                                   VkResult result, bool fragmented,
+                                   const DescriptorPoolState& state,
+                                   int64_t requested_set_count,
+                                   int64_t requested_descriptor_count)
+      : Event(name, LogLevel::kMedium),
+        pool_({"pool",
+               static_cast<int64_t>(reinterpret_cast<uintptr_t>(pool))}),
+        result_("result", DescriptorResultToString(result)),
+        fragmented_({"fragmented", fragmented}),
+        max_sets_({"max_sets", state.max_sets}),
+        live_set_count_(
+            {"live_set_count", static_cast<int64_t>(state.live_set_count)}),
+        freed_set_count_(
+            {"freed_set_count", static_cast<int64_t>(state.freed_set_count)}),
+        free_descriptor_count_(
+            {"free_descriptor_count",
+             static_cast<int64_t>(state.capacity.GetTotal() -
+                                  std::min(state.capacity.GetTotal(),
+                                           state.live.GetTotal()))}),
+        requested_set_count_({"requested_set_count", requested_set_count}),
+        requested_descriptor_count_(
+            {"requested_descriptor_count", requested_descriptor_count}),
+        trace_attr_("trace_attr", "descriptor", "i",
+                    {&scope_, &pool_, &result_, &fragmented_, &max_sets_,
+                     &live_set_count_, &freed_set_count_,
+                     &free_descriptor_count_, &requested_set_count_,
+                     &requested_descriptor_count_}) {
+    InitAttributes({&pool_, &result_, &fragmented_, &max_sets_,
+                    &live_set_count_, &freed_set_count_,
+                    &free_descriptor_count_, &requested_set_count_,
+                    &requested_descriptor_count_, &trace_attr_});
+  }
+
+ private:
+  Int64Attr pool_;
+  StringAttr result_;
+  BoolAttr fragmented_;
+  Int64Attr max_sets_;
+  Int64Attr live_set_count_;
+  Int64Attr freed_set_count_;
+  Int64Attr free_descriptor_count_;
+  Int64Attr requested_set_count_;
+  Int64Attr requested_descriptor_count_;
+  // `Perfetto` displays the args only for instant events with thread-level
+  // scope.
+  StringAttr scope_{"scope", "t"};
+  TraceEventAttr trace_attr_;
+};
+
+// The descriptor calls of one frame, summed over all threads.
+struct DescriptorFrameStats {
+  uint64_t call_count[kNumDescriptorCalls] = {};
+  int64_t call_time_ns[kNumDescriptorCalls] = {};
+  uint64_t allocated_set_count = 0;
+  uint64_t allocation_failure_count = 0;
+  uint64_t fragmentation_failure_count = 0;
+  uint64_t copy_count = 0;
+  DescriptorCounts writes;
+};
+
+// An event that summarizes the descriptor calls of one frame: the number of
+// calls and the time spent in them, by function, the allocation failures, and
+// the descriptors written, in total and by descriptor type.
+class DescriptorFrameEvent : public Event {
+ public:
+  DescriptorFrameEvent(const char* name, int64_t frame,
+                       const DescriptorFrameStats& stats)
+      : Event(name, LogLevel::kHigh),
+        frame_({"frame", frame}),
+        descriptor_time_("descriptor_time", GetTotalTime(stats)),
+        update_count_(GetCount("update_count", stats, DescriptorCall::kUpdate)),
+        update_time_(GetTime("update_time", stats, DescriptorCall::kUpdate)),
+        template_update_count_(GetCount("template_update_count", stats,
+                                        DescriptorCall::kTemplateUpdate)),
+        template_update_time_(GetTime("template_update_time", stats,
+                                      DescriptorCall::kTemplateUpdate)),
+        allocate_count_(
+            GetCount("allocate_count", stats, DescriptorCall::kAllocate)),
+        allocated_set_count_(
+            {"allocated_set_count",
+             static_cast<int64_t>(stats.allocated_set_count)}),
+        allocate_time_(
+            GetTime("allocate_time", stats, DescriptorCall::kAllocate)),
+        allocation_failure_count_(
+            {"allocation_failure_count",
+             static_cast<int64_t>(stats.allocation_failure_count)}),
+        fragmentation_failure_count_(
+            {"fragmentation_failure_count",
+             static_cast<int64_t>(stats.fragmentation_failure_count)}),
+        free_count_(GetCount("free_count", stats, DescriptorCall::kFree)),
+        free_time_(GetTime("free_time", stats, DescriptorCall::kFree)),
+        reset_count_(GetCount("reset_count", stats, DescriptorCall::kReset)),
+        reset_time_(GetTime("reset_time", stats, DescriptorCall::kReset)),
+        copy_count_({"copy_count", static_cast<int64_t>(stats.copy_count)}),
+        write_count_(
+            {"write_count", static_cast<int64_t>(stats.writes.GetTotal())}),
+        sampler_writes_(GetWrites("sampler_writes", stats,
+                                  VK_DESCRIPTOR_TYPE_SAMPLER)),
+        combined_image_sampler_writes_(
+            GetWrites("combined_image_sampler_writes", stats,
+                      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)),
+        sampled_image_writes_(GetWrites("sampled_image_writes", stats,
+                                        VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE)),
+        storage_image_writes_(GetWrites("storage_image_writes", stats,
+                                        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)),
+        uniform_texel_buffer_writes_(
+            GetWrites("uniform_texel_buffer_writes", stats,
+                      VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER)),
+        storage_texel_buffer_writes_(
+            GetWrites("storage_texel_buffer_writes", stats,
+                      VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER)),
+        uniform_buffer_writes_(GetWrites("uniform_buffer_writes", stats,
+                                         VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)),
+        storage_buffer_writes_(GetWrites("storage_buffer_writes", stats,
+                                         VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)),
+        uniform_buffer_dynamic_writes_(
+            GetWrites("uniform_buffer_dynamic_writes", stats,
+                      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)),
+        storage_buffer_dynamic_writes_(
+            GetWrites("storage_buffer_dynamic_writes", stats,
+                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)),
+        input_attachment_writes_(
+            GetWrites("input_attachment_writes", stats,
+                      VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT)),
+        other_writes_(
+            {"other_writes",
+             static_cast<int64_t>(
+                 stats.writes.counts[kNumDescriptorTypeCounts - 1])}),
+        trace_attr_(
+            "trace_attr", "descriptor", "i",
+            {&scope_, &frame_, &descriptor_time_, &update_count_,
+             &update_time_, &template_update_count_, &template_update_time_,
+             &allocate_count_, &allocated_set_count_, &allocate_time_,
+             &allocation_failure_count_, &fragmentation_failure_count_,
+             &free_count_, &free_time_, &reset_count_, &reset_time_,
+             &copy_count_, &write_count_, &sampler_writes_,
+             &combined_image_sampler_writes_, &sampled_image_writes_,
+             &storage_image_writes_, &uniform_texel_buffer_writes_,
+             &storage_texel_buffer_writes_, &uniform_buffer_writes_,
+             &storage_buffer_writes_, &uniform_buffer_dynamic_writes_,
+             &storage_buffer_dynamic_writes_, &input_attachment_writes_,
+             &other_writes_}) {
+    InitAttributes(
+        {&frame_, &descriptor_time_, &update_count_, &update_time_,
+         &template_update_count_, &template_update_time_, &allocate_count_,
+         &allocated_set_count_, &allocate_time_, &allocation_failure_count_,
+         &fragmentation_failure_count_, &free_count_, &free_time_,
+         &reset_count_, &reset_time_, &copy_count_, &write_count_,
+         &sampler_writes_, &combined_image_sampler_writes_,
+         &sampled_image_writes_, &storage_image_writes_,
+         &uniform_texel_buffer_writes_, &storage_texel_buffer_writes_,
+         &uniform_buffer_writes_, &storage_buffer_writes_,
+         &uniform_buffer_dynamic_writes_, &storage_buffer_dynamic_writes_,
+         &input_attachment_writes_, &other_writes_, &trace_attr_});
+  }
+
+ private:
+  static Duration GetTotalTime(const DescriptorFrameStats& stats) {
+    int64_t total_ns = 0;
+    for (int64_t call_time_ns : stats.call_time_ns) total_ns += call_time_ns;
+    return Duration::FromNanoseconds(total_ns);
+  }
+
+  static Int64Attr GetCount(const char* name, const DescriptorFrameStats& stats,
+                            DescriptorCall call) {
+    const size_t index = static_cast<size_t>(call);
+    return Int64Attr(name, static_cast<int64_t>(stats.call_count[index]));
+  }
+
+  static DurationAttr GetTime(const char* name,
+                              const DescriptorFrameStats& stats,
+                              DescriptorCall call) {
+    const size_t index = static_cast<size_t>(call);
+    return DurationAttr(name,
+                        Duration::FromNanoseconds(stats.call_time_ns[index]));
+  }
+
+  static Int64Attr GetWrites(const char* name,
+                             const DescriptorFrameStats& stats,
+                             VkDescriptorType type) {
+    const size_t index = DescriptorCounts::GetIndex(type);
+    return Int64Attr(name, static_cast<int64_t>(stats.writes.counts[index]));
+  }
+
+  Int64Attr frame_;
+  DurationAttr descriptor_time_;
+  Int64Attr update_count_;
+  DurationAttr update_time_;
+  Int64Attr template_update_count_;
+  DurationAttr template_update_time_;
+  Int64Attr allocate_count_;
+  Int64Attr allocated_set_count_;
+  DurationAttr allocate_time_;
+  Int64Attr allocation_failure_count_;
+  Int64Attr fragmentation_failure_count_;
+  Int64Attr free_count_;
+  DurationAttr free_time_;
+  Int64Attr reset_count_;
+  DurationAttr reset_time_;
+  Int64Attr copy_count_;
+  Int64Attr write_count_;
+  Int64Attr sampler_writes_;
+  Int64Attr combined_image_sampler_writes_;
+  Int64Attr sampled_image_writes_;
+  Int64Attr storage_image_writes_;
+  Int64Attr uniform_texel_buffer_writes_;
+  Int64Attr storage_texel_buffer_writes_;
+  Int64Attr uniform_buffer_writes_;
+  Int64Attr storage_buffer_writes_;
+  Int64Attr uniform_buffer_dynamic_writes_;
+  Int64Attr storage_buffer_dynamic_writes_;
+  Int64Attr input_attachment_writes_;
+  Int64Attr other_writes_;
+  // `Perfetto` displays the args only for instant events with thread-level
+  // scope.
+  StringAttr scope_{"scope", "t"};
+  TraceEventAttr trace_attr_;
+};
+
+// A class that contains all of the data that is needed for the functions
+// that this layer will override.
+//
+// Every timed call is logged to the event logs and, at every present, the
+// descriptor calls of the frame are logged to the layer's log file, the
+// "descriptor.log" setting of the `LayerConfig`. The calls are summed with
+// atomics, so that threads updating descriptors at once don't contend in the
+// layer. The pools, set layouts and update templates are tracked under locks
+// in every instrumentation mode, so that the pool usage stays right when the
+// mode changes. The update templates have their own lock, which template
+// updates only take as readers.
+class DescriptorLayerData : public LayerData {
+ public:
+  // Every |call_site_sample_us| microseconds spent in the timed calls, the
+  // stack of the calling function is captured, and the stacks are written to
+  // |call_site_log| when the layer is unloaded, weighted in nanoseconds. 0
+  // disables the sampling.
+  DescriptorLayerData(const char* log_filename, uint64_t call_site_sample_us,
+                      const char* call_site_log)
+      : LayerData(
+            log_filename,
+            "Frame,Descriptor Time (ns),Updates,Update Time (ns),Template "
+            "Updates,Template Update Time (ns),Allocations,Allocated "
+            "Sets,Allocation Time (ns),Allocation Failures,Fragmentation "
+            "Failures,Frees,Free Time (ns),Pool Resets,Pool Reset Time "
+            "(ns),Copies,Writes,Sampler Writes,Combined Image Sampler "
+            "Writes,Sampled Image Writes,Storage Image Writes,Uniform Texel "
+            "Buffer Writes,Storage Texel Buffer Writes,Uniform Buffer "
+            "Writes,Storage Buffer Writes,Dynamic Uniform Buffer "
+            "Writes,Dynamic Storage Buffer Writes,Input Attachment "
+            "Writes,Other Writes"),
+        call_sites_(call_site_sample_us * 1000, kCallSiteSkipFrames),
+        call_site_log_(call_site_log) {
+    LayerInitEvent event("descriptor_layer_init", "descriptor");
+    LogEvent(&event);
+    StartControl("descriptor");
+  }
+
+  ~DescriptorLayerData();
+
+  // Records the descriptors of every type in the set layout |layout|.
+  void AddSetLayout(VkDescriptorSetLayout layout,
+                    const VkDescriptorSetLayoutCreateInfo& create_info);
+  void RemoveSetLayout(VkDescriptorSetLayout layout);
+
+  // Records the descriptors of every type written by the update template
+  // |update_template|.
+  void AddUpdateTemplate(
+      VkDescriptorUpdateTemplate update_template,
+      const VkDescriptorUpdateTemplateCreateInfo& create_info);
+  void RemoveUpdateTemplate(VkDescriptorUpdateTemplate update_template);
+
+  void AddPool(VkDescriptorPool pool,
+               const VkDescriptorPoolCreateInfo& create_info);
+  void RemovePool(VkDescriptorPool pool);
+
+  // Records a vkUpdateDescriptorSets call. Logs the call if |log_call| is set.
+  void RecordUpdate(uint32_t write_count, const VkWriteDescriptorSet* writes,
+                    uint32_t copy_count, Duration duration, bool log_call);
+
+  // Records a vkUpdateDescriptorSetWithTemplate call with |update_template|.
+  // Logs the call if |log_call| is set.
+  void RecordTemplateUpdate(VkDescriptorUpdateTemplate update_template,
+                            Duration duration, bool log_call);
+
+  // Adds the sets allocated with |allocate_info| to |sets| to their pool.
+  void AddSets(const VkDescriptorSetAllocateInfo& allocate_info,
+               const VkDescriptorSet* sets);
+
+  // Removes the |set_count| |sets| from |pool|.
+  void RemoveSets(VkDescriptorPool pool, uint32_t set_count,
+                  const VkDescriptorSet* sets);
+
+  // Removes all the sets from |pool|. Returns the number of sets removed.
+  uint64_t ResetPool(VkDescriptorPool pool);
+
+  // Records a vkAllocateDescriptorSets call with |allocate_info| that returned
+  // |result|. Logs the call if |log_call| is set, and logs a failure with the
+  // state of the pool in any case.
+  void RecordAllocate(const VkDescriptorSetAllocateInfo& allocate_info,
+                      VkResult result, Duration duration, bool log_call);
+
+  // Records the call |name| of |call|, vkFreeDescriptorSets or
+  // vkResetDescriptorPool, that released |set_count| sets of |pool|. Logs the
+  // call if |log_call| is set.
+  void RecordPoolCall(const char* name, DescriptorCall call,
+                      VkDescriptorPool pool, uint64_t set_count,
+                      VkResult result, Duration duration, bool log_call);
+
+  // Logs the descriptor calls of the frame that ends, and starts a new frame.
+  void RecordPresent();
+
+  // Charges the stack of the current descriptor call with |duration|, in
+  // nanoseconds, as most descriptor calls take less than a microsecond.
+  // Not inlined, so that the number of the layer's own frames is fixed.
+  ABSL_ATTRIBUTE_NOINLINE void RecordCallSite(Duration duration) {
+    call_sites_.Record(
+        static_cast<uint64_t>(std::max<int64_t>(duration.ToNanoseconds(), 0)));
+  }
+
+ private:
+  void AddCall(DescriptorCall call, Duration duration);
+
+  // Returns the descriptors of a set of |layout| with |variable_count|
+  // descriptors in its variable binding. Unknown layouts have none.
+  DescriptorCounts GetSetCounts(VkDescriptorSetLayout layout,
+                                uint32_t variable_count) const
+      ABSL_SHARED_LOCKS_REQUIRED(objects_lock_);
+
+  absl::Mutex objects_lock_;
+  absl::flat_hash_map<VkDescriptorSetLayout, DescriptorSetLayoutCounts>
+      set_layouts_ ABSL_GUARDED_BY(objects_lock_);
+  absl::flat_hash_map<VkDescriptorPool, DescriptorPoolState> pools_
+      ABSL_GUARDED_BY(objects_lock_);
+
+  // Template updates are the hot path, so they don't contend with the pool
+  // tracking and with each other.
+  absl::Mutex templates_lock_;
+  absl::flat_hash_map<VkDescriptorUpdateTemplate, DescriptorCounts>
+      update_templates_ ABSL_GUARDED_BY(templates_lock_);
+
+  std::atomic<uint64_t> call_count_[kNumDescriptorCalls] = {};
+  std::atomic<int64_t> call_time_ns_[kNumDescriptorCalls] = {};
+  std::atomic<uint64_t> allocated_set_count_ = 0;
+  std::atomic<uint64_t> allocation_failure_count_ = 0;
+  std::atomic<uint64_t> fragmentation_failure_count_ = 0;
+  std::atomic<uint64_t> copy_count_ = 0;
+  std::atomic<uint64_t> write_count_[kNumDescriptorTypeCounts] = {};
+
+  std::atomic<uint64_t> frame_ = 0;
+
+  Counter calls_metric_ =
+      MetricsRegistry::Get()->GetCounter("descriptor_calls_total");
+  Counter writes_metric_ =
+      MetricsRegistry::Get()->GetCounter("descriptor_writes_total");
+  Counter allocation_failures_metric_ = MetricsRegistry::Get()->GetCounter(
+      "descriptor_allocation_failures_total");
+  Histogram call_time_metric_ =
+      MetricsRegistry::Get()->GetHistogram("descriptor_call_time_us");
+
+  // The layer's own frames in the sampled stacks: RecordCallSite and the
+  // descriptor function override.
+  static constexpr size_t kCallSiteSkipFrames = 2;
+  CallSiteProfiler call_sites_;
+  const char* call_site_log_;
+};
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_DESCRIPTOR_LAYER_DATA_H_
@@ -23,9 +23,11 @@
 
 #include "layer/support/debug_logging.h"
 #include "layer/support/event_logging.h"
+#include "layer/support/layer_config.h"
 #include "layer/support/layer_data.h"
 #include "layer/support/layer_utils.h"
 #include "layer/support/log_scanner.h"
+#include "layer/support/metrics.h"
 
 namespace performancelayers {
 namespace {
@@ -37,18 +39,6 @@ constexpr uint32_t kFrameTimeLayerVersion = 1;
 constexpr char kLayerName[] = "VK_LAYER_STADIA_frame_time";
 constexpr char kLayerDescription[] = "Stadia Frame Time Measuring Layer";
 
-constexpr char kLogFilenameEnvVar[] = "VK_FRAME_TIME_LOG";
-constexpr char kExitAfterFrameEnvVar[] = "VK_FRAME_TIME_EXIT_AFTER_FRAME";
-constexpr char kFinishFileEnvVar[] = "VK_FRAME_TIME_FINISH_FILE";
-constexpr char kBenchmarkWatchFileEnvVar[] =
-    "VK_FRAME_TIME_BENCHMARK_WATCH_FILE";
-constexpr char kBenchmarkStartStringEnvVar[] =
-    "VK_FRAME_TIME_BENCHMARK_START_STRING";
-
-const char* StrOrEmpty(const char* str_or_null) {
-  return str_or_null ? str_or_null : "";
-}
-
 class FrameTimeEvent : public Event {
  public:
   FrameTimeEvent(const char* name, Duration time_delta, bool started)
@@ -97,20 +87,22 @@ class FrameTimeExitEvent : public Event {
 
 class FrameTimeLayerData : public LayerData {
  public:
-  FrameTimeLayerData(char* log_filename, uint64_t exit_frame_num_or_invalid,
-                     const char* benchmark_watch_filename,
-                     const char* benchmark_start_string)
-      : LayerData(log_filename, "Frame Time (ns),Benchmark State"),
-        exit_frame_num_or_invalid_(exit_frame_num_or_invalid),
-        benchmark_start_pattern_(StrOrEmpty(benchmark_start_string)) {
+  explicit FrameTimeLayerData(const LayerConfig::FrameTime& config)
+      : LayerData(NullIfEmpty(config.log), "Frame Time (ns),Benchmark State"),
+        exit_frame_num_or_invalid_(config.exit_after_frame != 0
+                                       ? config.exit_after_frame
+                                       : kInvalidFrameNum),
+        benchmark_start_pattern_(config.benchmark_start_string) {
     LayerInitEvent event("frame_time_layer_init", "frame_time");
     LogEvent(&event);
-    if (!benchmark_watch_filename || strlen(benchmark_watch_filename) == 0)
-      return;
-
-    benchmark_log_scanner_ = LogScanner::FromFilename(benchmark_watch_filename);
-    if (benchmark_log_scanner_)
-      benchmark_log_scanner_->RegisterWatchedPattern(benchmark_start_pattern_);
+    if (!config.benchmark_watch_file.empty()) {
+      benchmark_log_scanner_ =
+          LogScanner::FromFilename(config.benchmark_watch_file);
+      if (benchmark_log_scanner_)
+        benchmark_log_scanner_->RegisterWatchedPattern(
+            benchmark_start_pattern_);
+    }
+    StartControl("frame_time");
   }
 
   ~FrameTimeLayerData() override;
@@ -118,9 +110,19 @@ class FrameTimeLayerData : public LayerData {
   static constexpr uint64_t kInvalidFrameNum = ~uint64_t(0);
 
   // Returns the next frame number.
-  uint64_t IncrementFrameNum() { return ++current_frame_num_; }
+  uint64_t IncrementFrameNum() {
+    frames_metric_.Add();
+    return ++current_frame_num_;
+  }
   uint64_t GetExitFrameNum() const { return exit_frame_num_or_invalid_; }
 
+  // Records |frame_time| in the live metrics.
+  void RecordFrameTimeMetrics(Duration frame_time) {
+    const int64_t frame_time_us = frame_time.ToNanoseconds() / 1000;
+    frame_time_metric_.Record(frame_time_us);
+    last_frame_time_metric_.Set(frame_time_us);
+  }
+
   // Returns true if the benchmark gameplay start has been detected.
   // If benchmark start detection is not configured (through env vars),
   // assumes that the benchmarks begins with the first frame.
@@ -133,32 +135,27 @@ class FrameTimeLayerData : public LayerData {
   uint32_t benchmark_state_idx_ = 0;
   std::string benchmark_start_pattern_;
   std::optional<LogScanner> benchmark_log_scanner_;
+
+  Counter frames_metric_ =
+      MetricsRegistry::Get()->GetCounter("frame_time_frames_total");
+  Histogram frame_time_metric_ =
+      MetricsRegistry::Get()->GetHistogram("frame_time_frame_time_us");
+  Gauge last_frame_time_metric_ =
+      MetricsRegistry::Get()->GetGauge("frame_time_last_frame_time_us");
 };
 
 FrameTimeLayerData* GetLayerData() {
-  auto GetExitAfterFrameVal = [] {
-    if (const char* exit_after_frame_val_str = getenv(kExitAfterFrameEnvVar)) {
-      std::stringstream ss;
-      ss << exit_after_frame_val_str;
-      uint64_t exit_frame_val = FrameTimeLayerData::kInvalidFrameNum;
-      ss >> exit_frame_val;
-      return exit_frame_val;
-    }
-    return FrameTimeLayerData::kInvalidFrameNum;
-  };
-
   // Don't use new -- make the destructor run when the layer gets unloaded.
-  static FrameTimeLayerData layer_data(
-      getenv(kLogFilenameEnvVar), GetExitAfterFrameVal(),
-      getenv(kBenchmarkWatchFileEnvVar), getenv(kBenchmarkStartStringEnvVar));
+  static FrameTimeLayerData layer_data(GetLayerConfig().frame_time);
   return &layer_data;
 }
 
-// If |kFinishFileEnvVar| is set, this function will create a finish file with
-// under |finishCause| and time written under that location.
+// If "frame_time.finish_file" is set, this function will create a finish file
+// with under |finishCause| and time written under that location.
 void CreateFinishIndicatorFile(const char* finishCause) {
   assert(finishCause);
-  const char* finish_indicator_file = getenv(kFinishFileEnvVar);
+  const char* finish_indicator_file =
+      NullIfEmpty(GetLayerConfig().frame_time.finish_file);
   if (!finish_indicator_file) return;
 
   FILE* finish_file = fopen(finish_indicator_file, "w");
@@ -201,6 +198,21 @@ FrameTimeLayerData::~FrameTimeLayerData() {
   SPL_INTERCEPTED_VULKAN_FUNC(RETURN_TYPE_, FrameTimeLayer_, FUNC_NAME_, \
                               FUNC_ARGS_)
 
+// The functions intercepted by the layer, defined below with
+// SPL_FRAME_TIME_LAYER_FUNC.
+#define SPL_FRAME_TIME_LAYER_FUNCS(X_, LAYER_PREFIX_) \
+  X_(LAYER_PREFIX_, QueuePresentKHR)                  \
+  X_(LAYER_PREFIX_, DestroyInstance)                  \
+  X_(LAYER_PREFIX_, CreateInstance)                   \
+  X_(LAYER_PREFIX_, DestroyDevice)                    \
+  X_(LAYER_PREFIX_, CreateDevice)                     \
+  X_(LAYER_PREFIX_, EnumerateInstanceLayerProperties) \
+  X_(LAYER_PREFIX_, EnumerateDeviceLayerProperties)   \
+  X_(LAYER_PREFIX_, GetDeviceProcAddr)                \
+  X_(LAYER_PREFIX_, GetInstanceProcAddr)
+
+SPL_DECLARE_INTERCEPTED_FUNCTIONS(FrameTimeLayer_, SPL_FRAME_TIME_LAYER_FUNCS);
+
 //////////////////////////////////////////////////////////////////////////////
 //  Implementation of the instance functions we want to override.
 //////////////////////////////////////////////////////////////////////////////
@@ -210,11 +222,14 @@ SPL_FRAME_TIME_LAYER_FUNC(VkResult, QueuePresentKHR,
                            const VkPresentInfoKHR* present_info)) {
   auto* layer_data = GetLayerData();
 
+  // The time between presents is measured for every frame, so that the frames
+  // that are instrumented report their own time.
   Duration logged_delta = layer_data->GetTimeDelta();
-  if (logged_delta != Duration::Min()) {
+  if (logged_delta != Duration::Min() && layer_data->ShouldInstrument()) {
     FrameTimeEvent event("frame_present", logged_delta,
                          layer_data->HasBenchmarkStarted());
     layer_data->LogEvent(&event);
+    layer_data->RecordFrameTimeMetrics(logged_delta);
   }
 
   uint64_t frames_elapsed = layer_data->IncrementFrameNum();
@@ -337,6 +352,9 @@ SPL_FRAME_TIME_LAYER_FUNC(VkResult, EnumerateDeviceLayerProperties,
 
 }  // namespace
 
+SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE(FrameTimeLayer_,
+                                      SPL_FRAME_TIME_LAYER_FUNCS);
+
 // The *GetProcAddr functions are the entry points to the layers.
 // They return a function pointer for the instance requested by |name|.  We
 // return the functions defined in this layer for those we want to override.
@@ -347,24 +365,32 @@ SPL_LAYER_ENTRY_POINT SPL_FRAME_TIME_LAYER_FUNC(PFN_vkVoidFunction,
                                                 GetDeviceProcAddr,
                                                 (VkDevice device,
                                                  const char* name)) {
-  if (auto func = FunctionInterceptor::GetInterceptedOrNull(name)) {
-    return func;
-  }
-
   auto* layer_data = GetLayerData();
 
   PFN_vkGetDeviceProcAddr next_get_proc_addr =
       layer_data->GetNextDeviceProcAddr(
           device, &VkLayerDispatchTable::GetDeviceProcAddr);
   assert(next_get_proc_addr && next_get_proc_addr != VK_NULL_HANDLE);
-  return next_get_proc_addr(device, name);
+  // The functions of the features and extensions that the device didn't
+  // enable are null down the chain, and must stay null.
+  PFN_vkVoidFunction next_func = next_get_proc_addr(device, name);
+  if (!next_func) return nullptr;
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(FrameTimeLayer_, name)) {
+    return func;
+  }
+  return next_func;
 }
 
 SPL_LAYER_ENTRY_POINT SPL_FRAME_TIME_LAYER_FUNC(PFN_vkVoidFunction,
                                                 GetInstanceProcAddr,
                                                 (VkInstance instance,
                                                  const char* name)) {
-  if (auto func = FunctionInterceptor::GetInterceptedOrNull(name)) {
+  // The loader looks up the layer's functions here first, before calling any
+  // of them.
+  if (IsLayerOverheadProfilingEnabled()) {
+    GetLayerData()->SetOverheadProfiler(&FrameTimeLayer_kOverheadProfiler);
+  }
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(FrameTimeLayer_, name)) {
     return func;
   }
 
@@ -0,0 +1,109 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "allocation_churn_tracker.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/synchronization/mutex.h"
+
+namespace performancelayers {
+namespace {
+// Raises |max| to |value| if |value| is larger.
+void AtomicMax(std::atomic<int64_t>& max, int64_t value) {
+  int64_t current = max.load(std::memory_order_relaxed);
+  while (value > current && !max.compare_exchange_weak(
+                                current, value, std::memory_order_relaxed)) {
+  }
+}
+}  // namespace
+
+size_t GetAllocationSizeClass(VkDeviceSize size) {
+  size_t size_class = 0;
+  for (VkDeviceSize bound = kSmallestSizeClassBytes;
+       size > bound && size_class + 1 != kNumAllocationSizeClasses;
+       bound <<= 1) {
+    ++size_class;
+  }
+  return size_class;
+}
+
+AllocationChurnTracker::AllocationChurnTracker(uint64_t short_lived_frames)
+    : short_lived_frames_(short_lived_frames), window_start_(Now()) {}
+
+void AllocationChurnTracker::RecordAllocateMemory(VkDeviceSize size,
+                                                  Duration duration,
+                                                  bool succeeded) {
+  const int64_t duration_ns = duration.ToNanoseconds();
+  total_allocate_ns_.fetch_add(duration_ns, std::memory_order_relaxed);
+  AtomicMax(max_allocate_ns_, duration_ns);
+  if (!succeeded) {
+    failed_allocation_count_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  allocation_count_.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes_.fetch_add(size, std::memory_order_relaxed);
+  size_class_counts_[GetAllocationSizeClass(size)].fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+void AllocationChurnTracker::RecordFreeMemory(VkDeviceSize size,
+                                              Duration duration,
+                                              uint64_t lifetime_frames,
+                                              Duration lifetime) {
+  const int64_t duration_ns = duration.ToNanoseconds();
+  total_free_ns_.fetch_add(duration_ns, std::memory_order_relaxed);
+  AtomicMax(max_free_ns_, duration_ns);
+  free_count_.fetch_add(1, std::memory_order_relaxed);
+  freed_bytes_.fetch_add(size, std::memory_order_relaxed);
+  if (lifetime_frames < short_lived_frames_) {
+    short_lived_count_.fetch_add(1, std::memory_order_relaxed);
+    short_lived_bytes_.fetch_add(size, std::memory_order_relaxed);
+    total_short_lived_lifetime_ns_.fetch_add(lifetime.ToNanoseconds(),
+                                             std::memory_order_relaxed);
+  }
+}
+
+AllocationChurnStats AllocationChurnTracker::TakeWindow(
+    DurationClock::time_point now) {
+  auto take = [](auto& counter) {
+    return counter.exchange(0, std::memory_order_relaxed);
+  };
+
+  AllocationChurnStats stats;
+  {
+    absl::MutexLock lock(&window_lock_);
+    stats.window_duration = now - window_start_;
+    window_start_ = now;
+  }
+  stats.allocation_count = take(allocation_count_);
+  stats.failed_allocation_count = take(failed_allocation_count_);
+  stats.free_count = take(free_count_);
+  stats.allocated_bytes = take(allocated_bytes_);
+  stats.freed_bytes = take(freed_bytes_);
+  stats.total_allocate_ns = take(total_allocate_ns_);
+  stats.max_allocate_ns = take(max_allocate_ns_);
+  stats.total_free_ns = take(total_free_ns_);
+  stats.max_free_ns = take(max_free_ns_);
+  for (size_t i = 0; i != kNumAllocationSizeClasses; ++i)
+    stats.size_class_counts[i] = take(size_class_counts_[i]);
+  stats.short_lived_count = take(short_lived_count_);
+  stats.short_lived_bytes = take(short_lived_bytes_);
+  stats.total_short_lived_lifetime_ns = take(total_short_lived_lifetime_ns_);
+  return stats;
+}
+
+}  // namespace performancelayers
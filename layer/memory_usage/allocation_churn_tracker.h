@@ -0,0 +1,109 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_ALLOCATION_CHURN_TRACKER_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_ALLOCATION_CHURN_TRACKER_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/synchronization/mutex.h"
+#include "layer/support/layer_utils.h"
+
+namespace performancelayers {
+
+// The allocation sizes are bucketed into power-of-two size classes. The first
+// class holds allocations up to |kSmallestSizeClassBytes|, each following class
+// holds sizes up to twice the previous bound, and the last class holds
+// everything larger.
+constexpr size_t kNumAllocationSizeClasses = 16;
+constexpr VkDeviceSize kSmallestSizeClassBytes = 4096;
+
+// Returns the size class of an allocation of |size| bytes.
+size_t GetAllocationSizeClass(VkDeviceSize size);
+
+// The allocation activity observed during one window of frames.
+struct AllocationChurnStats {
+  Duration window_duration = Duration::FromNanoseconds(0);
+  uint64_t allocation_count = 0;
+  uint64_t failed_allocation_count = 0;
+  uint64_t free_count = 0;
+  VkDeviceSize allocated_bytes = 0;
+  VkDeviceSize freed_bytes = 0;
+  // The time spent in the driver's vkAllocateMemory and vkFreeMemory.
+  int64_t total_allocate_ns = 0;
+  int64_t max_allocate_ns = 0;
+  int64_t total_free_ns = 0;
+  int64_t max_free_ns = 0;
+  // The number of successful allocations per size class.
+  std::array<uint64_t, kNumAllocationSizeClasses> size_class_counts = {};
+  // The allocations freed within the short-lived frame threshold.
+  uint64_t short_lived_count = 0;
+  VkDeviceSize short_lived_bytes = 0;
+  int64_t total_short_lived_lifetime_ns = 0;
+};
+
+// Keeps the allocation and free counters of the current window of frames.
+// Recording is lock-free, so that it doesn't serialize allocating threads;
+// only |TakeWindow| takes a lock. A window taken while other threads record
+// may attribute a concurrent call's counters to either window.
+class AllocationChurnTracker {
+ public:
+  // Allocations freed less than |short_lived_frames| frames after they were
+  // allocated are counted as short-lived.
+  explicit AllocationChurnTracker(uint64_t short_lived_frames);
+
+  AllocationChurnTracker(const AllocationChurnTracker&) = delete;
+  AllocationChurnTracker& operator=(const AllocationChurnTracker&) = delete;
+
+  // Records a vkAllocateMemory call of |size| bytes that took |duration|.
+  void RecordAllocateMemory(VkDeviceSize size, Duration duration,
+                            bool succeeded);
+
+  // Records a vkFreeMemory call of an allocation of |size| bytes that took
+  // |duration|. The allocation lived for |lifetime_frames| frames and
+  // |lifetime|.
+  void RecordFreeMemory(VkDeviceSize size, Duration duration,
+                        uint64_t lifetime_frames, Duration lifetime);
+
+  // Returns the stats of the current window and starts a new one at |now|.
+  AllocationChurnStats TakeWindow(DurationClock::time_point now);
+
+ private:
+  const uint64_t short_lived_frames_;
+
+  std::atomic<uint64_t> allocation_count_ = 0;
+  std::atomic<uint64_t> failed_allocation_count_ = 0;
+  std::atomic<uint64_t> free_count_ = 0;
+  std::atomic<VkDeviceSize> allocated_bytes_ = 0;
+  std::atomic<VkDeviceSize> freed_bytes_ = 0;
+  std::atomic<int64_t> total_allocate_ns_ = 0;
+  std::atomic<int64_t> max_allocate_ns_ = 0;
+  std::atomic<int64_t> total_free_ns_ = 0;
+  std::atomic<int64_t> max_free_ns_ = 0;
+  std::array<std::atomic<uint64_t>, kNumAllocationSizeClasses>
+      size_class_counts_ = {};
+  std::atomic<uint64_t> short_lived_count_ = 0;
+  std::atomic<VkDeviceSize> short_lived_bytes_ = 0;
+  std::atomic<int64_t> total_short_lived_lifetime_ns_ = 0;
+
+  absl::Mutex window_lock_;
+  DurationClock::time_point window_start_ ABSL_GUARDED_BY(window_lock_);
+};
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_ALLOCATION_CHURN_TRACKER_H_
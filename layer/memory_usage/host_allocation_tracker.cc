@@ -0,0 +1,317 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "host_allocation_tracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include "absl/synchronization/mutex.h"
+
+namespace performancelayers {
+namespace {
+// The bookkeeping stored right before every pointer returned to the driver.
+struct AllocationHeader {
+  uint64_t size;
+  // The distance from the start of the underlying allocation to the pointer
+  // returned to the driver.
+  uint32_t offset;
+  uint8_t scope;
+  uint8_t source;
+};
+static_assert(sizeof(AllocationHeader) == 16);
+
+// The source of the allocations made by the current thread.
+thread_local HostAllocationSource current_source = HostAllocationSource::kOther;
+
+// Returns the alignment to request from the underlying allocator. The header
+// must be suitably aligned as well.
+size_t GetUnderlyingAlignment(size_t alignment) {
+  return std::max(alignment, alignof(AllocationHeader));
+}
+
+// Returns the number of bytes reserved in front of each allocation. It is a
+// multiple of |alignment| large enough to hold the header.
+size_t GetHeaderPadding(size_t alignment) {
+  return std::max(alignment, sizeof(AllocationHeader));
+}
+
+AllocationHeader* GetHeader(void* memory) {
+  return static_cast<AllocationHeader*>(memory) - 1;
+}
+
+// The C heap replacements for applications that don't provide callbacks.
+void* HeapAllocate(size_t size, size_t alignment) {
+  void* memory = nullptr;
+  if (posix_memalign(&memory, std::max(alignment, sizeof(void*)), size) != 0)
+    return nullptr;
+  return memory;
+}
+
+void* HeapReallocate(void* original, size_t original_size, size_t size,
+                     size_t alignment) {
+  void* memory = HeapAllocate(size, alignment);
+  if (!memory) return nullptr;
+  memcpy(memory, original, std::min(original_size, size));
+  free(original);
+  return memory;
+}
+}  // namespace
+
+const char* HostAllocationSourceToString(HostAllocationSource source) {
+  switch (source) {
+    case HostAllocationSource::kOther:
+      return "other";
+    case HostAllocationSource::kCreateInstance:
+      return "vkCreateInstance";
+    case HostAllocationSource::kCreateDevice:
+      return "vkCreateDevice";
+    case HostAllocationSource::kAllocateMemory:
+      return "vkAllocateMemory";
+    case HostAllocationSource::kCreateBuffer:
+      return "vkCreateBuffer";
+    case HostAllocationSource::kCreateImage:
+      return "vkCreateImage";
+    case HostAllocationSource::kCreateShaderModule:
+      return "vkCreateShaderModule";
+    case HostAllocationSource::kCreatePipelineCache:
+      return "vkCreatePipelineCache";
+    case HostAllocationSource::kCreatePipelines:
+      return "vkCreate*Pipelines";
+    case HostAllocationSource::kCreateDescriptorPool:
+      return "vkCreateDescriptorPool";
+    case HostAllocationSource::kAllocateDescriptorSets:
+      return "vkAllocateDescriptorSets";
+  }
+  assert(false && "Unknown host allocation source");
+  return "unknown";
+}
+
+HostAllocationTracker::ScopedSource::ScopedSource(HostAllocationSource source)
+    : previous_(current_source) {
+  current_source = source;
+}
+
+HostAllocationTracker::ScopedSource::~ScopedSource() {
+  current_source = previous_;
+}
+
+void HostAllocationTracker::AtomicUsage::Add(int64_t bytes,
+                                             bool new_allocation) {
+  const int64_t current =
+      current_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  int64_t peak = peak_bytes.load(std::memory_order_relaxed);
+  while (current > peak && !peak_bytes.compare_exchange_weak(
+                               peak, current, std::memory_order_relaxed)) {
+  }
+  if (new_allocation) allocation_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void HostAllocationTracker::AtomicUsage::Subtract(int64_t bytes) {
+  current_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+HostAllocationUsage HostAllocationTracker::AtomicUsage::Load() const {
+  HostAllocationUsage usage;
+  usage.current_bytes = current_bytes.load(std::memory_order_relaxed);
+  usage.peak_bytes = peak_bytes.load(std::memory_order_relaxed);
+  usage.allocation_count = allocation_count.load(std::memory_order_relaxed);
+  return usage;
+}
+
+HostAllocationTracker::HostAllocationTracker() : window_start_(Now()) {
+  InitCallbacks(&default_callbacks_, nullptr);
+}
+
+void HostAllocationTracker::InitCallbacks(
+    WrappedCallbacks* wrapped, const VkAllocationCallbacks* app_callbacks) {
+  wrapped->tracker = this;
+  if (app_callbacks) {
+    wrapped->has_app_callbacks = true;
+    wrapped->app_callbacks = *app_callbacks;
+  }
+  wrapped->callbacks.pUserData = wrapped;
+  wrapped->callbacks.pfnAllocation = &Allocate;
+  wrapped->callbacks.pfnReallocation = &Reallocate;
+  wrapped->callbacks.pfnFree = &Free;
+  wrapped->callbacks.pfnInternalAllocation = &InternalAllocationNotification;
+  wrapped->callbacks.pfnInternalFree = &InternalFreeNotification;
+}
+
+const VkAllocationCallbacks* HostAllocationTracker::GetCallbacks(
+    const VkAllocationCallbacks* app_callbacks) {
+  if (!app_callbacks) return &default_callbacks_.callbacks;
+
+  AppCallbacksKey key = {
+      app_callbacks->pUserData,          app_callbacks->pfnAllocation,
+      app_callbacks->pfnReallocation,    app_callbacks->pfnFree,
+      app_callbacks->pfnInternalAllocation, app_callbacks->pfnInternalFree};
+  absl::MutexLock lock(&wrapped_callbacks_lock_);
+  std::unique_ptr<WrappedCallbacks>& wrapped = wrapped_callbacks_[key];
+  if (!wrapped) {
+    wrapped = std::make_unique<WrappedCallbacks>();
+    InitCallbacks(wrapped.get(), app_callbacks);
+  }
+  return &wrapped->callbacks;
+}
+
+void HostAllocationTracker::RecordAllocation(size_t scope, size_t source,
+                                             int64_t bytes,
+                                             bool new_allocation) {
+  total_.Add(bytes, new_allocation);
+  if (scope < kNumHostAllocationScopes)
+    by_scope_[scope].Add(bytes, new_allocation);
+  by_source_[source].Add(bytes, new_allocation);
+  if (new_allocation)
+    window_allocation_count_.fetch_add(1, std::memory_order_relaxed);
+  if (bytes > 0)
+    window_allocated_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void HostAllocationTracker::RecordFree(size_t scope, size_t source,
+                                       int64_t bytes) {
+  total_.Subtract(bytes);
+  if (scope < kNumHostAllocationScopes) by_scope_[scope].Subtract(bytes);
+  by_source_[source].Subtract(bytes);
+}
+
+void* HostAllocationTracker::Allocate(void* user_data, size_t size,
+                                      size_t alignment,
+                                      VkSystemAllocationScope scope) {
+  auto* wrapped = static_cast<WrappedCallbacks*>(user_data);
+  const size_t padding = GetHeaderPadding(alignment);
+  const size_t underlying_alignment = GetUnderlyingAlignment(alignment);
+  void* base =
+      wrapped->has_app_callbacks
+          ? wrapped->app_callbacks.pfnAllocation(
+                wrapped->app_callbacks.pUserData, size + padding,
+                underlying_alignment, scope)
+          : HeapAllocate(size + padding, underlying_alignment);
+  if (!base) return nullptr;
+
+  void* memory = static_cast<char*>(base) + padding;
+  AllocationHeader* header = GetHeader(memory);
+  header->size = size;
+  header->offset = static_cast<uint32_t>(padding);
+  header->scope = static_cast<uint8_t>(scope);
+  header->source = static_cast<uint8_t>(current_source);
+  wrapped->tracker->RecordAllocation(header->scope, header->source,
+                                     static_cast<int64_t>(size), true);
+  return memory;
+}
+
+void* HostAllocationTracker::Reallocate(void* user_data, void* original,
+                                        size_t size, size_t alignment,
+                                        VkSystemAllocationScope scope) {
+  if (!original) return Allocate(user_data, size, alignment, scope);
+  if (size == 0) {
+    Free(user_data, original);
+    return nullptr;
+  }
+
+  auto* wrapped = static_cast<WrappedCallbacks*>(user_data);
+  const AllocationHeader original_header = *GetHeader(original);
+  const size_t padding = original_header.offset;
+  assert(padding == GetHeaderPadding(alignment) &&
+         "Reallocation with a different alignment");
+  void* original_base = static_cast<char*>(original) - padding;
+  const size_t underlying_alignment = GetUnderlyingAlignment(alignment);
+  void* base =
+      wrapped->has_app_callbacks
+          ? wrapped->app_callbacks.pfnReallocation(
+                wrapped->app_callbacks.pUserData, original_base,
+                size + padding, underlying_alignment, scope)
+          : HeapReallocate(original_base, original_header.size + padding,
+                           size + padding, underlying_alignment);
+  if (!base) return nullptr;
+
+  void* memory = static_cast<char*>(base) + padding;
+  GetHeader(memory)->size = size;
+  // The allocation stays attributed to the call that made it.
+  wrapped->tracker->RecordAllocation(
+      original_header.scope, original_header.source,
+      static_cast<int64_t>(size) - static_cast<int64_t>(original_header.size),
+      false);
+  return memory;
+}
+
+void HostAllocationTracker::Free(void* user_data, void* memory) {
+  if (!memory) return;
+  auto* wrapped = static_cast<WrappedCallbacks*>(user_data);
+  const AllocationHeader* header = GetHeader(memory);
+  wrapped->tracker->RecordFree(header->scope, header->source,
+                               static_cast<int64_t>(header->size));
+  void* base = static_cast<char*>(memory) - header->offset;
+  if (wrapped->has_app_callbacks) {
+    wrapped->app_callbacks.pfnFree(wrapped->app_callbacks.pUserData, base);
+  } else {
+    free(base);
+  }
+}
+
+void HostAllocationTracker::InternalAllocationNotification(
+    void* user_data, size_t size, VkInternalAllocationType type,
+    VkSystemAllocationScope scope) {
+  auto* wrapped = static_cast<WrappedCallbacks*>(user_data);
+  wrapped->tracker->internal_current_bytes_.fetch_add(
+      static_cast<int64_t>(size), std::memory_order_relaxed);
+  if (wrapped->has_app_callbacks &&
+      wrapped->app_callbacks.pfnInternalAllocation) {
+    wrapped->app_callbacks.pfnInternalAllocation(
+        wrapped->app_callbacks.pUserData, size, type, scope);
+  }
+}
+
+void HostAllocationTracker::InternalFreeNotification(
+    void* user_data, size_t size, VkInternalAllocationType type,
+    VkSystemAllocationScope scope) {
+  auto* wrapped = static_cast<WrappedCallbacks*>(user_data);
+  wrapped->tracker->internal_current_bytes_.fetch_sub(
+      static_cast<int64_t>(size), std::memory_order_relaxed);
+  if (wrapped->has_app_callbacks && wrapped->app_callbacks.pfnInternalFree) {
+    wrapped->app_callbacks.pfnInternalFree(wrapped->app_callbacks.pUserData,
+                                           size, type, scope);
+  }
+}
+
+HostMemoryStats HostAllocationTracker::TakeStats(
+    DurationClock::time_point now) {
+  HostMemoryStats stats;
+  {
+    absl::MutexLock lock(&window_lock_);
+    stats.window_duration = now - window_start_;
+    window_start_ = now;
+  }
+  stats.window_allocation_count =
+      window_allocation_count_.exchange(0, std::memory_order_relaxed);
+  stats.window_allocated_bytes =
+      window_allocated_bytes_.exchange(0, std::memory_order_relaxed);
+
+  stats.total = total_.Load();
+  for (size_t i = 0; i != kNumHostAllocationScopes; ++i)
+    stats.by_scope[i] = by_scope_[i].Load();
+  for (size_t i = 0; i != kNumHostAllocationSources; ++i)
+    stats.by_source[i] = by_source_[i].Load();
+  stats.internal_current_bytes =
+      internal_current_bytes_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+}  // namespace performancelayers
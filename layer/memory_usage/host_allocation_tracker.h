@@ -0,0 +1,185 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_HOST_ALLOCATION_TRACKER_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_HOST_ALLOCATION_TRACKER_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "layer/support/layer_utils.h"
+
+namespace performancelayers {
+
+// The Vulkan call during which the driver made a host allocation.
+enum class HostAllocationSource : uint8_t {
+  kOther,
+  kCreateInstance,
+  kCreateDevice,
+  kAllocateMemory,
+  kCreateBuffer,
+  kCreateImage,
+  kCreateShaderModule,
+  kCreatePipelineCache,
+  kCreatePipelines,
+  kCreateDescriptorPool,
+  kAllocateDescriptorSets,
+};
+constexpr size_t kNumHostAllocationSources =
+    static_cast<size_t>(HostAllocationSource::kAllocateDescriptorSets) + 1;
+
+// VkSystemAllocationScope has the values 0 (command) to 4 (instance).
+constexpr size_t kNumHostAllocationScopes = 5;
+
+// Returns the name of the Vulkan call, e.g., "vkCreateDevice", or "other".
+const char* HostAllocationSourceToString(HostAllocationSource source);
+
+// The current and peak number of bytes of one group of host allocations.
+struct HostAllocationUsage {
+  int64_t current_bytes = 0;
+  int64_t peak_bytes = 0;
+  // The number of allocations made since the tracker was created.
+  uint64_t allocation_count = 0;
+};
+
+struct HostMemoryStats {
+  HostAllocationUsage total;
+  std::array<HostAllocationUsage, kNumHostAllocationScopes> by_scope;
+  std::array<HostAllocationUsage, kNumHostAllocationSources> by_source;
+  // The memory the driver reported through the internal allocation
+  // notifications. It is not part of the totals above.
+  int64_t internal_current_bytes = 0;
+  // The allocations made since the previous window.
+  Duration window_duration = Duration::FromNanoseconds(0);
+  uint64_t window_allocation_count = 0;
+  uint64_t window_allocated_bytes = 0;
+};
+
+// Tracks the host memory the driver allocates through VkAllocationCallbacks.
+//
+// The tracker hands out its own callbacks, to be passed down the chain in place
+// of the application's. They forward to the application's callbacks if there
+// were any, and to the C heap otherwise. Each allocation is prefixed with a
+// small header that records its size, scope and source, so that the
+// bookkeeping needs no lookups and no locks. All counters are atomics.
+//
+// The same substitution must be done for the creation and the destruction of
+// an object, since Vulkan requires compatible callbacks for both.
+class HostAllocationTracker {
+ public:
+  // Sets the source of the host allocations made by the current thread for the
+  // lifetime of the object.
+  class ScopedSource {
+   public:
+    explicit ScopedSource(HostAllocationSource source);
+    ~ScopedSource();
+
+    ScopedSource(const ScopedSource&) = delete;
+    ScopedSource& operator=(const ScopedSource&) = delete;
+
+   private:
+    HostAllocationSource previous_;
+  };
+
+  HostAllocationTracker();
+
+  HostAllocationTracker(const HostAllocationTracker&) = delete;
+  HostAllocationTracker& operator=(const HostAllocationTracker&) = delete;
+
+  // Returns the callbacks to pass down the chain in place of |app_callbacks|.
+  // The returned pointer stays valid for the lifetime of the tracker.
+  const VkAllocationCallbacks* GetCallbacks(
+      const VkAllocationCallbacks* app_callbacks);
+
+  // Returns the counters. The window counters are reset and a new window is
+  // started at |now|.
+  HostMemoryStats TakeStats(DurationClock::time_point now);
+
+ private:
+  // The callbacks handed to the driver for one set of application callbacks.
+  struct WrappedCallbacks {
+    HostAllocationTracker* tracker = nullptr;
+    // A copy of the application's callbacks, if it provided any.
+    bool has_app_callbacks = false;
+    VkAllocationCallbacks app_callbacks = {};
+    // The callbacks passed down the chain. Their user data points to this
+    // struct.
+    VkAllocationCallbacks callbacks = {};
+  };
+
+  struct AtomicUsage {
+    std::atomic<int64_t> current_bytes = 0;
+    std::atomic<int64_t> peak_bytes = 0;
+    std::atomic<uint64_t> allocation_count = 0;
+
+    void Add(int64_t bytes, bool new_allocation);
+    void Subtract(int64_t bytes);
+    HostAllocationUsage Load() const;
+  };
+
+  static void* VKAPI_PTR Allocate(void* user_data, size_t size,
+                                  size_t alignment,
+                                  VkSystemAllocationScope scope);
+  static void* VKAPI_PTR Reallocate(void* user_data, void* original,
+                                    size_t size, size_t alignment,
+                                    VkSystemAllocationScope scope);
+  static void VKAPI_PTR Free(void* user_data, void* memory);
+  static void VKAPI_PTR InternalAllocationNotification(
+      void* user_data, size_t size, VkInternalAllocationType type,
+      VkSystemAllocationScope scope);
+  static void VKAPI_PTR InternalFreeNotification(
+      void* user_data, size_t size, VkInternalAllocationType type,
+      VkSystemAllocationScope scope);
+
+  void InitCallbacks(WrappedCallbacks* wrapped,
+                     const VkAllocationCallbacks* app_callbacks);
+
+  void RecordAllocation(size_t scope, size_t source, int64_t bytes,
+                        bool new_allocation);
+  void RecordFree(size_t scope, size_t source, int64_t bytes);
+
+  AtomicUsage total_;
+  std::array<AtomicUsage, kNumHostAllocationScopes> by_scope_;
+  std::array<AtomicUsage, kNumHostAllocationSources> by_source_;
+  std::atomic<int64_t> internal_current_bytes_ = 0;
+  std::atomic<uint64_t> window_allocation_count_ = 0;
+  std::atomic<uint64_t> window_allocated_bytes_ = 0;
+
+  absl::Mutex window_lock_;
+  DurationClock::time_point window_start_ ABSL_GUARDED_BY(window_lock_);
+
+  // Used when the application doesn't provide callbacks.
+  WrappedCallbacks default_callbacks_;
+
+  using AppCallbacksKey =
+      std::tuple<void*, PFN_vkAllocationFunction, PFN_vkReallocationFunction,
+                 PFN_vkFreeFunction, PFN_vkInternalAllocationNotification,
+                 PFN_vkInternalFreeNotification>;
+  absl::Mutex wrapped_callbacks_lock_;
+  // Applications use very few distinct sets of callbacks, so the wrappers are
+  // created once per set and never freed: the driver may keep using them until
+  // the objects they were passed for are destroyed.
+  absl::flat_hash_map<AppCallbacksKey, std::unique_ptr<WrappedCallbacks>>
+      wrapped_callbacks_ ABSL_GUARDED_BY(wrapped_callbacks_lock_);
+};
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_HOST_ALLOCATION_TRACKER_H_
@@ -0,0 +1,368 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "memory_resource_tracker.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
+#include "absl/synchronization/mutex.h"
+
+namespace performancelayers {
+
+const char* ResourceKindToString(ResourceKind kind) {
+  switch (kind) {
+    case ResourceKind::kBuffer:
+      return "buffer";
+    case ResourceKind::kImage:
+      return "image";
+  }
+  assert(false && "Unknown resource kind");
+  return "unknown";
+}
+
+namespace {
+// Returns the key of |handle| in the resource shards.
+template <typename Handle>
+uintptr_t HandleKey(Handle handle) {
+  return reinterpret_cast<uintptr_t>(handle);
+}
+}  // namespace
+
+AllocationUtilization ComputeUtilization(
+    VkDeviceMemory memory, VkDeviceSize allocation_size,
+    const std::vector<BoundRange>& ranges) {
+  AllocationUtilization utilization;
+  utilization.memory = memory;
+  utilization.allocation_size = allocation_size;
+  utilization.resource_count = ranges.size();
+
+  // Collect the bound ranges, clamped to the allocation, sorted by offset.
+  std::vector<std::pair<VkDeviceSize, VkDeviceSize>> clamped;
+  clamped.reserve(ranges.size());
+  for (const BoundRange& range : ranges) {
+    const VkDeviceSize begin = std::min(range.offset, allocation_size);
+    const VkDeviceSize end =
+        std::min(begin + range.required_size, allocation_size);
+    clamped.emplace_back(begin, end);
+    if (range.kind == ResourceKind::kBuffer &&
+        range.required_size > range.requested_size) {
+      utilization.padding_bytes += range.required_size - range.requested_size;
+    }
+  }
+  std::sort(clamped.begin(), clamped.end());
+
+  // Walk the ranges in order, merging overlapping (aliased) ranges and keeping
+  // track of the gaps between them.
+  VkDeviceSize covered_end = 0;
+  VkDeviceSize largest_gap = 0;
+  for (const auto& [begin, end] : clamped) {
+    if (begin > covered_end) {
+      largest_gap = std::max(largest_gap, begin - covered_end);
+    } else if (end <= covered_end) {
+      continue;
+    }
+    utilization.bound_bytes += end - std::max(begin, covered_end);
+    covered_end = end;
+  }
+  largest_gap = std::max(largest_gap, allocation_size - covered_end);
+
+  utilization.wasted_bytes = allocation_size - utilization.bound_bytes;
+  utilization.fragmented_bytes = utilization.wasted_bytes - largest_gap;
+  return utilization;
+}
+
+MemoryResourceTracker::DeviceResources::MemoryShard&
+MemoryResourceTracker::DeviceResources::GetShard(VkDeviceMemory memory) {
+  return memory_shards[absl::Hash<VkDeviceMemory>{}(memory) % kNumShards];
+}
+
+MemoryResourceTracker::DeviceResources::ResourceShard&
+MemoryResourceTracker::DeviceResources::GetShard(const ResourceKey& key) {
+  return resource_shards[absl::Hash<ResourceKey>{}(key) % kNumShards];
+}
+
+void MemoryResourceTracker::AddDevice(VkDevice device) {
+  absl::MutexLock lock(&devices_lock_);
+  devices_.try_emplace(device, std::make_unique<DeviceResources>());
+}
+
+void MemoryResourceTracker::RemoveDevice(VkDevice device) {
+  std::unique_ptr<DeviceResources> resources;
+  {
+    absl::MutexLock lock(&devices_lock_);
+    auto it = devices_.find(device);
+    if (it == devices_.end()) return;
+    resources = std::move(it->second);
+    devices_.erase(it);
+  }
+  // |resources| is freed outside of the lock.
+}
+
+MemoryResourceTracker::DeviceResources* MemoryResourceTracker::GetDevice(
+    VkDevice device) const {
+  absl::ReaderMutexLock lock(&devices_lock_);
+  auto it = devices_.find(device);
+  return it == devices_.end() ? nullptr : it->second.get();
+}
+
+void MemoryResourceTracker::RecordAllocateMemory(VkDevice device,
+                                                 VkDeviceMemory memory,
+                                                 VkDeviceSize size) {
+  DeviceResources* resources = GetDevice(device);
+  if (!resources) return;
+  DeviceResources::MemoryShard& shard = resources->GetShard(memory);
+  absl::MutexLock lock(&shard.lock);
+  shard.memories.insert_or_assign(memory, MemoryBindings{size, {}});
+}
+
+void MemoryResourceTracker::RecordFreeMemory(VkDevice device,
+                                             VkDeviceMemory memory) {
+  DeviceResources* resources = GetDevice(device);
+  if (!resources) return;
+  MemoryBindings bindings;
+  {
+    DeviceResources::MemoryShard& shard = resources->GetShard(memory);
+    absl::MutexLock lock(&shard.lock);
+    auto it = shard.memories.find(memory);
+    if (it == shard.memories.end()) return;
+    bindings = std::move(it->second);
+    shard.memories.erase(it);
+  }
+  // Vulkan allows freeing memory that still has resources bound to it. The
+  // resources stay alive, but no longer occupy any memory.
+  for (const auto& [key, range] : bindings.resources) {
+    DeviceResources::ResourceShard& shard = resources->GetShard(key);
+    absl::MutexLock lock(&shard.lock);
+    auto it = shard.resources.find(key);
+    if (it == shard.resources.end() || it->second.memory != memory) continue;
+    it->second.memory = VK_NULL_HANDLE;
+    it->second.memory_offset = 0;
+  }
+}
+
+void MemoryResourceTracker::RecordCreateBuffer(VkDevice device, VkBuffer buffer,
+                                               const ResourceInfo& info) {
+  assert(info.kind == ResourceKind::kBuffer);
+  CreateResource(device, {ResourceKind::kBuffer, HandleKey(buffer)}, info);
+}
+
+void MemoryResourceTracker::RecordCreateImage(VkDevice device, VkImage image,
+                                              const ResourceInfo& info) {
+  assert(info.kind == ResourceKind::kImage);
+  CreateResource(device, {ResourceKind::kImage, HandleKey(image)}, info);
+}
+
+void MemoryResourceTracker::RecordDestroyBuffer(VkDevice device,
+                                                VkBuffer buffer) {
+  DestroyResource(device, {ResourceKind::kBuffer, HandleKey(buffer)});
+}
+
+void MemoryResourceTracker::RecordDestroyImage(VkDevice device, VkImage image) {
+  DestroyResource(device, {ResourceKind::kImage, HandleKey(image)});
+}
+
+void MemoryResourceTracker::RecordBindBufferMemory(VkDevice device,
+                                                   VkBuffer buffer,
+                                                   VkDeviceMemory memory,
+                                                   VkDeviceSize offset) {
+  BindResource(device, {ResourceKind::kBuffer, HandleKey(buffer)}, memory,
+               offset);
+}
+
+void MemoryResourceTracker::RecordBindImageMemory(VkDevice device,
+                                                  VkImage image,
+                                                  VkDeviceMemory memory,
+                                                  VkDeviceSize offset) {
+  BindResource(device, {ResourceKind::kImage, HandleKey(image)}, memory,
+               offset);
+}
+
+void MemoryResourceTracker::CreateResource(VkDevice device,
+                                           const ResourceKey& key,
+                                           const ResourceInfo& info) {
+  assert(info.memory == VK_NULL_HANDLE);
+  DeviceResources* resources = GetDevice(device);
+  if (!resources) return;
+  VkDeviceMemory stale_memory = VK_NULL_HANDLE;
+  {
+    DeviceResources::ResourceShard& shard = resources->GetShard(key);
+    absl::MutexLock lock(&shard.lock);
+    auto [it, inserted] = shard.resources.try_emplace(key, info);
+    if (!inserted) {
+      stale_memory = it->second.memory;
+      it->second = info;
+    }
+  }
+  // The handle was reused without the destroy call being seen.
+  if (stale_memory != VK_NULL_HANDLE)
+    UnbindResource(resources, key, stale_memory);
+}
+
+void MemoryResourceTracker::DestroyResource(VkDevice device,
+                                            const ResourceKey& key) {
+  DeviceResources* resources = GetDevice(device);
+  if (!resources) return;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  {
+    DeviceResources::ResourceShard& shard = resources->GetShard(key);
+    absl::MutexLock lock(&shard.lock);
+    auto it = shard.resources.find(key);
+    if (it == shard.resources.end()) return;
+    memory = it->second.memory;
+    shard.resources.erase(it);
+  }
+  if (memory != VK_NULL_HANDLE) UnbindResource(resources, key, memory);
+}
+
+void MemoryResourceTracker::BindResource(VkDevice device,
+                                         const ResourceKey& key,
+                                         VkDeviceMemory memory,
+                                         VkDeviceSize offset) {
+  DeviceResources* resources = GetDevice(device);
+  if (!resources) return;
+  BoundRange range;
+  VkDeviceMemory old_memory = VK_NULL_HANDLE;
+  {
+    DeviceResources::ResourceShard& shard = resources->GetShard(key);
+    absl::MutexLock lock(&shard.lock);
+    auto it = shard.resources.find(key);
+    if (it == shard.resources.end()) return;
+    ResourceInfo& info = it->second;
+    // Resources can only be bound once, but the old binding may be stale if
+    // the handle was reused without the destroy call being seen.
+    old_memory = info.memory;
+    info.memory = memory;
+    info.memory_offset = offset;
+    range = {info.kind, offset, info.required_size, info.requested_size};
+  }
+  if (old_memory != VK_NULL_HANDLE)
+    UnbindResource(resources, key, old_memory);
+
+  bool bound = false;
+  {
+    DeviceResources::MemoryShard& shard = resources->GetShard(memory);
+    absl::MutexLock lock(&shard.lock);
+    auto it = shard.memories.find(memory);
+    if (it != shard.memories.end()) {
+      it->second.resources.insert_or_assign(key, range);
+      bound = true;
+    }
+  }
+  if (bound) return;
+
+  // |memory| is unknown, so the resource stays unbound.
+  DeviceResources::ResourceShard& shard = resources->GetShard(key);
+  absl::MutexLock lock(&shard.lock);
+  auto it = shard.resources.find(key);
+  if (it == shard.resources.end() || it->second.memory != memory) return;
+  it->second.memory = VK_NULL_HANDLE;
+  it->second.memory_offset = 0;
+}
+
+void MemoryResourceTracker::UnbindResource(DeviceResources* resources,
+                                           const ResourceKey& key,
+                                           VkDeviceMemory memory) {
+  assert(resources);
+  DeviceResources::MemoryShard& shard = resources->GetShard(memory);
+  absl::MutexLock lock(&shard.lock);
+  if (auto it = shard.memories.find(memory); it != shard.memories.end())
+    it->second.resources.erase(key);
+}
+
+ResourceAttributionReport MemoryResourceTracker::GetReport(
+    size_t max_allocations, size_t max_resource_classes) const {
+  ResourceAttributionReport report;
+  absl::flat_hash_map<std::tuple<ResourceKind, VkFlags, VkFormat>,
+                      ResourceClassUsage>
+      classes;
+  auto add_to_class = [&report, &classes](const ResourceInfo& resource) {
+    if (resource.memory == VK_NULL_HANDLE) {
+      ++report.unbound_resource_count;
+      return;
+    }
+    ResourceClassUsage& usage =
+        classes[{resource.kind, resource.usage, resource.format}];
+    usage.kind = resource.kind;
+    usage.usage = resource.usage;
+    usage.format = resource.format;
+    ++usage.resource_count;
+    usage.bytes += resource.required_size;
+  };
+
+  {
+    std::vector<BoundRange> ranges;
+    absl::ReaderMutexLock devices_lock(&devices_lock_);
+    for (const auto& [device, resources] : devices_) {
+      for (const DeviceResources::MemoryShard& shard :
+           resources->memory_shards) {
+        absl::MutexLock lock(&shard.lock);
+        report.allocation_count += shard.memories.size();
+        for (const auto& [memory, bindings] : shard.memories) {
+          ranges.clear();
+          for (const auto& [key, range] : bindings.resources)
+            ranges.push_back(range);
+          AllocationUtilization utilization =
+              ComputeUtilization(memory, bindings.allocation_size, ranges);
+          report.allocation_bytes += utilization.allocation_size;
+          report.bound_bytes += utilization.bound_bytes;
+          report.wasted_bytes += utilization.wasted_bytes;
+          report.fragmented_bytes += utilization.fragmented_bytes;
+          report.padding_bytes += utilization.padding_bytes;
+          report.most_wasteful_allocations.push_back(utilization);
+        }
+      }
+      for (const DeviceResources::ResourceShard& shard :
+           resources->resource_shards) {
+        absl::MutexLock lock(&shard.lock);
+        for (const auto& [key, resource] : shard.resources)
+          add_to_class(resource);
+      }
+    }
+  }
+
+  auto& allocations = report.most_wasteful_allocations;
+  const size_t num_allocations = std::min(max_allocations, allocations.size());
+  std::partial_sort(allocations.begin(), allocations.begin() + num_allocations,
+                    allocations.end(),
+                    [](const AllocationUtilization& lhs,
+                       const AllocationUtilization& rhs) {
+                      return lhs.wasted_bytes > rhs.wasted_bytes;
+                    });
+  allocations.resize(num_allocations);
+
+  auto& largest_classes = report.largest_resource_classes;
+  largest_classes.reserve(classes.size());
+  for (const auto& [key, usage] : classes) largest_classes.push_back(usage);
+  const size_t num_classes =
+      std::min(max_resource_classes, largest_classes.size());
+  std::partial_sort(
+      largest_classes.begin(), largest_classes.begin() + num_classes,
+      largest_classes.end(),
+      [](const ResourceClassUsage& lhs, const ResourceClassUsage& rhs) {
+        return lhs.bytes > rhs.bytes;
+      });
+  largest_classes.resize(num_classes);
+  return report;
+}
+
+}  // namespace performancelayers
@@ -0,0 +1,224 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_MEMORY_RESOURCE_TRACKER_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_MEMORY_RESOURCE_TRACKER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "layer/support/layer_utils.h"
+
+namespace performancelayers {
+
+enum class ResourceKind { kBuffer, kImage };
+
+// Returns "buffer" or "image".
+const char* ResourceKindToString(ResourceKind kind);
+
+// The creation parameters and memory binding of a buffer or an image.
+struct ResourceInfo {
+  ResourceKind kind = ResourceKind::kBuffer;
+  // VkBufferUsageFlags or VkImageUsageFlags.
+  VkFlags usage = 0;
+  // The size requested in VkBufferCreateInfo. Always 0 for images.
+  VkDeviceSize requested_size = 0;
+  // The image parameters. Left at their defaults for buffers.
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  VkExtent3D extent = {0, 0, 0};
+  uint32_t mip_levels = 0;
+  uint32_t array_layers = 0;
+  // The size the resource occupies in its memory, as reported by
+  // vkGet*MemoryRequirements.
+  VkDeviceSize required_size = 0;
+
+  // The memory range the resource is bound to. |memory| is VK_NULL_HANDLE
+  // until the resource is bound, and after its memory is freed.
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize memory_offset = 0;
+};
+
+// The range of a VkDeviceMemory a buffer or an image is bound to.
+struct BoundRange {
+  ResourceKind kind = ResourceKind::kBuffer;
+  VkDeviceSize offset = 0;
+  // See ResourceInfo.
+  VkDeviceSize required_size = 0;
+  VkDeviceSize requested_size = 0;
+};
+
+// How well the resources bound to a single VkDeviceMemory fill it.
+struct AllocationUtilization {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize allocation_size = 0;
+  uint64_t resource_count = 0;
+  // The number of bytes covered by at least one bound resource. Aliased
+  // resources are only counted once.
+  VkDeviceSize bound_bytes = 0;
+  // |allocation_size| - |bound_bytes|.
+  VkDeviceSize wasted_bytes = 0;
+  // The wasted bytes outside of the largest unbound range. A resource larger
+  // than the largest unbound range cannot be placed in this allocation even
+  // if it is smaller than |wasted_bytes|.
+  VkDeviceSize fragmented_bytes = 0;
+  // Bytes the driver added on top of the requested buffer sizes to satisfy
+  // size and alignment requirements.
+  VkDeviceSize padding_bytes = 0;
+};
+
+// The resources sharing the same kind, usage and format, bound to any memory.
+struct ResourceClassUsage {
+  ResourceKind kind = ResourceKind::kBuffer;
+  VkFlags usage = 0;
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  uint64_t resource_count = 0;
+  VkDeviceSize bytes = 0;
+};
+
+struct ResourceAttributionReport {
+  uint64_t allocation_count = 0;
+  VkDeviceSize allocation_bytes = 0;
+  VkDeviceSize bound_bytes = 0;
+  VkDeviceSize wasted_bytes = 0;
+  VkDeviceSize fragmented_bytes = 0;
+  VkDeviceSize padding_bytes = 0;
+  // The number of live resources that are not bound to any memory.
+  uint64_t unbound_resource_count = 0;
+  // The allocations with the most wasted bytes, in decreasing order.
+  std::vector<AllocationUtilization> most_wasteful_allocations;
+  // The resource classes occupying the most bytes, in decreasing order.
+  std::vector<ResourceClassUsage> largest_resource_classes;
+};
+
+// Computes how well the resources bound at |ranges| fill |memory|, an
+// allocation of |allocation_size| bytes. Ranges may overlap (alias) and extend
+// past the end of the allocation.
+AllocationUtilization ComputeUtilization(VkDeviceMemory memory,
+                                         VkDeviceSize allocation_size,
+                                         const std::vector<BoundRange>& ranges);
+
+// Attributes device memory allocations to the buffers and images bound to
+// them. Engines usually suballocate large VkDeviceMemory blocks; this tracker
+// records which ranges of each block are used and by what kind of resource, so
+// that unused and fragmented memory can be reported.
+//
+// All methods are thread-safe. Allocations and resources are kept in
+// per-device tables split into independently locked shards, like
+// DeviceMemoryTable, so that calls on different handles rarely contend and
+// destroying a device drops its table at once.
+class MemoryResourceTracker {
+ public:
+  MemoryResourceTracker() = default;
+
+  MemoryResourceTracker(const MemoryResourceTracker&) = delete;
+  MemoryResourceTracker& operator=(const MemoryResourceTracker&) = delete;
+
+  // Creates the table of |device|. Calls for devices without a table are
+  // ignored.
+  void AddDevice(VkDevice device);
+
+  // Drops all resources and allocations that belong to |device|.
+  void RemoveDevice(VkDevice device);
+
+  void RecordAllocateMemory(VkDevice device, VkDeviceMemory memory,
+                            VkDeviceSize size);
+
+  // Removes |memory| and unbinds all resources bound to it.
+  void RecordFreeMemory(VkDevice device, VkDeviceMemory memory);
+
+  // Records a new, unbound buffer. |info| must hold the creation parameters
+  // and the memory requirements of |buffer|.
+  void RecordCreateBuffer(VkDevice device, VkBuffer buffer,
+                          const ResourceInfo& info);
+  void RecordCreateImage(VkDevice device, VkImage image,
+                         const ResourceInfo& info);
+
+  void RecordDestroyBuffer(VkDevice device, VkBuffer buffer);
+  void RecordDestroyImage(VkDevice device, VkImage image);
+
+  // Records that |buffer| was bound to |memory| at |offset|. Buffers and
+  // memory the tracker doesn't know about are ignored.
+  void RecordBindBufferMemory(VkDevice device, VkBuffer buffer,
+                              VkDeviceMemory memory, VkDeviceSize offset);
+  void RecordBindImageMemory(VkDevice device, VkImage image,
+                             VkDeviceMemory memory, VkDeviceSize offset);
+
+  // Computes the utilization of all live allocations. At most
+  // |max_allocations| allocations and |max_resource_classes| resource classes
+  // are included in the report.
+  ResourceAttributionReport GetReport(size_t max_allocations,
+                                      size_t max_resource_classes) const;
+
+ private:
+  // Buffers and images share the resource shards, keyed by kind and handle.
+  using ResourceKey = std::pair<ResourceKind, uintptr_t>;
+
+  struct MemoryBindings {
+    VkDeviceSize allocation_size = 0;
+    absl::flat_hash_map<ResourceKey, BoundRange> resources;
+  };
+
+  // The allocations and resources of a single device. An allocation and the
+  // resources bound to it usually live in different shards. The shards are
+  // never locked together: a bind updates the resource's shard and then the
+  // memory's shard, relying on Vulkan's external synchronization of the
+  // resource and memory handles to keep both sides consistent.
+  struct DeviceResources {
+    static constexpr size_t kNumShards = 8;
+
+    struct MemoryShard {
+      mutable absl::Mutex lock;
+      absl::flat_hash_map<VkDeviceMemory, MemoryBindings> memories
+          ABSL_GUARDED_BY(lock);
+    };
+
+    struct ResourceShard {
+      mutable absl::Mutex lock;
+      absl::flat_hash_map<ResourceKey, ResourceInfo> resources
+          ABSL_GUARDED_BY(lock);
+    };
+
+    MemoryShard& GetShard(VkDeviceMemory memory);
+    ResourceShard& GetShard(const ResourceKey& key);
+
+    std::array<MemoryShard, kNumShards> memory_shards;
+    std::array<ResourceShard, kNumShards> resource_shards;
+  };
+
+  // Returns the table of |device|, or nullptr if the device is unknown.
+  DeviceResources* GetDevice(VkDevice device) const;
+
+  void CreateResource(VkDevice device, const ResourceKey& key,
+                      const ResourceInfo& info);
+  void DestroyResource(VkDevice device, const ResourceKey& key);
+  void BindResource(VkDevice device, const ResourceKey& key,
+                    VkDeviceMemory memory, VkDeviceSize offset);
+  // Removes |key| from the resources bound to |memory|.
+  static void UnbindResource(DeviceResources* resources, const ResourceKey& key,
+                             VkDeviceMemory memory);
+
+  mutable absl::Mutex devices_lock_;
+  absl::flat_hash_map<VkDevice, std::unique_ptr<DeviceResources>> devices_
+      ABSL_GUARDED_BY(devices_lock_);
+};
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_MEMORY_RESOURCE_TRACKER_H_
@@ -12,16 +12,16 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <vector>
 
-#include "layer/support/csv_logging.h"
 #include "layer/support/debug_logging.h"
 #include "layer/support/event_logging.h"
+#include "layer/support/layer_config.h"
 #include "layer/support/layer_data.h"
 #include "layer/support/layer_utils.h"
+#include "memory_usage_layer_data.h"
 
 namespace performancelayers {
 namespace {
@@ -29,101 +29,25 @@ namespace {
 // Layer book-keeping information
 // ----------------------------------------------------------------------------
 
-constexpr char kLogFilenameEnvVar[] = "VK_MEMORY_USAGE_LOG";
-
-// An event that holds memory allocation information (current and peak
-// allocated) and can be logged both in the private and common files.
-class MemoryUsageEvent : public Event {
- public:
-  MemoryUsageEvent(const char* name, int64_t current, int64_t peak)
-      : Event(name, LogLevel::kHigh),
-        current_({"current", current}),
-        peak_({"peak", peak}),
-        trace_attr_("trace_attr", "memory_usage", "i",
-                    {&scope_, &current_, &peak_}) {
-    InitAttributes({&current_, &peak_, &trace_attr_});
-  }
-
- private:
-  Int64Attr current_;
-  Int64Attr peak_;
-  // `Perfetto` displays the args only for instant events with thread-level
-  // scope.
-  StringAttr scope_{"scope", "t"};
-  TraceEventAttr trace_attr_;
-};
-
-class MemoryUsageLayerData : public LayerData {
- public:
-  explicit MemoryUsageLayerData(char* log_filename)
-      : LayerData(log_filename, "Current (bytes), peak (bytes)") {
-    LayerInitEvent event("memory_usage_layer_init", "memory_usage");
-    LogEvent(&event);
-  }
-
-  void RecordAllocateMemory(VkDevice device, VkDeviceMemory memory,
-                            VkDeviceSize size) {
-    absl::MutexLock lock(&memory_hash_lock_);
-    bool inserted;
-    std::tie(std::ignore, inserted) =
-        memory_hash_map_.try_emplace({device, memory}, size);
-    assert(inserted);
-    current_allocation_size_ += size;
-    peak_allocation_size_ =
-        std::max(peak_allocation_size_, current_allocation_size_);
-  }
-
-  void RecordFreeMemory(VkDevice device, VkDeviceMemory memory) {
-    absl::MutexLock lock(&memory_hash_lock_);
-    auto it = memory_hash_map_.find({device, memory});
-    assert(it != memory_hash_map_.end());
-    VkDeviceSize size = it->second;
-    memory_hash_map_.erase(it);
-
-    assert(size <= current_allocation_size_);
-    current_allocation_size_ -= size;
-  }
-
-  void RecordDestroyDeviceMemory(VkDevice device) {
-    absl::MutexLock lock(&memory_hash_lock_);
-    VkDeviceSize size = 0;
-    for (auto it = memory_hash_map_.begin(); it != memory_hash_map_.end();
-         ++it) {
-      if (it->first.first == device) {
-        size += it->second;
-        // Note that absl::flat_hash_map does not invalidate iterators on erase.
-        memory_hash_map_.erase(it);
-      }
-    }
-    assert(size <= current_allocation_size_);
-    current_allocation_size_ -= size;
-  }
-
-  uint64_t GetPeakAllocationSize() const {
-    absl::MutexLock ReaderLock(&memory_hash_lock_);
-    return peak_allocation_size_;
-  }
-
-  uint64_t GetCurrentAllocationSize() const {
-    absl::MutexLock ReaderLock(&memory_hash_lock_);
-    return current_allocation_size_;
-  }
-
- private:
-  mutable absl::Mutex memory_hash_lock_;
-  // The map from device, memory tuple to its allocation size. TODO: Should be a
-  // two-level map, so that per-device data can be purged easily on
-  // DestroyDevice.
-  absl::flat_hash_map<std::pair<VkDevice, VkDeviceMemory>, VkDeviceSize>
-      memory_hash_map_ ABSL_GUARDED_BY(memory_hash_lock_);
-
-  VkDeviceSize current_allocation_size_ ABSL_GUARDED_BY(memory_hash_lock_) = 0;
-  VkDeviceSize peak_allocation_size_ ABSL_GUARDED_BY(memory_hash_lock_) = 0;
-};
-
 MemoryUsageLayerData* GetLayerData() {
+  auto GetOptions = [](const LayerConfig::MemoryUsage& config) {
+    MemoryUsageLayerData::Options options;
+    options.report_frame_interval = config.report_frames;
+    options.churn_window_frames = config.churn_window_frames;
+    options.short_lived_frames = config.short_lived_frames;
+    options.slow_call_threshold = Duration::FromNanoseconds(
+        static_cast<int64_t>(config.slow_call_us) * 1000);
+    options.host_report_frames = config.host_report_frames;
+    options.snapshot_frames = config.snapshot_frames;
+    options.call_site_sample_bytes = config.call_site_sample_bytes;
+    options.call_site_log = NullIfEmpty(config.call_site_log);
+    return options;
+  };
+
+  const LayerConfig::MemoryUsage& config = GetLayerConfig().memory_usage;
   // Don't use new -- make the destructor run when the layer gets unloaded.
-  static MemoryUsageLayerData layer_data(getenv(kLogFilenameEnvVar));
+  static MemoryUsageLayerData layer_data(NullIfEmpty(config.log),
+                                         GetOptions(config));
   return &layer_data;
 }
 
@@ -132,6 +56,42 @@ MemoryUsageLayerData* GetLayerData() {
   SPL_INTERCEPTED_VULKAN_FUNC(RETURN_TYPE_, MemoryUsageLayer_, FUNC_NAME_, \
                               FUNC_ARGS_)
 
+// The functions intercepted by the layer, defined below with
+// SPL_MEMORY_USAGE_LAYER_FUNC.
+#define SPL_MEMORY_USAGE_LAYER_FUNCS(X_, LAYER_PREFIX_) \
+  X_(LAYER_PREFIX_, CreateDevice)                       \
+  X_(LAYER_PREFIX_, DestroyInstance)                    \
+  X_(LAYER_PREFIX_, CreateInstance)                     \
+  X_(LAYER_PREFIX_, DestroyDevice)                      \
+  X_(LAYER_PREFIX_, QueuePresentKHR)                    \
+  X_(LAYER_PREFIX_, AllocateMemory)                     \
+  X_(LAYER_PREFIX_, FreeMemory)                         \
+  X_(LAYER_PREFIX_, CreateBuffer)                       \
+  X_(LAYER_PREFIX_, DestroyBuffer)                      \
+  X_(LAYER_PREFIX_, CreateImage)                        \
+  X_(LAYER_PREFIX_, DestroyImage)                       \
+  X_(LAYER_PREFIX_, BindBufferMemory)                   \
+  X_(LAYER_PREFIX_, BindBufferMemory2)                  \
+  X_(LAYER_PREFIX_, BindBufferMemory2KHR)               \
+  X_(LAYER_PREFIX_, BindImageMemory)                    \
+  X_(LAYER_PREFIX_, BindImageMemory2)                   \
+  X_(LAYER_PREFIX_, BindImageMemory2KHR)                \
+  X_(LAYER_PREFIX_, CreateShaderModule)                 \
+  X_(LAYER_PREFIX_, DestroyShaderModule)                \
+  X_(LAYER_PREFIX_, CreatePipelineCache)                \
+  X_(LAYER_PREFIX_, DestroyPipelineCache)               \
+  X_(LAYER_PREFIX_, CreateGraphicsPipelines)            \
+  X_(LAYER_PREFIX_, CreateComputePipelines)             \
+  X_(LAYER_PREFIX_, DestroyPipeline)                    \
+  X_(LAYER_PREFIX_, CreateDescriptorPool)               \
+  X_(LAYER_PREFIX_, DestroyDescriptorPool)              \
+  X_(LAYER_PREFIX_, AllocateDescriptorSets)             \
+  X_(LAYER_PREFIX_, GetDeviceProcAddr)                  \
+  X_(LAYER_PREFIX_, GetInstanceProcAddr)
+
+SPL_DECLARE_INTERCEPTED_FUNCTIONS(MemoryUsageLayer_,
+                                  SPL_MEMORY_USAGE_LAYER_FUNCS);
+
 //////////////////////////////////////////////////////////////////////////////
 //  Implementation of the instance functions we want to override.
 //////////////////////////////////////////////////////////////////////////////
@@ -152,10 +112,39 @@ SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, CreateDevice,
     SPL_DISPATCH_DEVICE_FUNC(AllocateMemory);
     SPL_DISPATCH_DEVICE_FUNC(FreeMemory);
     SPL_DISPATCH_DEVICE_FUNC(QueuePresentKHR);
+    SPL_DISPATCH_DEVICE_FUNC(CreateBuffer);
+    SPL_DISPATCH_DEVICE_FUNC(DestroyBuffer);
+    SPL_DISPATCH_DEVICE_FUNC(CreateImage);
+    SPL_DISPATCH_DEVICE_FUNC(DestroyImage);
+    SPL_DISPATCH_DEVICE_FUNC(BindBufferMemory);
+    SPL_DISPATCH_DEVICE_FUNC(BindBufferMemory2);
+    SPL_DISPATCH_DEVICE_FUNC(BindBufferMemory2KHR);
+    SPL_DISPATCH_DEVICE_FUNC(BindImageMemory);
+    SPL_DISPATCH_DEVICE_FUNC(BindImageMemory2);
+    SPL_DISPATCH_DEVICE_FUNC(BindImageMemory2KHR);
+    SPL_DISPATCH_DEVICE_FUNC(GetBufferMemoryRequirements);
+    SPL_DISPATCH_DEVICE_FUNC(GetImageMemoryRequirements);
+    SPL_DISPATCH_DEVICE_FUNC(CreateShaderModule);
+    SPL_DISPATCH_DEVICE_FUNC(DestroyShaderModule);
+    SPL_DISPATCH_DEVICE_FUNC(CreatePipelineCache);
+    SPL_DISPATCH_DEVICE_FUNC(DestroyPipelineCache);
+    SPL_DISPATCH_DEVICE_FUNC(CreateGraphicsPipelines);
+    SPL_DISPATCH_DEVICE_FUNC(CreateComputePipelines);
+    SPL_DISPATCH_DEVICE_FUNC(DestroyPipeline);
+    SPL_DISPATCH_DEVICE_FUNC(CreateDescriptorPool);
+    SPL_DISPATCH_DEVICE_FUNC(DestroyDescriptorPool);
+    SPL_DISPATCH_DEVICE_FUNC(AllocateDescriptorSets);
     return dispatch_table;
   };
-  return GetLayerData()->CreateDevice(physical_device, create_info, allocator,
-                                      device, build_dispatch_table);
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  HostAllocationTracker::ScopedSource source(
+      HostAllocationSource::kCreateDevice);
+  VkResult result = layer_data->CreateDevice(
+      physical_device, create_info, layer_data->GetHostAllocator(allocator),
+      device, build_dispatch_table);
+  if (result == VK_SUCCESS)
+    layer_data->RecordCreateDevice(physical_device, *device);
+  return result;
 }
 
 // Override for vkDestroyInstance.  Deletes the entry for |instance| from the
@@ -163,11 +152,14 @@ SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, CreateDevice,
 SPL_MEMORY_USAGE_LAYER_FUNC(void, DestroyInstance,
                             (VkInstance instance,
                              const VkAllocationCallbacks* allocator)) {
-  LayerData* layer_data = GetLayerData();
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  // Devices that are still alive leaked all of their memory.
+  layer_data->LogLeakReports(instance);
+  layer_data->LogHostMemoryUsage();
   auto next_proc = layer_data->GetNextInstanceProcAddr(
       instance, &VkLayerInstanceDispatchTable::DestroyInstance);
   layer_data->RemoveInstance(instance);
-  next_proc(instance, allocator);
+  next_proc(instance, layer_data->GetHostAllocator(allocator));
 }
 
 // Override for vkCreateInstance.  Creates the dispatch table for this instance
@@ -185,11 +177,16 @@ SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, CreateInstance,
         // override.
         SPL_DISPATCH_INSTANCE_FUNC(DestroyInstance);
         SPL_DISPATCH_INSTANCE_FUNC(GetInstanceProcAddr);
+        SPL_DISPATCH_INSTANCE_FUNC(GetPhysicalDeviceMemoryProperties);
         return dispatch_table;
       };
 
-  return GetLayerData()->CreateInstance(create_info, allocator, instance,
-                                        build_dispatch_table);
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  HostAllocationTracker::ScopedSource source(
+      HostAllocationSource::kCreateInstance);
+  return layer_data->CreateInstance(create_info,
+                                    layer_data->GetHostAllocator(allocator),
+                                    instance, build_dispatch_table);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -202,6 +199,10 @@ SPL_MEMORY_USAGE_LAYER_FUNC(void, DestroyDevice,
                             (VkDevice device,
                              const VkAllocationCallbacks* allocator)) {
   MemoryUsageLayerData* layer_data = GetLayerData();
+  // Report what was still bound and allocated before the records of the device
+  // are dropped.
+  layer_data->LogResourceAttributionReport();
+  layer_data->LogLeakReport(device);
   // Remove memory allocation records for the device being destroyed.
   layer_data->RecordDestroyDeviceMemory(device);
 
@@ -213,7 +214,7 @@ SPL_MEMORY_USAGE_LAYER_FUNC(void, DestroyDevice,
   auto next_proc = layer_data->GetNextDeviceProcAddr(
       device, &VkLayerDispatchTable::DestroyDevice);
   layer_data->RemoveDevice(device);
-  next_proc(device, allocator);
+  next_proc(device, layer_data->GetHostAllocator(allocator));
 }
 
 // Override for vkQueuePresentKHR. Used to log memory usage once per frame.
@@ -221,16 +222,14 @@ SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, QueuePresentKHR,
                             (VkQueue queue,
                              const VkPresentInfoKHR* present_info)) {
   MemoryUsageLayerData* layer_data = GetLayerData();
-  MemoryUsageEvent event("memory_usage_present",
-                         layer_data->GetCurrentAllocationSize(),
-                         layer_data->GetPeakAllocationSize());
-  layer_data->LogEvent(&event);
+  layer_data->RecordPresent();
   auto next_proc = layer_data->GetNextDeviceProcAddr(
       queue, &VkLayerDispatchTable::QueuePresentKHR);
   return next_proc(queue, present_info);
 }
 
-// Override for vkAllocateMemory.  Records the allocation size.
+// Override for vkAllocateMemory.  Records the allocation size and the time
+// spent in the driver.
 SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, AllocateMemory,
                             (VkDevice device,
                              const VkMemoryAllocateInfo* pAllocateInfo,
@@ -240,17 +239,23 @@ SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, AllocateMemory,
   auto next_proc = layer_data->GetNextDeviceProcAddr(
       device, &VkLayerDispatchTable::AllocateMemory);
 
-  auto result = next_proc(device, pAllocateInfo, pAllocator, pMemory);
-
-  if (result == VK_SUCCESS) {
-    // TODO: Also records failed allocations in some way?
-    layer_data->RecordAllocateMemory(device, *pMemory,
-                                     pAllocateInfo->allocationSize);
-  }
+  HostAllocationTracker::ScopedSource source(
+      HostAllocationSource::kAllocateMemory);
+  DurationClock::time_point start = Now();
+  auto result = next_proc(device, pAllocateInfo,
+                          layer_data->GetHostAllocator(pAllocator), pMemory);
+  Duration duration = Now() - start;
+
+  // The contents of |pMemory| are undefined if the allocation failed.
+  const VkDeviceMemory memory =
+      result == VK_SUCCESS ? *pMemory : VK_NULL_HANDLE;
+  layer_data->RecordAllocateMemory(device, memory, pAllocateInfo, result,
+                                   duration);
   return result;
 }
 
-// Override for vkFreeMemory. Deletes the records.
+// Override for vkFreeMemory. Deletes the records and records the time spent in
+// the driver.
 SPL_MEMORY_USAGE_LAYER_FUNC(void, FreeMemory,
                             (VkDevice device, VkDeviceMemory memory,
                              const VkAllocationCallbacks* pAllocator)) {
@@ -258,13 +263,322 @@ SPL_MEMORY_USAGE_LAYER_FUNC(void, FreeMemory,
   auto next_proc = layer_data->GetNextDeviceProcAddr(
       device, &VkLayerDispatchTable::FreeMemory);
 
-  layer_data->RecordFreeMemory(device, memory);
+  AllocationRecord record = layer_data->RecordFreeMemory(device, memory);
+
+  DurationClock::time_point start = Now();
+  next_proc(device, memory, layer_data->GetHostAllocator(pAllocator));
+  Duration duration = Now() - start;
+
+  if (memory != VK_NULL_HANDLE)
+    layer_data->RecordFreeMemoryCall(record, duration);
+}
+
+// Override for vkCreateBuffer.  Records the buffer parameters and memory
+// requirements.
+SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, CreateBuffer,
+                            (VkDevice device,
+                             const VkBufferCreateInfo* create_info,
+                             const VkAllocationCallbacks* allocator,
+                             VkBuffer* buffer)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreateBuffer);
+  HostAllocationTracker::ScopedSource source(
+      HostAllocationSource::kCreateBuffer);
+  VkResult result = next_proc(device, create_info,
+                              layer_data->GetHostAllocator(allocator), buffer);
+  if (result == VK_SUCCESS)
+    layer_data->RecordCreateBuffer(device, *buffer, create_info);
+  return result;
+}
+
+// Override for vkDestroyBuffer.  Releases the memory range bound to the buffer.
+SPL_MEMORY_USAGE_LAYER_FUNC(void, DestroyBuffer,
+                            (VkDevice device, VkBuffer buffer,
+                             const VkAllocationCallbacks* allocator)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyBuffer);
+  layer_data->RecordDestroyBuffer(device, buffer);
+  next_proc(device, buffer, layer_data->GetHostAllocator(allocator));
+}
+
+// Override for vkCreateImage.  Records the image parameters and memory
+// requirements.
+SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, CreateImage,
+                            (VkDevice device,
+                             const VkImageCreateInfo* create_info,
+                             const VkAllocationCallbacks* allocator,
+                             VkImage* image)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreateImage);
+  HostAllocationTracker::ScopedSource source(
+      HostAllocationSource::kCreateImage);
+  VkResult result = next_proc(device, create_info,
+                              layer_data->GetHostAllocator(allocator), image);
+  if (result == VK_SUCCESS)
+    layer_data->RecordCreateImage(device, *image, create_info);
+  return result;
+}
+
+// Override for vkDestroyImage.  Releases the memory range bound to the image.
+SPL_MEMORY_USAGE_LAYER_FUNC(void, DestroyImage,
+                            (VkDevice device, VkImage image,
+                             const VkAllocationCallbacks* allocator)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyImage);
+  layer_data->RecordDestroyImage(device, image);
+  next_proc(device, image, layer_data->GetHostAllocator(allocator));
+}
+
+// Override for vkBindBufferMemory.  Records the memory range of the buffer.
+SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, BindBufferMemory,
+                            (VkDevice device, VkBuffer buffer,
+                             VkDeviceMemory memory, VkDeviceSize offset)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::BindBufferMemory);
+  VkResult result = next_proc(device, buffer, memory, offset);
+  if (result == VK_SUCCESS)
+    layer_data->RecordBindBufferMemory(device, buffer, memory, offset);
+  return result;
+}
+
+// Records the memory ranges of the buffers in |bind_infos|.
+void RecordBindBufferMemoryInfos(MemoryUsageLayerData* layer_data,
+                                 VkDevice device, uint32_t bind_info_count,
+                                 const VkBindBufferMemoryInfo* bind_infos) {
+  for (uint32_t i = 0; i != bind_info_count; ++i) {
+    layer_data->RecordBindBufferMemory(device, bind_infos[i].buffer,
+                                       bind_infos[i].memory,
+                                       bind_infos[i].memoryOffset);
+  }
+}
 
-  next_proc(device, memory, pAllocator);
+// Override for vkBindBufferMemory2.  Records the memory ranges of the buffers.
+SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, BindBufferMemory2,
+                            (VkDevice device, uint32_t bind_info_count,
+                             const VkBindBufferMemoryInfo* bind_infos)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::BindBufferMemory2);
+  VkResult result = next_proc(device, bind_info_count, bind_infos);
+  if (result == VK_SUCCESS)
+    RecordBindBufferMemoryInfos(layer_data, device, bind_info_count,
+                                bind_infos);
+  return result;
+}
+
+// Override for vkBindBufferMemory2KHR.  Same as vkBindBufferMemory2.
+SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, BindBufferMemory2KHR,
+                            (VkDevice device, uint32_t bind_info_count,
+                             const VkBindBufferMemoryInfo* bind_infos)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::BindBufferMemory2KHR);
+  VkResult result = next_proc(device, bind_info_count, bind_infos);
+  if (result == VK_SUCCESS)
+    RecordBindBufferMemoryInfos(layer_data, device, bind_info_count,
+                                bind_infos);
+  return result;
+}
+
+// Override for vkBindImageMemory.  Records the memory range of the image.
+SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, BindImageMemory,
+                            (VkDevice device, VkImage image,
+                             VkDeviceMemory memory, VkDeviceSize offset)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::BindImageMemory);
+  VkResult result = next_proc(device, image, memory, offset);
+  if (result == VK_SUCCESS)
+    layer_data->RecordBindImageMemory(device, image, memory, offset);
+  return result;
+}
+
+// Records the memory ranges of the images in |bind_infos|. Swapchain images
+// are bound with a VK_NULL_HANDLE memory and are not tracked by the layer.
+void RecordBindImageMemoryInfos(MemoryUsageLayerData* layer_data,
+                                VkDevice device, uint32_t bind_info_count,
+                                const VkBindImageMemoryInfo* bind_infos) {
+  for (uint32_t i = 0; i != bind_info_count; ++i) {
+    if (bind_infos[i].memory == VK_NULL_HANDLE) continue;
+    layer_data->RecordBindImageMemory(device, bind_infos[i].image,
+                                      bind_infos[i].memory,
+                                      bind_infos[i].memoryOffset);
+  }
+}
+
+// Override for vkBindImageMemory2.  Records the memory ranges of the images.
+SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, BindImageMemory2,
+                            (VkDevice device, uint32_t bind_info_count,
+                             const VkBindImageMemoryInfo* bind_infos)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::BindImageMemory2);
+  VkResult result = next_proc(device, bind_info_count, bind_infos);
+  if (result == VK_SUCCESS)
+    RecordBindImageMemoryInfos(layer_data, device, bind_info_count,
+                               bind_infos);
+  return result;
+}
+
+// Override for vkBindImageMemory2KHR.  Same as vkBindImageMemory2.
+SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, BindImageMemory2KHR,
+                            (VkDevice device, uint32_t bind_info_count,
+                             const VkBindImageMemoryInfo* bind_infos)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::BindImageMemory2KHR);
+  VkResult result = next_proc(device, bind_info_count, bind_infos);
+  if (result == VK_SUCCESS)
+    RecordBindImageMemoryInfos(layer_data, device, bind_info_count,
+                               bind_infos);
+  return result;
+}
+
+// The functions below are only intercepted to attribute the host memory the
+// driver allocates for the objects, and to pass the host allocation callbacks
+// of the layer down the chain both on creation and destruction.
+
+// Override for vkCreateShaderModule.
+SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, CreateShaderModule,
+                            (VkDevice device,
+                             const VkShaderModuleCreateInfo* create_info,
+                             const VkAllocationCallbacks* allocator,
+                             VkShaderModule* shader_module)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreateShaderModule);
+  HostAllocationTracker::ScopedSource source(
+      HostAllocationSource::kCreateShaderModule);
+  return next_proc(device, create_info, layer_data->GetHostAllocator(allocator),
+                   shader_module);
+}
+
+// Override for vkDestroyShaderModule.
+SPL_MEMORY_USAGE_LAYER_FUNC(void, DestroyShaderModule,
+                            (VkDevice device, VkShaderModule shader_module,
+                             const VkAllocationCallbacks* allocator)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyShaderModule);
+  next_proc(device, shader_module, layer_data->GetHostAllocator(allocator));
+}
+
+// Override for vkCreatePipelineCache.
+SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, CreatePipelineCache,
+                            (VkDevice device,
+                             const VkPipelineCacheCreateInfo* create_info,
+                             const VkAllocationCallbacks* allocator,
+                             VkPipelineCache* pipeline_cache)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreatePipelineCache);
+  HostAllocationTracker::ScopedSource source(
+      HostAllocationSource::kCreatePipelineCache);
+  return next_proc(device, create_info, layer_data->GetHostAllocator(allocator),
+                   pipeline_cache);
+}
+
+// Override for vkDestroyPipelineCache.
+SPL_MEMORY_USAGE_LAYER_FUNC(void, DestroyPipelineCache,
+                            (VkDevice device, VkPipelineCache pipeline_cache,
+                             const VkAllocationCallbacks* allocator)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyPipelineCache);
+  next_proc(device, pipeline_cache, layer_data->GetHostAllocator(allocator));
+}
+
+// Override for vkCreateGraphicsPipelines.
+SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, CreateGraphicsPipelines,
+                            (VkDevice device, VkPipelineCache pipeline_cache,
+                             uint32_t create_info_count,
+                             const VkGraphicsPipelineCreateInfo* create_infos,
+                             const VkAllocationCallbacks* allocator,
+                             VkPipeline* pipelines)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreateGraphicsPipelines);
+  HostAllocationTracker::ScopedSource source(
+      HostAllocationSource::kCreatePipelines);
+  return next_proc(device, pipeline_cache, create_info_count, create_infos,
+                   layer_data->GetHostAllocator(allocator), pipelines);
+}
+
+// Override for vkCreateComputePipelines.
+SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, CreateComputePipelines,
+                            (VkDevice device, VkPipelineCache pipeline_cache,
+                             uint32_t create_info_count,
+                             const VkComputePipelineCreateInfo* create_infos,
+                             const VkAllocationCallbacks* allocator,
+                             VkPipeline* pipelines)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreateComputePipelines);
+  HostAllocationTracker::ScopedSource source(
+      HostAllocationSource::kCreatePipelines);
+  return next_proc(device, pipeline_cache, create_info_count, create_infos,
+                   layer_data->GetHostAllocator(allocator), pipelines);
+}
+
+// Override for vkDestroyPipeline.
+SPL_MEMORY_USAGE_LAYER_FUNC(void, DestroyPipeline,
+                            (VkDevice device, VkPipeline pipeline,
+                             const VkAllocationCallbacks* allocator)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyPipeline);
+  next_proc(device, pipeline, layer_data->GetHostAllocator(allocator));
+}
+
+// Override for vkCreateDescriptorPool.
+SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, CreateDescriptorPool,
+                            (VkDevice device,
+                             const VkDescriptorPoolCreateInfo* create_info,
+                             const VkAllocationCallbacks* allocator,
+                             VkDescriptorPool* descriptor_pool)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreateDescriptorPool);
+  HostAllocationTracker::ScopedSource source(
+      HostAllocationSource::kCreateDescriptorPool);
+  return next_proc(device, create_info, layer_data->GetHostAllocator(allocator),
+                   descriptor_pool);
+}
+
+// Override for vkDestroyDescriptorPool.
+SPL_MEMORY_USAGE_LAYER_FUNC(void, DestroyDescriptorPool,
+                            (VkDevice device, VkDescriptorPool descriptor_pool,
+                             const VkAllocationCallbacks* allocator)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyDescriptorPool);
+  next_proc(device, descriptor_pool, layer_data->GetHostAllocator(allocator));
+}
+
+// Override for vkAllocateDescriptorSets. Descriptor sets take no allocation
+// callbacks, but drivers may still allocate host memory for them.
+SPL_MEMORY_USAGE_LAYER_FUNC(VkResult, AllocateDescriptorSets,
+                            (VkDevice device,
+                             const VkDescriptorSetAllocateInfo* allocate_info,
+                             VkDescriptorSet* descriptor_sets)) {
+  MemoryUsageLayerData* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::AllocateDescriptorSets);
+  HostAllocationTracker::ScopedSource source(
+      HostAllocationSource::kAllocateDescriptorSets);
+  return next_proc(device, allocate_info, descriptor_sets);
 }
 
 }  // namespace
 
+SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE(MemoryUsageLayer_,
+                                      SPL_MEMORY_USAGE_LAYER_FUNCS);
+
 // The *GetProcAddr functions are the entry points to the layers.
 // They return a function pointer for the instance requested by |name|.  We
 // return the functions defined in this layer for those we want to override.
@@ -275,24 +589,32 @@ SPL_LAYER_ENTRY_POINT SPL_MEMORY_USAGE_LAYER_FUNC(PFN_vkVoidFunction,
                                                   GetDeviceProcAddr,
                                                   (VkDevice device,
                                                    const char* name)) {
-  if (auto func = FunctionInterceptor::GetInterceptedOrNull(name)) {
-    return func;
-  }
-
   MemoryUsageLayerData* layer_data = GetLayerData();
 
   PFN_vkGetDeviceProcAddr next_get_proc_addr =
       layer_data->GetNextDeviceProcAddr(
           device, &VkLayerDispatchTable::GetDeviceProcAddr);
   assert(next_get_proc_addr && next_get_proc_addr != VK_NULL_HANDLE);
-  return next_get_proc_addr(device, name);
+  // The functions of the features and extensions that the device didn't
+  // enable are null down the chain, and must stay null.
+  PFN_vkVoidFunction next_func = next_get_proc_addr(device, name);
+  if (!next_func) return nullptr;
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(MemoryUsageLayer_, name)) {
+    return func;
+  }
+  return next_func;
 }
 
 SPL_LAYER_ENTRY_POINT SPL_MEMORY_USAGE_LAYER_FUNC(PFN_vkVoidFunction,
                                                   GetInstanceProcAddr,
                                                   (VkInstance instance,
                                                    const char* name)) {
-  if (auto func = FunctionInterceptor::GetInterceptedOrNull(name)) {
+  // The loader looks up the layer's functions here first, before calling any
+  // of them.
+  if (IsLayerOverheadProfilingEnabled()) {
+    GetLayerData()->SetOverheadProfiler(&MemoryUsageLayer_kOverheadProfiler);
+  }
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(MemoryUsageLayer_, name)) {
     return func;
   }
 
@@ -0,0 +1,404 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "memory_usage_layer_data.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "layer/support/log_output.h"
+
+namespace performancelayers {
+
+void DeviceMemoryTable::Insert(VkDeviceMemory memory,
+                               const AllocationRecord& record) {
+  Shard& shard = GetShard(memory);
+  {
+    absl::MutexLock lock(&shard.lock);
+    bool inserted;
+    std::tie(std::ignore, inserted) =
+        shard.allocations.try_emplace(memory, record);
+    assert(inserted);
+    (void)inserted;
+  }
+  current_size_.fetch_add(record.size, std::memory_order_relaxed);
+  allocation_count_.fetch_add(1, std::memory_order_relaxed);
+  const uint32_t heap = GetHeapIndex(record.memory_type_index);
+  heap_bytes_[heap].fetch_add(record.size, std::memory_order_relaxed);
+  heap_allocation_counts_[heap].fetch_add(1, std::memory_order_relaxed);
+}
+
+AllocationRecord DeviceMemoryTable::Erase(VkDeviceMemory memory) {
+  Shard& shard = GetShard(memory);
+  AllocationRecord record;
+  {
+    absl::MutexLock lock(&shard.lock);
+    auto it = shard.allocations.find(memory);
+    assert(it != shard.allocations.end());
+    if (it == shard.allocations.end()) return record;
+    record = it->second;
+    shard.allocations.erase(it);
+  }
+  current_size_.fetch_sub(record.size, std::memory_order_relaxed);
+  allocation_count_.fetch_sub(1, std::memory_order_relaxed);
+  const uint32_t heap = GetHeapIndex(record.memory_type_index);
+  heap_bytes_[heap].fetch_sub(record.size, std::memory_order_relaxed);
+  heap_allocation_counts_[heap].fetch_sub(1, std::memory_order_relaxed);
+  return record;
+}
+
+uint32_t DeviceMemoryTable::GetHeapIndex(uint32_t memory_type_index) const {
+  if (memory_type_index >= memory_properties_.memoryTypeCount) return 0;
+  const uint32_t heap =
+      memory_properties_.memoryTypes[memory_type_index].heapIndex;
+  return heap < VK_MAX_MEMORY_HEAPS ? heap : 0;
+}
+
+DeviceMemorySnapshot DeviceMemoryTable::GetSnapshot(VkDevice device) const {
+  DeviceMemorySnapshot snapshot;
+  snapshot.device = device;
+  snapshot.current_size = GetCurrentSize();
+  snapshot.allocation_count = GetAllocationCount();
+  const uint32_t heap_count =
+      std::min<uint32_t>(memory_properties_.memoryHeapCount,
+                         VK_MAX_MEMORY_HEAPS);
+  for (uint32_t heap = 0; heap != heap_count; ++heap) {
+    snapshot.heap_sizes.push_back(
+        static_cast<int64_t>(memory_properties_.memoryHeaps[heap].size));
+    snapshot.heap_bytes.push_back(static_cast<int64_t>(
+        heap_bytes_[heap].load(std::memory_order_relaxed)));
+    snapshot.heap_allocation_counts.push_back(static_cast<int64_t>(
+        heap_allocation_counts_[heap].load(std::memory_order_relaxed)));
+  }
+  return snapshot;
+}
+
+std::vector<LiveAllocation> DeviceMemoryTable::GetLiveAllocations() const {
+  std::vector<LiveAllocation> allocations;
+  for (const Shard& shard : shards_) {
+    absl::MutexLock lock(&shard.lock);
+    for (const auto& [memory, record] : shard.allocations) {
+      allocations.push_back(
+          {memory, GetHeapIndex(record.memory_type_index), record});
+    }
+  }
+  std::sort(allocations.begin(), allocations.end(),
+            [](const LiveAllocation& lhs, const LiveAllocation& rhs) {
+              return lhs.record.time < rhs.record.time;
+            });
+  return allocations;
+}
+
+void MemoryAllocationTracker::AddDevice(
+    VkDevice device,
+    const VkPhysicalDeviceMemoryProperties& memory_properties) {
+  absl::MutexLock lock(&device_tables_lock_);
+  bool inserted;
+  std::tie(std::ignore, inserted) = device_tables_.try_emplace(
+      device, std::make_unique<DeviceMemoryTable>(memory_properties));
+  assert(inserted);
+  (void)inserted;
+}
+
+void MemoryAllocationTracker::RemoveDevice(VkDevice device) {
+  std::unique_ptr<DeviceMemoryTable> table;
+  {
+    absl::MutexLock lock(&device_tables_lock_);
+    auto it = device_tables_.find(device);
+    if (it == device_tables_.end()) return;
+    table = std::move(it->second);
+    device_tables_.erase(it);
+  }
+
+  // The per-device counter already holds the sum of the remaining
+  // allocations; the table itself is freed without being walked entry by
+  // entry.
+  SubtractAllocationSize(table->GetCurrentSize());
+}
+
+void MemoryAllocationTracker::RecordAllocateMemory(
+    VkDevice device, VkDeviceMemory memory, const AllocationRecord& record) {
+  DeviceMemoryTable* table = GetDeviceTable(device);
+  assert(table && "Device not registered");
+  if (!table) return;
+  table->Insert(memory, record);
+  AddAllocationSize(record.size);
+}
+
+AllocationRecord MemoryAllocationTracker::RecordFreeMemory(
+    VkDevice device, VkDeviceMemory memory) {
+  DeviceMemoryTable* table = GetDeviceTable(device);
+  assert(table && "Device not registered");
+  if (!table) return {};
+  AllocationRecord record = table->Erase(memory);
+  SubtractAllocationSize(record.size);
+  return record;
+}
+
+std::vector<DeviceMemorySnapshot> MemoryAllocationTracker::GetSnapshots()
+    const {
+  std::vector<DeviceMemorySnapshot> snapshots;
+  absl::ReaderMutexLock lock(&device_tables_lock_);
+  snapshots.reserve(device_tables_.size());
+  for (const auto& [device, table] : device_tables_)
+    snapshots.push_back(table->GetSnapshot(device));
+  return snapshots;
+}
+
+std::vector<LiveAllocation> MemoryAllocationTracker::GetLiveAllocations(
+    VkDevice device) const {
+  DeviceMemoryTable* table = GetDeviceTable(device);
+  if (!table) return {};
+  return table->GetLiveAllocations();
+}
+
+void MemoryAllocationTracker::AddAllocationSize(VkDeviceSize size) {
+  const VkDeviceSize current =
+      current_allocation_size_.fetch_add(size, std::memory_order_relaxed) +
+      size;
+  // Every value returned by the fetch_add above is a size the counter held at
+  // some point, so raising the peak to it keeps the peak exact.
+  VkDeviceSize peak = peak_allocation_size_.load(std::memory_order_relaxed);
+  while (current > peak && !peak_allocation_size_.compare_exchange_weak(
+                               peak, current, std::memory_order_relaxed)) {
+  }
+}
+
+void MemoryAllocationTracker::SubtractAllocationSize(VkDeviceSize size) {
+  const VkDeviceSize previous =
+      current_allocation_size_.fetch_sub(size, std::memory_order_relaxed);
+  assert(size <= previous);
+  (void)previous;
+}
+
+DeviceMemoryTable* MemoryAllocationTracker::GetDeviceTable(
+    VkDevice device) const {
+  absl::ReaderMutexLock lock(&device_tables_lock_);
+  if (auto it = device_tables_.find(device); it != device_tables_.end())
+    return it->second.get();
+  return nullptr;
+}
+
+MemoryUsageLayerData::~MemoryUsageLayerData() {
+  StopControl();
+  if (!call_sites_.IsEnabled()) return;
+  FileOutput out(options_.call_site_log);
+  call_sites_.WriteFoldedStacks(&out);
+}
+
+void MemoryUsageLayerData::LogSnapshot() {
+  LogMemorySnapshot("memory_usage_control_snapshot");
+  LogResourceAttributionReport();
+  LayerData::LogSnapshot();
+}
+
+void MemoryUsageLayerData::RecordCreateDevice(VkPhysicalDevice physical_device,
+                                              VkDevice device) {
+  VkPhysicalDeviceMemoryProperties memory_properties = {};
+  GetNextInstanceProcAddr(
+      physical_device,
+      &VkLayerInstanceDispatchTable::GetPhysicalDeviceMemoryProperties)(
+      physical_device, &memory_properties);
+  allocations_.AddDevice(device, memory_properties);
+  resources_.AddDevice(device);
+  absl::MutexLock lock(&device_instances_lock_);
+  device_instances_.insert_or_assign(device, InstanceKey(physical_device));
+}
+
+void MemoryUsageLayerData::RecordAllocateMemory(
+    VkDevice device, VkDeviceMemory memory,
+    const VkMemoryAllocateInfo* allocate_info, VkResult result,
+    Duration duration) {
+  assert(allocate_info);
+  const VkDeviceSize size = allocate_info->allocationSize;
+  churn_.RecordAllocateMemory(size, duration, result == VK_SUCCESS);
+  LogIfSlow("memory_usage_slow_allocate_memory", size, duration);
+  if (result != VK_SUCCESS) return;
+
+  AllocationRecord record;
+  record.size = size;
+  record.memory_type_index = allocate_info->memoryTypeIndex;
+  record.frame = frame_count_.load(std::memory_order_relaxed);
+  record.time = Now();
+  record.timestamp = GetTimestamp();
+  record.call_site = call_sites_.Record(size);
+  allocations_.RecordAllocateMemory(device, memory, record);
+  resources_.RecordAllocateMemory(device, memory, size);
+}
+
+AllocationRecord MemoryUsageLayerData::RecordFreeMemory(VkDevice device,
+                                                        VkDeviceMemory memory) {
+  // Freeing VK_NULL_HANDLE is valid and has no effect.
+  if (memory == VK_NULL_HANDLE) return {};
+  resources_.RecordFreeMemory(device, memory);
+  return allocations_.RecordFreeMemory(device, memory);
+}
+
+void MemoryUsageLayerData::RecordFreeMemoryCall(const AllocationRecord& record,
+                                                Duration duration) {
+  const uint64_t frame = frame_count_.load(std::memory_order_relaxed);
+  churn_.RecordFreeMemory(record.size, duration, frame - record.frame,
+                          Now() - record.time);
+  LogIfSlow("memory_usage_slow_free_memory", record.size, duration);
+}
+
+void MemoryUsageLayerData::LogIfSlow(const char* name, VkDeviceSize size,
+                                     Duration duration) {
+  const int64_t threshold_ns = options_.slow_call_threshold.ToNanoseconds();
+  if (threshold_ns == 0 || duration.ToNanoseconds() <= threshold_ns) return;
+  if (GetInstrumentationMode() == InstrumentationMode::kOff) return;
+  SlowMemoryCallEvent event(name, size, duration);
+  LogEvent(&event);
+}
+
+void MemoryUsageLayerData::RecordCreateBuffer(
+    VkDevice device, VkBuffer buffer, const VkBufferCreateInfo* create_info) {
+  assert(create_info);
+  ResourceInfo info;
+  info.kind = ResourceKind::kBuffer;
+  info.usage = create_info->usage;
+  info.requested_size = create_info->size;
+
+  VkMemoryRequirements requirements = {};
+  GetNextDeviceProcAddr(device,
+                        &VkLayerDispatchTable::GetBufferMemoryRequirements)(
+      device, buffer, &requirements);
+  info.required_size = requirements.size;
+  resources_.RecordCreateBuffer(device, buffer, info);
+}
+
+void MemoryUsageLayerData::RecordCreateImage(
+    VkDevice device, VkImage image, const VkImageCreateInfo* create_info) {
+  assert(create_info);
+  // The planes of disjoint images are bound separately, and
+  // vkGetImageMemoryRequirements must not be called for them. Such images are
+  // not attributed.
+  if (create_info->flags & VK_IMAGE_CREATE_DISJOINT_BIT) return;
+
+  ResourceInfo info;
+  info.kind = ResourceKind::kImage;
+  info.usage = create_info->usage;
+  info.format = create_info->format;
+  info.extent = create_info->extent;
+  info.mip_levels = create_info->mipLevels;
+  info.array_layers = create_info->arrayLayers;
+
+  VkMemoryRequirements requirements = {};
+  GetNextDeviceProcAddr(device,
+                        &VkLayerDispatchTable::GetImageMemoryRequirements)(
+      device, image, &requirements);
+  info.required_size = requirements.size;
+  resources_.RecordCreateImage(device, image, info);
+}
+
+void MemoryUsageLayerData::RecordPresent() {
+  const uint64_t frame =
+      frame_count_.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (GetInstrumentationMode() == InstrumentationMode::kOff) return;
+  current_allocation_metric_.Set(GetCurrentAllocationSize());
+  peak_allocation_metric_.Set(GetPeakAllocationSize());
+  if (options_.snapshot_frames != 0 && frame % options_.snapshot_frames == 0)
+    LogMemorySnapshot("memory_usage_present");
+  if (options_.report_frame_interval != 0 &&
+      frame % options_.report_frame_interval == 0) {
+    LogResourceAttributionReport();
+  }
+  if (options_.churn_window_frames != 0 &&
+      frame % options_.churn_window_frames == 0) {
+    AllocationChurnEvent event("memory_usage_allocation_churn",
+                               churn_.TakeWindow(Now()));
+    LogEvent(&event);
+  }
+  if (options_.host_report_frames != 0 &&
+      frame % options_.host_report_frames == 0) {
+    LogHostMemoryUsage();
+  }
+}
+
+void MemoryUsageLayerData::LogMemorySnapshot(const char* name) {
+  MemoryUsageEvent event(name, GetCurrentAllocationSize(),
+                         GetPeakAllocationSize());
+  LogEvent(&event);
+  for (const DeviceMemorySnapshot& snapshot : allocations_.GetSnapshots()) {
+    MemorySnapshotEvent snapshot_event("memory_usage_snapshot", snapshot);
+    LogEvent(&snapshot_event);
+  }
+}
+
+void MemoryUsageLayerData::LogLeakReport(VkDevice device) {
+  std::vector<LiveAllocation> allocations =
+      allocations_.GetLiveAllocations(device);
+  VkDeviceSize leaked_bytes = 0;
+  for (const LiveAllocation& allocation : allocations) {
+    LeakedAllocationEvent event(
+        "memory_usage_leaked_allocation", device, allocation,
+        call_sites_.GetFoldedStack(allocation.record.call_site));
+    LogEvent(&event);
+    leaked_bytes += allocation.record.size;
+  }
+  LeakReportEvent event("memory_usage_leak_report", device, allocations.size(),
+                        leaked_bytes);
+  LogEvent(&event);
+}
+
+void MemoryUsageLayerData::LogLeakReports(VkInstance instance) {
+  std::vector<VkDevice> devices;
+  {
+    absl::MutexLock lock(&device_instances_lock_);
+    for (const auto& [device, instance_key] : device_instances_) {
+      if (instance_key == InstanceKey(instance)) devices.push_back(device);
+    }
+  }
+  for (VkDevice device : devices) LogLeakReport(device);
+}
+
+void MemoryUsageLayerData::LogHostMemoryUsage() {
+  if (!host_allocations_) return;
+  HostMemoryStats stats = host_allocations_->TakeStats(Now());
+
+  HostMemoryEvent event("memory_usage_host_memory", stats);
+  LogEvent(&event);
+  for (size_t i = 0; i != kNumHostAllocationSources; ++i) {
+    if (stats.by_source[i].allocation_count == 0) continue;
+    HostMemorySourceEvent source_event("memory_usage_host_memory_source",
+                                       static_cast<HostAllocationSource>(i),
+                                       stats.by_source[i]);
+    LogEvent(&source_event);
+  }
+}
+
+void MemoryUsageLayerData::LogResourceAttributionReport() {
+  ResourceAttributionReport report = resources_.GetReport(
+      kMaxReportedAllocations, kMaxReportedResourceClasses);
+
+  ResourceAttributionEvent event("memory_usage_resource_report", report);
+  LogEvent(&event);
+  for (const AllocationUtilization& utilization :
+       report.most_wasteful_allocations) {
+    AllocationUtilizationEvent allocation_event(
+        "memory_usage_allocation_utilization", utilization);
+    LogEvent(&allocation_event);
+  }
+  for (const ResourceClassUsage& usage : report.largest_resource_classes) {
+    ResourceClassEvent class_event("memory_usage_resource_class", usage);
+    LogEvent(&class_event);
+  }
+}
+
+}  // namespace performancelayers
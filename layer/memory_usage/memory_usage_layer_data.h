@@ -0,0 +1,816 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_MEMORY_USAGE_LAYER_DATA_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_MEMORY_USAGE_LAYER_DATA_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
+#include "absl/synchronization/mutex.h"
+#include "allocation_churn_tracker.h"
+#include "host_allocation_tracker.h"
+#include "layer/support/call_site_profiler.h"
+#include "layer/support/event_logging.h"
+#include "layer/support/layer_data.h"
+#include "layer/support/layer_utils.h"
+#include "layer/support/metrics.h"
+#include "memory_resource_tracker.h"
+
+namespace performancelayers {
+// Returns |value| per second over |duration|, or 0 if |duration| is empty.
+inline int64_t PerSecond(uint64_t value, Duration duration) {
+  const int64_t duration_ns = duration.ToNanoseconds();
+  if (duration_ns <= 0) return 0;
+  return static_cast<int64_t>(static_cast<double>(value) * 1e9 /
+                              static_cast<double>(duration_ns));
+}
+
+// An event that holds memory allocation information (current and peak
+// allocated) and can be logged both in the private and common files.
+class MemoryUsageEvent : public Event {
+ public:
+  MemoryUsageEvent(const char* name, int64_t current, int64_t peak)
+      : Event(name, LogLevel::kHigh),
+        current_({"current", current}),
+        peak_({"peak", peak}),
+        trace_attr_("trace_attr", "memory_usage", "i",
+                    {&scope_, &current_, &peak_}) {
+    InitAttributes({&current_, &peak_, &trace_attr_});
+  }
+
+ private:
+  Int64Attr current_;
+  Int64Attr peak_;
+  // `Perfetto` displays the args only for instant events with thread-level
+  // scope.
+  StringAttr scope_{"scope", "t"};
+  TraceEventAttr trace_attr_;
+};
+
+// An event that summarizes how well the bound buffers and images fill the
+// device memory allocations.
+class ResourceAttributionEvent : public Event {
+ public:
+  ResourceAttributionEvent(const char* name,
+                           const ResourceAttributionReport& report)
+      : Event(name),
+        allocation_count_({"allocation_count",
+                           static_cast<int64_t>(report.allocation_count)}),
+        allocation_bytes_({"allocation_bytes",
+                           static_cast<int64_t>(report.allocation_bytes)}),
+        bound_bytes_({"bound_bytes", static_cast<int64_t>(report.bound_bytes)}),
+        wasted_bytes_(
+            {"wasted_bytes", static_cast<int64_t>(report.wasted_bytes)}),
+        fragmented_bytes_({"fragmented_bytes",
+                           static_cast<int64_t>(report.fragmented_bytes)}),
+        padding_bytes_(
+            {"padding_bytes", static_cast<int64_t>(report.padding_bytes)}),
+        unbound_resource_count_(
+            {"unbound_resource_count",
+             static_cast<int64_t>(report.unbound_resource_count)}),
+        trace_attr_("trace_attr", "memory_usage", "i",
+                    {&scope_, &allocation_count_, &allocation_bytes_,
+                     &bound_bytes_, &wasted_bytes_, &fragmented_bytes_,
+                     &padding_bytes_, &unbound_resource_count_}) {
+    InitAttributes({&allocation_count_, &allocation_bytes_, &bound_bytes_,
+                    &wasted_bytes_, &fragmented_bytes_, &padding_bytes_,
+                    &unbound_resource_count_, &trace_attr_});
+  }
+
+ private:
+  Int64Attr allocation_count_;
+  Int64Attr allocation_bytes_;
+  Int64Attr bound_bytes_;
+  Int64Attr wasted_bytes_;
+  Int64Attr fragmented_bytes_;
+  Int64Attr padding_bytes_;
+  Int64Attr unbound_resource_count_;
+  StringAttr scope_{"scope", "t"};
+  TraceEventAttr trace_attr_;
+};
+
+// An event that holds the utilization of a single device memory allocation.
+class AllocationUtilizationEvent : public Event {
+ public:
+  AllocationUtilizationEvent(const char* name,
+                             const AllocationUtilization& utilization)
+      : Event(name),
+        memory_({"memory", static_cast<int64_t>(reinterpret_cast<uintptr_t>(
+                               utilization.memory))}),
+        allocation_size_({"allocation_size",
+                          static_cast<int64_t>(utilization.allocation_size)}),
+        resource_count_({"resource_count",
+                         static_cast<int64_t>(utilization.resource_count)}),
+        bound_bytes_(
+            {"bound_bytes", static_cast<int64_t>(utilization.bound_bytes)}),
+        wasted_bytes_(
+            {"wasted_bytes", static_cast<int64_t>(utilization.wasted_bytes)}),
+        fragmented_bytes_({"fragmented_bytes",
+                           static_cast<int64_t>(utilization.fragmented_bytes)}),
+        utilization_percent_(
+            {"utilization_percent",
+             utilization.allocation_size == 0
+                 ? 0
+                 : static_cast<int64_t>(utilization.bound_bytes * 100 /
+                                        utilization.allocation_size)}),
+        trace_attr_("trace_attr", "memory_usage", "i",
+                    {&scope_, &memory_, &allocation_size_, &resource_count_,
+                     &bound_bytes_, &wasted_bytes_, &fragmented_bytes_,
+                     &utilization_percent_}) {
+    InitAttributes({&memory_, &allocation_size_, &resource_count_,
+                    &bound_bytes_, &wasted_bytes_, &fragmented_bytes_,
+                    &utilization_percent_, &trace_attr_});
+  }
+
+ private:
+  Int64Attr memory_;
+  Int64Attr allocation_size_;
+  Int64Attr resource_count_;
+  Int64Attr bound_bytes_;
+  Int64Attr wasted_bytes_;
+  Int64Attr fragmented_bytes_;
+  Int64Attr utilization_percent_;
+  StringAttr scope_{"scope", "t"};
+  TraceEventAttr trace_attr_;
+};
+
+// An event that holds the total memory occupied by one class of resources,
+// i.e., the buffers or images with the same usage flags and format.
+class ResourceClassEvent : public Event {
+ public:
+  ResourceClassEvent(const char* name, const ResourceClassUsage& usage)
+      : Event(name),
+        kind_({"kind", ResourceKindToString(usage.kind)}),
+        usage_({"usage", static_cast<int64_t>(usage.usage)}),
+        format_({"format", static_cast<int64_t>(usage.format)}),
+        resource_count_(
+            {"resource_count", static_cast<int64_t>(usage.resource_count)}),
+        bytes_({"bytes", static_cast<int64_t>(usage.bytes)}),
+        trace_attr_("trace_attr", "memory_usage", "i",
+                    {&scope_, &kind_, &usage_, &format_, &resource_count_,
+                     &bytes_}) {
+    InitAttributes({&kind_, &usage_, &format_, &resource_count_, &bytes_,
+                    &trace_attr_});
+  }
+
+ private:
+  StringAttr kind_;
+  Int64Attr usage_;
+  Int64Attr format_;
+  Int64Attr resource_count_;
+  Int64Attr bytes_;
+  StringAttr scope_{"scope", "t"};
+  TraceEventAttr trace_attr_;
+};
+
+// An event that summarizes the allocation activity of a window of frames. The
+// trace event spans the whole window.
+class AllocationChurnEvent : public Event {
+ public:
+  AllocationChurnEvent(const char* name, const AllocationChurnStats& stats)
+      : Event(name),
+        window_duration_("window", stats.window_duration),
+        allocation_count_(
+            {"allocation_count", static_cast<int64_t>(stats.allocation_count)}),
+        failed_allocation_count_(
+            {"failed_allocation_count",
+             static_cast<int64_t>(stats.failed_allocation_count)}),
+        free_count_({"free_count", static_cast<int64_t>(stats.free_count)}),
+        allocations_per_sec_(
+            {"allocations_per_sec",
+             PerSecond(stats.allocation_count, stats.window_duration)}),
+        frees_per_sec_({"frees_per_sec",
+                        PerSecond(stats.free_count, stats.window_duration)}),
+        allocated_bytes_per_sec_(
+            {"allocated_bytes_per_sec",
+             PerSecond(stats.allocated_bytes, stats.window_duration)}),
+        freed_bytes_per_sec_(
+            {"freed_bytes_per_sec",
+             PerSecond(stats.freed_bytes, stats.window_duration)}),
+        mean_allocate_ns_(
+            {"mean_allocate_ns",
+             Mean(stats.total_allocate_ns,
+                  stats.allocation_count + stats.failed_allocation_count)}),
+        max_allocate_ns_({"max_allocate_ns", stats.max_allocate_ns}),
+        mean_free_ns_(
+            {"mean_free_ns", Mean(stats.total_free_ns, stats.free_count)}),
+        max_free_ns_({"max_free_ns", stats.max_free_ns}),
+        size_classes_("size_classes",
+                      std::vector<int64_t>(stats.size_class_counts.begin(),
+                                           stats.size_class_counts.end())),
+        short_lived_count_({"short_lived_count",
+                            static_cast<int64_t>(stats.short_lived_count)}),
+        short_lived_bytes_({"short_lived_bytes",
+                            static_cast<int64_t>(stats.short_lived_bytes)}),
+        mean_short_lived_lifetime_ns_(
+            {"mean_short_lived_lifetime_ns",
+             Mean(stats.total_short_lived_lifetime_ns,
+                  stats.short_lived_count)}),
+        trace_attr_("trace_attr", "memory_usage", "X",
+                    {&window_duration_, &allocation_count_,
+                     &failed_allocation_count_, &free_count_,
+                     &allocations_per_sec_, &frees_per_sec_,
+                     &allocated_bytes_per_sec_, &freed_bytes_per_sec_,
+                     &mean_allocate_ns_, &max_allocate_ns_, &mean_free_ns_,
+                     &max_free_ns_, &size_classes_, &short_lived_count_,
+                     &short_lived_bytes_, &mean_short_lived_lifetime_ns_}) {
+    InitAttributes({&window_duration_, &allocation_count_,
+                    &failed_allocation_count_, &free_count_,
+                    &allocations_per_sec_, &frees_per_sec_,
+                    &allocated_bytes_per_sec_, &freed_bytes_per_sec_,
+                    &mean_allocate_ns_, &max_allocate_ns_, &mean_free_ns_,
+                    &max_free_ns_, &size_classes_, &short_lived_count_,
+                    &short_lived_bytes_, &mean_short_lived_lifetime_ns_,
+                    &trace_attr_});
+  }
+
+ private:
+  static int64_t Mean(int64_t total, uint64_t count) {
+    return count == 0 ? 0 : total / static_cast<int64_t>(count);
+  }
+
+  DurationAttr window_duration_;
+  Int64Attr allocation_count_;
+  Int64Attr failed_allocation_count_;
+  Int64Attr free_count_;
+  Int64Attr allocations_per_sec_;
+  Int64Attr frees_per_sec_;
+  Int64Attr allocated_bytes_per_sec_;
+  Int64Attr freed_bytes_per_sec_;
+  Int64Attr mean_allocate_ns_;
+  Int64Attr max_allocate_ns_;
+  Int64Attr mean_free_ns_;
+  Int64Attr max_free_ns_;
+  VectorInt64Attr size_classes_;
+  Int64Attr short_lived_count_;
+  Int64Attr short_lived_bytes_;
+  Int64Attr mean_short_lived_lifetime_ns_;
+  TraceEventAttr trace_attr_;
+};
+
+// An event for a single vkAllocateMemory or vkFreeMemory call that took longer
+// than the slow call threshold.
+class SlowMemoryCallEvent : public Event {
+ public:
+  SlowMemoryCallEvent(const char* name, VkDeviceSize size, Duration duration)
+      : Event(name),
+        size_({"size", static_cast<int64_t>(size)}),
+        duration_("duration", duration),
+        trace_attr_("trace_attr", "memory_usage", "X", {&duration_, &size_}) {
+    InitAttributes({&size_, &duration_, &trace_attr_});
+  }
+
+ private:
+  Int64Attr size_;
+  DurationAttr duration_;
+  TraceEventAttr trace_attr_;
+};
+
+// An event that holds the host memory allocated by the driver through the
+// allocation callbacks. The per-scope vectors are indexed by
+// VkSystemAllocationScope.
+class HostMemoryEvent : public Event {
+ public:
+  HostMemoryEvent(const char* name, const HostMemoryStats& stats)
+      : Event(name),
+        current_({"current", stats.total.current_bytes}),
+        peak_({"peak", stats.total.peak_bytes}),
+        internal_current_({"internal_current", stats.internal_current_bytes}),
+        allocation_count_({"allocation_count",
+                           static_cast<int64_t>(stats.total.allocation_count)}),
+        allocations_per_sec_({"allocations_per_sec",
+                              PerSecond(stats.window_allocation_count,
+                                        stats.window_duration)}),
+        allocated_bytes_per_sec_({"allocated_bytes_per_sec",
+                                  PerSecond(stats.window_allocated_bytes,
+                                            stats.window_duration)}),
+        current_by_scope_(
+            "current_by_scope",
+            GetScopeValues(stats, &HostAllocationUsage::current_bytes)),
+        peak_by_scope_("peak_by_scope",
+                       GetScopeValues(stats, &HostAllocationUsage::peak_bytes)),
+        trace_attr_("trace_attr", "memory_usage", "i",
+                    {&scope_, &current_, &peak_, &internal_current_,
+                     &allocation_count_, &allocations_per_sec_,
+                     &allocated_bytes_per_sec_, &current_by_scope_,
+                     &peak_by_scope_}) {
+    InitAttributes({&current_, &peak_, &internal_current_, &allocation_count_,
+                    &allocations_per_sec_, &allocated_bytes_per_sec_,
+                    &current_by_scope_, &peak_by_scope_, &trace_attr_});
+  }
+
+ private:
+  static std::vector<int64_t> GetScopeValues(
+      const HostMemoryStats& stats, int64_t HostAllocationUsage::*field) {
+    std::vector<int64_t> values;
+    for (const HostAllocationUsage& usage : stats.by_scope)
+      values.push_back(usage.*field);
+    return values;
+  }
+
+  Int64Attr current_;
+  Int64Attr peak_;
+  Int64Attr internal_current_;
+  Int64Attr allocation_count_;
+  Int64Attr allocations_per_sec_;
+  Int64Attr allocated_bytes_per_sec_;
+  VectorInt64Attr current_by_scope_;
+  VectorInt64Attr peak_by_scope_;
+  StringAttr scope_{"scope", "t"};
+  TraceEventAttr trace_attr_;
+};
+
+// An event that holds the host memory allocated during one kind of Vulkan
+// call.
+class HostMemorySourceEvent : public Event {
+ public:
+  HostMemorySourceEvent(const char* name, HostAllocationSource source,
+                        const HostAllocationUsage& usage)
+      : Event(name),
+        source_({"source", HostAllocationSourceToString(source)}),
+        current_({"current", usage.current_bytes}),
+        peak_({"peak", usage.peak_bytes}),
+        allocation_count_(
+            {"allocation_count", static_cast<int64_t>(usage.allocation_count)}),
+        trace_attr_("trace_attr", "memory_usage", "i",
+                    {&scope_, &source_, &current_, &peak_,
+                     &allocation_count_}) {
+    InitAttributes({&source_, &current_, &peak_, &allocation_count_,
+                    &trace_attr_});
+  }
+
+ private:
+  StringAttr source_;
+  Int64Attr current_;
+  Int64Attr peak_;
+  Int64Attr allocation_count_;
+  StringAttr scope_{"scope", "t"};
+  TraceEventAttr trace_attr_;
+};
+
+// A live device memory allocation.
+struct AllocationRecord {
+  VkDeviceSize size = 0;
+  uint32_t memory_type_index = 0;
+  // The number of frames presented before the allocation was made.
+  uint64_t frame = 0;
+  DurationClock::time_point time;
+  // The wall-clock time of the allocation, reported for leaked allocations.
+  TimestampClock::time_point timestamp;
+  // The stack of the allocating call, if it was sampled.
+  CallSiteProfiler::StackId call_site = CallSiteProfiler::kNoStack;
+};
+
+// An allocation that is still live, e.g., when its device is destroyed.
+struct LiveAllocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  uint32_t heap_index = 0;
+  AllocationRecord record;
+};
+
+// The live allocations of a device, per memory heap. All vectors have one entry
+// per heap of the device.
+struct DeviceMemorySnapshot {
+  VkDevice device = VK_NULL_HANDLE;
+  VkDeviceSize current_size = 0;
+  uint64_t allocation_count = 0;
+  std::vector<int64_t> heap_sizes;
+  std::vector<int64_t> heap_bytes;
+  std::vector<int64_t> heap_allocation_counts;
+};
+
+// Keeps the live memory allocations of a single VkDevice. The allocations are
+// spread over a fixed number of independently locked shards, so that threads
+// allocating and freeing memory on the same device rarely contend.
+class DeviceMemoryTable {
+ public:
+  // |memory_properties| are the memory types and heaps of the physical device.
+  explicit DeviceMemoryTable(
+      const VkPhysicalDeviceMemoryProperties& memory_properties)
+      : memory_properties_(memory_properties) {}
+
+  DeviceMemoryTable(const DeviceMemoryTable&) = delete;
+  DeviceMemoryTable& operator=(const DeviceMemoryTable&) = delete;
+
+  // Records |memory| as a live allocation.
+  void Insert(VkDeviceMemory memory, const AllocationRecord& record);
+
+  // Removes |memory| from the table and returns its record. Returns an empty
+  // record if |memory| is not in the table.
+  AllocationRecord Erase(VkDeviceMemory memory);
+
+  // Returns the sum of the sizes of all live allocations.
+  VkDeviceSize GetCurrentSize() const {
+    return current_size_.load(std::memory_order_relaxed);
+  }
+
+  // Returns the number of live allocations.
+  uint64_t GetAllocationCount() const {
+    return allocation_count_.load(std::memory_order_relaxed);
+  }
+
+  // Returns the heap of the memory type |memory_type_index|, or 0 if the type
+  // is out of range.
+  uint32_t GetHeapIndex(uint32_t memory_type_index) const;
+
+  // Returns the live allocations per heap. Lock-free; the counters of an
+  // allocation made concurrently may be only partially included.
+  DeviceMemorySnapshot GetSnapshot(VkDevice device) const;
+
+  // Returns all live allocations, oldest first. Takes every shard lock in
+  // turn.
+  std::vector<LiveAllocation> GetLiveAllocations() const;
+
+ private:
+  static constexpr size_t kNumShards = 8;
+
+  struct Shard {
+    mutable absl::Mutex lock;
+    // The map from a memory handle to its allocation record.
+    absl::flat_hash_map<VkDeviceMemory, AllocationRecord> allocations
+        ABSL_GUARDED_BY(lock);
+  };
+
+  Shard& GetShard(VkDeviceMemory memory) {
+    return shards_[absl::Hash<VkDeviceMemory>{}(memory) % kNumShards];
+  }
+
+  const VkPhysicalDeviceMemoryProperties memory_properties_;
+  std::array<Shard, kNumShards> shards_;
+  std::atomic<VkDeviceSize> current_size_ = 0;
+  std::atomic<uint64_t> allocation_count_ = 0;
+  std::array<std::atomic<VkDeviceSize>, VK_MAX_MEMORY_HEAPS> heap_bytes_ = {};
+  std::array<std::atomic<uint64_t>, VK_MAX_MEMORY_HEAPS>
+      heap_allocation_counts_ = {};
+};
+
+// Keeps track of the device memory allocated by the application. Allocations
+// are indexed per device first, so that all allocations of a device can be
+// dropped at once on DestroyDevice, and allocations on different devices do not
+// share any locks.
+class MemoryAllocationTracker {
+ public:
+  MemoryAllocationTracker() = default;
+
+  MemoryAllocationTracker(const MemoryAllocationTracker&) = delete;
+  MemoryAllocationTracker& operator=(const MemoryAllocationTracker&) = delete;
+
+  // Creates an empty allocation table for |device|, whose physical device has
+  // |memory_properties|. Must be called before any allocation is recorded for
+  // |device|.
+  void AddDevice(VkDevice device,
+                 const VkPhysicalDeviceMemoryProperties& memory_properties);
+
+  // Removes the allocation table of |device| and subtracts all of its live
+  // allocations from the current allocation size. The caller must guarantee
+  // that no other thread records allocations for |device| concurrently, which
+  // the Vulkan spec already requires for vkDestroyDevice.
+  void RemoveDevice(VkDevice device);
+
+  void RecordAllocateMemory(VkDevice device, VkDeviceMemory memory,
+                            const AllocationRecord& record);
+
+  // Removes |memory| and returns its record.
+  AllocationRecord RecordFreeMemory(VkDevice device, VkDeviceMemory memory);
+
+  // Returns the current allocation size. Lock-free, so it can be called on
+  // every present without contending with threads allocating memory.
+  uint64_t GetCurrentAllocationSize() const {
+    return current_allocation_size_.load(std::memory_order_relaxed);
+  }
+
+  // Returns the peak allocation size. Lock-free, like
+  // |GetCurrentAllocationSize|.
+  uint64_t GetPeakAllocationSize() const {
+    return peak_allocation_size_.load(std::memory_order_relaxed);
+  }
+
+  // Returns the per-heap usage of every device.
+  std::vector<DeviceMemorySnapshot> GetSnapshots() const;
+
+  // Returns the live allocations of |device|, oldest first.
+  std::vector<LiveAllocation> GetLiveAllocations(VkDevice device) const;
+
+ private:
+  // Returns the allocation table of |device|. The table stays valid until
+  // |RemoveDevice| is called for |device|.
+  DeviceMemoryTable* GetDeviceTable(VkDevice device) const;
+
+  mutable absl::Mutex device_tables_lock_;
+  // The map from a device to its live allocations. Only modified on device
+  // creation and destruction.
+  absl::flat_hash_map<VkDevice, std::unique_ptr<DeviceMemoryTable>>
+      device_tables_ ABSL_GUARDED_BY(device_tables_lock_);
+
+  // Adds |size| to the current allocation size and raises the peak allocation
+  // size if needed.
+  void AddAllocationSize(VkDeviceSize size);
+
+  // Subtracts |size| from the current allocation size.
+  void SubtractAllocationSize(VkDeviceSize size);
+
+  // Process-wide totals over all devices. Kept as atomics so that neither the
+  // updates nor the per-frame reads need a lock.
+  std::atomic<VkDeviceSize> current_allocation_size_ = 0;
+  std::atomic<VkDeviceSize> peak_allocation_size_ = 0;
+};
+
+// An event that holds the live device memory of one device, per memory heap.
+class MemorySnapshotEvent : public Event {
+ public:
+  MemorySnapshotEvent(const char* name, const DeviceMemorySnapshot& snapshot)
+      : Event(name),
+        device_({"device", static_cast<int64_t>(
+                               reinterpret_cast<uintptr_t>(snapshot.device))}),
+        current_({"current", static_cast<int64_t>(snapshot.current_size)}),
+        allocation_count_({"allocation_count",
+                           static_cast<int64_t>(snapshot.allocation_count)}),
+        heap_bytes_({"heap_bytes", snapshot.heap_bytes}),
+        heap_allocation_counts_(
+            {"heap_allocation_counts", snapshot.heap_allocation_counts}),
+        heap_sizes_({"heap_sizes", snapshot.heap_sizes}),
+        trace_attr_("trace_attr", "memory_usage", "i",
+                    {&scope_, &device_, &current_, &allocation_count_,
+                     &heap_bytes_, &heap_allocation_counts_}) {
+    InitAttributes({&device_, &current_, &allocation_count_, &heap_bytes_,
+                    &heap_allocation_counts_, &heap_sizes_, &trace_attr_});
+  }
+
+ private:
+  Int64Attr device_;
+  Int64Attr current_;
+  Int64Attr allocation_count_;
+  VectorInt64Attr heap_bytes_;
+  VectorInt64Attr heap_allocation_counts_;
+  VectorInt64Attr heap_sizes_;
+  StringAttr scope_{"scope", "t"};
+  TraceEventAttr trace_attr_;
+};
+
+// An event that holds a device memory allocation that was never freed.
+class LeakedAllocationEvent : public Event {
+ public:
+  // |call_site| is the folded stack of the allocating call, or empty if it
+  // wasn't sampled.
+  LeakedAllocationEvent(const char* name, VkDevice device,
+                        const LiveAllocation& allocation,
+                        const std::string& call_site)
+      : Event(name),
+        device_({"device",
+                 static_cast<int64_t>(reinterpret_cast<uintptr_t>(device))}),
+        memory_({"memory", static_cast<int64_t>(reinterpret_cast<uintptr_t>(
+                               allocation.memory))}),
+        size_({"size", static_cast<int64_t>(allocation.record.size)}),
+        memory_type_({"memory_type", allocation.record.memory_type_index}),
+        heap_({"heap", allocation.heap_index}),
+        frame_({"frame", static_cast<int64_t>(allocation.record.frame)}),
+        allocation_time_({"allocation_time", allocation.record.timestamp}),
+        call_site_({"call_site", call_site}),
+        trace_attr_("trace_attr", "memory_usage", "i",
+                    {&scope_, &memory_, &size_, &memory_type_, &heap_,
+                     &frame_, &call_site_}) {
+    InitAttributes({&device_, &memory_, &size_, &memory_type_, &heap_,
+                    &frame_, &allocation_time_, &call_site_, &trace_attr_});
+  }
+
+ private:
+  Int64Attr device_;
+  Int64Attr memory_;
+  Int64Attr size_;
+  Int64Attr memory_type_;
+  Int64Attr heap_;
+  Int64Attr frame_;
+  TimestampAttr allocation_time_;
+  StringAttr call_site_;
+  StringAttr scope_{"scope", "t"};
+  TraceEventAttr trace_attr_;
+};
+
+// An event that summarizes the allocations of a device that were never freed.
+class LeakReportEvent : public Event {
+ public:
+  LeakReportEvent(const char* name, VkDevice device, uint64_t leaked_count,
+                  VkDeviceSize leaked_bytes)
+      : Event(name),
+        device_({"device",
+                 static_cast<int64_t>(reinterpret_cast<uintptr_t>(device))}),
+        leaked_count_({"leaked_count", static_cast<int64_t>(leaked_count)}),
+        leaked_bytes_({"leaked_bytes", static_cast<int64_t>(leaked_bytes)}),
+        trace_attr_("trace_attr", "memory_usage", "i",
+                    {&scope_, &device_, &leaked_count_, &leaked_bytes_}) {
+    InitAttributes({&device_, &leaked_count_, &leaked_bytes_, &trace_attr_});
+  }
+
+ private:
+  Int64Attr device_;
+  Int64Attr leaked_count_;
+  Int64Attr leaked_bytes_;
+  StringAttr scope_{"scope", "t"};
+  TraceEventAttr trace_attr_;
+};
+
+// A class that contains all of the data that is needed for the functions
+// that this layer will override.
+//
+// The filename for the log file will be retrieved from the environment variable
+// "VK_MEMORY_USAGE_LOG".  If it is unset, then stderr will be used as the
+// log file.
+class MemoryUsageLayerData : public LayerData {
+ public:
+  struct Options {
+    // Every |report_frame_interval| presents, a report of the memory occupied
+    // by buffers and images is written to the event logs. 0 disables the
+    // periodic reports; a report is still written when a device is destroyed.
+    uint64_t report_frame_interval = 0;
+    // Every |churn_window_frames| presents, the allocation and free rates of
+    // the last window are written to the event logs. 0 disables them.
+    uint64_t churn_window_frames = 0;
+    // Allocations freed less than |short_lived_frames| frames after they were
+    // made are counted as short-lived.
+    uint64_t short_lived_frames = 2;
+    // vkAllocateMemory and vkFreeMemory calls that take longer than this are
+    // logged as individual events. 0 disables them.
+    Duration slow_call_threshold = Duration::FromNanoseconds(0);
+    // Every |snapshot_frames| presents, the current and peak allocation sizes
+    // and the live memory of every device per heap are written to the event
+    // logs. 0 disables the snapshots.
+    uint64_t snapshot_frames = 60;
+    // Every |host_report_frames| presents, the host memory allocated by the
+    // driver is written to the event logs. 0 disables host memory tracking,
+    // in which case the application's allocation callbacks are passed down
+    // unchanged.
+    uint64_t host_report_frames = 0;
+    // Every |call_site_sample_bytes| allocated bytes, the stack of the
+    // allocating call is captured. 0 disables the sampling.
+    uint64_t call_site_sample_bytes = 0;
+    // The file the sampled stacks are written to when the layer is unloaded,
+    // in the folded format of flame graph tools. If null, stderr is used.
+    const char* call_site_log = nullptr;
+  };
+
+  // The number of allocations and resource classes included in each report.
+  static constexpr size_t kMaxReportedAllocations = 8;
+  static constexpr size_t kMaxReportedResourceClasses = 8;
+  // The layer's own frames in the sampled allocation stacks:
+  // RecordAllocateMemory and the vkAllocateMemory override.
+  static constexpr size_t kCallSiteSkipFrames = 2;
+
+  MemoryUsageLayerData(const char* log_filename, const Options& options)
+      : LayerData(log_filename, "Current (bytes), peak (bytes)"),
+        options_(options),
+        churn_(options.short_lived_frames),
+        call_sites_(options.call_site_sample_bytes, kCallSiteSkipFrames) {
+    if (options.host_report_frames != 0)
+      host_allocations_ = std::make_unique<HostAllocationTracker>();
+    LayerInitEvent event("memory_usage_layer_init", "memory_usage");
+    LogEvent(&event);
+    StartControl("memory_usage");
+  }
+
+  // Writes the sampled allocation call sites, if any.
+  ~MemoryUsageLayerData() override;
+
+  // Also logs a memory snapshot and the resource attribution report.
+  void LogSnapshot() override;
+
+  // Creates the allocation table of |device|, using the memory properties of
+  // |physical_device|.
+  void RecordCreateDevice(VkPhysicalDevice physical_device, VkDevice device);
+
+  // Removes memory allocation records for the device being destroyed.
+  void RecordDestroyDeviceMemory(VkDevice device) {
+    allocations_.RemoveDevice(device);
+    resources_.RemoveDevice(device);
+    absl::MutexLock lock(&device_instances_lock_);
+    device_instances_.erase(device);
+  }
+
+  // Records a vkAllocateMemory call that returned |result| after |duration|.
+  void RecordAllocateMemory(VkDevice device, VkDeviceMemory memory,
+                            const VkMemoryAllocateInfo* allocate_info,
+                            VkResult result, Duration duration);
+
+  // Removes the records of |memory| and returns its allocation record. Must be
+  // called before the memory is freed, so that the handle cannot be reused by a
+  // concurrent allocation before its records are gone.
+  AllocationRecord RecordFreeMemory(VkDevice device, VkDeviceMemory memory);
+
+  // Records a vkFreeMemory call of the allocation |record| that took
+  // |duration|.
+  void RecordFreeMemoryCall(const AllocationRecord& record, Duration duration);
+
+  // Records the creation parameters and memory requirements of a new buffer.
+  void RecordCreateBuffer(VkDevice device, VkBuffer buffer,
+                          const VkBufferCreateInfo* create_info);
+
+  // Records the creation parameters and memory requirements of a new image.
+  void RecordCreateImage(VkDevice device, VkImage image,
+                         const VkImageCreateInfo* create_info);
+
+  void RecordDestroyBuffer(VkDevice device, VkBuffer buffer) {
+    resources_.RecordDestroyBuffer(device, buffer);
+  }
+
+  void RecordDestroyImage(VkDevice device, VkImage image) {
+    resources_.RecordDestroyImage(device, image);
+  }
+
+  void RecordBindBufferMemory(VkDevice device, VkBuffer buffer,
+                              VkDeviceMemory memory, VkDeviceSize offset) {
+    resources_.RecordBindBufferMemory(device, buffer, memory, offset);
+  }
+
+  void RecordBindImageMemory(VkDevice device, VkImage image,
+                             VkDeviceMemory memory, VkDeviceSize offset) {
+    resources_.RecordBindImageMemory(device, image, memory, offset);
+  }
+
+  // Counts a presented frame, updates the live memory metrics, and logs the
+  // resource attribution report, the allocation churn and the host memory
+  // usage if their intervals have elapsed, unless the layer's instrumentation
+  // is off.
+  void RecordPresent();
+
+  // Returns the allocation callbacks to pass down the chain in place of
+  // |app_allocator|. Must be used both when creating and destroying an object.
+  const VkAllocationCallbacks* GetHostAllocator(
+      const VkAllocationCallbacks* app_allocator) {
+    return host_allocations_ ? host_allocations_->GetCallbacks(app_allocator)
+                             : app_allocator;
+  }
+
+  // Logs the current and peak allocation sizes, and the live memory of every
+  // device per heap.
+  void LogMemorySnapshot(const char* name);
+
+  // Logs every allocation of |device| that is still live, followed by a
+  // summary. Must be called before the records of |device| are removed.
+  void LogLeakReport(VkDevice device);
+
+  // Logs the leak reports of the devices created from |instance| that were
+  // never destroyed.
+  void LogLeakReports(VkInstance instance);
+
+  // Logs the host memory allocated by the driver, in total and per source.
+  // Does nothing if host memory tracking is disabled.
+  void LogHostMemoryUsage();
+
+  // Logs the resource attribution report: the totals, the allocations with the
+  // most unused memory, and the resource classes occupying the most memory.
+  void LogResourceAttributionReport();
+
+  uint64_t GetPeakAllocationSize() const {
+    return allocations_.GetPeakAllocationSize();
+  }
+
+  uint64_t GetCurrentAllocationSize() const {
+    return allocations_.GetCurrentAllocationSize();
+  }
+
+ private:
+  // Logs a SlowMemoryCallEvent if |duration| exceeds the slow call threshold,
+  // unless the layer's instrumentation is off.
+  void LogIfSlow(const char* name, VkDeviceSize size, Duration duration);
+
+  const Options options_;
+  MemoryAllocationTracker allocations_;
+  MemoryResourceTracker resources_;
+  AllocationChurnTracker churn_;
+  // Null if host memory tracking is disabled.
+  std::unique_ptr<HostAllocationTracker> host_allocations_;
+  CallSiteProfiler call_sites_;
+  std::atomic<uint64_t> frame_count_ = 0;
+
+  Gauge current_allocation_metric_ =
+      MetricsRegistry::Get()->GetGauge("memory_usage_current_bytes");
+  Gauge peak_allocation_metric_ =
+      MetricsRegistry::Get()->GetGauge("memory_usage_peak_bytes");
+
+  absl::Mutex device_instances_lock_;
+  // The instance each live device was created from.
+  absl::flat_hash_map<VkDevice, InstanceKey> device_instances_
+      ABSL_GUARDED_BY(device_instances_lock_);
+};
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_MEMORY_USAGE_LAYER_DATA_H_
@@ -0,0 +1,314 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "layer/support/layer_config.h"
+#include "layer/support/layer_data.h"
+#include "layer/support/layer_utils.h"
+#include "queue_submit_layer_data.h"
+
+namespace performancelayers {
+namespace {
+// ----------------------------------------------------------------------------
+// Layer book-keeping information
+// ----------------------------------------------------------------------------
+
+constexpr uint32_t kQueueSubmitLayerVersion = 1;
+constexpr char kLayerName[] = "VK_LAYER_STADIA_queue_submit";
+constexpr char kLayerDescription[] = "Stadia Queue Submission Measuring Layer";
+
+QueueSubmitLayerData* GetLayerData() {
+  // Don't use new -- make the destructor run when the layer gets unloaded.
+  static QueueSubmitLayerData layer_data(
+      NullIfEmpty(GetLayerConfig().queue_submit.log));
+  return &layer_data;
+}
+
+// Use this macro to define all vulkan functions intercepted by the layer.
+#define SPL_QUEUE_SUBMIT_LAYER_FUNC(RETURN_TYPE_, FUNC_NAME_, FUNC_ARGS_)  \
+  SPL_INTERCEPTED_VULKAN_FUNC(RETURN_TYPE_, QueueSubmitLayer_, FUNC_NAME_, \
+                              FUNC_ARGS_)
+
+// The functions intercepted by the layer, defined below with
+// SPL_QUEUE_SUBMIT_LAYER_FUNC.
+#define SPL_QUEUE_SUBMIT_LAYER_FUNCS(X_, LAYER_PREFIX_) \
+  X_(LAYER_PREFIX_, QueueSubmit)                        \
+  X_(LAYER_PREFIX_, QueueSubmit2)                       \
+  X_(LAYER_PREFIX_, QueueSubmit2KHR)                    \
+  X_(LAYER_PREFIX_, QueueBindSparse)                    \
+  X_(LAYER_PREFIX_, QueuePresentKHR)                    \
+  X_(LAYER_PREFIX_, DestroyInstance)                    \
+  X_(LAYER_PREFIX_, CreateInstance)                     \
+  X_(LAYER_PREFIX_, DestroyDevice)                      \
+  X_(LAYER_PREFIX_, CreateDevice)                       \
+  X_(LAYER_PREFIX_, EnumerateInstanceLayerProperties)   \
+  X_(LAYER_PREFIX_, EnumerateDeviceLayerProperties)     \
+  X_(LAYER_PREFIX_, GetDeviceProcAddr)                  \
+  X_(LAYER_PREFIX_, GetInstanceProcAddr)
+
+SPL_DECLARE_INTERCEPTED_FUNCTIONS(QueueSubmitLayer_,
+                                  SPL_QUEUE_SUBMIT_LAYER_FUNCS);
+
+//////////////////////////////////////////////////////////////////////////////
+//  Implementation of the instance functions we want to override.
+//////////////////////////////////////////////////////////////////////////////
+
+// Override for vkDestroyInstance.  Deletes the entry for |instance| from the
+// layer data.
+SPL_QUEUE_SUBMIT_LAYER_FUNC(void, DestroyInstance,
+                            (VkInstance instance,
+                             const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextInstanceProcAddr(
+      instance, &VkLayerInstanceDispatchTable::DestroyInstance);
+  layer_data->RemoveInstance(instance);
+  next_proc(instance, allocator);
+}
+
+// Override for vkCreateInstance.  Creates the dispatch table for this instance
+// and add it to the layer data.
+SPL_QUEUE_SUBMIT_LAYER_FUNC(VkResult, CreateInstance,
+                            (const VkInstanceCreateInfo* create_info,
+                             const VkAllocationCallbacks* allocator,
+                             VkInstance* instance)) {
+  auto build_dispatch_table =
+      [instance](PFN_vkGetInstanceProcAddr get_proc_addr) {
+        // Build dispatch table for the instance functions we need to call.
+        VkLayerInstanceDispatchTable dispatch_table{};
+
+        // Get the next layer's instance of the instance functions we will
+        // override.
+        SPL_DISPATCH_INSTANCE_FUNC(DestroyInstance);
+        SPL_DISPATCH_INSTANCE_FUNC(GetInstanceProcAddr);
+        return dispatch_table;
+      };
+
+  return GetLayerData()->CreateInstance(create_info, allocator, instance,
+                                        build_dispatch_table);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//  Implementation of the device function we want to override.
+//////////////////////////////////////////////////////////////////////////////
+
+// Override for vkQueueSubmit.  Measures the time the driver takes to accept
+// the submission, and records the size of the submission.
+SPL_QUEUE_SUBMIT_LAYER_FUNC(VkResult, QueueSubmit,
+                            (VkQueue queue, uint32_t submit_count,
+                             const VkSubmitInfo* submits, VkFence fence)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      queue, &VkLayerDispatchTable::QueueSubmit);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(queue, submit_count, submits, fence);
+
+  DurationClock::time_point start = Now();
+  VkResult result = next_proc(queue, submit_count, submits, fence);
+  Duration duration = Now() - start;
+  layer_data->RecordSubmit("queue_submit", queue,
+                           CountSubmits(submit_count, submits, fence),
+                           duration, layer_data->ShouldInstrument());
+  return result;
+}
+
+// Override for vkQueueSubmit2.  Like vkQueueSubmit.
+SPL_QUEUE_SUBMIT_LAYER_FUNC(VkResult, QueueSubmit2,
+                            (VkQueue queue, uint32_t submit_count,
+                             const VkSubmitInfo2* submits, VkFence fence)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      queue, &VkLayerDispatchTable::QueueSubmit2);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(queue, submit_count, submits, fence);
+
+  DurationClock::time_point start = Now();
+  VkResult result = next_proc(queue, submit_count, submits, fence);
+  Duration duration = Now() - start;
+  layer_data->RecordSubmit("queue_submit2", queue,
+                           CountSubmits(submit_count, submits, fence),
+                           duration, layer_data->ShouldInstrument());
+  return result;
+}
+
+// Override for vkQueueSubmit2KHR.  Same as vkQueueSubmit2.
+SPL_QUEUE_SUBMIT_LAYER_FUNC(VkResult, QueueSubmit2KHR,
+                            (VkQueue queue, uint32_t submit_count,
+                             const VkSubmitInfo2* submits, VkFence fence)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      queue, &VkLayerDispatchTable::QueueSubmit2KHR);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(queue, submit_count, submits, fence);
+
+  DurationClock::time_point start = Now();
+  VkResult result = next_proc(queue, submit_count, submits, fence);
+  Duration duration = Now() - start;
+  layer_data->RecordSubmit("queue_submit2", queue,
+                           CountSubmits(submit_count, submits, fence),
+                           duration, layer_data->ShouldInstrument());
+  return result;
+}
+
+// Override for vkQueueBindSparse.  Sparse bindings go through the queue like
+// submissions, and are recorded as submissions without command buffers.
+SPL_QUEUE_SUBMIT_LAYER_FUNC(VkResult, QueueBindSparse,
+                            (VkQueue queue, uint32_t bind_info_count,
+                             const VkBindSparseInfo* bind_infos,
+                             VkFence fence)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      queue, &VkLayerDispatchTable::QueueBindSparse);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(queue, bind_info_count, bind_infos, fence);
+
+  DurationClock::time_point start = Now();
+  VkResult result = next_proc(queue, bind_info_count, bind_infos, fence);
+  Duration duration = Now() - start;
+  layer_data->RecordSubmit("queue_bind_sparse", queue,
+                           CountSubmits(bind_info_count, bind_infos, fence),
+                           duration, layer_data->ShouldInstrument());
+  return result;
+}
+
+// Override for vkQueuePresentKHR.  Logs the submissions of the frame.
+SPL_QUEUE_SUBMIT_LAYER_FUNC(VkResult, QueuePresentKHR,
+                            (VkQueue queue,
+                             const VkPresentInfoKHR* present_info)) {
+  auto* layer_data = GetLayerData();
+  layer_data->RecordPresent();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      queue, &VkLayerDispatchTable::QueuePresentKHR);
+  return next_proc(queue, present_info);
+}
+
+// Override for vkDestroyDevice.  Removes the dispatch table for the device from
+// the layer data.
+SPL_QUEUE_SUBMIT_LAYER_FUNC(void, DestroyDevice,
+                            (VkDevice device,
+                             const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyDevice);
+  layer_data->RemoveDevice(device);
+  next_proc(device, allocator);
+}
+
+// Override for vkCreateDevice.  Builds the dispatch table for the new device
+// and add it to the layer data.
+SPL_QUEUE_SUBMIT_LAYER_FUNC(VkResult, CreateDevice,
+                            (VkPhysicalDevice physical_device,
+                             const VkDeviceCreateInfo* create_info,
+                             const VkAllocationCallbacks* allocator,
+                             VkDevice* device)) {
+  auto build_dispatch_table = [device](PFN_vkGetDeviceProcAddr gdpa) {
+    VkLayerDispatchTable dispatch_table{};
+
+    // Get the next layer's instance of the device functions we will override.
+    // vkQueueSubmit2 and vkQueueSubmit2KHR are null unless the device
+    // supports them.
+    SPL_DISPATCH_DEVICE_FUNC(DestroyDevice);
+    SPL_DISPATCH_DEVICE_FUNC(GetDeviceProcAddr);
+    SPL_DISPATCH_DEVICE_FUNC(QueueSubmit);
+    SPL_DISPATCH_DEVICE_FUNC(QueueSubmit2);
+    SPL_DISPATCH_DEVICE_FUNC(QueueSubmit2KHR);
+    SPL_DISPATCH_DEVICE_FUNC(QueueBindSparse);
+    SPL_DISPATCH_DEVICE_FUNC(QueuePresentKHR);
+    return dispatch_table;
+  };
+
+  return GetLayerData()->CreateDevice(physical_device, create_info, allocator,
+                                      device, build_dispatch_table);
+}
+
+SPL_QUEUE_SUBMIT_LAYER_FUNC(VkResult, EnumerateInstanceLayerProperties,
+                            (uint32_t * property_count,
+                             VkLayerProperties* properties)) {
+  if (property_count) *property_count = 1;
+
+  if (properties) {
+    strncpy(properties->layerName, kLayerName, sizeof(properties->layerName));
+    strncpy(properties->description, kLayerDescription,
+            sizeof(properties->description));
+    properties->implementationVersion = kQueueSubmitLayerVersion;
+    properties->specVersion = VK_API_VERSION_1_0;
+  }
+
+  return VK_SUCCESS;
+}
+
+SPL_QUEUE_SUBMIT_LAYER_FUNC(VkResult, EnumerateDeviceLayerProperties,
+                            (VkPhysicalDevice /* physical_device */,
+                             uint32_t* property_count,
+                             VkLayerProperties* properties)) {
+  return QueueSubmitLayer_EnumerateInstanceLayerProperties(property_count,
+                                                           properties);
+}
+
+}  // namespace
+
+SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE(QueueSubmitLayer_,
+                                      SPL_QUEUE_SUBMIT_LAYER_FUNCS);
+
+// The *GetProcAddr functions are the entry points to the layers.
+// They return a function pointer for the instance requested by |name|.  We
+// return the functions defined in this layer for those we want to override.
+// Otherwise we call the *GetProcAddr function for the next layer to get the
+// function to be called.
+
+SPL_LAYER_ENTRY_POINT SPL_QUEUE_SUBMIT_LAYER_FUNC(PFN_vkVoidFunction,
+                                                  GetDeviceProcAddr,
+                                                  (VkDevice device,
+                                                   const char* name)) {
+  auto* layer_data = GetLayerData();
+
+  PFN_vkGetDeviceProcAddr next_get_proc_addr =
+      layer_data->GetNextDeviceProcAddr(
+          device, &VkLayerDispatchTable::GetDeviceProcAddr);
+  assert(next_get_proc_addr && next_get_proc_addr != VK_NULL_HANDLE);
+  // The functions of the features and extensions that the device didn't
+  // enable are null down the chain, and must stay null.
+  PFN_vkVoidFunction next_func = next_get_proc_addr(device, name);
+  if (!next_func) return nullptr;
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(QueueSubmitLayer_, name)) {
+    return func;
+  }
+  return next_func;
+}
+
+SPL_LAYER_ENTRY_POINT SPL_QUEUE_SUBMIT_LAYER_FUNC(PFN_vkVoidFunction,
+                                                  GetInstanceProcAddr,
+                                                  (VkInstance instance,
+                                                   const char* name)) {
+  // The loader looks up the layer's functions here first, before calling any
+  // of them.
+  if (IsLayerOverheadProfilingEnabled()) {
+    GetLayerData()->SetOverheadProfiler(&QueueSubmitLayer_kOverheadProfiler);
+  }
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(QueueSubmitLayer_, name)) {
+    return func;
+  }
+
+  auto* layer_data = GetLayerData();
+
+  PFN_vkGetInstanceProcAddr next_get_proc_addr =
+      layer_data->GetNextInstanceProcAddr(
+          instance, &VkLayerInstanceDispatchTable::GetInstanceProcAddr);
+  assert(next_get_proc_addr && next_get_proc_addr != VK_NULL_HANDLE);
+  return next_get_proc_addr(instance, name);
+}
+
+}  // namespace performancelayers
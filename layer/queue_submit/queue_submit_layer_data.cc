@@ -0,0 +1,148 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "queue_submit_layer_data.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace performancelayers {
+QueueSubmitCounts CountSubmits(uint32_t submit_count,
+                               const VkSubmitInfo* submits, VkFence fence) {
+  QueueSubmitCounts counts;
+  counts.batch_count = submit_count;
+  for (uint32_t i = 0; i != submit_count; ++i) {
+    counts.command_buffer_count += submits[i].commandBufferCount;
+    counts.wait_semaphore_count += submits[i].waitSemaphoreCount;
+    counts.signal_semaphore_count += submits[i].signalSemaphoreCount;
+  }
+  counts.has_fence = fence != VK_NULL_HANDLE;
+  return counts;
+}
+
+QueueSubmitCounts CountSubmits(uint32_t submit_count,
+                               const VkSubmitInfo2* submits, VkFence fence) {
+  QueueSubmitCounts counts;
+  counts.batch_count = submit_count;
+  for (uint32_t i = 0; i != submit_count; ++i) {
+    counts.command_buffer_count += submits[i].commandBufferInfoCount;
+    counts.wait_semaphore_count += submits[i].waitSemaphoreInfoCount;
+    counts.signal_semaphore_count += submits[i].signalSemaphoreInfoCount;
+  }
+  counts.has_fence = fence != VK_NULL_HANDLE;
+  return counts;
+}
+
+QueueSubmitCounts CountSubmits(uint32_t bind_info_count,
+                               const VkBindSparseInfo* bind_infos,
+                               VkFence fence) {
+  QueueSubmitCounts counts;
+  counts.batch_count = bind_info_count;
+  for (uint32_t i = 0; i != bind_info_count; ++i) {
+    counts.wait_semaphore_count += bind_infos[i].waitSemaphoreCount;
+    counts.signal_semaphore_count += bind_infos[i].signalSemaphoreCount;
+  }
+  counts.has_fence = fence != VK_NULL_HANDLE;
+  return counts;
+}
+
+QueueSubmitLayerData::QueueState* QueueSubmitLayerData::GetQueueState(
+    VkQueue queue) {
+  {
+    absl::ReaderMutexLock lock(&queues_lock_);
+    if (auto it = queue_states_.find(queue); it != queue_states_.end())
+      return it->second;
+  }
+  absl::MutexLock lock(&queues_lock_);
+  auto [it, inserted] = queue_states_.try_emplace(queue);
+  if (inserted) {
+    queues_.push_back(std::make_unique<QueueState>(queue));
+    it->second = queues_.back().get();
+  }
+  return it->second;
+}
+
+void QueueSubmitLayerData::RecordSubmit(const char* function_name,
+                                        VkQueue queue,
+                                        const QueueSubmitCounts& counts,
+                                        Duration duration, bool log_call) {
+  const int64_t duration_ns = duration.ToNanoseconds();
+  submit_calls_metric_.Add();
+  command_buffers_metric_.Add(counts.command_buffer_count);
+  submit_time_metric_.Record(duration_ns / 1000);
+
+  QueueState* state = GetQueueState(queue);
+  state->call_count.fetch_add(1, std::memory_order_relaxed);
+  state->batch_count.fetch_add(counts.batch_count, std::memory_order_relaxed);
+  state->command_buffer_count.fetch_add(counts.command_buffer_count,
+                                        std::memory_order_relaxed);
+  state->wait_semaphore_count.fetch_add(counts.wait_semaphore_count,
+                                        std::memory_order_relaxed);
+  state->signal_semaphore_count.fetch_add(counts.signal_semaphore_count,
+                                          std::memory_order_relaxed);
+  state->fence_count.fetch_add(counts.has_fence, std::memory_order_relaxed);
+  state->submit_time_ns.fetch_add(duration_ns, std::memory_order_relaxed);
+  int64_t max_ns = state->max_submit_time_ns.load(std::memory_order_relaxed);
+  while (duration_ns > max_ns &&
+         !state->max_submit_time_ns.compare_exchange_weak(
+             max_ns, duration_ns, std::memory_order_relaxed)) {
+  }
+
+  if (log_call) {
+    QueueSubmitEvent event(function_name, queue, counts, duration);
+    LogEvent(&event);
+  }
+}
+
+void QueueSubmitLayerData::RecordPresent() {
+  const uint64_t frame = frame_.fetch_add(1, std::memory_order_relaxed);
+  std::vector<std::pair<VkQueue, QueueFrameStats>> frame_stats;
+  {
+    absl::ReaderMutexLock lock(&queues_lock_);
+    for (const std::unique_ptr<QueueState>& state : queues_) {
+      QueueFrameStats stats;
+      stats.call_count =
+          state->call_count.exchange(0, std::memory_order_relaxed);
+      if (stats.call_count == 0) continue;
+      stats.batch_count =
+          state->batch_count.exchange(0, std::memory_order_relaxed);
+      stats.command_buffer_count =
+          state->command_buffer_count.exchange(0, std::memory_order_relaxed);
+      stats.wait_semaphore_count =
+          state->wait_semaphore_count.exchange(0, std::memory_order_relaxed);
+      stats.signal_semaphore_count =
+          state->signal_semaphore_count.exchange(0, std::memory_order_relaxed);
+      stats.fence_count =
+          state->fence_count.exchange(0, std::memory_order_relaxed);
+      stats.submit_time_ns =
+          state->submit_time_ns.exchange(0, std::memory_order_relaxed);
+      stats.max_submit_time_ns =
+          state->max_submit_time_ns.exchange(0, std::memory_order_relaxed);
+      frame_stats.emplace_back(state->queue, stats);
+    }
+  }
+
+  // Log outside of the lock, so that the first submissions to new queues don't
+  // wait for the logs.
+  for (const auto& [queue, stats] : frame_stats) {
+    QueueSubmitFrameEvent event("queue_submit_frame",
+                                static_cast<int64_t>(frame), queue, stats);
+    LogEvent(&event);
+  }
+}
+
+}  // namespace performancelayers
@@ -0,0 +1,233 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_QUEUE_SUBMIT_LAYER_DATA_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_QUEUE_SUBMIT_LAYER_DATA_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "layer/support/event_logging.h"
+#include "layer/support/layer_data.h"
+#include "layer/support/layer_utils.h"
+#include "layer/support/metrics.h"
+
+namespace performancelayers {
+// The work handed to the driver by one vkQueueSubmit, vkQueueSubmit2 or
+// vkQueueBindSparse call. A batch is one of the call's VkSubmitInfo,
+// VkSubmitInfo2 or VkBindSparseInfo.
+struct QueueSubmitCounts {
+  uint32_t batch_count = 0;
+  uint32_t command_buffer_count = 0;
+  uint32_t wait_semaphore_count = 0;
+  uint32_t signal_semaphore_count = 0;
+  bool has_fence = false;
+};
+
+// Returns the counts of the batches of a vkQueueSubmit call.
+QueueSubmitCounts CountSubmits(uint32_t submit_count,
+                               const VkSubmitInfo* submits, VkFence fence);
+
+// Returns the counts of the batches of a vkQueueSubmit2 or vkQueueSubmit2KHR
+// call.
+QueueSubmitCounts CountSubmits(uint32_t submit_count,
+                               const VkSubmitInfo2* submits, VkFence fence);
+
+// Returns the counts of the batches of a vkQueueBindSparse call, which have no
+// command buffers.
+QueueSubmitCounts CountSubmits(uint32_t bind_info_count,
+                               const VkBindSparseInfo* bind_infos,
+                               VkFence fence);
+
+// The submissions to one queue in one frame.
+struct QueueFrameStats {
+  uint64_t call_count = 0;
+  uint64_t batch_count = 0;
+  uint64_t command_buffer_count = 0;
+  uint64_t wait_semaphore_count = 0;
+  uint64_t signal_semaphore_count = 0;
+  uint64_t fence_count = 0;
+  // The CPU time spent in the driver's submission functions.
+  int64_t submit_time_ns = 0;
+  int64_t max_submit_time_ns = 0;
+};
+
+// An event that holds a single submission call and the CPU time it took. The
+// trace event spans the call.
+class QueueSubmitEvent : public Event {
+ public:
+  QueueSubmitEvent(const char* name, VkQueue queue,
+                   const QueueSubmitCounts& counts, Duration duration)
+      : Event(name),
+        queue_({"queue", static_cast<int64_t>(reinterpret_cast<uintptr_t>(
+                             queue))}),
+        batch_count_({"batch_count", counts.batch_count}),
+        command_buffer_count_(
+            {"command_buffer_count", counts.command_buffer_count}),
+        wait_semaphore_count_(
+            {"wait_semaphore_count", counts.wait_semaphore_count}),
+        signal_semaphore_count_(
+            {"signal_semaphore_count", counts.signal_semaphore_count}),
+        has_fence_({"fence", counts.has_fence}),
+        duration_({"duration", duration}),
+        trace_attr_("trace_attr", "queue_submit", "X",
+                    {&queue_, &batch_count_, &command_buffer_count_,
+                     &wait_semaphore_count_, &signal_semaphore_count_,
+                     &has_fence_, &duration_}) {
+    InitAttributes({&queue_, &batch_count_, &command_buffer_count_,
+                    &wait_semaphore_count_, &signal_semaphore_count_,
+                    &has_fence_, &duration_, &trace_attr_});
+  }
+
+ private:
+  Int64Attr queue_;
+  Int64Attr batch_count_;
+  Int64Attr command_buffer_count_;
+  Int64Attr wait_semaphore_count_;
+  Int64Attr signal_semaphore_count_;
+  BoolAttr has_fence_;
+  DurationAttr duration_;
+  TraceEventAttr trace_attr_;
+};
+
+// An event that summarizes the submissions to one queue in one frame. The
+// average number of command buffers per submission is |command_buffer_count|
+// over |batch_count|.
+class QueueSubmitFrameEvent : public Event {
+ public:
+  QueueSubmitFrameEvent(const char* name, int64_t frame, VkQueue queue,
+                        const QueueFrameStats& stats)
+      : Event(name, LogLevel::kHigh),
+        frame_({"frame", frame}),
+        queue_({"queue", static_cast<int64_t>(reinterpret_cast<uintptr_t>(
+                             queue))}),
+        call_count_({"call_count", static_cast<int64_t>(stats.call_count)}),
+        batch_count_({"batch_count", static_cast<int64_t>(stats.batch_count)}),
+        command_buffer_count_(
+            {"command_buffer_count",
+             static_cast<int64_t>(stats.command_buffer_count)}),
+        wait_semaphore_count_(
+            {"wait_semaphore_count",
+             static_cast<int64_t>(stats.wait_semaphore_count)}),
+        signal_semaphore_count_(
+            {"signal_semaphore_count",
+             static_cast<int64_t>(stats.signal_semaphore_count)}),
+        fence_count_({"fence_count", static_cast<int64_t>(stats.fence_count)}),
+        submit_time_("submit_time",
+                     Duration::FromNanoseconds(stats.submit_time_ns)),
+        max_submit_time_("max_submit_time",
+                         Duration::FromNanoseconds(stats.max_submit_time_ns)),
+        trace_attr_("trace_attr", "queue_submit", "i",
+                    {&scope_, &frame_, &queue_, &call_count_, &batch_count_,
+                     &command_buffer_count_, &wait_semaphore_count_,
+                     &signal_semaphore_count_, &fence_count_, &submit_time_,
+                     &max_submit_time_}) {
+    InitAttributes({&frame_, &queue_, &call_count_, &batch_count_,
+                    &command_buffer_count_, &wait_semaphore_count_,
+                    &signal_semaphore_count_, &fence_count_, &submit_time_,
+                    &max_submit_time_, &trace_attr_});
+  }
+
+ private:
+  Int64Attr frame_;
+  Int64Attr queue_;
+  Int64Attr call_count_;
+  Int64Attr batch_count_;
+  Int64Attr command_buffer_count_;
+  Int64Attr wait_semaphore_count_;
+  Int64Attr signal_semaphore_count_;
+  Int64Attr fence_count_;
+  DurationAttr submit_time_;
+  DurationAttr max_submit_time_;
+  // `Perfetto` displays the args only for instant events with thread-level
+  // scope.
+  StringAttr scope_{"scope", "t"};
+  TraceEventAttr trace_attr_;
+};
+
+// A class that contains all of the data that is needed for the functions
+// that this layer will override.
+//
+// Every submission call is logged to the event logs, and, at every present,
+// the submissions of the frame are summarized per queue, in the order the
+// queues were first submitted to, in the layer's log file, the
+// "queue_submit.log" setting of the `LayerConfig`.
+class QueueSubmitLayerData : public LayerData {
+ public:
+  explicit QueueSubmitLayerData(const char* log_filename)
+      : LayerData(log_filename,
+                  "Frame,Queue,Calls,Batches,Command Buffers,Wait "
+                  "Semaphores,Signal Semaphores,Fences,Submit Time (ns),Max "
+                  "Submit Time (ns)") {
+    LayerInitEvent event("queue_submit_layer_init", "queue_submit");
+    LogEvent(&event);
+    StartControl("queue_submit");
+  }
+
+  // Records the submission call |function_name| to |queue|, which took
+  // |duration| in the driver. Logs the call if |log_call| is set.
+  void RecordSubmit(const char* function_name, VkQueue queue,
+                    const QueueSubmitCounts& counts, Duration duration,
+                    bool log_call);
+
+  // Logs the submissions of the frame that ends, and starts a new frame.
+  void RecordPresent();
+
+ private:
+  // The submissions to one queue in the current frame. Submissions update the
+  // counts without locking, and RecordPresent() takes and resets them, so a
+  // submission racing with a present may be split between the two frames.
+  struct QueueState {
+    explicit QueueState(VkQueue queue) : queue(queue) {}
+
+    const VkQueue queue;
+    std::atomic<uint64_t> call_count = 0;
+    std::atomic<uint64_t> batch_count = 0;
+    std::atomic<uint64_t> command_buffer_count = 0;
+    std::atomic<uint64_t> wait_semaphore_count = 0;
+    std::atomic<uint64_t> signal_semaphore_count = 0;
+    std::atomic<uint64_t> fence_count = 0;
+    std::atomic<int64_t> submit_time_ns = 0;
+    std::atomic<int64_t> max_submit_time_ns = 0;
+  };
+
+  // Returns the state of |queue|, adding it on the first submission to it.
+  // Only the first submission takes the writer lock.
+  QueueState* GetQueueState(VkQueue queue);
+
+  std::atomic<uint64_t> frame_ = 0;
+
+  absl::Mutex queues_lock_;
+  // The queues in the order they were first submitted to. The states don't
+  // move, so they can be used outside of the lock.
+  std::vector<std::unique_ptr<QueueState>> queues_
+      ABSL_GUARDED_BY(queues_lock_);
+  absl::flat_hash_map<VkQueue, QueueState*> queue_states_
+      ABSL_GUARDED_BY(queues_lock_);
+
+  Counter submit_calls_metric_ =
+      MetricsRegistry::Get()->GetCounter("queue_submit_calls_total");
+  Counter command_buffers_metric_ =
+      MetricsRegistry::Get()->GetCounter("queue_submit_command_buffers_total");
+  Histogram submit_time_metric_ =
+      MetricsRegistry::Get()->GetHistogram("queue_submit_cpu_time_us");
+};
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_QUEUE_SUBMIT_LAYER_DATA_H_
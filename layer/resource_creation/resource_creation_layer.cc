@@ -0,0 +1,494 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "resource_creation_layer_data.h"
+#include "layer/support/layer_config.h"
+#include "layer/support/layer_data.h"
+#include "layer/support/layer_utils.h"
+
+namespace performancelayers {
+namespace {
+// ----------------------------------------------------------------------------
+// Layer book-keeping information
+// ----------------------------------------------------------------------------
+
+constexpr uint32_t kResourceCreationLayerVersion = 1;
+constexpr char kLayerName[] = "VK_LAYER_STADIA_resource_creation";
+constexpr char kLayerDescription[] =
+    "Stadia Resource Creation Latency Measuring Layer";
+
+ResourceCreationLayerData* GetLayerData() {
+  // Don't use new -- make the destructor run when the layer gets unloaded.
+  const LayerConfig::ResourceCreation& config =
+      GetLayerConfig().resource_creation;
+  static ResourceCreationLayerData layer_data(
+      NullIfEmpty(config.log),
+      Duration::FromNanoseconds(config.slow_call_us * 1000));
+  return &layer_data;
+}
+
+// Use this macro to define all vulkan functions intercepted by the layer.
+#define SPL_RESOURCE_CREATION_LAYER_FUNC(RETURN_TYPE_, FUNC_NAME_, FUNC_ARGS_) \
+  SPL_INTERCEPTED_VULKAN_FUNC(RETURN_TYPE_, ResourceCreationLayer_,            \
+                              FUNC_NAME_, FUNC_ARGS_)
+
+// The functions intercepted by the layer, defined below with
+// SPL_RESOURCE_CREATION_LAYER_FUNC.
+#define SPL_RESOURCE_CREATION_LAYER_FUNCS(X_, LAYER_PREFIX_) \
+  X_(LAYER_PREFIX_, CreateImage)                             \
+  X_(LAYER_PREFIX_, DestroyImage)                            \
+  X_(LAYER_PREFIX_, CreateImageView)                         \
+  X_(LAYER_PREFIX_, DestroyImageView)                        \
+  X_(LAYER_PREFIX_, CreateBuffer)                            \
+  X_(LAYER_PREFIX_, DestroyBuffer)                           \
+  X_(LAYER_PREFIX_, CreateBufferView)                        \
+  X_(LAYER_PREFIX_, DestroyBufferView)                       \
+  X_(LAYER_PREFIX_, CreateSampler)                           \
+  X_(LAYER_PREFIX_, DestroySampler)                          \
+  X_(LAYER_PREFIX_, CreateDescriptorSetLayout)               \
+  X_(LAYER_PREFIX_, DestroyDescriptorSetLayout)              \
+  X_(LAYER_PREFIX_, QueuePresentKHR)                         \
+  X_(LAYER_PREFIX_, DestroyInstance)                         \
+  X_(LAYER_PREFIX_, CreateInstance)                          \
+  X_(LAYER_PREFIX_, DestroyDevice)                           \
+  X_(LAYER_PREFIX_, CreateDevice)                            \
+  X_(LAYER_PREFIX_, EnumerateInstanceLayerProperties)        \
+  X_(LAYER_PREFIX_, EnumerateDeviceLayerProperties)          \
+  X_(LAYER_PREFIX_, GetDeviceProcAddr)                       \
+  X_(LAYER_PREFIX_, GetInstanceProcAddr)
+
+SPL_DECLARE_INTERCEPTED_FUNCTIONS(ResourceCreationLayer_,
+                                  SPL_RESOURCE_CREATION_LAYER_FUNCS);
+
+//////////////////////////////////////////////////////////////////////////////
+//  Implementation of the instance functions we want to override.
+//////////////////////////////////////////////////////////////////////////////
+
+// Override for vkDestroyInstance.  Deletes the entry for |instance| from the
+// layer data.
+SPL_RESOURCE_CREATION_LAYER_FUNC(void, DestroyInstance,
+                                 (VkInstance instance,
+                                  const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextInstanceProcAddr(
+      instance, &VkLayerInstanceDispatchTable::DestroyInstance);
+  layer_data->RemoveInstance(instance);
+  next_proc(instance, allocator);
+}
+
+// Override for vkCreateInstance.  Creates the dispatch table for this instance
+// and add it to the layer data.
+SPL_RESOURCE_CREATION_LAYER_FUNC(VkResult, CreateInstance,
+                                 (const VkInstanceCreateInfo* create_info,
+                                  const VkAllocationCallbacks* allocator,
+                                  VkInstance* instance)) {
+  auto build_dispatch_table =
+      [instance](PFN_vkGetInstanceProcAddr get_proc_addr) {
+        // Build dispatch table for the instance functions we need to call.
+        VkLayerInstanceDispatchTable dispatch_table{};
+
+        // Get the next layer's instance of the instance functions we will
+        // override.
+        SPL_DISPATCH_INSTANCE_FUNC(DestroyInstance);
+        SPL_DISPATCH_INSTANCE_FUNC(GetInstanceProcAddr);
+        return dispatch_table;
+      };
+
+  return GetLayerData()->CreateInstance(create_info, allocator, instance,
+                                        build_dispatch_table);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//  Implementation of the device function we want to override.
+//////////////////////////////////////////////////////////////////////////////
+
+// Override for vkCreateImage.  Measures the call, and logs the extent,
+// format and mip levels of the image if it is slow.
+SPL_RESOURCE_CREATION_LAYER_FUNC(VkResult, CreateImage,
+                                 (VkDevice device,
+                                  const VkImageCreateInfo* create_info,
+                                  const VkAllocationCallbacks* allocator,
+                                  VkImage* image)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreateImage);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(device, create_info, allocator, image);
+
+  DurationClock::time_point start = Now();
+  VkResult result = next_proc(device, create_info, allocator, image);
+  layer_data->RecordCreateImage(*create_info, result, Now() - start);
+  return result;
+}
+
+// Override for vkDestroyImage.  Measures the call, unless |image| is null.
+SPL_RESOURCE_CREATION_LAYER_FUNC(void, DestroyImage,
+                                 (VkDevice device, VkImage image,
+                                  const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyImage);
+  if (image == VK_NULL_HANDLE ||
+      layer_data->GetInstrumentationMode() == InstrumentationMode::kOff) {
+    return next_proc(device, image, allocator);
+  }
+
+  DurationClock::time_point start = Now();
+  next_proc(device, image, allocator);
+  layer_data->RecordCall("resource_creation_slow_destroy_image",
+                         ResourceType::kImage, /*create=*/false, VK_SUCCESS,
+                         Now() - start);
+}
+
+// Override for vkCreateImageView.  Measures the call.
+SPL_RESOURCE_CREATION_LAYER_FUNC(VkResult, CreateImageView,
+                                 (VkDevice device,
+                                  const VkImageViewCreateInfo* create_info,
+                                  const VkAllocationCallbacks* allocator,
+                                  VkImageView* image_view)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreateImageView);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(device, create_info, allocator, image_view);
+
+  DurationClock::time_point start = Now();
+  VkResult result = next_proc(device, create_info, allocator, image_view);
+  layer_data->RecordCall("resource_creation_slow_create_image_view",
+                         ResourceType::kImageView, /*create=*/true, result,
+                         Now() - start);
+  return result;
+}
+
+// Override for vkDestroyImageView.  Measures the call, unless |image_view|
+// is null.
+SPL_RESOURCE_CREATION_LAYER_FUNC(void, DestroyImageView,
+                                 (VkDevice device, VkImageView image_view,
+                                  const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyImageView);
+  if (image_view == VK_NULL_HANDLE ||
+      layer_data->GetInstrumentationMode() == InstrumentationMode::kOff) {
+    return next_proc(device, image_view, allocator);
+  }
+
+  DurationClock::time_point start = Now();
+  next_proc(device, image_view, allocator);
+  layer_data->RecordCall("resource_creation_slow_destroy_image_view",
+                         ResourceType::kImageView, /*create=*/false, VK_SUCCESS,
+                         Now() - start);
+}
+
+// Override for vkCreateBuffer.  Measures the call, and logs the size and
+// usage of the buffer if it is slow.
+SPL_RESOURCE_CREATION_LAYER_FUNC(VkResult, CreateBuffer,
+                                 (VkDevice device,
+                                  const VkBufferCreateInfo* create_info,
+                                  const VkAllocationCallbacks* allocator,
+                                  VkBuffer* buffer)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreateBuffer);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(device, create_info, allocator, buffer);
+
+  DurationClock::time_point start = Now();
+  VkResult result = next_proc(device, create_info, allocator, buffer);
+  layer_data->RecordCreateBuffer(*create_info, result, Now() - start);
+  return result;
+}
+
+// Override for vkDestroyBuffer.  Measures the call, unless |buffer| is null.
+SPL_RESOURCE_CREATION_LAYER_FUNC(void, DestroyBuffer,
+                                 (VkDevice device, VkBuffer buffer,
+                                  const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyBuffer);
+  if (buffer == VK_NULL_HANDLE ||
+      layer_data->GetInstrumentationMode() == InstrumentationMode::kOff) {
+    return next_proc(device, buffer, allocator);
+  }
+
+  DurationClock::time_point start = Now();
+  next_proc(device, buffer, allocator);
+  layer_data->RecordCall("resource_creation_slow_destroy_buffer",
+                         ResourceType::kBuffer, /*create=*/false, VK_SUCCESS,
+                         Now() - start);
+}
+
+// Override for vkCreateBufferView.  Measures the call.
+SPL_RESOURCE_CREATION_LAYER_FUNC(VkResult, CreateBufferView,
+                                 (VkDevice device,
+                                  const VkBufferViewCreateInfo* create_info,
+                                  const VkAllocationCallbacks* allocator,
+                                  VkBufferView* buffer_view)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreateBufferView);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(device, create_info, allocator, buffer_view);
+
+  DurationClock::time_point start = Now();
+  VkResult result = next_proc(device, create_info, allocator, buffer_view);
+  layer_data->RecordCall("resource_creation_slow_create_buffer_view",
+                         ResourceType::kBufferView, /*create=*/true, result,
+                         Now() - start);
+  return result;
+}
+
+// Override for vkDestroyBufferView.  Measures the call, unless |buffer_view|
+// is null.
+SPL_RESOURCE_CREATION_LAYER_FUNC(void, DestroyBufferView,
+                                 (VkDevice device, VkBufferView buffer_view,
+                                  const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyBufferView);
+  if (buffer_view == VK_NULL_HANDLE ||
+      layer_data->GetInstrumentationMode() == InstrumentationMode::kOff) {
+    return next_proc(device, buffer_view, allocator);
+  }
+
+  DurationClock::time_point start = Now();
+  next_proc(device, buffer_view, allocator);
+  layer_data->RecordCall("resource_creation_slow_destroy_buffer_view",
+                         ResourceType::kBufferView, /*create=*/false,
+                         VK_SUCCESS, Now() - start);
+}
+
+// Override for vkCreateSampler.  Measures the call.
+SPL_RESOURCE_CREATION_LAYER_FUNC(VkResult, CreateSampler,
+                                 (VkDevice device,
+                                  const VkSamplerCreateInfo* create_info,
+                                  const VkAllocationCallbacks* allocator,
+                                  VkSampler* sampler)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreateSampler);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(device, create_info, allocator, sampler);
+
+  DurationClock::time_point start = Now();
+  VkResult result = next_proc(device, create_info, allocator, sampler);
+  layer_data->RecordCall("resource_creation_slow_create_sampler",
+                         ResourceType::kSampler, /*create=*/true, result,
+                         Now() - start);
+  return result;
+}
+
+// Override for vkDestroySampler.  Measures the call, unless |sampler| is
+// null.
+SPL_RESOURCE_CREATION_LAYER_FUNC(void, DestroySampler,
+                                 (VkDevice device, VkSampler sampler,
+                                  const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroySampler);
+  if (sampler == VK_NULL_HANDLE ||
+      layer_data->GetInstrumentationMode() == InstrumentationMode::kOff) {
+    return next_proc(device, sampler, allocator);
+  }
+
+  DurationClock::time_point start = Now();
+  next_proc(device, sampler, allocator);
+  layer_data->RecordCall("resource_creation_slow_destroy_sampler",
+                         ResourceType::kSampler, /*create=*/false, VK_SUCCESS,
+                         Now() - start);
+}
+
+// Override for vkCreateDescriptorSetLayout.  Measures the call.
+SPL_RESOURCE_CREATION_LAYER_FUNC(
+    VkResult, CreateDescriptorSetLayout,
+    (VkDevice device, const VkDescriptorSetLayoutCreateInfo* create_info,
+     const VkAllocationCallbacks* allocator,
+     VkDescriptorSetLayout* set_layout)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::CreateDescriptorSetLayout);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(device, create_info, allocator, set_layout);
+
+  DurationClock::time_point start = Now();
+  VkResult result = next_proc(device, create_info, allocator, set_layout);
+  layer_data->RecordCall("resource_creation_slow_create_descriptor_set_layout",
+                         ResourceType::kDescriptorSetLayout, /*create=*/true,
+                         result, Now() - start);
+  return result;
+}
+
+// Override for vkDestroyDescriptorSetLayout.  Measures the call, unless
+// |set_layout| is null.
+SPL_RESOURCE_CREATION_LAYER_FUNC(void, DestroyDescriptorSetLayout,
+                                 (VkDevice device,
+                                  VkDescriptorSetLayout set_layout,
+                                  const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyDescriptorSetLayout);
+  if (set_layout == VK_NULL_HANDLE ||
+      layer_data->GetInstrumentationMode() == InstrumentationMode::kOff) {
+    return next_proc(device, set_layout, allocator);
+  }
+
+  DurationClock::time_point start = Now();
+  next_proc(device, set_layout, allocator);
+  layer_data->RecordCall("resource_creation_slow_destroy_descriptor_set_layout",
+                         ResourceType::kDescriptorSetLayout, /*create=*/false,
+                         VK_SUCCESS, Now() - start);
+}
+
+// Override for vkQueuePresentKHR.  Logs the resource calls of the frame. The
+// calling thread is taken to be the render thread.
+SPL_RESOURCE_CREATION_LAYER_FUNC(VkResult, QueuePresentKHR,
+                                 (VkQueue queue,
+                                  const VkPresentInfoKHR* present_info)) {
+  auto* layer_data = GetLayerData();
+  layer_data->RecordPresent();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      queue, &VkLayerDispatchTable::QueuePresentKHR);
+  return next_proc(queue, present_info);
+}
+
+// Override for vkDestroyDevice.  Removes the dispatch table for the device from
+// the layer data.
+SPL_RESOURCE_CREATION_LAYER_FUNC(void, DestroyDevice,
+                                 (VkDevice device,
+                                  const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyDevice);
+  layer_data->RemoveDevice(device);
+  next_proc(device, allocator);
+}
+
+// Override for vkCreateDevice.  Builds the dispatch table for the new device
+// and add it to the layer data.
+SPL_RESOURCE_CREATION_LAYER_FUNC(VkResult, CreateDevice,
+                                 (VkPhysicalDevice physical_device,
+                                  const VkDeviceCreateInfo* create_info,
+                                  const VkAllocationCallbacks* allocator,
+                                  VkDevice* device)) {
+  auto build_dispatch_table = [device](PFN_vkGetDeviceProcAddr gdpa) {
+    VkLayerDispatchTable dispatch_table{};
+
+    // Get the next layer's instance of the device functions we will override.
+    SPL_DISPATCH_DEVICE_FUNC(DestroyDevice);
+    SPL_DISPATCH_DEVICE_FUNC(GetDeviceProcAddr);
+    SPL_DISPATCH_DEVICE_FUNC(CreateImage);
+    SPL_DISPATCH_DEVICE_FUNC(DestroyImage);
+    SPL_DISPATCH_DEVICE_FUNC(CreateImageView);
+    SPL_DISPATCH_DEVICE_FUNC(DestroyImageView);
+    SPL_DISPATCH_DEVICE_FUNC(CreateBuffer);
+    SPL_DISPATCH_DEVICE_FUNC(DestroyBuffer);
+    SPL_DISPATCH_DEVICE_FUNC(CreateBufferView);
+    SPL_DISPATCH_DEVICE_FUNC(DestroyBufferView);
+    SPL_DISPATCH_DEVICE_FUNC(CreateSampler);
+    SPL_DISPATCH_DEVICE_FUNC(DestroySampler);
+    SPL_DISPATCH_DEVICE_FUNC(CreateDescriptorSetLayout);
+    SPL_DISPATCH_DEVICE_FUNC(DestroyDescriptorSetLayout);
+    SPL_DISPATCH_DEVICE_FUNC(QueuePresentKHR);
+    return dispatch_table;
+  };
+
+  return GetLayerData()->CreateDevice(physical_device, create_info, allocator,
+                                      device, build_dispatch_table);
+}
+
+SPL_RESOURCE_CREATION_LAYER_FUNC(VkResult, EnumerateInstanceLayerProperties,
+                                 (uint32_t * property_count,
+                                  VkLayerProperties* properties)) {
+  if (property_count) *property_count = 1;
+
+  if (properties) {
+    strncpy(properties->layerName, kLayerName, sizeof(properties->layerName));
+    strncpy(properties->description, kLayerDescription,
+            sizeof(properties->description));
+    properties->implementationVersion = kResourceCreationLayerVersion;
+    properties->specVersion = VK_API_VERSION_1_0;
+  }
+
+  return VK_SUCCESS;
+}
+
+SPL_RESOURCE_CREATION_LAYER_FUNC(VkResult, EnumerateDeviceLayerProperties,
+                                 (VkPhysicalDevice /* physical_device */,
+                                  uint32_t* property_count,
+                                  VkLayerProperties* properties)) {
+  return ResourceCreationLayer_EnumerateInstanceLayerProperties(property_count,
+                                                                properties);
+}
+
+}  // namespace
+
+SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE(ResourceCreationLayer_,
+                                      SPL_RESOURCE_CREATION_LAYER_FUNCS);
+
+// The *GetProcAddr functions are the entry points to the layers.
+// They return a function pointer for the instance requested by |name|.  We
+// return the functions defined in this layer for those we want to override.
+// Otherwise we call the *GetProcAddr function for the next layer to get the
+// function to be called.
+
+SPL_LAYER_ENTRY_POINT SPL_RESOURCE_CREATION_LAYER_FUNC(PFN_vkVoidFunction,
+                                                       GetDeviceProcAddr,
+                                                       (VkDevice device,
+                                                        const char* name)) {
+  auto* layer_data = GetLayerData();
+
+  PFN_vkGetDeviceProcAddr next_get_proc_addr =
+      layer_data->GetNextDeviceProcAddr(
+          device, &VkLayerDispatchTable::GetDeviceProcAddr);
+  assert(next_get_proc_addr && next_get_proc_addr != VK_NULL_HANDLE);
+  // The functions of the features and extensions that the device didn't
+  // enable are null down the chain, and must stay null.
+  PFN_vkVoidFunction next_func = next_get_proc_addr(device, name);
+  if (!next_func) return nullptr;
+  if (auto func =
+          SPL_GET_INTERCEPTED_VULKAN_FUNC(ResourceCreationLayer_, name)) {
+    return func;
+  }
+  return next_func;
+}
+
+SPL_LAYER_ENTRY_POINT SPL_RESOURCE_CREATION_LAYER_FUNC(PFN_vkVoidFunction,
+                                                       GetInstanceProcAddr,
+                                                       (VkInstance instance,
+                                                        const char* name)) {
+  // The loader looks up the layer's functions here first, before calling any
+  // of them.
+  if (IsLayerOverheadProfilingEnabled()) {
+    GetLayerData()->SetOverheadProfiler(
+        &ResourceCreationLayer_kOverheadProfiler);
+  }
+  if (auto func =
+          SPL_GET_INTERCEPTED_VULKAN_FUNC(ResourceCreationLayer_, name)) {
+    return func;
+  }
+
+  auto* layer_data = GetLayerData();
+
+  PFN_vkGetInstanceProcAddr next_get_proc_addr =
+      layer_data->GetNextInstanceProcAddr(
+          instance, &VkLayerInstanceDispatchTable::GetInstanceProcAddr);
+  assert(next_get_proc_addr && next_get_proc_addr != VK_NULL_HANDLE);
+  return next_get_proc_addr(instance, name);
+}
+
+}  // namespace performancelayers
@@ -0,0 +1,117 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "resource_creation_layer_data.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace performancelayers {
+const char* ResourceResultToString(VkResult result) {
+  switch (result) {
+    case VK_SUCCESS:
+      return "VK_SUCCESS";
+    case VK_ERROR_OUT_OF_HOST_MEMORY:
+      return "VK_ERROR_OUT_OF_HOST_MEMORY";
+    case VK_ERROR_OUT_OF_DEVICE_MEMORY:
+      return "VK_ERROR_OUT_OF_DEVICE_MEMORY";
+    default:
+      return "VK_ERROR";
+  }
+}
+
+bool ResourceCreationLayerData::AddCall(ResourceType type, bool create,
+                                        Duration duration,
+                                        bool* present_thread) {
+  const size_t index = static_cast<size_t>(type);
+  const int64_t duration_ns = duration.ToNanoseconds();
+  if (create) {
+    create_count_[index].fetch_add(1, std::memory_order_relaxed);
+    create_time_ns_[index].fetch_add(duration_ns, std::memory_order_relaxed);
+  } else {
+    destroy_count_[index].fetch_add(1, std::memory_order_relaxed);
+    destroy_time_ns_[index].fetch_add(duration_ns, std::memory_order_relaxed);
+  }
+  *present_thread =
+      GetThreadId() == present_thread_id_.load(std::memory_order_relaxed);
+  if (*present_thread)
+    present_thread_time_ns_.fetch_add(duration_ns, std::memory_order_relaxed);
+  calls_metric_.Add();
+  call_time_metric_.Record(duration_ns / 1000);
+
+  if (duration_ns < slow_call_threshold_ns_) return false;
+  slow_call_count_.fetch_add(1, std::memory_order_relaxed);
+  slow_calls_metric_.Add();
+  return true;
+}
+
+void ResourceCreationLayerData::RecordCreateImage(
+    const VkImageCreateInfo& create_info, VkResult result, Duration duration) {
+  bool present_thread = false;
+  if (!AddCall(ResourceType::kImage, /*create=*/true, duration,
+               &present_thread)) {
+    return;
+  }
+  SlowImageCreationEvent event("resource_creation_slow_create_image",
+                               create_info, present_thread, result, duration);
+  LogEvent(&event);
+}
+
+void ResourceCreationLayerData::RecordCreateBuffer(
+    const VkBufferCreateInfo& create_info, VkResult result, Duration duration) {
+  bool present_thread = false;
+  if (!AddCall(ResourceType::kBuffer, /*create=*/true, duration,
+               &present_thread)) {
+    return;
+  }
+  SlowBufferCreationEvent event("resource_creation_slow_create_buffer",
+                                create_info, present_thread, result, duration);
+  LogEvent(&event);
+}
+
+void ResourceCreationLayerData::RecordCall(const char* name, ResourceType type,
+                                           bool create, VkResult result,
+                                           Duration duration) {
+  bool present_thread = false;
+  if (!AddCall(type, create, duration, &present_thread)) return;
+  SlowResourceCallEvent event(name, present_thread, result, duration);
+  LogEvent(&event);
+}
+
+void ResourceCreationLayerData::RecordPresent() {
+  present_thread_id_.store(GetThreadId(), std::memory_order_relaxed);
+  const uint64_t frame = frame_.fetch_add(1, std::memory_order_relaxed);
+  ResourceCreationFrameStats stats;
+  for (size_t i = 0; i != kNumResourceTypes; ++i) {
+    ResourceTypeFrameStats& type = stats.types[i];
+    type.create_count = create_count_[i].exchange(0, std::memory_order_relaxed);
+    type.create_time_ns =
+        create_time_ns_[i].exchange(0, std::memory_order_relaxed);
+    type.destroy_count =
+        destroy_count_[i].exchange(0, std::memory_order_relaxed);
+    type.destroy_time_ns =
+        destroy_time_ns_[i].exchange(0, std::memory_order_relaxed);
+  }
+  stats.present_thread_time_ns =
+      present_thread_time_ns_.exchange(0, std::memory_order_relaxed);
+  stats.slow_call_count =
+      slow_call_count_.exchange(0, std::memory_order_relaxed);
+
+  ResourceCreationFrameEvent event("resource_creation_frame",
+                                   static_cast<int64_t>(frame), stats);
+  LogEvent(&event);
+}
+
+}  // namespace performancelayers
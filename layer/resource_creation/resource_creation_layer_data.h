@@ -0,0 +1,391 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_RESOURCE_CREATION_LAYER_DATA_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_RESOURCE_CREATION_LAYER_DATA_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "layer/support/event_logging.h"
+#include "layer/support/layer_data.h"
+#include "layer/support/layer_utils.h"
+#include "layer/support/metrics.h"
+
+namespace performancelayers {
+// The resources whose creation and destruction are measured.
+enum class ResourceType {
+  kImage,
+  kImageView,
+  kBuffer,
+  kBufferView,
+  kSampler,
+  kDescriptorSetLayout,
+};
+
+constexpr size_t kNumResourceTypes = 6;
+
+// Returns the name of |result|, e.g., "VK_ERROR_OUT_OF_DEVICE_MEMORY", for the
+// results of the creation functions, and "VK_ERROR" for the other errors.
+const char* ResourceResultToString(VkResult result);
+
+// An event that holds a single creation or destruction call that took longer
+// than the slow call threshold, and whether it was made on the thread that
+// presents, where it delays the frame. The trace event spans the call on the
+// calling thread.
+class SlowResourceCallEvent : public Event {
+ public:
+  SlowResourceCallEvent(const char* name, bool present_thread, VkResult result,
+                        Duration duration)
+      : Event(name),
+        present_thread_({"present_thread", present_thread}),
+        result_("result", ResourceResultToString(result)),
+        duration_("duration", duration),
+        trace_attr_("trace_attr", "resource_creation", "X",
+                    {&present_thread_, &result_, &duration_}) {
+    InitAttributes({&present_thread_, &result_, &duration_, &trace_attr_});
+  }
+
+ private:
+  BoolAttr present_thread_;
+  StringAttr result_;
+  DurationAttr duration_;
+  TraceEventAttr trace_attr_;
+};
+
+// Like SlowResourceCallEvent, for vkCreateImage, with the parameters of the
+// image.
+class SlowImageCreationEvent : public Event {
+ public:
+  SlowImageCreationEvent(const char* name,
+                         const VkImageCreateInfo& create_info,
+                         bool present_thread, VkResult result,
+                         Duration duration)
+      : Event(name),
+        width_({"width", create_info.extent.width}),
+        height_({"height", create_info.extent.height}),
+        depth_({"depth", create_info.extent.depth}),
+        format_({"format", create_info.format}),
+        mip_levels_({"mip_levels", create_info.mipLevels}),
+        array_layers_({"array_layers", create_info.arrayLayers}),
+        present_thread_({"present_thread", present_thread}),
+        result_("result", ResourceResultToString(result)),
+        duration_("duration", duration),
+        trace_attr_("trace_attr", "resource_creation", "X",
+                    {&width_, &height_, &depth_, &format_, &mip_levels_,
+                     &array_layers_, &present_thread_, &result_, &duration_}) {
+    InitAttributes({&width_, &height_, &depth_, &format_, &mip_levels_,
+                    &array_layers_, &present_thread_, &result_, &duration_,
+                    &trace_attr_});
+  }
+
+ private:
+  Int64Attr width_;
+  Int64Attr height_;
+  Int64Attr depth_;
+  Int64Attr format_;
+  Int64Attr mip_levels_;
+  Int64Attr array_layers_;
+  BoolAttr present_thread_;
+  StringAttr result_;
+  DurationAttr duration_;
+  TraceEventAttr trace_attr_;
+};
+
+// Like SlowResourceCallEvent, for vkCreateBuffer, with the parameters of the
+// buffer.
+class SlowBufferCreationEvent : public Event {
+ public:
+  SlowBufferCreationEvent(const char* name,
+                          const VkBufferCreateInfo& create_info,
+                          bool present_thread, VkResult result,
+                          Duration duration)
+      : Event(name),
+        size_({"size", static_cast<int64_t>(create_info.size)}),
+        usage_({"usage", create_info.usage}),
+        present_thread_({"present_thread", present_thread}),
+        result_("result", ResourceResultToString(result)),
+        duration_("duration", duration),
+        trace_attr_("trace_attr", "resource_creation", "X",
+                    {&size_, &usage_, &present_thread_, &result_, &duration_}) {
+    InitAttributes({&size_, &usage_, &present_thread_, &result_, &duration_,
+                    &trace_attr_});
+  }
+
+ private:
+  Int64Attr size_;
+  Int64Attr usage_;
+  BoolAttr present_thread_;
+  StringAttr result_;
+  DurationAttr duration_;
+  TraceEventAttr trace_attr_;
+};
+
+// The creation and destruction calls of one resource type in one frame.
+struct ResourceTypeFrameStats {
+  uint64_t create_count = 0;
+  int64_t create_time_ns = 0;
+  uint64_t destroy_count = 0;
+  int64_t destroy_time_ns = 0;
+};
+
+// The creation and destruction calls of one frame, summed over all threads.
+struct ResourceCreationFrameStats {
+  ResourceTypeFrameStats types[kNumResourceTypes];
+  // The time spent in the calls made on the thread that presents.
+  int64_t present_thread_time_ns = 0;
+  uint64_t slow_call_count = 0;
+};
+
+// The attributes of one resource type in a ResourceCreationFrameEvent. The
+// attribute names are prefixed with the resource type, e.g.,
+// "image_create_count".
+struct ResourceTypeFrameAttrs {
+  ResourceTypeFrameAttrs(const char* create_count_name,
+                         const char* create_time_name,
+                         const char* destroy_count_name,
+                         const char* destroy_time_name,
+                         const ResourceTypeFrameStats& stats)
+      : create_count({create_count_name,
+                      static_cast<int64_t>(stats.create_count)}),
+        create_time(create_time_name,
+                    Duration::FromNanoseconds(stats.create_time_ns)),
+        destroy_count({destroy_count_name,
+                       static_cast<int64_t>(stats.destroy_count)}),
+        destroy_time(destroy_time_name,
+                     Duration::FromNanoseconds(stats.destroy_time_ns)) {}
+
+  Int64Attr create_count;
+  DurationAttr create_time;
+  Int64Attr destroy_count;
+  DurationAttr destroy_time;
+};
+
+// An event that summarizes the resource creation and destruction calls of one
+// frame: the total time spent in them, the part of it spent on the thread that
+// presents, the number of slow calls, and the number of calls and the time
+// spent in them by resource type.
+class ResourceCreationFrameEvent : public Event {
+ public:
+  ResourceCreationFrameEvent(const char* name, int64_t frame,
+                             const ResourceCreationFrameStats& stats)
+      : Event(name, LogLevel::kHigh),
+        frame_({"frame", frame}),
+        create_time_("create_time", GetTotalCreateTime(stats)),
+        destroy_time_("destroy_time", GetTotalDestroyTime(stats)),
+        present_thread_time_(
+            "present_thread_time",
+            Duration::FromNanoseconds(stats.present_thread_time_ns)),
+        slow_call_count_(
+            {"slow_call_count", static_cast<int64_t>(stats.slow_call_count)}),
+        image_("image_create_count", "image_create_time",
+               "image_destroy_count", "image_destroy_time",
+               GetTypeStats(stats, ResourceType::kImage)),
+        image_view_("image_view_create_count", "image_view_create_time",
+                    "image_view_destroy_count", "image_view_destroy_time",
+                    GetTypeStats(stats, ResourceType::kImageView)),
+        buffer_("buffer_create_count", "buffer_create_time",
+                "buffer_destroy_count", "buffer_destroy_time",
+                GetTypeStats(stats, ResourceType::kBuffer)),
+        buffer_view_("buffer_view_create_count", "buffer_view_create_time",
+                     "buffer_view_destroy_count", "buffer_view_destroy_time",
+                     GetTypeStats(stats, ResourceType::kBufferView)),
+        sampler_("sampler_create_count", "sampler_create_time",
+                 "sampler_destroy_count", "sampler_destroy_time",
+                 GetTypeStats(stats, ResourceType::kSampler)),
+        set_layout_("set_layout_create_count", "set_layout_create_time",
+                    "set_layout_destroy_count", "set_layout_destroy_time",
+                    GetTypeStats(stats, ResourceType::kDescriptorSetLayout)),
+        trace_attr_(
+            "trace_attr", "resource_creation", "i",
+            {&scope_,
+             &frame_,
+             &create_time_,
+             &destroy_time_,
+             &present_thread_time_,
+             &slow_call_count_,
+             &image_.create_count,
+             &image_.create_time,
+             &image_.destroy_count,
+             &image_.destroy_time,
+             &image_view_.create_count,
+             &image_view_.create_time,
+             &image_view_.destroy_count,
+             &image_view_.destroy_time,
+             &buffer_.create_count,
+             &buffer_.create_time,
+             &buffer_.destroy_count,
+             &buffer_.destroy_time,
+             &buffer_view_.create_count,
+             &buffer_view_.create_time,
+             &buffer_view_.destroy_count,
+             &buffer_view_.destroy_time,
+             &sampler_.create_count,
+             &sampler_.create_time,
+             &sampler_.destroy_count,
+             &sampler_.destroy_time,
+             &set_layout_.create_count,
+             &set_layout_.create_time,
+             &set_layout_.destroy_count,
+             &set_layout_.destroy_time}) {
+    InitAttributes({&frame_,
+                    &create_time_,
+                    &destroy_time_,
+                    &present_thread_time_,
+                    &slow_call_count_,
+                    &image_.create_count,
+                    &image_.create_time,
+                    &image_.destroy_count,
+                    &image_.destroy_time,
+                    &image_view_.create_count,
+                    &image_view_.create_time,
+                    &image_view_.destroy_count,
+                    &image_view_.destroy_time,
+                    &buffer_.create_count,
+                    &buffer_.create_time,
+                    &buffer_.destroy_count,
+                    &buffer_.destroy_time,
+                    &buffer_view_.create_count,
+                    &buffer_view_.create_time,
+                    &buffer_view_.destroy_count,
+                    &buffer_view_.destroy_time,
+                    &sampler_.create_count,
+                    &sampler_.create_time,
+                    &sampler_.destroy_count,
+                    &sampler_.destroy_time,
+                    &set_layout_.create_count,
+                    &set_layout_.create_time,
+                    &set_layout_.destroy_count,
+                    &set_layout_.destroy_time,
+                    &trace_attr_});
+  }
+
+ private:
+  static const ResourceTypeFrameStats& GetTypeStats(
+      const ResourceCreationFrameStats& stats, ResourceType type) {
+    return stats.types[static_cast<size_t>(type)];
+  }
+
+  static Duration GetTotalCreateTime(const ResourceCreationFrameStats& stats) {
+    int64_t total_ns = 0;
+    for (const ResourceTypeFrameStats& type : stats.types)
+      total_ns += type.create_time_ns;
+    return Duration::FromNanoseconds(total_ns);
+  }
+
+  static Duration GetTotalDestroyTime(const ResourceCreationFrameStats& stats) {
+    int64_t total_ns = 0;
+    for (const ResourceTypeFrameStats& type : stats.types)
+      total_ns += type.destroy_time_ns;
+    return Duration::FromNanoseconds(total_ns);
+  }
+
+  Int64Attr frame_;
+  DurationAttr create_time_;
+  DurationAttr destroy_time_;
+  DurationAttr present_thread_time_;
+  Int64Attr slow_call_count_;
+  ResourceTypeFrameAttrs image_;
+  ResourceTypeFrameAttrs image_view_;
+  ResourceTypeFrameAttrs buffer_;
+  ResourceTypeFrameAttrs buffer_view_;
+  ResourceTypeFrameAttrs sampler_;
+  ResourceTypeFrameAttrs set_layout_;
+  // `Perfetto` displays the args only for instant events with thread-level
+  // scope.
+  StringAttr scope_{"scope", "t"};
+  TraceEventAttr trace_attr_;
+};
+
+// A class that contains all of the data that is needed for the functions
+// that this layer will override.
+//
+// Every creation and destruction call is summed, by resource type, and the
+// calls slower than the slow call threshold are logged to the event logs. At
+// every present, the calls of the frame are logged to the layer's log file,
+// the "resource_creation.log" setting of the `LayerConfig`. The calls are
+// summed with atomics, so that threads streaming resources in at once don't
+// contend in the layer.
+class ResourceCreationLayerData : public LayerData {
+ public:
+  // Calls that take at least |slow_call_threshold| are logged individually.
+  ResourceCreationLayerData(const char* log_filename,
+                            Duration slow_call_threshold)
+      : LayerData(
+            log_filename,
+            "Frame,Create Time (ns),Destroy Time (ns),Present Thread Time "
+            "(ns),Slow Calls,Images Created,Image Create Time (ns),Images "
+            "Destroyed,Image Destroy Time (ns),Image Views Created,Image View "
+            "Create Time (ns),Image Views Destroyed,Image View Destroy Time "
+            "(ns),Buffers Created,Buffer Create Time (ns),Buffers "
+            "Destroyed,Buffer Destroy Time (ns),Buffer Views Created,Buffer "
+            "View Create Time (ns),Buffer Views Destroyed,Buffer View Destroy "
+            "Time (ns),Samplers Created,Sampler Create Time (ns),Samplers "
+            "Destroyed,Sampler Destroy Time (ns),Set Layouts Created,Set "
+            "Layout Create Time (ns),Set Layouts Destroyed,Set Layout Destroy "
+            "Time (ns)"),
+        slow_call_threshold_ns_(slow_call_threshold.ToNanoseconds()) {
+    LayerInitEvent event("resource_creation_layer_init", "resource_creation");
+    LogEvent(&event);
+    StartControl("resource_creation");
+  }
+
+  // Records the vkCreateImage call with |create_info| that returned |result|.
+  void RecordCreateImage(const VkImageCreateInfo& create_info, VkResult result,
+                         Duration duration);
+
+  // Records the vkCreateBuffer call with |create_info| that returned |result|.
+  void RecordCreateBuffer(const VkBufferCreateInfo& create_info,
+                          VkResult result, Duration duration);
+
+  // Records the call |name| creating, if |create| is set, or destroying a
+  // resource of |type|.
+  void RecordCall(const char* name, ResourceType type, bool create,
+                  VkResult result, Duration duration);
+
+  // Logs the calls of the frame that ends, and starts a new frame. The calling
+  // thread is taken to be the render thread.
+  void RecordPresent();
+
+ private:
+  // Adds the call to the frame. Returns true if the call is slow and is to be
+  // logged. Sets |present_thread| if it was made on the thread that presents.
+  bool AddCall(ResourceType type, bool create, Duration duration,
+               bool* present_thread);
+
+  const int64_t slow_call_threshold_ns_;
+
+  std::atomic<uint64_t> create_count_[kNumResourceTypes] = {};
+  std::atomic<int64_t> create_time_ns_[kNumResourceTypes] = {};
+  std::atomic<uint64_t> destroy_count_[kNumResourceTypes] = {};
+  std::atomic<int64_t> destroy_time_ns_[kNumResourceTypes] = {};
+  std::atomic<int64_t> present_thread_time_ns_ = 0;
+  std::atomic<uint64_t> slow_call_count_ = 0;
+
+  // The thread that called vkQueuePresentKHR last, 0 before the first present.
+  std::atomic<int64_t> present_thread_id_ = 0;
+  std::atomic<uint64_t> frame_ = 0;
+
+  Counter calls_metric_ =
+      MetricsRegistry::Get()->GetCounter("resource_creation_calls_total");
+  Counter slow_calls_metric_ =
+      MetricsRegistry::Get()->GetCounter("resource_creation_slow_calls_total");
+  Histogram call_time_metric_ =
+      MetricsRegistry::Get()->GetHistogram("resource_creation_call_time_us");
+};
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_RESOURCE_CREATION_LAYER_DATA_H_
@@ -20,6 +20,7 @@
 #include <string>
 
 #include "layer/support/debug_logging.h"
+#include "layer/support/layer_config.h"
 #include "layer/support/layer_utils.h"
 #include "runtime_layer_data.h"
 
@@ -42,12 +43,12 @@ constexpr uint32_t kRuntimeLayerVersion = 1;
 constexpr char kLayerName[] = STRINGIFY(LAYER_NAME);
 constexpr char kLayerDescription[] =
     "Stadia Pipeline Pipeline Runtime Measuring Layer";
-constexpr char kLogFilenameEnvVar[] = "VK_RUNTIME_LOG";
 
 performancelayers::RuntimeLayerData* GetLayerData() {
   // Don't use new -- make the destructor run when the layer gets unloaded.
   static performancelayers::RuntimeLayerData layer_data =
-      performancelayers::RuntimeLayerData(getenv(kLogFilenameEnvVar));
+      performancelayers::RuntimeLayerData(performancelayers::NullIfEmpty(
+          performancelayers::GetLayerConfig().runtime.log));
   return &layer_data;
 }
 
@@ -56,6 +57,33 @@ performancelayers::RuntimeLayerData* GetLayerData() {
   SPL_INTERCEPTED_VULKAN_FUNC(RETURN_TYPE_, RuntimeLayer_, FUNC_NAME_, \
                               FUNC_ARGS_)
 
+// The functions intercepted by the layer, defined below with
+// SPL_RUNTIME_LAYER_FUNC.
+#define SPL_RUNTIME_LAYER_FUNCS(X_, LAYER_PREFIX_)    \
+  X_(LAYER_PREFIX_, DestroyInstance)                  \
+  X_(LAYER_PREFIX_, CreateInstance)                   \
+  X_(LAYER_PREFIX_, CreateComputePipelines)           \
+  X_(LAYER_PREFIX_, CreateGraphicsPipelines)          \
+  X_(LAYER_PREFIX_, CmdBindPipeline)                  \
+  X_(LAYER_PREFIX_, CmdDispatch)                      \
+  X_(LAYER_PREFIX_, CmdDraw)                          \
+  X_(LAYER_PREFIX_, CmdDrawIndexed)                   \
+  X_(LAYER_PREFIX_, CmdDrawIndirect)                  \
+  X_(LAYER_PREFIX_, CmdDrawIndexedIndirect)           \
+  X_(LAYER_PREFIX_, DeviceWaitIdle)                   \
+  X_(LAYER_PREFIX_, QueueWaitIdle)                    \
+  X_(LAYER_PREFIX_, CreateShaderModule)               \
+  X_(LAYER_PREFIX_, DestroyShaderModule)              \
+  X_(LAYER_PREFIX_, DestroyDevice)                    \
+  X_(LAYER_PREFIX_, CreateDevice)                     \
+  X_(LAYER_PREFIX_, EnumerateInstanceLayerProperties) \
+  X_(LAYER_PREFIX_, EnumerateDeviceLayerProperties)   \
+  X_(LAYER_PREFIX_, FreeCommandBuffers)               \
+  X_(LAYER_PREFIX_, GetDeviceProcAddr)                \
+  X_(LAYER_PREFIX_, GetInstanceProcAddr)
+
+SPL_DECLARE_INTERCEPTED_FUNCTIONS(RuntimeLayer_, SPL_RUNTIME_LAYER_FUNCS);
+
 //////////////////////////////////////////////////////////////////////////////
 //  Implementation of the instance functions we want to override.
 //////////////////////////////////////////////////////////////////////////////
@@ -161,13 +189,17 @@ SPL_RUNTIME_LAYER_FUNC(void, CmdBindPipeline,
 }
 
 // Override for vkCmdDispatch.  Adds commands to write timestamps before and
-// after the dispatch command that will be added.
+// after the dispatch command that will be added, if the call is instrumented.
 SPL_RUNTIME_LAYER_FUNC(void, CmdDispatch,
                        (VkCommandBuffer command_buffer, uint32_t group_count_x,
                         uint32_t group_count_y, uint32_t group_count_z)) {
   performancelayers::RuntimeLayerData* layer_data = GetLayerData();
   auto next_proc = layer_data->GetNextDeviceProcAddr(
       command_buffer, &VkLayerDispatchTable::CmdDispatch);
+  if (!layer_data->ShouldInstrument()) {
+    next_proc(command_buffer, group_count_x, group_count_y, group_count_z);
+    return;
+  }
 
   VkQueryPool timestamp_query_pool = VK_NULL_HANDLE;
   VkQueryPool stat_query_pool = VK_NULL_HANDLE;
@@ -217,12 +249,18 @@ SPL_RUNTIME_LAYER_FUNC(void, CmdDispatch,
   (end_query_function)(command_buffer, stat_query_pool, /*queryIndex=*/0);
 }
 
+// Calls the next layer's |func_ptr|, surrounded by commands to write
+// timestamps and pipeline statistics if the call is instrumented.
 template <typename TFuncPtr, typename... Args>
 static void WrapCallWithTimestamp(TFuncPtr func_ptr,
                                   VkCommandBuffer command_buffer,
                                   Args&&... args) {
   performancelayers::RuntimeLayerData* layer_data = GetLayerData();
   auto next_proc = layer_data->GetNextDeviceProcAddr(command_buffer, func_ptr);
+  if (!layer_data->ShouldInstrument()) {
+    next_proc(command_buffer, std::forward<Args>(args)...);
+    return;
+  }
 
   VkQueryPool timestamp_query_pool = VK_NULL_HANDLE;
   VkQueryPool stat_query_pool = VK_NULL_HANDLE;
@@ -452,6 +490,8 @@ SPL_RUNTIME_LAYER_FUNC(void, FreeCommandBuffers,
 
 }  // namespace
 
+SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE(RuntimeLayer_, SPL_RUNTIME_LAYER_FUNCS);
+
 // The *GetProcAddr functions are the entry points to the layers.
 // They return a function pointer for the instance requested by |name|.  We
 // return the functions defined in this layer for those we want to override.
@@ -462,26 +502,32 @@ SPL_LAYER_ENTRY_POINT SPL_RUNTIME_LAYER_FUNC(PFN_vkVoidFunction,
                                              GetDeviceProcAddr,
                                              (VkDevice device,
                                               const char* name)) {
-  if (auto func =
-          performancelayers::FunctionInterceptor::GetInterceptedOrNull(name)) {
-    return func;
-  }
-
   performancelayers::RuntimeLayerData* layer_data = GetLayerData();
 
   PFN_vkGetDeviceProcAddr next_get_proc_addr =
       layer_data->GetNextDeviceProcAddr(
           device, &VkLayerDispatchTable::GetDeviceProcAddr);
   assert(next_get_proc_addr && next_get_proc_addr != VK_NULL_HANDLE);
-  return next_get_proc_addr(device, name);
+  // The functions of the features and extensions that the device didn't
+  // enable are null down the chain, and must stay null.
+  PFN_vkVoidFunction next_func = next_get_proc_addr(device, name);
+  if (!next_func) return nullptr;
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(RuntimeLayer_, name)) {
+    return func;
+  }
+  return next_func;
 }
 
 SPL_LAYER_ENTRY_POINT SPL_RUNTIME_LAYER_FUNC(PFN_vkVoidFunction,
                                              GetInstanceProcAddr,
                                              (VkInstance instance,
                                               const char* name)) {
-  if (auto func =
-          performancelayers::FunctionInterceptor::GetInterceptedOrNull(name)) {
+  // The loader looks up the layer's functions here first, before calling any
+  // of them.
+  if (performancelayers::IsLayerOverheadProfilingEnabled()) {
+    GetLayerData()->SetOverheadProfiler(&RuntimeLayer_kOverheadProfiler);
+  }
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(RuntimeLayer_, name)) {
     return func;
   }
 
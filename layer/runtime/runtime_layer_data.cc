@@ -141,6 +141,9 @@ void RuntimeLayerData::LogAndRemoveQueryPools() {
                          Duration::FromNanoseconds(timestamp1 - timestamp0),
                          invocations[0], invocations[1]);
       LogEvent(&event);
+      pipeline_executions_metric_.Add();
+      pipeline_gpu_time_metric_.Record(
+          static_cast<int64_t>(timestamp1 - timestamp0) / 1000);
     }
 
     (destroy_query_pool_function)(device, info->timestamp_pool, nullptr);
@@ -20,6 +20,7 @@
 #include "layer/support/event_logging.h"
 #include "layer/support/layer_data.h"
 #include "layer/support/layer_utils.h"
+#include "layer/support/metrics.h"
 
 namespace performancelayers {
 class RuntimeEvent : public Event {
@@ -65,12 +66,13 @@ class RuntimeLayerData : public LayerData {
   };
 
  public:
-  explicit RuntimeLayerData(char* log_filename)
+  explicit RuntimeLayerData(const char* log_filename)
       : LayerData(log_filename,
                   "Pipeline,Run Time (ns),Fragment Shader Invocations,Compute "
                   "Shader Invocations") {
     LayerInitEvent event("runtime_layer_init", "runtime_layer");
     LogEvent(&event);
+    StartControl("runtime");
   }
 
   // Records |pipeline| as the latest pipeline that has been bound to
@@ -118,6 +120,11 @@ class RuntimeLayerData : public LayerData {
   // pipelines.
   std::vector<QueryInfo> timestamp_queries_
       ABSL_GUARDED_BY(timestamp_queries_lock_);
+
+  Counter pipeline_executions_metric_ =
+      MetricsRegistry::Get()->GetCounter("runtime_pipeline_executions_total");
+  Histogram pipeline_gpu_time_metric_ =
+      MetricsRegistry::Get()->GetHistogram("runtime_pipeline_gpu_time_us");
 };
 
 }  // namespace performancelayers
@@ -0,0 +1,119 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/support/call_site_profiler.h"
+
+#include <dlfcn.h>
+#include <execinfo.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+
+namespace performancelayers {
+
+CallSiteProfiler::CallSiteProfiler(uint64_t sample_period, size_t skip_frames)
+    : sample_period_(sample_period), skip_frames_(skip_frames) {
+  nodes_.emplace_back();
+}
+
+CallSiteProfiler::StackId CallSiteProfiler::Record(uint64_t weight) {
+  if (sample_period_ == 0 || weight == 0) return kNoStack;
+  const uint64_t before =
+      total_weight_.fetch_add(weight, std::memory_order_relaxed);
+  const uint64_t periods =
+      (before + weight) / sample_period_ - before / sample_period_;
+  if (periods == 0) return kNoStack;
+
+  // One extra frame for this function.
+  constexpr size_t kMaxCapturedFrames = kMaxFrames + 16;
+  void* frames[kMaxCapturedFrames];
+  const size_t skip = skip_frames_ + 1;
+  const int captured = backtrace(frames, kMaxCapturedFrames);
+  if (captured <= 0 || static_cast<size_t>(captured) <= skip) return kNoStack;
+  const size_t frame_count =
+      std::min(static_cast<size_t>(captured) - skip, kMaxFrames);
+  return AddStack(frames + skip, frame_count, periods * sample_period_);
+}
+
+CallSiteProfiler::StackId CallSiteProfiler::AddStack(void* const* frames,
+                                                     size_t frame_count,
+                                                     uint64_t weight) {
+  absl::MutexLock lock(&lock_);
+  StackId node = kNoStack;
+  // Walk from the outermost frame, so that stacks share their common callers.
+  for (size_t i = frame_count; i != 0; --i) {
+    void* address = frames[i - 1];
+    auto [it, inserted] = children_.try_emplace({node, address}, 0);
+    if (inserted) {
+      it->second = static_cast<StackId>(nodes_.size());
+      nodes_.push_back({node, address, 0});
+    }
+    node = it->second;
+  }
+  nodes_[node].weight += weight;
+  return node;
+}
+
+std::string CallSiteProfiler::GetFoldedStack(StackId stack) const {
+  absl::ReaderMutexLock lock(&lock_);
+  return GetFoldedStackLocked(stack);
+}
+
+void CallSiteProfiler::WriteFoldedStacks(LogOutput* out) const {
+  assert(out);
+  absl::ReaderMutexLock lock(&lock_);
+  for (StackId stack = 1; stack < nodes_.size(); ++stack) {
+    if (nodes_[stack].weight == 0) continue;
+    out->LogLine(
+        absl::StrCat(GetFoldedStackLocked(stack), " ", nodes_[stack].weight));
+  }
+  out->Flush();
+}
+
+std::string CallSiteProfiler::GetFoldedStackLocked(StackId stack) const {
+  assert(stack < nodes_.size());
+  std::vector<void*> addresses;
+  for (StackId node = stack; node != kNoStack; node = nodes_[node].parent)
+    addresses.push_back(nodes_[node].address);
+
+  std::string folded;
+  for (auto it = addresses.rbegin(); it != addresses.rend(); ++it) {
+    if (!folded.empty()) folded += ';';
+    folded += FormatFrame(*it);
+  }
+  return folded;
+}
+
+std::string CallSiteProfiler::FormatFrame(void* address) {
+  Dl_info info = {};
+  if (dladdr(address, &info) == 0 || !info.dli_fname || !info.dli_fbase)
+    return absl::StrFormat("%p", address);
+
+  std::string_view module = info.dli_fname;
+  if (size_t slash = module.rfind('/'); slash != std::string_view::npos)
+    module.remove_prefix(slash + 1);
+  const uintptr_t offset = reinterpret_cast<uintptr_t>(address) -
+                           reinterpret_cast<uintptr_t>(info.dli_fbase);
+  return absl::StrFormat("%s+0x%x", module, offset);
+}
+
+}  // namespace performancelayers
@@ -0,0 +1,113 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_CALL_SITE_PROFILER_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_CALL_SITE_PROFILER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/attributes.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "layer/support/log_output.h"
+
+namespace performancelayers {
+// Attributes the weight of a hot call, e.g., the bytes of vkAllocateMemory or
+// the time spent in vkCreateGraphicsPipelines, to the application call stacks
+// making it.
+//
+// Capturing a stack is expensive, so only a sample is taken: every time the
+// total recorded weight crosses a multiple of the sample period, the current
+// stack is captured with `backtrace()` and charged with the weight of the
+// periods crossed. Weight that doesn't cross a period boundary costs a single
+// atomic add.
+//
+// Stacks are interned in a trie keyed by return addresses, so a stack is stored
+// once no matter how often it is sampled, and stacks sharing their outer
+// frames share their nodes. The stacks are written in the folded format of
+// flame graph tools, one line per stack: "frame;frame;frame weight", outermost
+// frame first. Frames are written as "module+0xoffset" and are meant to be
+// symbolized offline, e.g., with `addr2line`. The offsets are return
+// addresses, which point just after the call instruction.
+class CallSiteProfiler {
+ public:
+  // Identifies an interned stack. |kNoStack| is the empty stack.
+  using StackId = uint32_t;
+  static constexpr StackId kNoStack = 0;
+
+  // Deeper stacks are truncated to their innermost frames.
+  static constexpr size_t kMaxFrames = 64;
+
+  // Samples a stack every |sample_period| units of weight. 0 disables the
+  // profiler. |skip_frames| is the number of innermost frames to drop from
+  // every captured stack, in addition to the profiler's own, so that the
+  // layer's frames don't show up in the output.
+  CallSiteProfiler(uint64_t sample_period, size_t skip_frames);
+
+  CallSiteProfiler(const CallSiteProfiler&) = delete;
+  CallSiteProfiler& operator=(const CallSiteProfiler&) = delete;
+
+  bool IsEnabled() const { return sample_period_ != 0; }
+
+  // Records a call of |weight| units. Returns the id of the current stack if
+  // the call was sampled, and |kNoStack| otherwise. Thread-safe.
+  ABSL_ATTRIBUTE_NOINLINE StackId Record(uint64_t weight);
+
+  // Interns the stack of |frame_count| return addresses in |frames|, innermost
+  // first, and charges it with |weight|. Returns the id of the stack.
+  StackId AddStack(void* const* frames, size_t frame_count, uint64_t weight);
+
+  // Returns the frames of |stack| in the folded format, outermost first,
+  // without the weight. Returns an empty string for |kNoStack|.
+  std::string GetFoldedStack(StackId stack) const;
+
+  // Writes every stack that was charged with some weight, one line per stack.
+  void WriteFoldedStacks(LogOutput* out) const;
+
+ private:
+  struct Node {
+    StackId parent = kNoStack;
+    void* address = nullptr;
+    // The weight charged to the stack ending at this node.
+    uint64_t weight = 0;
+  };
+
+  // Returns the frame at |address| as "module+0xoffset", or as a plain
+  // address if it is not in a loaded module.
+  static std::string FormatFrame(void* address);
+
+  std::string GetFoldedStackLocked(StackId stack) const
+      ABSL_SHARED_LOCKS_REQUIRED(lock_);
+
+  const uint64_t sample_period_;
+  const size_t skip_frames_;
+  std::atomic<uint64_t> total_weight_ = 0;
+
+  mutable absl::Mutex lock_;
+  // The trie nodes, indexed by stack id. Node 0 is the root, the empty stack.
+  std::vector<Node> nodes_ ABSL_GUARDED_BY(lock_);
+  // The map from a node and the return address of a callee to the callee's
+  // node.
+  absl::flat_hash_map<std::pair<StackId, void*>, StackId> children_
+      ABSL_GUARDED_BY(lock_);
+};
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_CALL_SITE_PROFILER_H_
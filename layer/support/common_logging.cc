@@ -28,6 +28,12 @@ std::string EventToCommonLogStr(Event &event) {
   csv_str << event.GetEventName() << "," << event.GetCreationTime().GetName()
           << ":" << ValueToCSVString(event.GetCreationTime().GetValue());
   for (Attribute *attribute : attributes) {
+    // The arguments of the trace event are attributes of the event already, so
+    // only the thread that logged it is added.
+    if (const auto *trace_attr = attribute->cast<TraceEventAttr>()) {
+      csv_str << ",tid:" << ValueToCSVString(trace_attr->GetTid().GetValue());
+      continue;
+    }
     csv_str << "," << attribute->GetName() << ":";
     switch (attribute->GetValueType()) {
       case ValueType::kHashAttribute: {
@@ -62,6 +68,7 @@ std::string EventToCommonLogStr(Event &event) {
         break;
       }
       case ValueType::kTraceEvent:
+        // Logged as its thread above.
         break;
     }
   }
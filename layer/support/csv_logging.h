@@ -42,8 +42,8 @@ std::string EventToCSVString(Event &event);
 
 // CSVLogger logs the events in the CSV format to the output given in its
 // constructor. There is no need to add '\n' at the end of the csv_header in the
-// constructor. This is handled by the implementation. The only valid method
-// after calling `EndLog()` is `EndLog()`.
+// constructor. This is handled by the implementation. A null csv_header writes
+// no header. The only valid method after calling `EndLog()` is `EndLog()`.
 class CSVLogger : public EventLogger {
  public:
   CSVLogger(const char *csv_header, LogOutput *out)
@@ -55,10 +55,10 @@ class CSVLogger : public EventLogger {
     out_->LogLine(event_str);
   }
 
-  // Writes the CSV header given in the constructor to the output.
+  // Writes the CSV header given in the constructor to the output, if any.
   void StartLog() override {
     assert(out_);
-    out_->LogLine(header_);
+    if (header_) out_->LogLine(header_);
   }
 
   void EndLog() override {}
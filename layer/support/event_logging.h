@@ -294,6 +294,38 @@ class CreateGraphicsPipelinesEvent : public Event {
   DurationAttr duration_;
 };
 
+// Reports the time a layer spent in its own code in one of its intercepted
+// functions, or in all of them for the function "all", since the previous
+// report or, for an end-of-run report, in the whole run. |frame_time_ppm| is
+// the fraction of the wall time spent in the layer, in parts per million. See
+// `LayerOverheadProfiler`.
+class LayerOverheadEvent : public Event {
+ public:
+  LayerOverheadEvent(const std::string &layer, const std::string &function,
+                     bool end_of_run, int64_t calls, Duration total_time,
+                     Duration max_time, int64_t frame_time_ppm)
+      : Event("layer_overhead", LogLevel::kLow),
+        layer_("layer", layer),
+        function_("function", function),
+        end_of_run_("end_of_run", end_of_run),
+        calls_("calls", calls),
+        total_time_("total_time", total_time),
+        max_time_("max_time", max_time),
+        frame_time_ppm_("frame_time_ppm", frame_time_ppm) {
+    InitAttributes({&layer_, &function_, &end_of_run_, &calls_, &total_time_,
+                    &max_time_, &frame_time_ppm_});
+  }
+
+ private:
+  StringAttr layer_;
+  StringAttr function_;
+  BoolAttr end_of_run_;
+  Int64Attr calls_;
+  DurationAttr total_time_;
+  DurationAttr max_time_;
+  Int64Attr frame_time_ppm_;
+};
+
 // EventLogger base class
 //
 // EventLogger provides an abstraction for the concrete loggers that log the
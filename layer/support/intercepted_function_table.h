@@ -0,0 +1,150 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_INTERCEPTED_FUNCTION_TABLE_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_INTERCEPTED_FUNCTION_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace performancelayers {
+
+namespace detail {
+// Returns the 8 bytes at |data| as a little-endian integer. Spelled out byte
+// by byte so that it can be evaluated at compile time, in a form compilers
+// turn into a single load.
+constexpr uint64_t LoadWord(const char* data) {
+  auto byte = [data](int i) {
+    return uint64_t{static_cast<uint8_t>(data[i])} << (8 * i);
+  };
+  return byte(0) | byte(1) | byte(2) | byte(3) | byte(4) | byte(5) | byte(6) |
+         byte(7);
+}
+
+// Hashes |name| with |seed|. Names of at least 8 characters, i.e., all Vulkan
+// function names, are hashed by their length and their first and last 8
+// characters, which tell apart the names of a layer without a pass over every
+// character. Shorter names take a seeded FNV-1a pass instead. The result is
+// mixed so that its low bits, which select the slot, depend on all the input.
+constexpr uint32_t HashFunctionName(std::string_view name, uint32_t seed) {
+  uint64_t hash = seed;
+  if (name.size() >= 8) {
+    hash ^= LoadWord(name.data()) * 0x9e3779b97f4a7c15u;
+    hash ^= LoadWord(name.data() + name.size() - 8) * 0xc2b2ae3d27d4eb4fu;
+  } else {
+    hash ^= 14695981039346656037u;
+    for (char c : name) {
+      hash ^= static_cast<uint8_t>(c);
+      hash *= 1099511628211u;
+    }
+  }
+  hash ^= name.size();
+  hash ^= hash >> 29;
+  hash *= 0xbf58476d1ce4e5b9u;
+  hash ^= hash >> 32;
+  return static_cast<uint32_t>(hash);
+}
+
+// Returns the smallest power of two that is at least 8 * |num_names|. With
+// that many slots a collision-free seed is found after a few attempts.
+constexpr size_t GetNumSlots(size_t num_names) {
+  size_t num_slots = 16;
+  while (num_slots < 8 * num_names) num_slots *= 2;
+  return num_slots;
+}
+}  // namespace detail
+
+// A perfect hash table over a fixed set of Vulkan function names, built at
+// compile time. Maps a name to its index in the set, so that a parallel array
+// can hold the function intercepting it.
+//
+// The constructor searches for a hash seed under which no two names share a
+// slot. A lookup is then one hash of the name, one slot load, and one string
+// comparison against the only candidate name. Empty slots refer to an extra
+// index, |kNotFound|, whose name is empty, so that a parallel array of
+// N + 1 elements ending with a null entry can be indexed without branching on
+// the result.
+//
+// Sample use:
+//   constexpr std::string_view kNames[] = {"vkCreateDevice",
+//                                          "vkDestroyDevice"};
+//   constexpr InterceptedFunctionTable kTable(kNames);
+//   static_assert(kTable.IsValid(), "Duplicate names");
+//   size_t index = kTable.Find("vkDestroyDevice");  // 1
+template <size_t N>
+class InterceptedFunctionTable {
+ public:
+  static constexpr size_t kNotFound = N;
+  static constexpr size_t kNumSlots = detail::GetNumSlots(N);
+  static_assert(N < UINT16_MAX, "Too many intercepted functions");
+
+  constexpr explicit InterceptedFunctionTable(
+      const std::string_view (&names)[N]) {
+    for (size_t i = 0; i != N; ++i) names_[i] = names[i];
+    names_[N] = "";
+    // Duplicate names never hash to distinct slots, so give up after a bounded
+    // number of attempts and leave the table invalid.
+    constexpr uint32_t kMaxSeeds = 1 << 12;
+    for (uint32_t seed = 0; seed != kMaxSeeds; ++seed) {
+      if (TryBuild(seed)) {
+        seed_ = seed;
+        valid_ = true;
+        return;
+      }
+    }
+  }
+
+  // Returns false if no perfect hash was found, i.e., if the names are not
+  // distinct.
+  constexpr bool IsValid() const { return valid_; }
+
+  // Returns the index of |name| in the names the table was built from, or
+  // |kNotFound|.
+  constexpr size_t Find(std::string_view name) const {
+    const size_t index =
+        slots_[detail::HashFunctionName(name, seed_) & (kNumSlots - 1)];
+    return names_[index] == name ? index : kNotFound;
+  }
+
+  // Returns true if |name| is in the names the table was built from.
+  constexpr bool Contains(std::string_view name) const {
+    return Find(name) != kNotFound;
+  }
+
+ private:
+  // Fills the slots using |seed|. Returns false on a collision.
+  constexpr bool TryBuild(uint32_t seed) {
+    for (size_t slot = 0; slot != kNumSlots; ++slot) slots_[slot] = kNotFound;
+    for (size_t i = 0; i != N; ++i) {
+      const size_t slot =
+          detail::HashFunctionName(names_[i], seed) & (kNumSlots - 1);
+      if (slots_[slot] != kNotFound) return false;
+      slots_[slot] = static_cast<uint16_t>(i);
+    }
+    return true;
+  }
+
+  // The names, followed by the empty name at |kNotFound|. Intercepted names
+  // are never empty, so only an empty query can match it, and |kNotFound| is
+  // the right answer for that one too.
+  std::string_view names_[N + 1] = {};
+  uint16_t slots_[kNumSlots] = {};
+  uint32_t seed_ = 0;
+  bool valid_ = false;
+};
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_INTERCEPTED_FUNCTION_TABLE_H_
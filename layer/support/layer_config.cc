@@ -0,0 +1,386 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/support/layer_config.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <type_traits>
+#include <variant>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "layer/support/debug_logging.h"
+
+namespace performancelayers {
+namespace {
+constexpr char kConfigFileEnvVar[] = "VK_PERFORMANCE_LAYERS_CONFIG";
+constexpr char kProfileEnvVar[] = "VK_PERFORMANCE_LAYERS_PROFILE";
+constexpr char kProfileKey[] = "profile";
+
+// The field of a setting in a `LayerConfig`.
+using SettingRef = std::variant<std::string*, uint64_t*, uint32_t*, bool*,
+                                InstrumentationMode*>;
+
+struct Setting {
+  LayerConfigKey key;
+  SettingRef (*get_field)(LayerConfig*);
+};
+
+#define SPL_CONFIG_SETTING(KEY_, ENV_VAR_, FIELD_) \
+  Setting {                                        \
+    {KEY_, ENV_VAR_}, [](LayerConfig* config) {    \
+      return SettingRef(&config->FIELD_);          \
+    }                                              \
+  }
+
+// The settings of each module with an instrumentation mode.
+#define SPL_CONFIG_MODULE_SETTINGS(MODULE_, ENV_PREFIX_)                    \
+  SPL_CONFIG_SETTING(#MODULE_ ".mode", ENV_PREFIX_ "_MODE",                 \
+                     MODULE_.module.mode),                                  \
+      SPL_CONFIG_SETTING(#MODULE_ ".sampling_period",                       \
+                         ENV_PREFIX_ "_SAMPLING_PERIOD",                    \
+                         MODULE_.module.sampling_period)
+
+const std::vector<Setting>& GetSettings() {
+  static const auto* settings = new std::vector<Setting>{
+      SPL_CONFIG_SETTING("common.event_log_file",
+                         "VK_PERFORMANCE_LAYERS_EVENT_LOG_FILE",
+                         common.event_log_file),
+      SPL_CONFIG_SETTING("common.trace_event_log_file",
+                         "VK_PERFORMANCE_LAYERS_TRACE_EVENT_LOG_FILE",
+                         common.trace_event_log_file),
+      SPL_CONFIG_SETTING("common.flush_every_event",
+                         "VK_PERFORMANCE_LAYERS_FLUSH_EVERY_EVENT",
+                         common.flush_every_event),
+      SPL_CONFIG_SETTING("common.modules", "VK_PERFORMANCE_LAYERS_MODULES",
+                         common.modules),
+      SPL_CONFIG_SETTING("common.control_file",
+                         "VK_PERFORMANCE_LAYERS_CONTROL_FILE",
+                         common.control_file),
+      SPL_CONFIG_SETTING("common.control_poll_ms",
+                         "VK_PERFORMANCE_LAYERS_CONTROL_POLL_MS",
+                         common.control_poll_ms),
+      SPL_CONFIG_SETTING("common.metrics_shm",
+                         "VK_PERFORMANCE_LAYERS_METRICS_SHM",
+                         common.metrics_shm),
+      SPL_CONFIG_SETTING("common.metrics_socket",
+                         "VK_PERFORMANCE_LAYERS_METRICS_SOCKET",
+                         common.metrics_socket),
+      SPL_CONFIG_SETTING("common.metrics_period_ms",
+                         "VK_PERFORMANCE_LAYERS_METRICS_PERIOD_MS",
+                         common.metrics_period_ms),
+      SPL_CONFIG_SETTING("common.overhead_profiling",
+                         "VK_PERFORMANCE_LAYERS_OVERHEAD_PROFILING",
+                         common.overhead_profiling),
+      SPL_CONFIG_SETTING("common.overhead_report_period_ms",
+                         "VK_PERFORMANCE_LAYERS_OVERHEAD_REPORT_PERIOD_MS",
+                         common.overhead_report_period_ms),
+
+      SPL_CONFIG_SETTING("frame_time.log", "VK_FRAME_TIME_LOG",
+                         frame_time.log),
+      SPL_CONFIG_SETTING("frame_time.exit_after_frame",
+                         "VK_FRAME_TIME_EXIT_AFTER_FRAME",
+                         frame_time.exit_after_frame),
+      SPL_CONFIG_SETTING("frame_time.finish_file", "VK_FRAME_TIME_FINISH_FILE",
+                         frame_time.finish_file),
+      SPL_CONFIG_SETTING("frame_time.benchmark_watch_file",
+                         "VK_FRAME_TIME_BENCHMARK_WATCH_FILE",
+                         frame_time.benchmark_watch_file),
+      SPL_CONFIG_SETTING("frame_time.benchmark_start_string",
+                         "VK_FRAME_TIME_BENCHMARK_START_STRING",
+                         frame_time.benchmark_start_string),
+      SPL_CONFIG_MODULE_SETTINGS(frame_time, "VK_FRAME_TIME"),
+
+      SPL_CONFIG_SETTING("compile_time.log", "VK_COMPILE_TIME_LOG",
+                         compile_time.log),
+      SPL_CONFIG_SETTING("compile_time.call_site_sample_us",
+                         "VK_COMPILE_TIME_CALL_SITE_SAMPLE_US",
+                         compile_time.call_site_sample_us),
+      SPL_CONFIG_SETTING("compile_time.call_site_log",
+                         "VK_COMPILE_TIME_CALL_SITE_LOG",
+                         compile_time.call_site_log),
+      SPL_CONFIG_MODULE_SETTINGS(compile_time, "VK_COMPILE_TIME"),
+
+      SPL_CONFIG_SETTING("runtime.log", "VK_RUNTIME_LOG", runtime.log),
+      SPL_CONFIG_MODULE_SETTINGS(runtime, "VK_RUNTIME"),
+
+      SPL_CONFIG_SETTING("memory_usage.log", "VK_MEMORY_USAGE_LOG",
+                         memory_usage.log),
+      SPL_CONFIG_SETTING("memory_usage.report_frames",
+                         "VK_MEMORY_USAGE_REPORT_FRAMES",
+                         memory_usage.report_frames),
+      SPL_CONFIG_SETTING("memory_usage.churn_window_frames",
+                         "VK_MEMORY_USAGE_CHURN_WINDOW_FRAMES",
+                         memory_usage.churn_window_frames),
+      SPL_CONFIG_SETTING("memory_usage.short_lived_frames",
+                         "VK_MEMORY_USAGE_SHORT_LIVED_FRAMES",
+                         memory_usage.short_lived_frames),
+      SPL_CONFIG_SETTING("memory_usage.slow_call_us",
+                         "VK_MEMORY_USAGE_SLOW_CALL_US",
+                         memory_usage.slow_call_us),
+      SPL_CONFIG_SETTING("memory_usage.snapshot_frames",
+                         "VK_MEMORY_USAGE_SNAPSHOT_FRAMES",
+                         memory_usage.snapshot_frames),
+      SPL_CONFIG_SETTING("memory_usage.host_report_frames",
+                         "VK_MEMORY_USAGE_HOST_REPORT_FRAMES",
+                         memory_usage.host_report_frames),
+      SPL_CONFIG_SETTING("memory_usage.call_site_sample_bytes",
+                         "VK_MEMORY_USAGE_CALL_SITE_SAMPLE_BYTES",
+                         memory_usage.call_site_sample_bytes),
+      SPL_CONFIG_SETTING("memory_usage.call_site_log",
+                         "VK_MEMORY_USAGE_CALL_SITE_LOG",
+                         memory_usage.call_site_log),
+      SPL_CONFIG_MODULE_SETTINGS(memory_usage, "VK_MEMORY_USAGE"),
+
+      SPL_CONFIG_SETTING("cache_sideload.file",
+                         "VK_PIPELINE_CACHE_SIDELOAD_FILE",
+                         cache_sideload.file),
+
+      SPL_CONFIG_SETTING("queue_submit.log", "VK_QUEUE_SUBMIT_LOG",
+                         queue_submit.log),
+      SPL_CONFIG_MODULE_SETTINGS(queue_submit, "VK_QUEUE_SUBMIT"),
+
+      SPL_CONFIG_SETTING("sync_wait.log", "VK_SYNC_WAIT_LOG", sync_wait.log),
+      SPL_CONFIG_MODULE_SETTINGS(sync_wait, "VK_SYNC_WAIT"),
+
+      SPL_CONFIG_SETTING("command_recording.log", "VK_COMMAND_RECORDING_LOG",
+                         command_recording.log),
+      SPL_CONFIG_MODULE_SETTINGS(command_recording, "VK_COMMAND_RECORDING"),
+
+      SPL_CONFIG_SETTING("descriptor.log", "VK_DESCRIPTOR_LOG", descriptor.log),
+      SPL_CONFIG_SETTING("descriptor.call_site_sample_us",
+                         "VK_DESCRIPTOR_CALL_SITE_SAMPLE_US",
+                         descriptor.call_site_sample_us),
+      SPL_CONFIG_SETTING("descriptor.call_site_log",
+                         "VK_DESCRIPTOR_CALL_SITE_LOG",
+                         descriptor.call_site_log),
+      SPL_CONFIG_MODULE_SETTINGS(descriptor, "VK_DESCRIPTOR"),
+
+      SPL_CONFIG_SETTING("resource_creation.log", "VK_RESOURCE_CREATION_LOG",
+                         resource_creation.log),
+      SPL_CONFIG_SETTING("resource_creation.slow_call_us",
+                         "VK_RESOURCE_CREATION_SLOW_CALL_US",
+                         resource_creation.slow_call_us),
+      SPL_CONFIG_MODULE_SETTINGS(resource_creation, "VK_RESOURCE_CREATION"),
+  };
+  return *settings;
+}
+
+#undef SPL_CONFIG_MODULE_SETTINGS
+#undef SPL_CONFIG_SETTING
+
+const Setting* FindSetting(absl::string_view key) {
+  for (const Setting& setting : GetSettings()) {
+    if (key == setting.key.key) return &setting;
+  }
+  return nullptr;
+}
+
+// Sets |field| to |value|. Returns false if |value| is not valid for the
+// field, which is left unchanged.
+bool SetField(SettingRef field, absl::string_view value) {
+  if (auto* str = std::get_if<std::string*>(&field)) {
+    **str = std::string(value);
+    return true;
+  }
+  if (auto* mode_field = std::get_if<InstrumentationMode*>(&field)) {
+    std::optional<InstrumentationMode> mode = ParseInstrumentationMode(value);
+    if (mode) **mode_field = *mode;
+    return mode.has_value();
+  }
+  // The absl parsers clobber their output on failure.
+  return std::visit(
+      [value](auto* typed_field) {
+        auto parsed = *typed_field;
+        bool valid = false;
+        if constexpr (std::is_same_v<decltype(parsed), bool>) {
+          valid = absl::SimpleAtob(value, &parsed);
+        } else if constexpr (std::is_integral_v<decltype(parsed)>) {
+          valid = absl::SimpleAtoi(value, &parsed);
+        }
+        if (valid) *typed_field = parsed;
+        return valid;
+      },
+      field);
+}
+
+// A "key = value" line of the config file.
+struct ConfigLine {
+  size_t line_number = 0;
+  std::string key;
+  std::string value;
+};
+
+// The settings of the config file, by section. The settings before the first
+// section are in the section "".
+using ConfigSections =
+    std::vector<std::pair<std::string, std::vector<ConfigLine>>>;
+
+ConfigSections SplitConfigFile(absl::string_view contents,
+                               std::vector<std::string>* problems) {
+  ConfigSections sections = {{"", {}}};
+  size_t line_number = 0;
+  for (absl::string_view line : absl::StrSplit(contents, '\n')) {
+    ++line_number;
+    line = absl::StripAsciiWhitespace(line);
+    if (line.empty() || line[0] == '#' || line[0] == ';') continue;
+
+    if (line.front() == '[') {
+      if (line.back() != ']' || line.size() == 2) {
+        problems->push_back(
+            absl::StrCat("line ", line_number, ": malformed section: ", line));
+        continue;
+      }
+      const absl::string_view name = line.substr(1, line.size() - 2);
+      sections.emplace_back(std::string(absl::StripAsciiWhitespace(name)),
+                            std::vector<ConfigLine>());
+      continue;
+    }
+
+    const size_t equals = line.find('=');
+    if (equals == absl::string_view::npos) {
+      problems->push_back(absl::StrCat("line ", line_number,
+                                       ": expected 'key = value': ", line));
+      continue;
+    }
+    sections.back().second.push_back(
+        {line_number,
+         std::string(absl::StripAsciiWhitespace(line.substr(0, equals))),
+         std::string(absl::StripAsciiWhitespace(line.substr(equals + 1)))});
+  }
+  return sections;
+}
+
+std::vector<std::string> LoadLayerConfig(LayerConfig* config) {
+  std::vector<std::string> problems;
+  const char* config_filename = getenv(kConfigFileEnvVar);
+  if (config_filename && *config_filename) {
+    std::ifstream file(config_filename);
+    if (file.good()) {
+      std::stringstream contents;
+      contents << file.rdbuf();
+      const char* profile = getenv(kProfileEnvVar);
+      for (std::string& problem : ApplyLayerConfigFile(
+               contents.str(), profile ? profile : "", config)) {
+        problems.push_back(absl::StrCat(config_filename, ": ", problem));
+      }
+    } else {
+      problems.push_back(absl::StrCat("Cannot read ", config_filename));
+    }
+  }
+
+  std::vector<std::string> env_var_problems =
+      ApplyLayerConfigEnvVars(getenv, config);
+  problems.insert(problems.end(), env_var_problems.begin(),
+                  env_var_problems.end());
+  return problems;
+}
+}  // namespace
+
+const ModuleConfig* LayerConfig::GetModuleConfig(
+    absl::string_view module_name) const {
+  if (module_name == "frame_time") return &frame_time.module;
+  if (module_name == "compile_time") return &compile_time.module;
+  if (module_name == "runtime") return &runtime.module;
+  if (module_name == "memory_usage") return &memory_usage.module;
+  if (module_name == "queue_submit") return &queue_submit.module;
+  if (module_name == "sync_wait") return &sync_wait.module;
+  if (module_name == "command_recording") return &command_recording.module;
+  if (module_name == "descriptor") return &descriptor.module;
+  if (module_name == "resource_creation") return &resource_creation.module;
+  return nullptr;
+}
+
+std::vector<LayerConfigKey> GetLayerConfigKeys() {
+  std::vector<LayerConfigKey> keys;
+  for (const Setting& setting : GetSettings()) keys.push_back(setting.key);
+  return keys;
+}
+
+std::vector<std::string> ApplyLayerConfigFile(absl::string_view contents,
+                                              absl::string_view profile,
+                                              LayerConfig* config) {
+  assert(config);
+  std::vector<std::string> problems;
+  const ConfigSections sections = SplitConfigFile(contents, &problems);
+
+  std::string selected_profile(profile);
+  if (selected_profile.empty()) {
+    for (const ConfigLine& line : sections.front().second) {
+      if (line.key == kProfileKey) selected_profile = line.value;
+    }
+  }
+  bool found_profile = selected_profile.empty();
+
+  for (const auto& [section, lines] : sections) {
+    const bool applied = section.empty() || section == selected_profile;
+    found_profile |= !section.empty() && applied;
+    for (const ConfigLine& line : lines) {
+      if (section.empty() && line.key == kProfileKey) continue;
+      const Setting* setting = FindSetting(line.key);
+      if (!setting) {
+        problems.push_back(absl::StrCat("line ", line.line_number,
+                                        ": unknown key: ", line.key));
+        continue;
+      }
+      // Check the profiles that are not applied as well, so that their
+      // mistakes show up before they are used.
+      LayerConfig unused;
+      if (!SetField(setting->get_field(applied ? config : &unused),
+                    line.value)) {
+        problems.push_back(absl::StrCat("line ", line.line_number,
+                                        ": invalid value for ", line.key, ": ",
+                                        line.value));
+      }
+    }
+  }
+
+  if (!found_profile)
+    problems.push_back(absl::StrCat("unknown profile: ", selected_profile));
+  return problems;
+}
+
+std::vector<std::string> ApplyLayerConfigEnvVars(
+    const std::function<const char*(const char*)>& get_env_var,
+    LayerConfig* config) {
+  assert(config);
+  std::vector<std::string> problems;
+  for (const Setting& setting : GetSettings()) {
+    const char* value = get_env_var(setting.key.env_var);
+    if (!value || !*value) continue;
+    if (!SetField(setting.get_field(config), value)) {
+      problems.push_back(
+          absl::StrCat("invalid value for ", setting.key.env_var, ": ", value));
+    }
+  }
+  return problems;
+}
+
+const LayerConfig& GetLayerConfig() {
+  static const LayerConfig* config = [] {
+    auto* config = new LayerConfig();
+    for (const std::string& problem : LoadLayerConfig(config))
+      SPL_LOG(WARNING) << "Layer config: " << problem;
+    return config;
+  }();
+  return *config;
+}
+
+}  // namespace performancelayers
@@ -0,0 +1,193 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LAYER_CONFIG_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LAYER_CONFIG_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "layer/support/layer_control.h"
+
+namespace performancelayers {
+// The initial instrumentation of a module, which `LayerControl` can change at
+// run time.
+struct ModuleConfig {
+  InstrumentationMode mode = InstrumentationMode::kFull;
+  // Used only when sampling.
+  uint32_t sampling_period = InstrumentationSwitch::kDefaultSamplingPeriod;
+};
+
+// The settings of the layers. Every setting has a key in the config file and
+// an environment variable, listed in `GetLayerConfigKeys()`. Empty strings
+// mean unset; unset log files default to stderr.
+struct LayerConfig {
+  struct Common {
+    // VK_PERFORMANCE_LAYERS_EVENT_LOG_FILE and
+    // VK_PERFORMANCE_LAYERS_TRACE_EVENT_LOG_FILE.
+    std::string event_log_file;
+    std::string trace_event_log_file;
+    // If false, the logs are only flushed when the layers are unloaded or a
+    // flush is requested through `LayerControl`, rather than after every
+    // event.
+    bool flush_every_event = true;
+    // The modules of the combined layer, comma-separated; all if empty.
+    std::string modules;
+    std::string control_file;
+    uint64_t control_poll_ms = 100;
+    std::string metrics_shm;
+    std::string metrics_socket;
+    uint64_t metrics_period_ms = 100;
+    bool overhead_profiling = false;
+    uint64_t overhead_report_period_ms = 10000;
+  };
+
+  struct FrameTime {
+    std::string log;
+    // 0 never exits.
+    uint64_t exit_after_frame = 0;
+    std::string finish_file;
+    std::string benchmark_watch_file;
+    std::string benchmark_start_string;
+    ModuleConfig module;
+  };
+
+  struct CompileTime {
+    std::string log;
+    uint64_t call_site_sample_us = 0;
+    std::string call_site_log;
+    ModuleConfig module;
+  };
+
+  struct ResourceCreation {
+    std::string log;
+    uint64_t slow_call_us = 1000;
+    ModuleConfig module;
+  };
+
+  struct Runtime {
+    std::string log;
+    ModuleConfig module;
+  };
+
+  // See `MemoryUsageLayerData::Options` for the meaning of the settings.
+  struct MemoryUsage {
+    std::string log;
+    uint64_t report_frames = 0;
+    uint64_t churn_window_frames = 0;
+    uint64_t short_lived_frames = 2;
+    uint64_t slow_call_us = 0;
+    uint64_t snapshot_frames = 60;
+    uint64_t host_report_frames = 0;
+    uint64_t call_site_sample_bytes = 0;
+    std::string call_site_log;
+    ModuleConfig module;
+  };
+
+  struct CacheSideload {
+    std::string file;
+  };
+
+  struct QueueSubmit {
+    std::string log;
+    ModuleConfig module;
+  };
+
+  struct SyncWait {
+    std::string log;
+    ModuleConfig module;
+  };
+
+  struct CommandRecording {
+    std::string log;
+    ModuleConfig module;
+  };
+
+  struct Descriptor {
+    std::string log;
+    uint64_t call_site_sample_us = 0;
+    std::string call_site_log;
+    ModuleConfig module;
+  };
+
+  Common common;
+  FrameTime frame_time;
+  CompileTime compile_time;
+  Runtime runtime;
+  MemoryUsage memory_usage;
+  CacheSideload cache_sideload;
+  QueueSubmit queue_submit;
+  SyncWait sync_wait;
+  CommandRecording command_recording;
+  Descriptor descriptor;
+  ResourceCreation resource_creation;
+
+  // Returns the instrumentation settings of the module |module_name|, e.g.,
+  // "runtime", or null if the module has none.
+  const ModuleConfig* GetModuleConfig(absl::string_view module_name) const;
+};
+
+// Returns |value|, or null if it is empty, for the functions taking optional
+// file names.
+inline const char* NullIfEmpty(const std::string& value) {
+  return value.empty() ? nullptr : value.c_str();
+}
+
+// A setting: its key in the config file, e.g., "frame_time.log", and its
+// environment variable, e.g., "VK_FRAME_TIME_LOG".
+struct LayerConfigKey {
+  const char* key;
+  const char* env_var;
+};
+
+// Returns every setting of `LayerConfig`.
+std::vector<LayerConfigKey> GetLayerConfigKeys();
+
+// Applies the settings of the config file |contents| to |config|: the
+// settings before the first section, then those of the section of |profile|.
+// If |profile| is empty, the profile is the value of the "profile" key before
+// the first section, if any. The file has one setting per line:
+// ```
+// # A comment.
+// profile = lightweight
+// common.event_log_file = /tmp/events.log
+//
+// [lightweight]
+// runtime.mode = off
+// ```
+// Returns the problems found, e.g., unknown keys or invalid values, in every
+// section; the settings with problems are skipped.
+std::vector<std::string> ApplyLayerConfigFile(absl::string_view contents,
+                                              absl::string_view profile,
+                                              LayerConfig* config);
+
+// Applies the settings set by environment variables to |config|, reading them
+// with |get_env_var|. Returns the problems found, e.g., invalid values.
+std::vector<std::string> ApplyLayerConfigEnvVars(
+    const std::function<const char*(const char*)>& get_env_var,
+    LayerConfig* config);
+
+// Returns the config of the layers in this library, read once: the defaults,
+// overridden by the file set by the "VK_PERFORMANCE_LAYERS_CONFIG"
+// environment variable for the profile set by
+// "VK_PERFORMANCE_LAYERS_PROFILE", if any, overridden by the environment
+// variables of the settings. The problems found are logged.
+const LayerConfig& GetLayerConfig();
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LAYER_CONFIG_H_
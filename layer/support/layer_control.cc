@@ -0,0 +1,214 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/support/layer_control.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/time.h"
+#include "layer/support/debug_logging.h"
+#include "layer/support/layer_config.h"
+
+namespace performancelayers {
+namespace {
+std::optional<LogLevel> ParseLogLevel(absl::string_view word) {
+  if (word == "low") return LogLevel::kLow;
+  if (word == "medium") return LogLevel::kMedium;
+  if (word == "high") return LogLevel::kHigh;
+  return std::nullopt;
+}
+
+// Returns true if |command| is a setting that |later| overrides.
+bool IsOverriddenBy(const ControlCommand& command,
+                    const ControlCommand& later) {
+  return command.kind == later.kind &&
+         (later.module == "all" || command.module == later.module);
+}
+}  // namespace
+
+std::optional<InstrumentationMode> ParseInstrumentationMode(
+    absl::string_view word) {
+  if (word == "off") return InstrumentationMode::kOff;
+  if (word == "sampling") return InstrumentationMode::kSampling;
+  if (word == "full") return InstrumentationMode::kFull;
+  return std::nullopt;
+}
+
+std::optional<ControlCommand> ParseControlCommand(absl::string_view line) {
+  std::vector<absl::string_view> words =
+      absl::StrSplit(line, absl::ByAnyChar(" \t\r"), absl::SkipEmpty());
+  if (words.empty() || words[0][0] == '#') return std::nullopt;
+
+  ControlCommand command;
+  bool valid = false;
+  if (words[0] == "mode" && (words.size() == 3 || words.size() == 4)) {
+    command.kind = ControlCommand::Kind::kMode;
+    command.module = std::string(words[1]);
+    std::optional<InstrumentationMode> mode =
+        ParseInstrumentationMode(words[2]);
+    valid = mode.has_value();
+    if (valid) command.mode = *mode;
+    if (valid && words.size() == 4) {
+      valid = command.mode == InstrumentationMode::kSampling &&
+              absl::SimpleAtoi(words[3], &command.sampling_period) &&
+              command.sampling_period > 0;
+    }
+  } else if (words[0] == "log_level" && words.size() == 3) {
+    command.kind = ControlCommand::Kind::kLogLevel;
+    command.module = std::string(words[1]);
+    std::optional<LogLevel> log_level = ParseLogLevel(words[2]);
+    valid = log_level.has_value();
+    if (valid) command.log_level = *log_level;
+  } else if ((words[0] == "flush" || words[0] == "snapshot") &&
+             words.size() <= 2) {
+    command.kind = words[0] == "flush" ? ControlCommand::Kind::kFlush
+                                       : ControlCommand::Kind::kSnapshot;
+    if (words.size() == 2) command.module = std::string(words[1]);
+    valid = true;
+  }
+
+  if (!valid) {
+    SPL_LOG(WARNING) << "Ignoring malformed control command: " << line;
+    return std::nullopt;
+  }
+  return command;
+}
+
+LayerControl* LayerControl::Get() {
+  // Don't use new -- the watcher must stop before the layer gets unloaded.
+  static const std::unique_ptr<LayerControl> control =
+      []() -> std::unique_ptr<LayerControl> {
+    const LayerConfig::Common& config = GetLayerConfig().common;
+    if (config.control_file.empty()) return nullptr;
+    auto control = std::make_unique<LayerControl>(config.control_file);
+    control->Poll();
+    control->StartWatching(std::max<uint64_t>(config.control_poll_ms, 1));
+    return control;
+  }();
+  return control.get();
+}
+
+LayerControl::LayerControl(std::string control_filename)
+    : control_filename_(std::move(control_filename)) {}
+
+LayerControl::~LayerControl() {
+  {
+    absl::MutexLock lock(&watcher_lock_);
+    stop_watching_ = true;
+  }
+  if (watcher_.joinable()) watcher_.join();
+}
+
+void LayerControl::StartWatching(uint64_t poll_period_ms) {
+  assert(!watcher_.joinable() && "Already watching the control file");
+  watcher_ = std::thread([this, poll_period_ms] {
+    while (true) {
+      {
+        absl::MutexLock lock(&watcher_lock_);
+        if (watcher_lock_.AwaitWithTimeout(
+                absl::Condition(&stop_watching_),
+                absl::Milliseconds(poll_period_ms))) {
+          return;
+        }
+      }
+      Poll();
+    }
+  });
+}
+
+void LayerControl::AddModule(absl::string_view module_name,
+                             ControlledModule* module) {
+  assert(module);
+  absl::MutexLock lock(&lock_);
+  for (const ControlCommand& setting : settings_) {
+    if (!setting.AppliesTo(module_name)) continue;
+    if (setting.kind == ControlCommand::Kind::kMode) {
+      module->SetInstrumentationMode(setting.mode, setting.sampling_period);
+    } else {
+      module->SetLogLevel(setting.log_level);
+    }
+  }
+  modules_.emplace_back(std::string(module_name), module);
+}
+
+void LayerControl::RemoveModule(ControlledModule* module) {
+  absl::MutexLock lock(&lock_);
+  modules_.erase(std::remove_if(modules_.begin(), modules_.end(),
+                                [module](const auto& name_and_module) {
+                                  return name_and_module.second == module;
+                                }),
+                 modules_.end());
+}
+
+bool LayerControl::Poll() {
+  struct stat file_stat = {};
+  if (stat(control_filename_.c_str(), &file_stat) != 0) return false;
+  const FileVersion version = {
+      static_cast<int64_t>(file_stat.st_mtim.tv_sec) * 1000000000 +
+          file_stat.st_mtim.tv_nsec,
+      static_cast<int64_t>(file_stat.st_size),
+      static_cast<uint64_t>(file_stat.st_ino)};
+
+  absl::MutexLock lock(&lock_);
+  if (file_version_ == version) return false;
+  file_version_ = version;
+
+  std::ifstream file(control_filename_);
+  if (!file.good()) return false;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (std::optional<ControlCommand> command = ParseControlCommand(line)) {
+      ApplyCommand(*command);
+    }
+  }
+  return true;
+}
+
+void LayerControl::ApplyCommand(const ControlCommand& command) {
+  for (const auto& [module_name, module] : modules_) {
+    if (!command.AppliesTo(module_name)) continue;
+    switch (command.kind) {
+      case ControlCommand::Kind::kMode:
+        module->SetInstrumentationMode(command.mode, command.sampling_period);
+        break;
+      case ControlCommand::Kind::kLogLevel:
+        module->SetLogLevel(command.log_level);
+        break;
+      case ControlCommand::Kind::kFlush:
+        module->Flush();
+        break;
+      case ControlCommand::Kind::kSnapshot:
+        module->LogSnapshot();
+        break;
+    }
+  }
+
+  if (command.kind == ControlCommand::Kind::kMode ||
+      command.kind == ControlCommand::Kind::kLogLevel) {
+    settings_.erase(std::remove_if(settings_.begin(), settings_.end(),
+                                   [&command](const ControlCommand& setting) {
+                                     return IsOverriddenBy(setting, command);
+                                   }),
+                    settings_.end());
+    settings_.push_back(command);
+  }
+}
+
+}  // namespace performancelayers
@@ -0,0 +1,217 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LAYER_CONTROL_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LAYER_CONTROL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "layer/support/event_logging.h"
+
+namespace performancelayers {
+// How much of a module's work is done: none, i.e., the module only passes the
+// calls down the chain and keeps the state the later calls depend on, every
+// n-th call, or all of it.
+enum class InstrumentationMode { kOff, kSampling, kFull };
+
+// Selects the calls a module instruments. Switched at run time by
+// `LayerControl`; checking it costs one relaxed load and one well-predicted
+// branch, unless the module is sampling.
+class InstrumentationSwitch {
+ public:
+  static constexpr uint32_t kDefaultSamplingPeriod = 10;
+
+  // Returns true if the current call is instrumented: always in full mode,
+  // never when off, and one call in every sampling period when sampling.
+  bool ShouldInstrument() {
+    const uint32_t period = period_.load(std::memory_order_relaxed);
+    if (ABSL_PREDICT_TRUE(period <= 1)) return period == 1;
+    return sampled_calls_.fetch_add(1, std::memory_order_relaxed) % period ==
+           0;
+  }
+
+  InstrumentationMode GetMode() const {
+    const uint32_t period = period_.load(std::memory_order_relaxed);
+    if (period == 0) return InstrumentationMode::kOff;
+    return period == 1 ? InstrumentationMode::kFull
+                       : InstrumentationMode::kSampling;
+  }
+
+  // Sets the mode. |sampling_period| is used only when sampling, and sampling
+  // every call is the same as the full mode.
+  void SetMode(InstrumentationMode mode,
+               uint32_t sampling_period = kDefaultSamplingPeriod) {
+    uint32_t period = 1;
+    if (mode == InstrumentationMode::kOff) {
+      period = 0;
+    } else if (mode == InstrumentationMode::kSampling) {
+      period = std::max<uint32_t>(sampling_period, 1);
+    }
+    period_.store(period, std::memory_order_relaxed);
+  }
+
+ private:
+  // 0 when off, 1 in full mode, and the sampling period otherwise.
+  std::atomic<uint32_t> period_ = 1;
+  std::atomic<uint32_t> sampled_calls_ = 0;
+};
+
+// A module that can be controlled at run time, implemented by `LayerData`. The
+// functions are called on the control thread, concurrently with the module's
+// own calls.
+class ControlledModule {
+ public:
+  virtual ~ControlledModule() = default;
+
+  virtual void SetInstrumentationMode(InstrumentationMode mode,
+                                      uint32_t sampling_period) = 0;
+
+  // Drops the events logged below |log_level|.
+  virtual void SetLogLevel(LogLevel log_level) = 0;
+
+  // Flushes the module's logs.
+  virtual void Flush() = 0;
+
+  // Logs the current state of the module, e.g., its statistics so far, and
+  // flushes the logs.
+  virtual void LogSnapshot() = 0;
+};
+
+// A command of the control file. Every line of the file is one command:
+//   mode <module> off|full|sampling [<period>]
+//   log_level <module> low|medium|high
+//   flush [<module>]
+//   snapshot [<module>]
+// |module| is a module name, such as "runtime", or "all" for every module;
+// flush and snapshot apply to all modules if it is omitted. Empty lines and
+// lines starting with '#' are ignored.
+struct ControlCommand {
+  enum class Kind { kMode, kLogLevel, kFlush, kSnapshot };
+
+  Kind kind = Kind::kFlush;
+  std::string module = "all";
+  InstrumentationMode mode = InstrumentationMode::kFull;
+  uint32_t sampling_period = InstrumentationSwitch::kDefaultSamplingPeriod;
+  LogLevel log_level = LogLevel::kLow;
+
+  // Returns true if the command applies to the module |module_name|.
+  bool AppliesTo(absl::string_view module_name) const {
+    return module == "all" || module == module_name;
+  }
+};
+
+// Parses "off", "sampling" or "full". Returns std::nullopt otherwise.
+std::optional<InstrumentationMode> ParseInstrumentationMode(
+    absl::string_view word);
+
+// Parses one line of the control file. Returns std::nullopt for empty lines,
+// comments and malformed commands, which are logged.
+std::optional<ControlCommand> ParseControlCommand(absl::string_view line);
+
+// Switches the modules of the layers between instrumentation modes, changes
+// their log levels, and makes them flush their logs or log a snapshot of their
+// state, while the application runs. The commands are read from a control
+// file, set by the "common.control_file" setting of the `LayerConfig`, which a
+// thread polls every "common.control_poll_ms" milliseconds, 100 by default.
+// Whenever the file is rewritten, all its commands are applied in order, so
+// e.g. writing "snapshot" to the file twice logs two snapshots. Modes and log
+// levels stay set until another command changes them, and modules added later
+// get the ones set so far.
+//
+// Sample use, to profile a 30 second window of a session:
+// ```
+// echo "mode runtime off" > /tmp/spl_control
+// VK_PERFORMANCE_LAYERS_CONTROL_FILE=/tmp/spl_control ./game &
+// ...
+// echo "mode runtime full" > /tmp/spl_control; sleep 30
+// printf "mode runtime off\nsnapshot\n" > /tmp/spl_control
+// ```
+class LayerControl {
+ public:
+  // Returns the control of the layers in this library, which watches the
+  // control file until the library is unloaded, or null if no control file is
+  // set.
+  static LayerControl* Get();
+
+  // Controls the modules through |control_filename|. The file is not read
+  // until `Poll()` or `StartWatching()` are called.
+  explicit LayerControl(std::string control_filename);
+
+  // Stops watching the control file.
+  ~LayerControl();
+
+  LayerControl(const LayerControl&) = delete;
+  LayerControl& operator=(const LayerControl&) = delete;
+
+  // Polls the control file every |poll_period_ms| on a thread of its own.
+  void StartWatching(uint64_t poll_period_ms);
+
+  // Controls |module| under |module_name| until it is removed, and applies
+  // the modes and log levels set so far to it.
+  void AddModule(absl::string_view module_name, ControlledModule* module);
+
+  // Stops controlling |module|. Once this returns, no command is applied to
+  // |module| anymore.
+  void RemoveModule(ControlledModule* module);
+
+  // Reads the control file and applies its commands if it changed since it was
+  // last read. Returns true if the commands were applied.
+  bool Poll();
+
+ private:
+  // What identifies a version of the control file.
+  struct FileVersion {
+    int64_t modification_ns = 0;
+    int64_t size = 0;
+    uint64_t inode = 0;
+
+    bool operator==(const FileVersion& other) const {
+      return modification_ns == other.modification_ns &&
+             size == other.size && inode == other.inode;
+    }
+  };
+
+  // Applies |command| to every matching module, and keeps it if it is a
+  // setting.
+  void ApplyCommand(const ControlCommand& command)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  const std::string control_filename_;
+
+  absl::Mutex lock_;
+  std::vector<std::pair<std::string, ControlledModule*>> modules_
+      ABSL_GUARDED_BY(lock_);
+  // The mode and log level commands in effect, in the order they were applied.
+  std::vector<ControlCommand> settings_ ABSL_GUARDED_BY(lock_);
+  std::optional<FileVersion> file_version_ ABSL_GUARDED_BY(lock_);
+
+  absl::Mutex watcher_lock_;
+  bool stop_watching_ ABSL_GUARDED_BY(watcher_lock_) = false;
+  std::thread watcher_;
+};
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LAYER_CONTROL_H_
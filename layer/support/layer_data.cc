@@ -14,6 +14,7 @@
 
 #include "layer/support/layer_data.h"
 
+#include <atomic>
 #include <cinttypes>
 #include <cstdint>
 #include <iomanip>
@@ -23,17 +24,35 @@
 #include "absl/strings/str_format.h"
 #include "absl/synchronization/mutex.h"
 #include "layer/support/debug_logging.h"
+#include "layer/support/layer_config.h"
 #include "layer/support/layer_utils.h"
 
 namespace performancelayers {
 namespace {
-constexpr char kEventLogFileEnvVar[] = "VK_PERFORMANCE_LAYERS_EVENT_LOG_FILE";
-constexpr char kTraceEventLogFileEnvVar[] =
-    "VK_PERFORMANCE_LAYERS_TRACE_EVENT_LOG_FILE";
+// A thread's last dispatch table lookup in one LayerData. The cached table is
+// valid as long as the LayerData's dispatch generation doesn't change.
+template <typename KeyT, typename TableT>
+struct DispatchCacheEntry {
+  uint64_t layer_data_id = 0;
+  uint64_t generation = 0;
+  KeyT key;
+  const TableT* table = nullptr;
+};
+
+// Direct-mapped per-thread caches, indexed by LayerData id.
+thread_local DispatchCacheEntry<InstanceKey, VkLayerInstanceDispatchTable>
+    instance_dispatch_cache[LayerData::kNumDispatchCacheEntries];
+thread_local DispatchCacheEntry<DeviceKey, VkLayerDispatchTable>
+    device_dispatch_cache[LayerData::kNumDispatchCacheEntries];
+
+// Returns a new id for a LayerData. Ids start at 1, so that they don't match
+// an empty cache entry.
+uint64_t GetNextLayerDataId() {
+  static std::atomic<uint64_t> next_id = 1;
+  return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+}  // namespace
 
-// Returns the first create info of type
-// VK_STRUCTURE_TYPE_LOADER_INSTANCE_CREATE_INFO in the chain |create_info|.
-// Returns |nullptr| if no info is found.
 VkLayerInstanceCreateInfo* FindInstanceCreateInfo(
     const VkInstanceCreateInfo* create_info) {
   auto* instance_create_info = const_cast<VkLayerInstanceCreateInfo*>(
@@ -50,9 +69,6 @@ VkLayerInstanceCreateInfo* FindInstanceCreateInfo(
   return instance_create_info;
 }
 
-// Returns the first create info of type
-// VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO in the chain |create_info|.
-// Returns |nullptr| if no info is found.
 VkLayerDeviceCreateInfo* FindDeviceCreateInfo(
     const VkDeviceCreateInfo* create_info) {
   auto* device_create_info = const_cast<VkLayerDeviceCreateInfo*>(
@@ -68,12 +84,18 @@ VkLayerDeviceCreateInfo* FindDeviceCreateInfo(
 
   return device_create_info;
 }
-}  // namespace
 
-LayerData::LayerData(char* log_filename, const char* header)
-    : common_output_(getenv(kEventLogFileEnvVar)),
-      private_output_(log_filename),
-      trace_output_(getenv(kTraceEventLogFileEnvVar)),
+LayerData::LayerData(const char* log_filename, const char* header)
+    : dispatch_cache_id_(GetNextLayerDataId()),
+      flush_every_event_(GetLayerConfig().common.flush_every_event),
+      // The common and trace logs are shared by all the layers, each with its
+      // own buffer, so they are flushed after every line to keep the lines of
+      // different layers from interleaving.
+      common_output_(NullIfEmpty(GetLayerConfig().common.event_log_file),
+                     /*flush_every_line=*/true),
+      private_output_(log_filename, flush_every_event_),
+      trace_output_(NullIfEmpty(GetLayerConfig().common.trace_event_log_file),
+                    /*flush_every_line=*/true),
       private_logger_(CSVLogger(header, &private_output_)),
       private_logger_filter_(FilterLogger(&private_logger_, LogLevel::kHigh)),
       common_logger_(&common_output_),
@@ -83,13 +105,86 @@ LayerData::LayerData(char* log_filename, const char* header)
   broadcast_logger_.StartLog();
 }
 
+LayerData::~LayerData() {
+  StopControl();
+  if (LayerOverheadProfiler* profiler = overhead_profiler_.load()) {
+    profiler->Report(/*end_of_run=*/true);
+    profiler->SetEventLogger(nullptr);
+  }
+  broadcast_logger_.EndLog();
+}
+
+void LayerData::SetOverheadProfiler(LayerOverheadProfiler* profiler) {
+  if (!IsLayerOverheadProfilingEnabled()) return;
+  if (overhead_profiler_.exchange(profiler) == profiler) return;
+  profiler->SetEventLogger(&broadcast_logger_);
+}
+
+void LayerData::LogSnapshot() {
+  if (LayerOverheadProfiler* profiler = overhead_profiler_.load()) {
+    profiler->Report(/*end_of_run=*/false);
+  }
+  broadcast_logger_.Flush();
+}
+
+void LayerData::StartControl(const char* module_name) {
+  assert(!control_ && "The layer is already controlled");
+  if (const ModuleConfig* module_config =
+          GetLayerConfig().GetModuleConfig(module_name)) {
+    SetInstrumentationMode(module_config->mode, module_config->sampling_period);
+  }
+  control_ = LayerControl::Get();
+  if (control_) control_->AddModule(module_name, this);
+}
+
+void LayerData::StopControl() {
+  if (!control_) return;
+  control_->RemoveModule(this);
+  control_ = nullptr;
+}
+
 void LayerData::RemoveInstance(VkInstance instance) {
   InstanceKey key(instance);
   absl::MutexLock lock(&instance_dispatch_lock_);
+  instance_dispatch_generation_.fetch_add(1, std::memory_order_release);
   instance_dispatch_map_.erase(key);
   instance_keys_map_.erase(key);
 }
 
+const VkLayerInstanceDispatchTable& LayerData::GetInstanceDispatchTable(
+    InstanceKey key) const {
+  auto& entry =
+      instance_dispatch_cache[dispatch_cache_id_ % kNumDispatchCacheEntries];
+  // Read the generation before looking up the table, so that a removal
+  // racing with the lookup invalidates the entry.
+  const uint64_t generation =
+      instance_dispatch_generation_.load(std::memory_order_acquire);
+  if (entry.layer_data_id != dispatch_cache_id_ || entry.key != key ||
+      entry.generation != generation) {
+    absl::MutexLock lock(&instance_dispatch_lock_);
+    auto it = instance_dispatch_map_.find(key);
+    assert(it != instance_dispatch_map_.end());
+    entry = {dispatch_cache_id_, generation, key, &it->second};
+  }
+  return *entry.table;
+}
+
+const VkLayerDispatchTable& LayerData::GetDeviceDispatchTable(
+    DeviceKey key) const {
+  auto& entry =
+      device_dispatch_cache[dispatch_cache_id_ % kNumDispatchCacheEntries];
+  const uint64_t generation =
+      device_dispatch_generation_.load(std::memory_order_acquire);
+  if (entry.layer_data_id != dispatch_cache_id_ || entry.key != key ||
+      entry.generation != generation) {
+    absl::MutexLock lock(&device_dispatch_lock_);
+    auto it = device_dispatch_map_.find(key);
+    assert(it != device_dispatch_map_.end());
+    entry = {dispatch_cache_id_, generation, key, &it->second};
+  }
+  return *entry.table;
+}
+
 Duration LayerData::GetTimeDelta() {
   absl::MutexLock lock(&log_time_lock_);
   DurationClock::time_point now = Now();
@@ -134,8 +229,9 @@ VkResult LayerData::CreateInstance(
   // Create the instance by calling the next layer's vkCreateInstance.
   instance_create_info->u.pLayerInfo =
       instance_create_info->u.pLayerInfo->pNext;
-  auto create_function = reinterpret_cast<PFN_vkCreateInstance>(
-      get_proc_addr(VK_NULL_HANDLE, "vkCreateInstance"));
+  NextLayerFunction<PFN_vkCreateInstance> create_function =
+      reinterpret_cast<PFN_vkCreateInstance>(
+          get_proc_addr(VK_NULL_HANDLE, "vkCreateInstance"));
   VkResult res = create_function(create_info, allocator, instance);
   if (res != VK_SUCCESS) {
     return res;
@@ -176,8 +272,9 @@ VkResult LayerData::CreateDevice(
 
   // Create the device after removing the current layer.
   device_create_info->u.pLayerInfo = device_create_info->u.pLayerInfo->pNext;
-  auto create_function = reinterpret_cast<PFN_vkCreateDevice>(
-      get_instance_proc_addr(instance, "vkCreateDevice"));
+  NextLayerFunction<PFN_vkCreateDevice> create_function =
+      reinterpret_cast<PFN_vkCreateDevice>(
+          get_instance_proc_addr(instance, "vkCreateDevice"));
   assert(create_function);
   VkResult result =
       create_function(physical_device, create_info, allocator, device);
@@ -15,6 +15,7 @@
 #ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LAYER_DATA_H_
 #define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LAYER_DATA_H_
 
+#include <atomic>
 #include <cstdint>
 #include <cstdio>
 #include <functional>
@@ -24,6 +25,7 @@
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/inlined_vector.h"
+#include "absl/container/node_hash_map.h"
 #include "absl/strings/str_join.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/clock.h"
@@ -32,6 +34,8 @@
 #include "layer/support/common_logging.h"
 #include "layer/support/csv_logging.h"
 #include "layer/support/event_logging.h"
+#include "layer/support/layer_control.h"
+#include "layer/support/layer_overhead_profiler.h"
 #include "layer/support/layer_utils.h"
 #include "layer/support/trace_event_logging.h"
 #include "log_output.h"
@@ -59,7 +63,7 @@ class DispatchableKeyBase {
 
  protected:
   using BaseT = DispatchableKeyBase;
-  explicit DispatchableKeyBase(void** raw_handle) {
+  constexpr explicit DispatchableKeyBase(void** raw_handle) {
     if (raw_handle) key_ = *raw_handle;
   }
   void* key_ = nullptr;
@@ -70,7 +74,7 @@ class DispatchableKeyBase {
 // `GetNextInstanceProcAddr`. Can be used as a hash map key.
 class InstanceKey : public DispatchableKeyBase<InstanceKey> {
  public:
-  InstanceKey() : BaseT(nullptr) {}
+  constexpr InstanceKey() : BaseT(nullptr) {}
 
   explicit InstanceKey(VkInstance instance)
       : BaseT(reinterpret_cast<void**>(instance)) {}
@@ -89,7 +93,7 @@ class InstanceKey : public DispatchableKeyBase<InstanceKey> {
 // `GetNextDeviceProcAddr`. Can be used as a hash map key.
 class DeviceKey : public DispatchableKeyBase<DeviceKey> {
  public:
-  DeviceKey() : BaseT(nullptr) {}
+  constexpr DeviceKey() : BaseT(nullptr) {}
 
   explicit DeviceKey(VkDevice device)
       : BaseT(reinterpret_cast<void**>(device)) {}
@@ -124,6 +128,18 @@ struct hash<performancelayers::DeviceKey> {
 
 namespace performancelayers {
 
+// Returns the first create info of type
+// VK_STRUCTURE_TYPE_LOADER_INSTANCE_CREATE_INFO in the chain |create_info|.
+// Returns |nullptr| if no info is found.
+VkLayerInstanceCreateInfo* FindInstanceCreateInfo(
+    const VkInstanceCreateInfo* create_info);
+
+// Returns the first create info of type
+// VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO in the chain |create_info|.
+// Returns |nullptr| if no info is found.
+VkLayerDeviceCreateInfo* FindDeviceCreateInfo(
+    const VkDeviceCreateInfo* create_info);
+
 // A class that contains all of the data needed for the functions
 // that this layer will override.
 // It contains three loggers that log the events to the layer's private and the
@@ -135,21 +151,35 @@ namespace performancelayers {
 // layer_data.LogEvent(&event);
 // ```
 // The `event` end up in the private or common file (or both) based on its log
-// level. The filename for the common log file will be retrieved from the
-// environment variable "VK_PERFORMANCE_LAYERS_EVENT_LOG_FILE" and
-// "VK_PERFORMANCE_LAYERS_TRACE_EVENT_LOG_FILE". If they are unset, then stderr
-// will be used as the log file.
-class LayerData {
+// level. The filenames for the common log files are the
+// "common.event_log_file" and "common.trace_event_log_file" settings of the
+// `LayerConfig`. If they are unset, then stderr will be used as the log file.
+// The common logs are flushed after every event, so that the lines of the
+// layers sharing them don't interleave. Unless "common.flush_every_event" is
+// unset, the private log is flushed after every event too.
+//
+// A layer can also be controlled at run time through `LayerControl`, which
+// switches its instrumentation mode and log level. The layer checks
+// `ShouldInstrument()` before doing any work that the calls passed down the
+// chain don't depend on.
+class LayerData : public ControlledModule {
  public:
+  // The dispatch tables are cached by address, so they must not move.
   using InstanceDispatchMap =
-      absl::flat_hash_map<InstanceKey, VkLayerInstanceDispatchTable>;
+      absl::node_hash_map<InstanceKey, VkLayerInstanceDispatchTable>;
   using DeviceDispatchMap =
-      absl::flat_hash_map<DeviceKey, VkLayerDispatchTable>;
+      absl::node_hash_map<DeviceKey, VkLayerDispatchTable>;
   using HashVector = absl::InlinedVector<uint64_t, 3>;
 
-  LayerData(char* log_filename, const char* header);
+  // The number of LayerData objects each thread caches a dispatch table lookup
+  // for. LayerData objects created in the same library must not outnumber it,
+  // or they evict each other's entries. The combined layer checks that its
+  // modules fit.
+  static constexpr uint64_t kNumDispatchCacheEntries = 16;
 
-  virtual ~LayerData() { broadcast_logger_.EndLog(); }
+  LayerData(const char* log_filename, const char* header);
+
+  ~LayerData() override;
 
   // Records the dispatch table and instance key that is associated with
   // |instance|.
@@ -197,6 +227,7 @@ class LayerData {
   void RemoveDevice(VkDevice device) {
     DeviceKey key(device);
     absl::MutexLock lock(&device_dispatch_lock_);
+    device_dispatch_generation_.fetch_add(1, std::memory_order_release);
     device_dispatch_map_.erase(key);
     device_keys_map_.erase(key);
   }
@@ -216,32 +247,29 @@ class LayerData {
   // layer in the instance. |instance_handle| must be a VkInstance or
   // VkPhysicalDevice. This is can be used only with functions declared in the
   // dispatch table. See https://renderdoc.org/vulkan-layer-guide.html.
+  // The result converts to the function pointer type; calling it directly
+  // keeps the call out of the layer's measured overhead.
   template <typename DispatchableInstanceHandleT, typename TFuncPtr>
   auto GetNextInstanceProcAddr(DispatchableInstanceHandleT instance_handle,
                                TFuncPtr func_ptr) const {
-    absl::MutexLock lock(&instance_dispatch_lock_);
-    auto instance_dispatch_iter =
-        instance_dispatch_map_.find(InstanceKey(instance_handle));
-    assert(instance_dispatch_iter != instance_dispatch_map_.end());
-    auto proc_addr = instance_dispatch_iter->second.*func_ptr;
+    auto proc_addr =
+        GetInstanceDispatchTable(InstanceKey(instance_handle)).*func_ptr;
     assert(proc_addr);
-    return proc_addr;
+    return NextLayerFunction<decltype(proc_addr)>(proc_addr);
   }
 
   // Returns the function pointer for the function |funct_ptr| for the next
   // layer in the device. |device_handle| must be one of: VkDevice, VkQueue, or
   // VkCommandBuffer. This is can be used only with functions declared in the
   // dispatch table. See https://renderdoc.org/vulkan-layer-guide.html.
+  // Like for `GetNextInstanceProcAddr`, the result converts to the function
+  // pointer type.
   template <typename DispatchableDeviceHandleT, typename TFuncPtr>
   auto GetNextDeviceProcAddr(DispatchableDeviceHandleT device_handle,
                              TFuncPtr func_ptr) const {
-    absl::MutexLock lock(&device_dispatch_lock_);
-    auto device_dispatch_iter =
-        device_dispatch_map_.find(DeviceKey(device_handle));
-    assert(device_dispatch_iter != device_dispatch_map_.end());
-    auto proc_addr = device_dispatch_iter->second.*func_ptr;
+    auto proc_addr = GetDeviceDispatchTable(DeviceKey(device_handle)).*func_ptr;
     assert(proc_addr);
-    return proc_addr;
+    return NextLayerFunction<decltype(proc_addr)>(proc_addr);
   }
 
   // Removes a previously created shader module from the LayerData. This is
@@ -362,13 +390,70 @@ class LayerData {
   void DestroyShaderModule(VkDevice device, VkShaderModule shader_module,
                            const VkAllocationCallbacks* allocator);
 
-  // Logs the incoming event to the layer log file.
+  // Logs the incoming event to the layer log file, unless its log level is
+  // below the layer's.
   void LogEvent(Event* event) {
+    if (event->GetLogLevel() < log_level_.load(std::memory_order_relaxed)) {
+      return;
+    }
     broadcast_logger_.AddEvent(event);
-    broadcast_logger_.Flush();
+    if (flush_every_event_) broadcast_logger_.Flush();
+  }
+
+  // Returns true if the layer should instrument the current call, as set by
+  // the layer's instrumentation mode. Calls that are not instrumented must
+  // still keep the state that later calls depend on, e.g., the dispatch
+  // tables or the shader hashes.
+  bool ShouldInstrument() { return instrumentation_.ShouldInstrument(); }
+
+  InstrumentationMode GetInstrumentationMode() const {
+    return instrumentation_.GetMode();
   }
 
+  // ControlledModule overrides.
+  void SetInstrumentationMode(InstrumentationMode mode,
+                              uint32_t sampling_period) override {
+    instrumentation_.SetMode(mode, sampling_period);
+  }
+  void SetLogLevel(LogLevel log_level) override {
+    log_level_.store(log_level, std::memory_order_relaxed);
+  }
+  void Flush() override { broadcast_logger_.Flush(); }
+  // Logs the layer's overhead since the previous report, if it is profiled.
+  // Layers with more state to report extend this.
+  void LogSnapshot() override;
+
+  // Logs the reports of |profiler|, which measures the overhead of this
+  // layer's functions, including an end-of-run report when the LayerData is
+  // destroyed. Does nothing unless the overhead of the layers is profiled.
+  void SetOverheadProfiler(LayerOverheadProfiler* profiler);
+
+ protected:
+  // Sets the instrumentation mode of the module |module_name| in the
+  // `LayerConfig`, and lets `LayerControl` control the layer as that module,
+  // if a control file is set. Called once the layer data is fully
+  // constructed.
+  void StartControl(const char* module_name);
+
+  // Stops the control of the layer. Layers overriding the `ControlledModule`
+  // functions call this first thing in their destructor; the LayerData
+  // destructor calls it otherwise.
+  void StopControl();
+
  private:
+  // Returns the dispatch table of |key|, which must have been added. Each
+  // thread caches the last table it looked up in every LayerData, so that
+  // repeated calls on the same device or instance, the common case, take
+  // neither the lock nor a hash map lookup. Removing a device or an instance
+  // invalidates the cached tables of all threads.
+  const VkLayerInstanceDispatchTable& GetInstanceDispatchTable(
+      InstanceKey key) const;
+  const VkLayerDispatchTable& GetDeviceDispatchTable(DeviceKey key) const;
+
+  // Identifies this LayerData in the per-thread dispatch table caches.
+  const uint64_t dispatch_cache_id_;
+  const bool flush_every_event_;
+
   mutable absl::Mutex instance_dispatch_lock_;
   // A map from a VkInstance to its VkLayerInstanceDispatchTable.
   InstanceDispatchMap instance_dispatch_map_
@@ -376,6 +461,9 @@ class LayerData {
   // A map from an InstanceKey to its VkInstance.
   absl::flat_hash_map<InstanceKey, VkInstance> instance_keys_map_;
   ABSL_GUARDED_BY(instance_dispatch_lock_)
+  // Incremented whenever an instance is removed, to invalidate the cached
+  // dispatch tables.
+  std::atomic<uint64_t> instance_dispatch_generation_ = 0;
 
   mutable absl::Mutex device_dispatch_lock_;
   // A map from a VkDevice to its VkLayerDispatchTable.
@@ -383,6 +471,9 @@ class LayerData {
   // A map from a DeviceKey to its VkDevice.
   absl::flat_hash_map<DeviceKey, VkDevice> device_keys_map_;
   ABSL_GUARDED_BY(device_dispatch_lock_)
+  // Incremented whenever a device is removed, to invalidate the cached
+  // dispatch tables.
+  std::atomic<uint64_t> device_dispatch_generation_ = 0;
 
   mutable absl::Mutex shader_hash_lock_;
   // The map from a shader module to the result of its hash.
@@ -409,6 +500,14 @@ class LayerData {
   CommonLogger common_logger_;
   TraceEventLogger trace_logger_;
   BroadcastLogger broadcast_logger_;
+
+  // The profiler whose reports are logged, if any.
+  std::atomic<LayerOverheadProfiler*> overhead_profiler_ = nullptr;
+
+  InstrumentationSwitch instrumentation_;
+  std::atomic<LogLevel> log_level_ = LogLevel::kLow;
+  // The control the layer was added to, if any.
+  LayerControl* control_ = nullptr;
 };
 
 }  // namespace performancelayers
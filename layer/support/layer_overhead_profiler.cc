@@ -0,0 +1,209 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/support/layer_overhead_profiler.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "layer/support/event_logging.h"
+#include "layer/support/layer_config.h"
+#include "layer/support/layer_utils.h"
+
+namespace performancelayers {
+namespace {
+// Returns a new id for a profiler. Ids start at 1, so that they don't match an
+// empty cache entry.
+uint64_t GetNextProfilerId() {
+  static std::atomic<uint64_t> next_id = 1;
+  return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Returns the duration of a tick in nanoseconds. The time stamp counter is
+// measured against the steady clock once, for a couple of milliseconds.
+double GetNanosecondsPerTick() {
+#if defined(__x86_64__) || defined(__i386__)
+  static const double nanoseconds_per_tick = [] {
+    const DurationClock::time_point start = Now();
+    const uint64_t start_ticks = ReadOverheadTicks();
+    DurationClock::time_point end = start;
+    while (end - start < std::chrono::milliseconds(2)) end = Now();
+    const uint64_t end_ticks = ReadOverheadTicks();
+    return static_cast<double>(Duration(end - start).ToNanoseconds()) /
+           static_cast<double>(std::max<uint64_t>(end_ticks - start_ticks, 1));
+  }();
+  return nanoseconds_per_tick;
+#else
+  return 1.0;
+#endif
+}
+
+// Returns the report period in ticks, or 0 if only the end-of-run report is
+// requested.
+uint64_t GetReportPeriodTicks() {
+  const uint64_t period_ms =
+      GetLayerConfig().common.overhead_report_period_ms;
+  return static_cast<uint64_t>(static_cast<double>(period_ms) * 1e6 /
+                               GetNanosecondsPerTick());
+}
+}  // namespace
+
+bool IsLayerOverheadProfilingEnabled() {
+  static const bool enabled = GetLayerConfig().common.overhead_profiling;
+  return enabled;
+}
+
+int64_t OverheadTicksToNanoseconds(uint64_t ticks) {
+  return static_cast<int64_t>(static_cast<double>(ticks) *
+                              GetNanosecondsPerTick());
+}
+
+LayerOverheadProfiler::LayerOverheadProfiler(
+    std::string_view layer_name,
+    absl::Span<const std::string_view> function_names)
+    : id_(GetNextProfilerId()),
+      // Layer prefixes end with an underscore.
+      layer_name_(layer_name.substr(0, layer_name.find_last_not_of('_') + 1)),
+      function_names_(function_names),
+      next_report_ticks_(UINT64_MAX),
+      run_max_ticks_(function_names.size()),
+      run_start_ticks_(ReadOverheadTicks()),
+      last_report_ticks_(run_start_ticks_) {}
+
+void LayerOverheadProfiler::SetEventLogger(EventLogger* logger) {
+  absl::MutexLock lock(&report_lock_);
+  logger_ = logger;
+  // The profilers are constructed before `main`, so the config is read only
+  // once a logger is set, e.g., after the benchmarks set their environment.
+  if (!logger || report_period_ticks_.load(std::memory_order_relaxed) != 0 ||
+      !IsLayerOverheadProfilingEnabled()) {
+    return;
+  }
+  const uint64_t period_ticks = GetReportPeriodTicks();
+  if (period_ticks == 0) return;
+  report_period_ticks_.store(period_ticks, std::memory_order_relaxed);
+  next_report_ticks_.store(ReadOverheadTicks() + period_ticks,
+                           std::memory_order_relaxed);
+}
+
+LayerOverheadProfiler::FunctionCounters*
+LayerOverheadProfiler::GetThreadCounters() {
+  struct CacheEntry {
+    uint64_t profiler_id = 0;
+    FunctionCounters* counters = nullptr;
+  };
+  // Direct-mapped per-thread cache, indexed by profiler id.
+  static thread_local CacheEntry cache[kNumThreadCountersCacheEntries];
+
+  CacheEntry& entry = cache[id_ % kNumThreadCountersCacheEntries];
+  if (ABSL_PREDICT_TRUE(entry.profiler_id == id_)) return entry.counters;
+  entry = {id_, AddThreadCounters()};
+  return entry.counters;
+}
+
+LayerOverheadProfiler::FunctionCounters*
+LayerOverheadProfiler::AddThreadCounters() {
+  absl::MutexLock lock(&threads_lock_);
+  // The counters may already exist if the cache entry was evicted.
+  std::unique_ptr<FunctionCounters[]>& counters =
+      thread_counters_[GetThreadId()];
+  if (!counters) {
+    counters = std::make_unique<FunctionCounters[]>(function_names_.size());
+  }
+  return counters.get();
+}
+
+void LayerOverheadProfiler::MaybeReport(uint64_t now_ticks) {
+  uint64_t due_ticks = next_report_ticks_.load(std::memory_order_relaxed);
+  if (now_ticks < due_ticks ||
+      !next_report_ticks_.compare_exchange_strong(
+          due_ticks,
+          now_ticks + report_period_ticks_.load(std::memory_order_relaxed),
+          std::memory_order_relaxed)) {
+    return;
+  }
+  Report(/*end_of_run=*/false);
+}
+
+void LayerOverheadProfiler::Report(bool end_of_run) {
+  absl::MutexLock report_lock(&report_lock_);
+  if (!logger_) return;
+
+  const size_t num_functions = function_names_.size();
+  std::vector<uint64_t> calls(num_functions);
+  std::vector<uint64_t> ticks(num_functions);
+  std::vector<uint64_t> max_ticks(num_functions);
+  {
+    absl::MutexLock threads_lock(&threads_lock_);
+    for (auto& [thread_id, thread_counters] : thread_counters_) {
+      for (size_t i = 0; i != num_functions; ++i) {
+        FunctionCounters& counters = thread_counters[i];
+        const uint64_t total_calls =
+            counters.calls.load(std::memory_order_relaxed);
+        const uint64_t total_ticks =
+            counters.ticks.load(std::memory_order_relaxed);
+        const uint64_t period_max_ticks =
+            counters.max_ticks.exchange(0, std::memory_order_relaxed);
+        calls[i] += end_of_run ? total_calls
+                               : total_calls - counters.reported_calls;
+        ticks[i] += end_of_run ? total_ticks
+                               : total_ticks - counters.reported_ticks;
+        max_ticks[i] = std::max(max_ticks[i], period_max_ticks);
+        counters.reported_calls = total_calls;
+        counters.reported_ticks = total_ticks;
+      }
+    }
+  }
+  for (size_t i = 0; i != num_functions; ++i) {
+    run_max_ticks_[i] = std::max(run_max_ticks_[i], max_ticks[i]);
+    if (end_of_run) max_ticks[i] = run_max_ticks_[i];
+  }
+
+  const uint64_t now_ticks = ReadOverheadTicks();
+  const int64_t period_ns = OverheadTicksToNanoseconds(
+      now_ticks - (end_of_run ? run_start_ticks_ : last_report_ticks_));
+  last_report_ticks_ = now_ticks;
+
+  auto log_event = [&](std::string_view function, uint64_t function_calls,
+                       uint64_t function_ticks, uint64_t function_max_ticks) {
+    const int64_t total_ns = OverheadTicksToNanoseconds(function_ticks);
+    const int64_t frame_time_ppm =
+        period_ns > 0 ? static_cast<int64_t>(static_cast<double>(total_ns) *
+                                             1e6 / period_ns)
+                      : 0;
+    LayerOverheadEvent event(
+        layer_name_, std::string(function), end_of_run,
+        static_cast<int64_t>(function_calls),
+        Duration::FromNanoseconds(total_ns),
+        Duration::FromNanoseconds(
+            OverheadTicksToNanoseconds(function_max_ticks)),
+        frame_time_ppm);
+    logger_->AddEvent(&event);
+  };
+
+  uint64_t all_calls = 0;
+  uint64_t all_ticks = 0;
+  uint64_t all_max_ticks = 0;
+  for (size_t i = 0; i != num_functions; ++i) {
+    if (calls[i] == 0) continue;
+    log_event(function_names_[i], calls[i], ticks[i], max_ticks[i]);
+    all_calls += calls[i];
+    all_ticks += ticks[i];
+    all_max_ticks = std::max(all_max_ticks, max_ticks[i]);
+  }
+  log_event("all", all_calls, all_ticks, all_max_ticks);
+  logger_->Flush();
+}
+
+}  // namespace performancelayers
@@ -0,0 +1,269 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LAYER_OVERHEAD_PROFILER_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LAYER_OVERHEAD_PROFILER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+#include "absl/base/optimization.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "vulkan/vulkan.h"
+
+namespace performancelayers {
+class EventLogger;
+
+// Returns true if the layers measure their own overhead, as requested with the
+// "common.overhead_profiling" setting of the `LayerConfig`.
+bool IsLayerOverheadProfilingEnabled();
+
+// Returns the current time in ticks of the cheapest clock to read: the time
+// stamp counter on x86, and the steady clock in nanoseconds elsewhere.
+inline uint64_t ReadOverheadTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+// Converts a number of ticks of `ReadOverheadTicks()` to nanoseconds.
+int64_t OverheadTicksToNanoseconds(uint64_t ticks);
+
+namespace detail {
+// The time a profiled call spent in the next layer so far.
+struct OverheadFrame {
+  uint64_t next_layer_ticks = 0;
+};
+
+// The frame of the innermost profiled call on this thread, or null outside of
+// profiled calls.
+inline thread_local OverheadFrame* current_overhead_frame = nullptr;
+}  // namespace detail
+
+// Measures the time the intercepted functions of one layer spend in the
+// layer's own code, i.e., excluding the calls to the next layer, and reports it
+// as `LayerOverheadEvent`s.
+//
+// Each thread records its calls in counters of its own, so recording takes no
+// lock and no atomic read-modify-write. The reports read the counters of all
+// threads and log, for every function called since the previous report, the
+// number of calls, the total and the longest time in the layer, and the
+// fraction of the wall time, i.e., of the frame time of the frames presented
+// in the meantime, spent in the layer. Reports are logged periodically, as set
+// by the "common.overhead_report_period_ms" setting, and at the end of the
+// run, when the end-of-run report covers the whole run.
+//
+// The functions are profiled through the trampolines of
+// SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE, which also defines the profiler of
+// each layer, and the calls to the next layer are timed by the
+// `NextLayerFunction`s returned by `LayerData`. Nothing is measured unless
+// `IsLayerOverheadProfilingEnabled()`.
+class LayerOverheadProfiler {
+ public:
+  // The number of profilers each thread caches its counters for. Profilers
+  // created in the same library must not outnumber it, or they evict each
+  // other's entries and every call takes the lock of its profiler. The
+  // combined layer checks that its profilers fit.
+  static constexpr uint64_t kNumThreadCountersCacheEntries = 16;
+
+  // |function_names| are the names of the layer's intercepted functions, by
+  // index, and must outlive the profiler.
+  LayerOverheadProfiler(std::string_view layer_name,
+                        absl::Span<const std::string_view> function_names);
+
+  LayerOverheadProfiler(const LayerOverheadProfiler&) = delete;
+  LayerOverheadProfiler& operator=(const LayerOverheadProfiler&) = delete;
+
+  // Records a call to the function |function_index| that spent |ticks| in the
+  // layer and returned at |end_ticks|. Logs a periodic report if one is due.
+  void RecordCall(size_t function_index, uint64_t ticks, uint64_t end_ticks) {
+    FunctionCounters& counters = GetThreadCounters()[function_index];
+    // Only this thread writes its counters, so plain loads and stores suffice.
+    counters.calls.store(counters.calls.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+    counters.ticks.store(
+        counters.ticks.load(std::memory_order_relaxed) + ticks,
+        std::memory_order_relaxed);
+    if (ticks > counters.max_ticks.load(std::memory_order_relaxed)) {
+      counters.max_ticks.store(ticks, std::memory_order_relaxed);
+    }
+    const uint64_t next_report_ticks =
+        next_report_ticks_.load(std::memory_order_relaxed);
+    if (ABSL_PREDICT_FALSE(end_ticks >= next_report_ticks)) {
+      MaybeReport(end_ticks);
+    }
+  }
+
+  // Sets the logger the reports are logged to. Nothing is reported without a
+  // logger.
+  void SetEventLogger(EventLogger* logger);
+
+  // Logs the calls recorded since the previous report. The end-of-run report
+  // covers all the calls of the run instead.
+  void Report(bool end_of_run);
+
+ private:
+  // The counters of one function on one thread.
+  struct FunctionCounters {
+    // Written only by the thread the counters belong to.
+    std::atomic<uint64_t> calls = 0;
+    std::atomic<uint64_t> ticks = 0;
+    // The longest call since the previous report, which resets it.
+    std::atomic<uint64_t> max_ticks = 0;
+    // The counts at the previous report. Accessed only by the reports.
+    uint64_t reported_calls = 0;
+    uint64_t reported_ticks = 0;
+  };
+
+  // Returns the counters of the calling thread, one per function.
+  FunctionCounters* GetThreadCounters();
+
+  // Creates the counters of the calling thread.
+  ABSL_ATTRIBUTE_NOINLINE FunctionCounters* AddThreadCounters();
+
+  // Logs a periodic report unless another thread got to it first.
+  ABSL_ATTRIBUTE_NOINLINE void MaybeReport(uint64_t now_ticks);
+
+  // Identifies this profiler in the per-thread counter caches.
+  const uint64_t id_;
+  const std::string layer_name_;
+  const absl::Span<const std::string_view> function_names_;
+  // The report period, 0 if reports are logged only at the end of the run.
+  // Set with the first logger.
+  std::atomic<uint64_t> report_period_ticks_ = 0;
+  // When the next periodic report is due.
+  std::atomic<uint64_t> next_report_ticks_;
+
+  absl::Mutex threads_lock_;
+  // The counters of every thread that called a function of the layer, by
+  // thread id. Kept after a thread exits so that its calls are reported.
+  absl::flat_hash_map<int64_t, std::unique_ptr<FunctionCounters[]>>
+      thread_counters_ ABSL_GUARDED_BY(threads_lock_);
+
+  // Acquired before |threads_lock_|.
+  absl::Mutex report_lock_;
+  EventLogger* logger_ ABSL_GUARDED_BY(report_lock_) = nullptr;
+  // The longest call of every function in the run, as of the previous report.
+  std::vector<uint64_t> run_max_ticks_ ABSL_GUARDED_BY(report_lock_);
+  const uint64_t run_start_ticks_;
+  uint64_t last_report_ticks_ ABSL_GUARDED_BY(report_lock_);
+};
+
+namespace detail {
+// Times a profiled call. The time of the calls to the next layer is recorded
+// in |frame_| by the `NextLayerFunction`s, and subtracted.
+class OverheadScope {
+ public:
+  OverheadScope(LayerOverheadProfiler* profiler, size_t function_index)
+      : profiler_(profiler),
+        function_index_(function_index),
+        parent_(current_overhead_frame),
+        start_ticks_(ReadOverheadTicks()) {
+    current_overhead_frame = &frame_;
+  }
+
+  ~OverheadScope() {
+    const uint64_t end_ticks = ReadOverheadTicks();
+    current_overhead_frame = parent_;
+    profiler_->RecordCall(function_index_,
+                          end_ticks - start_ticks_ - frame_.next_layer_ticks,
+                          end_ticks);
+  }
+
+ private:
+  LayerOverheadProfiler* profiler_;
+  size_t function_index_;
+  OverheadFrame* parent_;
+  OverheadFrame frame_;
+  uint64_t start_ticks_;
+};
+
+// Adds the duration of a call to the next layer to |frame|.
+class NextLayerScope {
+ public:
+  explicit NextLayerScope(OverheadFrame* frame)
+      : frame_(frame), start_ticks_(ReadOverheadTicks()) {}
+
+  ~NextLayerScope() {
+    frame_->next_layer_ticks += ReadOverheadTicks() - start_ticks_;
+  }
+
+ private:
+  OverheadFrame* frame_;
+  uint64_t start_ticks_;
+};
+}  // namespace detail
+
+// A trampoline calling the intercepted function |Func| as the function
+// |FunctionIndex| of |Profiler|. Used by SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE.
+template <auto Func, LayerOverheadProfiler* Profiler, size_t FunctionIndex>
+struct ProfiledFunction;
+
+template <typename ReturnT, typename... ArgsT,
+          ReturnT(VKAPI_PTR* Func)(ArgsT...), LayerOverheadProfiler* Profiler,
+          size_t FunctionIndex>
+struct ProfiledFunction<Func, Profiler, FunctionIndex> {
+  static VKAPI_ATTR ReturnT VKAPI_CALL Call(ArgsT... args) {
+    detail::OverheadScope scope(Profiler, FunctionIndex);
+    return Func(args...);
+  }
+};
+
+// A function of the next layer, as returned by `LayerData::GetNext*ProcAddr`.
+// Converts to the plain function pointer. Calling it directly excludes the
+// call from the overhead of the calling function when the layers are
+// profiled; otherwise it costs a thread-local load.
+template <typename FuncPtrT>
+class NextLayerFunction;
+
+template <typename ReturnT, typename... ArgsT>
+class NextLayerFunction<ReturnT(VKAPI_PTR*)(ArgsT...)> {
+ public:
+  using FuncPtrT = ReturnT(VKAPI_PTR*)(ArgsT...);
+
+  NextLayerFunction(FuncPtrT func) : func_(func) {}
+
+  operator FuncPtrT() const { return func_; }
+
+  ReturnT operator()(ArgsT... args) const {
+    detail::OverheadFrame* frame = detail::current_overhead_frame;
+    if (ABSL_PREDICT_TRUE(frame == nullptr)) return func_(args...);
+    detail::NextLayerScope scope(frame);
+    return func_(args...);
+  }
+
+ private:
+  FuncPtrT func_;
+};
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LAYER_OVERHEAD_PROFILER_H_
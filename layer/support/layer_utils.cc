@@ -46,34 +46,4 @@ TimestampClock::time_point GetTimestamp() { return TimestampClock::now(); }
 
 DurationClock::time_point Now() { return DurationClock::now(); }
 
-FunctionInterceptor::FunctionInterceptor(
-    InterceptedVulkanFunc intercepted_function) {
-  FunctionNameToPtr& registered_functions = GetInterceptedFunctions();
-  assert(registered_functions.count(
-             intercepted_function.vulkan_function_name) == 0 &&
-         "Already registered");
-  registered_functions[intercepted_function.vulkan_function_name] =
-      intercepted_function.layer_function;
-}
-
-PFN_vkVoidFunction FunctionInterceptor::GetInterceptedOrNull(
-    std::string_view vk_function_name) {
-  assert(!vk_function_name.empty());
-  assert(vk_function_name.find("vk") == 0 &&
-         "Vulkan function names must start with 'vk'.");
-  FunctionNameToPtr& registered_functions = GetInterceptedFunctions();
-  if (auto it = registered_functions.find(vk_function_name);
-      it != registered_functions.end())
-    return it->second;
-  return nullptr;
-}
-
-FunctionInterceptor::FunctionNameToPtr&
-FunctionInterceptor::GetInterceptedFunctions() {
-  static auto* registered_functions =
-      new FunctionInterceptor::FunctionNameToPtr();
-  assert(registered_functions);
-  return *registered_functions;
-}
-
 }  // namespace performancelayers
@@ -15,13 +15,17 @@
 #ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_UTILS_H_
 #define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_UTILS_H_
 
+#include <cassert>
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
 #include <ratio>
 #include <string>
+#include <string_view>
+#include <utility>
 
-#include "absl/container/flat_hash_map.h"
+#include "layer/support/intercepted_function_table.h"
+#include "layer/support/layer_overhead_profiler.h"
 #include "vulkan/vulkan.h"
 #include "vulkan/vulkan_core.h"
 
@@ -185,81 +189,16 @@ class Timestamp {
   TimestampClock::time_point timestamp_;
 };
 
-// Represents a type-erased layer function pointer intercepting a known
-// Vulkan function. Should be constructed with the type safe |Create|
-// function.
-// Note: This is an internal code, do not use directly. See
-//       SPL_INTERCEPTED_VULKAN_FUNC below for more details.
-//
-// Sample use:
-//   auto intercepted_func =
-//     InterceptedVulkanFunc::Create<&vkDestroyDevice,
-//                                   &MyLayer_DestroyDevice>("vkDestroyDevice");
-//
-// This will check that the two function pointers have the same type.
-struct InterceptedVulkanFunc {
-  template <auto VulkanFuncPtr, auto LayerFuncPtr>
-  static InterceptedVulkanFunc Create(const char* vulkan_func_name) {
-    static_assert(
-        std::is_same_v<decltype(VulkanFuncPtr), decltype(LayerFuncPtr)>,
-        "Vulkan and Layer function types do not match. Does your Layer "
-        "function have the right signature?");
-    assert(vulkan_func_name);
-
-    std::string_view vulkan_func_str(vulkan_func_name);
-    (void)vulkan_func_str;
-    assert(!vulkan_func_str.empty());
-    assert(vulkan_func_str.find("vk") == 0 &&
-           "Vulkan function names must start with 'vk'.");
-
-    return {vulkan_func_name,
-            reinterpret_cast<PFN_vkVoidFunction>(LayerFuncPtr)};
-  }
-
-  const char* vulkan_function_name;
-  PFN_vkVoidFunction layer_function;
-};
-
-// Helper class to automatically register intercepted Vulkan functions.
-// Maintains a global map of all intercepted functions. Adds new map entries
-// into this map upon constructions. Expects each function to be registered at
-// most once.
-//
-// Layer code can check if a vulkan function has been registered by calling:
-//   performancelayers::FunctionInterceptor::GetInterceptedOrNull(vk_name)
-class FunctionInterceptor {
- public:
-  FunctionInterceptor(InterceptedVulkanFunc intercepted_function);
-
-  FunctionInterceptor(const FunctionInterceptor&) = delete;
-  FunctionInterceptor(FunctionInterceptor&&) = delete;
-  FunctionInterceptor& operator=(const FunctionInterceptor&) = delete;
-  FunctionInterceptor& operator=(FunctionInterceptor&&) = delete;
-
-  static PFN_vkVoidFunction GetInterceptedOrNull(
-      std::string_view vk_function_name);
-
- private:
-  using FunctionNameToPtr =
-      absl::flat_hash_map<std::string_view, PFN_vkVoidFunction>;
-
-  static FunctionNameToPtr& GetInterceptedFunctions();
-};
-
 // Function attributes for intercepted vulkan functions. These are added
 // automatically by SPL_INTERCEPTED_VULKAN_FUNC.
 #define SPL_LAYER_FUNCTION_ATTRIBUTES(RETURN_TYPE_) \
   VKAPI_ATTR RETURN_TYPE_ VKAPI_CALL
 
-#define SPL_INTERNAL_CAT_IMPL_(X_, Y_) X_##Y_
-#define SPL_INTERNAL_CAT_(X_, Y_) SPL_INTERNAL_CAT_IMPL_(X_, Y_)
-
-// Creates a layer function declaration and automatically registers this
-// functions in the layer-global map of intercepted Vulkan functions.
-// This macro *must* be used to define all intercepted functions.
-//
-// This also makes sure that the overriden
-// Vulkan function has the same signature as the layer function being defined.
+// Creates a layer function declaration and definition. This macro *must* be
+// used to define all intercepted functions, and every function defined with it
+// must be listed in the layer's function list, see
+// SPL_DECLARE_INTERCEPTED_FUNCTIONS below. An unlisted function fails to
+// compile.
 //
 // Sample use:
 // 1. Define a layer-specific macro:
@@ -277,17 +216,108 @@ class FunctionInterceptor {
 //   VkResult MyLayer_QueuePresentKHR(VkQueue q, const VkPresentInfoKHR *pi) {
 //     ... function body ...
 //
-#define SPL_INTERCEPTED_VULKAN_FUNC(RETURN_TYPE_, LAYER_PREFIX_, FUNC_NAME_,   \
-                                    FUNC_ARGS_)                                \
-  SPL_LAYER_FUNCTION_ATTRIBUTES(RETURN_TYPE_)                                  \
-  LAYER_PREFIX_##FUNC_NAME_ FUNC_ARGS_;                                        \
-  static const auto* const SPL_INTERNAL_CAT_(kSPL_internal_intercepted_func_,  \
-                                             __LINE__) =                       \
-      new performancelayers::FunctionInterceptor(                              \
-          performancelayers::InterceptedVulkanFunc::Create<                    \
-              &vk##FUNC_NAME_, &LAYER_PREFIX_##FUNC_NAME_>("vk" #FUNC_NAME_)); \
+#define SPL_INTERCEPTED_VULKAN_FUNC(RETURN_TYPE_, LAYER_PREFIX_, FUNC_NAME_, \
+                                    FUNC_ARGS_)                              \
+  SPL_LAYER_FUNCTION_ATTRIBUTES(RETURN_TYPE_)                                \
+  LAYER_PREFIX_##FUNC_NAME_ FUNC_ARGS_;                                      \
+  static_assert(                                                             \
+      LAYER_PREFIX_##kInterceptedFunctionTable.Contains("vk" #FUNC_NAME_),   \
+      "vk" #FUNC_NAME_ " is not in the layer's intercepted functions.");     \
   RETURN_TYPE_ LAYER_PREFIX_##FUNC_NAME_ FUNC_ARGS_
 
+#define SPL_INTERNAL_INTERCEPTED_FUNC_NAME_(LAYER_PREFIX_, FUNC_NAME_) \
+  "vk" #FUNC_NAME_,
+
+// The static_cast makes sure that the layer function has the same signature as
+// the Vulkan function it overrides.
+#define SPL_INTERNAL_INTERCEPTED_FUNC_PTR_(LAYER_PREFIX_, FUNC_NAME_) \
+  reinterpret_cast<PFN_vkVoidFunction>(                                \
+      static_cast<PFN_vk##FUNC_NAME_>(&LAYER_PREFIX_##FUNC_NAME_)),
+
+// A trampoline recording the layer's overhead in the function, see
+// LayerOverheadProfiler.
+#define SPL_INTERNAL_PROFILED_FUNC_PTR_(LAYER_PREFIX_, FUNC_NAME_)            \
+  reinterpret_cast<PFN_vkVoidFunction>(                                       \
+      &performancelayers::ProfiledFunction<                                   \
+          static_cast<PFN_vk##FUNC_NAME_>(&LAYER_PREFIX_##FUNC_NAME_),        \
+          &LAYER_PREFIX_##kOverheadProfiler,                                  \
+          LAYER_PREFIX_##kInterceptedFunctionTable.Find("vk" #FUNC_NAME_)>::  \
+          Call),
+
+// Declares the functions intercepted by a layer, and defines the table of their
+// names looked up with SPL_GET_INTERCEPTED_VULKAN_FUNC. The table is a perfect
+// hash built at compile time, so it doesn't depend on static initialization
+// and a lookup doesn't allocate or lock.
+//
+// |FUNC_LIST_| is a macro listing the functions by their Vulkan names without
+// the "vk" prefix, including the GetDeviceProcAddr and GetInstanceProcAddr
+// entry points. Place the declaration before the intercepted functions, which
+// SPL_INTERCEPTED_VULKAN_FUNC checks against the table.
+//
+// Sample use:
+//   #define SPL_MY_LAYER_FUNCS(X_, LAYER_PREFIX_)
+//     X_(LAYER_PREFIX_, QueuePresentKHR)
+//     X_(LAYER_PREFIX_, GetDeviceProcAddr)
+//     X_(LAYER_PREFIX_, GetInstanceProcAddr)
+//
+//   SPL_DECLARE_INTERCEPTED_FUNCTIONS(MyLayer_, SPL_MY_LAYER_FUNCS);
+#define SPL_DECLARE_INTERCEPTED_FUNCTIONS(LAYER_PREFIX_, FUNC_LIST_)         \
+  constexpr std::string_view LAYER_PREFIX_##kInterceptedFunctionNames[] = {  \
+      FUNC_LIST_(SPL_INTERNAL_INTERCEPTED_FUNC_NAME_, LAYER_PREFIX_)};       \
+  constexpr performancelayers::InterceptedFunctionTable                      \
+      LAYER_PREFIX_##kInterceptedFunctionTable(                              \
+          LAYER_PREFIX_##kInterceptedFunctionNames);                         \
+  static_assert(LAYER_PREFIX_##kInterceptedFunctionTable.IsValid(),          \
+                "Intercepted functions must be listed only once.")
+
+// Defines the functions intercepting the names declared with
+// SPL_DECLARE_INTERCEPTED_FUNCTIONS, parallel to its table.
+//
+// Also defines the layer's LayerOverheadProfiler, |LAYER_PREFIX_| followed by
+// kOverheadProfiler, and a trampoline for every function that records the
+// time spent in the layer. The trampolines are looked up instead of the
+// functions when the overhead of the layers is profiled.
+//
+// Finally defines |LAYER_PREFIX_| followed by GetInterceptedProcAddr, which
+// returns SPL_GET_INTERCEPTED_VULKAN_FUNC for a name. The combined layer uses
+// it to find the modules intercepting a function without going down their
+// chains.
+//
+// |FUNC_LIST_| is the list given to SPL_DECLARE_INTERCEPTED_FUNCTIONS. This
+// macro declares the GetDeviceProcAddr and GetInstanceProcAddr entry points.
+// Place the table after the other intercepted functions and before the entry
+// points.
+//
+// Sample use:
+//   SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE(MyLayer_, SPL_MY_LAYER_FUNCS);
+#define SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE(LAYER_PREFIX_, FUNC_LIST_)       \
+  SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)      \
+      LAYER_PREFIX_##GetDeviceProcAddr(VkDevice device, const char* name);     \
+  SPL_LAYER_ENTRY_POINT SPL_LAYER_FUNCTION_ATTRIBUTES(PFN_vkVoidFunction)      \
+      LAYER_PREFIX_##GetInstanceProcAddr(VkInstance instance,                  \
+                                         const char* name);                    \
+  const PFN_vkVoidFunction LAYER_PREFIX_##kInterceptedFunctions[] = {          \
+      FUNC_LIST_(SPL_INTERNAL_INTERCEPTED_FUNC_PTR_, LAYER_PREFIX_) nullptr};  \
+  performancelayers::LayerOverheadProfiler LAYER_PREFIX_##kOverheadProfiler(   \
+      #LAYER_PREFIX_, LAYER_PREFIX_##kInterceptedFunctionNames);               \
+  const PFN_vkVoidFunction LAYER_PREFIX_##kProfiledInterceptedFunctions[] = {  \
+      FUNC_LIST_(SPL_INTERNAL_PROFILED_FUNC_PTR_, LAYER_PREFIX_) nullptr};     \
+  PFN_vkVoidFunction LAYER_PREFIX_##GetInterceptedProcAddr(const char* name) { \
+    return SPL_GET_INTERCEPTED_VULKAN_FUNC(LAYER_PREFIX_, name);               \
+  }                                                                            \
+  PFN_vkVoidFunction LAYER_PREFIX_##GetInterceptedProcAddr(const char* name)
+
+// Returns the function intercepting the Vulkan function |VK_FUNC_NAME_| in the
+// table defined with SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE and |LAYER_PREFIX_|,
+// or nullptr if the layer doesn't intercept it. Returns its profiling
+// trampoline if the overhead of the layers is profiled.
+#define SPL_GET_INTERCEPTED_VULKAN_FUNC(LAYER_PREFIX_, VK_FUNC_NAME_)        \
+  (performancelayers::IsLayerOverheadProfilingEnabled()                      \
+       ? LAYER_PREFIX_##kProfiledInterceptedFunctions                        \
+             [LAYER_PREFIX_##kInterceptedFunctionTable.Find(VK_FUNC_NAME_)]  \
+       : LAYER_PREFIX_##kInterceptedFunctions                                \
+             [LAYER_PREFIX_##kInterceptedFunctionTable.Find(VK_FUNC_NAME_)])
+
 }  // namespace performancelayers
 
 #endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_UTILS_H_
@@ -17,7 +17,8 @@
 #include "layer/support/debug_logging.h"
 
 namespace performancelayers {
-FileOutput::FileOutput(const char *filename) {
+FileOutput::FileOutput(const char *filename, bool flush_every_line)
+    : flush_every_line_(flush_every_line) {
   if (!filename) {
     out_ = stderr;
     return;
@@ -38,7 +39,7 @@ void FileOutput::LogLine(std::string_view line) {
   assert(line.find('\n') == std::string_view::npos && "Expected single line.");
   const int line_len = line.length();
   fprintf(out_, "%.*s\n", line_len, line.data());
-  Flush();
+  if (flush_every_line_) Flush();
 }
 
 }  // namespace performancelayers
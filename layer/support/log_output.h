@@ -30,12 +30,15 @@ class LogOutput {
 };
 
 // Implements LogOutput for a file. If the given filename is `nullptr`, it
-// writes to the standard output. After each write, the logs are persisted to
-// the file by calling `fflush`. Since only one line is written to the output by
-// each `LogLine()` call, it doens't need to aquire a mutex.
+// writes to the standard output. Unless |flush_every_line| is false, the logs
+// are persisted to the file by calling `fflush` after each write. Since only
+// one line is written to the output by each `LogLine()` call, it doens't need
+// to aquire a mutex. Without |flush_every_line|, lines are written when the
+// buffer fills up, possibly split, so files shared with other outputs must
+// flush every line.
 class FileOutput : public LogOutput {
  public:
-  FileOutput(const char *filename);
+  FileOutput(const char *filename, bool flush_every_line = true);
 
   ~FileOutput() {
     if (out_ && out_ != stderr) {
@@ -52,6 +55,7 @@ class FileOutput : public LogOutput {
 
  private:
   FILE *out_ = nullptr;
+  const bool flush_every_line_;
 };
 
 // This class is used for testing. It writes the data to a string
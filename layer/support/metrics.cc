@@ -0,0 +1,179 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/support/metrics.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <thread>
+
+#include "absl/strings/str_cat.h"
+#include "layer/support/metrics_exporter.h"
+
+namespace performancelayers {
+namespace {
+// The number of times a reader tries to copy a page being updated.
+constexpr int kMaxPageReadAttempts = 100;
+
+const char* GetPrometheusType(MetricKind kind) {
+  switch (kind) {
+    case MetricKind::kCounter:
+      return "counter";
+    case MetricKind::kGauge:
+      return "gauge";
+    case MetricKind::kHistogram:
+      return "histogram";
+  }
+  return "untyped";
+}
+}  // namespace
+
+int64_t GetHistogramBucketBound(size_t bucket) {
+  assert(bucket < kNumHistogramBuckets);
+  if (bucket + 1 >= kNumHistogramBuckets)
+    return std::numeric_limits<int64_t>::max();
+  return (int64_t(1) << bucket) - 1;
+}
+
+MetricsRegistry* MetricsRegistry::Get() {
+  static MetricsRegistry registry;
+  // Don't use new -- the exporter must stop before the layer gets unloaded,
+  // and it is destroyed before the registry it reads.
+  static const std::unique_ptr<MetricsExporter> exporter =
+      MetricsExporter::FromLayerConfig(&registry);
+  return &registry;
+}
+
+MetricCell* MetricsRegistry::GetCell(absl::string_view name, MetricKind kind) {
+  name = name.substr(0, kMaxMetricNameSize - 1);
+  absl::MutexLock lock(&lock_);
+  const size_t num_cells = num_cells_.load(std::memory_order_relaxed);
+  for (size_t i = 0; i != num_cells; ++i) {
+    MetricCell& cell = cells_[i];
+    if (name != cell.name) continue;
+    assert(cell.kind == kind && "Metric registered with another kind");
+    return cell.kind == kind ? &cell : &overflow_cell_;
+  }
+  if (num_cells == kMaxMetrics) return &overflow_cell_;
+
+  MetricCell& cell = cells_[num_cells];
+  cell.kind = kind;
+  memcpy(cell.name, name.data(), name.size());
+  // Publish the name and kind to `Collect()`.
+  num_cells_.store(num_cells + 1, std::memory_order_release);
+  return &cell;
+}
+
+std::vector<MetricValues> MetricsRegistry::Collect() const {
+  const size_t num_cells = num_cells_.load(std::memory_order_acquire);
+  std::vector<MetricValues> metrics(num_cells);
+  for (size_t i = 0; i != num_cells; ++i) {
+    const MetricCell& cell = cells_[i];
+    MetricValues& values = metrics[i];
+    memcpy(values.name, cell.name, sizeof(values.name));
+    values.kind = cell.kind;
+    values.sum = cell.sum.load(std::memory_order_relaxed);
+    if (cell.kind != MetricKind::kHistogram) {
+      values.value = cell.value.load(std::memory_order_relaxed);
+      continue;
+    }
+    for (size_t bucket = 0; bucket != kNumHistogramBuckets; ++bucket) {
+      values.buckets[bucket] =
+          cell.buckets[bucket].load(std::memory_order_relaxed);
+      values.value += values.buckets[bucket];
+    }
+  }
+  return metrics;
+}
+
+void PublishMetrics(const std::vector<MetricValues>& metrics, int64_t pid,
+                    int64_t publish_time_ns, MetricsPage* page) {
+  const uint64_t sequence = page->sequence.load(std::memory_order_relaxed);
+  page->sequence.store(sequence + 1, std::memory_order_relaxed);
+  // Order the odd sequence before the updates below.
+  std::atomic_thread_fence(std::memory_order_release);
+
+  page->pid = pid;
+  page->publish_time_ns = publish_time_ns;
+  const size_t num_metrics = std::min(metrics.size(), kMaxMetrics);
+  page->num_metrics = num_metrics;
+  memcpy(page->metrics, metrics.data(), num_metrics * sizeof(MetricValues));
+
+  page->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool ReadMetricsPage(const MetricsPage& page, MetricsPageContents* contents) {
+  assert(contents);
+  if (page.magic != MetricsPage::kMagic ||
+      page.version != MetricsPage::kVersion) {
+    return false;
+  }
+
+  for (int attempt = 0; attempt != kMaxPageReadAttempts; ++attempt) {
+    const uint64_t sequence = page.sequence.load(std::memory_order_acquire);
+    if (sequence % 2 != 0) {
+      std::this_thread::yield();
+      continue;
+    }
+    contents->pid = page.pid;
+    contents->publish_time_ns = page.publish_time_ns;
+    const size_t num_metrics =
+        std::min<size_t>(page.num_metrics, kMaxMetrics);
+    contents->metrics.resize(num_metrics);
+    memcpy(contents->metrics.data(), page.metrics,
+           num_metrics * sizeof(MetricValues));
+    // Order the copy before checking that the page didn't change under it.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (page.sequence.load(std::memory_order_relaxed) == sequence) {
+      for (MetricValues& metric : contents->metrics)
+        metric.name[kMaxMetricNameSize - 1] = '\0';
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string FormatPrometheusText(const std::vector<MetricValues>& metrics) {
+  std::string text;
+  for (const MetricValues& metric : metrics) {
+    const absl::string_view name = metric.name;
+    absl::StrAppend(&text, "# TYPE ", name, " ",
+                    GetPrometheusType(metric.kind), "\n");
+    if (metric.kind != MetricKind::kHistogram) {
+      absl::StrAppend(&text, name, " ", metric.value, "\n");
+      continue;
+    }
+
+    size_t last_bucket = kNumHistogramBuckets - 1;
+    while (last_bucket > 0 && metric.buckets[last_bucket] == 0) --last_bucket;
+    uint64_t cumulative_count = 0;
+    for (size_t bucket = 0;
+         bucket <= last_bucket && bucket + 1 < kNumHistogramBuckets;
+         ++bucket) {
+      cumulative_count += metric.buckets[bucket];
+      absl::StrAppend(&text, name, "_bucket{le=\"",
+                      GetHistogramBucketBound(bucket), "\"} ",
+                      cumulative_count, "\n");
+    }
+    absl::StrAppend(&text, name, "_bucket{le=\"+Inf\"} ", metric.value, "\n",
+                    name, "_sum ", metric.sum, "\n", name, "_count ",
+                    metric.value, "\n");
+  }
+  return text;
+}
+
+}  // namespace performancelayers
@@ -0,0 +1,207 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_METRICS_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/numeric/bits.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+
+namespace performancelayers {
+enum class MetricKind : uint32_t { kCounter, kGauge, kHistogram };
+
+// The number of metrics a registry holds. Metrics registered past it are
+// recorded but not exported.
+constexpr size_t kMaxMetrics = 64;
+// The size of a metric name, including the terminating null character.
+constexpr size_t kMaxMetricNameSize = 64;
+// Histogram bucket 0 counts the values <= 0, bucket i in [1, 31) the values
+// in [2^(i-1), 2^i), and the last bucket all larger values.
+constexpr size_t kNumHistogramBuckets = 32;
+
+// Returns the histogram bucket of |value|.
+inline size_t GetHistogramBucket(int64_t value) {
+  if (value <= 0) return 0;
+  const size_t bucket = absl::bit_width(static_cast<uint64_t>(value));
+  return bucket < kNumHistogramBuckets ? bucket : kNumHistogramBuckets - 1;
+}
+
+// Returns the largest value counted by histogram bucket |bucket|, or
+// INT64_MAX for the last bucket.
+int64_t GetHistogramBucketBound(size_t bucket);
+
+// The values of a metric at one point in time. Trivially copyable, as it is
+// also the layout of the metrics in `MetricsPage`.
+struct MetricValues {
+  char name[kMaxMetricNameSize] = {};
+  MetricKind kind = MetricKind::kCounter;
+  // The value of a counter or a gauge, or the number of values recorded in a
+  // histogram.
+  int64_t value = 0;
+  // The sum of the values recorded in a histogram.
+  int64_t sum = 0;
+  uint64_t buckets[kNumHistogramBuckets] = {};
+};
+
+// The storage of a metric, updated with relaxed atomics only.
+struct MetricCell {
+  MetricKind kind = MetricKind::kCounter;
+  char name[kMaxMetricNameSize] = {};
+  std::atomic<int64_t> value = 0;
+  std::atomic<int64_t> sum = 0;
+  std::array<std::atomic<uint64_t>, kNumHistogramBuckets> buckets = {};
+};
+
+// A monotonically increasing count, e.g., of frames presented.
+class Counter {
+ public:
+  void Add(int64_t delta = 1) {
+    cell_->value.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+ private:
+  friend class MetricsRegistry;
+  explicit Counter(MetricCell* cell) : cell_(cell) {}
+  MetricCell* cell_;
+};
+
+// A value that goes up and down, e.g., the allocated device memory.
+class Gauge {
+ public:
+  void Set(int64_t value) {
+    cell_->value.store(value, std::memory_order_relaxed);
+  }
+  void Add(int64_t delta) {
+    cell_->value.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+ private:
+  friend class MetricsRegistry;
+  explicit Gauge(MetricCell* cell) : cell_(cell) {}
+  MetricCell* cell_;
+};
+
+// A distribution of values, e.g., of frame times, in power of two buckets.
+class Histogram {
+ public:
+  void Record(int64_t value) {
+    cell_->buckets[GetHistogramBucket(value)].fetch_add(
+        1, std::memory_order_relaxed);
+    cell_->sum.fetch_add(value, std::memory_order_relaxed);
+  }
+
+ private:
+  friend class MetricsRegistry;
+  explicit Histogram(MetricCell* cell) : cell_(cell) {}
+  MetricCell* cell_;
+};
+
+// Holds the live metrics of the layers, to be read while the application runs
+// rather than from the logs afterwards. Registering a metric takes a lock, so
+// the layers register theirs once, when they are created; updating a metric
+// is a relaxed atomic operation. Sample use:
+// ```c++
+// Counter frames = MetricsRegistry::Get()->GetCounter("frames_total");
+// frames.Add();
+// ```
+class MetricsRegistry {
+ public:
+  // Returns the registry of the layers in this library. Also starts exporting
+  // the metrics, if `MetricsExporter` is configured.
+  static MetricsRegistry* Get();
+
+  MetricsRegistry() = default;
+  MetricsRegistry(const MetricsRegistry&) = delete;
+  MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+  // Returns the metric |name|, registering it first if needed. Names are
+  // truncated to fit `kMaxMetricNameSize`, and should follow the Prometheus
+  // conventions, e.g., "frame_time_us". A name can only be used for one kind
+  // of metric.
+  Counter GetCounter(absl::string_view name) {
+    return Counter(GetCell(name, MetricKind::kCounter));
+  }
+  Gauge GetGauge(absl::string_view name) {
+    return Gauge(GetCell(name, MetricKind::kGauge));
+  }
+  Histogram GetHistogram(absl::string_view name) {
+    return Histogram(GetCell(name, MetricKind::kHistogram));
+  }
+
+  // Returns the current values of the registered metrics. The values of one
+  // metric are read one by one, so they are only consistent with each other
+  // when no update races with the read; the count of a histogram is always
+  // the sum of its buckets.
+  std::vector<MetricValues> Collect() const;
+
+ private:
+  MetricCell* GetCell(absl::string_view name, MetricKind kind);
+
+  absl::Mutex lock_;
+  std::array<MetricCell, kMaxMetrics> cells_;
+  // The number of registered cells. Only grows, and the cells below it are
+  // immutable except for their values.
+  std::atomic<size_t> num_cells_ = 0;
+  // Shared by the metrics that don't fit in |cells_|, never exported.
+  MetricCell overflow_cell_;
+};
+
+// The metrics as published in shared memory by `MetricsExporter`, guarded by
+// a sequence lock: the writer makes |sequence| odd while it updates the page,
+// and readers retry until they copy the page with the same even |sequence|
+// before and after. Readers never block the writer.
+struct MetricsPage {
+  static constexpr uint32_t kMagic = 0x4d4c5053;  // "SPLM"
+  static constexpr uint32_t kVersion = 1;
+
+  uint32_t magic = kMagic;
+  uint32_t version = kVersion;
+  std::atomic<uint64_t> sequence = 0;
+  int64_t pid = 0;
+  // The wall clock time of the last update, in nanoseconds since the epoch.
+  int64_t publish_time_ns = 0;
+  uint32_t num_metrics = 0;
+  MetricValues metrics[kMaxMetrics];
+};
+
+// Writes |metrics| to |page|. There must be only one writer per page.
+void PublishMetrics(const std::vector<MetricValues>& metrics, int64_t pid,
+                    int64_t publish_time_ns, MetricsPage* page);
+
+// A consistent copy of a `MetricsPage`.
+struct MetricsPageContents {
+  int64_t pid = 0;
+  int64_t publish_time_ns = 0;
+  std::vector<MetricValues> metrics;
+};
+
+// Copies the metrics of |page|. Returns false if |page| is not a metrics page
+// of this version, or if no consistent copy was made after a few retries.
+bool ReadMetricsPage(const MetricsPage& page, MetricsPageContents* contents);
+
+// Returns |metrics| in the Prometheus text exposition format. Histograms have
+// cumulative "le" buckets, up to the last non-empty one.
+std::string FormatPrometheusText(const std::vector<MetricValues>& metrics);
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_METRICS_H_
@@ -0,0 +1,297 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/support/metrics_exporter.h"
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <string_view>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "layer/support/debug_logging.h"
+#include "layer/support/layer_config.h"
+
+namespace performancelayers {
+namespace {
+// How long a client has to send its request, and to receive the response.
+constexpr int kClientRequestTimeoutMs = 100;
+constexpr int kClientSendTimeoutS = 1;
+
+// Returns the name of the library this function is linked into, without the
+// "lib" prefix and the extension, e.g., "VkLayer_stadia_frame_time".
+std::string GetLibraryName() {
+  Dl_info info = {};
+  if (dladdr(reinterpret_cast<void*>(&GetLibraryName), &info) == 0 ||
+      !info.dli_fname) {
+    return "unknown";
+  }
+  std::string_view name = info.dli_fname;
+  if (size_t slash = name.rfind('/'); slash != std::string_view::npos)
+    name.remove_prefix(slash + 1);
+  if (name.substr(0, 3) == "lib") name.remove_prefix(3);
+  name = name.substr(0, name.find('.'));
+  return std::string(name);
+}
+
+// Returns |name| as a POSIX shared memory object name, which starts with a
+// slash.
+std::string ToShmName(std::string_view name) {
+  return name.substr(0, 1) == "/" ? std::string(name)
+                                  : "/" + std::string(name);
+}
+
+// Writes all of |data| to the socket |fd|. Returns false on error.
+bool SendAll(int fd, std::string_view data) {
+  while (!data.empty()) {
+    const ssize_t sent = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) return false;
+    data.remove_prefix(sent);
+  }
+  return true;
+}
+}  // namespace
+
+std::unique_ptr<MetricsExporter> MetricsExporter::FromLayerConfig(
+    const MetricsRegistry* registry) {
+  const LayerConfig::Common& config = GetLayerConfig().common;
+  if (config.metrics_shm.empty() && config.metrics_socket.empty())
+    return nullptr;
+
+  const std::string library_name = GetLibraryName();
+  Options options;
+  if (!config.metrics_shm.empty()) {
+    options.shm_name =
+        absl::StrCat(ToShmName(config.metrics_shm), ".", library_name);
+  }
+  if (!config.metrics_socket.empty()) {
+    options.socket_path =
+        absl::StrCat(config.metrics_socket, ".", library_name);
+  }
+  options.period_ms = std::max<uint64_t>(config.metrics_period_ms, 1);
+
+  auto exporter = std::make_unique<MetricsExporter>(registry, options);
+  if (!exporter->Start()) return nullptr;
+  return exporter;
+}
+
+MetricsExporter::MetricsExporter(const MetricsRegistry* registry,
+                                 Options options)
+    : registry_(registry), options_(std::move(options)) {
+  assert(registry_);
+}
+
+MetricsExporter::~MetricsExporter() {
+  if (thread_.joinable()) {
+    const char stop = 1;
+    while (write(stop_write_fd_, &stop, 1) < 0 && errno == EINTR) {
+    }
+    thread_.join();
+  }
+  if (stop_read_fd_ >= 0) close(stop_read_fd_);
+  if (stop_write_fd_ >= 0) close(stop_write_fd_);
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+    unlink(options_.socket_path.c_str());
+  }
+  if (page_) {
+    munmap(page_, sizeof(MetricsPage));
+    shm_unlink(options_.shm_name.c_str());
+  }
+}
+
+bool MetricsExporter::Start() {
+  assert(!thread_.joinable() && "The exporter is already started");
+  if (!options_.shm_name.empty() && !CreatePage()) return false;
+  if (!options_.socket_path.empty() && !CreateSocket()) return false;
+
+  int stop_fds[2] = {-1, -1};
+  if (pipe2(stop_fds, O_CLOEXEC) != 0) {
+    SPL_LOG(ERROR) << "Cannot create the metrics exporter pipe: "
+                   << strerror(errno);
+    return false;
+  }
+  stop_read_fd_ = stop_fds[0];
+  stop_write_fd_ = stop_fds[1];
+  thread_ = std::thread([this] { Run(); });
+  return true;
+}
+
+bool MetricsExporter::CreatePage() {
+  const int fd = shm_open(options_.shm_name.c_str(),
+                          O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    SPL_LOG(ERROR) << "Cannot create the metrics page " << options_.shm_name
+                   << ": " << strerror(errno);
+    return false;
+  }
+  void* memory = MAP_FAILED;
+  if (ftruncate(fd, sizeof(MetricsPage)) == 0) {
+    memory = mmap(nullptr, sizeof(MetricsPage), PROT_READ | PROT_WRITE,
+                  MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (memory == MAP_FAILED) {
+    SPL_LOG(ERROR) << "Cannot map the metrics page " << options_.shm_name
+                   << ": " << strerror(errno);
+    shm_unlink(options_.shm_name.c_str());
+    return false;
+  }
+  page_ = new (memory) MetricsPage();
+  return true;
+}
+
+bool MetricsExporter::CreateSocket() {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (options_.socket_path.size() >= sizeof(address.sun_path)) {
+    SPL_LOG(ERROR) << "The metrics socket path is too long: "
+                   << options_.socket_path;
+    return false;
+  }
+  memcpy(address.sun_path, options_.socket_path.data(),
+         options_.socket_path.size());
+
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  // Replace the socket left behind by a previous run, if any.
+  unlink(options_.socket_path.c_str());
+  if (listen_fd_ < 0 ||
+      bind(listen_fd_, reinterpret_cast<sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      listen(listen_fd_, /*backlog=*/4) != 0) {
+    SPL_LOG(ERROR) << "Cannot serve the metrics on " << options_.socket_path
+                   << ": " << strerror(errno);
+    if (listen_fd_ >= 0) close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+  return true;
+}
+
+void MetricsExporter::Run() {
+  using Clock = std::chrono::steady_clock;
+  const auto period = std::chrono::milliseconds(options_.period_ms);
+  Clock::time_point next_publish = Clock::now();
+  while (true) {
+    int timeout_ms = -1;
+    if (page_) {
+      const Clock::time_point now = Clock::now();
+      if (now >= next_publish) {
+        PublishMetrics(registry_->Collect(), getpid(),
+                       absl::ToUnixNanos(absl::Now()), page_);
+        next_publish = now + period;
+      }
+      timeout_ms = static_cast<int>(
+          std::chrono::ceil<std::chrono::milliseconds>(next_publish - now)
+              .count());
+    }
+
+    pollfd fds[2] = {{stop_read_fd_, POLLIN, 0}, {listen_fd_, POLLIN, 0}};
+    const nfds_t num_fds = listen_fd_ >= 0 ? 2 : 1;
+    if (poll(fds, num_fds, timeout_ms) < 0 && errno != EINTR) {
+      SPL_LOG(ERROR) << "Metrics export stopped: " << strerror(errno);
+      return;
+    }
+    if (fds[0].revents != 0) break;
+    if (num_fds == 2 && (fds[1].revents & POLLIN)) {
+      const int client_fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+      if (client_fd >= 0) ServeClient(client_fd);
+    }
+  }
+  // Leave the final values to the readers.
+  if (page_) {
+    PublishMetrics(registry_->Collect(), getpid(),
+                   absl::ToUnixNanos(absl::Now()), page_);
+  }
+}
+
+void MetricsExporter::ServeClient(int client_fd) {
+  // Consume the HTTP request, if any, so that closing the connection doesn't
+  // reset it. Clients that just connect and read, e.g., socat, get the same
+  // response.
+  pollfd request_fd = {client_fd, POLLIN, 0};
+  if (poll(&request_fd, 1, kClientRequestTimeoutMs) > 0) {
+    char request[4096];
+    while (recv(client_fd, request, sizeof(request), MSG_DONTWAIT) ==
+           static_cast<ssize_t>(sizeof(request))) {
+    }
+  }
+
+  // Don't let a client that doesn't read stall the export.
+  timeval send_timeout = {kClientSendTimeoutS, 0};
+  setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout,
+             sizeof(send_timeout));
+  const std::string body = FormatPrometheusText(registry_->Collect());
+  const std::string header = absl::StrCat(
+      "HTTP/1.0 200 OK\r\n"
+      "Content-Type: text/plain; version=0.0.4\r\n"
+      "Content-Length: ",
+      body.size(), "\r\n\r\n");
+  if (SendAll(client_fd, header)) SendAll(client_fd, body);
+  shutdown(client_fd, SHUT_WR);
+  close(client_fd);
+}
+
+std::unique_ptr<MetricsPageReader> MetricsPageReader::Open(
+    const std::string& shm_name) {
+  const std::string name = ToShmName(shm_name);
+  const int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0) {
+    SPL_LOG(ERROR) << "Cannot open the metrics page " << name << ": "
+                   << strerror(errno);
+    return nullptr;
+  }
+  struct stat file_stat = {};
+  void* memory = MAP_FAILED;
+  if (fstat(fd, &file_stat) == 0 &&
+      static_cast<size_t>(file_stat.st_size) >= sizeof(MetricsPage)) {
+    memory = mmap(nullptr, sizeof(MetricsPage), PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (memory == MAP_FAILED) {
+    SPL_LOG(ERROR) << "Cannot map the metrics page " << name;
+    return nullptr;
+  }
+
+  const auto* page = static_cast<const MetricsPage*>(memory);
+  if (page->magic != MetricsPage::kMagic ||
+      page->version != MetricsPage::kVersion) {
+    SPL_LOG(ERROR) << name << " is not a metrics page of version "
+                   << MetricsPage::kVersion;
+    munmap(memory, sizeof(MetricsPage));
+    return nullptr;
+  }
+  return std::unique_ptr<MetricsPageReader>(new MetricsPageReader(page));
+}
+
+MetricsPageReader::~MetricsPageReader() {
+  munmap(const_cast<MetricsPage*>(page_), sizeof(MetricsPage));
+}
+
+}  // namespace performancelayers
@@ -0,0 +1,113 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_METRICS_EXPORTER_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_METRICS_EXPORTER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "layer/support/metrics.h"
+
+namespace performancelayers {
+// Exports the metrics of a `MetricsRegistry` from a thread of its own, so that
+// monitoring the layers needs no file I/O on the application's threads:
+// - as a `MetricsPage` in POSIX shared memory, updated every period, to be
+//   read with `MetricsPageReader` or the `performance_layers_metrics` tool,
+//   and
+// - in the Prometheus text format, served over HTTP on a Unix socket, e.g.,
+//   `curl --unix-socket <socket> http://localhost/metrics`.
+//
+// `FromLayerConfig` configures the exporter with the settings of the
+// `LayerConfig` "common.metrics_shm" (the shared memory name),
+// "common.metrics_socket" (the socket path) and "common.metrics_period_ms"
+// (100 by default). As every layer library has its own registry, the name of
+// the library is appended to both, e.g.,
+// "/spl_metrics.VkLayer_stadia_frame_time".
+class MetricsExporter {
+ public:
+  struct Options {
+    // The POSIX shared memory object to publish the metrics to, if any.
+    std::string shm_name;
+    // The Unix socket to serve the metrics on, if any.
+    std::string socket_path;
+    uint64_t period_ms = 100;
+  };
+
+  // Returns an exporter of |registry| started with the options set by the
+  // layer config, or null if neither output is set or if it fails.
+  static std::unique_ptr<MetricsExporter> FromLayerConfig(
+      const MetricsRegistry* registry);
+
+  MetricsExporter(const MetricsRegistry* registry, Options options);
+
+  // Stops the exporter, and removes the shared memory object and the socket.
+  ~MetricsExporter();
+
+  MetricsExporter(const MetricsExporter&) = delete;
+  MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+  // Creates the outputs and starts the export thread. Returns false, and logs
+  // the error, if any of the outputs cannot be created.
+  bool Start();
+
+ private:
+  // Creates the shared memory object and maps the page.
+  bool CreatePage();
+  // Creates the socket and listens to it.
+  bool CreateSocket();
+  // The export thread: publishes the page every period and serves the socket
+  // until |stop_write_fd_| is written to.
+  void Run();
+  // Writes the metrics to the client connected to |client_fd|.
+  void ServeClient(int client_fd);
+
+  const MetricsRegistry* registry_;
+  const Options options_;
+
+  MetricsPage* page_ = nullptr;
+  int listen_fd_ = -1;
+  // A pipe whose write end wakes up and stops the thread.
+  int stop_read_fd_ = -1;
+  int stop_write_fd_ = -1;
+  std::thread thread_;
+};
+
+// A read-only mapping of a `MetricsPage` published by another process.
+class MetricsPageReader {
+ public:
+  // Maps the page in the shared memory object |shm_name|. Returns null, and
+  // logs the error, if it is not a metrics page.
+  static std::unique_ptr<MetricsPageReader> Open(const std::string& shm_name);
+
+  ~MetricsPageReader();
+
+  MetricsPageReader(const MetricsPageReader&) = delete;
+  MetricsPageReader& operator=(const MetricsPageReader&) = delete;
+
+  // Copies the current metrics. Returns false if no consistent copy was made.
+  bool Read(MetricsPageContents* contents) const {
+    return ReadMetricsPage(*page_, contents);
+  }
+
+ private:
+  explicit MetricsPageReader(const MetricsPage* page) : page_(page) {}
+  const MetricsPage* page_;
+};
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_METRICS_EXPORTER_H_
@@ -0,0 +1,366 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "layer/support/layer_config.h"
+#include "layer/support/layer_data.h"
+#include "layer/support/layer_utils.h"
+#include "sync_wait_layer_data.h"
+
+namespace performancelayers {
+namespace {
+// ----------------------------------------------------------------------------
+// Layer book-keeping information
+// ----------------------------------------------------------------------------
+
+constexpr uint32_t kSyncWaitLayerVersion = 1;
+constexpr char kLayerName[] = "VK_LAYER_STADIA_sync_wait";
+constexpr char kLayerDescription[] =
+    "Stadia Synchronization Wait Measuring Layer";
+
+SyncWaitLayerData* GetLayerData() {
+  // Don't use new -- make the destructor run when the layer gets unloaded.
+  static SyncWaitLayerData layer_data(
+      NullIfEmpty(GetLayerConfig().sync_wait.log));
+  return &layer_data;
+}
+
+// Use this macro to define all vulkan functions intercepted by the layer.
+#define SPL_SYNC_WAIT_LAYER_FUNC(RETURN_TYPE_, FUNC_NAME_, FUNC_ARGS_)  \
+  SPL_INTERCEPTED_VULKAN_FUNC(RETURN_TYPE_, SyncWaitLayer_, FUNC_NAME_, \
+                              FUNC_ARGS_)
+
+// The functions intercepted by the layer, defined below with
+// SPL_SYNC_WAIT_LAYER_FUNC.
+#define SPL_SYNC_WAIT_LAYER_FUNCS(X_, LAYER_PREFIX_)  \
+  X_(LAYER_PREFIX_, WaitForFences)                    \
+  X_(LAYER_PREFIX_, WaitSemaphores)                   \
+  X_(LAYER_PREFIX_, WaitSemaphoresKHR)                \
+  X_(LAYER_PREFIX_, GetFenceStatus)                   \
+  X_(LAYER_PREFIX_, QueueWaitIdle)                    \
+  X_(LAYER_PREFIX_, DeviceWaitIdle)                   \
+  X_(LAYER_PREFIX_, QueuePresentKHR)                  \
+  X_(LAYER_PREFIX_, DestroyInstance)                  \
+  X_(LAYER_PREFIX_, CreateInstance)                   \
+  X_(LAYER_PREFIX_, DestroyDevice)                    \
+  X_(LAYER_PREFIX_, CreateDevice)                     \
+  X_(LAYER_PREFIX_, EnumerateInstanceLayerProperties) \
+  X_(LAYER_PREFIX_, EnumerateDeviceLayerProperties)   \
+  X_(LAYER_PREFIX_, GetDeviceProcAddr)                \
+  X_(LAYER_PREFIX_, GetInstanceProcAddr)
+
+SPL_DECLARE_INTERCEPTED_FUNCTIONS(SyncWaitLayer_, SPL_SYNC_WAIT_LAYER_FUNCS);
+
+//////////////////////////////////////////////////////////////////////////////
+//  Implementation of the instance functions we want to override.
+//////////////////////////////////////////////////////////////////////////////
+
+// Override for vkDestroyInstance.  Deletes the entry for |instance| from the
+// layer data.
+SPL_SYNC_WAIT_LAYER_FUNC(void, DestroyInstance,
+                         (VkInstance instance,
+                          const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextInstanceProcAddr(
+      instance, &VkLayerInstanceDispatchTable::DestroyInstance);
+  layer_data->RemoveInstance(instance);
+  next_proc(instance, allocator);
+}
+
+// Override for vkCreateInstance.  Creates the dispatch table for this instance
+// and add it to the layer data.
+SPL_SYNC_WAIT_LAYER_FUNC(VkResult, CreateInstance,
+                         (const VkInstanceCreateInfo* create_info,
+                          const VkAllocationCallbacks* allocator,
+                          VkInstance* instance)) {
+  auto build_dispatch_table =
+      [instance](PFN_vkGetInstanceProcAddr get_proc_addr) {
+        // Build dispatch table for the instance functions we need to call.
+        VkLayerInstanceDispatchTable dispatch_table{};
+
+        // Get the next layer's instance of the instance functions we will
+        // override.
+        SPL_DISPATCH_INSTANCE_FUNC(DestroyInstance);
+        SPL_DISPATCH_INSTANCE_FUNC(GetInstanceProcAddr);
+        return dispatch_table;
+      };
+
+  return GetLayerData()->CreateInstance(create_info, allocator, instance,
+                                        build_dispatch_table);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//  Implementation of the device function we want to override.
+//////////////////////////////////////////////////////////////////////////////
+
+// Override for vkWaitForFences.  Measures the time the calling thread is
+// blocked until the fences are signaled or the timeout expires.
+SPL_SYNC_WAIT_LAYER_FUNC(VkResult, WaitForFences,
+                         (VkDevice device, uint32_t fence_count,
+                          const VkFence* fences, VkBool32 wait_all,
+                          uint64_t timeout)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::WaitForFences);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(device, fence_count, fences, wait_all, timeout);
+
+  DurationClock::time_point start = Now();
+  SyncWaitCall call;
+  call.result = next_proc(device, fence_count, fences, wait_all, timeout);
+  call.duration = Now() - start;
+  call.object_count = fence_count;
+  call.wait_all = wait_all == VK_TRUE;
+  call.timeout_ns = timeout;
+  layer_data->RecordWait("wait_for_fences", SyncWaitKind::kWaitForFences, call,
+                         layer_data->ShouldInstrument());
+  return call.result;
+}
+
+// Override for vkWaitSemaphores.  Measures the time the calling thread is
+// blocked until the timeline semaphores reach their values or the timeout
+// expires.
+SPL_SYNC_WAIT_LAYER_FUNC(VkResult, WaitSemaphores,
+                         (VkDevice device,
+                          const VkSemaphoreWaitInfo* wait_info,
+                          uint64_t timeout)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::WaitSemaphores);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(device, wait_info, timeout);
+
+  DurationClock::time_point start = Now();
+  SyncWaitCall call;
+  call.result = next_proc(device, wait_info, timeout);
+  call.duration = Now() - start;
+  call.object_count = wait_info->semaphoreCount;
+  call.wait_all = (wait_info->flags & VK_SEMAPHORE_WAIT_ANY_BIT) == 0;
+  call.timeout_ns = timeout;
+  layer_data->RecordWait("wait_semaphores", SyncWaitKind::kWaitSemaphores,
+                         call, layer_data->ShouldInstrument());
+  return call.result;
+}
+
+// Override for vkWaitSemaphoresKHR.  Like vkWaitSemaphores, for devices that
+// only expose VK_KHR_timeline_semaphore.
+SPL_SYNC_WAIT_LAYER_FUNC(VkResult, WaitSemaphoresKHR,
+                         (VkDevice device,
+                          const VkSemaphoreWaitInfo* wait_info,
+                          uint64_t timeout)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::WaitSemaphoresKHR);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(device, wait_info, timeout);
+
+  DurationClock::time_point start = Now();
+  SyncWaitCall call;
+  call.result = next_proc(device, wait_info, timeout);
+  call.duration = Now() - start;
+  call.object_count = wait_info->semaphoreCount;
+  call.wait_all = (wait_info->flags & VK_SEMAPHORE_WAIT_ANY_BIT) == 0;
+  call.timeout_ns = timeout;
+  layer_data->RecordWait("wait_semaphores", SyncWaitKind::kWaitSemaphores,
+                         call, layer_data->ShouldInstrument());
+  return call.result;
+}
+
+// Override for vkGetFenceStatus.  The call doesn't block, but applications
+// that call it in a loop spin until the fence is signaled, so the loop is
+// recorded as a wait.
+SPL_SYNC_WAIT_LAYER_FUNC(VkResult, GetFenceStatus,
+                         (VkDevice device, VkFence fence)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::GetFenceStatus);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(device, fence);
+
+  DurationClock::time_point start = Now();
+  VkResult result = next_proc(device, fence);
+  layer_data->RecordFenceStatus(fence, result, start, Now(),
+                                layer_data->ShouldInstrument());
+  return result;
+}
+
+// Override for vkQueueWaitIdle.  Measures the time the calling thread is
+// blocked until the queue is idle.
+SPL_SYNC_WAIT_LAYER_FUNC(VkResult, QueueWaitIdle, (VkQueue queue)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      queue, &VkLayerDispatchTable::QueueWaitIdle);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(queue);
+
+  DurationClock::time_point start = Now();
+  SyncWaitCall call;
+  call.result = next_proc(queue);
+  call.duration = Now() - start;
+  layer_data->RecordWait("queue_wait_idle", SyncWaitKind::kQueueWaitIdle, call,
+                         layer_data->ShouldInstrument());
+  return call.result;
+}
+
+// Override for vkDeviceWaitIdle.  Measures the time the calling thread is
+// blocked until all the queues of the device are idle.
+SPL_SYNC_WAIT_LAYER_FUNC(VkResult, DeviceWaitIdle, (VkDevice device)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DeviceWaitIdle);
+  if (layer_data->GetInstrumentationMode() == InstrumentationMode::kOff)
+    return next_proc(device);
+
+  DurationClock::time_point start = Now();
+  SyncWaitCall call;
+  call.result = next_proc(device);
+  call.duration = Now() - start;
+  layer_data->RecordWait("device_wait_idle", SyncWaitKind::kDeviceWaitIdle,
+                         call, layer_data->ShouldInstrument());
+  return call.result;
+}
+
+// Override for vkQueuePresentKHR.  Logs the waits of the frame.
+SPL_SYNC_WAIT_LAYER_FUNC(VkResult, QueuePresentKHR,
+                         (VkQueue queue,
+                          const VkPresentInfoKHR* present_info)) {
+  auto* layer_data = GetLayerData();
+  layer_data->RecordPresent();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      queue, &VkLayerDispatchTable::QueuePresentKHR);
+  return next_proc(queue, present_info);
+}
+
+// Override for vkDestroyDevice.  Removes the dispatch table for the device from
+// the layer data.
+SPL_SYNC_WAIT_LAYER_FUNC(void, DestroyDevice,
+                         (VkDevice device,
+                          const VkAllocationCallbacks* allocator)) {
+  auto* layer_data = GetLayerData();
+  auto next_proc = layer_data->GetNextDeviceProcAddr(
+      device, &VkLayerDispatchTable::DestroyDevice);
+  layer_data->RemoveDevice(device);
+  next_proc(device, allocator);
+}
+
+// Override for vkCreateDevice.  Builds the dispatch table for the new device
+// and add it to the layer data.
+SPL_SYNC_WAIT_LAYER_FUNC(VkResult, CreateDevice,
+                         (VkPhysicalDevice physical_device,
+                          const VkDeviceCreateInfo* create_info,
+                          const VkAllocationCallbacks* allocator,
+                          VkDevice* device)) {
+  auto build_dispatch_table = [device](PFN_vkGetDeviceProcAddr gdpa) {
+    VkLayerDispatchTable dispatch_table{};
+
+    // Get the next layer's instance of the device functions we will override.
+    // vkWaitSemaphores and vkWaitSemaphoresKHR are null unless the device
+    // supports timeline semaphores.
+    SPL_DISPATCH_DEVICE_FUNC(DestroyDevice);
+    SPL_DISPATCH_DEVICE_FUNC(GetDeviceProcAddr);
+    SPL_DISPATCH_DEVICE_FUNC(WaitForFences);
+    SPL_DISPATCH_DEVICE_FUNC(WaitSemaphores);
+    SPL_DISPATCH_DEVICE_FUNC(WaitSemaphoresKHR);
+    SPL_DISPATCH_DEVICE_FUNC(GetFenceStatus);
+    SPL_DISPATCH_DEVICE_FUNC(QueueWaitIdle);
+    SPL_DISPATCH_DEVICE_FUNC(DeviceWaitIdle);
+    SPL_DISPATCH_DEVICE_FUNC(QueuePresentKHR);
+    return dispatch_table;
+  };
+
+  return GetLayerData()->CreateDevice(physical_device, create_info, allocator,
+                                      device, build_dispatch_table);
+}
+
+SPL_SYNC_WAIT_LAYER_FUNC(VkResult, EnumerateInstanceLayerProperties,
+                         (uint32_t * property_count,
+                          VkLayerProperties* properties)) {
+  if (property_count) *property_count = 1;
+
+  if (properties) {
+    strncpy(properties->layerName, kLayerName, sizeof(properties->layerName));
+    strncpy(properties->description, kLayerDescription,
+            sizeof(properties->description));
+    properties->implementationVersion = kSyncWaitLayerVersion;
+    properties->specVersion = VK_API_VERSION_1_0;
+  }
+
+  return VK_SUCCESS;
+}
+
+SPL_SYNC_WAIT_LAYER_FUNC(VkResult, EnumerateDeviceLayerProperties,
+                         (VkPhysicalDevice /* physical_device */,
+                          uint32_t* property_count,
+                          VkLayerProperties* properties)) {
+  return SyncWaitLayer_EnumerateInstanceLayerProperties(property_count,
+                                                        properties);
+}
+
+}  // namespace
+
+SPL_DEFINE_INTERCEPTED_FUNCTION_TABLE(SyncWaitLayer_,
+                                      SPL_SYNC_WAIT_LAYER_FUNCS);
+
+// The *GetProcAddr functions are the entry points to the layers.
+// They return a function pointer for the instance requested by |name|.  We
+// return the functions defined in this layer for those we want to override.
+// Otherwise we call the *GetProcAddr function for the next layer to get the
+// function to be called.
+
+SPL_LAYER_ENTRY_POINT SPL_SYNC_WAIT_LAYER_FUNC(PFN_vkVoidFunction,
+                                               GetDeviceProcAddr,
+                                               (VkDevice device,
+                                                const char* name)) {
+  auto* layer_data = GetLayerData();
+
+  PFN_vkGetDeviceProcAddr next_get_proc_addr =
+      layer_data->GetNextDeviceProcAddr(
+          device, &VkLayerDispatchTable::GetDeviceProcAddr);
+  assert(next_get_proc_addr && next_get_proc_addr != VK_NULL_HANDLE);
+  // The functions of the features and extensions that the device didn't
+  // enable are null down the chain, and must stay null.
+  PFN_vkVoidFunction next_func = next_get_proc_addr(device, name);
+  if (!next_func) return nullptr;
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(SyncWaitLayer_, name)) {
+    return func;
+  }
+  return next_func;
+}
+
+SPL_LAYER_ENTRY_POINT SPL_SYNC_WAIT_LAYER_FUNC(PFN_vkVoidFunction,
+                                               GetInstanceProcAddr,
+                                               (VkInstance instance,
+                                                const char* name)) {
+  // The loader looks up the layer's functions here first, before calling any
+  // of them.
+  if (IsLayerOverheadProfilingEnabled()) {
+    GetLayerData()->SetOverheadProfiler(&SyncWaitLayer_kOverheadProfiler);
+  }
+  if (auto func = SPL_GET_INTERCEPTED_VULKAN_FUNC(SyncWaitLayer_, name)) {
+    return func;
+  }
+
+  auto* layer_data = GetLayerData();
+
+  PFN_vkGetInstanceProcAddr next_get_proc_addr =
+      layer_data->GetNextInstanceProcAddr(
+          instance, &VkLayerInstanceDispatchTable::GetInstanceProcAddr);
+  assert(next_get_proc_addr && next_get_proc_addr != VK_NULL_HANDLE);
+  return next_get_proc_addr(instance, name);
+}
+
+}  // namespace performancelayers
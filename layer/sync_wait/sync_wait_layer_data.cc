@@ -0,0 +1,137 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sync_wait_layer_data.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/synchronization/mutex.h"
+
+namespace performancelayers {
+namespace {
+// The vkGetFenceStatus loops of the thread.
+thread_local FencePollDetector fence_poll_detector;
+}  // namespace
+
+const char* SyncWaitResultToString(VkResult result) {
+  switch (result) {
+    case VK_SUCCESS:
+      return "VK_SUCCESS";
+    case VK_NOT_READY:
+      return "VK_NOT_READY";
+    case VK_TIMEOUT:
+      return "VK_TIMEOUT";
+    case VK_ERROR_OUT_OF_HOST_MEMORY:
+      return "VK_ERROR_OUT_OF_HOST_MEMORY";
+    case VK_ERROR_OUT_OF_DEVICE_MEMORY:
+      return "VK_ERROR_OUT_OF_DEVICE_MEMORY";
+    case VK_ERROR_DEVICE_LOST:
+      return "VK_ERROR_DEVICE_LOST";
+    default:
+      return "VK_ERROR";
+  }
+}
+
+void SyncWaitLayerData::AddBlockedTime(SyncWaitKind kind, int64_t duration_ns,
+                                       bool timed_out) {
+  blocked_time_ns_[static_cast<size_t>(kind)].fetch_add(
+      duration_ns, std::memory_order_relaxed);
+  wait_count_.fetch_add(1, std::memory_order_relaxed);
+  waits_metric_.Add();
+  blocked_time_metric_.Record(duration_ns / 1000);
+  if (timed_out) {
+    timeout_count_.fetch_add(1, std::memory_order_relaxed);
+    timeouts_metric_.Add();
+  }
+}
+
+void SyncWaitLayerData::RecordWait(const char* name, SyncWaitKind kind,
+                                   const SyncWaitCall& call, bool log_call) {
+  AddBlockedTime(kind, call.duration.ToNanoseconds(),
+                 call.result == VK_TIMEOUT);
+  if (log_call) {
+    SyncWaitEvent event(name, call);
+    LogEvent(&event);
+  }
+}
+
+bool FencePollDetector::RecordFenceStatus(VkFence fence, VkResult result,
+                                          DurationClock::time_point start,
+                                          DurationClock::time_point end,
+                                          FencePollLoop* loop) {
+  const bool continues_loop = poll_count_ != 0 && fence_ == fence &&
+                              start - last_end_ <= kMaxFencePollGap;
+  if (result == VK_NOT_READY) {
+    if (!continues_loop) {
+      fence_ = fence;
+      start_ = start;
+      poll_count_ = 0;
+    }
+    ++poll_count_;
+    last_end_ = end;
+    return false;
+  }
+
+  const int64_t poll_count = poll_count_ + 1;
+  poll_count_ = 0;
+  if (!continues_loop) return false;
+  loop->poll_count = poll_count;
+  loop->duration = end - start_;
+  return true;
+}
+
+void SyncWaitLayerData::RecordFenceStatus(VkFence fence, VkResult result,
+                                          DurationClock::time_point start,
+                                          DurationClock::time_point end,
+                                          bool log_call) {
+  FencePollLoop loop;
+  if (!fence_poll_detector.RecordFenceStatus(fence, result, start, end, &loop))
+    return;
+
+  AddBlockedTime(SyncWaitKind::kFencePoll, loop.duration.ToNanoseconds(),
+                 /*timed_out=*/false);
+  if (log_call) {
+    FenceStatusSpinEvent event("fence_status_spin", loop.poll_count, result,
+                               loop.duration);
+    LogEvent(&event);
+  }
+}
+
+void SyncWaitLayerData::RecordPresent() {
+  uint64_t frame = 0;
+  Duration frame_time = Duration::FromNanoseconds(0);
+  {
+    absl::MutexLock lock(&present_lock_);
+    frame = frame_++;
+    const DurationClock::time_point now = Now();
+    frame_time = now - last_present_;
+    last_present_ = now;
+  }
+
+  SyncWaitFrameStats stats;
+  for (size_t i = 0; i != kNumSyncWaitKinds; ++i) {
+    stats.blocked_time_ns[i] =
+        blocked_time_ns_[i].exchange(0, std::memory_order_relaxed);
+  }
+  stats.wait_count = wait_count_.exchange(0, std::memory_order_relaxed);
+  stats.timeout_count = timeout_count_.exchange(0, std::memory_order_relaxed);
+
+  SyncWaitFrameEvent event("sync_wait_frame", static_cast<int64_t>(frame),
+                           frame_time, stats);
+  LogEvent(&event);
+}
+
+}  // namespace performancelayers
@@ -0,0 +1,276 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_SYNC_WAIT_LAYER_DATA_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_SYNC_WAIT_LAYER_DATA_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/synchronization/mutex.h"
+#include "layer/support/event_logging.h"
+#include "layer/support/layer_data.h"
+#include "layer/support/layer_utils.h"
+#include "layer/support/metrics.h"
+
+namespace performancelayers {
+// The ways the CPU waits for the GPU.
+enum class SyncWaitKind {
+  kWaitForFences,
+  kWaitSemaphores,
+  // vkGetFenceStatus called in a loop until the fence is signaled.
+  kFencePoll,
+  kQueueWaitIdle,
+  kDeviceWaitIdle,
+};
+
+constexpr size_t kNumSyncWaitKinds = 5;
+
+// Returns the name of |result|, e.g., "VK_TIMEOUT", for the results of the
+// wait functions, and "VK_ERROR" for the other errors.
+const char* SyncWaitResultToString(VkResult result);
+
+// A single blocking call.
+struct SyncWaitCall {
+  // The number of fences or semaphores waited for, 0 when waiting for idle.
+  uint32_t object_count = 0;
+  // False if any of the objects is enough.
+  bool wait_all = true;
+  uint64_t timeout_ns = UINT64_MAX;
+  VkResult result = VK_SUCCESS;
+  Duration duration = Duration::FromNanoseconds(0);
+};
+
+// An event that holds a single blocking call and the time the calling thread
+// was blocked in it. The trace event spans the call on the calling thread.
+class SyncWaitEvent : public Event {
+ public:
+  SyncWaitEvent(const char* name, const SyncWaitCall& call)
+      : Event(name),
+        object_count_({"object_count", call.object_count}),
+        wait_all_({"wait_all", call.wait_all}),
+        // A timeout that never expires is logged as -1.
+        timeout_({"timeout", call.timeout_ns == UINT64_MAX
+                                 ? -1
+                                 : static_cast<int64_t>(call.timeout_ns)}),
+        result_("result", SyncWaitResultToString(call.result)),
+        duration_("duration", call.duration),
+        trace_attr_("trace_attr", "sync_wait", "X",
+                    {&object_count_, &wait_all_, &timeout_, &result_,
+                     &duration_}) {
+    InitAttributes({&object_count_, &wait_all_, &timeout_, &result_,
+                    &duration_, &trace_attr_});
+  }
+
+ private:
+  Int64Attr object_count_;
+  BoolAttr wait_all_;
+  Int64Attr timeout_;
+  StringAttr result_;
+  DurationAttr duration_;
+  TraceEventAttr trace_attr_;
+};
+
+// An event that holds a loop of vkGetFenceStatus calls on one fence, from the
+// first call that found the fence unsignaled to the call that found it
+// signaled. The trace event spans the loop on the polling thread.
+class FenceStatusSpinEvent : public Event {
+ public:
+  FenceStatusSpinEvent(const char* name, int64_t poll_count, VkResult result,
+                       Duration duration)
+      : Event(name),
+        poll_count_({"poll_count", poll_count}),
+        result_("result", SyncWaitResultToString(result)),
+        duration_("duration", duration),
+        trace_attr_("trace_attr", "sync_wait", "X",
+                    {&poll_count_, &result_, &duration_}) {
+    InitAttributes({&poll_count_, &result_, &duration_, &trace_attr_});
+  }
+
+ private:
+  Int64Attr poll_count_;
+  StringAttr result_;
+  DurationAttr duration_;
+  TraceEventAttr trace_attr_;
+};
+
+// A loop of vkGetFenceStatus calls on one fence, from the first call that
+// found the fence unsignaled to the call that found it signaled.
+struct FencePollLoop {
+  int64_t poll_count = 0;
+  Duration duration = Duration::FromNanoseconds(0);
+};
+
+// Detects the vkGetFenceStatus loops of one thread. Calls that find the fence
+// unsignaled start or continue a loop, and the call that finds it signaled
+// ends the loop. The loop is dropped if the thread polls another fence, or if
+// it does something else for more than `kMaxFencePollGap` between two calls,
+// e.g., when it checks a fence once per frame.
+class FencePollDetector {
+ public:
+  static constexpr DurationClock::duration kMaxFencePollGap =
+      std::chrono::milliseconds(1);
+
+  // Records a vkGetFenceStatus call on |fence|, from |start| to |end|, that
+  // returned |result|. Returns true and sets |loop| if the call ends a loop.
+  // A fence found signaled by the first call didn't block the thread, and
+  // ends no loop.
+  bool RecordFenceStatus(VkFence fence, VkResult result,
+                         DurationClock::time_point start,
+                         DurationClock::time_point end, FencePollLoop* loop);
+
+ private:
+  VkFence fence_ = VK_NULL_HANDLE;
+  // The start of the first call of the loop, and the end of the last one.
+  DurationClock::time_point start_;
+  DurationClock::time_point last_end_;
+  // 0 when the thread is not polling.
+  int64_t poll_count_ = 0;
+};
+
+// The time spent waiting for the GPU in one frame, by kind of wait, summed
+// over all threads.
+struct SyncWaitFrameStats {
+  int64_t blocked_time_ns[kNumSyncWaitKinds] = {};
+  uint64_t wait_count = 0;
+  uint64_t timeout_count = 0;
+};
+
+// An event that summarizes the waits of one frame. A frame whose blocked time
+// is close to its frame time is GPU-bound; the blocked time can exceed the
+// frame time when several threads wait at once.
+class SyncWaitFrameEvent : public Event {
+ public:
+  SyncWaitFrameEvent(const char* name, int64_t frame, Duration frame_time,
+                     const SyncWaitFrameStats& stats)
+      : Event(name, LogLevel::kHigh),
+        frame_({"frame", frame}),
+        frame_time_("frame_time", frame_time),
+        blocked_time_("blocked_time",
+                      Duration::FromNanoseconds(GetTotalBlockedTime(stats))),
+        fence_wait_time_("fence_wait_time",
+                         GetBlockedTime(stats, SyncWaitKind::kWaitForFences)),
+        semaphore_wait_time_(
+            "semaphore_wait_time",
+            GetBlockedTime(stats, SyncWaitKind::kWaitSemaphores)),
+        fence_poll_time_("fence_poll_time",
+                         GetBlockedTime(stats, SyncWaitKind::kFencePoll)),
+        queue_idle_time_("queue_idle_time",
+                         GetBlockedTime(stats, SyncWaitKind::kQueueWaitIdle)),
+        device_idle_time_(
+            "device_idle_time",
+            GetBlockedTime(stats, SyncWaitKind::kDeviceWaitIdle)),
+        wait_count_({"wait_count", static_cast<int64_t>(stats.wait_count)}),
+        timeout_count_(
+            {"timeout_count", static_cast<int64_t>(stats.timeout_count)}),
+        trace_attr_("trace_attr", "sync_wait", "i",
+                    {&scope_, &frame_, &frame_time_, &blocked_time_,
+                     &fence_wait_time_, &semaphore_wait_time_,
+                     &fence_poll_time_, &queue_idle_time_, &device_idle_time_,
+                     &wait_count_, &timeout_count_}) {
+    InitAttributes({&frame_, &frame_time_, &blocked_time_, &fence_wait_time_,
+                    &semaphore_wait_time_, &fence_poll_time_,
+                    &queue_idle_time_, &device_idle_time_, &wait_count_,
+                    &timeout_count_, &trace_attr_});
+  }
+
+ private:
+  static int64_t GetTotalBlockedTime(const SyncWaitFrameStats& stats) {
+    int64_t total_ns = 0;
+    for (int64_t blocked_time_ns : stats.blocked_time_ns)
+      total_ns += blocked_time_ns;
+    return total_ns;
+  }
+
+  static Duration GetBlockedTime(const SyncWaitFrameStats& stats,
+                                 SyncWaitKind kind) {
+    return Duration::FromNanoseconds(
+        stats.blocked_time_ns[static_cast<size_t>(kind)]);
+  }
+
+  Int64Attr frame_;
+  DurationAttr frame_time_;
+  DurationAttr blocked_time_;
+  DurationAttr fence_wait_time_;
+  DurationAttr semaphore_wait_time_;
+  DurationAttr fence_poll_time_;
+  DurationAttr queue_idle_time_;
+  DurationAttr device_idle_time_;
+  Int64Attr wait_count_;
+  Int64Attr timeout_count_;
+  // `Perfetto` displays the args only for instant events with thread-level
+  // scope.
+  StringAttr scope_{"scope", "t"};
+  TraceEventAttr trace_attr_;
+};
+
+// A class that contains all of the data that is needed for the functions
+// that this layer will override.
+//
+// Every blocking call is logged to the event logs and, at every present, the
+// time the frame spent waiting for the GPU is logged to the layer's log file,
+// the "sync_wait.log" setting of the `LayerConfig`. The waits are recorded
+// with atomics, so that threads waiting at once don't contend in the layer.
+class SyncWaitLayerData : public LayerData {
+ public:
+  explicit SyncWaitLayerData(const char* log_filename)
+      : LayerData(log_filename,
+                  "Frame,Frame Time (ns),Blocked Time (ns),Fence Wait Time "
+                  "(ns),Semaphore Wait Time (ns),Fence Poll Time (ns),Queue "
+                  "Idle Time (ns),Device Idle Time (ns),Waits,Timeouts") {
+    LayerInitEvent event("sync_wait_layer_init", "sync_wait");
+    LogEvent(&event);
+    StartControl("sync_wait");
+  }
+
+  // Records the blocking call |name| of |kind|. Logs the call if |log_call|
+  // is set.
+  void RecordWait(const char* name, SyncWaitKind kind,
+                  const SyncWaitCall& call, bool log_call);
+
+  // Records a vkGetFenceStatus call on |fence|, from |start| to |end|, that
+  // returned |result|. The poll loops of the calling thread, see
+  // `FencePollDetector`, are recorded as waits of the duration of the loop.
+  void RecordFenceStatus(VkFence fence, VkResult result,
+                         DurationClock::time_point start,
+                         DurationClock::time_point end, bool log_call);
+
+  // Logs the waits of the frame that ends, and starts a new frame.
+  void RecordPresent();
+
+ private:
+  void AddBlockedTime(SyncWaitKind kind, int64_t duration_ns, bool timed_out);
+
+  std::atomic<int64_t> blocked_time_ns_[kNumSyncWaitKinds] = {};
+  std::atomic<uint64_t> wait_count_ = 0;
+  std::atomic<uint64_t> timeout_count_ = 0;
+
+  absl::Mutex present_lock_;
+  uint64_t frame_ ABSL_GUARDED_BY(present_lock_) = 0;
+  DurationClock::time_point last_present_ ABSL_GUARDED_BY(present_lock_) =
+      Now();
+
+  Counter waits_metric_ =
+      MetricsRegistry::Get()->GetCounter("sync_wait_waits_total");
+  Counter timeouts_metric_ =
+      MetricsRegistry::Get()->GetCounter("sync_wait_timeouts_total");
+  Histogram blocked_time_metric_ =
+      MetricsRegistry::Get()->GetHistogram("sync_wait_blocked_time_us");
+};
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_SYNC_WAIT_LAYER_DATA_H_
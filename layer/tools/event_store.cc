@@ -0,0 +1,599 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/tools/event_store.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <system_error>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "layer/tools/log_analysis.h"
+#include "layer/tools/log_reader.h"
+
+namespace performancelayers {
+namespace {
+namespace fs = std::filesystem;
+
+constexpr char kFormatVersion[] = "performance_layers_event_store 1";
+constexpr int64_t kNoValue = std::numeric_limits<int64_t>::min();
+
+// The attributes of the value column, by priority.
+constexpr std::string_view kValueAttributes[] = {"duration", "runtime",
+                                                 "frame_time"};
+constexpr std::string_view kThreadAttribute = "tid";
+
+constexpr char kMetadataFile[] = "metadata.txt";
+constexpr char kNamesFile[] = "names.txt";
+constexpr char kTimestampsFile[] = "timestamps.bin";
+constexpr char kNameIdsFile[] = "name_ids.bin";
+constexpr char kThreadsFile[] = "threads.bin";
+constexpr char kValuesFile[] = "values.bin";
+constexpr char kAttributeOffsetsFile[] = "attribute_offsets.bin";
+constexpr char kAttributeSizesFile[] = "attribute_sizes.bin";
+constexpr char kAttributesFile[] = "attributes.txt";
+constexpr char kNameOffsetsFile[] = "name_offsets.bin";
+constexpr char kNameEventsFile[] = "name_events.bin";
+constexpr char kHashesFile[] = "hashes.bin";
+constexpr char kHashOffsetsFile[] = "hash_offsets.bin";
+constexpr char kHashEventsFile[] = "hash_events.bin";
+constexpr char kTimeIndexFile[] = "time_index.bin";
+
+// An event while the store is built.
+struct Event {
+  int64_t timestamp_ns = 0;
+  uint32_t name_id = 0;
+  int64_t thread = EventStore::kNoThread;
+  int64_t value = kNoValue;
+  uint64_t attribute_offset = 0;
+  uint32_t attribute_size = 0;
+};
+
+// Splits |field|, an attribute of an event, into its name and value.
+bool SplitAttribute(std::string_view field, std::string_view* name,
+                    std::string_view* value) {
+  const size_t colon = field.find(':');
+  if (colon == std::string_view::npos) return false;
+  *name = field.substr(0, colon);
+  *value = field.substr(colon + 1);
+  return true;
+}
+
+// Adds the hashes of |value|, a hash or a quoted list of hashes, to |hashes|.
+void ParseHashes(std::string_view value, std::vector<uint64_t>* hashes) {
+  uint64_t hash = 0;
+  if (value.size() >= 4 && value.substr(0, 2) == "\"[" &&
+      value.substr(value.size() - 2) == "]\"") {
+    for (absl::string_view element :
+         absl::StrSplit(absl::string_view(value.data() + 2, value.size() - 4),
+                        ',')) {
+      if (ParseHash(std::string_view(element.data(), element.size()), &hash))
+        hashes->push_back(hash);
+    }
+  } else if (ParseHash(value, &hash)) {
+    hashes->push_back(hash);
+  }
+}
+
+template <typename T>
+absl::Status WriteColumn(const fs::path& dir, const char* name,
+                         const std::vector<T>& values) {
+  const fs::path path = dir / name;
+  FILE* file = fopen(path.c_str(), "wb");
+  if (!file)
+    return absl::UnavailableError(absl::StrCat("Cannot write ", path.string()));
+  const size_t written =
+      values.empty() ? 0
+                     : fwrite(values.data(), sizeof(T), values.size(), file);
+  if (fclose(file) != 0 || written != values.size())
+    return absl::UnavailableError(absl::StrCat("Cannot write ", path.string()));
+  return absl::OkStatus();
+}
+
+absl::Status WriteText(const fs::path& dir, const char* name,
+                       const std::string& text) {
+  return WriteColumn(dir, name, std::vector<char>(text.begin(), text.end()));
+}
+
+// Maps the file |name| of |dir|, which holds |size| values, into |column|.
+template <typename T>
+absl::Status MapColumn(const fs::path& dir, const char* name, size_t size,
+                       std::vector<InputBuffer>* files,
+                       absl::Span<const T>* column) {
+  const std::string path = (dir / name).string();
+  absl::StatusOr<InputBuffer> buffer = InputBuffer::Create(path);
+  if (!buffer.ok()) return buffer.status();
+  absl::Span<const uint8_t> bytes = buffer->GetBuffer();
+  if (bytes.size() != size * sizeof(T)) {
+    return absl::DataLossError(
+        absl::StrCat(path, ": expected ", size * sizeof(T), " bytes"));
+  }
+  *column = absl::MakeConstSpan(reinterpret_cast<const T*>(bytes.data()), size);
+  files->push_back(*std::move(buffer));
+  return absl::OkStatus();
+}
+
+// Returns the events of |events| in [|begin|, |end|).
+absl::Span<const uint32_t> Restrict(absl::Span<const uint32_t> events,
+                                    uint32_t begin, uint32_t end) {
+  const auto first = std::lower_bound(events.begin(), events.end(), begin);
+  const auto last = std::lower_bound(first, events.end(), end);
+  return events.subspan(first - events.begin(), last - first);
+}
+}  // namespace
+
+bool ParseHash(std::string_view text, uint64_t* hash) {
+  if (text.size() <= 2 || text.size() > 18 || text.substr(0, 2) != "0x")
+    return false;
+  uint64_t parsed = 0;
+  for (const char c : text.substr(2)) {
+    uint64_t digit = 0;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else {
+      return false;
+    }
+    parsed = parsed << 4 | digit;
+  }
+  *hash = parsed;
+  return true;
+}
+
+absl::StatusOr<EventStoreBuildStats> BuildEventStore(
+    const std::vector<std::string_view>& logs, const std::string& dir,
+    const EventStoreOptions& options) {
+  assert(options.time_bucket_ns > 0);
+  const fs::path dir_path(dir);
+  std::error_code error;
+  fs::create_directories(dir_path, error);
+  if (error) {
+    return absl::UnavailableError(
+        absl::StrCat("Cannot create ", dir, ": ", error.message()));
+  }
+  const fs::path attributes_path = dir_path / kAttributesFile;
+  FILE* attributes_file = fopen(attributes_path.c_str(), "wb");
+  if (!attributes_file) {
+    return absl::UnavailableError(
+        absl::StrCat("Cannot write ", attributes_path.string()));
+  }
+
+  EventStoreBuildStats stats;
+  std::vector<Event> events;
+  std::vector<std::string> names;
+  absl::flat_hash_map<std::string, uint32_t> name_ids;
+  // The hashes the events refer to, and the events, in log order.
+  std::vector<std::pair<uint64_t, uint32_t>> hash_references;
+  std::vector<uint64_t> hashes;
+  uint64_t attributes_size = 0;
+  std::vector<std::string_view> fields;
+  for (std::string_view log : logs) {
+    CsvReader reader(log);
+    while (reader.NextRow(&fields)) {
+      Event event;
+      std::string_view attribute;
+      std::string_view value;
+      if (fields.size() < 2 || !SplitAttribute(fields[1], &attribute, &value) ||
+          attribute != "timestamp" || !ParseInt64(value, &event.timestamp_ns)) {
+        ++stats.num_malformed_lines;
+        continue;
+      }
+      if (events.size() == std::numeric_limits<uint32_t>::max()) {
+        fclose(attributes_file);
+        return absl::ResourceExhaustedError(
+            absl::StrCat("More than ", events.size(), " events"));
+      }
+      const uint32_t event_id = static_cast<uint32_t>(events.size());
+
+      const std::string_view name = fields[0];
+      auto name_it = name_ids.find(absl::string_view(name.data(), name.size()));
+      if (name_it == name_ids.end()) {
+        name_it =
+            name_ids.insert({std::string(name), uint32_t(names.size())}).first;
+        names.push_back(std::string(name));
+      }
+      event.name_id = name_it->second;
+
+      size_t value_priority = std::size(kValueAttributes);
+      for (size_t i = 2; i < fields.size(); ++i) {
+        if (!SplitAttribute(fields[i], &attribute, &value)) continue;
+        int64_t parsed = 0;
+        if (attribute == kThreadAttribute) {
+          if (ParseInt64(value, &parsed)) event.thread = parsed;
+          continue;
+        }
+        const size_t priority =
+            std::find(std::begin(kValueAttributes), std::end(kValueAttributes),
+                      attribute) -
+            std::begin(kValueAttributes);
+        if (priority < value_priority && ParseInt64(value, &parsed)) {
+          event.value = parsed;
+          value_priority = priority;
+          continue;
+        }
+        hashes.clear();
+        ParseHashes(value, &hashes);
+        for (uint64_t hash : hashes)
+          hash_references.push_back({hash, event_id});
+      }
+
+      if (fields.size() > 2) {
+        const char* begin = fields[2].data();
+        const char* end = fields.back().data() + fields.back().size();
+        event.attribute_offset = attributes_size;
+        event.attribute_size = static_cast<uint32_t>(end - begin);
+        fwrite(begin, 1, end - begin, attributes_file);
+        attributes_size += end - begin;
+      }
+      events.push_back(event);
+    }
+  }
+  if (fclose(attributes_file) != 0) {
+    return absl::UnavailableError(
+        absl::StrCat("Cannot write ", attributes_path.string()));
+  }
+
+  // Sort the events by timestamp. The logs of the layers are only roughly
+  // sorted, as every layer buffers its own events.
+  const size_t num_events = events.size();
+  std::vector<uint32_t> order(num_events);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&events](uint32_t a, uint32_t b) {
+                     return events[a].timestamp_ns < events[b].timestamp_ns;
+                   });
+  std::vector<uint32_t> sorted_ids(num_events);
+  for (size_t i = 0; i != num_events; ++i) sorted_ids[order[i]] = i;
+
+  std::vector<int64_t> timestamps(num_events);
+  std::vector<uint32_t> event_name_ids(num_events);
+  std::vector<int64_t> threads(num_events);
+  std::vector<int64_t> values(num_events);
+  std::vector<uint64_t> attribute_offsets(num_events);
+  std::vector<uint32_t> attribute_sizes(num_events);
+  for (size_t i = 0; i != num_events; ++i) {
+    const Event& event = events[order[i]];
+    timestamps[i] = event.timestamp_ns;
+    event_name_ids[i] = event.name_id;
+    threads[i] = event.thread;
+    values[i] = event.value;
+    attribute_offsets[i] = event.attribute_offset;
+    attribute_sizes[i] = event.attribute_size;
+  }
+  events = {};
+  order = {};
+
+  // The events of every name, which are sorted as they are added in order.
+  std::vector<uint64_t> name_offsets(names.size() + 1);
+  for (uint32_t name_id : event_name_ids) ++name_offsets[name_id + 1];
+  std::partial_sum(name_offsets.begin(), name_offsets.end(),
+                   name_offsets.begin());
+  std::vector<uint32_t> name_events(num_events);
+  {
+    std::vector<uint64_t> next = name_offsets;
+    for (size_t i = 0; i != num_events; ++i)
+      name_events[next[event_name_ids[i]]++] = i;
+  }
+
+  for (auto& [hash, event] : hash_references) event = sorted_ids[event];
+  std::sort(hash_references.begin(), hash_references.end());
+  hash_references.erase(
+      std::unique(hash_references.begin(), hash_references.end()),
+      hash_references.end());
+  std::vector<uint64_t> hash_keys;
+  std::vector<uint64_t> hash_offsets;
+  std::vector<uint32_t> hash_events;
+  hash_events.reserve(hash_references.size());
+  for (const auto& [hash, event] : hash_references) {
+    if (hash_keys.empty() || hash_keys.back() != hash) {
+      hash_keys.push_back(hash);
+      hash_offsets.push_back(hash_events.size());
+    }
+    hash_events.push_back(event);
+  }
+  hash_offsets.push_back(hash_events.size());
+
+  // The first event of every time bucket, and the number of events.
+  const int64_t min_timestamp_ns = timestamps.empty() ? 0 : timestamps[0];
+  std::vector<uint32_t> time_index;
+  if (!timestamps.empty()) {
+    const uint64_t num_buckets =
+        (static_cast<uint64_t>(timestamps.back()) - min_timestamp_ns) /
+            options.time_bucket_ns +
+        1;
+    time_index.reserve(num_buckets + 1);
+    uint32_t event = 0;
+    for (uint64_t bucket = 0; bucket != num_buckets; ++bucket) {
+      const int64_t bucket_start =
+          min_timestamp_ns + bucket * options.time_bucket_ns;
+      while (event != num_events && timestamps[event] < bucket_start) ++event;
+      time_index.push_back(event);
+    }
+  }
+  time_index.push_back(num_events);
+
+  std::string names_text;
+  for (const std::string& name : names)
+    absl::StrAppend(&names_text, name, "\n");
+  const std::string metadata = absl::StrCat(
+      kFormatVersion, "\nevents ", num_events, "\nnames ", names.size(),
+      "\nhashes ", hash_keys.size(), "\nattributes_size ", attributes_size,
+      "\nmin_timestamp_ns ", min_timestamp_ns, "\ntime_bucket_ns ",
+      options.time_bucket_ns, "\ntime_buckets ", time_index.size() - 1, "\n");
+
+  for (absl::Status status : {
+           WriteColumn(dir_path, kTimestampsFile, timestamps),
+           WriteColumn(dir_path, kNameIdsFile, event_name_ids),
+           WriteColumn(dir_path, kThreadsFile, threads),
+           WriteColumn(dir_path, kValuesFile, values),
+           WriteColumn(dir_path, kAttributeOffsetsFile, attribute_offsets),
+           WriteColumn(dir_path, kAttributeSizesFile, attribute_sizes),
+           WriteColumn(dir_path, kNameOffsetsFile, name_offsets),
+           WriteColumn(dir_path, kNameEventsFile, name_events),
+           WriteColumn(dir_path, kHashesFile, hash_keys),
+           WriteColumn(dir_path, kHashOffsetsFile, hash_offsets),
+           WriteColumn(dir_path, kHashEventsFile, hash_events),
+           WriteColumn(dir_path, kTimeIndexFile, time_index),
+           WriteText(dir_path, kNamesFile, names_text),
+           // Written last, so that a store is only complete once it exists.
+           WriteText(dir_path, kMetadataFile, metadata),
+       }) {
+    if (!status.ok()) return status;
+  }
+
+  stats.num_events = num_events;
+  stats.num_names = names.size();
+  stats.num_hashes = hash_keys.size();
+  return stats;
+}
+
+absl::StatusOr<EventStore> EventStore::Open(const std::string& dir) {
+  const fs::path dir_path(dir);
+  absl::StatusOr<InputBuffer> metadata_buffer =
+      InputBuffer::Create((dir_path / kMetadataFile).string());
+  if (!metadata_buffer.ok()) return metadata_buffer.status();
+  absl::Span<const uint8_t> metadata_bytes = metadata_buffer->GetBuffer();
+  const absl::string_view metadata(
+      reinterpret_cast<const char*>(metadata_bytes.data()),
+      metadata_bytes.size());
+
+  std::map<std::string, int64_t, std::less<>> sizes;
+  bool first_line = true;
+  for (absl::string_view line : absl::StrSplit(metadata, '\n')) {
+    if (first_line) {
+      if (line != kFormatVersion) {
+        return absl::FailedPreconditionError(
+            absl::StrCat(dir, " is not an event store of this version"));
+      }
+      first_line = false;
+      continue;
+    }
+    if (line.empty()) continue;
+    std::pair<absl::string_view, absl::string_view> entry =
+        absl::StrSplit(line, absl::MaxSplits(' ', 1));
+    int64_t value = 0;
+    if (!absl::SimpleAtoi(entry.second, &value) || value < 0)
+      return absl::DataLossError(absl::StrCat(dir, ": bad metadata: ", line));
+    sizes[std::string(entry.first)] = value;
+  }
+  for (const char* key : {"events", "names", "hashes", "attributes_size",
+                          "min_timestamp_ns", "time_bucket_ns",
+                          "time_buckets"}) {
+    if (sizes.find(key) == sizes.end())
+      return absl::DataLossError(absl::StrCat(dir, ": no ", key, " metadata"));
+  }
+  const size_t num_events = sizes["events"];
+  const size_t num_names = sizes["names"];
+  const size_t num_hashes = sizes["hashes"];
+
+  EventStore store;
+  store.min_timestamp_ns_ = sizes["min_timestamp_ns"];
+  store.time_bucket_ns_ = sizes["time_bucket_ns"];
+  if (store.time_bucket_ns_ == 0)
+    return absl::DataLossError(absl::StrCat(dir, ": no time buckets"));
+
+  absl::Span<const char> names_text;
+  absl::Span<const char> attributes;
+  std::vector<InputBuffer>* files = &store.files_;
+  for (absl::Status status : {
+           MapColumn(dir_path, kTimestampsFile, num_events, files,
+                     &store.timestamps_),
+           MapColumn(dir_path, kNameIdsFile, num_events, files,
+                     &store.name_ids_),
+           MapColumn(dir_path, kThreadsFile, num_events, files,
+                     &store.threads_),
+           MapColumn(dir_path, kValuesFile, num_events, files,
+                     &store.values_),
+           MapColumn(dir_path, kAttributeOffsetsFile, num_events, files,
+                     &store.attribute_offsets_),
+           MapColumn(dir_path, kAttributeSizesFile, num_events, files,
+                     &store.attribute_sizes_),
+           MapColumn(dir_path, kAttributesFile, sizes["attributes_size"], files,
+                     &attributes),
+           MapColumn(dir_path, kNameOffsetsFile, num_names + 1, files,
+                     &store.name_offsets_),
+           MapColumn(dir_path, kNameEventsFile, num_events, files,
+                     &store.name_events_),
+           MapColumn(dir_path, kHashesFile, num_hashes, files, &store.hashes_),
+           MapColumn(dir_path, kHashOffsetsFile, num_hashes + 1, files,
+                     &store.hash_offsets_),
+           MapColumn(dir_path, kHashEventsFile,
+                     store.hash_offsets_.empty() ? 0
+                                                 : store.hash_offsets_.back(),
+                     files, &store.hash_events_),
+           MapColumn(dir_path, kTimeIndexFile, sizes["time_buckets"] + 1, files,
+                     &store.time_index_),
+       }) {
+    if (!status.ok()) return status;
+  }
+  store.attributes_ = std::string_view(attributes.data(), attributes.size());
+
+  absl::StatusOr<InputBuffer> names_buffer =
+      InputBuffer::Create((dir_path / kNamesFile).string());
+  if (!names_buffer.ok()) return names_buffer.status();
+  absl::Span<const uint8_t> names_bytes = names_buffer->GetBuffer();
+  for (absl::string_view name : absl::StrSplit(
+           absl::string_view(reinterpret_cast<const char*>(names_bytes.data()),
+                             names_bytes.size()),
+           '\n', absl::SkipEmpty())) {
+    store.names_.push_back(std::string(name));
+  }
+  if (store.names_.size() != num_names)
+    return absl::DataLossError(absl::StrCat(dir, ": expected ", num_names,
+                                            " event names"));
+  for (uint32_t name_id : store.name_ids_) {
+    if (name_id >= num_names)
+      return absl::DataLossError(absl::StrCat(dir, ": bad event name"));
+  }
+  return store;
+}
+
+std::optional<int64_t> EventStore::GetValue(uint32_t event) const {
+  if (values_[event] == kNoValue) return std::nullopt;
+  return values_[event];
+}
+
+std::string_view EventStore::GetAttributes(uint32_t event) const {
+  return attributes_.substr(attribute_offsets_[event], attribute_sizes_[event]);
+}
+
+uint32_t EventStore::LowerBound(int64_t timestamp_ns) const {
+  const size_t num_events = GetNumEvents();
+  if (num_events == 0 || timestamp_ns <= min_timestamp_ns_) return 0;
+  const uint64_t bucket =
+      (static_cast<uint64_t>(timestamp_ns) - min_timestamp_ns_) /
+      time_bucket_ns_;
+  if (bucket + 1 >= time_index_.size()) return num_events;
+  // All the events of the bucket are in [bucket start, next bucket start).
+  const auto first = timestamps_.begin() + time_index_[bucket];
+  const auto last = timestamps_.begin() + time_index_[bucket + 1];
+  return std::lower_bound(first, last, timestamp_ns) - timestamps_.begin();
+}
+
+std::vector<uint32_t> EventStore::Query(const EventQuery& query) const {
+  const uint32_t begin = query.begin_ns ? LowerBound(*query.begin_ns) : 0;
+  const uint32_t end =
+      query.end_ns ? LowerBound(*query.end_ns) : GetNumEvents();
+  if (begin >= end) return {};
+
+  // The events of the name and of the hash, within the time range.
+  std::vector<absl::Span<const uint32_t>> lists;
+  if (query.name) {
+    auto name = std::find(names_.begin(), names_.end(), *query.name);
+    if (name == names_.end()) return {};
+    const size_t name_id = name - names_.begin();
+    lists.push_back(Restrict(
+        name_events_.subspan(name_offsets_[name_id],
+                             name_offsets_[name_id + 1] -
+                                 name_offsets_[name_id]),
+        begin, end));
+  }
+  if (query.hash) {
+    auto hash = std::lower_bound(hashes_.begin(), hashes_.end(), *query.hash);
+    if (hash == hashes_.end() || *hash != *query.hash) return {};
+    const size_t hash_id = hash - hashes_.begin();
+    lists.push_back(Restrict(
+        hash_events_.subspan(hash_offsets_[hash_id],
+                             hash_offsets_[hash_id + 1] -
+                                 hash_offsets_[hash_id]),
+        begin, end));
+  }
+
+  std::vector<uint32_t> events;
+  auto add = [&events, &query, this](uint32_t event) {
+    if (!query.thread || threads_[event] == *query.thread)
+      events.push_back(event);
+  };
+  if (lists.empty()) {
+    for (uint32_t event = begin; event != end; ++event) add(event);
+  } else if (lists.size() == 1) {
+    for (uint32_t event : lists[0]) add(event);
+  } else {
+    // Look the events of the shorter list up in the longer one.
+    if (lists[0].size() > lists[1].size()) std::swap(lists[0], lists[1]);
+    auto next = lists[1].begin();
+    for (uint32_t event : lists[0]) {
+      next = std::lower_bound(next, lists[1].end(), event);
+      if (next == lists[1].end()) break;
+      if (*next == event) add(event);
+    }
+  }
+  return events;
+}
+
+std::vector<EventAggregate> AggregateEvents(const EventStore& store,
+                                            const std::vector<uint32_t>& events,
+                                            std::string_view value_attribute) {
+  std::map<std::string_view, std::vector<double>> values;
+  std::map<std::string_view, uint64_t> counts;
+  std::vector<std::string_view> fields;
+  for (uint32_t event : events) {
+    const std::string_view name = store.GetName(event);
+    ++counts[name];
+    std::vector<double>& event_values = values[name];
+    if (value_attribute.empty()) {
+      if (std::optional<int64_t> value = store.GetValue(event))
+        event_values.push_back(*value);
+      continue;
+    }
+    CsvReader reader(store.GetAttributes(event));
+    if (!reader.NextRow(&fields)) continue;
+    for (std::string_view field : fields) {
+      std::string_view attribute;
+      std::string_view text;
+      int64_t value = 0;
+      if (SplitAttribute(field, &attribute, &text) &&
+          attribute == value_attribute && ParseInt64(text, &value)) {
+        event_values.push_back(value);
+        break;
+      }
+    }
+  }
+
+  std::vector<EventAggregate> aggregates;
+  for (auto& [name, name_values] : values) {
+    EventAggregate aggregate;
+    aggregate.name = std::string(name);
+    aggregate.num_events = counts[name];
+    aggregate.num_values = name_values.size();
+    if (!name_values.empty()) {
+      std::sort(name_values.begin(), name_values.end());
+      aggregate.sum =
+          std::accumulate(name_values.begin(), name_values.end(), 0.0);
+      aggregate.min = name_values.front();
+      aggregate.max = name_values.back();
+      aggregate.p50 = Percentile(name_values, 50);
+      aggregate.p95 = Percentile(name_values, 95);
+    }
+    aggregates.push_back(std::move(aggregate));
+  }
+  return aggregates;
+}
+
+}  // namespace performancelayers
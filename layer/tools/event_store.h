@@ -0,0 +1,149 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_EVENT_STORE_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_EVENT_STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "layer/support/input_buffer.h"
+
+// A columnar store of the events of event logs, i.e., of the rows written by
+// `EventToCommonLogStr`, that answers queries by event name, pipeline or
+// shader hash, time range and thread without reading the whole log.
+//
+// A store is a directory of files, one per column or index, in the byte order
+// of the machine that built it:
+//  - The events, sorted by timestamp: their timestamp, the id of their name in
+//    the dictionary of names, their thread, their value, i.e., the first of
+//    their duration, runtime or frame time, and the range of their attributes
+//    in the attribute text, which is in log order.
+//  - For every name, and for every hash an event refers to, the sorted list
+//    of the events.
+//  - For every time bucket, the first event of the bucket.
+// The files are memory mapped when the store is opened, so that queries only
+// touch the pages of the events they select.
+
+namespace performancelayers {
+struct EventStoreOptions {
+  // The duration of the time buckets of the time index.
+  int64_t time_bucket_ns = 1000000000;
+};
+
+struct EventStoreBuildStats {
+  uint64_t num_events = 0;
+  // The lines that are not events, e.g., truncated by a crash.
+  uint64_t num_malformed_lines = 0;
+  uint64_t num_names = 0;
+  uint64_t num_hashes = 0;
+};
+
+// Builds the store of the events of |logs|, the contents of event logs, in
+// the directory |dir|, which is created if needed.
+absl::StatusOr<EventStoreBuildStats> BuildEventStore(
+    const std::vector<std::string_view>& logs, const std::string& dir,
+    const EventStoreOptions& options);
+
+// Selects the events that match all the given criteria.
+struct EventQuery {
+  std::optional<std::string> name;
+  // A pipeline or shader hash the event refers to.
+  std::optional<uint64_t> hash;
+  // The time range, as timestamps in nanoseconds, |end_ns| excluded.
+  std::optional<int64_t> begin_ns;
+  std::optional<int64_t> end_ns;
+  std::optional<int64_t> thread;
+};
+
+class EventStore {
+ public:
+  // The thread of the events logged without one.
+  static constexpr int64_t kNoThread = -1;
+
+  static absl::StatusOr<EventStore> Open(const std::string& dir);
+
+  size_t GetNumEvents() const { return timestamps_.size(); }
+
+  int64_t GetTimestamp(uint32_t event) const { return timestamps_[event]; }
+  std::string_view GetName(uint32_t event) const {
+    return names_[name_ids_[event]];
+  }
+  int64_t GetThread(uint32_t event) const { return threads_[event]; }
+  std::optional<int64_t> GetValue(uint32_t event) const;
+  // Returns the attributes of |event|, as written in the log, e.g.,
+  // `hashes:"[0x1,0x2]",duration:42`.
+  std::string_view GetAttributes(uint32_t event) const;
+
+  // Returns the events that match |query|, sorted by timestamp.
+  std::vector<uint32_t> Query(const EventQuery& query) const;
+
+ private:
+  EventStore() = default;
+
+  // Returns the first event at or after |timestamp_ns|.
+  uint32_t LowerBound(int64_t timestamp_ns) const;
+
+  std::vector<InputBuffer> files_;
+  std::vector<std::string> names_;
+  int64_t min_timestamp_ns_ = 0;
+  int64_t time_bucket_ns_ = 0;
+  absl::Span<const int64_t> timestamps_;
+  absl::Span<const uint32_t> name_ids_;
+  absl::Span<const int64_t> threads_;
+  absl::Span<const int64_t> values_;
+  absl::Span<const uint64_t> attribute_offsets_;
+  absl::Span<const uint32_t> attribute_sizes_;
+  std::string_view attributes_;
+  absl::Span<const uint64_t> name_offsets_;
+  absl::Span<const uint32_t> name_events_;
+  absl::Span<const uint64_t> hashes_;
+  absl::Span<const uint64_t> hash_offsets_;
+  absl::Span<const uint32_t> hash_events_;
+  absl::Span<const uint32_t> time_index_;
+};
+
+// The statistics of the values of the events with the same name.
+struct EventAggregate {
+  std::string name;
+  uint64_t num_events = 0;
+  // The number of events with a value, and the statistics of the values.
+  uint64_t num_values = 0;
+  double sum = 0;
+  double min = 0;
+  double max = 0;
+  double p50 = 0;
+  double p95 = 0;
+};
+
+// Parses |text|, a hash as written by `EventToCommonLogStr`, e.g., "0x1f",
+// into |hash|. Returns false if it is not one.
+bool ParseHash(std::string_view text, uint64_t* hash);
+
+// Aggregates the values of |events| of |store| by event name, sorted by name.
+// The values are those of the |value_attribute| attribute of the events, or,
+// if it is empty, their value column.
+std::vector<EventAggregate> AggregateEvents(const EventStore& store,
+                                            const std::vector<uint32_t>& events,
+                                            std::string_view value_attribute);
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_EVENT_STORE_H_
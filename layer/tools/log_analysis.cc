@@ -0,0 +1,378 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/tools/log_analysis.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <filesystem>
+#include <numeric>
+#include <thread>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "layer/tools/log_reader.h"
+
+namespace performancelayers {
+namespace {
+constexpr double kNanosPerSecond = 1e9;
+constexpr double kNanosPerMilli = 1e6;
+constexpr int64_t kNanosPerSecondInt = 1000000000;
+
+// Returns |values| sorted.
+std::vector<double> Sorted(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  return values;
+}
+
+double Mean(const std::vector<double>& values) {
+  if (values.empty()) return 0;
+  return std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+}
+
+// The population standard deviation, like numpy.std.
+double StandardDeviation(const std::vector<double>& values) {
+  if (values.empty()) return 0;
+  const double mean = Mean(values);
+  double sum_of_squares = 0;
+  for (double value : values) sum_of_squares += (value - mean) * (value - mean);
+  return std::sqrt(sum_of_squares / values.size());
+}
+
+// The events of a part of an event log, with absolute timestamps.
+struct EventChunk {
+  int64_t first_timestamp_ns = 0;
+  int64_t last_timestamp_ns = 0;
+  uint64_t num_events = 0;
+  uint64_t num_malformed_lines = 0;
+  std::map<std::string, uint64_t, std::less<>> event_counts;
+  // The timestamp and benchmark state of every frame_present event.
+  std::vector<std::pair<int64_t, int64_t>> frames;
+  // The timestamp of every pipeline creation, and the creation.
+  std::vector<std::pair<int64_t, PipelineCreation>> pipeline_creations;
+};
+
+EventChunk ParseEventChunk(std::string_view contents) {
+  EventChunk chunk;
+  CsvReader reader(contents);
+  std::vector<std::string_view> fields;
+  while (reader.NextRow(&fields)) {
+    std::optional<int64_t> timestamp_ns =
+        FindIntEventAttribute(fields, "timestamp");
+    if (!timestamp_ns) {
+      ++chunk.num_malformed_lines;
+      continue;
+    }
+    if (chunk.num_events++ == 0) chunk.first_timestamp_ns = *timestamp_ns;
+    chunk.last_timestamp_ns = std::max(chunk.last_timestamp_ns, *timestamp_ns);
+    const std::string_view name = fields[0];
+    // Look the name up as a view, to copy it only the first time it's seen.
+    auto count_it = chunk.event_counts.find(name);
+    if (count_it == chunk.event_counts.end())
+      count_it = chunk.event_counts.emplace(name, 0).first;
+    ++count_it->second;
+
+    if (name == "frame_present") {
+      chunk.frames.emplace_back(
+          *timestamp_ns,
+          FindIntEventAttribute(fields, "started").value_or(0));
+    } else if (name == "create_graphics_pipelines" ||
+               name == "create_compute_pipelines") {
+      auto& [creation_timestamp_ns, creation] =
+          chunk.pipeline_creations.emplace_back();
+      creation_timestamp_ns = *timestamp_ns;
+      creation.duration_ms =
+          FindIntEventAttribute(fields, "duration").value_or(0) /
+          kNanosPerMilli;
+      creation.compute = name == "create_compute_pipelines";
+    }
+  }
+  return chunk;
+}
+
+// Splits |contents| into up to |max_chunks| parts of whole lines, none
+// smaller than |kMinChunkSize| so that small logs aren't split.
+std::vector<std::string_view> SplitAtLines(std::string_view contents,
+                                           size_t max_chunks) {
+  constexpr size_t kMinChunkSize = 16 << 20;
+  const size_t num_chunks = std::clamp<size_t>(
+      contents.size() / kMinChunkSize, 1, std::max<size_t>(max_chunks, 1));
+  std::vector<std::string_view> chunks;
+  size_t chunk_start = 0;
+  for (size_t i = 1; i < num_chunks; ++i) {
+    const size_t split = contents.find(
+        '\n', std::max(chunk_start, contents.size() / num_chunks * i));
+    if (split == std::string_view::npos) break;
+    chunks.push_back(contents.substr(chunk_start, split + 1 - chunk_start));
+    chunk_start = split + 1;
+  }
+  chunks.push_back(contents.substr(chunk_start));
+  return chunks;
+}
+}  // namespace
+
+double FrameTimeStats::GetTimeInStateS(int64_t state) const {
+  auto it = state_duration_ms.find(state);
+  return it != state_duration_ms.end() ? it->second / 1000 : 0;
+}
+
+std::vector<FpsBin> FrameTimeStats::GetFpsOverTime() const {
+  assert(frame_times_ns.size() == frame_states.size());
+  const int64_t total_duration_ns = std::accumulate(
+      frame_times_ns.begin(), frame_times_ns.end(), int64_t(0));
+  std::vector<FpsBin> bins(total_duration_ns / kNanosPerSecondInt + 1);
+  int64_t duration_ns = 0;
+  for (size_t i = 0; i != frame_times_ns.size(); ++i) {
+    duration_ns += frame_times_ns[i];
+    // Keep the state of the last frame in the second.
+    FpsBin& bin = bins[duration_ns / kNanosPerSecondInt];
+    ++bin.frames;
+    bin.state = frame_states[i];
+  }
+  return bins;
+}
+
+double Percentile(const std::vector<double>& sorted_values,
+                  double percentile) {
+  if (sorted_values.empty()) return 0;
+  const double rank = percentile / 100 * (sorted_values.size() - 1);
+  const size_t lower = static_cast<size_t>(std::floor(rank));
+  const size_t upper = std::min(lower + 1, sorted_values.size() - 1);
+  return sorted_values[lower] +
+         (sorted_values[upper] - sorted_values[lower]) * (rank - lower);
+}
+
+absl::StatusOr<FrameTimeStats> AnalyzeFrameTimeLog(
+    std::string_view path, std::string_view contents,
+    const FrameTimeFilter& filter) {
+  CsvReader reader(contents);
+  std::vector<std::string_view> fields;
+  // Skip the header.
+  reader.NextRow(&fields);
+  std::vector<int64_t> frame_times_ns;
+  std::vector<int64_t> frame_states;
+  while (reader.NextRow(&fields)) {
+    int64_t frame_time_ns = 0;
+    int64_t state = 0;
+    if (fields.size() != 2 || !ParseInt64(fields[0], &frame_time_ns) ||
+        !ParseInt64(fields[1], &state)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat(std::string(path), ":", reader.GetLineNumber(),
+                       ": expected '<frame time>,<state>'"));
+    }
+    frame_times_ns.push_back(frame_time_ns);
+    frame_states.push_back(state);
+  }
+  return AnalyzeFrameTimes(path, frame_times_ns, frame_states, filter);
+}
+
+absl::StatusOr<FrameTimeStats> AnalyzeFrameTimes(
+    std::string_view path, const std::vector<int64_t>& frame_times_ns,
+    const std::vector<int64_t>& frame_states, const FrameTimeFilter& filter) {
+  assert(frame_times_ns.size() == frame_states.size());
+  FrameTimeStats stats;
+  stats.path = std::string(path);
+  const std::filesystem::path fs_path(stats.path);
+  stats.run_name =
+      (fs_path.parent_path().filename() / fs_path.filename()).string();
+
+  std::map<int64_t, int64_t> state_duration_ns;
+  for (size_t i = 0; i != frame_times_ns.size(); ++i) {
+    state_duration_ns[frame_states[i]] += frame_times_ns[i];
+    if (filter.gameplay_state && *filter.gameplay_state != frame_states[i])
+      continue;
+    stats.frame_times_ns.push_back(frame_times_ns[i]);
+    stats.frame_states.push_back(frame_states[i]);
+  }
+  for (const auto& [state, duration_ns] : state_duration_ns)
+    stats.state_duration_ms[state] = duration_ns / kNanosPerMilli;
+
+  size_t begin = 0;
+  size_t end = stats.frame_times_ns.size();
+  if (filter.drop_front_s) {
+    // Drop the frames that end before the given time.
+    const int64_t drop_ns = *filter.drop_front_s * kNanosPerSecondInt;
+    int64_t duration_ns = 0;
+    while (begin != end) {
+      duration_ns += stats.frame_times_ns[begin];
+      if (duration_ns >= drop_ns) break;
+      ++begin;
+    }
+  }
+  if (filter.duration_s) {
+    // Keep the frames up to the first that ends after the given time.
+    const int64_t duration_limit_ns = *filter.duration_s * kNanosPerSecondInt;
+    int64_t duration_ns = 0;
+    size_t kept_end = begin;
+    while (kept_end != end) {
+      duration_ns += stats.frame_times_ns[kept_end++];
+      if (duration_ns > duration_limit_ns) break;
+    }
+    end = kept_end;
+  }
+  stats.frame_times_ns.assign(stats.frame_times_ns.begin() + begin,
+                              stats.frame_times_ns.begin() + end);
+  stats.frame_states.assign(stats.frame_states.begin() + begin,
+                            stats.frame_states.begin() + end);
+  if (stats.frame_times_ns.empty()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat(stats.path, ": no frames left"));
+  }
+
+  std::vector<double> sorted_frame_times(stats.frame_times_ns.begin(),
+                                         stats.frame_times_ns.end());
+  std::sort(sorted_frame_times.begin(), sorted_frame_times.end());
+  const double total_ns = std::accumulate(sorted_frame_times.begin(),
+                                          sorted_frame_times.end(), 0.0);
+  const double target_frame_time_ns =
+      kNanosPerSecond / FrameTimeStats::kTargetFps;
+  const size_t num_missed =
+      sorted_frame_times.end() -
+      std::upper_bound(sorted_frame_times.begin(), sorted_frame_times.end(),
+                       target_frame_time_ns);
+
+  stats.total_duration_ms = total_ns / kNanosPerMilli;
+  stats.average_frame_time_ms =
+      total_ns / sorted_frame_times.size() / kNanosPerMilli;
+  stats.p50_ms = Percentile(sorted_frame_times, 50) / kNanosPerMilli;
+  stats.p90_ms = Percentile(sorted_frame_times, 90) / kNanosPerMilli;
+  stats.p95_ms = Percentile(sorted_frame_times, 95) / kNanosPerMilli;
+  stats.missed_percent = 100.0 * num_missed / sorted_frame_times.size();
+  return stats;
+}
+
+const std::vector<SummaryFunction>& GetSummaryFunctions() {
+  static const auto* functions = new std::vector<SummaryFunction>{
+      {"P5",
+       [](std::vector<double> values) {
+         return Percentile(Sorted(std::move(values)), 5);
+       },
+       false},
+      {"Median",
+       [](std::vector<double> values) {
+         return Percentile(Sorted(std::move(values)), 50);
+       },
+       false},
+      {"P95",
+       [](std::vector<double> values) {
+         return Percentile(Sorted(std::move(values)), 95);
+       },
+       false},
+      {"Std Dev",
+       [](std::vector<double> values) { return StandardDeviation(values); },
+       false},
+      {"Noise",
+       [](std::vector<double> values) {
+         const std::vector<double> sorted = Sorted(std::move(values));
+         const double low = Percentile(sorted, 5);
+         const double high = Percentile(sorted, 95);
+         return std::abs(low - high) / low * 100;
+       },
+       true},
+  };
+  return *functions;
+}
+
+std::vector<MetricSummary> SummarizeFrameTimes(
+    const std::vector<FrameTimeStats>& runs) {
+  struct Metric {
+    const char* name;
+    double (*get)(const FrameTimeStats&);
+  };
+  static constexpr Metric kMetrics[] = {
+      {"avg",
+       [](const FrameTimeStats& run) { return run.average_frame_time_ms; }},
+      {"median", [](const FrameTimeStats& run) { return run.p50_ms; }},
+      {"p90", [](const FrameTimeStats& run) { return run.p90_ms; }},
+      {"p95", [](const FrameTimeStats& run) { return run.p95_ms; }},
+      {"missed_percent",
+       [](const FrameTimeStats& run) { return run.missed_percent; }},
+      {"init_time",
+       [](const FrameTimeStats& run) { return run.GetTimeInStateS(0); }},
+  };
+
+  std::vector<MetricSummary> summaries;
+  for (const Metric& metric : kMetrics) {
+    std::vector<double> values;
+    for (const FrameTimeStats& run : runs) values.push_back(metric.get(run));
+    MetricSummary& summary = summaries.emplace_back();
+    summary.metric = metric.name;
+    for (const SummaryFunction& function : GetSummaryFunctions())
+      summary.values.push_back(function.function(values));
+  }
+  return summaries;
+}
+
+EventTimeline AnalyzeEventLog(std::string_view contents,
+                              size_t max_threads) {
+  std::vector<std::string_view> chunks = SplitAtLines(contents, max_threads);
+  std::vector<EventChunk> parsed_chunks(chunks.size());
+  RunInParallel(chunks.size(), max_threads, [&](size_t i) {
+    parsed_chunks[i] = ParseEventChunk(chunks[i]);
+  });
+
+  EventTimeline timeline;
+  std::optional<int64_t> start_ns;
+  int64_t end_ns = 0;
+  // The frame_present times, for the rolling FPS.
+  std::vector<int64_t> frame_times_ns;
+  size_t first_frame_in_window = 0;
+  for (EventChunk& chunk : parsed_chunks) {
+    timeline.num_events += chunk.num_events;
+    timeline.num_malformed_lines += chunk.num_malformed_lines;
+    for (const auto& [name, count] : chunk.event_counts)
+      timeline.event_counts[name] += count;
+    if (chunk.num_events == 0) continue;
+    if (!start_ns) start_ns = chunk.first_timestamp_ns;
+    end_ns = std::max(end_ns, chunk.last_timestamp_ns);
+
+    for (const auto& [timestamp_ns, state] : chunk.frames) {
+      const int64_t time_ns = timestamp_ns - *start_ns;
+      frame_times_ns.push_back(time_ns);
+      while (frame_times_ns[first_frame_in_window] <=
+             time_ns - kNanosPerSecondInt) {
+        ++first_frame_in_window;
+      }
+      FpsPoint& point = timeline.fps.emplace_back();
+      point.time_s = time_ns / kNanosPerSecond;
+      point.fps = static_cast<int64_t>(frame_times_ns.size() -
+                                       first_frame_in_window);
+      point.state = state;
+    }
+    for (auto& [timestamp_ns, creation] : chunk.pipeline_creations) {
+      creation.time_s = (timestamp_ns - *start_ns) / kNanosPerSecond;
+      timeline.pipeline_creations.push_back(creation);
+    }
+  }
+  if (start_ns) timeline.duration_s = (end_ns - *start_ns) / kNanosPerSecond;
+  return timeline;
+}
+
+void RunInParallel(size_t num_tasks, size_t max_threads,
+                   const std::function<void(size_t)>& task) {
+  std::atomic<size_t> next_task = 0;
+  auto run_tasks = [&] {
+    for (size_t i = next_task++; i < num_tasks; i = next_task++) task(i);
+  };
+  std::vector<std::thread> threads;
+  const size_t num_threads =
+      std::min(num_tasks, std::max<size_t>(max_threads, 1));
+  for (size_t i = 1; i < num_threads; ++i) threads.emplace_back(run_tasks);
+  run_tasks();
+  for (std::thread& thread : threads) thread.join();
+}
+
+}  // namespace performancelayers
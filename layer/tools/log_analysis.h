@@ -0,0 +1,157 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LOG_ANALYSIS_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LOG_ANALYSIS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/status/statusor.h"
+
+// The analyses of scripts/analyze_frametimes.py and the parsing of
+// scripts/plot_timeline.py, on the logs read with `CsvReader`.
+
+namespace performancelayers {
+// Selects the frames of a frame time log that are analyzed.
+struct FrameTimeFilter {
+  // Only the frames in this benchmark state are analyzed, if set.
+  std::optional<int64_t> gameplay_state;
+  // The frames of the first seconds are dropped, if set.
+  std::optional<int64_t> drop_front_s;
+  // The frames after this many seconds are dropped, if set.
+  std::optional<int64_t> duration_s;
+};
+
+// The frames per second in one second of a run, and the benchmark state of the
+// last frame in that second.
+struct FpsBin {
+  int64_t frames = 0;
+  int64_t state = 0;
+};
+
+// The statistics of one frame time layer log.
+struct FrameTimeStats {
+  static constexpr double kTargetFps = 45;
+
+  std::string path;
+  // The name of the log's directory and the log's name, to tell the runs
+  // apart.
+  std::string run_name;
+  std::vector<int64_t> frame_times_ns;
+  std::vector<int64_t> frame_states;
+  double total_duration_ms = 0;
+  double average_frame_time_ms = 0;
+  double p50_ms = 0;
+  double p90_ms = 0;
+  double p95_ms = 0;
+  // The percentage of frames longer than the frame time at `kTargetFps`.
+  double missed_percent = 0;
+  // The time spent in every benchmark state, including the frames that were
+  // filtered out.
+  std::map<int64_t, double> state_duration_ms;
+
+  double GetTimeInStateS(int64_t state) const;
+
+  // Returns the frames per second in every second of the run.
+  std::vector<FpsBin> GetFpsOverTime() const;
+};
+
+// Returns the |percentile| of |sorted_values|, linearly interpolated between
+// the closest ranks, like numpy.percentile.
+double Percentile(const std::vector<double>& sorted_values, double percentile);
+
+// Parses |contents|, the CSV log of the frame time layer at |path|, and
+// computes its statistics over the frames selected by |filter|.
+absl::StatusOr<FrameTimeStats> AnalyzeFrameTimeLog(
+    std::string_view path, std::string_view contents,
+    const FrameTimeFilter& filter);
+
+// Computes the statistics of the frames of the log at |path|, whose frame
+// times and benchmark states are given, over the frames selected by |filter|.
+absl::StatusOr<FrameTimeStats> AnalyzeFrameTimes(
+    std::string_view path, const std::vector<int64_t>& frame_times_ns,
+    const std::vector<int64_t>& frame_states, const FrameTimeFilter& filter);
+
+// A statistic of the runs of a dataset, e.g., the median.
+struct SummaryFunction {
+  const char* name;
+  std::function<double(std::vector<double>)> function;
+  // Relative summaries are percentages.
+  bool relative;
+};
+
+// Returns the summaries of analyze_frametimes.py: the 5th percentile, the
+// median, the 95th percentile, the standard deviation and the noise, i.e., the
+// spread between the 5th and 95th percentiles relative to the former.
+const std::vector<SummaryFunction>& GetSummaryFunctions();
+
+// A metric of the runs of a dataset, e.g., the median frame time, and its
+// value for every summary function.
+struct MetricSummary {
+  const char* metric;
+  std::vector<double> values;
+};
+
+// Summarizes the average, median, p90 and p95 frame time, the percentage of
+// missed frames and the time spent in state 0, usually the loading screens, of
+// |runs|.
+std::vector<MetricSummary> SummarizeFrameTimes(
+    const std::vector<FrameTimeStats>& runs);
+
+// The frames per second at a frame_present event of an event log: the
+// number of frames in the second before it.
+struct FpsPoint {
+  double time_s = 0;
+  int64_t fps = 0;
+  int64_t state = 0;
+};
+
+// A create_graphics_pipelines or create_compute_pipelines event.
+struct PipelineCreation {
+  double time_s = 0;
+  double duration_ms = 0;
+  bool compute = false;
+};
+
+// The timeline of an event log, with the times relative to its first event.
+struct EventTimeline {
+  double duration_s = 0;
+  uint64_t num_events = 0;
+  // The lines that are not events, e.g., truncated by a crash.
+  uint64_t num_malformed_lines = 0;
+  std::map<std::string, uint64_t, std::less<>> event_counts;
+  std::vector<FpsPoint> fps;
+  std::vector<PipelineCreation> pipeline_creations;
+};
+
+// Parses |contents|, an event log in the `CommonLogger` format. Large logs are
+// split at line boundaries and parsed from up to |max_threads| threads.
+EventTimeline AnalyzeEventLog(std::string_view contents,
+                              size_t max_threads = 1);
+
+// Calls |task| with every index in [0, |num_tasks|) from up to |max_threads|
+// threads, and returns once all are done.
+void RunInParallel(size_t num_tasks, size_t max_threads,
+                   const std::function<void(size_t)>& task);
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LOG_ANALYSIS_H_
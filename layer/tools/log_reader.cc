@@ -0,0 +1,113 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/tools/log_reader.h"
+
+#include <algorithm>
+#include <charconv>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace performancelayers {
+namespace {
+bool IsDelimiter(char c) { return c == ',' || c == '"' || c == '\n'; }
+
+// Strips the double quotes around |field|, if any.
+std::string_view Unquote(std::string_view field) {
+  if (field.size() >= 2 && field.front() == '"' && field.back() == '"')
+    return field.substr(1, field.size() - 2);
+  return field;
+}
+}  // namespace
+
+void DelimiterScanner::LoadBlock() {
+  const char* block = data_.data() + block_start_;
+#if defined(__SSE2__)
+  if (block_start_ + kBlockSize <= data_.size()) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    const __m128i delimiters = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(',')),
+                     _mm_cmpeq_epi8(bytes, _mm_set1_epi8('"'))),
+        _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')));
+    mask_ = static_cast<uint32_t>(_mm_movemask_epi8(delimiters));
+    return;
+  }
+#endif
+  const size_t block_size = std::min(kBlockSize, data_.size() - block_start_);
+  mask_ = 0;
+  for (size_t i = 0; i != block_size; ++i)
+    mask_ |= static_cast<uint32_t>(IsDelimiter(block[i])) << i;
+}
+
+bool CsvReader::NextRow(std::vector<std::string_view>* fields) {
+  while (row_start_ < data_.size()) {
+    fields->clear();
+    ++line_number_;
+    size_t field_start = row_start_;
+    bool in_quotes = false;
+    size_t position = 0;
+    while (true) {
+      position = scanner_.Next();
+      const char c = position < data_.size() ? data_[position] : '\n';
+      if (c == '"') {
+        in_quotes = !in_quotes;
+        continue;
+      }
+      if (c == ',' && in_quotes) continue;
+
+      std::string_view field =
+          data_.substr(field_start, position - field_start);
+      if (c == '\n' && !field.empty() && field.back() == '\r')
+        field.remove_suffix(1);
+      fields->push_back(Unquote(field));
+      field_start = position + 1;
+      if (c == '\n') break;
+    }
+    row_start_ = std::min(position + 1, data_.size());
+    if (fields->size() != 1 || !fields->front().empty()) return true;
+  }
+  fields->clear();
+  return false;
+}
+
+bool ParseInt64(std::string_view text, int64_t* value) {
+  const char* end = text.data() + text.size();
+  auto [parsed_end, error] = std::from_chars(text.data(), end, *value);
+  return error == std::errc() && parsed_end == end && !text.empty();
+}
+
+std::optional<std::string_view> FindEventAttribute(
+    const std::vector<std::string_view>& fields, std::string_view name) {
+  for (size_t i = 1; i < fields.size(); ++i) {
+    std::string_view field = fields[i];
+    if (field.size() > name.size() && field[name.size()] == ':' &&
+        field.substr(0, name.size()) == name) {
+      return field.substr(name.size() + 1);
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<int64_t> FindIntEventAttribute(
+    const std::vector<std::string_view>& fields, std::string_view name) {
+  std::optional<std::string_view> value = FindEventAttribute(fields, name);
+  int64_t parsed = 0;
+  if (!value || !ParseInt64(*value, &parsed)) return std::nullopt;
+  return parsed;
+}
+
+}  // namespace performancelayers
@@ -0,0 +1,98 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LOG_READER_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LOG_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace performancelayers {
+// Finds the delimiters of the logs the layers write, i.e., commas, double
+// quotes and line feeds, in order. The data is scanned 16 bytes at a time with
+// SSE2 where available, so that the bytes between delimiters are never looked
+// at one by one.
+class DelimiterScanner {
+ public:
+  explicit DelimiterScanner(std::string_view data) : data_(data) {
+    LoadBlock();
+  }
+
+  // Returns the position of the next delimiter, or the size of the data if
+  // there is none left.
+  size_t Next() {
+    while (mask_ == 0) {
+      block_start_ += kBlockSize;
+      if (block_start_ >= data_.size()) return data_.size();
+      LoadBlock();
+    }
+    const size_t position = block_start_ + __builtin_ctz(mask_);
+    mask_ &= mask_ - 1;
+    return position;
+  }
+
+ private:
+  static constexpr size_t kBlockSize = 16;
+
+  // Sets |mask_| to the delimiters of the block at |block_start_|.
+  void LoadBlock();
+
+  std::string_view data_;
+  size_t block_start_ = 0;
+  // A bit for every delimiter of the current block not returned yet.
+  uint32_t mask_ = 0;
+};
+
+// Reads the rows of the CSV files and event logs the layers write: fields are
+// separated by commas, and may be quoted with double quotes, which are
+// stripped, to hold commas; rows are separated by line feeds. Quoted fields
+// don't span lines, so a malformed row never affects the next one.
+class CsvReader {
+ public:
+  explicit CsvReader(std::string_view data) : data_(data), scanner_(data) {}
+
+  // Reads the next non-empty row into |fields|, which point into the data.
+  // Returns false once all the rows are read.
+  bool NextRow(std::vector<std::string_view>* fields);
+
+  // Returns the 1-based line number of the last row read.
+  uint64_t GetLineNumber() const { return line_number_; }
+
+ private:
+  std::string_view data_;
+  DelimiterScanner scanner_;
+  size_t row_start_ = 0;
+  uint64_t line_number_ = 0;
+};
+
+// Parses |text| as a decimal integer, with no surrounding characters. Returns
+// false if it is not one.
+bool ParseInt64(std::string_view text, int64_t* value);
+
+// Returns the value of the attribute |name| of a row of an event log, whose
+// fields after the event name are "<attribute>:<value>", if it has one.
+std::optional<std::string_view> FindEventAttribute(
+    const std::vector<std::string_view>& fields, std::string_view name);
+
+// Returns the value of the attribute |name| of a row of an event log, if it has
+// one and it is an integer.
+std::optional<int64_t> FindIntEventAttribute(
+    const std::vector<std::string_view>& fields, std::string_view name);
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_LOG_READER_H_
@@ -0,0 +1,482 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Analyzes the logs of the layers, like scripts/analyze_frametimes.py and
+// scripts/plot_timeline.py, without Python dependencies and at the speed of
+// the disk. The logs are memory mapped, and the files are analyzed in
+// parallel. Usage:
+//   performance_layers_analyze frame_times
+//       --dataset <name> <frame_time.csv>... [--dataset ...]
+//       [--duration=<s>] [--drop_front=<s>] [--gameplay_state=<n>]
+//       [--csv] [--verbose] [--output_dir=<dir>] [--json=<file>]
+//       [--threads=<n>]
+//   performance_layers_analyze timeline
+//       --dataset <name> <events.log> [--dataset ...]
+//       [--output_dir=<dir>] [--json=<file>] [--threads=<n>]
+// frame_times prints the statistics of analyze_frametimes.py for every
+// dataset of frame time layer logs, and writes the FPS over time of the runs
+// at the 5th, 50th and 95th percentile of the median frame time to
+// <dataset>_fps.csv. timeline writes the FPS at every frame and the pipeline
+// creation times of an event log to <dataset>_fps_timeline.csv and
+// <dataset>_pipelines.csv, to be plotted. --json writes all the results to one
+// JSON file instead.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "absl/types/span.h"
+#include "layer/support/input_buffer.h"
+#include "layer/tools/log_analysis.h"
+
+namespace performancelayers {
+namespace {
+namespace fs = std::filesystem;
+
+struct Dataset {
+  std::string name;
+  std::vector<std::string> paths;
+};
+
+struct Flags {
+  enum class Command { kFrameTimes, kTimeline };
+
+  Command command = Command::kFrameTimes;
+  std::vector<Dataset> datasets;
+  FrameTimeFilter filter;
+  bool csv = false;
+  bool verbose = false;
+  std::string output_dir = ".";
+  std::string json_path;
+  size_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+};
+
+bool ParseOptionalInt(absl::string_view value, std::optional<int64_t>* flag) {
+  int64_t parsed = 0;
+  if (!absl::SimpleAtoi(value, &parsed)) return false;
+  *flag = parsed;
+  return true;
+}
+
+bool ParseFlags(int argc, char** argv, Flags* flags) {
+  if (argc < 2) return false;
+  const absl::string_view command = argv[1];
+  if (command == "frame_times") {
+    flags->command = Flags::Command::kFrameTimes;
+  } else if (command == "timeline") {
+    flags->command = Flags::Command::kTimeline;
+  } else {
+    return false;
+  }
+
+  for (int i = 2; i != argc; ++i) {
+    absl::string_view arg = argv[i];
+    if (arg == "--dataset") {
+      if (++i == argc) return false;
+      flags->datasets.push_back({argv[i], {}});
+    } else if (absl::ConsumePrefix(&arg, "--duration=")) {
+      if (!ParseOptionalInt(arg, &flags->filter.duration_s)) return false;
+    } else if (absl::ConsumePrefix(&arg, "--drop_front=")) {
+      if (!ParseOptionalInt(arg, &flags->filter.drop_front_s)) return false;
+    } else if (absl::ConsumePrefix(&arg, "--gameplay_state=")) {
+      if (!ParseOptionalInt(arg, &flags->filter.gameplay_state)) return false;
+    } else if (arg == "--csv") {
+      flags->csv = true;
+    } else if (arg == "--verbose") {
+      flags->verbose = true;
+    } else if (absl::ConsumePrefix(&arg, "--output_dir=")) {
+      flags->output_dir = std::string(arg);
+    } else if (absl::ConsumePrefix(&arg, "--json=")) {
+      flags->json_path = std::string(arg);
+    } else if (absl::ConsumePrefix(&arg, "--threads=")) {
+      if (!absl::SimpleAtoi(arg, &flags->threads) || flags->threads == 0)
+        return false;
+    } else if (!absl::StartsWith(arg, "--") && !flags->datasets.empty()) {
+      flags->datasets.back().paths.push_back(std::string(arg));
+    } else {
+      return false;
+    }
+  }
+
+  if (flags->datasets.empty()) return false;
+  for (const Dataset& dataset : flags->datasets) {
+    if (dataset.paths.empty()) return false;
+    if (flags->command == Flags::Command::kTimeline &&
+        dataset.paths.size() != 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The amount of logs read, and the time spent reading and analyzing them,
+// excluding the time spent writing the results.
+struct Throughput {
+  std::atomic<uint64_t> num_bytes = 0;
+  std::chrono::steady_clock::duration analysis_time = {};
+};
+
+// Opens the file at |path| and calls |analyze| with its contents. Adds the
+// size of the file to |num_bytes|.
+template <typename AnalyzeFn>
+auto AnalyzeFile(const std::string& path, std::atomic<uint64_t>* num_bytes,
+                 AnalyzeFn analyze) -> decltype(analyze(std::string_view())) {
+  absl::StatusOr<InputBuffer> buffer = InputBuffer::Create(path);
+  if (!buffer.ok()) return buffer.status();
+  absl::Span<const uint8_t> bytes = buffer->GetBuffer();
+  num_bytes->fetch_add(bytes.size(), std::memory_order_relaxed);
+  return analyze(std::string_view(reinterpret_cast<const char*>(bytes.data()),
+                                  bytes.size()));
+}
+
+// Like analyze_frametimes.py, large values get an exponent.
+std::string FormatSummaryValue(double value, bool relative) {
+  std::string formatted = value < 1e6 ? absl::StrFormat("%.3f", value)
+                                      : absl::StrFormat("%.2e", value);
+  return relative ? formatted + "%" : formatted;
+}
+
+void PrintRun(const FrameTimeStats& run) {
+  printf("%s:\tduration: %.3f ms,\taverage: %.3f ms\n", run.run_name.c_str(),
+         run.total_duration_ms, run.average_frame_time_ms);
+  printf("\t\tmedian: %.3f ms,\tp90: %.3f ms,\t\t\tp95: %.3f ms\n",
+         run.p50_ms, run.p90_ms, run.p95_ms);
+  printf("\t\tmissed frames: %.3f%%\n", run.missed_percent);
+  for (const auto& [state, duration_ms] : run.state_duration_ms) {
+    printf("\t\ttime in state %lld: %.3f s\n", static_cast<long long>(state),
+           duration_ms / 1000);
+  }
+}
+
+// Writes the FPS over time of the runs at the 5th, 50th and 95th percentile of
+// the median frame time of a dataset to |path|.
+bool WriteFpsCsv(const std::string& path,
+                 const std::vector<const FrameTimeStats*>& sorted_runs) {
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) return false;
+  const std::vector<FpsBin> series[] = {
+      sorted_runs[sorted_runs.size() * 5 / 100]->GetFpsOverTime(),
+      sorted_runs[sorted_runs.size() / 2]->GetFpsOverTime(),
+      sorted_runs[sorted_runs.size() * 95 / 100]->GetFpsOverTime()};
+  fprintf(file,
+          "Second,Low FPS,Low State,Median FPS,Median State,High FPS,"
+          "High State\n");
+  const size_t num_seconds = std::min(
+      {series[0].size(), series[1].size(), series[2].size()});
+  for (size_t second = 0; second != num_seconds; ++second) {
+    fprintf(file, "%zu", second);
+    for (const std::vector<FpsBin>& bins : series) {
+      fprintf(file, ",%lld,%lld", static_cast<long long>(bins[second].frames),
+              static_cast<long long>(bins[second].state));
+    }
+    fprintf(file, "\n");
+  }
+  return fclose(file) == 0;
+}
+
+void AppendRunJson(const FrameTimeStats& run, std::string* json) {
+  absl::StrAppend(json, "{\"path\":\"", run.path, "\",\"duration_ms\":",
+                  run.total_duration_ms, ",\"average_ms\":",
+                  run.average_frame_time_ms, ",\"p50_ms\":",
+                  run.p50_ms, ",\"p90_ms\":",
+                  run.p90_ms, ",\"p95_ms\":",
+                  run.p95_ms, ",\"missed_percent\":",
+                  run.missed_percent, ",\"time_in_state_s\":{");
+  const char* separator = "";
+  for (const auto& [state, duration_ms] : run.state_duration_ms) {
+    absl::StrAppend(json, separator, "\"", state,
+                    "\":", duration_ms / 1000);
+    separator = ",";
+  }
+  absl::StrAppend(json, "},\"fps_over_time\":[");
+  separator = "";
+  for (const FpsBin& bin : run.GetFpsOverTime()) {
+    absl::StrAppend(json, separator, "[", bin.frames, ",", bin.state, "]");
+    separator = ",";
+  }
+  absl::StrAppend(json, "]}");
+}
+
+bool WriteFile(const std::string& path, const std::string& contents) {
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) return false;
+  fwrite(contents.data(), 1, contents.size(), file);
+  return fclose(file) == 0;
+}
+
+int RunFrameTimes(const Flags& flags, Throughput* throughput) {
+  struct Task {
+    size_t dataset;
+    const std::string* path;
+    absl::StatusOr<FrameTimeStats> result = absl::UnknownError("Not run");
+  };
+  std::vector<Task> tasks;
+  for (size_t i = 0; i != flags.datasets.size(); ++i) {
+    for (const std::string& path : flags.datasets[i].paths)
+      tasks.push_back({i, &path});
+  }
+  const auto start = std::chrono::steady_clock::now();
+  RunInParallel(tasks.size(), flags.threads, [&](size_t i) {
+    tasks[i].result = AnalyzeFile(
+        *tasks[i].path, &throughput->num_bytes,
+        [&](std::string_view contents) {
+          return AnalyzeFrameTimeLog(*tasks[i].path, contents, flags.filter);
+        });
+  });
+  throughput->analysis_time += std::chrono::steady_clock::now() - start;
+
+  const char* separator = flags.csv ? "," : "\t\t";
+  std::string json = "{\"datasets\":[";
+  for (size_t i = 0; i != flags.datasets.size(); ++i) {
+    const std::string& dataset_name = flags.datasets[i].name;
+    std::vector<FrameTimeStats> runs;
+    for (Task& task : tasks) {
+      if (task.dataset != i) continue;
+      if (!task.result.ok()) {
+        fprintf(stderr, "%s\n",
+                std::string(task.result.status().message()).c_str());
+        return EXIT_FAILURE;
+      }
+      runs.push_back(std::move(*task.result));
+    }
+
+    if (!flags.json_path.empty()) {
+      absl::StrAppend(&json, i == 0 ? "" : ",", "{\"name\":\"", dataset_name,
+                      "\",\"runs\":[");
+      for (size_t run = 0; run != runs.size(); ++run) {
+        if (run != 0) json += ",";
+        AppendRunJson(runs[run], &json);
+      }
+      absl::StrAppend(&json, "],\"summary\":{");
+      const char* metric_separator = "";
+      for (const MetricSummary& summary : SummarizeFrameTimes(runs)) {
+        absl::StrAppend(&json, metric_separator, "\"", summary.metric, "\":{");
+        for (size_t f = 0; f != summary.values.size(); ++f) {
+          absl::StrAppend(&json, f == 0 ? "" : ",", "\"",
+                          GetSummaryFunctions()[f].name,
+                          "\":", summary.values[f]);
+        }
+        json += "}";
+        metric_separator = ",";
+      }
+      json += "}}";
+      continue;
+    }
+
+    printf("~~~~ Processing dataset %s ~~~~\n\n", dataset_name.c_str());
+    if (flags.verbose) {
+      for (const FrameTimeStats& run : runs) {
+        PrintRun(run);
+        printf("\n");
+      }
+    }
+    printf("Dataset: %s%ssize: %zu\n", dataset_name.c_str(), separator,
+           runs.size());
+    printf("Metric");
+    for (const SummaryFunction& function : GetSummaryFunctions())
+      printf("%s%s", separator, function.name);
+    printf("\n");
+    for (const MetricSummary& summary : SummarizeFrameTimes(runs)) {
+      printf("%s", summary.metric);
+      for (size_t f = 0; f != summary.values.size(); ++f) {
+        printf("%s%s", separator,
+               FormatSummaryValue(summary.values[f],
+                                  GetSummaryFunctions()[f].relative)
+                   .c_str());
+      }
+      printf("\n");
+    }
+    printf("\n");
+
+    std::vector<const FrameTimeStats*> sorted_runs;
+    for (const FrameTimeStats& run : runs) sorted_runs.push_back(&run);
+    std::stable_sort(sorted_runs.begin(), sorted_runs.end(),
+                     [](const FrameTimeStats* a, const FrameTimeStats* b) {
+                       return a->p50_ms < b->p50_ms;
+                     });
+    printf("Median result for %s:\n", dataset_name.c_str());
+    PrintRun(*sorted_runs[sorted_runs.size() / 2]);
+    printf(
+        "---------------------------------------------------------------------"
+        "\n\n");
+
+    const std::string fps_path =
+        (fs::path(flags.output_dir) / (dataset_name + "_fps.csv")).string();
+    if (!WriteFpsCsv(fps_path, sorted_runs)) {
+      fprintf(stderr, "Cannot write %s\n", fps_path.c_str());
+      return EXIT_FAILURE;
+    }
+    printf("Fps saved as: %s\n", fps_path.c_str());
+    printf(
+        "---------------------------------------------------------------------"
+        "\n\n");
+  }
+
+  if (!flags.json_path.empty()) {
+    json += "]}\n";
+    if (!WriteFile(flags.json_path, json)) {
+      fprintf(stderr, "Cannot write %s\n", flags.json_path.c_str());
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+void AppendTimelineJson(const EventTimeline& timeline, std::string* json) {
+  absl::StrAppend(json, "\"duration_s\":", timeline.duration_s,
+                  ",\"num_events\":", timeline.num_events,
+                  ",\"num_malformed_lines\":", timeline.num_malformed_lines,
+                  ",\"event_counts\":{");
+  const char* separator = "";
+  for (const auto& [name, count] : timeline.event_counts) {
+    absl::StrAppend(json, separator, "\"", name, "\":", count);
+    separator = ",";
+  }
+  absl::StrAppend(json, "},\"fps\":[");
+  separator = "";
+  for (const FpsPoint& point : timeline.fps) {
+    absl::StrAppend(json, separator, "[", point.time_s, ",",
+                    point.fps, ",", point.state, "]");
+    separator = ",";
+  }
+  absl::StrAppend(json, "],\"pipelines\":[");
+  separator = "";
+  for (const PipelineCreation& creation : timeline.pipeline_creations) {
+    absl::StrAppend(json, separator, "[", creation.time_s, ",",
+                    creation.duration_ms, ",\"",
+                    creation.compute ? "compute" : "graphics", "\"]");
+    separator = ",";
+  }
+  absl::StrAppend(json, "]");
+}
+
+bool WriteTimelineCsvs(const std::string& output_dir,
+                       const std::string& dataset_name,
+                       const EventTimeline& timeline) {
+  std::string fps_csv = "Time (s),FPS,State\n";
+  for (const FpsPoint& point : timeline.fps) {
+    absl::StrAppend(&fps_csv, point.time_s, ",", point.fps, ",",
+                    point.state, "\n");
+  }
+  std::string pipelines_csv = "Time (s),Creation Time (ms),Kind\n";
+  for (const PipelineCreation& creation : timeline.pipeline_creations) {
+    absl::StrAppend(&pipelines_csv, creation.time_s, ",",
+                    creation.duration_ms, ",",
+                    creation.compute ? "compute" : "graphics", "\n");
+  }
+  const fs::path dir(output_dir);
+  return WriteFile((dir / (dataset_name + "_fps_timeline.csv")).string(),
+                   fps_csv) &&
+         WriteFile((dir / (dataset_name + "_pipelines.csv")).string(),
+                   pipelines_csv);
+}
+
+int RunTimeline(const Flags& flags, Throughput* throughput) {
+  std::string json = "{\"datasets\":[";
+  for (size_t i = 0; i != flags.datasets.size(); ++i) {
+    const std::string& dataset_name = flags.datasets[i].name;
+    // Event logs are large, so each is split between the threads rather than
+    // analyzed in parallel with the others.
+    const auto start = std::chrono::steady_clock::now();
+    absl::StatusOr<EventTimeline> analyzed = AnalyzeFile(
+        flags.datasets[i].paths[0], &throughput->num_bytes,
+        [&](std::string_view contents) -> absl::StatusOr<EventTimeline> {
+          return AnalyzeEventLog(contents, flags.threads);
+        });
+    throughput->analysis_time += std::chrono::steady_clock::now() - start;
+    if (!analyzed.ok()) {
+      fprintf(stderr, "%s\n", std::string(analyzed.status().message()).c_str());
+      return EXIT_FAILURE;
+    }
+    const EventTimeline& timeline = *analyzed;
+    double max_creation_ms = 0;
+    for (const PipelineCreation& creation : timeline.pipeline_creations)
+      max_creation_ms = std::max(max_creation_ms, creation.duration_ms);
+    printf("%s: %llu events over %.3f s, %zu frames, %zu pipeline creations "
+           "(longest %.3f ms), %llu malformed lines\n",
+           dataset_name.c_str(),
+           static_cast<unsigned long long>(timeline.num_events),
+           timeline.duration_s, timeline.fps.size(),
+           timeline.pipeline_creations.size(), max_creation_ms,
+           static_cast<unsigned long long>(timeline.num_malformed_lines));
+
+    if (!flags.json_path.empty()) {
+      absl::StrAppend(&json, i == 0 ? "" : ",", "{\"name\":\"", dataset_name,
+                      "\",");
+      AppendTimelineJson(timeline, &json);
+      json += "}";
+    } else if (!WriteTimelineCsvs(flags.output_dir, dataset_name, timeline)) {
+      fprintf(stderr, "Cannot write the timeline of %s to %s\n",
+              dataset_name.c_str(), flags.output_dir.c_str());
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!flags.json_path.empty()) {
+    json += "]}\n";
+    if (!WriteFile(flags.json_path, json)) {
+      fprintf(stderr, "Cannot write %s\n", flags.json_path.c_str());
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+int Run(const Flags& flags) {
+  Throughput throughput;
+  const int result = flags.command == Flags::Command::kFrameTimes
+                         ? RunFrameTimes(flags, &throughput)
+                         : RunTimeline(flags, &throughput);
+  const double megabytes = throughput.num_bytes.load() / 1e6;
+  const double analysis_s =
+      std::chrono::duration<double>(throughput.analysis_time).count();
+  fprintf(stderr, "Analyzed %.1f MB in %.3f s (%.1f MB/s)\n", megabytes,
+          analysis_s, analysis_s > 0 ? megabytes / analysis_s : 0.0);
+  return result;
+}
+}  // namespace
+}  // namespace performancelayers
+
+int main(int argc, char** argv) {
+  performancelayers::Flags flags;
+  if (!performancelayers::ParseFlags(argc, argv, &flags)) {
+    fprintf(stderr,
+            "Usage: %s frame_times --dataset <name> <frame_time.csv>... "
+            "[--dataset ...] [--duration=<s>] [--drop_front=<s>] "
+            "[--gameplay_state=<n>] [--csv] [--verbose] [--output_dir=<dir>] "
+            "[--json=<file>] [--threads=<n>]\n"
+            "       %s timeline --dataset <name> <events.log> [--dataset ...] "
+            "[--output_dir=<dir>] [--json=<file>] [--threads=<n>]\n",
+            argv[0], argv[0]);
+    return EXIT_FAILURE;
+  }
+  return performancelayers::Run(flags);
+}
@@ -0,0 +1,296 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares the logs of the layers of two sets of runs of a benchmark, e.g.,
+// before and after a driver or game change, and reports the significant
+// regressions. Usage:
+//   performance_layers_compare --baseline <run>... --test <run>...
+//       [--alpha=<p>] [--min_delta_percent=<n>] [--confidence=<c>]
+//       [--resamples=<n>] [--threads=<n>] [--json=<file>] [--all]
+// A run is a directory with the logs of one run, or one log. The frame time
+// percentiles, missed frames, compile times, GPU times and peak memory usage
+// of the runs are compared with the Mann-Whitney U test and a bootstrap
+// confidence interval of the difference between the medians. The metrics of
+// the CSV logs of a run take precedence over those of its event log. Only the
+// whole-run metrics and the flagged per-pipeline metrics are printed unless
+// --all is given. Exits with 0 if there is no regression, 2 if there is one,
+// and 1 on errors, so that benchmark runs can be gated on it.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "absl/types/span.h"
+#include "layer/support/input_buffer.h"
+#include "layer/tools/log_analysis.h"
+#include "layer/tools/run_comparison.h"
+
+namespace performancelayers {
+namespace {
+namespace fs = std::filesystem;
+
+constexpr int kExitRegression = 2;
+
+struct Flags {
+  std::vector<std::string> baseline;
+  std::vector<std::string> test;
+  ComparisonOptions options;
+  std::string json_path;
+  bool all = false;
+};
+
+bool ParseDouble(absl::string_view value, double* flag) {
+  return absl::SimpleAtod(value, flag) && std::isfinite(*flag);
+}
+
+bool ParseFlags(int argc, char** argv, Flags* flags) {
+  flags->options.max_threads =
+      std::max(std::thread::hardware_concurrency(), 1u);
+  std::vector<std::string>* runs = nullptr;
+  for (int i = 1; i != argc; ++i) {
+    absl::string_view arg = argv[i];
+    if (arg == "--baseline") {
+      runs = &flags->baseline;
+    } else if (arg == "--test") {
+      runs = &flags->test;
+    } else if (absl::ConsumePrefix(&arg, "--alpha=")) {
+      double& alpha = flags->options.alpha;
+      if (!ParseDouble(arg, &alpha) || alpha <= 0 || alpha >= 1) return false;
+    } else if (absl::ConsumePrefix(&arg, "--min_delta_percent=")) {
+      double& min_delta = flags->options.min_relative_delta_percent;
+      if (!ParseDouble(arg, &min_delta) || min_delta < 0) return false;
+    } else if (absl::ConsumePrefix(&arg, "--confidence=")) {
+      double& confidence = flags->options.confidence;
+      if (!ParseDouble(arg, &confidence) || confidence <= 0 ||
+          confidence >= 1) {
+        return false;
+      }
+    } else if (absl::ConsumePrefix(&arg, "--resamples=")) {
+      if (!absl::SimpleAtoi(arg, &flags->options.num_resamples) ||
+          flags->options.num_resamples == 0) {
+        return false;
+      }
+    } else if (absl::ConsumePrefix(&arg, "--threads=")) {
+      if (!absl::SimpleAtoi(arg, &flags->options.max_threads) ||
+          flags->options.max_threads == 0) {
+        return false;
+      }
+    } else if (absl::ConsumePrefix(&arg, "--json=")) {
+      flags->json_path = std::string(arg);
+    } else if (arg == "--all") {
+      flags->all = true;
+    } else if (!absl::StartsWith(arg, "--") && runs) {
+      runs->push_back(std::string(arg));
+    } else {
+      return false;
+    }
+  }
+  return !flags->baseline.empty() && !flags->test.empty();
+}
+
+// Returns the logs of |run|, the CSV logs first.
+absl::StatusOr<std::vector<std::string>> GetRunLogs(const std::string& run) {
+  std::error_code error;
+  if (!fs::is_directory(run, error)) return std::vector<std::string>{run};
+  std::vector<std::string> csv_logs;
+  std::vector<std::string> other_logs;
+  for (const fs::directory_entry& entry :
+       fs::directory_iterator(run, error)) {
+    if (!entry.is_regular_file(error)) continue;
+    const fs::path& path = entry.path();
+    if (path.extension() == ".csv") {
+      csv_logs.push_back(path.string());
+    } else if (path.extension() == ".log") {
+      other_logs.push_back(path.string());
+    }
+  }
+  if (error) {
+    return absl::UnavailableError(
+        absl::StrCat("Cannot list ", run, ": ", error.message()));
+  }
+  std::sort(csv_logs.begin(), csv_logs.end());
+  std::sort(other_logs.begin(), other_logs.end());
+  csv_logs.insert(csv_logs.end(), other_logs.begin(), other_logs.end());
+  return csv_logs;
+}
+
+absl::StatusOr<RunMetrics> ReadFileMetrics(const std::string& path) {
+  absl::StatusOr<InputBuffer> buffer = InputBuffer::Create(path);
+  if (!buffer.ok()) return buffer.status();
+  absl::Span<const uint8_t> bytes = buffer->GetBuffer();
+  return ReadLogMetrics(
+      path, std::string_view(reinterpret_cast<const char*>(bytes.data()),
+                             bytes.size()));
+}
+
+// Reads the metrics of every run of |runs|.
+absl::StatusOr<std::vector<RunMetrics>> ReadRuns(
+    const std::vector<std::string>& runs, size_t max_threads) {
+  struct Log {
+    size_t run;
+    std::string path;
+    absl::StatusOr<RunMetrics> metrics = absl::UnknownError("Not read");
+  };
+  std::vector<Log> logs;
+  for (size_t i = 0; i != runs.size(); ++i) {
+    absl::StatusOr<std::vector<std::string>> paths = GetRunLogs(runs[i]);
+    if (!paths.ok()) return paths.status();
+    for (std::string& path : *paths) logs.push_back({i, std::move(path)});
+  }
+  RunInParallel(logs.size(), max_threads, [&logs](size_t i) {
+    logs[i].metrics = ReadFileMetrics(logs[i].path);
+  });
+
+  std::vector<RunMetrics> metrics(runs.size());
+  for (const Log& log : logs) {
+    if (absl::IsNotFound(log.metrics.status())) continue;
+    if (!log.metrics.ok()) return log.metrics.status();
+    AddMissingMetrics(*log.metrics, &metrics[log.run]);
+  }
+  for (size_t i = 0; i != runs.size(); ++i) {
+    if (metrics[i].metrics.empty() && metrics[i].pipeline_metrics.empty()) {
+      return absl::NotFoundError(
+          absl::StrCat(runs[i], ": no logs of the layers"));
+    }
+  }
+  return metrics;
+}
+
+const char* GetVerdict(const MetricComparison& comparison) {
+  if (comparison.regression) return "REGRESSION";
+  if (comparison.improvement) return "improvement";
+  return "";
+}
+
+void PrintComparison(const MetricComparison& comparison) {
+  printf("%-40s %5zu %5zu %12.4g %12.4g %+9.2f%% [%+.4g, %+.4g] %9.3g %s\n",
+         comparison.metric.c_str(), comparison.num_baseline_runs,
+         comparison.num_test_runs, comparison.baseline_median,
+         comparison.test_median, comparison.relative_delta_percent,
+         comparison.delta_interval.low, comparison.delta_interval.high,
+         comparison.p_value, GetVerdict(comparison));
+}
+
+// JSON has no infinity, for the relative deltas of zero baselines.
+std::string FormatJsonNumber(double value) {
+  return std::isfinite(value) ? absl::StrCat(value) : "null";
+}
+
+std::string GetJson(const std::vector<MetricComparison>& comparisons) {
+  std::string json = "{\"comparisons\":[";
+  const char* separator = "";
+  for (const MetricComparison& comparison : comparisons) {
+    absl::StrAppend(
+        &json, separator, "{\"metric\":\"", comparison.metric,
+        "\",\"baseline_runs\":", comparison.num_baseline_runs,
+        ",\"test_runs\":", comparison.num_test_runs,
+        ",\"baseline_median\":", comparison.baseline_median,
+        ",\"test_median\":", comparison.test_median,
+        ",\"delta\":", comparison.delta, ",\"relative_delta_percent\":",
+        FormatJsonNumber(comparison.relative_delta_percent),
+        ",\"delta_interval\":[", comparison.delta_interval.low, ",",
+        comparison.delta_interval.high, "],\"p_value\":", comparison.p_value,
+        ",\"alpha\":", comparison.alpha, ",\"regression\":",
+        comparison.regression ? "true" : "false",
+        ",\"improvement\":", comparison.improvement ? "true" : "false", "}");
+    separator = ",";
+  }
+  json += "]}\n";
+  return json;
+}
+
+bool WriteFile(const std::string& path, const std::string& contents) {
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) return false;
+  fwrite(contents.data(), 1, contents.size(), file);
+  return fclose(file) == 0;
+}
+
+int Compare(int argc, char** argv) {
+  Flags flags;
+  if (!ParseFlags(argc, argv, &flags)) {
+    fprintf(stderr,
+            "Usage: %s --baseline <run>... --test <run>... [--alpha=<p>] "
+            "[--min_delta_percent=<n>] [--confidence=<c>] [--resamples=<n>] "
+            "[--threads=<n>] [--json=<file>] [--all]\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  absl::StatusOr<std::vector<RunMetrics>> baseline =
+      ReadRuns(flags.baseline, flags.options.max_threads);
+  if (!baseline.ok()) {
+    fprintf(stderr, "%s\n", std::string(baseline.status().message()).c_str());
+    return EXIT_FAILURE;
+  }
+  absl::StatusOr<std::vector<RunMetrics>> test =
+      ReadRuns(flags.test, flags.options.max_threads);
+  if (!test.ok()) {
+    fprintf(stderr, "%s\n", std::string(test.status().message()).c_str());
+    return EXIT_FAILURE;
+  }
+
+  const std::vector<MetricComparison> comparisons =
+      CompareRuns(*baseline, *test, flags.options);
+  if (comparisons.empty()) {
+    fprintf(stderr,
+            "No metric is in at least two baseline and two test runs\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("%-40s %5s %5s %12s %12s %10s %s\n", "Metric", "Base", "Test",
+         "Base median", "Test median", "Delta", "[CI of delta] p-value");
+  size_t num_regressions = 0;
+  size_t num_improvements = 0;
+  for (const MetricComparison& comparison : comparisons) {
+    num_regressions += comparison.regression;
+    num_improvements += comparison.improvement;
+    const bool pipeline_metric = comparison.metric.find('[') !=
+                                 std::string::npos;
+    if (flags.all || !pipeline_metric || comparison.regression ||
+        comparison.improvement) {
+      PrintComparison(comparison);
+    }
+  }
+  printf("\n%zu regressions and %zu improvements in %zu metrics\n",
+         num_regressions, num_improvements, comparisons.size());
+
+  if (!flags.json_path.empty() &&
+      !WriteFile(flags.json_path, GetJson(comparisons))) {
+    fprintf(stderr, "Cannot write %s\n", flags.json_path.c_str());
+    return EXIT_FAILURE;
+  }
+  return num_regressions == 0 ? EXIT_SUCCESS : kExitRegression;
+}
+}  // namespace
+}  // namespace performancelayers
+
+int main(int argc, char** argv) {
+  return performancelayers::Compare(argc, argv);
+}
@@ -0,0 +1,231 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Builds an indexed store of the events of event logs, and queries it, so that
+// the events of one pipeline, for instance, are found without reading the
+// whole log. Usage:
+//   performance_layers_events build --output=<dir> [--time_bucket_ms=<n>]
+//       <events.log>...
+//   performance_layers_events query <dir> [--name=<event>] [--hash=<0x...>]
+//       [--from=<s>] [--to=<s>] [--thread=<tid>] [--limit=<n>]
+//       [--stats [--value=<attribute>]]
+// query prints the selected events in the format of the event log, sorted by
+// timestamp, or, with --stats, the number of events of every name and the
+// statistics of their values: their duration, runtime or frame time, or the
+// integer attribute given by --value. --from and --to are in seconds since
+// the first event of the store.
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "absl/types/span.h"
+#include "layer/support/input_buffer.h"
+#include "layer/tools/event_store.h"
+
+namespace performancelayers {
+namespace {
+constexpr double kNanosPerSecond = 1e9;
+
+struct Flags {
+  enum class Command { kBuild, kQuery };
+
+  Command command = Command::kBuild;
+  std::string store_dir;
+  std::vector<std::string> logs;
+  EventStoreOptions options;
+  EventQuery query;
+  std::optional<double> from_s;
+  std::optional<double> to_s;
+  size_t limit = 0;
+  bool stats = false;
+  std::string value_attribute;
+};
+
+bool ParseFlags(int argc, char** argv, Flags* flags) {
+  if (argc < 2) return false;
+  const absl::string_view command = argv[1];
+  if (command == "build") {
+    flags->command = Flags::Command::kBuild;
+  } else if (command == "query") {
+    flags->command = Flags::Command::kQuery;
+  } else {
+    return false;
+  }
+
+  for (int i = 2; i != argc; ++i) {
+    absl::string_view arg = argv[i];
+    if (absl::ConsumePrefix(&arg, "--output=")) {
+      flags->store_dir = std::string(arg);
+    } else if (absl::ConsumePrefix(&arg, "--time_bucket_ms=")) {
+      int64_t time_bucket_ms = 0;
+      if (!absl::SimpleAtoi(arg, &time_bucket_ms) || time_bucket_ms <= 0)
+        return false;
+      flags->options.time_bucket_ns = time_bucket_ms * 1000000;
+    } else if (absl::ConsumePrefix(&arg, "--name=")) {
+      flags->query.name = std::string(arg);
+    } else if (absl::ConsumePrefix(&arg, "--hash=")) {
+      uint64_t hash = 0;
+      if (!ParseHash(std::string_view(arg.data(), arg.size()), &hash))
+        return false;
+      flags->query.hash = hash;
+    } else if (absl::ConsumePrefix(&arg, "--from=")) {
+      double from_s = 0;
+      if (!absl::SimpleAtod(arg, &from_s)) return false;
+      flags->from_s = from_s;
+    } else if (absl::ConsumePrefix(&arg, "--to=")) {
+      double to_s = 0;
+      if (!absl::SimpleAtod(arg, &to_s)) return false;
+      flags->to_s = to_s;
+    } else if (absl::ConsumePrefix(&arg, "--thread=")) {
+      int64_t thread = 0;
+      if (!absl::SimpleAtoi(arg, &thread)) return false;
+      flags->query.thread = thread;
+    } else if (absl::ConsumePrefix(&arg, "--limit=")) {
+      if (!absl::SimpleAtoi(arg, &flags->limit)) return false;
+    } else if (arg == "--stats") {
+      flags->stats = true;
+    } else if (absl::ConsumePrefix(&arg, "--value=")) {
+      flags->value_attribute = std::string(arg);
+    } else if (absl::StartsWith(arg, "--")) {
+      return false;
+    } else if (flags->command == Flags::Command::kBuild) {
+      flags->logs.push_back(std::string(arg));
+    } else if (flags->store_dir.empty()) {
+      flags->store_dir = std::string(arg);
+    } else {
+      return false;
+    }
+  }
+
+  if (flags->store_dir.empty()) return false;
+  if (flags->command == Flags::Command::kBuild) return !flags->logs.empty();
+  return flags->stats || flags->value_attribute.empty();
+}
+
+double GetElapsedMs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+int Build(const Flags& flags) {
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<InputBuffer> buffers;
+  std::vector<std::string_view> logs;
+  uint64_t num_bytes = 0;
+  for (const std::string& path : flags.logs) {
+    absl::StatusOr<InputBuffer> buffer = InputBuffer::Create(path);
+    if (!buffer.ok()) {
+      fprintf(stderr, "%s\n", std::string(buffer.status().message()).c_str());
+      return EXIT_FAILURE;
+    }
+    absl::Span<const uint8_t> bytes = buffer->GetBuffer();
+    logs.push_back(std::string_view(
+        reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+    num_bytes += bytes.size();
+    buffers.push_back(*std::move(buffer));
+  }
+
+  absl::StatusOr<EventStoreBuildStats> stats =
+      BuildEventStore(logs, flags.store_dir, flags.options);
+  if (!stats.ok()) {
+    fprintf(stderr, "%s\n", std::string(stats.status().message()).c_str());
+    return EXIT_FAILURE;
+  }
+  const double elapsed_ms = GetElapsedMs(start);
+  fprintf(stderr,
+          "Stored %" PRIu64 " events with %" PRIu64 " names and %" PRIu64
+          " hashes in %s, skipped %" PRIu64
+          " malformed lines, in %.0f ms (%.1f MB/s)\n",
+          stats->num_events, stats->num_names, stats->num_hashes,
+          flags.store_dir.c_str(), stats->num_malformed_lines, elapsed_ms,
+          num_bytes / 1e3 / elapsed_ms);
+  return EXIT_SUCCESS;
+}
+
+int Query(Flags flags) {
+  const auto start = std::chrono::steady_clock::now();
+  absl::StatusOr<EventStore> store = EventStore::Open(flags.store_dir);
+  if (!store.ok()) {
+    fprintf(stderr, "%s\n", std::string(store.status().message()).c_str());
+    return EXIT_FAILURE;
+  }
+  if (store->GetNumEvents() != 0) {
+    const int64_t first_ns = store->GetTimestamp(0);
+    if (flags.from_s)
+      flags.query.begin_ns = first_ns + *flags.from_s * kNanosPerSecond;
+    if (flags.to_s)
+      flags.query.end_ns = first_ns + *flags.to_s * kNanosPerSecond;
+  }
+  const std::vector<uint32_t> events = store->Query(flags.query);
+  const double query_ms = GetElapsedMs(start);
+
+  if (flags.stats) {
+    printf("%-40s %12s %12s %14s %14s %14s %14s %14s\n", "Event", "Count",
+           "Values", "Sum", "Min", "Max", "p50", "p95");
+    for (const EventAggregate& aggregate :
+         AggregateEvents(*store, events, flags.value_attribute)) {
+      printf("%-40s %12" PRIu64 " %12" PRIu64
+             " %14.6g %14.6g %14.6g %14.6g %14.6g\n",
+             aggregate.name.c_str(), aggregate.num_events,
+             aggregate.num_values, aggregate.sum, aggregate.min, aggregate.max,
+             aggregate.p50, aggregate.p95);
+    }
+  } else {
+    size_t num_printed = 0;
+    for (uint32_t event : events) {
+      if (flags.limit != 0 && num_printed++ == flags.limit) break;
+      const std::string_view name = store->GetName(event);
+      const std::string_view attributes = store->GetAttributes(event);
+      printf("%.*s,timestamp:%" PRId64 "%s%.*s\n",
+             static_cast<int>(name.size()), name.data(),
+             store->GetTimestamp(event), attributes.empty() ? "" : ",",
+             static_cast<int>(attributes.size()), attributes.data());
+    }
+  }
+  fprintf(stderr, "Selected %zu of %zu events in %.3f ms\n", events.size(),
+          store->GetNumEvents(), query_ms);
+  return EXIT_SUCCESS;
+}
+}  // namespace
+}  // namespace performancelayers
+
+int main(int argc, char** argv) {
+  performancelayers::Flags flags;
+  if (!performancelayers::ParseFlags(argc, argv, &flags)) {
+    fprintf(stderr,
+            "Usage: %s build --output=<dir> [--time_bucket_ms=<n>] "
+            "<events.log>...\n"
+            "       %s query <dir> [--name=<event>] [--hash=<0x...>] "
+            "[--from=<s>] [--to=<s>] [--thread=<tid>] [--limit=<n>] "
+            "[--stats [--value=<attribute>]]\n",
+            argv[0], argv[0]);
+    return EXIT_FAILURE;
+  }
+  return flags.command == performancelayers::Flags::Command::kBuild
+             ? performancelayers::Build(flags)
+             : performancelayers::Query(flags);
+}
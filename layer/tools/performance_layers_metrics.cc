@@ -0,0 +1,163 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Prints the live metrics the layers publish in shared memory, see
+// `MetricsExporter`. Usage:
+//   performance_layers_metrics <shm_name> [--watch=<ms>] [--prometheus]
+// <shm_name> is the name of the page, e.g.,
+// "spl_metrics.VkLayer_stadia_performance"; the pages are listed in /dev/shm.
+// With --watch, the metrics are printed every <ms> milliseconds, with the rate
+// of every counter since the previous print, until the tool is interrupted.
+// With --prometheus, they are printed in the Prometheus text format.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "layer/support/metrics.h"
+#include "layer/support/metrics_exporter.h"
+
+namespace performancelayers {
+namespace {
+struct Flags {
+  std::string shm_name;
+  uint64_t watch_ms = 0;
+  bool prometheus = false;
+};
+
+bool ParseFlags(int argc, char** argv, Flags* flags) {
+  for (int i = 1; i != argc; ++i) {
+    absl::string_view arg = argv[i];
+    if (absl::ConsumePrefix(&arg, "--watch=")) {
+      if (!absl::SimpleAtoi(arg, &flags->watch_ms) || flags->watch_ms == 0)
+        return false;
+    } else if (arg == "--prometheus") {
+      flags->prometheus = true;
+    } else if (!absl::StartsWith(arg, "--") && flags->shm_name.empty()) {
+      flags->shm_name = std::string(arg);
+    } else {
+      return false;
+    }
+  }
+  return !flags->shm_name.empty();
+}
+
+// Returns an upper bound of the |quantile| of the values in |histogram|: the
+// bound of the bucket holding it.
+int64_t EstimateQuantile(const MetricValues& histogram, double quantile) {
+  const double rank = quantile * histogram.value;
+  uint64_t cumulative_count = 0;
+  for (size_t bucket = 0; bucket != kNumHistogramBuckets; ++bucket) {
+    cumulative_count += histogram.buckets[bucket];
+    if (cumulative_count > 0 && cumulative_count >= rank)
+      return GetHistogramBucketBound(bucket);
+  }
+  return 0;
+}
+
+// Prints |contents| as a table. Counters also get their rate since
+// |previous|, if any.
+void PrintTable(const MetricsPageContents& contents,
+                const MetricsPageContents* previous) {
+  absl::flat_hash_map<std::string, int64_t> previous_values;
+  double elapsed_s = 0;
+  if (previous) {
+    elapsed_s = (contents.publish_time_ns - previous->publish_time_ns) / 1e9;
+    for (const MetricValues& metric : previous->metrics)
+      previous_values[metric.name] = metric.value;
+  }
+
+  printf("pid %lld, published at %lld ns\n",
+         static_cast<long long>(contents.pid),
+         static_cast<long long>(contents.publish_time_ns));
+  for (const MetricValues& metric : contents.metrics) {
+    switch (metric.kind) {
+      case MetricKind::kCounter: {
+        printf("%-48s %16lld", metric.name,
+               static_cast<long long>(metric.value));
+        auto it = previous_values.find(metric.name);
+        if (it != previous_values.end() && elapsed_s > 0)
+          printf("  %.1f/s", (metric.value - it->second) / elapsed_s);
+        printf("\n");
+        break;
+      }
+      case MetricKind::kGauge:
+        printf("%-48s %16lld\n", metric.name,
+               static_cast<long long>(metric.value));
+        break;
+      case MetricKind::kHistogram:
+        printf("%-48s %16lld  mean %.1f  p50 <= %lld  p99 <= %lld\n",
+               metric.name, static_cast<long long>(metric.value),
+               metric.value != 0
+                   ? static_cast<double>(metric.sum) / metric.value
+                   : 0.0,
+               static_cast<long long>(EstimateQuantile(metric, 0.5)),
+               static_cast<long long>(EstimateQuantile(metric, 0.99)));
+        break;
+    }
+  }
+  fflush(stdout);
+}
+
+int Run(const Flags& flags) {
+  std::unique_ptr<MetricsPageReader> reader =
+      MetricsPageReader::Open(flags.shm_name);
+  if (!reader) return EXIT_FAILURE;
+
+  MetricsPageContents previous;
+  bool has_previous = false;
+  while (true) {
+    MetricsPageContents contents;
+    if (!reader->Read(&contents)) {
+      fprintf(stderr, "Cannot read a consistent copy of %s\n",
+              flags.shm_name.c_str());
+      return EXIT_FAILURE;
+    }
+    if (flags.prometheus) {
+      printf("%s", FormatPrometheusText(contents.metrics).c_str());
+      fflush(stdout);
+    } else {
+      PrintTable(contents, has_previous ? &previous : nullptr);
+    }
+    if (flags.watch_ms == 0) return EXIT_SUCCESS;
+
+    previous = std::move(contents);
+    has_previous = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(flags.watch_ms));
+    printf("\n");
+  }
+}
+}  // namespace
+}  // namespace performancelayers
+
+int main(int argc, char** argv) {
+  performancelayers::Flags flags;
+  if (!performancelayers::ParseFlags(argc, argv, &flags)) {
+    fprintf(stderr, "Usage: %s <shm_name> [--watch=<ms>] [--prometheus]\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+  return performancelayers::Run(flags);
+}
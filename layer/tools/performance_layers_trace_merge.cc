@@ -0,0 +1,105 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Merges the Trace Event logs of several processes or runs into one trace,
+// sorted by timestamp, that trace viewers load quickly. Usage:
+//   performance_layers_trace_merge --output=<file> [--format=json|perfetto]
+//       [--max_memory_mb=<n>] <trace_event.log>...
+// The JSON format is a finalized JSON array in the Trace Event format, and the
+// perfetto format is a protobuf trace for https://ui.perfetto.dev. The events
+// past --max_memory_mb, 256 by default, are sorted in temporary files.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "layer/tools/trace_merge.h"
+
+namespace performancelayers {
+namespace {
+struct Flags {
+  std::string output_path;
+  std::vector<std::string> inputs;
+  TraceMergeOptions options;
+};
+
+bool ParseFlags(int argc, char** argv, Flags* flags) {
+  for (int i = 1; i != argc; ++i) {
+    absl::string_view arg = argv[i];
+    if (absl::ConsumePrefix(&arg, "--output=")) {
+      flags->output_path = std::string(arg);
+    } else if (absl::ConsumePrefix(&arg, "--format=")) {
+      if (arg == "json") {
+        flags->options.format = TraceFormat::kJson;
+      } else if (arg == "perfetto") {
+        flags->options.format = TraceFormat::kPerfetto;
+      } else {
+        return false;
+      }
+    } else if (absl::ConsumePrefix(&arg, "--max_memory_mb=")) {
+      size_t max_memory_mb = 0;
+      if (!absl::SimpleAtoi(arg, &max_memory_mb) || max_memory_mb == 0)
+        return false;
+      flags->options.max_memory_bytes = max_memory_mb << 20;
+    } else if (!absl::StartsWith(arg, "--")) {
+      flags->inputs.push_back(std::string(arg));
+    } else {
+      return false;
+    }
+  }
+  return !flags->output_path.empty() && !flags->inputs.empty();
+}
+}  // namespace
+}  // namespace performancelayers
+
+int main(int argc, char** argv) {
+  performancelayers::Flags flags;
+  if (!performancelayers::ParseFlags(argc, argv, &flags)) {
+    fprintf(stderr,
+            "Usage: %s --output=<file> [--format=json|perfetto] "
+            "[--max_memory_mb=<n>] <trace_event.log>...\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  FILE* out = fopen(flags.output_path.c_str(), "wb");
+  if (!out) {
+    fprintf(stderr, "Cannot open %s\n", flags.output_path.c_str());
+    return EXIT_FAILURE;
+  }
+  absl::StatusOr<performancelayers::TraceMergeStats> stats =
+      performancelayers::MergeTraces(flags.inputs, flags.options, out);
+  fclose(out);
+  if (!stats.ok()) {
+    fprintf(stderr, "%s\n", std::string(stats.status().message()).c_str());
+    return EXIT_FAILURE;
+  }
+  fprintf(stderr,
+          "Merged %llu events from %zu logs into %s: dropped %llu header and "
+          "metadata lines, skipped %llu malformed lines, renumbered %llu "
+          "processes, spilled %llu sorted runs\n",
+          static_cast<unsigned long long>(stats->num_events),
+          flags.inputs.size(), flags.output_path.c_str(),
+          static_cast<unsigned long long>(stats->num_dropped_lines),
+          static_cast<unsigned long long>(stats->num_malformed_lines),
+          static_cast<unsigned long long>(stats->num_renumbered_processes),
+          static_cast<unsigned long long>(stats->num_spilled_runs));
+  return EXIT_SUCCESS;
+}
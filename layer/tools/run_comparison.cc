@@ -0,0 +1,454 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/tools/run_comparison.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <random>
+#include <set>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "layer/tools/log_analysis.h"
+#include "layer/tools/log_reader.h"
+
+namespace performancelayers {
+namespace {
+constexpr double kNanosPerMilli = 1e6;
+constexpr double kBytesPerMegabyte = 1 << 20;
+
+// The events of the memory usage layer that log the peak device memory usage.
+constexpr std::string_view kMemoryUsageEvents[] = {
+    "memory_usage_present", "memory_usage_control_snapshot",
+    "memory_usage_destroy_device"};
+
+// The largest samples for which the exact distribution of the U statistic is
+// computed.
+constexpr size_t kMaxExactSampleSize = 20;
+
+// Accumulates a time per pipeline, e.g., the compile times of a run.
+class PipelineTimes {
+ public:
+  void Add(std::string_view pipeline, int64_t time_ns) {
+    Sum& sum = sums_[std::string(pipeline)];
+    sum.total_ns += time_ns;
+    ++sum.count;
+    total_ns_ += time_ns;
+  }
+
+  // Adds the mean time of every pipeline, in milliseconds, as |metric|, and
+  // the total time as |total_metric|.
+  void AddMetrics(const char* metric, const char* total_metric,
+                  RunMetrics* metrics) const {
+    if (sums_.empty()) return;
+    std::map<std::string, double>& pipelines =
+        metrics->pipeline_metrics[metric];
+    for (const auto& [pipeline, sum] : sums_)
+      pipelines[pipeline] = sum.total_ns / kNanosPerMilli / sum.count;
+    metrics->metrics[total_metric] = total_ns_ / kNanosPerMilli;
+  }
+
+ private:
+  struct Sum {
+    double total_ns = 0;
+    int64_t count = 0;
+  };
+
+  std::map<std::string, Sum> sums_;
+  double total_ns_ = 0;
+};
+
+void AddFrameTimeMetrics(const FrameTimeStats& stats, RunMetrics* metrics) {
+  metrics->metrics["frame_time_avg_ms"] = stats.average_frame_time_ms;
+  metrics->metrics["frame_time_p50_ms"] = stats.p50_ms;
+  metrics->metrics["frame_time_p90_ms"] = stats.p90_ms;
+  metrics->metrics["frame_time_p95_ms"] = stats.p95_ms;
+  metrics->metrics["missed_frames_percent"] = stats.missed_percent;
+}
+
+std::string_view Unquote(std::string_view value) {
+  if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+    return value.substr(1, value.size() - 2);
+  return value;
+}
+
+absl::Status MalformedRow(std::string_view path, const CsvReader& reader,
+                          const char* expected) {
+  return absl::InvalidArgumentError(absl::StrCat(
+      std::string(path), ":", reader.GetLineNumber(), ": expected ", expected));
+}
+
+// Reads the rows of |reader| as "<pipeline>,<time>[,...]" into |times|.
+absl::Status ReadPipelineTimes(std::string_view path, CsvReader* reader,
+                               PipelineTimes* times) {
+  std::vector<std::string_view> fields;
+  while (reader->NextRow(&fields)) {
+    int64_t time_ns = 0;
+    if (fields.size() < 2 || !ParseInt64(fields[1], &time_ns))
+      return MalformedRow(path, *reader, "'<pipeline>,<time>'");
+    times->Add(fields[0], time_ns);
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<RunMetrics> ReadEventLogMetrics(std::string_view path,
+                                               std::string_view contents) {
+  RunMetrics metrics;
+  std::vector<int64_t> frame_times_ns;
+  std::vector<int64_t> frame_states;
+  PipelineTimes compile_times;
+  PipelineTimes gpu_times;
+  std::optional<int64_t> peak_memory;
+
+  CsvReader reader(contents);
+  std::vector<std::string_view> fields;
+  while (reader.NextRow(&fields)) {
+    const std::string_view name = fields[0];
+    if (name == "frame_present") {
+      std::optional<int64_t> frame_time_ns =
+          FindIntEventAttribute(fields, "frame_time");
+      if (!frame_time_ns) continue;
+      frame_times_ns.push_back(*frame_time_ns);
+      frame_states.push_back(
+          FindIntEventAttribute(fields, "started").value_or(0));
+    } else if (name == "create_graphics_pipelines" ||
+               name == "create_compute_pipelines") {
+      std::optional<std::string_view> hashes =
+          FindEventAttribute(fields, "hashes");
+      std::optional<int64_t> duration_ns =
+          FindIntEventAttribute(fields, "duration");
+      if (hashes && duration_ns)
+        compile_times.Add(Unquote(*hashes), *duration_ns);
+    } else if (name == "pipeline_execution") {
+      std::optional<std::string_view> pipeline =
+          FindEventAttribute(fields, "pipeline");
+      std::optional<int64_t> runtime_ns =
+          FindIntEventAttribute(fields, "runtime");
+      if (pipeline && runtime_ns)
+        gpu_times.Add(Unquote(*pipeline), *runtime_ns);
+    } else if (std::find(std::begin(kMemoryUsageEvents),
+                         std::end(kMemoryUsageEvents),
+                         name) != std::end(kMemoryUsageEvents)) {
+      if (std::optional<int64_t> peak = FindIntEventAttribute(fields, "peak"))
+        peak_memory = std::max(peak_memory.value_or(0), *peak);
+    }
+  }
+
+  if (!frame_times_ns.empty()) {
+    absl::StatusOr<FrameTimeStats> stats =
+        AnalyzeFrameTimes(path, frame_times_ns, frame_states, {});
+    if (!stats.ok()) return stats.status();
+    AddFrameTimeMetrics(*stats, &metrics);
+  }
+  compile_times.AddMetrics("compile_time_ms", "compile_time_total_ms",
+                           &metrics);
+  gpu_times.AddMetrics("gpu_time_ms", "gpu_time_total_ms", &metrics);
+  if (peak_memory)
+    metrics.metrics["peak_memory_mb"] = *peak_memory / kBytesPerMegabyte;
+  return metrics;
+}
+
+// Returns the seed of the bootstrap of |metric|, so that the results don't
+// depend on the order the metrics are compared in.
+uint64_t GetSeed(std::string_view metric) {
+  // FNV-1a.
+  uint64_t hash = 14695981039346656037ull;
+  for (const char c : metric) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// The number of ways to get every value of the U statistic of samples of
+// |n1| and |n2| values without ties.
+std::vector<double> GetUFrequencies(size_t n1, size_t n2) {
+  // frequencies[i][j][u] for samples of i and j values.
+  std::vector<std::vector<std::vector<double>>> frequencies(
+      n1 + 1, std::vector<std::vector<double>>(n2 + 1));
+  for (size_t i = 0; i <= n1; ++i) {
+    for (size_t j = 0; j <= n2; ++j) {
+      std::vector<double>& current = frequencies[i][j];
+      current.assign(i * j + 1, 0);
+      if (i == 0 || j == 0) {
+        current[0] = 1;
+        continue;
+      }
+      // Either the largest value is in the first sample, and is larger than
+      // all j values of the second, or it is in the second.
+      const std::vector<double>& first_largest = frequencies[i - 1][j];
+      for (size_t u = 0; u != first_largest.size(); ++u)
+        current[u + j] += first_largest[u];
+      const std::vector<double>& second_largest = frequencies[i][j - 1];
+      for (size_t u = 0; u != second_largest.size(); ++u)
+        current[u] += second_largest[u];
+    }
+  }
+  return frequencies[n1][n2];
+}
+}  // namespace
+
+absl::StatusOr<RunMetrics> ReadLogMetrics(std::string_view path,
+                                          std::string_view contents) {
+  CsvReader reader(contents);
+  std::vector<std::string_view> header;
+  if (!reader.NextRow(&header))
+    return absl::NotFoundError(absl::StrCat(std::string(path), ": empty"));
+
+  RunMetrics metrics;
+  if (header.size() == 2 && header[0] == "Frame Time (ns)") {
+    absl::StatusOr<FrameTimeStats> stats =
+        AnalyzeFrameTimeLog(path, contents, {});
+    if (!stats.ok()) return stats.status();
+    AddFrameTimeMetrics(*stats, &metrics);
+  } else if (header.size() == 2 && header[0] == "Pipeline" &&
+             header[1] == "Compile Time (ns)") {
+    PipelineTimes compile_times;
+    if (absl::Status read = ReadPipelineTimes(path, &reader, &compile_times);
+        !read.ok()) {
+      return read;
+    }
+    compile_times.AddMetrics("compile_time_ms", "compile_time_total_ms",
+                             &metrics);
+  } else if (header.size() >= 2 && header[0] == "Pipeline" &&
+             header[1] == "Run Time (ns)") {
+    PipelineTimes gpu_times;
+    if (absl::Status read = ReadPipelineTimes(path, &reader, &gpu_times);
+        !read.ok()) {
+      return read;
+    }
+    gpu_times.AddMetrics("gpu_time_ms", "gpu_time_total_ms", &metrics);
+  } else if (header.size() == 2 && header[0] == "Current (bytes)") {
+    std::vector<std::string_view> fields;
+    int64_t peak_memory = 0;
+    while (reader.NextRow(&fields)) {
+      int64_t peak = 0;
+      if (fields.size() != 2 || !ParseInt64(fields[1], &peak))
+        return MalformedRow(path, reader, "'<current>,<peak>'");
+      peak_memory = std::max(peak_memory, peak);
+    }
+    metrics.metrics["peak_memory_mb"] = peak_memory / kBytesPerMegabyte;
+  } else if (FindEventAttribute(header, "timestamp")) {
+    return ReadEventLogMetrics(path, contents);
+  } else {
+    return absl::NotFoundError(
+        absl::StrCat(std::string(path), ": not a log of the layers"));
+  }
+  return metrics;
+}
+
+void AddMissingMetrics(const RunMetrics& log, RunMetrics* run) {
+  run->metrics.insert(log.metrics.begin(), log.metrics.end());
+  for (const auto& [metric, pipelines] : log.pipeline_metrics)
+    run->pipeline_metrics.insert({metric, pipelines});
+}
+
+MannWhitneyResult MannWhitneyUTest(const std::vector<double>& a,
+                                   const std::vector<double>& b) {
+  MannWhitneyResult result;
+  const size_t n1 = a.size();
+  const size_t n2 = b.size();
+  if (n1 == 0 || n2 == 0) return result;
+
+  // Rank the values of both samples, with the mean rank for ties.
+  std::vector<std::pair<double, bool>> values;
+  for (double value : a) values.push_back({value, true});
+  for (double value : b) values.push_back({value, false});
+  std::sort(values.begin(), values.end());
+  const double n = static_cast<double>(values.size());
+  double rank_sum = 0;
+  double tie_term = 0;
+  for (size_t begin = 0; begin != values.size();) {
+    size_t end = begin;
+    while (end != values.size() && values[end].first == values[begin].first)
+      ++end;
+    const double rank = (begin + 1 + end) / 2.0;
+    for (size_t i = begin; i != end; ++i) {
+      if (values[i].second) rank_sum += rank;
+    }
+    const double ties = static_cast<double>(end - begin);
+    tie_term += ties * ties * ties - ties;
+    begin = end;
+  }
+  result.u = rank_sum - n1 * (n1 + 1) / 2.0;
+
+  if (tie_term == 0 && n1 <= kMaxExactSampleSize &&
+      n2 <= kMaxExactSampleSize) {
+    const std::vector<double> frequencies = GetUFrequencies(n1, n2);
+    const size_t u = static_cast<size_t>(std::lround(result.u));
+    double total = 0;
+    double at_most_u = 0;
+    for (size_t i = 0; i != frequencies.size(); ++i) {
+      total += frequencies[i];
+      if (i <= u) at_most_u += frequencies[i];
+    }
+    const double at_least_u = total - at_most_u + frequencies[u];
+    result.p_value =
+        std::min(1.0, 2 * std::min(at_most_u, at_least_u) / total);
+    return result;
+  }
+
+  const double mean = n1 * n2 / 2.0;
+  const double variance =
+      n1 * n2 / 12.0 * ((n + 1) - tie_term / (n * (n - 1)));
+  if (variance <= 0) return result;
+  const double z =
+      std::max(0.0, std::abs(result.u - mean) - 0.5) / std::sqrt(variance);
+  result.p_value = std::erfc(z / std::sqrt(2.0));
+  return result;
+}
+
+double Median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  return Percentile(values, 50);
+}
+
+ConfidenceInterval BootstrapMedianDifference(const std::vector<double>& a,
+                                             const std::vector<double>& b,
+                                             double confidence,
+                                             size_t num_resamples,
+                                             uint64_t seed) {
+  assert(!a.empty() && !b.empty());
+  std::mt19937_64 random(seed);
+  std::vector<double> differences;
+  differences.reserve(num_resamples);
+  std::vector<double> resample;
+  auto resampled_median = [&](const std::vector<double>& values) {
+    std::uniform_int_distribution<size_t> index(0, values.size() - 1);
+    resample.clear();
+    for (size_t i = 0; i != values.size(); ++i)
+      resample.push_back(values[index(random)]);
+    return Median(resample);
+  };
+  for (size_t i = 0; i != num_resamples; ++i) {
+    const double median_a = resampled_median(a);
+    differences.push_back(resampled_median(b) - median_a);
+  }
+  std::sort(differences.begin(), differences.end());
+  return {Percentile(differences, (1 - confidence) / 2 * 100),
+          Percentile(differences, (1 + confidence) / 2 * 100)};
+}
+
+std::vector<MetricComparison> CompareRuns(
+    const std::vector<RunMetrics>& baseline,
+    const std::vector<RunMetrics>& test, const ComparisonOptions& options) {
+  struct Samples {
+    std::string metric;
+    std::vector<double> baseline;
+    std::vector<double> test;
+    double alpha = 0;
+  };
+  std::vector<Samples> samples;
+  auto add_samples = [&samples](std::string metric, double alpha,
+                                auto get_value,
+                                const std::vector<RunMetrics>& baseline,
+                                const std::vector<RunMetrics>& test) {
+    Samples metric_samples{std::move(metric), {}, {}, alpha};
+    for (const RunMetrics& run : baseline) {
+      if (std::optional<double> value = get_value(run))
+        metric_samples.baseline.push_back(*value);
+    }
+    for (const RunMetrics& run : test) {
+      if (std::optional<double> value = get_value(run))
+        metric_samples.test.push_back(*value);
+    }
+    if (metric_samples.baseline.size() < 2 || metric_samples.test.size() < 2)
+      return false;
+    samples.push_back(std::move(metric_samples));
+    return true;
+  };
+
+  std::set<std::string> metrics;
+  std::map<std::string, std::set<std::string>> pipeline_metrics;
+  for (const std::vector<RunMetrics>* runs : {&baseline, &test}) {
+    for (const RunMetrics& run : *runs) {
+      for (const auto& [metric, value] : run.metrics) metrics.insert(metric);
+      for (const auto& [metric, pipelines] : run.pipeline_metrics) {
+        for (const auto& [pipeline, value] : pipelines)
+          pipeline_metrics[metric].insert(pipeline);
+      }
+    }
+  }
+
+  for (const std::string& metric : metrics) {
+    add_samples(
+        metric, options.alpha,
+        [&metric](const RunMetrics& run) -> std::optional<double> {
+          auto it = run.metrics.find(metric);
+          if (it == run.metrics.end()) return std::nullopt;
+          return it->second;
+        },
+        baseline, test);
+  }
+  for (const auto& [metric, pipelines] : pipeline_metrics) {
+    const size_t first_sample = samples.size();
+    for (const std::string& pipeline : pipelines) {
+      add_samples(
+          absl::StrCat(metric, pipeline), 0,
+          [&metric = metric,
+           &pipeline](const RunMetrics& run) -> std::optional<double> {
+            auto metric_it = run.pipeline_metrics.find(metric);
+            if (metric_it == run.pipeline_metrics.end()) return std::nullopt;
+            auto it = metric_it->second.find(pipeline);
+            if (it == metric_it->second.end()) return std::nullopt;
+            return it->second;
+          },
+          baseline, test);
+    }
+    const size_t num_compared = samples.size() - first_sample;
+    for (size_t i = first_sample; i != samples.size(); ++i)
+      samples[i].alpha = options.alpha / num_compared;
+  }
+
+  std::vector<MetricComparison> comparisons(samples.size());
+  RunInParallel(samples.size(), options.max_threads, [&](size_t i) {
+    const Samples& metric_samples = samples[i];
+    MetricComparison& comparison = comparisons[i];
+    comparison.metric = metric_samples.metric;
+    comparison.num_baseline_runs = metric_samples.baseline.size();
+    comparison.num_test_runs = metric_samples.test.size();
+    comparison.baseline_median = Median(metric_samples.baseline);
+    comparison.test_median = Median(metric_samples.test);
+    comparison.delta = comparison.test_median - comparison.baseline_median;
+    if (comparison.baseline_median != 0) {
+      comparison.relative_delta_percent =
+          comparison.delta / std::abs(comparison.baseline_median) * 100;
+    } else if (comparison.delta != 0) {
+      comparison.relative_delta_percent = std::copysign(
+          std::numeric_limits<double>::infinity(), comparison.delta);
+    }
+    comparison.delta_interval = BootstrapMedianDifference(
+        metric_samples.baseline, metric_samples.test, options.confidence,
+        options.num_resamples, GetSeed(metric_samples.metric));
+    comparison.p_value =
+        MannWhitneyUTest(metric_samples.baseline, metric_samples.test)
+            .p_value;
+    comparison.alpha = metric_samples.alpha;
+
+    const bool significant = comparison.p_value < comparison.alpha &&
+                             std::abs(comparison.relative_delta_percent) >=
+                                 options.min_relative_delta_percent;
+    comparison.regression = significant && comparison.delta > 0 &&
+                            comparison.delta_interval.low > 0;
+    comparison.improvement = significant && comparison.delta < 0 &&
+                             comparison.delta_interval.high < 0;
+  });
+  return comparisons;
+}
+
+}  // namespace performancelayers
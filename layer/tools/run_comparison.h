@@ -0,0 +1,125 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_RUN_COMPARISON_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_RUN_COMPARISON_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/status/statusor.h"
+
+// Compares the metrics of two sets of runs of a benchmark, e.g., before and
+// after a change, read from the logs of the layers, and tells the significant
+// differences apart from the noise between runs.
+
+namespace performancelayers {
+// The metrics of one run, or of one log of a run. Lower is better for all of
+// them.
+struct RunMetrics {
+  // The metrics of the whole run, by name, e.g., "frame_time_p95_ms".
+  std::map<std::string, double> metrics;
+  // The metrics of every pipeline, by name, e.g., "compile_time_ms", and by
+  // the hashes of the pipeline's shaders.
+  std::map<std::string, std::map<std::string, double>> pipeline_metrics;
+};
+
+// Reads the metrics of |contents|, the log at |path|. The kind of log, i.e.,
+// the CSV log of the frame time, compile time, runtime or memory usage layer
+// or an event log, is told by its contents. Returns a NotFound error if it is
+// none of these, e.g., a Trace Event log.
+absl::StatusOr<RunMetrics> ReadLogMetrics(std::string_view path,
+                                          std::string_view contents);
+
+// Adds the metrics of |log| that |run| doesn't have yet to |run|, so that the
+// metrics of the CSV logs of a run take precedence over those of its event
+// log.
+void AddMissingMetrics(const RunMetrics& log, RunMetrics* run);
+
+struct MannWhitneyResult {
+  // The U statistic of the first sample.
+  double u = 0;
+  // The two-sided p-value: exact for small samples without ties, and from the
+  // normal approximation, with the tie and continuity corrections, otherwise.
+  double p_value = 1;
+};
+
+// Tests whether |a| and |b| come from distributions with the same median.
+MannWhitneyResult MannWhitneyUTest(const std::vector<double>& a,
+                                   const std::vector<double>& b);
+
+double Median(std::vector<double> values);
+
+struct ConfidenceInterval {
+  double low = 0;
+  double high = 0;
+};
+
+// Returns the percentile bootstrap |confidence| interval of the difference
+// between the median of |b| and the median of |a|, from |num_resamples|
+// resamples drawn with |seed|.
+ConfidenceInterval BootstrapMedianDifference(const std::vector<double>& a,
+                                             const std::vector<double>& b,
+                                             double confidence,
+                                             size_t num_resamples,
+                                             uint64_t seed);
+
+struct ComparisonOptions {
+  // The significance level. The per-pipeline metrics are tested against the
+  // level divided by the number of pipelines compared, i.e., with the
+  // Bonferroni correction, so that large games don't report noise as
+  // regressions.
+  double alpha = 0.05;
+  // Significant differences smaller than this percentage of the baseline are
+  // not reported as regressions or improvements.
+  double min_relative_delta_percent = 1;
+  double confidence = 0.95;
+  size_t num_resamples = 2000;
+  size_t max_threads = 1;
+};
+
+struct MetricComparison {
+  // The metric, with the hashes of the pipeline for per-pipeline metrics,
+  // e.g., "compile_time_ms[0x1,0x2]".
+  std::string metric;
+  size_t num_baseline_runs = 0;
+  size_t num_test_runs = 0;
+  double baseline_median = 0;
+  double test_median = 0;
+  // The difference between the medians, and relative to the baseline.
+  double delta = 0;
+  double relative_delta_percent = 0;
+  ConfidenceInterval delta_interval;
+  double p_value = 1;
+  // The significance level the p-value is tested against.
+  double alpha = 0;
+  bool regression = false;
+  bool improvement = false;
+};
+
+// Compares every metric of |baseline| and |test| that at least two runs of
+// each have, the whole-run metrics first. The metrics are compared in parallel
+// from up to |options.max_threads| threads, and the results don't depend on
+// it.
+std::vector<MetricComparison> CompareRuns(
+    const std::vector<RunMetrics>& baseline,
+    const std::vector<RunMetrics>& test, const ComparisonOptions& options);
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_RUN_COMPARISON_H_
@@ -0,0 +1,807 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/tools/trace_merge.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <set>
+#include <tuple>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "layer/tools/log_reader.h"
+
+namespace performancelayers {
+namespace {
+constexpr int64_t kNanosPerMilli = 1000000;
+
+bool IsJsonSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+std::string_view StripJsonSpace(std::string_view text) {
+  while (!text.empty() && IsJsonSpace(text.front())) text.remove_prefix(1);
+  while (!text.empty() && IsJsonSpace(text.back())) text.remove_suffix(1);
+  return text;
+}
+
+size_t SkipJsonSpace(std::string_view json, size_t pos) {
+  while (pos < json.size() && IsJsonSpace(json[pos])) ++pos;
+  return pos;
+}
+
+// Returns the end of the JSON value that starts at |pos| in |json|, or npos if
+// there is none.
+size_t SkipJsonValue(std::string_view json, size_t pos) {
+  if (pos >= json.size()) return std::string_view::npos;
+  const char first = json[pos];
+  if (first == '"' || first == '{' || first == '[') {
+    bool in_string = false;
+    int depth = 0;
+    for (size_t i = pos; i < json.size(); ++i) {
+      const char c = json[i];
+      if (in_string) {
+        if (c == '\\') {
+          ++i;
+        } else if (c == '"') {
+          in_string = false;
+          if (depth == 0) return i + 1;
+        }
+      } else if (c == '"') {
+        in_string = true;
+      } else if (c == '{' || c == '[') {
+        ++depth;
+      } else if (c == '}' || c == ']') {
+        if (--depth == 0) return i + 1;
+      }
+    }
+    return std::string_view::npos;
+  }
+  // A number or a literal.
+  size_t end = pos;
+  while (end < json.size() && !IsJsonSpace(json[end]) && json[end] != ',' &&
+         json[end] != '}' && json[end] != ']') {
+    ++end;
+  }
+  return end != pos ? end : std::string_view::npos;
+}
+
+void AppendUtf8(uint32_t code_point, std::string* out) {
+  if (code_point < 0x80) {
+    out->push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    out->push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else {
+    out->push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  }
+}
+
+// Returns the contents of |quoted|, a JSON string with its quotes.
+std::string UnquoteJsonString(std::string_view quoted) {
+  assert(quoted.size() >= 2);
+  const std::string_view text = quoted.substr(1, quoted.size() - 2);
+  std::string unquoted;
+  unquoted.reserve(text.size());
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (text[i] != '\\' || i + 1 == text.size()) {
+      unquoted.push_back(text[i]);
+      continue;
+    }
+    switch (const char escaped = text[++i]) {
+      case 'b':
+        unquoted.push_back('\b');
+        break;
+      case 'f':
+        unquoted.push_back('\f');
+        break;
+      case 'n':
+        unquoted.push_back('\n');
+        break;
+      case 'r':
+        unquoted.push_back('\r');
+        break;
+      case 't':
+        unquoted.push_back('\t');
+        break;
+      case 'u': {
+        uint32_t code_point = 0;
+        size_t digits = 0;
+        for (; digits != 4 && i + 1 < text.size(); ++digits) {
+          const char c = text[i + 1];
+          uint32_t digit = 0;
+          if (c >= '0' && c <= '9') {
+            digit = c - '0';
+          } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+          } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+          } else {
+            break;
+          }
+          code_point = code_point * 16 + digit;
+          ++i;
+        }
+        AppendUtf8(code_point, &unquoted);
+        break;
+      }
+      default:
+        // '"', '\\' and '/'.
+        unquoted.push_back(escaped);
+        break;
+    }
+  }
+  return unquoted;
+}
+
+// Returns |text| as a JSON string, with its quotes.
+std::string QuoteJsonString(std::string_view text) {
+  std::string quoted = "\"";
+  for (const char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted.push_back('\\');
+      quoted.push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      constexpr char kHexDigits[] = "0123456789abcdef";
+      quoted += "\\u00";
+      quoted.push_back(kHexDigits[c >> 4]);
+      quoted.push_back(kHexDigits[c & 0xF]);
+    } else {
+      quoted.push_back(c);
+    }
+  }
+  quoted.push_back('"');
+  return quoted;
+}
+
+using JsonMembers = std::vector<std::pair<std::string_view, std::string_view>>;
+
+std::optional<std::string_view> FindMember(const JsonMembers& members,
+                                           std::string_view key) {
+  for (const auto& [member_key, value] : members) {
+    if (member_key == key) return value;
+  }
+  return std::nullopt;
+}
+
+std::optional<int64_t> FindIntMember(const JsonMembers& members,
+                                     std::string_view key) {
+  std::optional<std::string_view> value = FindMember(members, key);
+  int64_t parsed = 0;
+  if (!value || !ParseInt64(*value, &parsed)) return std::nullopt;
+  return parsed;
+}
+
+std::optional<std::string> FindStringMember(const JsonMembers& members,
+                                            std::string_view key) {
+  std::optional<std::string_view> value = FindMember(members, key);
+  if (!value || value->empty() || value->front() != '"') return std::nullopt;
+  return UnquoteJsonString(*value);
+}
+
+// Writes |members| back as a JSON object, spaced like `TraceEventLogger`.
+std::string SerializeJsonObject(const JsonMembers& members) {
+  std::string json = "{ ";
+  for (size_t i = 0; i != members.size(); ++i) {
+    absl::StrAppend(&json, i == 0 ? "" : ", ", "\"",
+                    std::string(members[i].first),
+                    "\" : ", std::string(members[i].second));
+  }
+  json += " }";
+  return json;
+}
+
+// Reads the next line of |file| into |line|, without the line feed. Returns
+// false at the end of the file.
+bool ReadLine(FILE* file, std::string* line) {
+  line->clear();
+  char buffer[4096];
+  while (fgets(buffer, sizeof(buffer), file)) {
+    const size_t length = strlen(buffer);
+    if (length != 0 && buffer[length - 1] == '\n') {
+      line->append(buffer, length - 1);
+      return true;
+    }
+    line->append(buffer, length);
+  }
+  return !line->empty();
+}
+
+struct TraceProcess {
+  // The name of the log the process comes from.
+  std::string name;
+  // The pid the process had in the log.
+  int64_t logged_pid = 0;
+  std::set<int64_t> tids;
+};
+
+using TraceProcesses = std::map<int64_t, TraceProcess>;
+
+std::string GetThreadName(const TraceProcess& process, int64_t tid) {
+  return tid == process.logged_pid ? "main thread"
+                                    : absl::StrCat("thread ", tid);
+}
+
+// An event of the inputs, serialized.
+struct SortedEvent {
+  int64_t timestamp_ns = 0;
+  // The order of the event in the inputs, to keep the order of the events with
+  // the same timestamp.
+  uint64_t sequence = 0;
+  std::string json;
+
+  bool operator<(const SortedEvent& other) const {
+    return std::tie(timestamp_ns, sequence) <
+           std::tie(other.timestamp_ns, other.sequence);
+  }
+};
+
+// Writes the merged trace in one of the `TraceFormat`s.
+class TraceWriter {
+ public:
+  virtual ~TraceWriter() = default;
+
+  // Called first, with all the processes of the trace.
+  virtual void WriteProcesses(const TraceProcesses& processes) = 0;
+  // Called with the events in the order of their timestamps.
+  virtual void WriteEvent(int64_t timestamp_ns, std::string_view json) = 0;
+  virtual void Finish() = 0;
+};
+
+class JsonTraceWriter : public TraceWriter {
+ public:
+  explicit JsonTraceWriter(FILE* out) : out_(out) {}
+
+  void WriteProcesses(const TraceProcesses& processes) override {
+    fputs("[\n", out_);
+    for (const auto& [pid, process] : processes) {
+      WriteLine(absl::StrCat(
+          "{ \"name\" : \"process_name\", \"ph\" : \"M\", \"pid\" : ", pid,
+          ", \"tid\" : 0, \"args\" : { \"name\" : ",
+          QuoteJsonString(process.name), " } }"));
+      for (const int64_t tid : process.tids) {
+        WriteLine(absl::StrCat(
+            "{ \"name\" : \"thread_name\", \"ph\" : \"M\", \"pid\" : ", pid,
+            ", \"tid\" : ", tid, ", \"args\" : { \"name\" : ",
+            QuoteJsonString(GetThreadName(process, tid)), " } }"));
+      }
+    }
+  }
+
+  void WriteEvent(int64_t, std::string_view json) override { WriteLine(json); }
+
+  void Finish() override { fputs(first_line_ ? "]\n" : "\n]\n", out_); }
+
+ private:
+  void WriteLine(std::string_view line) {
+    if (!first_line_) fputs(",\n", out_);
+    fwrite(line.data(), 1, line.size(), out_);
+    first_line_ = false;
+  }
+
+  FILE* out_ = nullptr;
+  bool first_line_ = true;
+};
+
+// Builds a protobuf message, field by field.
+class ProtoBuilder {
+ public:
+  void AppendVarint(uint32_t field, uint64_t value) {
+    AppendRawVarint(uint64_t(field) << 3);
+    AppendRawVarint(value);
+  }
+
+  void AppendInt(uint32_t field, int64_t value) {
+    AppendVarint(field, static_cast<uint64_t>(value));
+  }
+
+  void AppendDouble(uint32_t field, double value) {
+    AppendRawVarint(uint64_t(field) << 3 | 1);
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i != 8; ++i)
+      data_.push_back(static_cast<char>(bits >> 8 * i));
+  }
+
+  void AppendBytes(uint32_t field, std::string_view bytes) {
+    AppendRawVarint(uint64_t(field) << 3 | 2);
+    AppendRawVarint(bytes.size());
+    data_.append(bytes.data(), bytes.size());
+  }
+
+  void AppendMessage(uint32_t field, const ProtoBuilder& message) {
+    AppendBytes(field, message.data_);
+  }
+
+  const std::string& GetData() const { return data_; }
+
+ private:
+  void AppendRawVarint(uint64_t value) {
+    while (value >= 0x80) {
+      data_.push_back(static_cast<char>(value | 0x80));
+      value >>= 7;
+    }
+    data_.push_back(static_cast<char>(value));
+  }
+
+  std::string data_;
+};
+
+// Writes the events as Perfetto track events: complete events become slices
+// on the track of their thread, and instant events are put on the track of
+// their thread or, if their scope is the process or global, of their process.
+// The args become debug annotations.
+class PerfettoTraceWriter : public TraceWriter {
+ public:
+  explicit PerfettoTraceWriter(FILE* out) : out_(out) {}
+
+  void WriteProcesses(const TraceProcesses& processes) override {
+    for (const auto& [pid, process] : processes) {
+      const uint64_t process_uuid = next_uuid_++;
+      process_tracks_[pid] = process_uuid;
+      ProtoBuilder process_descriptor;
+      process_descriptor.AppendInt(kProcessDescriptorPid, pid);
+      process_descriptor.AppendBytes(kProcessDescriptorName, process.name);
+      ProtoBuilder track;
+      track.AppendVarint(kTrackDescriptorUuid, process_uuid);
+      track.AppendMessage(kTrackDescriptorProcess, process_descriptor);
+      WriteTrackDescriptor(track);
+
+      for (const int64_t tid : process.tids) {
+        const uint64_t thread_uuid = next_uuid_++;
+        thread_tracks_[{pid, tid}] = thread_uuid;
+        ProtoBuilder thread_descriptor;
+        thread_descriptor.AppendInt(kThreadDescriptorPid, pid);
+        thread_descriptor.AppendInt(kThreadDescriptorTid, tid);
+        thread_descriptor.AppendBytes(kThreadDescriptorName,
+                                      GetThreadName(process, tid));
+        ProtoBuilder thread_track;
+        thread_track.AppendVarint(kTrackDescriptorUuid, thread_uuid);
+        thread_track.AppendVarint(kTrackDescriptorParentUuid, process_uuid);
+        thread_track.AppendMessage(kTrackDescriptorThread, thread_descriptor);
+        WriteTrackDescriptor(thread_track);
+      }
+    }
+  }
+
+  void WriteEvent(int64_t timestamp_ns, std::string_view json) override {
+    WriteSliceEnds(timestamp_ns);
+    JsonMembers members;
+    if (!ParseJsonObject(json, &members)) return;
+    const int64_t pid = FindIntMember(members, "pid").value_or(0);
+    const int64_t tid = FindIntMember(members, "tid").value_or(0);
+    const std::string phase = FindStringMember(members, "ph").value_or("");
+    const std::string scope = FindStringMember(members, "s").value_or("t");
+    const uint64_t track_uuid = phase == "i" && scope != "t"
+                                    ? process_tracks_[pid]
+                                    : thread_tracks_[{pid, tid}];
+
+    ProtoBuilder event;
+    event.AppendVarint(kTrackEventTrackUuid, track_uuid);
+    event.AppendBytes(kTrackEventName,
+                      FindStringMember(members, "name").value_or(""));
+    if (std::optional<std::string> category =
+            FindStringMember(members, "cat")) {
+      event.AppendBytes(kTrackEventCategories, *category);
+    }
+    AppendDebugAnnotations(FindMember(members, "args").value_or("{}"), &event);
+
+    int64_t duration_ns = 0;
+    std::optional<std::string_view> duration = FindMember(members, "dur");
+    if (phase == "X" && duration && ParseTraceTime(*duration, &duration_ns)) {
+      event.AppendVarint(kTrackEventType, kTypeSliceBegin);
+      pending_slice_ends_.push(
+          {timestamp_ns + duration_ns, next_slice_++, track_uuid});
+    } else {
+      event.AppendVarint(kTrackEventType, kTypeInstant);
+    }
+    WriteTrackEvent(timestamp_ns, event);
+  }
+
+  void Finish() override {
+    WriteSliceEnds(std::numeric_limits<int64_t>::max());
+  }
+
+ private:
+  // The fields of the Perfetto protos.
+  static constexpr uint32_t kTracePacket = 1;
+  static constexpr uint32_t kPacketTimestamp = 8;
+  static constexpr uint32_t kPacketSequenceId = 10;
+  static constexpr uint32_t kPacketTrackEvent = 11;
+  static constexpr uint32_t kPacketSequenceFlags = 13;
+  static constexpr uint32_t kPacketTrackDescriptor = 60;
+  static constexpr uint32_t kTrackDescriptorUuid = 1;
+  static constexpr uint32_t kTrackDescriptorProcess = 3;
+  static constexpr uint32_t kTrackDescriptorThread = 4;
+  static constexpr uint32_t kTrackDescriptorParentUuid = 5;
+  static constexpr uint32_t kProcessDescriptorPid = 1;
+  static constexpr uint32_t kProcessDescriptorName = 6;
+  static constexpr uint32_t kThreadDescriptorPid = 1;
+  static constexpr uint32_t kThreadDescriptorTid = 2;
+  static constexpr uint32_t kThreadDescriptorName = 5;
+  static constexpr uint32_t kTrackEventDebugAnnotations = 4;
+  static constexpr uint32_t kTrackEventType = 9;
+  static constexpr uint32_t kTrackEventTrackUuid = 11;
+  static constexpr uint32_t kTrackEventCategories = 22;
+  static constexpr uint32_t kTrackEventName = 23;
+  static constexpr uint32_t kDebugAnnotationBool = 2;
+  static constexpr uint32_t kDebugAnnotationInt = 4;
+  static constexpr uint32_t kDebugAnnotationDouble = 5;
+  static constexpr uint32_t kDebugAnnotationString = 6;
+  static constexpr uint32_t kDebugAnnotationJson = 9;
+  static constexpr uint32_t kDebugAnnotationName = 10;
+  static constexpr uint64_t kTypeSliceBegin = 1;
+  static constexpr uint64_t kTypeSliceEnd = 2;
+  static constexpr uint64_t kTypeInstant = 3;
+  static constexpr uint64_t kSequenceIncrementalStateCleared = 1;
+  static constexpr uint64_t kSequenceNeedsIncrementalState = 2;
+  // All the packets are written on one sequence.
+  static constexpr uint64_t kSequenceId = 1;
+
+  struct SliceEnd {
+    int64_t timestamp_ns = 0;
+    // The order of the slice's begin, so that the slices that end at the same
+    // time end in the order they begin.
+    uint64_t slice = 0;
+    uint64_t track_uuid = 0;
+
+    bool operator>(const SliceEnd& other) const {
+      return std::tie(timestamp_ns, slice) >
+             std::tie(other.timestamp_ns, other.slice);
+    }
+  };
+
+  static void AppendDebugAnnotations(std::string_view args,
+                                     ProtoBuilder* event) {
+    JsonMembers members;
+    if (!ParseJsonObject(args, &members)) return;
+    for (const auto& [name, value] : members) {
+      ProtoBuilder annotation;
+      annotation.AppendBytes(kDebugAnnotationName, name);
+      int64_t int_value = 0;
+      if (value.front() == '"') {
+        annotation.AppendBytes(kDebugAnnotationString,
+                               UnquoteJsonString(value));
+      } else if (value == "true" || value == "false") {
+        annotation.AppendVarint(kDebugAnnotationBool, value == "true");
+      } else if (ParseInt64(value, &int_value)) {
+        annotation.AppendInt(kDebugAnnotationInt, int_value);
+      } else if (double double_value = 0;
+                 absl::SimpleAtod(absl::string_view(value.data(), value.size()),
+                                  &double_value)) {
+        annotation.AppendDouble(kDebugAnnotationDouble, double_value);
+      } else {
+        annotation.AppendBytes(kDebugAnnotationJson, value);
+      }
+      event->AppendMessage(kTrackEventDebugAnnotations, annotation);
+    }
+  }
+
+  // Ends the slices that end by |timestamp_ns|.
+  void WriteSliceEnds(int64_t timestamp_ns) {
+    while (!pending_slice_ends_.empty() &&
+           pending_slice_ends_.top().timestamp_ns <= timestamp_ns) {
+      const SliceEnd end = pending_slice_ends_.top();
+      pending_slice_ends_.pop();
+      ProtoBuilder event;
+      event.AppendVarint(kTrackEventTrackUuid, end.track_uuid);
+      event.AppendVarint(kTrackEventType, kTypeSliceEnd);
+      WriteTrackEvent(end.timestamp_ns, event);
+    }
+  }
+
+  void WriteTrackDescriptor(const ProtoBuilder& track) {
+    ProtoBuilder packet;
+    packet.AppendVarint(kPacketSequenceId, kSequenceId);
+    if (first_packet_) {
+      packet.AppendVarint(kPacketSequenceFlags,
+                          kSequenceIncrementalStateCleared);
+      first_packet_ = false;
+    }
+    packet.AppendMessage(kPacketTrackDescriptor, track);
+    WritePacket(packet);
+  }
+
+  void WriteTrackEvent(int64_t timestamp_ns, const ProtoBuilder& event) {
+    ProtoBuilder packet;
+    packet.AppendVarint(kPacketTimestamp, timestamp_ns);
+    packet.AppendVarint(kPacketSequenceId, kSequenceId);
+    packet.AppendVarint(kPacketSequenceFlags,
+                        first_packet_ ? kSequenceIncrementalStateCleared
+                                      : kSequenceNeedsIncrementalState);
+    first_packet_ = false;
+    packet.AppendMessage(kPacketTrackEvent, event);
+    WritePacket(packet);
+  }
+
+  void WritePacket(const ProtoBuilder& packet) {
+    ProtoBuilder trace;
+    trace.AppendMessage(kTracePacket, packet);
+    fwrite(trace.GetData().data(), 1, trace.GetData().size(), out_);
+  }
+
+  FILE* out_ = nullptr;
+  bool first_packet_ = true;
+  uint64_t next_uuid_ = 1;
+  uint64_t next_slice_ = 0;
+  std::map<int64_t, uint64_t> process_tracks_;
+  std::map<std::pair<int64_t, int64_t>, uint64_t> thread_tracks_;
+  std::priority_queue<SliceEnd, std::vector<SliceEnd>, std::greater<>>
+      pending_slice_ends_;
+};
+
+// A temporary file of events sorted by timestamp, one per line, each prefixed
+// with its timestamp.
+class SpilledRun {
+ public:
+  static absl::StatusOr<std::unique_ptr<SpilledRun>> Create(
+      const std::vector<SortedEvent>& sorted_events) {
+    FILE* file = tmpfile();
+    if (!file) return absl::InternalError("Cannot create a temporary file");
+    for (const SortedEvent& event : sorted_events) {
+      fprintf(file, "%lld ", static_cast<long long>(event.timestamp_ns));
+      fwrite(event.json.data(), 1, event.json.size(), file);
+      fputc('\n', file);
+    }
+    if (fflush(file) != 0 || ferror(file)) {
+      fclose(file);
+      return absl::InternalError("Cannot write a temporary file");
+    }
+    rewind(file);
+    return std::unique_ptr<SpilledRun>(new SpilledRun(file));
+  }
+
+  ~SpilledRun() { fclose(file_); }
+
+  // Reads the next event. Returns false at the end of the run.
+  bool Next() {
+    if (!ReadLine(file_, &line_)) return false;
+    const size_t separator = line_.find(' ');
+    if (separator == std::string::npos ||
+        !ParseInt64(std::string_view(line_).substr(0, separator),
+                    &timestamp_ns_)) {
+      return false;
+    }
+    json_ = std::string_view(line_).substr(separator + 1);
+    return true;
+  }
+
+  int64_t GetTimestampNs() const { return timestamp_ns_; }
+  std::string_view GetJson() const { return json_; }
+
+ private:
+  explicit SpilledRun(FILE* file) : file_(file) {}
+
+  FILE* file_ = nullptr;
+  std::string line_;
+  int64_t timestamp_ns_ = 0;
+  std::string_view json_;
+};
+
+// Merges the sorted |runs| into |writer|.
+void MergeRuns(std::vector<std::unique_ptr<SpilledRun>>& runs,
+               TraceWriter* writer) {
+  // The runs hold the events in the order of the inputs, so the ties are
+  // broken by the index of the run.
+  using Head = std::pair<int64_t, size_t>;
+  std::priority_queue<Head, std::vector<Head>, std::greater<>> heads;
+  for (size_t i = 0; i != runs.size(); ++i) {
+    if (runs[i]->Next()) heads.push({runs[i]->GetTimestampNs(), i});
+  }
+  while (!heads.empty()) {
+    const size_t run = heads.top().second;
+    heads.pop();
+    writer->WriteEvent(runs[run]->GetTimestampNs(), runs[run]->GetJson());
+    if (runs[run]->Next()) heads.push({runs[run]->GetTimestampNs(), run});
+  }
+}
+}  // namespace
+
+bool ParseJsonObject(std::string_view json, JsonMembers* members) {
+  members->clear();
+  if (json.empty() || json.front() != '{') return false;
+  size_t pos = SkipJsonSpace(json, 1);
+  if (pos < json.size() && json[pos] == '}') return pos + 1 == json.size();
+  while (true) {
+    if (pos >= json.size() || json[pos] != '"') return false;
+    const size_t key_end = SkipJsonValue(json, pos);
+    if (key_end == std::string_view::npos) return false;
+    const std::string_view key = json.substr(pos + 1, key_end - pos - 2);
+    pos = SkipJsonSpace(json, key_end);
+    if (pos >= json.size() || json[pos] != ':') return false;
+    pos = SkipJsonSpace(json, pos + 1);
+    const size_t value_end = SkipJsonValue(json, pos);
+    if (value_end == std::string_view::npos) return false;
+    members->emplace_back(key, json.substr(pos, value_end - pos));
+    pos = SkipJsonSpace(json, value_end);
+    if (pos >= json.size()) return false;
+    if (json[pos] == '}') return pos + 1 == json.size();
+    if (json[pos] != ',') return false;
+    pos = SkipJsonSpace(json, pos + 1);
+  }
+}
+
+bool ParseTraceTime(std::string_view text, int64_t* nanoseconds) {
+  // Large enough for the milliseconds since the epoch, small enough for their
+  // nanoseconds not to overflow.
+  constexpr size_t kMaxMillisecondDigits = 15;
+  const size_t point = std::min(text.find('.'), text.size());
+  const std::string_view milliseconds = text.substr(0, point);
+  std::string_view fraction =
+      point < text.size() ? text.substr(point + 1) : std::string_view();
+  if (milliseconds.empty() || milliseconds.size() > kMaxMillisecondDigits ||
+      (point < text.size() && fraction.empty())) {
+    return false;
+  }
+  auto all_digits = [](std::string_view digits) {
+    return std::all_of(digits.begin(), digits.end(),
+                       [](char c) { return c >= '0' && c <= '9'; });
+  };
+  if (!all_digits(milliseconds) || !all_digits(fraction)) return false;
+
+  int64_t parsed_milliseconds = 0;
+  if (!ParseInt64(milliseconds, &parsed_milliseconds)) return false;
+  int64_t fraction_ns = 0;
+  for (size_t i = 0; i != 6; ++i) {
+    const int digit = i < fraction.size() ? fraction[i] - '0' : 0;
+    fraction_ns = fraction_ns * 10 + digit;
+  }
+  *nanoseconds = parsed_milliseconds * kNanosPerMilli + fraction_ns;
+  return true;
+}
+
+absl::StatusOr<TraceMergeStats> MergeTraces(
+    const std::vector<std::string>& paths, const TraceMergeOptions& options,
+    FILE* out) {
+  TraceMergeStats stats;
+  TraceProcesses processes;
+  std::vector<SortedEvent> events;
+  size_t events_size = 0;
+  std::vector<std::unique_ptr<SpilledRun>> runs;
+
+  auto spill_events = [&]() -> absl::Status {
+    std::sort(events.begin(), events.end());
+    absl::StatusOr<std::unique_ptr<SpilledRun>> run =
+        SpilledRun::Create(events);
+    if (!run.ok()) return run.status();
+    runs.push_back(*std::move(run));
+    ++stats.num_spilled_runs;
+    events.clear();
+    events_size = 0;
+    return absl::OkStatus();
+  };
+
+  std::string line;
+  JsonMembers members;
+  for (const std::string& path : paths) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) return absl::NotFoundError(absl::StrCat("Cannot open ", path));
+    const std::string name = std::filesystem::path(path).filename().string();
+    // The pids of the input's processes in the merged trace.
+    std::map<int64_t, int64_t> pids;
+    // The process names of the input's metadata events, e.g., if it is a
+    // merged trace, which replace the name of the input.
+    std::map<int64_t, std::string> logged_names;
+
+    while (ReadLine(file, &line)) {
+      std::string_view text = StripJsonSpace(line);
+      if (!text.empty() && text.back() == ',')
+        text = StripJsonSpace(text.substr(0, text.size() - 1));
+      if (text.empty() || text == "[" || text == "]") {
+        ++stats.num_dropped_lines;
+        continue;
+      }
+      if (!ParseJsonObject(text, &members)) {
+        ++stats.num_malformed_lines;
+        continue;
+      }
+      if (FindStringMember(members, "ph") == "M") {
+        std::optional<int64_t> pid = FindIntMember(members, "pid");
+        JsonMembers args;
+        if (pid && FindStringMember(members, "name") == "process_name" &&
+            ParseJsonObject(FindMember(members, "args").value_or(""), &args)) {
+          if (std::optional<std::string> process_name =
+                  FindStringMember(args, "name")) {
+            logged_names[*pid] = *std::move(process_name);
+          }
+        }
+        ++stats.num_dropped_lines;
+        continue;
+      }
+      std::optional<std::string_view> timestamp = FindMember(members, "ts");
+      std::optional<int64_t> pid = FindIntMember(members, "pid");
+      int64_t timestamp_ns = 0;
+      if (!timestamp || !pid || !ParseTraceTime(*timestamp, &timestamp_ns)) {
+        ++stats.num_malformed_lines;
+        continue;
+      }
+
+      auto [pid_it, new_pid] = pids.emplace(*pid, *pid);
+      if (new_pid) {
+        // Give the process a new pid if another input already uses it.
+        while (processes.count(pid_it->second)) ++pid_it->second;
+        if (pid_it->second != *pid) ++stats.num_renumbered_processes;
+        TraceProcess& process = processes[pid_it->second];
+        process.name = name;
+        process.logged_pid = *pid;
+      }
+      const int64_t merged_pid = pid_it->second;
+      processes[merged_pid].tids.insert(
+          FindIntMember(members, "tid").value_or(0));
+
+      SortedEvent& event = events.emplace_back();
+      event.timestamp_ns = timestamp_ns;
+      event.sequence = stats.num_events++;
+      if (merged_pid == *pid) {
+        event.json = std::string(text);
+      } else {
+        const std::string merged_pid_text = std::to_string(merged_pid);
+        for (auto& [key, value] : members) {
+          if (key == "pid") value = merged_pid_text;
+        }
+        event.json = SerializeJsonObject(members);
+      }
+      events_size += sizeof(SortedEvent) + event.json.size();
+      if (events_size > options.max_memory_bytes) {
+        if (absl::Status spilled = spill_events(); !spilled.ok()) {
+          fclose(file);
+          return spilled;
+        }
+      }
+    }
+    for (const auto& [pid, name] : logged_names) {
+      if (auto it = pids.find(pid); it != pids.end())
+        processes[it->second].name = name;
+    }
+    const bool read_error = ferror(file);
+    fclose(file);
+    if (read_error)
+      return absl::DataLossError(absl::StrCat("Cannot read ", path));
+  }
+
+  std::unique_ptr<TraceWriter> writer;
+  if (options.format == TraceFormat::kJson) {
+    writer = std::make_unique<JsonTraceWriter>(out);
+  } else {
+    writer = std::make_unique<PerfettoTraceWriter>(out);
+  }
+  writer->WriteProcesses(processes);
+  if (runs.empty()) {
+    std::sort(events.begin(), events.end());
+    for (const SortedEvent& event : events)
+      writer->WriteEvent(event.timestamp_ns, event.json);
+  } else {
+    if (!events.empty()) {
+      if (absl::Status spilled = spill_events(); !spilled.ok()) return spilled;
+    }
+    MergeRuns(runs, writer.get());
+  }
+  writer->Finish();
+  if (fflush(out) != 0 || ferror(out))
+    return absl::DataLossError("Cannot write the merged trace");
+  return stats;
+}
+
+}  // namespace performancelayers
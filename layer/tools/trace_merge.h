@@ -0,0 +1,84 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_TRACE_MERGE_H_
+#define STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_TRACE_MERGE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"
+
+// Merges the Trace Event logs written by `TraceEventLogger`. Every layer
+// appends its own '[' to the log and the array is never closed, and the events
+// of a log are only roughly sorted, so the logs are merged into one sorted and
+// finalized trace.
+
+namespace performancelayers {
+enum class TraceFormat {
+  // A JSON array in the Trace Event format.
+  kJson,
+  // A protobuf trace of Perfetto track events.
+  kPerfetto,
+};
+
+struct TraceMergeOptions {
+  TraceFormat format = TraceFormat::kJson;
+  // The size of the events kept in memory. Once exceeded, the events are
+  // sorted and spilled to a temporary file, and the files are merged at the
+  // end.
+  size_t max_memory_bytes = size_t(256) << 20;
+};
+
+struct TraceMergeStats {
+  uint64_t num_events = 0;
+  // The '[' and ']' lines and the metadata events of the inputs, replaced by
+  // those of the merged trace.
+  uint64_t num_dropped_lines = 0;
+  // The lines that are not trace events, e.g., truncated by a crash.
+  uint64_t num_malformed_lines = 0;
+  // The number of sorted runs spilled to temporary files.
+  uint64_t num_spilled_runs = 0;
+  // The processes of an input whose pid is already used by another input,
+  // and that got a new one.
+  uint64_t num_renumbered_processes = 0;
+};
+
+// Merges the trace event logs at |paths| into |out|, sorted by timestamp.
+// Every process gets a name, after the log it comes from unless the log names
+// it, and so do its threads.
+absl::StatusOr<TraceMergeStats> MergeTraces(
+    const std::vector<std::string>& paths, const TraceMergeOptions& options,
+    FILE* out);
+
+// Splits |json|, a JSON object with no surrounding whitespace, into the keys
+// and the raw text of the values of its members. Returns false if it is not an
+// object.
+bool ParseJsonObject(std::string_view json,
+                     std::vector<std::pair<std::string_view, std::string_view>>*
+                         members);
+
+// Parses |text|, a duration or a timestamp in milliseconds as written by
+// `TraceEventLogger`, into |nanoseconds|. Digits past the nanoseconds are
+// dropped. Returns false if it is not a non-negative decimal number.
+bool ParseTraceTime(std::string_view text, int64_t* nanoseconds);
+
+}  // namespace performancelayers
+
+#endif  // STADIA_OPEN_SOURCE_PERFORMANCE_LAYERS_TRACE_MERGE_H_
@@ -0,0 +1,108 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/support/call_site_profiler.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "layer/support/log_output.h"
+
+using ::testing::ElementsAre;
+using ::testing::EndsWith;
+using ::testing::IsEmpty;
+using ::testing::UnorderedElementsAre;
+
+namespace performancelayers {
+namespace {
+// Returns a fake return address. Addresses this low are not in any loaded
+// module, so they are printed as plain addresses.
+void* Frame(uintptr_t address) { return reinterpret_cast<void*>(address); }
+
+TEST(CallSiteProfiler, InternsStacks) {
+  CallSiteProfiler profiler(1, 0);
+  void* const stack_a[] = {Frame(0x30), Frame(0x20), Frame(0x10)};
+  void* const stack_b[] = {Frame(0x40), Frame(0x20), Frame(0x10)};
+
+  const CallSiteProfiler::StackId a = profiler.AddStack(stack_a, 3, 1);
+  const CallSiteProfiler::StackId b = profiler.AddStack(stack_b, 3, 1);
+  EXPECT_NE(a, CallSiteProfiler::kNoStack);
+  EXPECT_NE(a, b);
+  EXPECT_EQ(profiler.AddStack(stack_a, 3, 1), a);
+
+  // The outermost frame comes first.
+  EXPECT_EQ(profiler.GetFoldedStack(a), "0x10;0x20;0x30");
+  EXPECT_EQ(profiler.GetFoldedStack(b), "0x10;0x20;0x40");
+  EXPECT_EQ(profiler.GetFoldedStack(CallSiteProfiler::kNoStack), "");
+}
+
+TEST(CallSiteProfiler, WritesFoldedStacks) {
+  CallSiteProfiler profiler(1, 0);
+  void* const stack_a[] = {Frame(0x30), Frame(0x20), Frame(0x10)};
+  void* const stack_b[] = {Frame(0x20), Frame(0x10)};
+  profiler.AddStack(stack_a, 3, 5);
+  profiler.AddStack(stack_a, 3, 2);
+  profiler.AddStack(stack_b, 2, 4);
+
+  // The prefix of a stack is only written if it was charged itself.
+  StringOutput out;
+  profiler.WriteFoldedStacks(&out);
+  EXPECT_THAT(out.GetLog(),
+              UnorderedElementsAre("0x10;0x20;0x30 7", "0x10;0x20 4"));
+}
+
+TEST(CallSiteProfiler, DisabledProfilerRecordsNothing) {
+  CallSiteProfiler profiler(0, 0);
+  EXPECT_FALSE(profiler.IsEnabled());
+  EXPECT_EQ(profiler.Record(1000), CallSiteProfiler::kNoStack);
+
+  StringOutput out;
+  profiler.WriteFoldedStacks(&out);
+  EXPECT_THAT(out.GetLog(), IsEmpty());
+}
+
+TEST(CallSiteProfiler, SamplesEveryPeriod) {
+  CallSiteProfiler profiler(100, 0);
+  std::vector<CallSiteProfiler::StackId> sampled;
+  for (int i = 0; i != 10; ++i) {
+    if (CallSiteProfiler::StackId stack = profiler.Record(30);
+        stack != CallSiteProfiler::kNoStack) {
+      sampled.push_back(stack);
+    }
+  }
+  // The weight crosses 100, 200 and 300, and all calls come from the same
+  // stack.
+  ASSERT_EQ(sampled.size(), 3u);
+  EXPECT_EQ(sampled[0], sampled[1]);
+  EXPECT_EQ(sampled[0], sampled[2]);
+
+  StringOutput out;
+  profiler.WriteFoldedStacks(&out);
+  ASSERT_THAT(out.GetLog(), ElementsAre(EndsWith(" 300")));
+}
+
+TEST(CallSiteProfiler, ChargesEveryCrossedPeriod) {
+  CallSiteProfiler profiler(100, 0);
+  EXPECT_NE(profiler.Record(250), CallSiteProfiler::kNoStack);
+
+  StringOutput out;
+  profiler.WriteFoldedStacks(&out);
+  ASSERT_THAT(out.GetLog(), ElementsAre(EndsWith(" 200")));
+}
+
+}  // namespace
+}  // namespace performancelayers
@@ -0,0 +1,71 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/command_recording/command_recording_layer_data.h"
+
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace performancelayers {
+namespace {
+using Interval =
+    std::pair<DurationClock::time_point, DurationClock::time_point>;
+
+// Returns the interval [begin_us, end_us], in microseconds after an arbitrary
+// origin.
+Interval Span(int64_t begin_us, int64_t end_us) {
+  const DurationClock::time_point origin;
+  return {origin + std::chrono::microseconds(begin_us),
+          origin + std::chrono::microseconds(end_us)};
+}
+
+int64_t GetCoveredMicroseconds(std::vector<Interval> intervals) {
+  return GetCoveredTime(&intervals).ToNanoseconds() / 1000;
+}
+
+TEST(GetCoveredTime, NoIntervalsCoverNothing) {
+  EXPECT_EQ(GetCoveredMicroseconds({}), 0);
+}
+
+TEST(GetCoveredTime, SumsDisjointIntervals) {
+  EXPECT_EQ(GetCoveredMicroseconds({Span(20, 30), Span(0, 10)}), 20);
+}
+
+TEST(GetCoveredTime, MergesOverlappingIntervals) {
+  EXPECT_EQ(GetCoveredMicroseconds({Span(0, 10), Span(5, 15), Span(12, 20)}),
+            20);
+}
+
+TEST(GetCoveredTime, MergesNestedIntervals) {
+  EXPECT_EQ(GetCoveredMicroseconds({Span(0, 100), Span(10, 20), Span(30, 40)}),
+            100);
+}
+
+TEST(GetCoveredTime, MergesTouchingIntervals) {
+  EXPECT_EQ(GetCoveredMicroseconds({Span(10, 20), Span(0, 10)}), 20);
+}
+
+TEST(GetCoveredTime, KeepsGapsAfterNestedIntervals) {
+  // The second interval ends before the first, so the third one doesn't
+  // overlap the merged interval.
+  EXPECT_EQ(GetCoveredMicroseconds({Span(0, 50), Span(10, 20), Span(60, 70)}),
+            60);
+}
+
+}  // namespace
+}  // namespace performancelayers
@@ -47,5 +47,24 @@ TEST(CommonLogger, MethodCheck) {
   EXPECT_THAT(out.GetLog(), ElementsAre(event_str.str()));
 }
 
+TEST(CommonLogger, LogsThreadOfTraceEvents) {
+  class TracedEvent : public Event {
+   public:
+    TracedEvent()
+        : Event("traced", 5),
+          count_("count", 3),
+          trace_attr_("trace_attr", "test", "i", 10, 42, {&count_}) {
+      InitAttributes({&count_, &trace_attr_});
+    }
+
+   private:
+    Int64Attr count_;
+    TraceEventAttr trace_attr_;
+  };
+
+  TracedEvent event;
+  EXPECT_EQ(EventToCommonLogStr(event), "traced,timestamp:5,count:3,tid:42");
+}
+
 }  // namespace
 }  // namespace performancelayers
@@ -0,0 +1,164 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/descriptor/descriptor_layer_data.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include "gtest/gtest.h"
+
+namespace performancelayers {
+namespace {
+constexpr size_t kSampledImage =
+    static_cast<size_t>(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE);
+constexpr size_t kUniformBuffer =
+    static_cast<size_t>(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+
+// A pool with room for 4 sets and 16 sampled images, with 2 sets of 4 sampled
+// images each live, and |freed_set_count| sets freed.
+DescriptorPoolState HalfFullPool(uint64_t freed_set_count) {
+  DescriptorPoolState state;
+  state.max_sets = 4;
+  state.can_free_sets = true;
+  state.capacity.Add(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 16);
+  state.live_set_count = 2;
+  state.live.Add(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 8);
+  state.freed_set_count = freed_set_count;
+  return state;
+}
+
+DescriptorCounts SampledImages(uint64_t count) {
+  DescriptorCounts counts;
+  counts.Add(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, count);
+  return counts;
+}
+
+TEST(GetDescriptorCounts, SumsSetLayoutBindings) {
+  VkDescriptorSetLayoutBinding bindings[3] = {};
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  bindings[0].descriptorCount = 1;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+  bindings[1].descriptorCount = 4;
+  bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+  bindings[2].descriptorCount = 2;
+  VkDescriptorSetLayoutCreateInfo create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  create_info.bindingCount = 3;
+  create_info.pBindings = bindings;
+
+  DescriptorSetLayoutCounts counts = GetDescriptorCounts(create_info);
+  EXPECT_FALSE(counts.has_variable_binding);
+  EXPECT_EQ(counts.counts.counts[kUniformBuffer], 1u);
+  EXPECT_EQ(counts.counts.counts[kSampledImage], 6u);
+  EXPECT_EQ(counts.GetSetCounts(100).GetTotal(), 7u);
+}
+
+TEST(GetDescriptorCounts, LeavesOutTheVariableBinding) {
+  VkDescriptorSetLayoutBinding bindings[2] = {};
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  bindings[0].descriptorCount = 1;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+  bindings[1].descriptorCount = 1024;
+  const VkDescriptorBindingFlags binding_flags[2] = {
+      0, VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT};
+  VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info = {};
+  flags_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  flags_info.bindingCount = 2;
+  flags_info.pBindingFlags = binding_flags;
+  VkDescriptorSetLayoutCreateInfo create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  create_info.pNext = &flags_info;
+  create_info.bindingCount = 2;
+  create_info.pBindings = bindings;
+
+  DescriptorSetLayoutCounts counts = GetDescriptorCounts(create_info);
+  EXPECT_TRUE(counts.has_variable_binding);
+  EXPECT_EQ(counts.counts.GetTotal(), 1u);
+  DescriptorCounts set_counts = counts.GetSetCounts(10);
+  EXPECT_EQ(set_counts.counts[kUniformBuffer], 1u);
+  EXPECT_EQ(set_counts.counts[kSampledImage], 10u);
+}
+
+TEST(GetVariableDescriptorCounts, FindsTheCountsInThePNextChain) {
+  const uint32_t descriptor_counts[2] = {3, 5};
+  VkDescriptorSetVariableDescriptorCountAllocateInfo variable_info = {};
+  variable_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+  variable_info.descriptorSetCount = 2;
+  variable_info.pDescriptorCounts = descriptor_counts;
+  // Another structure before the counts.
+  VkDescriptorSetLayoutBindingFlagsCreateInfo other = {};
+  other.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  other.pNext = &variable_info;
+  VkDescriptorSetAllocateInfo allocate_info = {};
+  allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocate_info.descriptorSetCount = 2;
+
+  EXPECT_EQ(GetVariableDescriptorCounts(allocate_info), nullptr);
+  allocate_info.pNext = &other;
+  EXPECT_EQ(GetVariableDescriptorCounts(allocate_info), descriptor_counts);
+  // No counts means that they are all 0.
+  variable_info.descriptorSetCount = 0;
+  EXPECT_EQ(GetVariableDescriptorCounts(allocate_info), nullptr);
+}
+
+TEST(IsFragmentationFailure, TrustsTheDriver) {
+  EXPECT_TRUE(IsFragmentationFailure(VK_ERROR_FRAGMENTED_POOL,
+                                     HalfFullPool(0), 1, SampledImages(4)));
+  EXPECT_FALSE(IsFragmentationFailure(VK_ERROR_OUT_OF_HOST_MEMORY,
+                                      HalfFullPool(1), 1, SampledImages(4)));
+}
+
+TEST(IsFragmentationFailure, FreedPoolWithRoomIsFragmented) {
+  EXPECT_TRUE(IsFragmentationFailure(VK_ERROR_OUT_OF_POOL_MEMORY,
+                                     HalfFullPool(1), 2, SampledImages(8)));
+}
+
+TEST(IsFragmentationFailure, PoolWithoutFreesIsNotFragmented) {
+  EXPECT_FALSE(IsFragmentationFailure(VK_ERROR_OUT_OF_POOL_MEMORY,
+                                      HalfFullPool(0), 1, SampledImages(4)));
+}
+
+TEST(IsFragmentationFailure, PoolWithoutRoomIsNotFragmented) {
+  // Too many sets.
+  EXPECT_FALSE(IsFragmentationFailure(VK_ERROR_OUT_OF_POOL_MEMORY,
+                                      HalfFullPool(1), 3, SampledImages(3)));
+  // Too many descriptors.
+  EXPECT_FALSE(IsFragmentationFailure(VK_ERROR_OUT_OF_POOL_MEMORY,
+                                      HalfFullPool(1), 1, SampledImages(9)));
+  // A type that the pool has none of.
+  DescriptorCounts requested;
+  requested.Add(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1);
+  EXPECT_FALSE(IsFragmentationFailure(VK_ERROR_OUT_OF_POOL_MEMORY,
+                                      HalfFullPool(1), 1, requested));
+}
+
+TEST(IsFragmentationFailure, CountsTheVariableDescriptorsRequested) {
+  DescriptorSetLayoutCounts layout;
+  layout.has_variable_binding = true;
+  layout.variable_type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+  // The pool has room for a set with 8 variable descriptors, not with 9.
+  EXPECT_TRUE(IsFragmentationFailure(VK_ERROR_OUT_OF_POOL_MEMORY,
+                                     HalfFullPool(1), 1,
+                                     layout.GetSetCounts(8)));
+  EXPECT_FALSE(IsFragmentationFailure(VK_ERROR_OUT_OF_POOL_MEMORY,
+                                      HalfFullPool(1), 1,
+                                      layout.GetSetCounts(9)));
+}
+
+}  // namespace
+}  // namespace performancelayers
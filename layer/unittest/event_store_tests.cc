@@ -0,0 +1,170 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/tools/event_store.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using ::testing::ElementsAre;
+
+namespace performancelayers {
+namespace {
+namespace fs = std::filesystem;
+
+// Two layers logging to the same file, each in order, and a truncated line.
+constexpr char kLog[] =
+    "frame_present,timestamp:1000,frame_time:16,started:1,tid:7\n"
+    "create_graphics_pipelines,timestamp:1500,hashes:\"[0x1f,0x2a]\","
+    "duration:40,tid:8\n"
+    "frame_present,timestamp:3000,frame_time:17,started:1,tid:7\n"
+    "pipeline_execution,timestamp:1200,pipeline:\"[0x1f,0x2a]\",runtime:5,"
+    "fragment_shader_invocations:9,compute_shader_invocations:0,tid:7\n"
+    "create_shader_module_ns,timestamp:2500,shader_hash:0x2a,duration:3\n"
+    "frame_time_layer_init,timestamp:900\n"
+    "truncated_eve";
+
+class EventStoreTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = (fs::temp_directory_path() / "event_store_test").string();
+    EventStoreOptions options;
+    options.time_bucket_ns = 1000;
+    absl::StatusOr<EventStoreBuildStats> stats =
+        BuildEventStore({kLog}, dir_, options);
+    ASSERT_TRUE(stats.ok()) << stats.status();
+    EXPECT_EQ(stats->num_events, 6u);
+    EXPECT_EQ(stats->num_malformed_lines, 1u);
+    EXPECT_EQ(stats->num_names, 5u);
+    EXPECT_EQ(stats->num_hashes, 2u);
+    absl::StatusOr<EventStore> store = EventStore::Open(dir_);
+    ASSERT_TRUE(store.ok()) << store.status();
+    store_.emplace(*std::move(store));
+  }
+
+  void TearDown() override { fs::remove_all(dir_); }
+
+  std::vector<int64_t> QueryTimestamps(const EventQuery& query) const {
+    std::vector<int64_t> timestamps;
+    for (uint32_t event : store_->Query(query))
+      timestamps.push_back(store_->GetTimestamp(event));
+    return timestamps;
+  }
+
+  std::string dir_;
+  std::optional<EventStore> store_;
+};
+
+TEST_F(EventStoreTest, StoresSortedEvents) {
+  ASSERT_EQ(store_->GetNumEvents(), 6u);
+  EXPECT_THAT(QueryTimestamps({}),
+              ElementsAre(900, 1000, 1200, 1500, 2500, 3000));
+  EXPECT_EQ(store_->GetName(0), "frame_time_layer_init");
+  EXPECT_EQ(store_->GetAttributes(0), "");
+  EXPECT_EQ(store_->GetThread(0), EventStore::kNoThread);
+  EXPECT_EQ(store_->GetValue(0), std::nullopt);
+
+  EXPECT_EQ(store_->GetName(3), "create_graphics_pipelines");
+  EXPECT_EQ(store_->GetAttributes(3),
+            "hashes:\"[0x1f,0x2a]\",duration:40,tid:8");
+  EXPECT_EQ(store_->GetThread(3), 8);
+  EXPECT_EQ(store_->GetValue(3), 40);
+  EXPECT_EQ(store_->GetValue(2), 5);
+  EXPECT_EQ(store_->GetValue(1), 16);
+}
+
+TEST_F(EventStoreTest, QueriesEvents) {
+  EventQuery query;
+  query.name = "frame_present";
+  EXPECT_THAT(QueryTimestamps(query), ElementsAre(1000, 3000));
+  query.name = "no_such_event";
+  EXPECT_TRUE(QueryTimestamps(query).empty());
+
+  query = {};
+  query.hash = 0x1f;
+  EXPECT_THAT(QueryTimestamps(query), ElementsAre(1200, 1500));
+  query.hash = 0x2a;
+  EXPECT_THAT(QueryTimestamps(query), ElementsAre(1200, 1500, 2500));
+  query.name = "create_shader_module_ns";
+  EXPECT_THAT(QueryTimestamps(query), ElementsAre(2500));
+  query.hash = 0x3;
+  EXPECT_TRUE(QueryTimestamps(query).empty());
+
+  query = {};
+  query.begin_ns = 1000;
+  query.end_ns = 2500;
+  EXPECT_THAT(QueryTimestamps(query), ElementsAre(1000, 1200, 1500));
+  query.begin_ns = 1001;
+  query.end_ns = 100000;
+  EXPECT_THAT(QueryTimestamps(query), ElementsAre(1200, 1500, 2500, 3000));
+  query.begin_ns = 0;
+  query.end_ns = 901;
+  EXPECT_THAT(QueryTimestamps(query), ElementsAre(900));
+  query.hash = 0x2a;
+  query.end_ns = 2000;
+  EXPECT_THAT(QueryTimestamps(query), ElementsAre(1200, 1500));
+
+  query = {};
+  query.thread = 7;
+  EXPECT_THAT(QueryTimestamps(query), ElementsAre(1000, 1200, 3000));
+}
+
+TEST_F(EventStoreTest, AggregatesEvents) {
+  const std::vector<EventAggregate> aggregates =
+      AggregateEvents(*store_, store_->Query({}), "");
+  ASSERT_EQ(aggregates.size(), 5u);
+  EXPECT_EQ(aggregates[2].name, "frame_present");
+  EXPECT_EQ(aggregates[2].num_events, 2u);
+  EXPECT_EQ(aggregates[2].num_values, 2u);
+  EXPECT_DOUBLE_EQ(aggregates[2].sum, 33);
+  EXPECT_DOUBLE_EQ(aggregates[2].min, 16);
+  EXPECT_DOUBLE_EQ(aggregates[2].max, 17);
+  EXPECT_DOUBLE_EQ(aggregates[2].p50, 16.5);
+  EXPECT_EQ(aggregates[3].name, "frame_time_layer_init");
+  EXPECT_EQ(aggregates[3].num_values, 0u);
+
+  EventQuery query;
+  query.name = "pipeline_execution";
+  const std::vector<EventAggregate> invocations = AggregateEvents(
+      *store_, store_->Query(query), "fragment_shader_invocations");
+  ASSERT_EQ(invocations.size(), 1u);
+  EXPECT_DOUBLE_EQ(invocations[0].sum, 9);
+}
+
+TEST(EventStore, ParseHash) {
+  uint64_t hash = 0;
+  EXPECT_TRUE(ParseHash("0x1F", &hash));
+  EXPECT_EQ(hash, 0x1fu);
+  EXPECT_TRUE(ParseHash("0xffffffffffffffff", &hash));
+  EXPECT_EQ(hash, ~uint64_t(0));
+  EXPECT_FALSE(ParseHash("0x", &hash));
+  EXPECT_FALSE(ParseHash("1f", &hash));
+  EXPECT_FALSE(ParseHash("0x1g", &hash));
+  EXPECT_FALSE(ParseHash("0x1ffffffffffffffff", &hash));
+}
+
+TEST(EventStore, RejectsMissingStores) {
+  EXPECT_FALSE(
+      EventStore::Open((fs::temp_directory_path() / "no_event_store").string())
+          .ok());
+}
+
+}  // namespace
+}  // namespace performancelayers
@@ -0,0 +1,103 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdint>
+
+#include "gtest/gtest.h"
+#include "layer/sync_wait/sync_wait_layer_data.h"
+
+namespace performancelayers {
+namespace {
+using std::chrono::microseconds;
+
+const VkFence kFence = reinterpret_cast<VkFence>(uintptr_t{0x10});
+const VkFence kOtherFence = reinterpret_cast<VkFence>(uintptr_t{0x20});
+
+// Issues vkGetFenceStatus calls of 1us each, starting at |time|, and advances
+// |time| past every call.
+class FencePollDetectorTest : public ::testing::Test {
+ protected:
+  bool Poll(VkFence fence, VkResult result, microseconds gap = microseconds(1),
+            FencePollLoop* loop = nullptr) {
+    FencePollLoop unused_loop;
+    const DurationClock::time_point start = time_ + gap;
+    time_ = start + microseconds(1);
+    return detector_.RecordFenceStatus(fence, result, start, time_,
+                                       loop ? loop : &unused_loop);
+  }
+
+  FencePollDetector detector_;
+  DurationClock::time_point time_;
+};
+
+TEST_F(FencePollDetectorTest, SignaledFenceIsNotALoop) {
+  EXPECT_FALSE(Poll(kFence, VK_SUCCESS));
+  EXPECT_FALSE(Poll(kFence, VK_SUCCESS));
+}
+
+TEST_F(FencePollDetectorTest, DetectsLoopUntilSignaled) {
+  EXPECT_FALSE(Poll(kFence, VK_NOT_READY));
+  EXPECT_FALSE(Poll(kFence, VK_NOT_READY));
+  EXPECT_FALSE(Poll(kFence, VK_NOT_READY));
+  FencePollLoop loop;
+  ASSERT_TRUE(Poll(kFence, VK_SUCCESS, microseconds(1), &loop));
+  EXPECT_EQ(loop.poll_count, 4);
+  // Four calls of 1us with 1us between them.
+  EXPECT_EQ(loop.duration.ToNanoseconds(), 7000);
+
+  // The loop ended, so the next signaled call is not part of it.
+  EXPECT_FALSE(Poll(kFence, VK_SUCCESS));
+}
+
+TEST_F(FencePollDetectorTest, DropsLoopAfterLongGap) {
+  EXPECT_FALSE(Poll(kFence, VK_NOT_READY));
+  const microseconds long_gap =
+      std::chrono::duration_cast<microseconds>(
+          FencePollDetector::kMaxFencePollGap) +
+      microseconds(1);
+  EXPECT_FALSE(Poll(kFence, VK_SUCCESS, long_gap));
+}
+
+TEST_F(FencePollDetectorTest, LongGapStartsNewLoop) {
+  EXPECT_FALSE(Poll(kFence, VK_NOT_READY));
+  EXPECT_FALSE(Poll(kFence, VK_NOT_READY, std::chrono::milliseconds(10)));
+  FencePollLoop loop;
+  ASSERT_TRUE(Poll(kFence, VK_SUCCESS, microseconds(1), &loop));
+  EXPECT_EQ(loop.poll_count, 2);
+  EXPECT_EQ(loop.duration.ToNanoseconds(), 3000);
+}
+
+TEST_F(FencePollDetectorTest, PollingAnotherFenceRestartsTheLoop) {
+  EXPECT_FALSE(Poll(kFence, VK_NOT_READY));
+  EXPECT_FALSE(Poll(kOtherFence, VK_NOT_READY));
+  // The loop on |kFence| was dropped.
+  EXPECT_FALSE(Poll(kFence, VK_SUCCESS));
+
+  EXPECT_FALSE(Poll(kOtherFence, VK_NOT_READY));
+  FencePollLoop loop;
+  ASSERT_TRUE(Poll(kOtherFence, VK_SUCCESS, microseconds(1), &loop));
+  EXPECT_EQ(loop.poll_count, 2);
+}
+
+TEST_F(FencePollDetectorTest, ErrorEndsTheLoop) {
+  EXPECT_FALSE(Poll(kFence, VK_NOT_READY));
+  FencePollLoop loop;
+  ASSERT_TRUE(Poll(kFence, VK_ERROR_DEVICE_LOST, microseconds(1), &loop));
+  EXPECT_EQ(loop.poll_count, 2);
+  EXPECT_FALSE(Poll(kFence, VK_NOT_READY));
+}
+
+}  // namespace
+}  // namespace performancelayers
@@ -0,0 +1,76 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/support/intercepted_function_table.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "gtest/gtest.h"
+
+namespace performancelayers {
+namespace {
+
+constexpr std::string_view kNames[] = {
+    "vkCreateInstance",     "vkDestroyInstance",   "vkCreateDevice",
+    "vkDestroyDevice",      "vkAllocateMemory",    "vkFreeMemory",
+    "vkBindBufferMemory",   "vkBindBufferMemory2", "vkBindBufferMemory2KHR",
+    "vkQueuePresentKHR",    "vkGetDeviceProcAddr", "vkGetInstanceProcAddr",
+    "vkCreateShaderModule", "vkDestroyShaderModule"};
+constexpr InterceptedFunctionTable kTable(kNames);
+constexpr size_t kNumNames = sizeof(kNames) / sizeof(kNames[0]);
+
+// The table is usable in constant expressions.
+static_assert(kTable.IsValid());
+static_assert(kTable.Find("vkCreateDevice") == 2);
+static_assert(kTable.Find("vkCreateDevic") == kTable.kNotFound);
+static_assert(kTable.Contains("vkCreateDevice"));
+static_assert(!kTable.Contains("vkCreateDevic"));
+
+TEST(InterceptedFunctionTable, FindsEveryName) {
+  for (size_t i = 0; i != kNumNames; ++i) {
+    // Look up a copy, so that the comparison isn't of the same pointer.
+    const std::string name(kNames[i]);
+    EXPECT_EQ(kTable.Find(name), i) << name;
+  }
+}
+
+TEST(InterceptedFunctionTable, RejectsOtherNames) {
+  EXPECT_EQ(kTable.Find(""), kTable.kNotFound);
+  EXPECT_EQ(kTable.Find("vk"), kTable.kNotFound);
+  EXPECT_EQ(kTable.Find("vkQueueSubmit"), kTable.kNotFound);
+  EXPECT_EQ(kTable.Find("vkBindBufferMemory2EXT"), kTable.kNotFound);
+  EXPECT_EQ(kTable.Find("vkCreateDevice "), kTable.kNotFound);
+  EXPECT_EQ(kTable.Find("VkCreateDevice"), kTable.kNotFound);
+}
+
+TEST(InterceptedFunctionTable, IndexesParallelArray) {
+  // A parallel array with a trailing null entry needs no check of the result.
+  constexpr std::string_view kSmallNames[] = {"vkCmdDraw", "vkCmdDispatch"};
+  constexpr InterceptedFunctionTable kSmallTable(kSmallNames);
+  const char* const values[] = {"draw", "dispatch", nullptr};
+  EXPECT_STREQ(values[kSmallTable.Find("vkCmdDispatch")], "dispatch");
+  EXPECT_STREQ(values[kSmallTable.Find("vkCmdDraw")], "draw");
+  EXPECT_EQ(values[kSmallTable.Find("vkCmdDrawIndexed")], nullptr);
+}
+
+TEST(InterceptedFunctionTable, DuplicateNamesAreInvalid) {
+  constexpr std::string_view kDuplicateNames[] = {"vkCmdDraw", "vkCmdDraw"};
+  constexpr InterceptedFunctionTable kDuplicateTable(kDuplicateNames);
+  EXPECT_FALSE(kDuplicateTable.IsValid());
+}
+
+}  // namespace
+}  // namespace performancelayers
@@ -0,0 +1,155 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/support/layer_config.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+
+namespace performancelayers {
+namespace {
+constexpr char kConfigFile[] = R"(
+# Settings of every profile.
+profile = lightweight
+common.event_log_file = /tmp/events.log
+memory_usage.short_lived_frames = 4
+
+[lightweight]
+runtime.mode = off
+frame_time.mode = sampling
+frame_time.sampling_period = 60
+common.flush_every_event = false
+
+[full-runtime]
+runtime.log = /tmp/runtime.csv
+memory_usage.short_lived_frames = 8
+)";
+
+TEST(LayerConfig, Defaults) {
+  LayerConfig config;
+  EXPECT_TRUE(config.common.flush_every_event);
+  EXPECT_EQ(config.common.control_poll_ms, 100);
+  EXPECT_EQ(config.memory_usage.short_lived_frames, 2);
+  EXPECT_EQ(config.memory_usage.snapshot_frames, 60);
+  EXPECT_EQ(config.runtime.module.mode, InstrumentationMode::kFull);
+  EXPECT_EQ(NullIfEmpty(config.runtime.log), nullptr);
+}
+
+TEST(LayerConfig, AppliesDefaultProfile) {
+  LayerConfig config;
+  EXPECT_THAT(ApplyLayerConfigFile(kConfigFile, "", &config), IsEmpty());
+  EXPECT_EQ(config.common.event_log_file, "/tmp/events.log");
+  EXPECT_EQ(config.memory_usage.short_lived_frames, 4);
+  EXPECT_FALSE(config.common.flush_every_event);
+  EXPECT_EQ(config.runtime.module.mode, InstrumentationMode::kOff);
+  EXPECT_EQ(config.frame_time.module.mode, InstrumentationMode::kSampling);
+  EXPECT_EQ(config.frame_time.module.sampling_period, 60);
+  // Not set by the selected profile.
+  EXPECT_EQ(config.runtime.log, "");
+}
+
+TEST(LayerConfig, AppliesSelectedProfile) {
+  LayerConfig config;
+  EXPECT_THAT(ApplyLayerConfigFile(kConfigFile, "full-runtime", &config),
+              IsEmpty());
+  EXPECT_EQ(config.common.event_log_file, "/tmp/events.log");
+  EXPECT_EQ(config.runtime.log, "/tmp/runtime.csv");
+  EXPECT_EQ(config.memory_usage.short_lived_frames, 8);
+  EXPECT_TRUE(config.common.flush_every_event);
+  EXPECT_EQ(config.runtime.module.mode, InstrumentationMode::kFull);
+}
+
+TEST(LayerConfig, ReportsProblems) {
+  LayerConfig config;
+  const std::vector<std::string> problems = ApplyLayerConfigFile(
+      "common.unknown = 1\n"
+      "common.control_poll_ms = soon\n"
+      "runtime.log = /tmp/runtime.csv\n"
+      "no value\n"
+      "[other]\n"
+      "runtime.mode = sometimes\n",
+      "missing", &config);
+  EXPECT_THAT(problems,
+              ElementsAre(HasSubstr("line 4: expected 'key = value'"),
+                          HasSubstr("line 1: unknown key: common.unknown"),
+                          HasSubstr("line 2: invalid value for "
+                                    "common.control_poll_ms"),
+                          HasSubstr("line 6: invalid value for runtime.mode"),
+                          HasSubstr("unknown profile: missing")));
+  // The valid settings are still applied, and the invalid ones are skipped.
+  EXPECT_EQ(config.runtime.log, "/tmp/runtime.csv");
+  EXPECT_EQ(config.common.control_poll_ms, 100);
+}
+
+TEST(LayerConfig, EnvVarsOverrideFile) {
+  LayerConfig config;
+  ASSERT_THAT(ApplyLayerConfigFile(kConfigFile, "", &config), IsEmpty());
+  const std::map<std::string, std::string> env_vars = {
+      {"VK_PERFORMANCE_LAYERS_EVENT_LOG_FILE", "/tmp/other.log"},
+      {"VK_RUNTIME_MODE", "full"},
+      {"VK_MEMORY_USAGE_SHORT_LIVED_FRAMES", "many"},
+      {"VK_FRAME_TIME_LOG", ""},
+  };
+  auto get_env_var = [&env_vars](const char* name) -> const char* {
+    auto it = env_vars.find(name);
+    return it != env_vars.end() ? it->second.c_str() : nullptr;
+  };
+
+  EXPECT_THAT(
+      ApplyLayerConfigEnvVars(get_env_var, &config),
+      ElementsAre(HasSubstr(
+          "invalid value for VK_MEMORY_USAGE_SHORT_LIVED_FRAMES: many")));
+  EXPECT_EQ(config.common.event_log_file, "/tmp/other.log");
+  EXPECT_EQ(config.runtime.module.mode, InstrumentationMode::kFull);
+  EXPECT_EQ(config.memory_usage.short_lived_frames, 4);
+}
+
+TEST(LayerConfig, KeysAreUnique) {
+  std::set<std::string> keys;
+  std::set<std::string> env_vars;
+  for (const LayerConfigKey& key : GetLayerConfigKeys()) {
+    EXPECT_TRUE(keys.insert(key.key).second) << key.key;
+    EXPECT_TRUE(env_vars.insert(key.env_var).second) << key.env_var;
+  }
+  EXPECT_TRUE(keys.count("frame_time.exit_after_frame"));
+  EXPECT_TRUE(env_vars.count("VK_PIPELINE_CACHE_SIDELOAD_FILE"));
+}
+
+TEST(LayerConfig, ModuleConfigs) {
+  LayerConfig config;
+  EXPECT_EQ(config.GetModuleConfig("runtime"), &config.runtime.module);
+  EXPECT_EQ(config.GetModuleConfig("memory_usage"),
+            &config.memory_usage.module);
+  EXPECT_EQ(config.GetModuleConfig("queue_submit"),
+            &config.queue_submit.module);
+  EXPECT_EQ(config.GetModuleConfig("sync_wait"), &config.sync_wait.module);
+  EXPECT_EQ(config.GetModuleConfig("command_recording"),
+            &config.command_recording.module);
+  EXPECT_EQ(config.GetModuleConfig("descriptor"), &config.descriptor.module);
+  EXPECT_EQ(config.GetModuleConfig("resource_creation"),
+            &config.resource_creation.module);
+  EXPECT_EQ(config.GetModuleConfig("cache_sideload"), nullptr);
+}
+
+}  // namespace
+}  // namespace performancelayers
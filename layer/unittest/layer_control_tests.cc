@@ -0,0 +1,193 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/support/layer_control.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+namespace performancelayers {
+namespace {
+namespace fs = std::filesystem;
+
+// A module recording the commands applied to it.
+class FakeModule : public ControlledModule {
+ public:
+  void SetInstrumentationMode(InstrumentationMode mode,
+                              uint32_t sampling_period) override {
+    instrumentation.SetMode(mode, sampling_period);
+  }
+  void SetLogLevel(LogLevel new_log_level) override {
+    log_level = new_log_level;
+  }
+  void Flush() override { ++flushes; }
+  void LogSnapshot() override { ++snapshots; }
+
+  InstrumentationSwitch instrumentation;
+  std::atomic<LogLevel> log_level = LogLevel::kLow;
+  int flushes = 0;
+  int snapshots = 0;
+};
+
+// Replaces the contents of |path| with |contents|.
+void WriteFile(const fs::path& path, const char* contents) {
+  FILE* file = fopen(path.c_str(), "w");
+  ASSERT_NE(file, nullptr);
+  fputs(contents, file);
+  fclose(file);
+}
+
+// Returns the number of the first |num_calls| calls |instrumentation|
+// instruments.
+int CountInstrumentedCalls(InstrumentationSwitch& instrumentation,
+                           int num_calls) {
+  int instrumented = 0;
+  for (int i = 0; i != num_calls; ++i) {
+    if (instrumentation.ShouldInstrument()) ++instrumented;
+  }
+  return instrumented;
+}
+
+TEST(InstrumentationSwitch, SelectsCallsByMode) {
+  InstrumentationSwitch instrumentation;
+  EXPECT_EQ(instrumentation.GetMode(), InstrumentationMode::kFull);
+  EXPECT_EQ(CountInstrumentedCalls(instrumentation, 8), 8);
+
+  instrumentation.SetMode(InstrumentationMode::kOff);
+  EXPECT_EQ(instrumentation.GetMode(), InstrumentationMode::kOff);
+  EXPECT_EQ(CountInstrumentedCalls(instrumentation, 8), 0);
+
+  instrumentation.SetMode(InstrumentationMode::kSampling, 4);
+  EXPECT_EQ(instrumentation.GetMode(), InstrumentationMode::kSampling);
+  EXPECT_EQ(CountInstrumentedCalls(instrumentation, 8), 2);
+
+  // Sampling every call is the full mode.
+  instrumentation.SetMode(InstrumentationMode::kSampling, 1);
+  EXPECT_EQ(instrumentation.GetMode(), InstrumentationMode::kFull);
+}
+
+TEST(ParseControlCommand, ParsesCommands) {
+  std::optional<ControlCommand> command =
+      ParseControlCommand("mode runtime sampling 16");
+  ASSERT_TRUE(command.has_value());
+  EXPECT_EQ(command->kind, ControlCommand::Kind::kMode);
+  EXPECT_EQ(command->module, "runtime");
+  EXPECT_EQ(command->mode, InstrumentationMode::kSampling);
+  EXPECT_EQ(command->sampling_period, 16);
+  EXPECT_TRUE(command->AppliesTo("runtime"));
+  EXPECT_FALSE(command->AppliesTo("frame_time"));
+
+  command = ParseControlCommand("  log_level all\thigh\r");
+  ASSERT_TRUE(command.has_value());
+  EXPECT_EQ(command->kind, ControlCommand::Kind::kLogLevel);
+  EXPECT_EQ(command->log_level, LogLevel::kHigh);
+  EXPECT_TRUE(command->AppliesTo("frame_time"));
+
+  command = ParseControlCommand("flush");
+  ASSERT_TRUE(command.has_value());
+  EXPECT_EQ(command->kind, ControlCommand::Kind::kFlush);
+  EXPECT_EQ(command->module, "all");
+
+  command = ParseControlCommand("snapshot memory_usage");
+  ASSERT_TRUE(command.has_value());
+  EXPECT_EQ(command->kind, ControlCommand::Kind::kSnapshot);
+  EXPECT_EQ(command->module, "memory_usage");
+}
+
+TEST(ParseControlCommand, IgnoresCommentsAndMalformedCommands) {
+  EXPECT_FALSE(ParseControlCommand("").has_value());
+  EXPECT_FALSE(ParseControlCommand("# mode runtime off").has_value());
+  EXPECT_FALSE(ParseControlCommand("mode runtime").has_value());
+  EXPECT_FALSE(ParseControlCommand("mode runtime fast").has_value());
+  EXPECT_FALSE(ParseControlCommand("mode runtime full 16").has_value());
+  EXPECT_FALSE(ParseControlCommand("mode runtime sampling 0").has_value());
+  EXPECT_FALSE(ParseControlCommand("log_level runtime loud").has_value());
+  EXPECT_FALSE(ParseControlCommand("flush runtime now").has_value());
+  EXPECT_FALSE(ParseControlCommand("restart").has_value());
+}
+
+TEST(LayerControl, AppliesControlFile) {
+  const fs::path path = fs::temp_directory_path() / "layer_control_apply";
+  fs::remove(path);
+  LayerControl control(path);
+  FakeModule runtime;
+  FakeModule frame_time;
+  control.AddModule("runtime", &runtime);
+  control.AddModule("frame_time", &frame_time);
+
+  // A missing file changes nothing.
+  EXPECT_FALSE(control.Poll());
+
+  WriteFile(path, "mode runtime off\nlog_level all high\n");
+  EXPECT_TRUE(control.Poll());
+  EXPECT_EQ(runtime.instrumentation.GetMode(), InstrumentationMode::kOff);
+  EXPECT_EQ(frame_time.instrumentation.GetMode(), InstrumentationMode::kFull);
+  EXPECT_EQ(runtime.log_level, LogLevel::kHigh);
+  EXPECT_EQ(frame_time.log_level, LogLevel::kHigh);
+  // The file is applied once.
+  EXPECT_FALSE(control.Poll());
+
+  WriteFile(path, "snapshot runtime\nflush\n");
+  EXPECT_TRUE(control.Poll());
+  EXPECT_EQ(runtime.snapshots, 1);
+  EXPECT_EQ(frame_time.snapshots, 0);
+  EXPECT_EQ(runtime.flushes, 1);
+  EXPECT_EQ(frame_time.flushes, 1);
+
+  // Modules added later get the settings so far, but no snapshot.
+  FakeModule late_runtime;
+  control.AddModule("runtime", &late_runtime);
+  EXPECT_EQ(late_runtime.instrumentation.GetMode(), InstrumentationMode::kOff);
+  EXPECT_EQ(late_runtime.log_level, LogLevel::kHigh);
+  EXPECT_EQ(late_runtime.snapshots, 0);
+
+  // Removed modules are left alone.
+  control.RemoveModule(&late_runtime);
+  WriteFile(path, "mode all sampling 4\n");
+  EXPECT_TRUE(control.Poll());
+  EXPECT_EQ(runtime.instrumentation.GetMode(), InstrumentationMode::kSampling);
+  EXPECT_EQ(frame_time.instrumentation.GetMode(),
+            InstrumentationMode::kSampling);
+  EXPECT_EQ(late_runtime.instrumentation.GetMode(), InstrumentationMode::kOff);
+  fs::remove(path);
+}
+
+TEST(LayerControl, WatchesControlFile) {
+  const fs::path path = fs::temp_directory_path() / "layer_control_watch";
+  fs::remove(path);
+  LayerControl control(path);
+  FakeModule runtime;
+  control.AddModule("runtime", &runtime);
+  control.StartWatching(/*poll_period_ms=*/1);
+
+  WriteFile(path, "mode runtime off\n");
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (runtime.instrumentation.GetMode() != InstrumentationMode::kOff &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(runtime.instrumentation.GetMode(), InstrumentationMode::kOff);
+  control.RemoveModule(&runtime);
+  fs::remove(path);
+}
+
+}  // namespace
+}  // namespace performancelayers
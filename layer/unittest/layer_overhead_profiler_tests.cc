@@ -0,0 +1,196 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/support/layer_overhead_profiler.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "layer/support/event_logging.h"
+#include "layer/support/layer_utils.h"
+
+using ::testing::ElementsAre;
+using ::testing::FieldsAre;
+
+namespace performancelayers {
+namespace {
+// The attributes of a `LayerOverheadEvent`.
+struct OverheadReport {
+  std::string function;
+  bool end_of_run = false;
+  int64_t calls = 0;
+  int64_t total_ns = 0;
+  int64_t max_ns = 0;
+};
+
+// A logger recording the `LayerOverheadEvent`s it receives.
+class OverheadReportLogger : public EventLogger {
+ public:
+  void AddEvent(Event *event) override {
+    OverheadReport report;
+    for (Attribute *attr : event->GetAttributes()) {
+      const std::string_view name = attr->GetName();
+      if (name == "function") {
+        report.function = attr->cast<StringAttr>()->GetValue();
+      } else if (name == "end_of_run") {
+        report.end_of_run = attr->cast<BoolAttr>()->GetValue();
+      } else if (name == "calls") {
+        report.calls = attr->cast<Int64Attr>()->GetValue();
+      } else if (name == "total_time") {
+        report.total_ns = ToNanoseconds(attr);
+      } else if (name == "max_time") {
+        report.max_ns = ToNanoseconds(attr);
+      }
+    }
+    reports.push_back(report);
+  }
+
+  void StartLog() override {}
+  void EndLog() override {}
+  void Flush() override {}
+
+  std::vector<OverheadReport> reports;
+
+ private:
+  static int64_t ToNanoseconds(Attribute *attr) {
+    return attr->cast<DurationAttr>()->GetValue().ToNanoseconds();
+  }
+};
+
+// Returns the function, end-of-run flag and call count of |reports|.
+std::vector<std::tuple<std::string, bool, int64_t>> GetCalls(
+    const std::vector<OverheadReport> &reports) {
+  std::vector<std::tuple<std::string, bool, int64_t>> calls;
+  for (const OverheadReport &report : reports) {
+    calls.emplace_back(report.function, report.end_of_run, report.calls);
+  }
+  return calls;
+}
+
+// Busy-waits for |duration|.
+void Spin(std::chrono::nanoseconds duration) {
+  const DurationClock::time_point end = Now() + duration;
+  while (Now() < end) {
+  }
+}
+
+constexpr std::string_view kFunctionNames[] = {"vkFirst", "vkSecond"};
+
+VKAPI_ATTR void VKAPI_CALL NextLayerFunc(uint32_t spin_us) {
+  Spin(std::chrono::microseconds(spin_us));
+}
+
+VKAPI_ATTR void VKAPI_CALL LayerFunc(uint32_t spin_us) {
+  Spin(std::chrono::microseconds(spin_us));
+}
+
+// A layer function that spends |spin_us| in the next layer.
+VKAPI_ATTR void VKAPI_CALL LayerFuncCallingNextLayer(uint32_t spin_us) {
+  NextLayerFunction<void(VKAPI_PTR *)(uint32_t)> next_func = &NextLayerFunc;
+  next_func(spin_us);
+}
+
+TEST(LayerOverheadProfiler, CountsCallsPerFunction) {
+  static LayerOverheadProfiler profiler("TestLayer_", kFunctionNames);
+  auto first = &ProfiledFunction<&LayerFunc, &profiler, 0>::Call;
+  auto second = &ProfiledFunction<&LayerFunc, &profiler, 1>::Call;
+  OverheadReportLogger logger;
+  profiler.SetEventLogger(&logger);
+
+  first(0);
+  first(0);
+  second(0);
+  profiler.Report(/*end_of_run=*/false);
+  EXPECT_THAT(GetCalls(logger.reports),
+              ElementsAre(FieldsAre("vkFirst", false, 2),
+                          FieldsAre("vkSecond", false, 1),
+                          FieldsAre("all", false, 3)));
+
+  // Only the calls since the previous report are reported, and the end-of-run
+  // report covers the whole run.
+  logger.reports.clear();
+  first(0);
+  profiler.Report(/*end_of_run=*/false);
+  profiler.Report(/*end_of_run=*/true);
+  EXPECT_THAT(GetCalls(logger.reports),
+              ElementsAre(FieldsAre("vkFirst", false, 1),
+                          FieldsAre("all", false, 1),
+                          FieldsAre("vkFirst", true, 3),
+                          FieldsAre("vkSecond", true, 1),
+                          FieldsAre("all", true, 4)));
+
+  // Nothing is reported without a logger.
+  logger.reports.clear();
+  profiler.SetEventLogger(nullptr);
+  profiler.Report(/*end_of_run=*/true);
+  EXPECT_TRUE(logger.reports.empty());
+}
+
+TEST(LayerOverheadProfiler, ExcludesNextLayerCalls) {
+  static LayerOverheadProfiler profiler("TestLayer_", kFunctionNames);
+  auto calling_next_layer =
+      &ProfiledFunction<&LayerFuncCallingNextLayer, &profiler, 0>::Call;
+  auto spinning = &ProfiledFunction<&LayerFunc, &profiler, 1>::Call;
+  OverheadReportLogger logger;
+  profiler.SetEventLogger(&logger);
+
+  calling_next_layer(20000);
+  spinning(20000);
+  profiler.Report(/*end_of_run=*/false);
+  ASSERT_EQ(logger.reports.size(), 3);
+  EXPECT_EQ(logger.reports[0].function, "vkFirst");
+  EXPECT_LT(logger.reports[0].total_ns, 10000000);
+  EXPECT_EQ(logger.reports[1].function, "vkSecond");
+  EXPECT_GE(logger.reports[1].total_ns, 15000000);
+  EXPECT_EQ(logger.reports[1].max_ns, logger.reports[1].total_ns);
+  profiler.SetEventLogger(nullptr);
+}
+
+TEST(LayerOverheadProfiler, AddsUpThreads) {
+  static LayerOverheadProfiler profiler("TestLayer_", kFunctionNames);
+  auto first = &ProfiledFunction<&LayerFunc, &profiler, 0>::Call;
+  OverheadReportLogger logger;
+  profiler.SetEventLogger(&logger);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i != 4; ++i) {
+    threads.emplace_back([first] {
+      for (int j = 0; j != 100; ++j) first(0);
+    });
+  }
+  for (std::thread &thread : threads) thread.join();
+  profiler.Report(/*end_of_run=*/true);
+  EXPECT_THAT(GetCalls(logger.reports),
+              ElementsAre(FieldsAre("vkFirst", true, 400),
+                          FieldsAre("all", true, 400)));
+  profiler.SetEventLogger(nullptr);
+}
+
+TEST(NextLayerFunction, ConvertsToFunctionPointer) {
+  NextLayerFunction<void(VKAPI_PTR *)(uint32_t)> next_func = &NextLayerFunc;
+  void(VKAPI_PTR * func_ptr)(uint32_t) = next_func;
+  EXPECT_EQ(func_ptr, &NextLayerFunc);
+  // Calls outside of profiled functions are not timed.
+  next_func(0);
+}
+
+}  // namespace
+}  // namespace performancelayers
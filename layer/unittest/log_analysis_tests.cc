@@ -0,0 +1,276 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/tools/log_analysis.h"
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "layer/tools/log_reader.h"
+
+using ::testing::DoubleNear;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+
+namespace performancelayers {
+namespace {
+std::vector<std::vector<std::string>> ReadAllRows(std::string_view data) {
+  CsvReader reader(data);
+  std::vector<std::string_view> fields;
+  std::vector<std::vector<std::string>> rows;
+  while (reader.NextRow(&fields))
+    rows.emplace_back(fields.begin(), fields.end());
+  return rows;
+}
+
+std::vector<size_t> ScanAll(std::string_view data) {
+  DelimiterScanner scanner(data);
+  std::vector<size_t> positions;
+  for (size_t p = scanner.Next(); p != data.size(); p = scanner.Next())
+    positions.push_back(p);
+  return positions;
+}
+
+TEST(DelimiterScanner, FindsDelimitersAcrossBlocks) {
+  const std::string data = "a,\"b\"\n0123456789abcdefghij,xyz\n";
+  std::vector<size_t> expected;
+  for (size_t i = 0; i != data.size(); ++i) {
+    if (data[i] == ',' || data[i] == '"' || data[i] == '\n')
+      expected.push_back(i);
+  }
+  EXPECT_EQ(ScanAll(data), expected);
+  EXPECT_TRUE(ScanAll("").empty());
+  EXPECT_TRUE(ScanAll("no delimiters in this long line").empty());
+}
+
+TEST(CsvReader, ReadsRows) {
+  EXPECT_THAT(ReadAllRows("a,b\nc,d\n"),
+              ElementsAre(ElementsAre("a", "b"), ElementsAre("c", "d")));
+  // No trailing line feed.
+  EXPECT_THAT(ReadAllRows("a,b\nc,d"),
+              ElementsAre(ElementsAre("a", "b"), ElementsAre("c", "d")));
+  EXPECT_THAT(ReadAllRows("a,b\r\nc,\r\n"),
+              ElementsAre(ElementsAre("a", "b"), ElementsAre("c", "")));
+  EXPECT_TRUE(ReadAllRows("").empty());
+}
+
+TEST(CsvReader, SkipsEmptyRows) {
+  EXPECT_THAT(ReadAllRows("\n\na\n\nb\n"),
+              ElementsAre(ElementsAre("a"), ElementsAre("b")));
+}
+
+TEST(CsvReader, QuotedFields) {
+  EXPECT_THAT(
+      ReadAllRows("create_graphics_pipelines,hashes:\"[1,2,3]\",\"x,y\"\n"),
+      ElementsAre(ElementsAre("create_graphics_pipelines",
+                              "hashes:\"[1,2,3]\"", "x,y")));
+  // An unterminated quote ends with the line.
+  EXPECT_THAT(ReadAllRows("a,\"b,c\nd,e\n"),
+              ElementsAre(ElementsAre("a", "\"b,c"), ElementsAre("d", "e")));
+}
+
+TEST(CsvReader, LongRows) {
+  const std::string long_field(100, 'x');
+  EXPECT_THAT(ReadAllRows(long_field + "," + long_field + "\n1,2\n"),
+              ElementsAre(ElementsAre(long_field, long_field),
+                          ElementsAre("1", "2")));
+}
+
+TEST(CsvReader, LineNumbers) {
+  CsvReader reader("a\nb\n\nc\n");
+  std::vector<std::string_view> fields;
+  ASSERT_TRUE(reader.NextRow(&fields));
+  EXPECT_EQ(reader.GetLineNumber(), 1u);
+  ASSERT_TRUE(reader.NextRow(&fields));
+  EXPECT_EQ(reader.GetLineNumber(), 2u);
+  ASSERT_TRUE(reader.NextRow(&fields));
+  EXPECT_EQ(reader.GetLineNumber(), 4u);
+  EXPECT_FALSE(reader.NextRow(&fields));
+}
+
+TEST(ParseInt64, ParsesWholeText) {
+  int64_t value = 0;
+  EXPECT_TRUE(ParseInt64("1234567890123", &value));
+  EXPECT_EQ(value, 1234567890123);
+  EXPECT_TRUE(ParseInt64("-5", &value));
+  EXPECT_EQ(value, -5);
+  EXPECT_FALSE(ParseInt64("", &value));
+  EXPECT_FALSE(ParseInt64("12a", &value));
+  EXPECT_FALSE(ParseInt64(" 12", &value));
+}
+
+TEST(LogAnalysis, Percentile) {
+  const std::vector<double> values = {1, 2, 3, 4};
+  EXPECT_DOUBLE_EQ(Percentile(values, 0), 1);
+  EXPECT_DOUBLE_EQ(Percentile(values, 50), 2.5);
+  EXPECT_DOUBLE_EQ(Percentile(values, 90), 3.7);
+  EXPECT_DOUBLE_EQ(Percentile(values, 100), 4);
+  EXPECT_DOUBLE_EQ(Percentile({7}, 95), 7);
+}
+
+constexpr char kFrameTimeLog[] =
+    "Frame Time (ns),Benchmark State\n"
+    "500000000,0\n"
+    "500000000,0\n"
+    "10000000,1\n"
+    "20000000,1\n"
+    "30000000,1\n"
+    "40000000,1\n";
+
+TEST(LogAnalysis, AnalyzeFrameTimeLog) {
+  absl::StatusOr<FrameTimeStats> stats =
+      AnalyzeFrameTimeLog("dir/run/frame_time.csv", kFrameTimeLog, {});
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  EXPECT_EQ(stats->run_name, "run/frame_time.csv");
+  EXPECT_EQ(stats->frame_times_ns.size(), 6u);
+  EXPECT_DOUBLE_EQ(stats->total_duration_ms, 1100);
+  EXPECT_DOUBLE_EQ(stats->p50_ms, 35);
+  // Frames longer than 1/45 s.
+  EXPECT_DOUBLE_EQ(stats->missed_percent, 400.0 / 6);
+  EXPECT_DOUBLE_EQ(stats->GetTimeInStateS(0), 1);
+  EXPECT_DOUBLE_EQ(stats->GetTimeInStateS(1), 0.1);
+  EXPECT_DOUBLE_EQ(stats->GetTimeInStateS(2), 0);
+
+  const std::vector<FpsBin> fps = stats->GetFpsOverTime();
+  ASSERT_EQ(fps.size(), 2u);
+  EXPECT_EQ(fps[0].frames, 1);
+  EXPECT_EQ(fps[0].state, 0);
+  EXPECT_EQ(fps[1].frames, 5);
+  EXPECT_EQ(fps[1].state, 1);
+}
+
+TEST(LogAnalysis, AnalyzeFrameTimeLogFilters) {
+  FrameTimeFilter filter;
+  filter.gameplay_state = 1;
+  absl::StatusOr<FrameTimeStats> stats =
+      AnalyzeFrameTimeLog("frame_time.csv", kFrameTimeLog, filter);
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  EXPECT_EQ(stats->frame_times_ns.size(), 4u);
+  EXPECT_DOUBLE_EQ(stats->average_frame_time_ms, 25);
+  // The time in the filtered out states is still reported.
+  EXPECT_DOUBLE_EQ(stats->GetTimeInStateS(0), 1);
+
+  filter = {};
+  filter.drop_front_s = 1;
+  stats = AnalyzeFrameTimeLog("frame_time.csv", kFrameTimeLog, filter);
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  EXPECT_EQ(stats->frame_times_ns.size(), 5u);
+
+  filter = {};
+  filter.duration_s = 0;
+  stats = AnalyzeFrameTimeLog("frame_time.csv", kFrameTimeLog, filter);
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  EXPECT_EQ(stats->frame_times_ns.size(), 1u);
+
+  filter = {};
+  filter.gameplay_state = 2;
+  stats = AnalyzeFrameTimeLog("frame_time.csv", kFrameTimeLog, filter);
+  EXPECT_FALSE(stats.ok());
+}
+
+TEST(LogAnalysis, AnalyzeFrameTimeLogMalformed) {
+  absl::StatusOr<FrameTimeStats> stats = AnalyzeFrameTimeLog(
+      "frame_time.csv", "header\n1000,0\n1000\n", FrameTimeFilter());
+  ASSERT_FALSE(stats.ok());
+  EXPECT_THAT(stats.status().message(), HasSubstr("frame_time.csv:3"));
+}
+
+TEST(LogAnalysis, SummarizeFrameTimes) {
+  std::vector<FrameTimeStats> runs(3);
+  runs[0].average_frame_time_ms = 10;
+  runs[1].average_frame_time_ms = 20;
+  runs[2].average_frame_time_ms = 30;
+  const std::vector<MetricSummary> summaries = SummarizeFrameTimes(runs);
+  ASSERT_EQ(summaries.size(), 6u);
+  EXPECT_STREQ(summaries[0].metric, "avg");
+  ASSERT_EQ(summaries[0].values.size(), GetSummaryFunctions().size());
+  // P5, Median, P95, Std Dev and Noise.
+  EXPECT_THAT(summaries[0].values,
+              ElementsAre(DoubleNear(11, 1e-9), DoubleNear(20, 1e-9),
+                          DoubleNear(29, 1e-9), DoubleNear(8.16497, 1e-5),
+                          DoubleNear(1800.0 / 11, 1e-9)));
+}
+
+TEST(LogAnalysis, AnalyzeEventLog) {
+  const EventTimeline timeline = AnalyzeEventLog(
+      "frame_present,timestamp:1000000000,started:0\n"
+      "create_graphics_pipelines,timestamp:1200000000,"
+      "hashes:\"[1,2]\",duration:5000000\n"
+      "frame_present,timestamp:1500000000,started:1\n"
+      "frame_present,timestamp:2000000000,started:1\n"
+      "frame_present,timestamp:2100000000,started:1\n"
+      "truncated_eve");
+  EXPECT_EQ(timeline.num_events, 5u);
+  EXPECT_EQ(timeline.num_malformed_lines, 1u);
+  EXPECT_DOUBLE_EQ(timeline.duration_s, 1.1);
+  EXPECT_EQ(timeline.event_counts.at("frame_present"), 4u);
+
+  ASSERT_EQ(timeline.fps.size(), 4u);
+  EXPECT_EQ(timeline.fps[0].fps, 1);
+  EXPECT_EQ(timeline.fps[1].fps, 2);
+  EXPECT_EQ(timeline.fps[1].state, 1);
+  // The frame a second before is out of the window.
+  EXPECT_EQ(timeline.fps[2].fps, 2);
+  EXPECT_EQ(timeline.fps[3].fps, 3);
+
+  ASSERT_EQ(timeline.pipeline_creations.size(), 1u);
+  EXPECT_DOUBLE_EQ(timeline.pipeline_creations[0].time_s, 0.2);
+  EXPECT_DOUBLE_EQ(timeline.pipeline_creations[0].duration_ms, 5);
+  EXPECT_FALSE(timeline.pipeline_creations[0].compute);
+}
+
+TEST(LogAnalysis, AnalyzeEventLogInParallel) {
+  // Large enough to be split in chunks.
+  std::string contents;
+  for (int64_t i = 0; contents.size() < (40 << 20); ++i) {
+    absl::StrAppend(&contents, "frame_present,timestamp:", i * 16000000,
+                    ",started:", i / 1000 % 2, "\n");
+    if (i % 7 == 0) {
+      absl::StrAppend(&contents, "create_compute_pipelines,timestamp:",
+                      i * 16000000, ",hashes:\"[1,2]\",duration:", i, "\n");
+    }
+  }
+  const EventTimeline expected = AnalyzeEventLog(contents, 1);
+  const EventTimeline timeline = AnalyzeEventLog(contents, 4);
+  EXPECT_EQ(timeline.num_events, expected.num_events);
+  EXPECT_EQ(timeline.duration_s, expected.duration_s);
+  EXPECT_EQ(timeline.event_counts, expected.event_counts);
+  ASSERT_EQ(timeline.fps.size(), expected.fps.size());
+  for (size_t i = 0; i != timeline.fps.size(); ++i) {
+    EXPECT_EQ(timeline.fps[i].time_s, expected.fps[i].time_s);
+    EXPECT_EQ(timeline.fps[i].fps, expected.fps[i].fps);
+    EXPECT_EQ(timeline.fps[i].state, expected.fps[i].state);
+  }
+  ASSERT_EQ(timeline.pipeline_creations.size(),
+            expected.pipeline_creations.size());
+  for (size_t i = 0; i != timeline.pipeline_creations.size(); ++i) {
+    EXPECT_EQ(timeline.pipeline_creations[i].time_s,
+              expected.pipeline_creations[i].time_s);
+  }
+}
+
+TEST(LogAnalysis, RunInParallel) {
+  std::vector<std::atomic<int>> runs(100);
+  RunInParallel(runs.size(), 4, [&](size_t i) { ++runs[i]; });
+  for (const std::atomic<int>& count : runs) EXPECT_EQ(count.load(), 1);
+  RunInParallel(0, 4, [](size_t) { FAIL(); });
+}
+
+}  // namespace
+}  // namespace performancelayers
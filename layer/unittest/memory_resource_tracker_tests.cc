@@ -0,0 +1,238 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/memory_usage/memory_resource_tracker.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace performancelayers {
+namespace {
+// Returns a fake handle. The tracker never dereferences handles.
+template <typename Handle>
+Handle FakeHandle(uintptr_t value) {
+  return reinterpret_cast<Handle>(value);
+}
+
+const VkDevice kDevice = FakeHandle<VkDevice>(0x1000);
+const VkDevice kOtherDevice = FakeHandle<VkDevice>(0x2000);
+
+ResourceInfo BufferInfo(VkDeviceSize requested_size,
+                        VkDeviceSize required_size) {
+  ResourceInfo info;
+  info.kind = ResourceKind::kBuffer;
+  info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+  info.requested_size = requested_size;
+  info.required_size = required_size;
+  return info;
+}
+
+ResourceInfo ImageInfo(VkDeviceSize required_size) {
+  ResourceInfo info;
+  info.kind = ResourceKind::kImage;
+  info.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+  info.format = VK_FORMAT_R8G8B8A8_UNORM;
+  info.required_size = required_size;
+  return info;
+}
+
+BoundRange Range(VkDeviceSize offset, VkDeviceSize size) {
+  return {ResourceKind::kImage, offset, size, 0};
+}
+
+TEST(ComputeUtilization, EmptyAllocationIsOneGap) {
+  const VkDeviceMemory memory = FakeHandle<VkDeviceMemory>(0x10);
+  AllocationUtilization utilization = ComputeUtilization(memory, 1024, {});
+  EXPECT_EQ(utilization.memory, memory);
+  EXPECT_EQ(utilization.allocation_size, 1024u);
+  EXPECT_EQ(utilization.resource_count, 0u);
+  EXPECT_EQ(utilization.bound_bytes, 0u);
+  EXPECT_EQ(utilization.wasted_bytes, 1024u);
+  EXPECT_EQ(utilization.fragmented_bytes, 0u);
+}
+
+TEST(ComputeUtilization, CountsGapsOutsideTheLargestAsFragmented) {
+  // [0, 100) bound, [100, 200) free, [200, 300) bound, [300, 1000) free.
+  AllocationUtilization utilization = ComputeUtilization(
+      VK_NULL_HANDLE, 1000, {Range(200, 100), Range(0, 100)});
+  EXPECT_EQ(utilization.resource_count, 2u);
+  EXPECT_EQ(utilization.bound_bytes, 200u);
+  EXPECT_EQ(utilization.wasted_bytes, 800u);
+  EXPECT_EQ(utilization.fragmented_bytes, 100u);
+}
+
+TEST(ComputeUtilization, MergesAliasedRanges) {
+  AllocationUtilization utilization = ComputeUtilization(
+      VK_NULL_HANDLE, 1000,
+      {Range(0, 500), Range(100, 100), Range(400, 200)});
+  EXPECT_EQ(utilization.resource_count, 3u);
+  EXPECT_EQ(utilization.bound_bytes, 600u);
+  EXPECT_EQ(utilization.wasted_bytes, 400u);
+  EXPECT_EQ(utilization.fragmented_bytes, 0u);
+}
+
+TEST(ComputeUtilization, ClampsRangesToTheAllocation) {
+  AllocationUtilization utilization = ComputeUtilization(
+      VK_NULL_HANDLE, 1000, {Range(900, 500), Range(2000, 100)});
+  EXPECT_EQ(utilization.bound_bytes, 100u);
+  EXPECT_EQ(utilization.wasted_bytes, 900u);
+  EXPECT_EQ(utilization.fragmented_bytes, 0u);
+}
+
+TEST(ComputeUtilization, CountsBufferPadding) {
+  const BoundRange buffer = {ResourceKind::kBuffer, 0, 256, 200};
+  const BoundRange image = {ResourceKind::kImage, 256, 256, 0};
+  AllocationUtilization utilization =
+      ComputeUtilization(VK_NULL_HANDLE, 512, {buffer, image});
+  EXPECT_EQ(utilization.padding_bytes, 56u);
+  EXPECT_EQ(utilization.wasted_bytes, 0u);
+}
+
+TEST(MemoryResourceTracker, AttributesBoundResources) {
+  MemoryResourceTracker tracker;
+  tracker.AddDevice(kDevice);
+  const VkDeviceMemory memory = FakeHandle<VkDeviceMemory>(0x10);
+  const VkBuffer buffer = FakeHandle<VkBuffer>(0x20);
+  const VkImage image = FakeHandle<VkImage>(0x30);
+  const VkImage unbound_image = FakeHandle<VkImage>(0x40);
+  tracker.RecordAllocateMemory(kDevice, memory, 1024);
+  tracker.RecordCreateBuffer(kDevice, buffer, BufferInfo(100, 128));
+  tracker.RecordCreateImage(kDevice, image, ImageInfo(256));
+  tracker.RecordCreateImage(kDevice, unbound_image, ImageInfo(64));
+  tracker.RecordBindBufferMemory(kDevice, buffer, memory, 0);
+  tracker.RecordBindImageMemory(kDevice, image, memory, 512);
+
+  ResourceAttributionReport report = tracker.GetReport(10, 10);
+  EXPECT_EQ(report.allocation_count, 1u);
+  EXPECT_EQ(report.allocation_bytes, 1024u);
+  EXPECT_EQ(report.bound_bytes, 384u);
+  EXPECT_EQ(report.wasted_bytes, 640u);
+  // The gaps are [128, 512) and [768, 1024); only the smaller one is
+  // fragmented.
+  EXPECT_EQ(report.fragmented_bytes, 256u);
+  EXPECT_EQ(report.padding_bytes, 28u);
+  EXPECT_EQ(report.unbound_resource_count, 1u);
+  ASSERT_EQ(report.most_wasteful_allocations.size(), 1u);
+  EXPECT_EQ(report.most_wasteful_allocations[0].resource_count, 2u);
+  ASSERT_EQ(report.largest_resource_classes.size(), 2u);
+  EXPECT_EQ(report.largest_resource_classes[0].kind, ResourceKind::kImage);
+  EXPECT_EQ(report.largest_resource_classes[0].bytes, 256u);
+  EXPECT_EQ(report.largest_resource_classes[1].kind, ResourceKind::kBuffer);
+  EXPECT_EQ(report.largest_resource_classes[1].bytes, 128u);
+}
+
+TEST(MemoryResourceTracker, FreeingMemoryUnbindsResources) {
+  MemoryResourceTracker tracker;
+  tracker.AddDevice(kDevice);
+  const VkDeviceMemory memory = FakeHandle<VkDeviceMemory>(0x10);
+  const VkBuffer buffer = FakeHandle<VkBuffer>(0x20);
+  tracker.RecordAllocateMemory(kDevice, memory, 1024);
+  tracker.RecordCreateBuffer(kDevice, buffer, BufferInfo(128, 128));
+  tracker.RecordBindBufferMemory(kDevice, buffer, memory, 0);
+  tracker.RecordFreeMemory(kDevice, memory);
+
+  ResourceAttributionReport report = tracker.GetReport(10, 10);
+  EXPECT_EQ(report.allocation_count, 0u);
+  EXPECT_EQ(report.unbound_resource_count, 1u);
+  EXPECT_TRUE(report.largest_resource_classes.empty());
+}
+
+TEST(MemoryResourceTracker, DestroyingResourcesReleasesTheirRanges) {
+  MemoryResourceTracker tracker;
+  tracker.AddDevice(kDevice);
+  const VkDeviceMemory memory = FakeHandle<VkDeviceMemory>(0x10);
+  const VkImage image = FakeHandle<VkImage>(0x30);
+  tracker.RecordAllocateMemory(kDevice, memory, 1024);
+  tracker.RecordCreateImage(kDevice, image, ImageInfo(512));
+  tracker.RecordBindImageMemory(kDevice, image, memory, 0);
+  EXPECT_EQ(tracker.GetReport(10, 10).bound_bytes, 512u);
+
+  tracker.RecordDestroyImage(kDevice, image);
+  ResourceAttributionReport report = tracker.GetReport(10, 10);
+  EXPECT_EQ(report.bound_bytes, 0u);
+  EXPECT_EQ(report.unbound_resource_count, 0u);
+}
+
+TEST(MemoryResourceTracker, BuffersAndImagesWithTheSameHandleAreDistinct) {
+  MemoryResourceTracker tracker;
+  tracker.AddDevice(kDevice);
+  const VkDeviceMemory memory = FakeHandle<VkDeviceMemory>(0x10);
+  tracker.RecordAllocateMemory(kDevice, memory, 1024);
+  tracker.RecordCreateBuffer(kDevice, FakeHandle<VkBuffer>(0x20),
+                             BufferInfo(128, 128));
+  tracker.RecordCreateImage(kDevice, FakeHandle<VkImage>(0x20),
+                            ImageInfo(256));
+  tracker.RecordBindBufferMemory(kDevice, FakeHandle<VkBuffer>(0x20), memory,
+                                 0);
+  tracker.RecordBindImageMemory(kDevice, FakeHandle<VkImage>(0x20), memory,
+                                256);
+  tracker.RecordDestroyBuffer(kDevice, FakeHandle<VkBuffer>(0x20));
+
+  ResourceAttributionReport report = tracker.GetReport(10, 10);
+  EXPECT_EQ(report.bound_bytes, 256u);
+  ASSERT_EQ(report.largest_resource_classes.size(), 1u);
+  EXPECT_EQ(report.largest_resource_classes[0].kind, ResourceKind::kImage);
+}
+
+TEST(MemoryResourceTracker, IgnoresUnknownMemoryAndDevices) {
+  MemoryResourceTracker tracker;
+  tracker.AddDevice(kDevice);
+  const VkBuffer buffer = FakeHandle<VkBuffer>(0x20);
+  tracker.RecordCreateBuffer(kDevice, buffer, BufferInfo(128, 128));
+  tracker.RecordBindBufferMemory(kDevice, buffer,
+                                 FakeHandle<VkDeviceMemory>(0x10), 0);
+  tracker.RecordAllocateMemory(kOtherDevice, FakeHandle<VkDeviceMemory>(0x50),
+                               1024);
+
+  ResourceAttributionReport report = tracker.GetReport(10, 10);
+  EXPECT_EQ(report.allocation_count, 0u);
+  EXPECT_EQ(report.unbound_resource_count, 1u);
+}
+
+TEST(MemoryResourceTracker, RemoveDeviceDropsOnlyItsRecords) {
+  MemoryResourceTracker tracker;
+  tracker.AddDevice(kDevice);
+  tracker.AddDevice(kOtherDevice);
+  tracker.RecordAllocateMemory(kDevice, FakeHandle<VkDeviceMemory>(0x10), 100);
+  tracker.RecordAllocateMemory(kOtherDevice, FakeHandle<VkDeviceMemory>(0x20),
+                               200);
+  tracker.RecordCreateImage(kDevice, FakeHandle<VkImage>(0x30),
+                            ImageInfo(64));
+
+  tracker.RemoveDevice(kDevice);
+  ResourceAttributionReport report = tracker.GetReport(10, 10);
+  EXPECT_EQ(report.allocation_count, 1u);
+  EXPECT_EQ(report.allocation_bytes, 200u);
+  EXPECT_EQ(report.unbound_resource_count, 0u);
+}
+
+TEST(MemoryResourceTracker, LimitsTheReport) {
+  MemoryResourceTracker tracker;
+  tracker.AddDevice(kDevice);
+  for (uintptr_t i = 1; i <= 4; ++i) {
+    tracker.RecordAllocateMemory(kDevice, FakeHandle<VkDeviceMemory>(i * 0x10),
+                                 i * 100);
+  }
+
+  ResourceAttributionReport report = tracker.GetReport(2, 0);
+  EXPECT_EQ(report.allocation_count, 4u);
+  ASSERT_EQ(report.most_wasteful_allocations.size(), 2u);
+  EXPECT_EQ(report.most_wasteful_allocations[0].wasted_bytes, 400u);
+  EXPECT_EQ(report.most_wasteful_allocations[1].wasted_bytes, 300u);
+}
+
+}  // namespace
+}  // namespace performancelayers
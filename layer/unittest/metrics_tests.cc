@@ -0,0 +1,238 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/support/metrics.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "layer/support/metrics_exporter.h"
+
+using ::testing::HasSubstr;
+
+namespace performancelayers {
+namespace {
+namespace fs = std::filesystem;
+
+// Returns the values of the metric |name| in |metrics|, or null.
+const MetricValues* FindMetric(const std::vector<MetricValues>& metrics,
+                               const std::string& name) {
+  for (const MetricValues& metric : metrics) {
+    if (name == metric.name) return &metric;
+  }
+  return nullptr;
+}
+
+// Sends an HTTP request to the Unix socket |path| and returns the response.
+std::string RequestMetrics(const std::string& path) {
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) !=
+      0) {
+    close(fd);
+    return "";
+  }
+  constexpr char kRequest[] = "GET /metrics HTTP/1.0\r\n\r\n";
+  send(fd, kRequest, strlen(kRequest), MSG_NOSIGNAL);
+  std::string response;
+  char buffer[1024];
+  ssize_t received = 0;
+  while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+    response.append(buffer, received);
+  close(fd);
+  return response;
+}
+
+TEST(Histogram, PowerOfTwoBuckets) {
+  EXPECT_EQ(GetHistogramBucket(-5), 0);
+  EXPECT_EQ(GetHistogramBucket(0), 0);
+  EXPECT_EQ(GetHistogramBucket(1), 1);
+  EXPECT_EQ(GetHistogramBucket(2), 2);
+  EXPECT_EQ(GetHistogramBucket(3), 2);
+  EXPECT_EQ(GetHistogramBucket(4), 3);
+  EXPECT_EQ(GetHistogramBucket(std::numeric_limits<int64_t>::max()),
+            kNumHistogramBuckets - 1);
+
+  EXPECT_EQ(GetHistogramBucketBound(0), 0);
+  EXPECT_EQ(GetHistogramBucketBound(1), 1);
+  EXPECT_EQ(GetHistogramBucketBound(2), 3);
+  EXPECT_EQ(GetHistogramBucketBound(3), 7);
+  EXPECT_EQ(GetHistogramBucketBound(kNumHistogramBuckets - 1),
+            std::numeric_limits<int64_t>::max());
+  for (size_t bucket = 0; bucket + 1 < kNumHistogramBuckets; ++bucket) {
+    EXPECT_EQ(GetHistogramBucket(GetHistogramBucketBound(bucket)), bucket);
+    EXPECT_EQ(GetHistogramBucket(GetHistogramBucketBound(bucket) + 1),
+              bucket + 1);
+  }
+}
+
+TEST(MetricsRegistry, CollectsMetrics) {
+  MetricsRegistry registry;
+  Counter counter = registry.GetCounter("test_total");
+  Gauge gauge = registry.GetGauge("test_bytes");
+  Histogram histogram = registry.GetHistogram("test_us");
+  counter.Add();
+  counter.Add(4);
+  // The same name is the same metric.
+  registry.GetCounter("test_total").Add();
+  gauge.Set(10);
+  gauge.Add(-3);
+  histogram.Record(1);
+  histogram.Record(3);
+  histogram.Record(3);
+
+  const std::vector<MetricValues> metrics = registry.Collect();
+  ASSERT_EQ(metrics.size(), 3);
+  EXPECT_STREQ(metrics[0].name, "test_total");
+  EXPECT_EQ(metrics[0].kind, MetricKind::kCounter);
+  EXPECT_EQ(metrics[0].value, 6);
+  EXPECT_EQ(metrics[1].kind, MetricKind::kGauge);
+  EXPECT_EQ(metrics[1].value, 7);
+  EXPECT_EQ(metrics[2].kind, MetricKind::kHistogram);
+  EXPECT_EQ(metrics[2].value, 3);
+  EXPECT_EQ(metrics[2].sum, 7);
+  EXPECT_EQ(metrics[2].buckets[1], 1);
+  EXPECT_EQ(metrics[2].buckets[2], 2);
+}
+
+TEST(MetricsRegistry, DropsMetricsPastCapacity) {
+  MetricsRegistry registry;
+  for (size_t i = 0; i != kMaxMetrics; ++i)
+    registry.GetCounter(absl::StrCat("test_", i, "_total")).Add();
+  Counter dropped = registry.GetCounter("dropped_total");
+  dropped.Add();
+
+  const std::vector<MetricValues> metrics = registry.Collect();
+  EXPECT_EQ(metrics.size(), kMaxMetrics);
+  EXPECT_EQ(FindMetric(metrics, "dropped_total"), nullptr);
+}
+
+TEST(MetricsRegistry, CountsFromManyThreads) {
+  MetricsRegistry registry;
+  Counter counter = registry.GetCounter("test_total");
+  std::vector<std::thread> threads;
+  for (int i = 0; i != 4; ++i) {
+    threads.emplace_back([counter]() mutable {
+      for (int j = 0; j != 1000; ++j) counter.Add();
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  EXPECT_EQ(registry.Collect()[0].value, 4000);
+}
+
+TEST(FormatPrometheusText, FormatsMetrics) {
+  MetricsRegistry registry;
+  registry.GetCounter("test_total").Add(2);
+  registry.GetGauge("test_bytes").Set(-1);
+  Histogram histogram = registry.GetHistogram("test_us");
+  histogram.Record(1);
+  histogram.Record(5);
+
+  EXPECT_EQ(FormatPrometheusText(registry.Collect()),
+            "# TYPE test_total counter\n"
+            "test_total 2\n"
+            "# TYPE test_bytes gauge\n"
+            "test_bytes -1\n"
+            "# TYPE test_us histogram\n"
+            "test_us_bucket{le=\"0\"} 0\n"
+            "test_us_bucket{le=\"1\"} 1\n"
+            "test_us_bucket{le=\"3\"} 1\n"
+            "test_us_bucket{le=\"7\"} 2\n"
+            "test_us_bucket{le=\"+Inf\"} 2\n"
+            "test_us_sum 6\n"
+            "test_us_count 2\n");
+}
+
+TEST(MetricsPage, ReadsPublishedMetrics) {
+  MetricsRegistry registry;
+  registry.GetCounter("test_total").Add(3);
+  auto page = std::make_unique<MetricsPage>();
+  PublishMetrics(registry.Collect(), /*pid=*/42, /*publish_time_ns=*/1000,
+                 page.get());
+
+  MetricsPageContents contents;
+  ASSERT_TRUE(ReadMetricsPage(*page, &contents));
+  EXPECT_EQ(contents.pid, 42);
+  EXPECT_EQ(contents.publish_time_ns, 1000);
+  ASSERT_EQ(contents.metrics.size(), 1);
+  EXPECT_STREQ(contents.metrics[0].name, "test_total");
+  EXPECT_EQ(contents.metrics[0].value, 3);
+
+  // A page being updated cannot be read.
+  page->sequence.fetch_add(1);
+  EXPECT_FALSE(ReadMetricsPage(*page, &contents));
+  page->sequence.fetch_add(1);
+  EXPECT_TRUE(ReadMetricsPage(*page, &contents));
+
+  page->magic = 0;
+  EXPECT_FALSE(ReadMetricsPage(*page, &contents));
+}
+
+TEST(MetricsExporter, ExportsToSharedMemoryAndSocket) {
+  const std::string shm_name =
+      absl::StrCat("/layer_metrics_tests.", getpid());
+  const std::string socket_path =
+      fs::temp_directory_path() /
+      absl::StrCat("layer_metrics_tests.", getpid());
+  MetricsRegistry registry;
+  registry.GetCounter("test_total").Add(5);
+
+  {
+    MetricsExporter exporter(&registry, {shm_name, socket_path,
+                                         /*period_ms=*/1});
+    ASSERT_TRUE(exporter.Start());
+
+    std::unique_ptr<MetricsPageReader> reader =
+        MetricsPageReader::Open(shm_name);
+    ASSERT_NE(reader, nullptr);
+    MetricsPageContents contents;
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while ((!reader->Read(&contents) || contents.metrics.empty()) &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(contents.metrics.size(), 1);
+    EXPECT_EQ(contents.pid, getpid());
+    EXPECT_EQ(contents.metrics[0].value, 5);
+
+    const std::string response = RequestMetrics(socket_path);
+    EXPECT_THAT(response, HasSubstr("HTTP/1.0 200 OK\r\n"));
+    EXPECT_THAT(response, HasSubstr("\r\n\r\n# TYPE test_total counter\n"
+                                    "test_total 5\n"));
+  }
+
+  // The outputs are removed with the exporter.
+  EXPECT_EQ(MetricsPageReader::Open(shm_name), nullptr);
+  EXPECT_FALSE(fs::exists(socket_path));
+}
+
+}  // namespace
+}  // namespace performancelayers
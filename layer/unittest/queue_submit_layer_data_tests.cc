@@ -0,0 +1,90 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/queue_submit/queue_submit_layer_data.h"
+
+#include <cstdint>
+
+#include "gtest/gtest.h"
+
+namespace performancelayers {
+namespace {
+// Returns a fake handle. CountSubmits never dereferences handles.
+template <typename Handle>
+Handle FakeHandle(uintptr_t value) {
+  return reinterpret_cast<Handle>(value);
+}
+
+TEST(CountSubmits, SumsSubmitInfos) {
+  VkSubmitInfo submits[2] = {};
+  submits[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submits[0].waitSemaphoreCount = 1;
+  submits[0].commandBufferCount = 3;
+  submits[1].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submits[1].commandBufferCount = 2;
+  submits[1].signalSemaphoreCount = 2;
+
+  QueueSubmitCounts counts = CountSubmits(2, submits, VK_NULL_HANDLE);
+  EXPECT_EQ(counts.batch_count, 2u);
+  EXPECT_EQ(counts.command_buffer_count, 5u);
+  EXPECT_EQ(counts.wait_semaphore_count, 1u);
+  EXPECT_EQ(counts.signal_semaphore_count, 2u);
+  EXPECT_FALSE(counts.has_fence);
+}
+
+TEST(CountSubmits, SumsSubmitInfo2s) {
+  VkSubmitInfo2 submits[2] = {};
+  submits[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+  submits[0].commandBufferInfoCount = 4;
+  submits[0].signalSemaphoreInfoCount = 1;
+  submits[1].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+  submits[1].waitSemaphoreInfoCount = 2;
+  submits[1].commandBufferInfoCount = 1;
+
+  QueueSubmitCounts counts =
+      CountSubmits(2, submits, FakeHandle<VkFence>(0x10));
+  EXPECT_EQ(counts.batch_count, 2u);
+  EXPECT_EQ(counts.command_buffer_count, 5u);
+  EXPECT_EQ(counts.wait_semaphore_count, 2u);
+  EXPECT_EQ(counts.signal_semaphore_count, 1u);
+  EXPECT_TRUE(counts.has_fence);
+}
+
+TEST(CountSubmits, CountsBindSparseInfosWithoutCommandBuffers) {
+  VkBindSparseInfo bind_infos[3] = {};
+  for (VkBindSparseInfo& bind_info : bind_infos) {
+    bind_info.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+    bind_info.waitSemaphoreCount = 1;
+    bind_info.signalSemaphoreCount = 1;
+  }
+
+  QueueSubmitCounts counts =
+      CountSubmits(3, bind_infos, FakeHandle<VkFence>(0x10));
+  EXPECT_EQ(counts.batch_count, 3u);
+  EXPECT_EQ(counts.command_buffer_count, 0u);
+  EXPECT_EQ(counts.wait_semaphore_count, 3u);
+  EXPECT_EQ(counts.signal_semaphore_count, 3u);
+  EXPECT_TRUE(counts.has_fence);
+}
+
+TEST(CountSubmits, EmptySubmissionOnlyCountsTheFence) {
+  QueueSubmitCounts counts = CountSubmits(
+      0, static_cast<const VkSubmitInfo*>(nullptr), FakeHandle<VkFence>(0x10));
+  EXPECT_EQ(counts.batch_count, 0u);
+  EXPECT_EQ(counts.command_buffer_count, 0u);
+  EXPECT_TRUE(counts.has_fence);
+}
+
+}  // namespace
+}  // namespace performancelayers
@@ -0,0 +1,212 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/tools/run_comparison.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using ::testing::DoubleNear;
+using ::testing::ElementsAre;
+using ::testing::Pair;
+
+namespace performancelayers {
+namespace {
+TEST(RunComparison, ReadsCsvLogs) {
+  absl::StatusOr<RunMetrics> compile_times = ReadLogMetrics(
+      "compile_time.csv",
+      "Pipeline,Compile Time (ns)\n"
+      "\"[0x1,0x2]\",2000000\n"
+      "\"[0x3]\",1000000\n"
+      "\"[0x1,0x2]\",4000000\n");
+  ASSERT_TRUE(compile_times.ok()) << compile_times.status();
+  EXPECT_THAT(compile_times->metrics,
+              ElementsAre(Pair("compile_time_total_ms", 7)));
+  EXPECT_THAT(compile_times->pipeline_metrics.at("compile_time_ms"),
+              ElementsAre(Pair("[0x1,0x2]", 3), Pair("[0x3]", 1)));
+
+  absl::StatusOr<RunMetrics> run_times = ReadLogMetrics(
+      "run_time.csv",
+      "Pipeline,Run Time (ns),Fragment Shader Invocations,Compute Shader "
+      "Invocations\n"
+      "\"[0x1]\",500000,100,0\n");
+  ASSERT_TRUE(run_times.ok()) << run_times.status();
+  EXPECT_THAT(run_times->metrics, ElementsAre(Pair("gpu_time_total_ms", 0.5)));
+  EXPECT_THAT(run_times->pipeline_metrics.at("gpu_time_ms"),
+              ElementsAre(Pair("[0x1]", 0.5)));
+
+  absl::StatusOr<RunMetrics> memory_usage = ReadLogMetrics(
+      "memory_usage.csv",
+      "Current (bytes), peak (bytes)\n1048576,2097152\n0,3145728\n");
+  ASSERT_TRUE(memory_usage.ok()) << memory_usage.status();
+  EXPECT_THAT(memory_usage->metrics, ElementsAre(Pair("peak_memory_mb", 3)));
+
+  absl::StatusOr<RunMetrics> frame_times = ReadLogMetrics(
+      "frame_time.csv",
+      "Frame Time (ns),Benchmark State\n10000000,1\n20000000,1\n30000000,1\n");
+  ASSERT_TRUE(frame_times.ok()) << frame_times.status();
+  EXPECT_DOUBLE_EQ(frame_times->metrics.at("frame_time_avg_ms"), 20);
+  EXPECT_DOUBLE_EQ(frame_times->metrics.at("frame_time_p50_ms"), 20);
+
+  EXPECT_EQ(ReadLogMetrics("compile_time.csv",
+                           "Pipeline,Compile Time (ns)\n\"[0x1]\",x\n")
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_TRUE(absl::IsNotFound(
+      ReadLogMetrics("trace.log", "[\n{ \"name\" : \"a\" },\n").status()));
+  EXPECT_TRUE(absl::IsNotFound(ReadLogMetrics("empty.csv", "").status()));
+}
+
+TEST(RunComparison, ReadsEventLogs) {
+  absl::StatusOr<RunMetrics> metrics = ReadLogMetrics(
+      "events.log",
+      "frame_present,timestamp:1,frame_time:10000000,started:1\n"
+      "create_graphics_pipelines,timestamp:2,hashes:\"[0x1,0x2]\","
+      "duration:2000000\n"
+      "pipeline_execution,timestamp:3,pipeline:\"[0x1,0x2]\",runtime:300000,"
+      "fragment_shader_invocations:5,compute_shader_invocations:0\n"
+      "memory_usage_present,timestamp:4,current:1,peak:1048576\n"
+      "frame_present,timestamp:5,frame_time:20000000,started:1\n"
+      "truncated_eve");
+  ASSERT_TRUE(metrics.ok()) << metrics.status();
+  EXPECT_DOUBLE_EQ(metrics->metrics.at("frame_time_avg_ms"), 15);
+  EXPECT_DOUBLE_EQ(metrics->metrics.at("compile_time_total_ms"), 2);
+  EXPECT_DOUBLE_EQ(metrics->metrics.at("gpu_time_total_ms"), 0.3);
+  EXPECT_DOUBLE_EQ(metrics->metrics.at("peak_memory_mb"), 1);
+  EXPECT_THAT(metrics->pipeline_metrics.at("compile_time_ms"),
+              ElementsAre(Pair("[0x1,0x2]", 2)));
+  EXPECT_THAT(metrics->pipeline_metrics.at("gpu_time_ms"),
+              ElementsAre(Pair("[0x1,0x2]", 0.3)));
+
+  // The CSV logs take precedence.
+  RunMetrics run;
+  run.metrics["peak_memory_mb"] = 5;
+  AddMissingMetrics(*metrics, &run);
+  EXPECT_DOUBLE_EQ(run.metrics.at("peak_memory_mb"), 5);
+  EXPECT_DOUBLE_EQ(run.metrics.at("compile_time_total_ms"), 2);
+}
+
+TEST(RunComparison, MannWhitneyUTest) {
+  // The exact p-values, as computed by scipy.stats.mannwhitneyu.
+  MannWhitneyResult result = MannWhitneyUTest({1, 2, 3}, {4, 5, 6});
+  EXPECT_DOUBLE_EQ(result.u, 0);
+  EXPECT_DOUBLE_EQ(result.p_value, 0.1);
+  result = MannWhitneyUTest({6, 7, 8, 9, 10}, {1, 2, 3, 4, 5});
+  EXPECT_DOUBLE_EQ(result.u, 25);
+  EXPECT_DOUBLE_EQ(result.p_value, 2.0 / 252);
+  result = MannWhitneyUTest({1, 4, 5}, {2, 3, 6});
+  EXPECT_DOUBLE_EQ(result.u, 4);
+  EXPECT_DOUBLE_EQ(result.p_value, 1);
+
+  // The normal approximation, with ties.
+  result = MannWhitneyUTest({1, 1, 2, 2}, {3, 3, 4, 4});
+  EXPECT_DOUBLE_EQ(result.u, 0);
+  EXPECT_THAT(result.p_value, DoubleNear(0.02652, 1e-5));
+  EXPECT_DOUBLE_EQ(MannWhitneyUTest({1, 1}, {1, 1}).p_value, 1);
+  EXPECT_DOUBLE_EQ(MannWhitneyUTest({}, {1}).p_value, 1);
+}
+
+TEST(RunComparison, BootstrapMedianDifference) {
+  EXPECT_DOUBLE_EQ(Median({3, 1, 2}), 2);
+  EXPECT_DOUBLE_EQ(Median({4, 1, 3, 2}), 2.5);
+
+  ConfidenceInterval interval =
+      BootstrapMedianDifference({1, 1, 1}, {3, 3, 3}, 0.95, 100, 1);
+  EXPECT_DOUBLE_EQ(interval.low, 2);
+  EXPECT_DOUBLE_EQ(interval.high, 2);
+
+  const std::vector<double> a = {10, 11, 9, 10.5, 9.5, 10.2};
+  const std::vector<double> b = {12, 13, 11.5, 12.5, 12.2, 11.8};
+  interval = BootstrapMedianDifference(a, b, 0.95, 1000, 7);
+  EXPECT_GT(interval.low, 0);
+  EXPECT_LE(interval.low, interval.high);
+  const ConfidenceInterval same_seed =
+      BootstrapMedianDifference(a, b, 0.95, 1000, 7);
+  EXPECT_EQ(same_seed.low, interval.low);
+  EXPECT_EQ(same_seed.high, interval.high);
+}
+
+TEST(RunComparison, CompareRuns) {
+  std::vector<RunMetrics> baseline(10);
+  std::vector<RunMetrics> test(10);
+  for (int i = 0; i != 10; ++i) {
+    // Interleaved noise, and a 20% regression of the p95.
+    baseline[i].metrics["frame_time_p95_ms"] = 20 + i * 0.1;
+    test[i].metrics["frame_time_p95_ms"] = 24 + i * 0.1;
+    baseline[i].metrics["peak_memory_mb"] = 100 + i;
+    test[i].metrics["peak_memory_mb"] = 100.5 + i;
+    baseline[i].pipeline_metrics["compile_time_ms"]["[0x1]"] = 5 - i * 0.01;
+    test[i].pipeline_metrics["compile_time_ms"]["[0x1]"] = 4 - i * 0.01;
+    baseline[i].pipeline_metrics["compile_time_ms"]["[0x2]"] = 1;
+    test[i].pipeline_metrics["compile_time_ms"]["[0x2]"] = 1;
+    baseline[i].pipeline_metrics["compile_time_ms"]["[0x3]"] = 1;
+  }
+  // In only one test run.
+  test[0].metrics["gpu_time_total_ms"] = 1;
+
+  ComparisonOptions options;
+  options.num_resamples = 500;
+  const std::vector<MetricComparison> comparisons =
+      CompareRuns(baseline, test, options);
+  ASSERT_EQ(comparisons.size(), 4u);
+
+  EXPECT_EQ(comparisons[0].metric, "frame_time_p95_ms");
+  EXPECT_EQ(comparisons[0].num_baseline_runs, 10u);
+  EXPECT_DOUBLE_EQ(comparisons[0].delta, 4);
+  EXPECT_DOUBLE_EQ(comparisons[0].relative_delta_percent,
+                   4 / 20.45 * 100);
+  EXPECT_LT(comparisons[0].p_value, 0.001);
+  EXPECT_DOUBLE_EQ(comparisons[0].alpha, 0.05);
+  EXPECT_TRUE(comparisons[0].regression);
+  EXPECT_FALSE(comparisons[0].improvement);
+
+  EXPECT_EQ(comparisons[1].metric, "peak_memory_mb");
+  EXPECT_GT(comparisons[1].p_value, 0.05);
+  EXPECT_FALSE(comparisons[1].regression);
+
+  // The pipelines in at least two runs of each set, with the Bonferroni
+  // correction.
+  EXPECT_EQ(comparisons[2].metric, "compile_time_ms[0x1]");
+  EXPECT_DOUBLE_EQ(comparisons[2].alpha, 0.025);
+  EXPECT_TRUE(comparisons[2].improvement);
+  EXPECT_FALSE(comparisons[2].regression);
+  EXPECT_EQ(comparisons[3].metric, "compile_time_ms[0x2]");
+  EXPECT_DOUBLE_EQ(comparisons[3].p_value, 1);
+  EXPECT_FALSE(comparisons[3].improvement);
+
+  // The results don't depend on the number of threads.
+  options.max_threads = 4;
+  const std::vector<MetricComparison> parallel =
+      CompareRuns(baseline, test, options);
+  ASSERT_EQ(parallel.size(), comparisons.size());
+  for (size_t i = 0; i != parallel.size(); ++i) {
+    EXPECT_EQ(parallel[i].delta_interval.low,
+              comparisons[i].delta_interval.low);
+    EXPECT_EQ(parallel[i].delta_interval.high,
+              comparisons[i].delta_interval.high);
+  }
+
+  // Below the minimum relative delta.
+  options.min_relative_delta_percent = 25;
+  EXPECT_FALSE(CompareRuns(baseline, test, options)[0].regression);
+}
+
+}  // namespace
+}  // namespace performancelayers
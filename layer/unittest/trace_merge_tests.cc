@@ -0,0 +1,192 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layer/tools/trace_merge.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::Pair;
+
+namespace performancelayers {
+namespace {
+namespace fs = std::filesystem;
+
+// Writes |contents| to a temporary file and returns its path.
+std::string WriteTempFile(const char* name, std::string_view contents) {
+  const fs::path path = fs::temp_directory_path() / name;
+  FILE* file = fopen(path.c_str(), "w");
+  EXPECT_NE(file, nullptr);
+  fwrite(contents.data(), 1, contents.size(), file);
+  fclose(file);
+  return path.string();
+}
+
+// Merges |paths| and returns the merged trace.
+std::string Merge(const std::vector<std::string>& paths,
+                  const TraceMergeOptions& options,
+                  TraceMergeStats* stats = nullptr) {
+  FILE* out = tmpfile();
+  EXPECT_NE(out, nullptr);
+  absl::StatusOr<TraceMergeStats> merged = MergeTraces(paths, options, out);
+  EXPECT_TRUE(merged.ok()) << merged.status();
+  if (stats && merged.ok()) *stats = *merged;
+  std::string contents(ftell(out), '\0');
+  rewind(out);
+  EXPECT_EQ(fread(contents.data(), 1, contents.size(), out), contents.size());
+  fclose(out);
+  return contents;
+}
+
+std::string Event(const char* name, int pid, const char* ts) {
+  return absl::StrCat("{ \"name\" : \"", name, "\", \"ph\" : \"i\", ",
+                      "\"cat\" : \"layer\", \"pid\" : ", pid,
+                      ", \"tid\" : 7, \"ts\" : ", ts,
+                      ", \"s\" : \"t\", \"args\" : { } }");
+}
+
+TEST(TraceMerge, ParseTraceTime) {
+  int64_t ns = 0;
+  EXPECT_TRUE(ParseTraceTime("1669687325401.4216", &ns));
+  EXPECT_EQ(ns, 1669687325401421600);
+  EXPECT_TRUE(ParseTraceTime("0.000001", &ns));
+  EXPECT_EQ(ns, 1);
+  EXPECT_TRUE(ParseTraceTime("12", &ns));
+  EXPECT_EQ(ns, 12000000);
+  // Digits past the nanoseconds are dropped.
+  EXPECT_TRUE(ParseTraceTime("1.23456789", &ns));
+  EXPECT_EQ(ns, 1234567);
+  EXPECT_FALSE(ParseTraceTime("", &ns));
+  EXPECT_FALSE(ParseTraceTime("1.", &ns));
+  EXPECT_FALSE(ParseTraceTime("-1.5", &ns));
+  EXPECT_FALSE(ParseTraceTime("1e3", &ns));
+}
+
+TEST(TraceMerge, ParseJsonObject) {
+  std::vector<std::pair<std::string_view, std::string_view>> members;
+  ASSERT_TRUE(ParseJsonObject(
+      "{ \"a\" : \"x,\\\"}\", \"b\":[1, {\"c\" : 2}], \"d\" : true }",
+      &members));
+  EXPECT_THAT(members, ElementsAre(Pair("a", "\"x,\\\"}\""),
+                                   Pair("b", "[1, {\"c\" : 2}]"),
+                                   Pair("d", "true")));
+  EXPECT_TRUE(ParseJsonObject("{ }", &members));
+  EXPECT_TRUE(members.empty());
+  EXPECT_FALSE(ParseJsonObject("{ \"a\" : 1", &members));
+  EXPECT_FALSE(ParseJsonObject("{ \"a\" : \"1 }", &members));
+  EXPECT_FALSE(ParseJsonObject("{ \"a\" 1 }", &members));
+  EXPECT_FALSE(ParseJsonObject("[1]", &members));
+}
+
+TEST(TraceMerge, MergesSortedJson) {
+  // Two layers writing to the same log, and a log truncated by a crash.
+  const std::string first = WriteTempFile(
+      "trace_merge_first.log",
+      absl::StrCat("[\n", Event("a", 10, "3.0"), ",\n[\n",
+                   Event("b", 10, "1.0"), ",\n", Event("c", 10, "2.0"),
+                   ",\n{ \"name\" : \"trunc"));
+  const std::string second = WriteTempFile(
+      "trace_merge_second.log",
+      absl::StrCat("[\n", Event("d", 20, "2.5"), ",\n"));
+
+  TraceMergeStats stats;
+  const std::string merged = Merge({first, second}, {}, &stats);
+  EXPECT_EQ(stats.num_events, 4u);
+  EXPECT_EQ(stats.num_dropped_lines, 3u);
+  EXPECT_EQ(stats.num_malformed_lines, 1u);
+  EXPECT_EQ(stats.num_renumbered_processes, 0u);
+  EXPECT_EQ(
+      merged,
+      absl::StrCat(
+          "[\n",
+          "{ \"name\" : \"process_name\", \"ph\" : \"M\", \"pid\" : 10, "
+          "\"tid\" : 0, \"args\" : { \"name\" : \"trace_merge_first.log\" } "
+          "},\n",
+          "{ \"name\" : \"thread_name\", \"ph\" : \"M\", \"pid\" : 10, "
+          "\"tid\" : 7, \"args\" : { \"name\" : \"thread 7\" } },\n",
+          "{ \"name\" : \"process_name\", \"ph\" : \"M\", \"pid\" : 20, "
+          "\"tid\" : 0, \"args\" : { \"name\" : \"trace_merge_second.log\" } "
+          "},\n",
+          "{ \"name\" : \"thread_name\", \"ph\" : \"M\", \"pid\" : 20, "
+          "\"tid\" : 7, \"args\" : { \"name\" : \"thread 7\" } },\n",
+          Event("b", 10, "1.0"), ",\n", Event("c", 10, "2.0"), ",\n",
+          Event("d", 20, "2.5"), ",\n", Event("a", 10, "3.0"), "\n]\n"));
+
+  // Merging the merged trace changes nothing.
+  const std::string remerged = WriteTempFile("trace_merge_merged.log", merged);
+  EXPECT_EQ(Merge({remerged}, {}), merged);
+
+  fs::remove(first);
+  fs::remove(second);
+  fs::remove(remerged);
+}
+
+TEST(TraceMerge, RenumbersProcesses) {
+  const std::string first = WriteTempFile(
+      "trace_merge_run1.log", absl::StrCat(Event("a", 10, "1.0"), ",\n"));
+  const std::string second = WriteTempFile(
+      "trace_merge_run2.log", absl::StrCat(Event("b", 10, "2.0"), ",\n"));
+  TraceMergeStats stats;
+  const std::string merged = Merge({first, second}, {}, &stats);
+  EXPECT_EQ(stats.num_renumbered_processes, 1u);
+  EXPECT_THAT(merged, HasSubstr(Event("a", 10, "1.0")));
+  EXPECT_THAT(merged, HasSubstr(Event("b", 11, "2.0")));
+  EXPECT_THAT(merged,
+              HasSubstr("\"pid\" : 11, \"tid\" : 0, \"args\" : { \"name\" : "
+                        "\"trace_merge_run2.log\" }"));
+  fs::remove(first);
+  fs::remove(second);
+}
+
+TEST(TraceMerge, SpillsSortedRuns) {
+  std::string contents = "[\n";
+  for (int i = 0; i != 1000; ++i) {
+    // Out of order, with ties.
+    const int ms = (i * 7919) % 500;
+    absl::StrAppend(&contents,
+                    Event(absl::StrCat("e", i).c_str(), 1,
+                          absl::StrCat(ms, ".5").c_str()),
+                    ",\n");
+  }
+  const std::string path = WriteTempFile("trace_merge_spill.log", contents);
+
+  TraceMergeStats stats;
+  const std::string in_memory = Merge({path}, {}, &stats);
+  EXPECT_EQ(stats.num_spilled_runs, 0u);
+  TraceMergeOptions options;
+  options.max_memory_bytes = 4096;
+  const std::string spilled = Merge({path}, options, &stats);
+  EXPECT_GT(stats.num_spilled_runs, 1u);
+  EXPECT_EQ(spilled, in_memory);
+
+  options.format = TraceFormat::kPerfetto;
+  const std::string perfetto = Merge({path}, options);
+  // A sequence of `TracePacket`s, i.e., of length-delimited field 1.
+  ASSERT_FALSE(perfetto.empty());
+  EXPECT_EQ(perfetto[0], '\x0a');
+  fs::remove(path);
+}
+
+}  // namespace
+}  // namespace performancelayers